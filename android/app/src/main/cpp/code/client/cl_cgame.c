@@ -723,6 +723,8 @@ Should only be called by CL_StartHunkUsers
 void CL_InitCGame( void ) {
 	const char			*info;
 	const char			*mapname;
+	const char			*names[MAX_MODELS + MAX_SOUNDS];
+	int					numNames, i;
 	int					t1, t2;
 	vmInterpret_t		interpret;
 
@@ -736,6 +738,16 @@ void CL_InitCGame( void ) {
 	mapname = Info_ValueForKey( info, "mapname" );
 	Com_sprintf( cl.mapname, sizeof( cl.mapname ), "maps/%s.bsp", mapname );
 
+	// inflate what the cgame is about to register on the job threads
+	numNames = 0;
+	for ( i = 1 ; i < MAX_MODELS ; i++ ) {
+		names[numNames++] = cl.gameState.stringData + cl.gameState.stringOffsets[ CS_MODELS + i ];
+	}
+	for ( i = 1 ; i < MAX_SOUNDS ; i++ ) {
+		names[numNames++] = cl.gameState.stringData + cl.gameState.stringOffsets[ CS_SOUNDS + i ];
+	}
+	FS_PrefetchMap( cl.mapname, names, numNames );
+
 	// load the dll or bytecode
 	interpret = Cvar_VariableValue("vm_cgame");
 	if(cl_connectedToPureServer)
@@ -760,6 +772,9 @@ void CL_InitCGame( void ) {
 	// otherwise server commands sent just before a gamestate are dropped
 	VM_Call( cgvm, CG_INIT, clc.serverMessageSequence, clc.lastExecutedServerCommand, clc.clientNum, ptr[0], ptr[1] );
 
+	// everything is registered, anything left over wasn't needed
+	FS_ClearPrefetch();
+
 	// reset any CVAR_CHEAT cvars registered by cgame
 	if ( !clc.demoplaying && !cl_connectedToCheatServer )
 		Cvar_SetCheatState();
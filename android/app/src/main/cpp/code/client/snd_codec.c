@@ -26,6 +26,35 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 
 static snd_codec_t *codecs;
 
+/*
+=================
+S_CodecLoadCached
+
+Loads a sound with a codec, unless the asset cache has the samples it
+decoded from the same file
+=================
+*/
+static void *S_CodecLoadCached(snd_codec_t *codec, const char *filename, snd_info_t *info)
+{
+	void	*rtn;
+	int		length;
+
+	rtn = FS_ReadAssetCache(filename, "pcm1", info, sizeof(*info), &length,
+		Hunk_AllocateTempMemory, Hunk_FreeTempMemory);
+	if(rtn)
+	{
+		if(length == info->size)
+			return rtn;
+		Hunk_FreeTempMemory(rtn);
+	}
+
+	rtn = codec->load(filename, info);
+	if(rtn)
+		FS_WriteAssetCache(filename, "pcm1", info, sizeof(*info), rtn, info->size);
+
+	return rtn;
+}
+
 /*
 =================
 S_CodecGetSound
@@ -57,7 +86,7 @@ static void *S_CodecGetSound(const char *filename, snd_info_t *info)
 			{
 				// Load
 				if( info )
-					rtn = codec->load(localName, info);
+					rtn = S_CodecLoadCached(codec, localName, info);
 				else
 					rtn = codec->open(localName);
 				break;
@@ -94,7 +123,7 @@ static void *S_CodecGetSound(const char *filename, snd_info_t *info)
 
 		// Load
 		if( info )
-			rtn = codec->load(altName, info);
+			rtn = S_CodecLoadCached(codec, altName, info);
 		else
 			rtn = codec->open(altName);
 
@@ -25,6 +25,8 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 
 #define	GAME_API_VERSION	8
 
+#define	MAX_TRACE_BATCH		64		// traces in one G_TRACE_BATCH, a few of the engine's 16 ray batches
+
 // entity->svFlags
 // the server does not know how to interpret most of the values
 // in entityStates (level eType), so the game must explicitly flag
@@ -230,6 +232,10 @@ typedef enum {
 	// 1.32
 	G_FS_SEEK,
 
+	G_TRACE_BATCH,	// ( trace_t *results, int numTraces, const vec3_t *starts, const vec3_t *ends, const vec3_t mins, const vec3_t maxs, int passEntityNum, int contentmask );
+	// the same as numTraces G_TRACE calls that only differ in start and end,
+	// numTraces up to MAX_TRACE_BATCH
+
 	BOTLIB_SETUP = 200,				// ( void );
 	BOTLIB_SHUTDOWN,				// ( void );
 	BOTLIB_LIBVAR_SET,
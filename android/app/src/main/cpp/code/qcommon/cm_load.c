@@ -62,6 +62,8 @@ byte		*cmod_base;
 cvar_t		*cm_noAreas;
 cvar_t		*cm_noCurves;
 cvar_t		*cm_playerCurveClip;
+cvar_t		*cm_simdPlanes;
+cvar_t		*cm_debugSurfaceUpdate;
 #endif
 
 cmodel_t	box_model;
@@ -224,6 +226,64 @@ void CM_BoundBrush( cbrush_t *b ) {
 }
 
 
+#ifdef CM_SIMD_PLANES
+/*
+=================
+CMod_LoadSidePlanes
+
+Copies the side planes of the brushes into groups of four by component, so
+CM_TraceThroughBrush and CM_TestBoxInBrush can test four sides at once.
+The unused lanes of the last group get a plane nothing is ever in front of.
+Plain boxes are left to the scalar loops, which usually leave them after
+the first side or two and are no slower with only six planes.
+
+They are only used with cm_simdPlanes 1, which is off by default.  The
+grouped dot products round differently from the scalar loops under
+-ffast-math, so a few traces come out different.
+=================
+*/
+static void CMod_LoadSidePlanes( void ) {
+	cbrush_t	*b;
+	cplane_t	*plane;
+	float		*out, *g;
+	int			i, j, numPadded, total;
+
+	total = 0;
+	for ( i = 0, b = cm.brushes ; i < cm.numBrushes ; i++, b++ ) {
+		if ( b->numsides > 6 && b->numsides <= CM_MAX_SIMD_SIDES ) {
+			total += ( ( b->numsides + 3 ) & ~3 ) * 4;
+		}
+	}
+	if ( !total ) {
+		return;
+	}
+
+	out = Hunk_Alloc( total * sizeof( *out ), h_high );
+
+	for ( i = 0, b = cm.brushes ; i < cm.numBrushes ; i++, b++ ) {
+		if ( b->numsides <= 6 || b->numsides > CM_MAX_SIMD_SIDES ) {
+			continue;
+		}
+		numPadded = ( b->numsides + 3 ) & ~3;
+		b->sidePlanes = out;
+		for ( j = 0 ; j < numPadded ; j++ ) {
+			g = out + ( j >> 2 ) * 16 + ( j & 3 );
+			if ( j < b->numsides ) {
+				plane = b->sides[j].plane;
+				g[0] = plane->normal[0];
+				g[4] = plane->normal[1];
+				g[8] = plane->normal[2];
+				g[12] = plane->dist;
+			} else {
+				g[0] = g[4] = g[8] = 0;
+				g[12] = 1;
+			}
+		}
+		out += numPadded * 4;
+	}
+}
+#endif
+
 /*
 =================
 CMod_LoadBrushes
@@ -259,6 +319,9 @@ void CMod_LoadBrushes( lump_t *l ) {
 		CM_BoundBrush( out );
 	}
 
+#ifdef CM_SIMD_PLANES
+	CMod_LoadSidePlanes();
+#endif
 }
 
 /*
@@ -536,6 +599,48 @@ void CMod_LoadPatches( lump_t *surfs, lump_t *verts ) {
 	}
 }
 
+/*
+=================
+CMod_MarkShared
+
+Marks the brushes and patches that are in more than one leaf.  A trace
+reaches every leaf at most once, so only these need to be remembered to
+not test them twice.
+=================
+*/
+void CMod_MarkShared( void ) {
+	byte		*seen;
+	cLeaf_t		*leaf;
+	cPatch_t	*patch;
+	int			i, k, num;
+
+	seen = Hunk_AllocateTempMemory( cm.numBrushes + cm.numSurfaces + 1 );
+	Com_Memset( seen, 0, cm.numBrushes + cm.numSurfaces + 1 );
+
+	for ( i = 0, leaf = cm.leafs ; i < cm.numLeafs ; i++, leaf++ ) {
+		for ( k = 0 ; k < leaf->numLeafBrushes ; k++ ) {
+			num = cm.leafbrushes[ leaf->firstLeafBrush + k ];
+			if ( seen[num] ) {
+				cm.brushes[num].shared = qtrue;
+			}
+			seen[num] = 1;
+		}
+		for ( k = 0 ; k < leaf->numLeafSurfaces ; k++ ) {
+			num = cm.leafsurfaces[ leaf->firstLeafSurface + k ];
+			patch = cm.surfaces[num];
+			if ( !patch ) {
+				continue;
+			}
+			if ( seen[cm.numBrushes + num] ) {
+				patch->shared = qtrue;
+			}
+			seen[cm.numBrushes + num] = 1;
+		}
+	}
+
+	Hunk_FreeTempMemory( seen );
+}
+
 //==================================================================
 
 unsigned CM_LumpChecksum(lump_t *lump) {
@@ -584,6 +689,8 @@ void CM_LoadMap( const char *name, qboolean clientload, int *checksum ) {
 	cm_noAreas = Cvar_Get ("cm_noAreas", "0", CVAR_CHEAT);
 	cm_noCurves = Cvar_Get ("cm_noCurves", "0", CVAR_CHEAT);
 	cm_playerCurveClip = Cvar_Get ("cm_playerCurveClip", "1", CVAR_ARCHIVE|CVAR_CHEAT );
+	cm_simdPlanes = Cvar_Get ("cm_simdPlanes", "0", CVAR_CHEAT);
+	cm_debugSurfaceUpdate = Cvar_Get ("r_debugSurfaceUpdate", "1", 0);
 #endif
 	Com_DPrintf( "CM_LoadMap( %s, %i )\n", name, clientload );
 
@@ -650,6 +757,8 @@ void CM_LoadMap( const char *name, qboolean clientload, int *checksum ) {
 	// we are NOT freeing the file, because it is cached for the ref
 	FS_FreeFile (buf.v);
 
+	CMod_MarkShared ();
+
 	CM_InitBoxHull ();
 
 	CM_FloodAreaConnections ();
@@ -666,6 +775,9 @@ CM_ClearMap
 ==================
 */
 void CM_ClearMap( void ) {
+#ifdef USE_TESTS
+	CM_StopTraceLog();
+#endif
 	Com_Memset( &cm, 0, sizeof( cm ) );
 	CM_ClearLevelPatches();
 }
@@ -796,6 +908,9 @@ CM_TempBoxModel
 To keep everything totally uniform, bounding boxes are turned into small
 BSP trees instead of being compared directly.
 Capsules are handled differently though.
+
+There is only one box model, so unlike traces against the map and its
+inline models, this and the traces against it must stay on one thread.
 ===================
 */
 clipHandle_t CM_TempBoxModel( const vec3_t mins, const vec3_t maxs, int capsule ) {
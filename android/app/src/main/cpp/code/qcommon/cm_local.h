@@ -62,12 +62,13 @@ typedef struct {
 	vec3_t		bounds[2];
 	int			numsides;
 	cbrushside_t	*sides;
-	int			checkcount;		// to avoid repeated testings
+	qboolean	shared;			// in more than one leaf, so a trace can reach it twice
+	float		*sidePlanes;	// planes of the sides four at a time, see CMod_LoadSidePlanes
 } cbrush_t;
 
 
 typedef struct {
-	int			checkcount;				// to avoid repeated testings
+	qboolean	shared;					// in more than one leaf
 	int			surfaceFlags;
 	int			contents;
 	struct patchCollide_s	*pc;
@@ -125,7 +126,6 @@ typedef struct {
 	cPatch_t	**surfaces;			// non-patches will be NULL
 
 	int			floodvalid;
-	int			checkcount;					// incremented on each trace
 } clipMap_t;
 
 
@@ -139,6 +139,16 @@ extern	int			c_traces, c_brush_traces, c_patch_traces;
 extern	cvar_t		*cm_noAreas;
 extern	cvar_t		*cm_noCurves;
 extern	cvar_t		*cm_playerCurveClip;
+extern	cvar_t		*cm_simdPlanes;
+extern	cvar_t		*cm_debugSurfaceUpdate;
+
+#ifdef USE_TESTS
+// cm_trace_test.c
+extern	fileHandle_t	cm_traceLog;
+
+void CM_LogTrace( const trace_t *results, const vec3_t start, const vec3_t end, const vec3_t mins, const vec3_t maxs,
+				  clipHandle_t model, int brushmask, const vec3_t origin, const vec3_t angles, int capsule );
+#endif
 
 // cm_test.c
 
@@ -151,6 +161,19 @@ typedef struct
 	vec3_t		offset;
 } sphere_t;
 
+// the shared brushes and patches a trace already tested, so that they are only
+// tested once.  This is kept by the trace instead of in the brushes, so that
+// any number of traces can run on different threads at the same time.
+#define	CM_CHECK_BITS	7
+#define	CM_CHECK_SLOTS	( 1 << CM_CHECK_BITS )
+
+typedef struct {
+	int			numChecked;
+	unsigned	used[CM_CHECK_SLOTS / 32];
+	int			items[CM_CHECK_SLOTS];	// brush number, or -1 - surface number for patches
+	unsigned	rays[CM_CHECK_SLOTS];	// rays of a batched trace that tested it
+} checkSet_t;
+
 typedef struct {
 	vec3_t		start;
 	vec3_t		end;
@@ -164,8 +187,18 @@ typedef struct {
 	qboolean	isPoint;	// optimized case
 	trace_t		trace;		// returned from trace call
 	sphere_t	sphere;		// sphere for oriendted capsule collision
+	checkSet_t	*checked;	// shared brushes and patches already tested
 } traceWork_t;
 
+// brush sides are also kept as groups of four planes by component, nx[4] ny[4]
+// nz[4] dist[4], so that a trace can be tested against four of them at once
+#if idx64 || defined( __aarch64__ )
+#define	CM_SIMD_PLANES
+#endif
+#define	CM_MAX_SIMD_SIDES	64	// brushes with more sides, or only six, just use the plane pointers
+
+#define	CM_BATCH_RAYS	16	// rays carried down the tree together by CM_BoxTraceBatch
+
 typedef struct leafList_s {
 	int		count;
 	int		maxcount;
@@ -41,6 +41,11 @@ int			CM_TransformedPointContents( const vec3_t p, clipHandle_t model, const vec
 void		CM_BoxTrace ( trace_t *results, const vec3_t start, const vec3_t end,
 						  vec3_t mins, vec3_t maxs,
 						  clipHandle_t model, int brushmask, int capsule );
+void		CM_BoxTraceBatch( trace_t *results, int numTraces, const vec3_t *starts, const vec3_t *ends,
+						  vec3_t mins, vec3_t maxs,
+						  clipHandle_t model, int brushmask, int capsule );
+// same as numTraces CM_BoxTrace calls that share the box and mask, but the
+// rays walk the tree together
 void		CM_TransformedBoxTrace( trace_t *results, const vec3_t start, const vec3_t end,
 						  vec3_t mins, vec3_t maxs,
 						  clipHandle_t model, int brushmask,
@@ -63,5 +68,13 @@ qboolean	CM_AreasConnected( int area1, int area2 );
 
 int			CM_WriteAreaBits( byte *buffer, int area );
 
+#ifdef USE_TESTS
+// cm_trace_test.c
+void CM_TraceTest_f( void );
+void CM_TraceLog_f( void );
+void CM_TraceStress_f( void );
+void CM_StopTraceLog( void );
+#endif
+
 // cm_patch.c
 void CM_DrawDebugSurface( void (*drawPoly)(int color, int numPoints, float *points) );
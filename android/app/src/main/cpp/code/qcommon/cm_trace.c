@@ -21,6 +21,12 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 */
 #include "cm_local.h"
 
+#if idx64
+#include <xmmintrin.h>
+#elif defined( __aarch64__ )
+#include <arm_neon.h>
+#endif
+
 // always use bbox vs. bbox collision and never capsule vs. bbox or vice versa
 //#define ALWAYS_BBOX_VS_BBOX
 // always use capsule vs. capsule collision and never capsule vs. bbox or vice versa
@@ -145,6 +151,47 @@ float SquareRootFloat(float number) {
 }
 
 
+/*
+================
+CM_ClearCheckSet
+================
+*/
+static void CM_ClearCheckSet( checkSet_t *cs ) {
+	cs->numChecked = 0;
+	Com_Memset( cs->used, 0, sizeof( cs->used ) );
+}
+
+/*
+================
+CM_CheckedRays
+
+Returns the rays that already tested the brush or patch, and adds rays to
+them.  A single trace is ray 1.  Once the set is too full to take another
+one, it is not remembered and will just be tested again.
+================
+*/
+static unsigned CM_CheckedRays( checkSet_t *cs, int item, unsigned rays ) {
+	unsigned	i, checked;
+
+	i = ( (unsigned)item * 2654435761u ) >> ( 32 - CM_CHECK_BITS );
+	while ( cs->used[i >> 5] & ( 1u << ( i & 31 ) ) ) {
+		if ( cs->items[i] == item ) {
+			checked = cs->rays[i];
+			cs->rays[i] |= rays;
+			return checked;
+		}
+		i = ( i + 1 ) & ( CM_CHECK_SLOTS - 1 );
+	}
+
+	if ( cs->numChecked < CM_CHECK_SLOTS * 3 / 4 ) {
+		cs->numChecked++;
+		cs->used[i >> 5] |= 1u << ( i & 31 );
+		cs->items[i] = item;
+		cs->rays[i] = rays;
+	}
+	return 0;
+}
+
 /*
 ===============================================================================
 
@@ -153,6 +200,161 @@ POSITION TESTING
 ===============================================================================
 */
 
+#ifdef CM_SIMD_PLANES
+/*
+================
+CM_SidePlaneDistances
+
+Fills d1s (and d2s for a trace, when it is not NULL) with the distances
+from the trace start and end to the sides of the brush, from side first on,
+with the plane moved out for the box or capsule just like the scalar loops.
+Four sides are done at once from brush->sidePlanes.
+
+Returns qfalse if the trace is completely in front of one of the sides,
+so it can not touch the brush at all.
+================
+*/
+static qboolean CM_SidePlaneDistances( const traceWork_t *tw, const cbrush_t *brush, int first,
+									   float *d1s, float *d2s ) {
+	const float	*g;
+	int			i, numGroups;
+	unsigned	out, skip;
+#if idx64
+	__m128		zero, eps, nx, ny, nz, dist, m, d1, d2;
+	__m128		s[3], e[3], lo[3], hi[3];
+
+	zero = _mm_setzero_ps();
+	eps = _mm_set1_ps( SURFACE_CLIP_EPSILON );
+	for ( i = 0 ; i < 3 ; i++ ) {
+		if ( tw->sphere.use ) {
+			// start and end moved to the bottom and to the top of the capsule
+			s[i] = _mm_set1_ps( tw->start[i] - tw->sphere.offset[i] );
+			e[i] = _mm_set1_ps( tw->end[i] - tw->sphere.offset[i] );
+			lo[i] = _mm_set1_ps( tw->start[i] + tw->sphere.offset[i] );
+			hi[i] = _mm_set1_ps( tw->end[i] + tw->sphere.offset[i] );
+		} else {
+			s[i] = _mm_set1_ps( tw->start[i] );
+			e[i] = _mm_set1_ps( tw->end[i] );
+			lo[i] = _mm_set1_ps( tw->size[0][i] );
+			hi[i] = _mm_set1_ps( tw->size[1][i] );
+		}
+	}
+
+	numGroups = ( brush->numsides + 3 ) >> 2;
+	skip = ( 1u << ( first & 3 ) ) - 1;
+	for ( i = first >> 2 ; i < numGroups ; i++, skip = 0 ) {
+		g = brush->sidePlanes + i * 16;
+		nx = _mm_loadu_ps( g );
+		ny = _mm_loadu_ps( g + 4 );
+		nz = _mm_loadu_ps( g + 8 );
+
+		if ( tw->sphere.use ) {
+			// find the closest point on the capsule to the plane
+			dist = _mm_add_ps( _mm_loadu_ps( g + 12 ), _mm_set1_ps( tw->sphere.radius ) );
+			m = _mm_add_ps( _mm_mul_ps( nx, _mm_set1_ps( tw->sphere.offset[0] ) ), _mm_mul_ps( ny, _mm_set1_ps( tw->sphere.offset[1] ) ) );
+			m = _mm_cmpgt_ps( _mm_add_ps( m, _mm_mul_ps( nz, _mm_set1_ps( tw->sphere.offset[2] ) ) ), zero );
+			d1 = _mm_add_ps( _mm_mul_ps( _mm_or_ps( _mm_and_ps( m, s[0] ), _mm_andnot_ps( m, lo[0] ) ), nx ),
+				_mm_mul_ps( _mm_or_ps( _mm_and_ps( m, s[1] ), _mm_andnot_ps( m, lo[1] ) ), ny ) );
+			d1 = _mm_add_ps( d1, _mm_mul_ps( _mm_or_ps( _mm_and_ps( m, s[2] ), _mm_andnot_ps( m, lo[2] ) ), nz ) );
+			d2 = _mm_add_ps( _mm_mul_ps( _mm_or_ps( _mm_and_ps( m, e[0] ), _mm_andnot_ps( m, hi[0] ) ), nx ),
+				_mm_mul_ps( _mm_or_ps( _mm_and_ps( m, e[1] ), _mm_andnot_ps( m, hi[1] ) ), ny ) );
+			d2 = _mm_add_ps( d2, _mm_mul_ps( _mm_or_ps( _mm_and_ps( m, e[2] ), _mm_andnot_ps( m, hi[2] ) ), nz ) );
+		} else {
+			// adjust the plane distance for the corner of the box closest to it
+			m = _mm_cmplt_ps( nx, zero );
+			dist = _mm_mul_ps( _mm_or_ps( _mm_and_ps( m, hi[0] ), _mm_andnot_ps( m, lo[0] ) ), nx );
+			m = _mm_cmplt_ps( ny, zero );
+			dist = _mm_add_ps( dist, _mm_mul_ps( _mm_or_ps( _mm_and_ps( m, hi[1] ), _mm_andnot_ps( m, lo[1] ) ), ny ) );
+			m = _mm_cmplt_ps( nz, zero );
+			dist = _mm_add_ps( dist, _mm_mul_ps( _mm_or_ps( _mm_and_ps( m, hi[2] ), _mm_andnot_ps( m, lo[2] ) ), nz ) );
+			dist = _mm_sub_ps( _mm_loadu_ps( g + 12 ), dist );
+			d1 = _mm_add_ps( _mm_add_ps( _mm_mul_ps( s[0], nx ), _mm_mul_ps( s[1], ny ) ), _mm_mul_ps( s[2], nz ) );
+			d2 = _mm_add_ps( _mm_add_ps( _mm_mul_ps( e[0], nx ), _mm_mul_ps( e[1], ny ) ), _mm_mul_ps( e[2], nz ) );
+		}
+		d1 = _mm_sub_ps( d1, dist );
+		_mm_storeu_ps( d1s + i * 4, d1 );
+
+		// if completely in front of a face, no intersection with the entire brush
+		m = _mm_cmpgt_ps( d1, zero );
+		if ( d2s ) {
+			d2 = _mm_sub_ps( d2, dist );
+			_mm_storeu_ps( d2s + i * 4, d2 );
+			m = _mm_and_ps( m, _mm_or_ps( _mm_cmpge_ps( d2, eps ), _mm_cmpge_ps( d2, d1 ) ) );
+		}
+		out = _mm_movemask_ps( m ) & ~skip;
+		if ( out ) {
+			return qfalse;
+		}
+	}
+#else
+	static const uint32_t	laneBits[4] = { 1, 2, 4, 8 };
+	float32x4_t	eps, nx, ny, nz, dist, d1, d2;
+	float32x4_t	s[3], e[3], lo[3], hi[3];
+	uint32x4_t	m;
+
+	eps = vdupq_n_f32( SURFACE_CLIP_EPSILON );
+	for ( i = 0 ; i < 3 ; i++ ) {
+		if ( tw->sphere.use ) {
+			// start and end moved to the bottom and to the top of the capsule
+			s[i] = vdupq_n_f32( tw->start[i] - tw->sphere.offset[i] );
+			e[i] = vdupq_n_f32( tw->end[i] - tw->sphere.offset[i] );
+			lo[i] = vdupq_n_f32( tw->start[i] + tw->sphere.offset[i] );
+			hi[i] = vdupq_n_f32( tw->end[i] + tw->sphere.offset[i] );
+		} else {
+			s[i] = vdupq_n_f32( tw->start[i] );
+			e[i] = vdupq_n_f32( tw->end[i] );
+			lo[i] = vdupq_n_f32( tw->size[0][i] );
+			hi[i] = vdupq_n_f32( tw->size[1][i] );
+		}
+	}
+
+	// no fused multiply-add, so the lanes round like the scalar code
+	numGroups = ( brush->numsides + 3 ) >> 2;
+	skip = ( 1u << ( first & 3 ) ) - 1;
+	for ( i = first >> 2 ; i < numGroups ; i++, skip = 0 ) {
+		g = brush->sidePlanes + i * 16;
+		nx = vld1q_f32( g );
+		ny = vld1q_f32( g + 4 );
+		nz = vld1q_f32( g + 8 );
+
+		if ( tw->sphere.use ) {
+			// find the closest point on the capsule to the plane
+			dist = vaddq_f32( vld1q_f32( g + 12 ), vdupq_n_f32( tw->sphere.radius ) );
+			d1 = vaddq_f32( vmulq_n_f32( nx, tw->sphere.offset[0] ), vmulq_n_f32( ny, tw->sphere.offset[1] ) );
+			m = vcgtzq_f32( vaddq_f32( d1, vmulq_n_f32( nz, tw->sphere.offset[2] ) ) );
+			d1 = vaddq_f32( vmulq_f32( vbslq_f32( m, s[0], lo[0] ), nx ), vmulq_f32( vbslq_f32( m, s[1], lo[1] ), ny ) );
+			d1 = vaddq_f32( d1, vmulq_f32( vbslq_f32( m, s[2], lo[2] ), nz ) );
+			d2 = vaddq_f32( vmulq_f32( vbslq_f32( m, e[0], hi[0] ), nx ), vmulq_f32( vbslq_f32( m, e[1], hi[1] ), ny ) );
+			d2 = vaddq_f32( d2, vmulq_f32( vbslq_f32( m, e[2], hi[2] ), nz ) );
+		} else {
+			// adjust the plane distance for the corner of the box closest to it
+			dist = vmulq_f32( vbslq_f32( vcltzq_f32( nx ), hi[0], lo[0] ), nx );
+			dist = vaddq_f32( dist, vmulq_f32( vbslq_f32( vcltzq_f32( ny ), hi[1], lo[1] ), ny ) );
+			dist = vaddq_f32( dist, vmulq_f32( vbslq_f32( vcltzq_f32( nz ), hi[2], lo[2] ), nz ) );
+			dist = vsubq_f32( vld1q_f32( g + 12 ), dist );
+			d1 = vaddq_f32( vaddq_f32( vmulq_f32( s[0], nx ), vmulq_f32( s[1], ny ) ), vmulq_f32( s[2], nz ) );
+			d2 = vaddq_f32( vaddq_f32( vmulq_f32( e[0], nx ), vmulq_f32( e[1], ny ) ), vmulq_f32( e[2], nz ) );
+		}
+		d1 = vsubq_f32( d1, dist );
+		vst1q_f32( d1s + i * 4, d1 );
+
+		// if completely in front of a face, no intersection with the entire brush
+		m = vcgtzq_f32( d1 );
+		if ( d2s ) {
+			d2 = vsubq_f32( d2, dist );
+			vst1q_f32( d2s + i * 4, d2 );
+			m = vandq_u32( m, vorrq_u32( vcgeq_f32( d2, eps ), vcgeq_f32( d2, d1 ) ) );
+		}
+		out = vaddvq_u32( vandq_u32( m, vld1q_u32( laneBits ) ) ) & ~skip;
+		if ( out ) {
+			return qfalse;
+		}
+	}
+#endif
+	return qtrue;
+}
+#endif
+
 /*
 ================
 CM_TestBoxInBrush
@@ -182,6 +384,17 @@ void CM_TestBoxInBrush( traceWork_t *tw, cbrush_t *brush ) {
 		return;
 	}
 
+#ifdef CM_SIMD_PLANES
+	if ( brush->sidePlanes && cm_simdPlanes->integer ) {
+		float	d1s[CM_MAX_SIMD_SIDES];
+
+		// the first six planes are the axial planes, so we only
+		// need to test the remainder
+		if ( !CM_SidePlaneDistances( tw, brush, 6, d1s, NULL ) ) {
+			return;
+		}
+	} else
+#endif
    if ( tw->sphere.use ) {
 		// the first six planes are the axial planes, so we only
 		// need to test the remainder
@@ -249,10 +462,9 @@ void CM_TestInLeaf( traceWork_t *tw, cLeaf_t *leaf ) {
 	for (k=0 ; k<leaf->numLeafBrushes ; k++) {
 		brushnum = cm.leafbrushes[leaf->firstLeafBrush+k];
 		b = &cm.brushes[brushnum];
-		if (b->checkcount == cm.checkcount) {
+		if ( b->shared && CM_CheckedRays( tw->checked, brushnum, 1 ) ) {
 			continue;	// already checked this brush in another leaf
 		}
-		b->checkcount = cm.checkcount;
 
 		if ( !(b->contents & tw->contents)) {
 			continue;
@@ -275,10 +487,9 @@ void CM_TestInLeaf( traceWork_t *tw, cLeaf_t *leaf ) {
 			if ( !patch ) {
 				continue;
 			}
-			if ( patch->checkcount == cm.checkcount ) {
-				continue;	// already checked this brush in another leaf
+			if ( patch->shared && CM_CheckedRays( tw->checked, -1 - cm.leafsurfaces[ leaf->firstLeafSurface + k ], 1 ) ) {
+				continue;	// already checked this patch in another leaf
 			}
-			patch->checkcount = cm.checkcount;
 
 			if ( !(patch->contents & tw->contents)) {
 				continue;
@@ -428,13 +639,8 @@ void CM_PositionTest( traceWork_t *tw ) {
 	ll.lastLeaf = 0;
 	ll.overflowed = qfalse;
 
-	cm.checkcount++;
-
 	CM_BoxLeafnums_r( &ll, 0 );
 
-
-	cm.checkcount++;
-
 	// test the contents of the leafs
 	for (i=0 ; i < ll.count ; i++) {
 		CM_TestInLeaf( tw, &cm.leafs[leafs[i]] );
@@ -507,6 +713,58 @@ void CM_TraceThroughBrush( traceWork_t *tw, cbrush_t *brush ) {
 
 	leadside = NULL;
 
+#ifdef CM_SIMD_PLANES
+	if ( brush->sidePlanes && cm_simdPlanes->integer ) {
+		float	d1s[CM_MAX_SIMD_SIDES], d2s[CM_MAX_SIMD_SIDES];
+
+		// if completely in front of any face, no intersection with the entire brush
+		if ( !CM_SidePlaneDistances( tw, brush, 0, d1s, d2s ) ) {
+			return;
+		}
+
+		//
+		// find the latest time the trace crosses a plane towards the interior
+		// and the earliest time the trace crosses a plane towards the exterior
+		//
+		for (i = 0; i < brush->numsides; i++) {
+			d1 = d1s[i];
+			d2 = d2s[i];
+
+			if (d2 > 0) {
+				getout = qtrue;	// endpoint is not in solid
+			}
+			if (d1 > 0) {
+				startout = qtrue;
+			}
+
+			// if it doesn't cross the plane, the plane isn't relevant
+			if (d1 <= 0 && d2 <= 0 ) {
+				continue;
+			}
+
+			// crosses face
+			if (d1 > d2) {	// enter
+				f = (d1-SURFACE_CLIP_EPSILON) / (d1-d2);
+				if ( f < 0 ) {
+					f = 0;
+				}
+				if (f > enterFrac) {
+					enterFrac = f;
+					leadside = brush->sides + i;
+					clipplane = leadside->plane;
+				}
+			} else {	// leave
+				f = (d1+SURFACE_CLIP_EPSILON) / (d1-d2);
+				if ( f > 1 ) {
+					f = 1;
+				}
+				if (f < leaveFrac) {
+					leaveFrac = f;
+				}
+			}
+		}
+	} else
+#endif
 	if ( tw->sphere.use ) {
 		//
 		// compare the trace against all planes of the brush
@@ -677,10 +935,9 @@ void CM_TraceThroughLeaf( traceWork_t *tw, cLeaf_t *leaf ) {
 		brushnum = cm.leafbrushes[leaf->firstLeafBrush+k];
 
 		b = &cm.brushes[brushnum];
-		if ( b->checkcount == cm.checkcount ) {
+		if ( b->shared && CM_CheckedRays( tw->checked, brushnum, 1 ) ) {
 			continue;	// already checked this brush in another leaf
 		}
-		b->checkcount = cm.checkcount;
 
 		if ( !(b->contents & tw->contents) ) {
 			continue;
@@ -708,10 +965,9 @@ void CM_TraceThroughLeaf( traceWork_t *tw, cLeaf_t *leaf ) {
 			if ( !patch ) {
 				continue;
 			}
-			if ( patch->checkcount == cm.checkcount ) {
+			if ( patch->shared && CM_CheckedRays( tw->checked, -1 - cm.leafsurfaces[ leaf->firstLeafSurface + k ], 1 ) ) {
 				continue;	// already checked this patch in another leaf
 			}
-			patch->checkcount = cm.checkcount;
 
 			if ( !(patch->contents & tw->contents) ) {
 				continue;
@@ -1142,126 +1398,193 @@ void CM_TraceThroughTree( traceWork_t *tw, int num, float p1f, float p2f, vec3_t
 
 /*
 ==================
-CM_Trace
+CM_InitTraceWork
+
+Fills in everything a sweep needs apart from the result
 ==================
 */
-void CM_Trace( trace_t *results, const vec3_t start, const vec3_t end, vec3_t mins, vec3_t maxs,
-						  clipHandle_t model, const vec3_t origin, int brushmask, int capsule, sphere_t *sphere ) {
+static void CM_InitTraceWork( traceWork_t *tw, const vec3_t start, const vec3_t end, const vec3_t mins, const vec3_t maxs,
+						  const vec3_t origin, int brushmask, int capsule, const sphere_t *sphere ) {
 	int			i;
-	traceWork_t	tw;
 	vec3_t		offset;
-	cmodel_t	*cmod;
-
-	cmod = CM_ClipHandleToModel( model );
-
-	cm.checkcount++;		// for multi-check avoidance
-
-	c_traces++;				// for statistics, may be zeroed
 
 	// fill in a default trace
-	Com_Memset( &tw, 0, sizeof(tw) );
-	tw.trace.fraction = 1;	// assume it goes the entire distance until shown otherwise
-	VectorCopy(origin, tw.modelOrigin);
-
-	if (!cm.numNodes) {
-		*results = tw.trace;
-
-		return;	// map not loaded, shouldn't happen
-	}
-
-	// allow NULL to be passed in for 0,0,0
-	if ( !mins ) {
-		mins = vec3_origin;
-	}
-	if ( !maxs ) {
-		maxs = vec3_origin;
-	}
+	Com_Memset( tw, 0, sizeof(*tw) );
+	tw->trace.fraction = 1;	// assume it goes the entire distance until shown otherwise
+	VectorCopy(origin, tw->modelOrigin);
 
 	// set basic parms
-	tw.contents = brushmask;
+	tw->contents = brushmask;
 
 	// adjust so that mins and maxs are always symetric, which
 	// avoids some complications with plane expanding of rotated
 	// bmodels
 	for ( i = 0 ; i < 3 ; i++ ) {
 		offset[i] = ( mins[i] + maxs[i] ) * 0.5;
-		tw.size[0][i] = mins[i] - offset[i];
-		tw.size[1][i] = maxs[i] - offset[i];
-		tw.start[i] = start[i] + offset[i];
-		tw.end[i] = end[i] + offset[i];
+		tw->size[0][i] = mins[i] - offset[i];
+		tw->size[1][i] = maxs[i] - offset[i];
+		tw->start[i] = start[i] + offset[i];
+		tw->end[i] = end[i] + offset[i];
 	}
 
 	// if a sphere is already specified
 	if ( sphere ) {
-		tw.sphere = *sphere;
+		tw->sphere = *sphere;
 	}
 	else {
-		tw.sphere.use = capsule;
-		tw.sphere.radius = ( tw.size[1][0] > tw.size[1][2] ) ? tw.size[1][2]: tw.size[1][0];
-		tw.sphere.halfheight = tw.size[1][2];
-		VectorSet( tw.sphere.offset, 0, 0, tw.size[1][2] - tw.sphere.radius );
+		tw->sphere.use = capsule;
+		tw->sphere.radius = ( tw->size[1][0] > tw->size[1][2] ) ? tw->size[1][2]: tw->size[1][0];
+		tw->sphere.halfheight = tw->size[1][2];
+		VectorSet( tw->sphere.offset, 0, 0, tw->size[1][2] - tw->sphere.radius );
 	}
 
-	tw.maxOffset = tw.size[1][0] + tw.size[1][1] + tw.size[1][2];
+	tw->maxOffset = tw->size[1][0] + tw->size[1][1] + tw->size[1][2];
 
-	// tw.offsets[signbits] = vector to appropriate corner from origin
-	tw.offsets[0][0] = tw.size[0][0];
-	tw.offsets[0][1] = tw.size[0][1];
-	tw.offsets[0][2] = tw.size[0][2];
+	// tw->offsets[signbits] = vector to appropriate corner from origin
+	tw->offsets[0][0] = tw->size[0][0];
+	tw->offsets[0][1] = tw->size[0][1];
+	tw->offsets[0][2] = tw->size[0][2];
 
-	tw.offsets[1][0] = tw.size[1][0];
-	tw.offsets[1][1] = tw.size[0][1];
-	tw.offsets[1][2] = tw.size[0][2];
+	tw->offsets[1][0] = tw->size[1][0];
+	tw->offsets[1][1] = tw->size[0][1];
+	tw->offsets[1][2] = tw->size[0][2];
 
-	tw.offsets[2][0] = tw.size[0][0];
-	tw.offsets[2][1] = tw.size[1][1];
-	tw.offsets[2][2] = tw.size[0][2];
+	tw->offsets[2][0] = tw->size[0][0];
+	tw->offsets[2][1] = tw->size[1][1];
+	tw->offsets[2][2] = tw->size[0][2];
 
-	tw.offsets[3][0] = tw.size[1][0];
-	tw.offsets[3][1] = tw.size[1][1];
-	tw.offsets[3][2] = tw.size[0][2];
+	tw->offsets[3][0] = tw->size[1][0];
+	tw->offsets[3][1] = tw->size[1][1];
+	tw->offsets[3][2] = tw->size[0][2];
 
-	tw.offsets[4][0] = tw.size[0][0];
-	tw.offsets[4][1] = tw.size[0][1];
-	tw.offsets[4][2] = tw.size[1][2];
+	tw->offsets[4][0] = tw->size[0][0];
+	tw->offsets[4][1] = tw->size[0][1];
+	tw->offsets[4][2] = tw->size[1][2];
 
-	tw.offsets[5][0] = tw.size[1][0];
-	tw.offsets[5][1] = tw.size[0][1];
-	tw.offsets[5][2] = tw.size[1][2];
+	tw->offsets[5][0] = tw->size[1][0];
+	tw->offsets[5][1] = tw->size[0][1];
+	tw->offsets[5][2] = tw->size[1][2];
 
-	tw.offsets[6][0] = tw.size[0][0];
-	tw.offsets[6][1] = tw.size[1][1];
-	tw.offsets[6][2] = tw.size[1][2];
+	tw->offsets[6][0] = tw->size[0][0];
+	tw->offsets[6][1] = tw->size[1][1];
+	tw->offsets[6][2] = tw->size[1][2];
 
-	tw.offsets[7][0] = tw.size[1][0];
-	tw.offsets[7][1] = tw.size[1][1];
-	tw.offsets[7][2] = tw.size[1][2];
+	tw->offsets[7][0] = tw->size[1][0];
+	tw->offsets[7][1] = tw->size[1][1];
+	tw->offsets[7][2] = tw->size[1][2];
 
 	//
 	// calculate bounds
 	//
-	if ( tw.sphere.use ) {
+	if ( tw->sphere.use ) {
 		for ( i = 0 ; i < 3 ; i++ ) {
-			if ( tw.start[i] < tw.end[i] ) {
-				tw.bounds[0][i] = tw.start[i] - fabs(tw.sphere.offset[i]) - tw.sphere.radius;
-				tw.bounds[1][i] = tw.end[i] + fabs(tw.sphere.offset[i]) + tw.sphere.radius;
+			if ( tw->start[i] < tw->end[i] ) {
+				tw->bounds[0][i] = tw->start[i] - fabs(tw->sphere.offset[i]) - tw->sphere.radius;
+				tw->bounds[1][i] = tw->end[i] + fabs(tw->sphere.offset[i]) + tw->sphere.radius;
 			} else {
-				tw.bounds[0][i] = tw.end[i] - fabs(tw.sphere.offset[i]) - tw.sphere.radius;
-				tw.bounds[1][i] = tw.start[i] + fabs(tw.sphere.offset[i]) + tw.sphere.radius;
+				tw->bounds[0][i] = tw->end[i] - fabs(tw->sphere.offset[i]) - tw->sphere.radius;
+				tw->bounds[1][i] = tw->start[i] + fabs(tw->sphere.offset[i]) + tw->sphere.radius;
 			}
 		}
 	}
 	else {
 		for ( i = 0 ; i < 3 ; i++ ) {
-			if ( tw.start[i] < tw.end[i] ) {
-				tw.bounds[0][i] = tw.start[i] + tw.size[0][i];
-				tw.bounds[1][i] = tw.end[i] + tw.size[1][i];
+			if ( tw->start[i] < tw->end[i] ) {
+				tw->bounds[0][i] = tw->start[i] + tw->size[0][i];
+				tw->bounds[1][i] = tw->end[i] + tw->size[1][i];
 			} else {
-				tw.bounds[0][i] = tw.end[i] + tw.size[0][i];
-				tw.bounds[1][i] = tw.start[i] + tw.size[1][i];
+				tw->bounds[0][i] = tw->end[i] + tw->size[0][i];
+				tw->bounds[1][i] = tw->start[i] + tw->size[1][i];
 			}
 		}
 	}
+}
+
+/*
+==================
+CM_InitSweep
+
+Position tests leave isPoint unset, only sweeps use it
+==================
+*/
+static void CM_InitSweep( traceWork_t *tw ) {
+	//
+	// check for point special case
+	//
+	if ( tw->size[0][0] == 0 && tw->size[0][1] == 0 && tw->size[0][2] == 0 ) {
+		tw->isPoint = qtrue;
+		VectorClear( tw->extents );
+	} else {
+		tw->isPoint = qfalse;
+		tw->extents[0] = tw->size[1][0];
+		tw->extents[1] = tw->size[1][1];
+		tw->extents[2] = tw->size[1][2];
+	}
+}
+
+/*
+==================
+CM_FinishTrace
+==================
+*/
+static void CM_FinishTrace( traceWork_t *tw, trace_t *results, const vec3_t start, const vec3_t end ) {
+	int			i;
+
+	// generate endpos from the original, unmodified start/end
+	if ( tw->trace.fraction == 1 ) {
+		VectorCopy (end, tw->trace.endpos);
+	} else {
+		for ( i=0 ; i<3 ; i++ ) {
+			tw->trace.endpos[i] = start[i] + tw->trace.fraction * (end[i] - start[i]);
+		}
+	}
+
+        // If allsolid is set (was entirely inside something solid), the plane is not valid.
+        // If fraction == 1.0, we never hit anything, and thus the plane is not valid.
+        // Otherwise, the normal on the plane should have unit length
+        assert(tw->trace.allsolid ||
+               tw->trace.fraction == 1.0 ||
+               VectorLengthSquared(tw->trace.plane.normal) > 0.9999);
+	*results = tw->trace;
+}
+
+/*
+==================
+CM_Trace
+==================
+*/
+void CM_Trace( trace_t *results, const vec3_t start, const vec3_t end, vec3_t mins, vec3_t maxs,
+						  clipHandle_t model, const vec3_t origin, int brushmask, int capsule, sphere_t *sphere ) {
+	traceWork_t	tw;
+	checkSet_t	checked;
+	cmodel_t	*cmod;
+
+	cmod = CM_ClipHandleToModel( model );
+
+	c_traces++;				// for statistics, may be zeroed
+
+	if (!cm.numNodes) {
+		// fill in a default trace
+		Com_Memset( &tw, 0, sizeof(tw) );
+		tw.trace.fraction = 1;
+		*results = tw.trace;
+
+		return;	// map not loaded, shouldn't happen
+	}
+
+	// allow NULL to be passed in for 0,0,0
+	if ( !mins ) {
+		mins = vec3_origin;
+	}
+	if ( !maxs ) {
+		maxs = vec3_origin;
+	}
+
+	CM_InitTraceWork( &tw, start, end, mins, maxs, origin, brushmask, capsule, sphere );
+
+	// for multi-check avoidance
+	CM_ClearCheckSet( &checked );
+	tw.checked = &checked;
 
 	//
 	// check for position test special case
@@ -1295,18 +1618,7 @@ void CM_Trace( trace_t *results, const vec3_t start, const vec3_t end, vec3_t mi
 			CM_PositionTest( &tw );
 		}
 	} else {
-		//
-		// check for point special case
-		//
-		if ( tw.size[0][0] == 0 && tw.size[0][1] == 0 && tw.size[0][2] == 0 ) {
-			tw.isPoint = qtrue;
-			VectorClear( tw.extents );
-		} else {
-			tw.isPoint = qfalse;
-			tw.extents[0] = tw.size[1][0];
-			tw.extents[1] = tw.size[1][1];
-			tw.extents[2] = tw.size[1][2];
-		}
+		CM_InitSweep( &tw );
 
 		//
 		// general sweeping through world
@@ -1340,22 +1652,7 @@ void CM_Trace( trace_t *results, const vec3_t start, const vec3_t end, vec3_t mi
 		}
 	}
 
-	// generate endpos from the original, unmodified start/end
-	if ( tw.trace.fraction == 1 ) {
-		VectorCopy (end, tw.trace.endpos);
-	} else {
-		for ( i=0 ; i<3 ; i++ ) {
-			tw.trace.endpos[i] = start[i] + tw.trace.fraction * (end[i] - start[i]);
-		}
-	}
-
-        // If allsolid is set (was entirely inside something solid), the plane is not valid.
-        // If fraction == 1.0, we never hit anything, and thus the plane is not valid.
-        // Otherwise, the normal on the plane should have unit length
-        assert(tw.trace.allsolid ||
-               tw.trace.fraction == 1.0 ||
-               VectorLengthSquared(tw.trace.plane.normal) > 0.9999);
-	*results = tw.trace;
+	CM_FinishTrace( &tw, results, start, end );
 }
 
 /*
@@ -1367,6 +1664,12 @@ void CM_BoxTrace( trace_t *results, const vec3_t start, const vec3_t end,
 						  vec3_t mins, vec3_t maxs,
 						  clipHandle_t model, int brushmask, int capsule ) {
 	CM_Trace( results, start, end, mins, maxs, model, vec3_origin, brushmask, capsule, NULL );
+
+#ifdef USE_TESTS
+	if ( cm_traceLog ) {
+		CM_LogTrace( results, start, end, mins, maxs, model, brushmask, NULL, NULL, capsule );
+	}
+#endif
 }
 
 /*
@@ -1467,4 +1770,904 @@ void CM_TransformedBoxTrace( trace_t *results, const vec3_t start, const vec3_t
 	trace.endpos[2] = start[2] + trace.fraction * (end[2] - start[2]);
 
 	*results = trace;
+
+#ifdef USE_TESTS
+	if ( cm_traceLog ) {
+		CM_LogTrace( results, start, end, mins, maxs, model, brushmask, origin, angles, capsule );
+	}
+#endif
+}
+
+/*
+===============================================================================
+
+BATCHED TRACES
+
+CM_BoxTraceBatch sweeps up to CM_BATCH_RAYS rays with the same box through the
+world tree together.  At every node the rays are split into the ones that
+visit the front child first and the ones that visit the back child first, so
+each ray still sees exactly the leafs and brushes CM_TraceThroughTree would
+show it, in the same order, and the results match separate traces.  What is
+shared is the walk itself and the plane loads: the plane distances of all the
+rays at a node or brush side, and the bounds tests against a brush, are done
+four rays at a time.  A ray that ends up on its own in a node goes down the
+rest of the tree like a single trace.
+
+The check set of the batch remembers which rays already tested a shared brush
+or patch, instead of just whether it was tested.
+
+===============================================================================
+*/
+
+typedef struct {
+	traceWork_t	tw[CM_BATCH_RAYS];
+	checkSet_t	checked;
+	float		start[3][CM_BATCH_RAYS];	// tw[].start, tw[].end and tw[].bounds by axis,
+	float		end[3][CM_BATCH_RAYS];		// padded to a multiple of four rays
+	float		mins[3][CM_BATCH_RAYS];
+	float		maxs[3][CM_BATCH_RAYS];
+} traceBatch_t;
+
+// the part of each ray that is left inside a node
+typedef struct {
+	int			count;
+	int			ray[CM_BATCH_RAYS];
+	float		p1f[CM_BATCH_RAYS];
+	float		p2f[CM_BATCH_RAYS];
+	float		p1[3][CM_BATCH_RAYS];
+	float		p2[3][CM_BATCH_RAYS];
+} traceRays_t;
+
+/*
+================
+CM_PlaneDistances
+
+out[i] = DotProduct( point i, normal ) - dist for count points stored by axis
+================
+*/
+static void CM_PlaneDistances( const float *x, const float *y, const float *z, int count,
+							   const vec3_t normal, float dist, float *out ) {
+	int			i;
+#if idx64
+	__m128		nx, ny, nz, d;
+
+	nx = _mm_set1_ps( normal[0] );
+	ny = _mm_set1_ps( normal[1] );
+	nz = _mm_set1_ps( normal[2] );
+	d = _mm_set1_ps( dist );
+	for ( i = 0 ; i + 4 <= count ; i += 4 ) {
+		__m128	v;
+
+		v = _mm_add_ps( _mm_mul_ps( _mm_loadu_ps( x + i ), nx ), _mm_mul_ps( _mm_loadu_ps( y + i ), ny ) );
+		v = _mm_add_ps( v, _mm_mul_ps( _mm_loadu_ps( z + i ), nz ) );
+		_mm_storeu_ps( out + i, _mm_sub_ps( v, d ) );
+	}
+#elif defined( __aarch64__ )
+	float32x4_t	d;
+
+	d = vdupq_n_f32( dist );
+	for ( i = 0 ; i + 4 <= count ; i += 4 ) {
+		float32x4_t	v;
+
+		// no fused multiply-add, so the lanes round like the scalar code
+		v = vaddq_f32( vmulq_n_f32( vld1q_f32( x + i ), normal[0] ), vmulq_n_f32( vld1q_f32( y + i ), normal[1] ) );
+		v = vaddq_f32( v, vmulq_n_f32( vld1q_f32( z + i ), normal[2] ) );
+		vst1q_f32( out + i, vsubq_f32( v, d ) );
+	}
+#else
+	i = 0;
+#endif
+	for ( ; i < count ; i++ ) {
+		out[i] = x[i] * normal[0] + y[i] * normal[1] + z[i] * normal[2] - dist;
+	}
+}
+
+/*
+================
+CM_BoundsMask
+
+The rays in test whose bounds touch the bounds of the brush
+================
+*/
+static unsigned CM_BoundsMask( const traceBatch_t *tb, const cbrush_t *brush, unsigned test ) {
+	unsigned	mask;
+	int			i;
+#if idx64
+	__m128		lo[3], hi[3], in;
+
+	for ( i = 0 ; i < 3 ; i++ ) {
+		lo[i] = _mm_set1_ps( brush->bounds[0][i] - SURFACE_CLIP_EPSILON );
+		hi[i] = _mm_set1_ps( brush->bounds[1][i] + SURFACE_CLIP_EPSILON );
+	}
+	mask = 0;
+	for ( i = 0 ; test >> i ; i += 4 ) {
+		if ( !( ( test >> i ) & 15 ) ) {
+			continue;
+		}
+		in = _mm_and_ps( _mm_cmpge_ps( _mm_loadu_ps( tb->maxs[0] + i ), lo[0] ), _mm_cmple_ps( _mm_loadu_ps( tb->mins[0] + i ), hi[0] ) );
+		in = _mm_and_ps( in, _mm_and_ps( _mm_cmpge_ps( _mm_loadu_ps( tb->maxs[1] + i ), lo[1] ), _mm_cmple_ps( _mm_loadu_ps( tb->mins[1] + i ), hi[1] ) ) );
+		in = _mm_and_ps( in, _mm_and_ps( _mm_cmpge_ps( _mm_loadu_ps( tb->maxs[2] + i ), lo[2] ), _mm_cmple_ps( _mm_loadu_ps( tb->mins[2] + i ), hi[2] ) ) );
+		mask |= _mm_movemask_ps( in ) << i;
+	}
+#elif defined( __aarch64__ )
+	static const uint32_t	laneBits[4] = { 1, 2, 4, 8 };
+	float32x4_t	lo[3], hi[3];
+	uint32x4_t	in;
+
+	for ( i = 0 ; i < 3 ; i++ ) {
+		lo[i] = vdupq_n_f32( brush->bounds[0][i] - SURFACE_CLIP_EPSILON );
+		hi[i] = vdupq_n_f32( brush->bounds[1][i] + SURFACE_CLIP_EPSILON );
+	}
+	mask = 0;
+	for ( i = 0 ; test >> i ; i += 4 ) {
+		if ( !( ( test >> i ) & 15 ) ) {
+			continue;
+		}
+		in = vandq_u32( vcgeq_f32( vld1q_f32( tb->maxs[0] + i ), lo[0] ), vcleq_f32( vld1q_f32( tb->mins[0] + i ), hi[0] ) );
+		in = vandq_u32( in, vandq_u32( vcgeq_f32( vld1q_f32( tb->maxs[1] + i ), lo[1] ), vcleq_f32( vld1q_f32( tb->mins[1] + i ), hi[1] ) ) );
+		in = vandq_u32( in, vandq_u32( vcgeq_f32( vld1q_f32( tb->maxs[2] + i ), lo[2] ), vcleq_f32( vld1q_f32( tb->mins[2] + i ), hi[2] ) ) );
+		mask |= vaddvq_u32( vandq_u32( in, vld1q_u32( laneBits ) ) ) << i;
+	}
+#else
+	mask = 0;
+	for ( i = 0 ; test >> i ; i++ ) {
+		if ( ( test & ( 1u << i ) ) && CM_BoundsIntersect( tb->tw[i].bounds[0], tb->tw[i].bounds[1], brush->bounds[0], brush->bounds[1] ) ) {
+			mask |= 1u << i;
+		}
+	}
+#endif
+	return mask & test;
+}
+
+/*
+================
+CM_TraceThroughBrushBatch
+
+CM_TraceThroughBrush for the rays of the batch in mask
+================
+*/
+static void CM_TraceThroughBrushBatch( traceBatch_t *tb, cbrush_t *brush, unsigned mask ) {
+	const traceWork_t	*shared = &tb->tw[0];
+	traceWork_t	*tw;
+	int			ray[CM_BATCH_RAYS];
+	float		start[3][CM_BATCH_RAYS], end[3][CM_BATCH_RAYS];
+	float		startp[3][CM_BATCH_RAYS], endp[3][CM_BATCH_RAYS];
+	float		d1s[CM_BATCH_RAYS], d2s[CM_BATCH_RAYS];
+	float		enterFrac[CM_BATCH_RAYS], leaveFrac[CM_BATCH_RAYS];
+	cplane_t	*clipplane[CM_BATCH_RAYS];
+	cbrushside_t	*leadside[CM_BATCH_RAYS];
+	qboolean	getout[CM_BATCH_RAYS], startout[CM_BATCH_RAYS];
+	qboolean	out[CM_BATCH_RAYS];
+	int			i, j, r, count, lanes, live;
+	cplane_t	*plane;
+	cbrushside_t	*side;
+	float		dist, d1, d2, f, t;
+
+	count = 0;
+	for ( r = 0 ; mask >> r ; r++ ) {
+		if ( mask & ( 1u << r ) ) {
+			ray[count++] = r;
+		}
+	}
+
+	// nothing to share with a single ray
+	if ( count == 1 ) {
+		CM_TraceThroughBrush( &tb->tw[ray[0]], brush );
+		return;
+	}
+
+	if ( !brush->numsides ) {
+		return;
+	}
+
+	c_brush_traces += count;
+
+	// fill up the last group of four with copies of the first ray
+	lanes = ( count + 3 ) & ~3;
+	for ( r = 0 ; r < lanes ; r++ ) {
+		for ( j = 0 ; j < 3 ; j++ ) {
+			start[j][r] = tb->start[j][ray[r < count ? r : 0]];
+			end[j][r] = tb->end[j][ray[r < count ? r : 0]];
+		}
+	}
+
+	for ( r = 0 ; r < count ; r++ ) {
+		enterFrac[r] = -1.0;
+		leaveFrac[r] = 1.0;
+		clipplane[r] = NULL;
+		leadside[r] = NULL;
+		getout[r] = qfalse;
+		startout[r] = qfalse;
+		out[r] = qfalse;
+	}
+
+	//
+	// compare the traces against all planes of the brush
+	// find the latest time each trace crosses a plane towards the interior
+	// and the earliest time it crosses a plane towards the exterior
+	//
+	live = count;
+	for ( i = 0 ; i < brush->numsides && live ; i++ ) {
+		side = brush->sides + i;
+		plane = side->plane;
+
+		if ( shared->sphere.use ) {
+			// adjust the plane distance appropriately for radius
+			dist = plane->dist + shared->sphere.radius;
+
+			// find the closest point on the capsule to the plane
+			t = DotProduct( plane->normal, shared->sphere.offset );
+			for ( j = 0 ; j < 3 ; j++ ) {
+				for ( r = 0 ; r < lanes ; r++ ) {
+					if ( t > 0 ) {
+						startp[j][r] = start[j][r] - shared->sphere.offset[j];
+						endp[j][r] = end[j][r] - shared->sphere.offset[j];
+					} else {
+						startp[j][r] = start[j][r] + shared->sphere.offset[j];
+						endp[j][r] = end[j][r] + shared->sphere.offset[j];
+					}
+				}
+			}
+			CM_PlaneDistances( startp[0], startp[1], startp[2], lanes, plane->normal, dist, d1s );
+			CM_PlaneDistances( endp[0], endp[1], endp[2], lanes, plane->normal, dist, d2s );
+		} else {
+			// adjust the plane distance appropriately for mins/maxs
+			dist = plane->dist - DotProduct( shared->offsets[ plane->signbits ], plane->normal );
+
+			CM_PlaneDistances( start[0], start[1], start[2], lanes, plane->normal, dist, d1s );
+			CM_PlaneDistances( end[0], end[1], end[2], lanes, plane->normal, dist, d2s );
+		}
+
+		for ( r = 0 ; r < count ; r++ ) {
+			if ( out[r] ) {
+				continue;
+			}
+			d1 = d1s[r];
+			d2 = d2s[r];
+
+			if (d2 > 0) {
+				getout[r] = qtrue;	// endpoint is not in solid
+			}
+			if (d1 > 0) {
+				startout[r] = qtrue;
+			}
+
+			// if completely in front of face, no intersection with the entire brush
+			if (d1 > 0 && ( d2 >= SURFACE_CLIP_EPSILON || d2 >= d1 )  ) {
+				out[r] = qtrue;
+				live--;
+				continue;
+			}
+
+			// if it doesn't cross the plane, the plane isn't relevant
+			if (d1 <= 0 && d2 <= 0 ) {
+				continue;
+			}
+
+			// crosses face
+			if (d1 > d2) {	// enter
+				f = (d1-SURFACE_CLIP_EPSILON) / (d1-d2);
+				if ( f < 0 ) {
+					f = 0;
+				}
+				if (f > enterFrac[r]) {
+					enterFrac[r] = f;
+					clipplane[r] = plane;
+					leadside[r] = side;
+				}
+			} else {	// leave
+				f = (d1+SURFACE_CLIP_EPSILON) / (d1-d2);
+				if ( f > 1 ) {
+					f = 1;
+				}
+				if (f < leaveFrac[r]) {
+					leaveFrac[r] = f;
+				}
+			}
+		}
+	}
+
+	//
+	// all planes have been checked, and the trace was not
+	// completely outside the brush
+	//
+	for ( r = 0 ; r < count ; r++ ) {
+		if ( out[r] ) {
+			continue;
+		}
+		tw = &tb->tw[ray[r]];
+
+		if (!startout[r]) {	// original point was inside brush
+			tw->trace.startsolid = qtrue;
+			if (!getout[r]) {
+				tw->trace.allsolid = qtrue;
+				tw->trace.fraction = 0;
+				tw->trace.contents = brush->contents;
+			}
+			continue;
+		}
+
+		if (enterFrac[r] < leaveFrac[r]) {
+			if (enterFrac[r] > -1 && enterFrac[r] < tw->trace.fraction) {
+				if (enterFrac[r] < 0) {
+					enterFrac[r] = 0;
+				}
+				tw->trace.fraction = enterFrac[r];
+				if (clipplane[r] != NULL) {
+					tw->trace.plane = *clipplane[r];
+				}
+				if (leadside[r] != NULL) {
+					tw->trace.surfaceFlags = leadside[r]->surfaceFlags;
+				}
+				tw->trace.contents = brush->contents;
+			}
+		}
+	}
+}
+
+/*
+================
+CM_TraceThroughLeafRay
+
+CM_TraceThroughLeaf for a single ray of the batch
+================
+*/
+static void CM_TraceThroughLeafRay( traceBatch_t *tb, cLeaf_t *leaf, int ray ) {
+	traceWork_t	*tw = &tb->tw[ray];
+	unsigned	bit = 1u << ray;
+	int			k;
+	int			brushnum;
+	cbrush_t	*b;
+	cPatch_t	*patch;
+
+	// trace line against all brushes in the leaf
+	for ( k = 0 ; k < leaf->numLeafBrushes ; k++ ) {
+		brushnum = cm.leafbrushes[leaf->firstLeafBrush+k];
+
+		b = &cm.brushes[brushnum];
+		if ( b->shared && ( CM_CheckedRays( &tb->checked, brushnum, bit ) & bit ) ) {
+			continue;	// already checked this brush in another leaf
+		}
+
+		if ( !(b->contents & tw->contents) ) {
+			continue;
+		}
+
+		if ( !CM_BoundsIntersect( tw->bounds[0], tw->bounds[1],
+					b->bounds[0], b->bounds[1] ) ) {
+			continue;
+		}
+
+		CM_TraceThroughBrush( tw, b );
+		if ( !tw->trace.fraction ) {
+			return;
+		}
+	}
+
+	// trace line against all patches in the leaf
+#ifdef BSPC
+	if (1) {
+#else
+	if ( !cm_noCurves->integer ) {
+#endif
+		for ( k = 0 ; k < leaf->numLeafSurfaces ; k++ ) {
+			patch = cm.surfaces[ cm.leafsurfaces[ leaf->firstLeafSurface + k ] ];
+			if ( !patch ) {
+				continue;
+			}
+			if ( patch->shared && ( CM_CheckedRays( &tb->checked, -1 - cm.leafsurfaces[ leaf->firstLeafSurface + k ], bit ) & bit ) ) {
+				continue;	// already checked this patch in another leaf
+			}
+
+			if ( !(patch->contents & tw->contents) ) {
+				continue;
+			}
+
+			CM_TraceThroughPatch( tw, patch );
+			if ( !tw->trace.fraction ) {
+				return;
+			}
+		}
+	}
+}
+
+/*
+================
+CM_TraceThroughLeafBatch
+
+CM_TraceThroughLeaf for the rays of the batch in live
+================
+*/
+static void CM_TraceThroughLeafBatch( traceBatch_t *tb, cLeaf_t *leaf, unsigned live ) {
+	unsigned	test;
+	int			k, r, brushnum;
+	cbrush_t	*b;
+	cPatch_t	*patch;
+	traceWork_t	*tw;
+
+	if ( !( live & ( live - 1 ) ) ) {
+		for ( r = 0 ; !( live & ( 1u << r ) ) ; r++ ) {
+		}
+		CM_TraceThroughLeafRay( tb, leaf, r );
+		return;
+	}
+
+	// trace the lines against all brushes in the leaf
+	for ( k = 0 ; k < leaf->numLeafBrushes && live ; k++ ) {
+		brushnum = cm.leafbrushes[leaf->firstLeafBrush+k];
+
+		b = &cm.brushes[brushnum];
+		test = live;
+		if ( b->shared ) {
+			test &= ~CM_CheckedRays( &tb->checked, brushnum, live );
+			if ( !test ) {
+				continue;	// already checked this brush in another leaf
+			}
+		}
+
+		if ( !(b->contents & tb->tw[0].contents) ) {
+			continue;
+		}
+
+		test = CM_BoundsMask( tb, b, test );
+		if ( !test ) {
+			continue;
+		}
+
+		CM_TraceThroughBrushBatch( tb, b, test );
+
+		// rays that are blocked completely are done with the leaf
+		for ( r = 0 ; test >> r ; r++ ) {
+			if ( ( test & ( 1u << r ) ) && !tb->tw[r].trace.fraction ) {
+				live &= ~( 1u << r );
+			}
+		}
+	}
+
+	// trace the lines against all patches in the leaf
+#ifdef BSPC
+	if (1) {
+#else
+	if ( !cm_noCurves->integer ) {
+#endif
+		for ( k = 0 ; k < leaf->numLeafSurfaces && live ; k++ ) {
+			patch = cm.surfaces[ cm.leafsurfaces[ leaf->firstLeafSurface + k ] ];
+			if ( !patch ) {
+				continue;
+			}
+			test = live;
+			if ( patch->shared ) {
+				test &= ~CM_CheckedRays( &tb->checked, -1 - cm.leafsurfaces[ leaf->firstLeafSurface + k ], live );
+			}
+
+			for ( r = 0 ; test >> r ; r++ ) {
+				if ( !( test & ( 1u << r ) ) ) {
+					continue;
+				}
+				tw = &tb->tw[r];
+				if ( patch->contents & tw->contents ) {
+					CM_TraceThroughPatch( tw, patch );
+				}
+				if ( !tw->trace.fraction ) {
+					live &= ~( 1u << r );
+				}
+			}
+		}
+	}
+}
+
+/*
+================
+CM_AddTraceRay
+
+Adds the part of a ray between p1f and p2f to a node, unless the ray
+already hit something nearer.  The end points are taken from column
+r of p1 and p2, which are stored by axis.
+================
+*/
+static void CM_AddTraceRay( const traceBatch_t *tb, traceRays_t *rays, int ray, float p1f, float p2f,
+							const float (*p1)[CM_BATCH_RAYS], const float (*p2)[CM_BATCH_RAYS], int r ) {
+	int		n;
+
+	if ( tb->tw[ray].trace.fraction <= p1f ) {
+		return;		// already hit something nearer
+	}
+
+	n = rays->count++;
+	rays->ray[n] = ray;
+	rays->p1f[n] = p1f;
+	rays->p2f[n] = p2f;
+	rays->p1[0][n] = p1[0][r];
+	rays->p1[1][n] = p1[1][r];
+	rays->p1[2][n] = p1[2][r];
+	rays->p2[0][n] = p2[0][r];
+	rays->p2[1][n] = p2[1][r];
+	rays->p2[2][n] = p2[2][r];
+}
+
+/*
+==================
+CM_TraceThroughTreeRay
+
+CM_TraceThroughTree for a single ray of the batch, which still has to
+share the check set of the batch with the others at the leafs
+==================
+*/
+static void CM_TraceThroughTreeRay( traceBatch_t *tb, int ray, int num, float p1f, float p2f, vec3_t p1, vec3_t p2 ) {
+	traceWork_t	*tw = &tb->tw[ray];
+	cNode_t		*node;
+	cplane_t	*plane;
+	float		t1, t2, offset;
+	float		frac, frac2;
+	float		idist;
+	vec3_t		mid;
+	int			side;
+	float		midf;
+
+	if (tw->trace.fraction <= p1f) {
+		return;		// already hit something nearer
+	}
+
+	// if < 0, we are in a leaf node
+	if (num < 0) {
+		CM_TraceThroughLeafRay( tb, &cm.leafs[-1-num], ray );
+		return;
+	}
+
+	//
+	// find the point distances to the separating plane
+	// and the offset for the size of the box
+	//
+	node = cm.nodes + num;
+	plane = node->plane;
+
+	// adjust the plane distance appropriately for mins/maxs
+	if ( plane->type < 3 ) {
+		t1 = p1[plane->type] - plane->dist;
+		t2 = p2[plane->type] - plane->dist;
+		offset = tw->extents[plane->type];
+	} else {
+		t1 = DotProduct (plane->normal, p1) - plane->dist;
+		t2 = DotProduct (plane->normal, p2) - plane->dist;
+		if ( tw->isPoint ) {
+			offset = 0;
+		} else {
+			// this is silly
+			offset = 2048;
+		}
+	}
+
+	// see which sides we need to consider
+	if ( t1 >= offset + 1 && t2 >= offset + 1 ) {
+		CM_TraceThroughTreeRay( tb, ray, node->children[0], p1f, p2f, p1, p2 );
+		return;
+	}
+	if ( t1 < -offset - 1 && t2 < -offset - 1 ) {
+		CM_TraceThroughTreeRay( tb, ray, node->children[1], p1f, p2f, p1, p2 );
+		return;
+	}
+
+	// put the crosspoint SURFACE_CLIP_EPSILON pixels on the near side
+	if ( t1 < t2 ) {
+		idist = 1.0/(t1-t2);
+		side = 1;
+		frac2 = (t1 + offset + SURFACE_CLIP_EPSILON)*idist;
+		frac = (t1 - offset + SURFACE_CLIP_EPSILON)*idist;
+	} else if (t1 > t2) {
+		idist = 1.0/(t1-t2);
+		side = 0;
+		frac2 = (t1 - offset - SURFACE_CLIP_EPSILON)*idist;
+		frac = (t1 + offset + SURFACE_CLIP_EPSILON)*idist;
+	} else {
+		side = 0;
+		frac = 1;
+		frac2 = 0;
+	}
+
+	// move up to the node
+	if ( frac < 0 ) {
+		frac = 0;
+	}
+	if ( frac > 1 ) {
+		frac = 1;
+	}
+
+	midf = p1f + (p2f - p1f)*frac;
+
+	mid[0] = p1[0] + frac*(p2[0] - p1[0]);
+	mid[1] = p1[1] + frac*(p2[1] - p1[1]);
+	mid[2] = p1[2] + frac*(p2[2] - p1[2]);
+
+	CM_TraceThroughTreeRay( tb, ray, node->children[side], p1f, midf, p1, mid );
+
+	// go past the node
+	if ( frac2 < 0 ) {
+		frac2 = 0;
+	}
+	if ( frac2 > 1 ) {
+		frac2 = 1;
+	}
+
+	midf = p1f + (p2f - p1f)*frac2;
+
+	mid[0] = p1[0] + frac2*(p2[0] - p1[0]);
+	mid[1] = p1[1] + frac2*(p2[1] - p1[1]);
+	mid[2] = p1[2] + frac2*(p2[2] - p1[2]);
+
+	CM_TraceThroughTreeRay( tb, ray, node->children[side^1], midf, p2f, mid, p2 );
+}
+
+/*
+==================
+CM_TraceThroughTreeBatch
+
+CM_TraceThroughTree for a group of rays.  The rays that cross the node are
+split in two groups by the side they start on, and each group visits its
+near child and then its far child.
+==================
+*/
+static void CM_TraceThroughTreeBatch( traceBatch_t *tb, int num, const traceRays_t *rays ) {
+	const traceWork_t	*shared = &tb->tw[0];
+	traceRays_t	next;
+	cNode_t		*node;
+	cplane_t	*plane;
+	float		t1s[CM_BATCH_RAYS], t2s[CM_BATCH_RAYS];
+	float		fracs[CM_BATCH_RAYS], frac2s[CM_BATCH_RAYS];
+	float		nearf[CM_BATCH_RAYS], farf[CM_BATCH_RAYS];
+	float		nearp[3][CM_BATCH_RAYS], farp[3][CM_BATCH_RAYS];
+	int			sides[CM_BATCH_RAYS];	// near child, or -1 - child when it only touches one
+	float		t1, t2, offset;
+	float		frac, frac2;
+	float		idist;
+	vec3_t		p1, p2;
+	unsigned	live;
+	int			i, r, side;
+
+	// if < 0, we are in a leaf node
+	if (num < 0) {
+		live = 0;
+		for ( r = 0 ; r < rays->count ; r++ ) {
+			live |= 1u << rays->ray[r];
+		}
+		CM_TraceThroughLeafBatch( tb, &cm.leafs[-1-num], live );
+		return;
+	}
+
+	// a ray that is on its own goes down the rest of the way alone
+	if ( rays->count == 1 ) {
+		for ( i = 0 ; i < 3 ; i++ ) {
+			p1[i] = rays->p1[i][0];
+			p2[i] = rays->p2[i][0];
+		}
+		CM_TraceThroughTreeRay( tb, rays->ray[0], num, rays->p1f[0], rays->p2f[0], p1, p2 );
+		return;
+	}
+
+	//
+	// find the point distances to the separating plane
+	// and the offset for the size of the box
+	//
+	node = cm.nodes + num;
+	plane = node->plane;
+
+	// adjust the plane distance appropriately for mins/maxs
+	if ( plane->type < 3 ) {
+		for ( r = 0 ; r < rays->count ; r++ ) {
+			t1s[r] = rays->p1[plane->type][r] - plane->dist;
+			t2s[r] = rays->p2[plane->type][r] - plane->dist;
+		}
+		offset = shared->extents[plane->type];
+	} else {
+		CM_PlaneDistances( rays->p1[0], rays->p1[1], rays->p1[2], rays->count, plane->normal, plane->dist, t1s );
+		CM_PlaneDistances( rays->p2[0], rays->p2[1], rays->p2[2], rays->count, plane->normal, plane->dist, t2s );
+		if ( shared->isPoint ) {
+			offset = 0;
+		} else {
+			// this is silly
+			offset = 2048;
+		}
+	}
+
+	for ( r = 0 ; r < rays->count ; r++ ) {
+		t1 = t1s[r];
+		t2 = t2s[r];
+
+		// see which sides we need to consider
+		if ( t1 >= offset + 1 && t2 >= offset + 1 ) {
+			sides[r] = -1;
+			fracs[r] = frac2s[r] = 0;
+			continue;
+		}
+		if ( t1 < -offset - 1 && t2 < -offset - 1 ) {
+			sides[r] = -2;
+			fracs[r] = frac2s[r] = 0;
+			continue;
+		}
+
+		// put the crosspoint SURFACE_CLIP_EPSILON pixels on the near side
+		if ( t1 < t2 ) {
+			idist = 1.0/(t1-t2);
+			side = 1;
+			frac2 = (t1 + offset + SURFACE_CLIP_EPSILON)*idist;
+			frac = (t1 - offset + SURFACE_CLIP_EPSILON)*idist;
+		} else if (t1 > t2) {
+			idist = 1.0/(t1-t2);
+			side = 0;
+			frac2 = (t1 - offset - SURFACE_CLIP_EPSILON)*idist;
+			frac = (t1 + offset + SURFACE_CLIP_EPSILON)*idist;
+		} else {
+			side = 0;
+			frac = 1;
+			frac2 = 0;
+		}
+
+		// move up to the node
+		if ( frac < 0 ) {
+			frac = 0;
+		}
+		if ( frac > 1 ) {
+			frac = 1;
+		}
+
+		// go past the node
+		if ( frac2 < 0 ) {
+			frac2 = 0;
+		}
+		if ( frac2 > 1 ) {
+			frac2 = 1;
+		}
+
+		sides[r] = side;
+		fracs[r] = frac;
+		frac2s[r] = frac2;
+	}
+
+	// when all the rays stay on one side they go down as they are,
+	// unless some of them already hit something nearer
+	for ( r = 1 ; r < rays->count && sides[r] == sides[0] ; r++ ) {
+	}
+	if ( r == rays->count && sides[0] < 0 ) {
+		for ( r = 0 ; r < rays->count && tb->tw[rays->ray[r]].trace.fraction > rays->p1f[r] ; r++ ) {
+		}
+		if ( r == rays->count ) {
+			CM_TraceThroughTreeBatch( tb, node->children[-1 - sides[0]], rays );
+			return;
+		}
+	}
+
+	//
+	// split every ray at the node the way CM_TraceThroughTree does,
+	// the near part ends at frac and the far part starts at frac2
+	//
+	for ( r = 0 ; r < rays->count ; r++ ) {
+		nearf[r] = rays->p1f[r] + (rays->p2f[r] - rays->p1f[r])*fracs[r];
+		farf[r] = rays->p1f[r] + (rays->p2f[r] - rays->p1f[r])*frac2s[r];
+	}
+	for ( i = 0 ; i < 3 ; i++ ) {
+		for ( r = 0 ; r < rays->count ; r++ ) {
+			nearp[i][r] = rays->p1[i][r] + fracs[r]*(rays->p2[i][r] - rays->p1[i][r]);
+			farp[i][r] = rays->p1[i][r] + frac2s[r]*(rays->p2[i][r] - rays->p1[i][r]);
+		}
+	}
+	// the rays that only touch one child go there whole
+	for ( r = 0 ; r < rays->count ; r++ ) {
+		if ( sides[r] < 0 ) {
+			nearf[r] = rays->p2f[r];
+			for ( i = 0 ; i < 3 ; i++ ) {
+				nearp[i][r] = rays->p2[i][r];
+			}
+		}
+	}
+
+	// the rays that start in front
+	next.count = 0;
+	for ( r = 0 ; r < rays->count ; r++ ) {
+		if ( sides[r] == 0 || sides[r] == -1 ) {
+			CM_AddTraceRay( tb, &next, rays->ray[r], rays->p1f[r], nearf[r], rays->p1, nearp, r );
+		}
+	}
+	if ( next.count ) {
+		CM_TraceThroughTreeBatch( tb, node->children[0], &next );
+	}
+
+	// the rays that start behind, and the far parts of the
+	// ones that started in front
+	next.count = 0;
+	for ( r = 0 ; r < rays->count ; r++ ) {
+		if ( sides[r] == 1 || sides[r] == -2 ) {
+			CM_AddTraceRay( tb, &next, rays->ray[r], rays->p1f[r], nearf[r], rays->p1, nearp, r );
+		} else if ( sides[r] == 0 ) {
+			CM_AddTraceRay( tb, &next, rays->ray[r], farf[r], rays->p2f[r], farp, rays->p2, r );
+		}
+	}
+	if ( next.count ) {
+		CM_TraceThroughTreeBatch( tb, node->children[1], &next );
+	}
+
+	// the far parts of the rays that started behind
+	next.count = 0;
+	for ( r = 0 ; r < rays->count ; r++ ) {
+		if ( sides[r] == 1 ) {
+			CM_AddTraceRay( tb, &next, rays->ray[r], farf[r], rays->p2f[r], farp, rays->p2, r );
+		}
+	}
+	if ( next.count ) {
+		CM_TraceThroughTreeBatch( tb, node->children[0], &next );
+	}
+}
+
+/*
+==================
+CM_BoxTraceBatch
+
+Traces that are only position tests, or that are against a
+submodel, are done one at a time
+==================
+*/
+void CM_BoxTraceBatch( trace_t *results, int numTraces, const vec3_t *starts, const vec3_t *ends,
+						  vec3_t mins, vec3_t maxs,
+						  clipHandle_t model, int brushmask, int capsule ) {
+	traceBatch_t	tb;
+	traceRays_t		rays;
+	int				index[CM_BATCH_RAYS];
+	int				i, j, k, first, count;
+
+	if ( model || !cm.numNodes ) {
+		for ( i = 0 ; i < numTraces ; i++ ) {
+			CM_BoxTrace( &results[i], starts[i], ends[i], mins, maxs, model, brushmask, capsule );
+		}
+		return;
+	}
+
+	// allow NULL to be passed in for 0,0,0
+	if ( !mins ) {
+		mins = vec3_origin;
+	}
+	if ( !maxs ) {
+		maxs = vec3_origin;
+	}
+
+	for ( first = 0 ; first < numTraces ; first = i ) {
+		count = 0;
+		for ( i = first ; i < numTraces && count < CM_BATCH_RAYS ; i++ ) {
+			if ( VectorCompare( starts[i], ends[i] ) ) {
+				CM_BoxTrace( &results[i], starts[i], ends[i], mins, maxs, 0, brushmask, capsule );
+				continue;
+			}
+			index[count++] = i;
+		}
+		if ( !count ) {
+			continue;
+		}
+
+		CM_ClearCheckSet( &tb.checked );	// for multi-check avoidance
+
+		rays.count = 0;
+		for ( j = 0 ; j < count ; j++ ) {
+			c_traces++;				// for statistics, may be zeroed
+
+			CM_InitTraceWork( &tb.tw[j], starts[index[j]], ends[index[j]], mins, maxs, vec3_origin, brushmask, capsule, NULL );
+			CM_InitSweep( &tb.tw[j] );
+
+		}
+
+		for ( j = 0 ; j < ( ( count + 3 ) & ~3 ) ; j++ ) {
+			for ( k = 0 ; k < 3 ; k++ ) {
+				tb.start[k][j] = tb.tw[j < count ? j : 0].start[k];
+				tb.end[k][j] = tb.tw[j < count ? j : 0].end[k];
+				tb.mins[k][j] = tb.tw[j < count ? j : 0].bounds[0][k];
+				tb.maxs[k][j] = tb.tw[j < count ? j : 0].bounds[1][k];
+			}
+		}
+
+		for ( j = 0 ; j < count ; j++ ) {
+			CM_AddTraceRay( &tb, &rays, j, 0, 1, (const float (*)[CM_BATCH_RAYS])tb.start, (const float (*)[CM_BATCH_RAYS])tb.end, j );
+		}
+
+		CM_TraceThroughTreeBatch( &tb, 0, &rays );
+
+		for ( j = 0 ; j < count ; j++ ) {
+			CM_FinishTrace( &tb.tw[j], &results[index[j]], starts[index[j]], ends[index[j]] );
+		}
+	}
 }
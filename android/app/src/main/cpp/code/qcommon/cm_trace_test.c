@@ -0,0 +1,679 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// cm_trace_test.c -- checks batched traces against single ones on the loaded map,
+// checks traces on several threads at once against serial ones, and records
+// and replays the traces of a real game
+
+/*
+
+tracetest [count] [seed] [repeat]
+
+Builds count bundles of rays over the bounds of the loaded map, shaped like
+the traces that get batched: shotgun blasts fanning out from one point, bot
+visibility checks from one point to many, and short player sized moves as
+boxes and as capsules.  Some bundles are longer than CM_BATCH_RAYS and some
+rays are position tests, so every path of CM_BoxTraceBatch is taken.
+
+Every bundle is traced with CM_BoxTraceBatch and with a CM_BoxTrace per ray,
+and the results have to be the same down to the bit.  The compiler is free
+to order the float math of the two differently when building with
+-ffast-math, so results that only differ by rounding are counted on their
+own and do not fail the test.
+
+With repeat, both are also timed over that many passes through all bundles.
+
+
+tracestress [count] [threads] [seed] [rounds]
+
+Builds count bundles like tracetest and traces every one of them, batched and
+ray by ray, first on the main thread and then rounds times with the bundles
+spread over threads through Com_RunJobs.  Nothing in the collision model is
+shared between traces any more, so every threaded result has to match the
+serial one down to the bit.
+
+
+tracelog record <name>
+tracelog stop
+tracelog replay <name> [repeat]
+
+Writes every CM_BoxTrace and CM_TransformedBoxTrace that is made against the
+map or its inline models to tracelogs/<name>.tlog, along with what it
+returned, until stopped or the map is cleared.  Traces against the temporary
+box models of entities are left out, as they can not be rebuilt later.
+
+Replay loads the log on the same map and runs every trace again, once with
+the brush sides tested four at a time and once with cm_simdPlanes 0, checks
+the results against the log and times both over repeat passes.
+
+*/
+
+#include "cm_local.h"
+
+#define TT_MAX_RAYS		24
+#define TT_MASK			( CONTENTS_SOLID | CONTENTS_PLAYERCLIP | CONTENTS_BODY )
+
+typedef struct {
+	int			numRays;
+	vec3_t		starts[TT_MAX_RAYS];
+	vec3_t		ends[TT_MAX_RAYS];
+	vec3_t		mins, maxs;
+	int			capsule;
+} traceBundle_t;
+
+typedef struct {
+	int				seed;
+	vec3_t			mins, maxs;		// of the world model
+	traceBundle_t	*bundles;
+	int				numBundles;
+	trace_t			results[2][TT_MAX_RAYS];
+} traceTest_t;
+
+static traceTest_t	tt;
+
+typedef struct {
+	trace_t		single[TT_MAX_RAYS];
+	trace_t		batch[TT_MAX_RAYS];
+} bundleResults_t;
+
+#define	TRACELOG_IDENT		(('G'<<24)+('O'<<16)+('L'<<8)+'T')
+#define	TRACELOG_VERSION	1
+
+typedef struct {
+	int			ident;
+	int			version;
+	char		mapname[MAX_QPATH];
+	int			numBrushes;
+	int			numPlanes;
+} traceLogHeader_t;
+
+typedef struct {
+	vec3_t		start, end;
+	vec3_t		mins, maxs;
+	vec3_t		origin, angles;
+	int			model;
+	int			brushmask;
+	int			capsule;
+	int			transformed;
+	trace_t		trace;
+} loggedTrace_t;
+
+fileHandle_t	cm_traceLog;
+
+/*
+================
+TT_RandomPoint
+================
+*/
+static void TT_RandomPoint( vec3_t point ) {
+	int		i;
+
+	for ( i = 0 ; i < 3 ; i++ ) {
+		point[i] = tt.mins[i] + Q_random( &tt.seed ) * ( tt.maxs[i] - tt.mins[i] );
+	}
+}
+
+/*
+================
+TT_RandomDir
+================
+*/
+static void TT_RandomDir( vec3_t dir ) {
+	dir[0] = Q_crandom( &tt.seed );
+	dir[1] = Q_crandom( &tt.seed );
+	dir[2] = Q_crandom( &tt.seed ) * 0.5f;
+	if ( !VectorNormalize( dir ) ) {
+		VectorSet( dir, 1, 0, 0 );
+	}
+}
+
+/*
+================
+TT_BuildBundle
+================
+*/
+static void TT_BuildBundle( traceBundle_t *b, int kind ) {
+	vec3_t		start, forward, right, up;
+	float		r, u;
+	int			i;
+
+	TT_RandomPoint( start );
+	VectorClear( b->mins );
+	VectorClear( b->maxs );
+	b->capsule = qfalse;
+
+	switch ( kind ) {
+	case 0:
+		// a shotgun blast
+		b->numRays = 11;
+		TT_RandomDir( forward );
+		PerpendicularVector( right, forward );
+		CrossProduct( forward, right, up );
+		for ( i = 0 ; i < b->numRays ; i++ ) {
+			r = Q_crandom( &tt.seed ) * 700 * 16;
+			u = Q_crandom( &tt.seed ) * 700 * 16;
+			VectorCopy( start, b->starts[i] );
+			VectorMA( start, 8192 * 16, forward, b->ends[i] );
+			VectorMA( b->ends[i], r, right, b->ends[i] );
+			VectorMA( b->ends[i], u, up, b->ends[i] );
+		}
+		break;
+	case 1:
+		// a bot looking around, more rays than fit in a batch
+		b->numRays = TT_MAX_RAYS;
+		for ( i = 0 ; i < b->numRays ; i++ ) {
+			VectorCopy( start, b->starts[i] );
+			TT_RandomPoint( b->ends[i] );
+		}
+		break;
+	default:
+		// player moves, some of them position tests
+		b->numRays = 1 + ( (unsigned)Q_rand( &tt.seed ) >> 8 ) % CM_BATCH_RAYS;
+		VectorSet( b->mins, -15, -15, -24 );
+		VectorSet( b->maxs, 15, 15, 32 );
+		b->capsule = ( kind == 3 );
+		for ( i = 0 ; i < b->numRays ; i++ ) {
+			TT_RandomDir( forward );
+			VectorMA( start, 32 * Q_crandom( &tt.seed ), forward, b->starts[i] );
+			if ( ( (unsigned)Q_rand( &tt.seed ) >> 8 ) % 8 == 0 ) {
+				VectorCopy( b->starts[i], b->ends[i] );
+			} else {
+				VectorMA( b->starts[i], 256 * Q_random( &tt.seed ), forward, b->ends[i] );
+			}
+		}
+		break;
+	}
+}
+
+/*
+================
+TT_RoundingOnly
+
+True if two traces only differ in the last bits of the fraction and endpos
+================
+*/
+static qboolean TT_RoundingOnly( const trace_t *a, const trace_t *b ) {
+	if ( a->allsolid != b->allsolid || a->startsolid != b->startsolid
+		|| a->surfaceFlags != b->surfaceFlags || a->contents != b->contents
+		|| a->entityNum != b->entityNum ) {
+		return qfalse;
+	}
+	if ( memcmp( &a->plane, &b->plane, sizeof( a->plane ) ) ) {
+		return qfalse;
+	}
+	if ( fabs( a->fraction - b->fraction ) > 1e-5f ) {
+		return qfalse;
+	}
+	if ( fabs( a->endpos[0] - b->endpos[0] ) > 0.01f || fabs( a->endpos[1] - b->endpos[1] ) > 0.01f
+		|| fabs( a->endpos[2] - b->endpos[2] ) > 0.01f ) {
+		return qfalse;
+	}
+	return qtrue;
+}
+
+/*
+================
+TT_CheckBundle
+
+Returns the number of rays that came out differently
+================
+*/
+static int TT_CheckBundle( traceBundle_t *b, int *rounded ) {
+	int		i, failed;
+
+	Com_Memset( tt.results, 0, sizeof( tt.results ) );
+
+	CM_BoxTraceBatch( tt.results[0], b->numRays, (const vec3_t *)b->starts, (const vec3_t *)b->ends,
+		b->mins, b->maxs, 0, TT_MASK, b->capsule );
+	for ( i = 0 ; i < b->numRays ; i++ ) {
+		CM_BoxTrace( &tt.results[1][i], b->starts[i], b->ends[i], b->mins, b->maxs, 0, TT_MASK, b->capsule );
+	}
+
+	failed = 0;
+	for ( i = 0 ; i < b->numRays ; i++ ) {
+		if ( memcmp( &tt.results[0][i], &tt.results[1][i], sizeof( trace_t ) ) ) {
+			if ( TT_RoundingOnly( &tt.results[0][i], &tt.results[1][i] ) ) {
+				(*rounded)++;
+				continue;
+			}
+			if ( !failed ) {
+				Com_Printf( "tracetest: (%f %f %f) to (%f %f %f): batch %f %i, single %f %i\n",
+					b->starts[i][0], b->starts[i][1], b->starts[i][2], b->ends[i][0], b->ends[i][1], b->ends[i][2],
+					tt.results[0][i].fraction, tt.results[0][i].contents,
+					tt.results[1][i].fraction, tt.results[1][i].contents );
+			}
+			failed++;
+		}
+	}
+	return failed;
+}
+
+/*
+================
+TT_TraceBundle
+
+Traces all rays of the bundle batched and one by one
+================
+*/
+static void TT_TraceBundle( const traceBundle_t *b, bundleResults_t *r ) {
+	int		i;
+
+	CM_BoxTraceBatch( r->batch, b->numRays, (const vec3_t *)b->starts, (const vec3_t *)b->ends,
+		(float *)b->mins, (float *)b->maxs, 0, TT_MASK, b->capsule );
+	for ( i = 0 ; i < b->numRays ; i++ ) {
+		CM_BoxTrace( &r->single[i], b->starts[i], b->ends[i], (float *)b->mins, (float *)b->maxs, 0, TT_MASK, b->capsule );
+	}
+}
+
+/*
+================
+TT_StressJob
+================
+*/
+static void TT_StressJob( void *data, int job ) {
+	TT_TraceBundle( &tt.bundles[job], (bundleResults_t *)data + job );
+}
+
+/*
+================
+CM_TraceTest_f
+================
+*/
+void CM_TraceTest_f( void ) {
+	int		count, seed, repeat;
+	int		i, pass, start;
+	int		failed, rounded, rays, hits;
+	int		msec[2];
+	traceBundle_t	*b;
+
+	if ( !cm.numNodes ) {
+		Com_Printf( "tracetest: no map loaded\n" );
+		return;
+	}
+
+	count = Cmd_Argc() > 1 ? atoi( Cmd_Argv( 1 ) ) : 10000;
+	seed = Cmd_Argc() > 2 ? atoi( Cmd_Argv( 2 ) ) : Com_Milliseconds();
+	repeat = Cmd_Argc() > 3 ? atoi( Cmd_Argv( 3 ) ) : 0;
+	if ( count < 1 || count > 100000 ) {
+		Com_Printf( "tracetest: count must be 1 to 100000\n" );
+		return;
+	}
+
+	Com_Memset( &tt, 0, sizeof( tt ) );
+	tt.seed = seed;
+	CM_ModelBounds( 0, tt.mins, tt.maxs );
+	tt.bundles = Z_Malloc( count * sizeof( *tt.bundles ) );
+	tt.numBundles = count;
+
+	failed = rounded = rays = hits = 0;
+	for ( i = 0 ; i < count ; i++ ) {
+		b = &tt.bundles[i];
+		TT_BuildBundle( b, i % 4 );
+		failed += TT_CheckBundle( b, &rounded );
+		rays += b->numRays;
+		for ( pass = 0 ; pass < b->numRays ; pass++ ) {
+			if ( tt.results[1][pass].fraction < 1 ) {
+				hits++;
+			}
+		}
+	}
+
+	Com_Printf( "tracetest: %i bundles, %i rays (%i hit), %i failed, %i rounded differently, seed %i\n",
+		count, rays, hits, failed, rounded, seed );
+
+	if ( repeat > 0 ) {
+		msec[0] = msec[1] = 0;
+		for ( pass = 0 ; pass < repeat ; pass++ ) {
+			start = Sys_Milliseconds();
+			for ( i = 0 ; i < count ; i++ ) {
+				b = &tt.bundles[i];
+				CM_BoxTraceBatch( tt.results[0], b->numRays, (const vec3_t *)b->starts, (const vec3_t *)b->ends,
+					b->mins, b->maxs, 0, TT_MASK, b->capsule );
+			}
+			msec[0] += Sys_Milliseconds() - start;
+
+			start = Sys_Milliseconds();
+			for ( i = 0 ; i < count ; i++ ) {
+				int		j;
+
+				b = &tt.bundles[i];
+				for ( j = 0 ; j < b->numRays ; j++ ) {
+					CM_BoxTrace( &tt.results[1][j], b->starts[j], b->ends[j], b->mins, b->maxs, 0, TT_MASK, b->capsule );
+				}
+			}
+			msec[1] += Sys_Milliseconds() - start;
+		}
+		Com_Printf( "tracetest: %i passes, batched %i msec, single %i msec\n", repeat, msec[0], msec[1] );
+	}
+
+	Z_Free( tt.bundles );
+	Com_Memset( &tt, 0, sizeof( tt ) );
+}
+
+/*
+================
+CM_LogTrace
+
+Called by CM_BoxTrace and CM_TransformedBoxTrace while a trace log is being
+recorded, origin and angles are NULL for CM_BoxTrace
+================
+*/
+void CM_LogTrace( const trace_t *results, const vec3_t start, const vec3_t end, const vec3_t mins, const vec3_t maxs,
+				  clipHandle_t model, int brushmask, const vec3_t origin, const vec3_t angles, int capsule ) {
+	loggedTrace_t	lt;
+
+	if ( model == BOX_MODEL_HANDLE || model == CAPSULE_MODEL_HANDLE ) {
+		return;
+	}
+
+	Com_Memset( &lt, 0, sizeof( lt ) );
+	VectorCopy( start, lt.start );
+	VectorCopy( end, lt.end );
+	if ( mins ) {
+		VectorCopy( mins, lt.mins );
+	}
+	if ( maxs ) {
+		VectorCopy( maxs, lt.maxs );
+	}
+	if ( origin ) {
+		VectorCopy( origin, lt.origin );
+		VectorCopy( angles, lt.angles );
+		lt.transformed = qtrue;
+	}
+	lt.model = model;
+	lt.brushmask = brushmask;
+	lt.capsule = capsule;
+	lt.trace = *results;
+
+	FS_Write( &lt, sizeof( lt ), cm_traceLog );
+}
+
+/*
+================
+CM_StopTraceLog
+================
+*/
+void CM_StopTraceLog( void ) {
+	if ( !cm_traceLog ) {
+		return;
+	}
+	FS_FCloseFile( cm_traceLog );
+	cm_traceLog = 0;
+	Com_Printf( "tracelog: stopped recording\n" );
+}
+
+/*
+================
+TL_Record
+================
+*/
+static void TL_Record( const char *name ) {
+	traceLogHeader_t	header;
+	char				path[MAX_QPATH];
+
+	if ( cm_traceLog ) {
+		Com_Printf( "tracelog: already recording\n" );
+		return;
+	}
+
+	Com_sprintf( path, sizeof( path ), "tracelogs/%s.tlog", name );
+	cm_traceLog = FS_FOpenFileWrite( path );
+	if ( !cm_traceLog ) {
+		Com_Printf( "tracelog: couldn't open %s\n", path );
+		return;
+	}
+
+	Com_Memset( &header, 0, sizeof( header ) );
+	header.ident = TRACELOG_IDENT;
+	header.version = TRACELOG_VERSION;
+	Q_strncpyz( header.mapname, cm.name, sizeof( header.mapname ) );
+	header.numBrushes = cm.numBrushes;
+	header.numPlanes = cm.numPlanes;
+	FS_Write( &header, sizeof( header ), cm_traceLog );
+
+	Com_Printf( "tracelog: recording to %s\n", path );
+}
+
+/*
+================
+TL_ReplayPass
+
+Runs all traces of the log, and checks them against it when failed is not NULL
+================
+*/
+static void TL_ReplayPass( const loggedTrace_t *log, int count, int *failed, int *rounded ) {
+	const loggedTrace_t	*lt;
+	trace_t				trace;
+	int					i;
+
+	for ( i = 0, lt = log ; i < count ; i++, lt++ ) {
+		if ( lt->transformed ) {
+			CM_TransformedBoxTrace( &trace, lt->start, lt->end, (float *)lt->mins, (float *)lt->maxs,
+				lt->model, lt->brushmask, lt->origin, lt->angles, lt->capsule );
+		} else {
+			CM_BoxTrace( &trace, lt->start, lt->end, (float *)lt->mins, (float *)lt->maxs,
+				lt->model, lt->brushmask, lt->capsule );
+		}
+		if ( !failed || !memcmp( &trace, &lt->trace, sizeof( trace ) ) ) {
+			continue;
+		}
+		if ( TT_RoundingOnly( &trace, &lt->trace ) ) {
+			(*rounded)++;
+			continue;
+		}
+		if ( !*failed ) {
+			Com_Printf( "tracelog: (%f %f %f) to (%f %f %f): %f %i, logged %f %i\n",
+				lt->start[0], lt->start[1], lt->start[2], lt->end[0], lt->end[1], lt->end[2],
+				trace.fraction, trace.contents, lt->trace.fraction, lt->trace.contents );
+		}
+		(*failed)++;
+	}
+}
+
+/*
+================
+TL_Replay
+================
+*/
+static void TL_Replay( const char *name, int repeat ) {
+	const traceLogHeader_t	*header;
+	const loggedTrace_t		*log;
+	char		path[MAX_QPATH];
+	char		simdPlanes[MAX_CVAR_VALUE_STRING];
+	void		*buffer;
+	int			len, count, i, pass, start;
+	int			failed[2], rounded[2], msec[2];
+
+	if ( cm_traceLog ) {
+		Com_Printf( "tracelog: can't replay while recording\n" );
+		return;
+	}
+
+	Com_sprintf( path, sizeof( path ), "tracelogs/%s.tlog", name );
+	len = FS_ReadFile( path, &buffer );
+	if ( !buffer ) {
+		Com_Printf( "tracelog: couldn't load %s\n", path );
+		return;
+	}
+
+	header = buffer;
+	if ( len < (int)sizeof( *header ) || header->ident != TRACELOG_IDENT
+		|| header->version != TRACELOG_VERSION ) {
+		Com_Printf( "tracelog: %s is not a trace log\n", path );
+		FS_FreeFile( buffer );
+		return;
+	}
+	if ( Q_stricmp( header->mapname, cm.name ) || header->numBrushes != cm.numBrushes
+		|| header->numPlanes != cm.numPlanes ) {
+		Com_Printf( "tracelog: %s was recorded on %s\n", path, header->mapname );
+		FS_FreeFile( buffer );
+		return;
+	}
+
+	log = (const loggedTrace_t *)( header + 1 );
+	count = ( len - (int)sizeof( *header ) ) / (int)sizeof( *log );
+
+	// 0 is the scalar loops, 1 the four at a time ones
+	Q_strncpyz( simdPlanes, Cvar_VariableString( "cm_simdPlanes" ), sizeof( simdPlanes ) );
+	for ( i = 0 ; i < 2 ; i++ ) {
+		Cvar_Set( "cm_simdPlanes", i ? "1" : "0" );
+		failed[i] = rounded[i] = 0;
+		TL_ReplayPass( log, count, &failed[i], &rounded[i] );
+
+		start = Sys_Milliseconds();
+		for ( pass = 0 ; pass < repeat ; pass++ ) {
+			TL_ReplayPass( log, count, NULL, NULL );
+		}
+		msec[i] = Sys_Milliseconds() - start;
+	}
+	Cvar_Set( "cm_simdPlanes", simdPlanes );
+
+	Com_Printf( "tracelog: %i traces, scalar %i failed %i rounded differently, simd %i failed %i rounded differently\n",
+		count, failed[0], rounded[0], failed[1], rounded[1] );
+	if ( repeat > 0 ) {
+		Com_Printf( "tracelog: %i passes, scalar %i msec, simd %i msec\n", repeat, msec[0], msec[1] );
+	}
+
+	FS_FreeFile( buffer );
+}
+
+/*
+================
+CM_TraceLog_f
+================
+*/
+void CM_TraceLog_f( void ) {
+	const char	*cmd;
+
+	cmd = Cmd_Argv( 1 );
+	if ( !Q_stricmp( cmd, "stop" ) ) {
+		CM_StopTraceLog();
+		return;
+	}
+
+	if ( Cmd_Argc() < 3 || ( Q_stricmp( cmd, "record" ) && Q_stricmp( cmd, "replay" ) ) ) {
+		Com_Printf( "usage: tracelog record <name> | stop | replay <name> [repeat]\n" );
+		return;
+	}
+	if ( !cm.numNodes ) {
+		Com_Printf( "tracelog: no map loaded\n" );
+		return;
+	}
+
+	if ( !Q_stricmp( cmd, "record" ) ) {
+		TL_Record( Cmd_Argv( 2 ) );
+	} else {
+		TL_Replay( Cmd_Argv( 2 ), Cmd_Argc() > 3 ? atoi( Cmd_Argv( 3 ) ) : 0 );
+	}
+}
+
+/*
+================
+CM_TraceStress_f
+================
+*/
+void CM_TraceStress_f( void ) {
+	int		count, threads, seed, rounds;
+	int		i, j, round, start, rays;
+	int		failed, msec[2];
+	bundleResults_t	*serial, *threaded;
+
+	if ( !cm.numNodes ) {
+		Com_Printf( "tracestress: no map loaded\n" );
+		return;
+	}
+	if ( cm_traceLog ) {
+		Com_Printf( "tracestress: can't run while recording a trace log\n" );
+		return;
+	}
+
+	count = Cmd_Argc() > 1 ? atoi( Cmd_Argv( 1 ) ) : 2000;
+	threads = Cmd_Argc() > 2 ? atoi( Cmd_Argv( 2 ) ) : 4;
+	seed = Cmd_Argc() > 3 ? atoi( Cmd_Argv( 3 ) ) : Com_Milliseconds();
+	rounds = Cmd_Argc() > 4 ? atoi( Cmd_Argv( 4 ) ) : 4;
+	if ( count < 1 || count > 20000 ) {
+		Com_Printf( "tracestress: count must be 1 to 20000\n" );
+		return;
+	}
+	if ( threads < 1 || threads > MAX_JOB_THREADS + 1 ) {
+		Com_Printf( "tracestress: threads must be 1 to %i\n", MAX_JOB_THREADS + 1 );
+		return;
+	}
+
+	Com_Memset( &tt, 0, sizeof( tt ) );
+	tt.seed = seed;
+	CM_ModelBounds( 0, tt.mins, tt.maxs );
+	tt.bundles = Z_Malloc( count * sizeof( *tt.bundles ) );
+	tt.numBundles = count;
+
+	rays = 0;
+	for ( i = 0 ; i < count ; i++ ) {
+		TT_BuildBundle( &tt.bundles[i], i % 4 );
+		rays += tt.bundles[i].numRays;
+	}
+
+	serial = Hunk_AllocateTempMemory( count * sizeof( *serial ) );
+	threaded = Hunk_AllocateTempMemory( count * sizeof( *threaded ) );
+	Com_Memset( serial, 0, count * sizeof( *serial ) );
+
+	start = Sys_Milliseconds();
+	for ( i = 0 ; i < count ; i++ ) {
+		TT_TraceBundle( &tt.bundles[i], &serial[i] );
+	}
+	msec[0] = Sys_Milliseconds() - start;
+
+	failed = 0;
+	msec[1] = 0;
+	for ( round = 0 ; round < rounds ; round++ ) {
+		Com_Memset( threaded, 0, count * sizeof( *threaded ) );
+
+		// the calling thread takes jobs too
+		start = Sys_Milliseconds();
+		Com_RunJobs( TT_StressJob, threaded, count, threads - 1 );
+		msec[1] += Sys_Milliseconds() - start;
+
+		for ( i = 0 ; i < count ; i++ ) {
+			for ( j = 0 ; j < tt.bundles[i].numRays ; j++ ) {
+				if ( !memcmp( &serial[i].single[j], &threaded[i].single[j], sizeof( trace_t ) )
+					&& !memcmp( &serial[i].batch[j], &threaded[i].batch[j], sizeof( trace_t ) ) ) {
+					continue;
+				}
+				if ( !failed ) {
+					Com_Printf( "tracestress: bundle %i ray %i: serial %f %f, threaded %f %f\n", i, j,
+						serial[i].single[j].fraction, serial[i].batch[j].fraction,
+						threaded[i].single[j].fraction, threaded[i].batch[j].fraction );
+				}
+				failed++;
+			}
+		}
+	}
+
+	Com_Printf( "tracestress: %i bundles, %i rays, %i threads, %i rounds, %i failed, seed %i\n",
+		count, rays, threads, rounds, failed, seed );
+	if ( rounds > 0 ) {
+		Com_Printf( "tracestress: serial %i msec, threaded %i msec per round\n", msec[0], msec[1] / rounds );
+	}
+
+	Hunk_FreeTempMemory( threaded );
+	Hunk_FreeTempMemory( serial );
+	Z_Free( tt.bundles );
+	Com_Memset( &tt, 0, sizeof( tt ) );
+}
@@ -765,12 +765,31 @@ The rover can be left pointing at a non-empty block
 
 The zone calls are pretty much only used for small strings and structures,
 all big things are allocated on the hunk.
+
+Allocations of up to Z_MAX_SLAB_SIZE bytes, header included, are not taken
+from the block list directly but from slabs.  A slab is one TAG_SLAB block
+of the zone, cut into objects of one size class.  The slabs of each class
+are kept in a list with the ones that still have free objects at the front,
+so these allocations and frees never walk the block list, and the small
+blocks that come and go all the time don't fragment it.  Objects have the
+usual memblock_t header with the tag and the trash tester, with SLABID as
+id and the slab they are part of in prev.
 ==============================================================================
 */
 
 #define	ZONEID	0x1d4a11
+#define	SLABID	0x1d4a12
 #define MINFRAGMENT	64
 
+#define	Z_MAX_SLAB_SIZE		2048
+#define	Z_NUM_SLAB_CLASSES	( sizeof( z_slabSizes ) / sizeof( z_slabSizes[0] ) )
+#define	Z_MIN_SLAB_OBJECTS	4
+
+// object sizes of the slab classes, header and trash tester included
+static const int	z_slabSizes[] = {
+	48, 64, 80, 96, 128, 160, 192, 256, 320, 384, 512, 640, 768, 1024, 1280, 1536, Z_MAX_SLAB_SIZE
+};
+
 typedef struct zonedebug_s {
 	char *label;
 	char *file;
@@ -788,11 +807,28 @@ typedef struct memblock_s {
 #endif
 } memblock_t;
 
+typedef struct slab_s {
+	struct slab_s	*next, *prev;	// in the list of its class
+	int			sizeClass;
+	int			numObjects;
+	int			numUsed;
+	memblock_t	*free;			// free objects, linked by next
+} slab_t;
+
+#define	SLAB_HEADER_SIZE	PAD( sizeof( slab_t ), 16 )
+
+typedef struct {
+	slab_t		*first;			// slabs with free objects come first
+	slab_t		*last;
+} slabClass_t;
+
 typedef struct {
 	int		size;			// total bytes malloced, including header
 	int		used;			// total bytes used
 	memblock_t	blocklist;	// start / end cap for linked list
 	memblock_t	*rover;
+	int		slabSize;		// bytes to cut into objects for a new slab
+	slabClass_t	slabs[Z_NUM_SLAB_CLASSES];
 } memzone_t;
 
 // main zone for all "dynamic" memory allocation
@@ -801,6 +837,9 @@ static memzone_t	*mainzone;
 // fragment the main zone (think of cvar and cmd strings)
 static memzone_t	*smallzone;
 
+// com_zoneSlabs, read once the zones are up
+static qboolean		z_useSlabs = qtrue;
+
 static void Z_CheckHeap( void );
 
 /*
@@ -808,7 +847,7 @@ static void Z_CheckHeap( void );
 Z_ClearZone
 ========================
 */
-static void Z_ClearZone( memzone_t *zone, int size ) {
+static void Z_ClearZone( memzone_t *zone, int size, int slabSize ) {
 	memblock_t	*block;
 	
 	// set the entire zone to one free block
@@ -821,6 +860,8 @@ static void Z_ClearZone( memzone_t *zone, int size ) {
 	zone->rover = block;
 	zone->size = size;
 	zone->used = 0;
+	zone->slabSize = slabSize;
+	Com_Memset( zone->slabs, 0, sizeof( zone->slabs ) );
 	
 	block->prev = block->next = &zone->blocklist;
 	block->tag = 0;			// free block
@@ -846,13 +887,152 @@ int Z_AvailableMemory( void ) {
 	return Z_AvailableZoneMemory( mainzone );
 }
 
+/*
+========================
+Z_UseSlabs
+
+Turns the slabs on or off for new allocations and returns the old setting.
+Blocks remember where they came from, so they can be freed either way.
+========================
+*/
+qboolean Z_UseSlabs( qboolean use ) {
+	qboolean	old;
+
+	old = z_useSlabs;
+	z_useSlabs = use;
+	return old;
+}
+
+/*
+========================
+Z_SlabObject
+========================
+*/
+static ID_INLINE memblock_t *Z_SlabObject( slab_t *slab, int num ) {
+	return (memblock_t *)( (byte *)slab + SLAB_HEADER_SIZE + num * z_slabSizes[slab->sizeClass] );
+}
+
+/*
+========================
+Z_UnlinkSlab
+========================
+*/
+static void Z_UnlinkSlab( slabClass_t *sc, slab_t *slab ) {
+	if ( slab->prev ) {
+		slab->prev->next = slab->next;
+	} else {
+		sc->first = slab->next;
+	}
+	if ( slab->next ) {
+		slab->next->prev = slab->prev;
+	} else {
+		sc->last = slab->prev;
+	}
+	slab->next = slab->prev = NULL;
+}
+
+/*
+========================
+Z_LinkSlab
+
+Puts the slab at the front of its class, or at the back when it is full
+========================
+*/
+static void Z_LinkSlab( slabClass_t *sc, slab_t *slab ) {
+	if ( slab->free ) {
+		slab->next = sc->first;
+		if ( sc->first ) {
+			sc->first->prev = slab;
+		} else {
+			sc->last = slab;
+		}
+		sc->first = slab;
+	} else {
+		slab->prev = sc->last;
+		if ( sc->last ) {
+			sc->last->next = slab;
+		} else {
+			sc->first = slab;
+		}
+		sc->last = slab;
+	}
+}
+
+/*
+========================
+Z_FreeBlock
+
+Gives a block back to the block list of its zone
+========================
+*/
+static void Z_FreeBlock( memzone_t *zone, memblock_t *block ) {
+	memblock_t	*other;
+
+	zone->used -= block->size;
+
+	block->tag = 0;		// mark as free
+	
+	other = block->prev;
+	if (!other->tag) {
+		// merge with previous free block
+		other->size += block->size;
+		other->next = block->next;
+		other->next->prev = other;
+		if (block == zone->rover) {
+			zone->rover = other;
+		}
+		block = other;
+	}
+
+	zone->rover = block;
+
+	other = block->next;
+	if ( !other->tag ) {
+		// merge the next free block onto the end
+		block->size += other->size;
+		block->next = other->next;
+		block->next->prev = block;
+	}
+}
+
+/*
+========================
+Z_FreeSlabObject
+
+Gives an object back to its slab
+========================
+*/
+static void Z_FreeSlabObject( memzone_t *zone, memblock_t *block ) {
+	slabClass_t	*sc;
+	slab_t		*slab;
+
+	slab = (slab_t *)block->prev;
+	sc = &zone->slabs[slab->sizeClass];
+
+	block->tag = 0;
+	block->next = slab->free;
+	slab->free = block;
+	slab->numUsed--;
+
+	if ( !block->next ) {
+		// it was full, move it to the front
+		Z_UnlinkSlab( sc, slab );
+		Z_LinkSlab( sc, slab );
+	}
+	if ( !slab->numUsed && slab != sc->first ) {
+		// only the front slab of a class is kept around when empty
+		Z_UnlinkSlab( sc, slab );
+		Z_FreeBlock( zone, (memblock_t *)slab - 1 );
+	}
+}
+
 /*
 ========================
 Z_Free
 ========================
 */
 void Z_Free( void *ptr ) {
-	memblock_t	*block, *other;
+	memblock_t	*block;
 	memzone_t *zone;
 	
 	if (!ptr) {
@@ -860,7 +1040,7 @@ void Z_Free( void *ptr ) {
 	}
 
 	block = (memblock_t *) ( (byte *)ptr - sizeof(memblock_t));
-	if (block->id != ZONEID) {
+	if (block->id != ZONEID && block->id != SLABID) {
 		Com_Error( ERR_FATAL, "Z_Free: freed a pointer without ZONEID" );
 	}
 	if (block->tag == 0) {
@@ -876,6 +1056,12 @@ void Z_Free( void *ptr ) {
 		Com_Error( ERR_FATAL, "Z_Free: memory block wrote past end" );
 	}
 
+#ifdef USE_TESTS
+	if ( z_recordAllocs ) {
+		Z_RecordFree( ptr );
+	}
+#endif
+
 	if (block->tag == TAG_SMALL) {
 		zone = smallzone;
 	}
@@ -883,33 +1069,14 @@ void Z_Free( void *ptr ) {
 		zone = mainzone;
 	}
 
-	zone->used -= block->size;
 	// set the block to something that should cause problems
 	// if it is referenced...
 	Com_Memset( ptr, 0xaa, block->size - sizeof( *block ) );
 
-	block->tag = 0;		// mark as free
-	
-	other = block->prev;
-	if (!other->tag) {
-		// merge with previous free block
-		other->size += block->size;
-		other->next = block->next;
-		other->next->prev = other;
-		if (block == zone->rover) {
-			zone->rover = other;
-		}
-		block = other;
-	}
-
-	zone->rover = block;
-
-	other = block->next;
-	if ( !other->tag ) {
-		// merge the next free block onto the end
-		block->size += other->size;
-		block->next = other->next;
-		block->next->prev = block;
+	if ( block->id == SLABID ) {
+		Z_FreeSlabObject( zone, block );
+	} else {
+		Z_FreeBlock( zone, block );
 	}
 }
 
@@ -921,6 +1088,9 @@ Z_FreeTags
 */
 void Z_FreeTags( int tag ) {
 	memzone_t	*zone;
+	slab_t		*slab, *next;
+	memblock_t	*block;
+	int			i, j, used;
 
 	if ( tag == TAG_SMALL ) {
 		zone = smallzone;
@@ -928,6 +1098,26 @@ void Z_FreeTags( int tag ) {
 	else {
 		zone = mainzone;
 	}
+
+	// objects in slabs, a slab may go back to the zone when its
+	// last object is freed
+	for ( i = 0 ; i < Z_NUM_SLAB_CLASSES ; i++ ) {
+		for ( slab = zone->slabs[i].first ; slab ; slab = next ) {
+			next = slab->next;
+			for ( j = 0 ; j < slab->numObjects ; j++ ) {
+				block = Z_SlabObject( slab, j );
+				if ( block->tag != tag ) {
+					continue;
+				}
+				used = slab->numUsed;
+				Z_Free( (void *)(block + 1) );
+				if ( used == 1 ) {
+					break;
+				}
+			}
+		}
+	}
+
 	// use the rover as our pointer, because
 	// Z_Free automatically adjusts it
 	zone->rover = zone->blocklist.next;
@@ -940,59 +1130,28 @@ void Z_FreeTags( int tag ) {
 	} while ( zone->rover != &zone->blocklist );
 }
 
-
 /*
 ================
-Z_TagMalloc
+Z_BlockMalloc
+
+Takes the first free block of the zone that is big enough, size includes
+the header and the trash tester.  Returns NULL if there is none.
 ================
 */
-#ifdef ZONE_DEBUG
-void *Z_TagMallocDebug( int size, int tag, char *label, char *file, int line ) {
-	int		allocSize;
-#else
-void *Z_TagMalloc( int size, int tag ) {
-#endif
+static memblock_t *Z_BlockMalloc( memzone_t *zone, int size, int tag ) {
 	int		extra;
 	memblock_t	*start, *rover, *new, *base;
-	memzone_t *zone;
-
-	if (!tag) {
-		Com_Error( ERR_FATAL, "Z_TagMalloc: tried to use a 0 tag" );
-	}
-
-	if ( tag == TAG_SMALL ) {
-		zone = smallzone;
-	}
-	else {
-		zone = mainzone;
-	}
 
-#ifdef ZONE_DEBUG
-	allocSize = size;
-#endif
 	//
 	// scan through the block list looking for the first free block
 	// of sufficient size
 	//
-	size += sizeof(memblock_t);	// account for size of block header
-	size += 4;					// space for memory trash tester
-	size = PAD(size, sizeof(intptr_t));		// align to 32/64 bit boundary
-	
 	base = rover = zone->rover;
 	start = base->prev;
 	
 	do {
 		if (rover == start)	{
 			// scaned all the way around the list
-#ifdef ZONE_DEBUG
-			Z_LogHeap();
-
-			Com_Error(ERR_FATAL, "Z_Malloc: failed on allocation of %i bytes from the %s zone: %s, line: %d (%s)",
-								size, zone == smallzone ? "small" : "main", file, line, label);
-#else
-			Com_Error(ERR_FATAL, "Z_Malloc: failed on allocation of %i bytes from the %s zone",
-								size, zone == smallzone ? "small" : "main");
-#endif
 			return NULL;
 		}
 		if (rover->tag) {
@@ -1026,6 +1185,157 @@ void *Z_TagMalloc( int size, int tag ) {
 	
 	base->id = ZONEID;
 
+	return base;
+}
+
+/*
+================
+Z_NewSlab
+
+Adds a slab with only free objects to the front of a class
+================
+*/
+static slab_t *Z_NewSlab( memzone_t *zone, int sizeClass ) {
+	memblock_t	*base, *block;
+	slab_t		*slab;
+	int			i, numObjects, size;
+
+	numObjects = zone->slabSize / z_slabSizes[sizeClass];
+	if ( numObjects < Z_MIN_SLAB_OBJECTS ) {
+		numObjects = Z_MIN_SLAB_OBJECTS;
+	}
+
+	size = sizeof( memblock_t ) + SLAB_HEADER_SIZE + numObjects * z_slabSizes[sizeClass] + 4;
+	size = PAD( size, sizeof( intptr_t ) );
+	base = Z_BlockMalloc( zone, size, TAG_SLAB );
+	if ( !base ) {
+		return NULL;
+	}
+#ifdef ZONE_DEBUG
+	base->d.label = "slab";
+	base->d.file = __FILE__;
+	base->d.line = __LINE__;
+	base->d.allocSize = size;
+#endif
+	*(int *)((byte *)base + base->size - 4) = ZONEID;
+
+	slab = (slab_t *)( base + 1 );
+	slab->next = slab->prev = NULL;
+	slab->sizeClass = sizeClass;
+	slab->numObjects = numObjects;
+	slab->numUsed = 0;
+	slab->free = NULL;
+	for ( i = numObjects - 1 ; i >= 0 ; i-- ) {
+		block = Z_SlabObject( slab, i );
+		block->size = z_slabSizes[sizeClass];
+		block->tag = 0;
+		block->id = SLABID;
+		block->prev = (memblock_t *)slab;
+		block->next = slab->free;
+		slab->free = block;
+	}
+	Z_LinkSlab( &zone->slabs[sizeClass], slab );
+
+	return slab;
+}
+
+/*
+================
+Z_SlabMalloc
+
+Takes a free object from the slabs, size includes the header and the
+trash tester.  Returns NULL if a new slab was needed and didn't fit.
+================
+*/
+static memblock_t *Z_SlabMalloc( memzone_t *zone, int size, int tag ) {
+	slabClass_t	*sc;
+	slab_t		*slab;
+	memblock_t	*block;
+	int			i;
+
+	for ( i = 0 ; z_slabSizes[i] < size ; i++ ) {
+	}
+
+	sc = &zone->slabs[i];
+	slab = sc->first;
+	if ( !slab || !slab->free ) {
+		slab = Z_NewSlab( zone, i );
+		if ( !slab ) {
+			return NULL;
+		}
+	}
+
+	block = slab->free;
+	slab->free = block->next;
+	slab->numUsed++;
+	if ( !slab->free ) {
+		// full, to the back
+		Z_UnlinkSlab( sc, slab );
+		Z_LinkSlab( sc, slab );
+	}
+
+	block->tag = tag;
+	block->next = NULL;
+	return block;
+}
+
+/*
+================
+Z_TagMalloc
+================
+*/
+#ifdef ZONE_DEBUG
+void *Z_TagMallocDebug( int size, int tag, char *label, char *file, int line ) {
+	int		allocSize;
+#else
+void *Z_TagMalloc( int size, int tag ) {
+#endif
+	memblock_t	*base;
+	memzone_t *zone;
+#if !defined( ZONE_DEBUG ) && defined( USE_TESTS )
+	int		allocSize;
+#endif
+
+	if (!tag) {
+		Com_Error( ERR_FATAL, "Z_TagMalloc: tried to use a 0 tag" );
+	}
+
+	if ( tag == TAG_SMALL ) {
+		zone = smallzone;
+	}
+	else {
+		zone = mainzone;
+	}
+
+#if defined( ZONE_DEBUG ) || defined( USE_TESTS )
+	allocSize = size;
+#endif
+	size += sizeof(memblock_t);	// account for size of block header
+	size += 4;					// space for memory trash tester
+	size = PAD(size, sizeof(intptr_t));		// align to 32/64 bit boundary
+
+	base = NULL;
+	if ( z_useSlabs && size <= Z_MAX_SLAB_SIZE ) {
+		base = Z_SlabMalloc( zone, size, tag );
+	}
+	if ( !base ) {
+		// big, or no room left for another slab
+		base = Z_BlockMalloc( zone, size, tag );
+	}
+
+	if ( !base ) {
+#ifdef ZONE_DEBUG
+		Z_LogHeap();
+
+		Com_Error(ERR_FATAL, "Z_Malloc: failed on allocation of %i bytes from the %s zone: %s, line: %d (%s)",
+							size, zone == smallzone ? "small" : "main", file, line, label);
+#else
+		Com_Error(ERR_FATAL, "Z_Malloc: failed on allocation of %i bytes from the %s zone",
+							size, zone == smallzone ? "small" : "main");
+#endif
+		return NULL;
+	}
+
 #ifdef ZONE_DEBUG
 	base->d.label = label;
 	base->d.file = file;
@@ -1036,6 +1346,12 @@ void *Z_TagMalloc( int size, int tag ) {
 	// marker for memory trash testing
 	*(int *)((byte *)base + base->size - 4) = ZONEID;
 
+#ifdef USE_TESTS
+	if ( z_recordAllocs ) {
+		Z_RecordAlloc( base + 1, allocSize, tag );
+	}
+#endif
+
 	return (void *) ((byte *)base + sizeof(memblock_t));
 }
 
@@ -1098,17 +1414,45 @@ static void Z_CheckHeap( void ) {
 
 /*
 ========================
-Z_LogZoneHeap
+Z_LogBlock
 ========================
 */
-void Z_LogZoneHeap( memzone_t *zone, char *name ) {
+static void Z_LogBlock( memblock_t *block, int *size, int *allocSize, int *numBlocks ) {
 #ifdef ZONE_DEBUG
 	char dump[32], *ptr;
 	int  i, j;
+	char		buf[4096];
+
+	ptr = ((char *) block) + sizeof(memblock_t);
+	j = 0;
+	for (i = 0; i < 20 && i < block->d.allocSize; i++) {
+		if (ptr[i] >= 32 && ptr[i] < 127) {
+			dump[j++] = ptr[i];
+		}
+		else {
+			dump[j++] = '_';
+		}
+	}
+	dump[j] = '\0';
+	Com_sprintf(buf, sizeof(buf), "size = %8d: %s, line: %d (%s) [%s]\r\n", block->d.allocSize, block->d.file, block->d.line, block->d.label, dump);
+	FS_Write(buf, strlen(buf), logfile);
+	*allocSize += block->d.allocSize;
 #endif
-	memblock_t	*block;
+	*size += block->size;
+	(*numBlocks)++;
+}
+
+/*
+========================
+Z_LogZoneHeap
+========================
+*/
+void Z_LogZoneHeap( memzone_t *zone, char *name ) {
+	memblock_t	*block, *object;
+	slab_t		*slab;
 	char		buf[4096];
 	int size, allocSize, numBlocks;
+	int			i;
 
 	if (!logfile || !FS_Initialized())
 		return;
@@ -1119,25 +1463,16 @@ void Z_LogZoneHeap( memzone_t *zone, char *name ) {
 	Com_sprintf(buf, sizeof(buf), "\r\n================\r\n%s log\r\n================\r\n", name);
 	FS_Write(buf, strlen(buf), logfile);
 	for (block = zone->blocklist.next ; block->next != &zone->blocklist; block = block->next) {
-		if (block->tag) {
-#ifdef ZONE_DEBUG
-			ptr = ((char *) block) + sizeof(memblock_t);
-			j = 0;
-			for (i = 0; i < 20 && i < block->d.allocSize; i++) {
-				if (ptr[i] >= 32 && ptr[i] < 127) {
-					dump[j++] = ptr[i];
-				}
-				else {
-					dump[j++] = '_';
+		if (block->tag == TAG_SLAB) {
+			slab = (slab_t *)( block + 1 );
+			for ( i = 0 ; i < slab->numObjects ; i++ ) {
+				object = Z_SlabObject( slab, i );
+				if ( object->tag ) {
+					Z_LogBlock( object, &size, &allocSize, &numBlocks );
 				}
 			}
-			dump[j] = '\0';
-			Com_sprintf(buf, sizeof(buf), "size = %8d: %s, line: %d (%s) [%s]\r\n", block->d.allocSize, block->d.file, block->d.line, block->d.label, dump);
-			FS_Write(buf, strlen(buf), logfile);
-			allocSize += block->d.allocSize;
-#endif
-			size += block->size;
-			numBlocks++;
+		} else if (block->tag) {
+			Z_LogBlock( block, &size, &allocSize, &numBlocks );
 		}
 	}
 #ifdef ZONE_DEBUG
@@ -1284,22 +1619,45 @@ Com_Meminfo_f
 =================
 */
 void Com_Meminfo_f( void ) {
-	memblock_t	*block;
+	memblock_t	*block, *object;
+	slab_t		*slab;
 	int			zoneBytes, zoneBlocks;
 	int			smallZoneBytes;
 	int			botlibBytes, rendererBytes;
+	int			slabBytes, slabFreeBytes;
 	int			unused;
+	int			i;
 
 	zoneBytes = 0;
 	botlibBytes = 0;
 	rendererBytes = 0;
 	zoneBlocks = 0;
+	slabBytes = 0;
+	slabFreeBytes = 0;
 	for (block = mainzone->blocklist.next ; ; block = block->next) {
 		if ( Cmd_Argc() != 1 ) {
 			Com_Printf ("block:%p    size:%7i    tag:%3i\n",
 				(void *)block, block->size, block->tag);
 		}
-		if ( block->tag ) {
+		if ( block->tag == TAG_SLAB ) {
+			// count the objects in it like blocks
+			slab = (slab_t *)( block + 1 );
+			slabBytes += block->size;
+			for ( i = 0 ; i < slab->numObjects ; i++ ) {
+				object = Z_SlabObject( slab, i );
+				if ( !object->tag ) {
+					slabFreeBytes += object->size;
+					continue;
+				}
+				zoneBytes += object->size;
+				zoneBlocks++;
+				if ( object->tag == TAG_BOTLIB ) {
+					botlibBytes += object->size;
+				} else if ( object->tag == TAG_RENDERER ) {
+					rendererBytes += object->size;
+				}
+			}
+		} else if ( block->tag ) {
 			zoneBytes += block->size;
 			zoneBlocks++;
 			if ( block->tag == TAG_BOTLIB ) {
@@ -1325,7 +1683,15 @@ void Com_Meminfo_f( void ) {
 
 	smallZoneBytes = 0;
 	for (block = smallzone->blocklist.next ; ; block = block->next) {
-		if ( block->tag ) {
+		if ( block->tag == TAG_SLAB ) {
+			slab = (slab_t *)( block + 1 );
+			for ( i = 0 ; i < slab->numObjects ; i++ ) {
+				object = Z_SlabObject( slab, i );
+				if ( object->tag ) {
+					smallZoneBytes += object->size;
+				}
+			}
+		} else if ( block->tag ) {
 			smallZoneBytes += block->size;
 		}
 
@@ -1366,6 +1732,8 @@ void Com_Meminfo_f( void ) {
 	Com_Printf( "        %8i bytes in dynamic renderer\n", rendererBytes );
 	Com_Printf( "        %8i bytes in dynamic other\n", zoneBytes - ( botlibBytes + rendererBytes ) );
 	Com_Printf( "        %8i bytes in small Zone memory\n", smallZoneBytes );
+	Com_Printf( "%8i bytes in zone slabs\n", slabBytes );
+	Com_Printf( "        %8i bytes free in zone slabs\n", slabFreeBytes );
 }
 
 /*
@@ -1428,7 +1796,7 @@ void Com_InitSmallZoneMemory( void ) {
 	if ( !smallzone ) {
 		Com_Error( ERR_FATAL, "Small zone data failed to allocate %1.1f megs", (float)s_smallZoneTotal / (1024*1024) );
 	}
-	Z_ClearZone( smallzone, s_smallZoneTotal );
+	Z_ClearZone( smallzone, s_smallZoneTotal, 4 * 1024 );
 }
 
 void Com_InitZoneMemory( void ) {
@@ -1453,7 +1821,12 @@ void Com_InitZoneMemory( void ) {
 	if ( !mainzone ) {
 		Com_Error( ERR_FATAL, "Zone data failed to allocate %i megs", s_zoneTotal / (1024*1024) );
 	}
-	Z_ClearZone( mainzone, s_zoneTotal );
+	Z_ClearZone( mainzone, s_zoneTotal, 16 * 1024 );
+
+	// the small zone has been using slabs since before cvars existed,
+	// blocks of either kind can be freed when this turns them off
+	cv = Cvar_Get( "com_zoneSlabs", "1", CVAR_LATCH | CVAR_ARCHIVE );
+	Z_UseSlabs( cv->integer != 0 );
 
 }
 
@@ -2685,6 +3058,8 @@ void Com_Init( char *commandLine ) {
 
 	Com_DetectSSE();
 
+	Com_InitJobs();
+
 	// override anything from the config files with command line args
 	Com_StartupVariable( NULL );
 
@@ -2715,6 +3090,17 @@ void Com_Init( char *commandLine ) {
 	}
 	Cmd_AddCommand ("quit", Com_Quit_f);
 	Cmd_AddCommand ("changeVectors", MSG_ReportChangeVectors_f );
+#ifdef USE_TESTS
+	Cmd_AddCommand ("msgtest", MSG_Test_f );
+	Cmd_AddCommand ("msgbench", MSG_Bench_f );
+	Cmd_AddCommand ("tracetest", CM_TraceTest_f );
+	Cmd_AddCommand ("tracelog", CM_TraceLog_f );
+	Cmd_AddCommand ("tracestress", CM_TraceStress_f );
+	Cmd_AddCommand ("zonebench", Z_Bench_f );
+	Cmd_AddCommand ("pakbench", FS_PakBench_f );
+	Cmd_AddCommand ("prefetchbench", FS_PrefetchBench_f );
+	Cmd_AddCommand ("nettest", NET_Test_f );
+#endif
 	Cmd_AddCommand ("writeconfig", Com_WriteConfig_f );
 	Cmd_SetCommandCompletionFunc( "writeconfig", Cmd_CompleteCfgName );
 	Cmd_AddCommand("game_restart", Com_GameRestart_f);
@@ -3291,6 +3677,7 @@ void Com_Shutdown (void) {
 		FS_HomeRemove( com_pipefile->string );
 	}
 
+	Com_ShutdownJobs();
 }
 
 /*
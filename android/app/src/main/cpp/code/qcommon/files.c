@@ -32,6 +32,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include "q_shared.h"
 #include "qcommon.h"
 #include "unzip.h"
+#include "qfiles.h"
 
 /*
 =============================================================================
@@ -209,11 +210,13 @@ static const unsigned int missionpak_checksums[] =
 #define	MAX_SEARCH_PATHS	4096
 #define MAX_FILEHASH_SIZE	1024
 
-typedef struct fileInPack_s {
-	char					*name;		// name of the file
-	unsigned long			pos;		// file info position in zip
-	unsigned long			len;		// uncompress file size
-	struct	fileInPack_s*	next;		// next file in the hash
+// the files of a pack refer to each other and to their names by number, so
+// that they can be used straight from the pak index file
+typedef struct {
+	int				name;		// offset of the name of the file in names
+	int				next;		// next file in the hash, -1 at the end
+	unsigned int	pos;		// file info position in zip
+	unsigned int	len;		// uncompress file size
 } fileInPack_t;
 
 typedef struct {
@@ -227,10 +230,53 @@ typedef struct {
 	int				numfiles;					// number of files in pk3
 	int				referenced;					// referenced file flags
 	int				hashSize;					// hash table size (power of 2)
-	fileInPack_t*	*hashTable;					// hash table
-	fileInPack_t*	buildBuffer;				// buffer with the filenames etc.
+	int				*hashTable;					// first file of each hash, -1 for none
+	fileInPack_t	*files;
+	char			*names;
+	int				namesLength;
+	int				*crcs;						// of the files that aren't empty, for the checksums
+	int				numCrcs;
+	int64_t			fileSize;					// of the pk3 when it was loaded, for the pak index
+	int64_t			fileTime;
+	void			*buildBuffer;				// holds all of the above, NULL if they are in the pak index
 } pack_t;
 
+#define	PAKINDEX_NAME		"pakindex.dat"
+#define	PAKINDEX_IDENT		(('X'<<24)+('D'<<16)+('I'<<8)+'P')
+#define	PAKINDEX_VERSION	1
+
+// the pak index file starts with a header and an entry for each pk3, the
+// rest is the data of the entries, each part 4 byte aligned
+typedef struct {
+	int				ident;
+	int				version;
+	int				numPaks;
+	int				length;						// of the whole file
+} pakIndexHeader_t;
+
+typedef struct {
+	int64_t			fileSize;					// the pk3 has to still have these
+	int64_t			fileTime;
+	int				pakFilename;				// offsets in the file
+	int				hashTable;
+	int				files;
+	int				crcs;
+	int				names;
+	int				hashSize;
+	int				numFiles;
+	int				numCrcs;
+	int				namesLength;
+	int				pad;
+} pakIndexEntry_t;
+
+typedef struct {
+	char			ospath[MAX_OSPATH];			// empty if there is no index in use
+	byte			*base;						// the mapped file, NULL if there was none
+	int				length;
+	int				numMissed;					// pk3s that weren't in it and were read
+	int				nextEntry;					// pk3s are looked up in the order they were written
+} pakIndex_t;
+
 typedef struct {
 	char		path[MAX_OSPATH];		// c:\quake3
 	char		fullpath[MAX_OSPATH];		// c:\quake3\baseq3
@@ -247,6 +293,7 @@ typedef struct searchpath_s {
 static	char		fs_gamedir[MAX_OSPATH];	// this will be a single file name with no separators
 static	cvar_t		*fs_debug;
 static	cvar_t		*fs_homepath;
+static	cvar_t		*fs_pakIndex;
 
 static	cvar_t		*fs_forceNativeVM;
 static	cvar_t		*fs_nativeVMBase;
@@ -266,6 +313,50 @@ static	int			fs_readCount;			// total bytes read
 static	int			fs_loadCount;			// total files read
 static	int			fs_loadStack;			// total files in memory
 static	int			fs_packFiles = 0;		// total number of files in packs
+static	pakIndex_t	fs_index;				// directories of the pk3s from the last startup
+
+// FS_ReadFile buffers of stored pk3 files that are mapped instead of read
+#define	MAX_MAPPED_FILES	64
+#define	MIN_MAPPED_SIZE		( 256 * 1024 )	// copying smaller ones is faster
+
+typedef struct {
+	void		*data;			// what FS_ReadFile returned
+	void		*base;
+	int			length;
+} mappedFile_t;
+
+static	cvar_t		*fs_mapFiles;
+static	mappedFile_t	fs_mappedFiles[MAX_MAPPED_FILES];
+
+// pk3 files inflated ahead of time on the job threads, see FS_PrefetchMap
+#define	MAX_PREFETCH_FILES	1024
+
+typedef enum {
+	PF_FREE,
+	PF_QUEUED,		// waiting for the jobs
+	PF_READY,		// inflated, nobody asked for it yet
+	PF_OPEN,		// being read through a file handle
+	PF_LOADED		// handed out by FS_ReadFile, until FS_FreeFile
+} prefetchState_t;
+
+typedef struct {
+	prefetchState_t	state;
+	pack_t		*pack;
+	fileInPack_t	*pakFile;
+	unsigned int	dataPos;		// of the compressed data in the pk3
+	int			compressedLength;
+	qboolean	deflated;
+	unsigned int	crc;
+	int			length;
+	byte		*data;			// length + 1 bytes from malloc, NULL if it failed
+} prefetchFile_t;
+
+static	cvar_t		*fs_prefetchThreads;
+static	cvar_t		*fs_prefetchMegs;
+static	prefetchFile_t	fs_prefetch[MAX_PREFETCH_FILES];
+static	int			fs_numPrefetchReady;	// so opening files can skip the search
+static	int			fs_numPrefetchLoaded;	// and so can freeing them
+static	int			fs_prefetchBytes;
 
 static int fs_checksumFeed;
 
@@ -286,6 +377,9 @@ typedef struct {
 	int			zipFilePos;
 	int			zipFileLen;
 	qboolean	zipFile;
+	pack_t		*zipPack;		// the pk3 it's in, for mapping stored files
+	prefetchFile_t	*prefetch;		// read from memory instead of the pk3
+	int			prefetchPos;
 	char		name[MAX_ZPATH];
 } fileHandleData_t;
 
@@ -394,6 +488,21 @@ static long FS_HashFileName( const char *fname, int hashSize ) {
 	return hash;
 }
 
+/*
+================
+FS_FirstPakFile / FS_NextPakFile
+
+Walk the files of a pack with the same hash
+================
+*/
+static ID_INLINE fileInPack_t *FS_FirstPakFile( const pack_t *pak, long hash ) {
+	return pak->hashTable[hash] < 0 ? NULL : &pak->files[pak->hashTable[hash]];
+}
+
+static ID_INLINE fileInPack_t *FS_NextPakFile( const pack_t *pak, const fileInPack_t *pakFile ) {
+	return pakFile->next < 0 ? NULL : &pak->files[pakFile->next];
+}
+
 static fileHandle_t	FS_HandleForFile(void) {
 	int		i;
 
@@ -863,6 +972,43 @@ void FS_Rename( const char *from, const char *to ) {
 	rename(from_ospath, to_ospath);
 }
 
+/*
+===========
+FS_FindPrefetched
+
+Returns the inflated copy of a pk3 file if it is waiting to be read
+===========
+*/
+static prefetchFile_t *FS_FindPrefetched( pack_t *pak, fileInPack_t *pakFile ) {
+	prefetchFile_t	*pf;
+	int				i;
+
+	for ( i = 0, pf = fs_prefetch ; i < MAX_PREFETCH_FILES ; i++, pf++ ) {
+		if ( pf->state == PF_READY && pf->pakFile == pakFile && pf->pack == pak ) {
+			return pf;
+		}
+	}
+	return NULL;
+}
+
+/*
+===========
+FS_DropPrefetched
+===========
+*/
+static void FS_DropPrefetched( prefetchFile_t *pf ) {
+	if ( pf->state == PF_READY ) {
+		fs_numPrefetchReady--;
+	} else if ( pf->state == PF_LOADED ) {
+		fs_numPrefetchLoaded--;
+	}
+	if ( pf->state != PF_FREE ) {
+		fs_prefetchBytes -= pf->length + 1;
+	}
+	free( pf->data );
+	Com_Memset( pf, 0, sizeof( *pf ) );
+}
+
 /*
 ==============
 FS_FCloseFile
@@ -878,6 +1024,15 @@ void FS_FCloseFile( fileHandle_t f ) {
 		Com_Error( ERR_FATAL, "Filesystem call made without initialization" );
 	}
 
+	if ( fsh[f].prefetch ) {
+		// free it unless FS_ReadFile took the buffer
+		if ( fsh[f].prefetch->state == PF_OPEN ) {
+			FS_DropPrefetched( fsh[f].prefetch );
+		}
+		Com_Memset( &fsh[f], 0, sizeof( fsh[f] ) );
+		return;
+	}
+
 	if (fsh[f].zipFile == qtrue) {
 		unzCloseCurrentFile( fsh[f].handleFiles.file.z );
 		if ( fsh[f].handleFiles.unique ) {
@@ -1178,16 +1333,16 @@ long FS_FOpenFileReadDir(const char *filename, searchpath_t *search, fileHandle_
 		{
 			hash = FS_HashFileName(filename, search->pack->hashSize);
 
-			if(search->pack->hashTable[hash])
+			if(search->pack->hashTable[hash] >= 0)
 			{
 				// look through all the pak file elements
 				pak = search->pack;
-				pakFile = pak->hashTable[hash];
+				pakFile = FS_FirstPakFile(pak, hash);
 
 				do
 				{
 					// case and separator insensitive comparisons
-					if(!FS_FilenameCompare(pakFile->name, filename))
+					if(!FS_FilenameCompare(pak->names + pakFile->name, filename))
 					{
 						// found it!
 						if(pakFile->len)
@@ -1201,7 +1356,7 @@ long FS_FOpenFileReadDir(const char *filename, searchpath_t *search, fileHandle_
 						}
 					}
 
-					pakFile = pakFile->next;
+					pakFile = FS_NextPakFile(pak, pakFile);
 				} while(pakFile != NULL);
 			}
 		}
@@ -1235,7 +1390,7 @@ long FS_FOpenFileReadDir(const char *filename, searchpath_t *search, fileHandle_
 	{
 		hash = FS_HashFileName(filename, search->pack->hashSize);
 
-		if(search->pack->hashTable[hash])
+		if(search->pack->hashTable[hash] >= 0)
 		{
 			// disregard if it doesn't match one of the allowed pure pak files
 			if(!unpure && !FS_PakIsPure(search->pack))
@@ -1246,12 +1401,12 @@ long FS_FOpenFileReadDir(const char *filename, searchpath_t *search, fileHandle_
 
 			// look through all the pak file elements
 			pak = search->pack;
-			pakFile = pak->hashTable[hash];
+			pakFile = FS_FirstPakFile(pak, hash);
 
 			do
 			{
 				// case and separator insensitive comparisons
-				if(!FS_FilenameCompare(pakFile->name, filename))
+				if(!FS_FilenameCompare(pak->names + pakFile->name, filename))
 				{
 					// found it!
 
@@ -1282,7 +1437,13 @@ long FS_FOpenFileReadDir(const char *filename, searchpath_t *search, fileHandle_
 					if(strstr(filename, "ui.qvm"))
 						pak->referenced |= FS_UI_REF;
 
-					if(uniqueFILE)
+					if(fs_numPrefetchReady && (fsh[*file].prefetch = FS_FindPrefetched(pak, pakFile)) != NULL)
+					{
+						// already inflated, read it from memory
+						fsh[*file].prefetch->state = PF_OPEN;
+						fs_numPrefetchReady--;
+					}
+					else if(uniqueFILE)
 					{
 						// open a new file on the pakfile
 						fsh[*file].handleFiles.file.z = unzOpen(pak->pakFilename);
@@ -1295,25 +1456,29 @@ long FS_FOpenFileReadDir(const char *filename, searchpath_t *search, fileHandle_
 
 					Q_strncpyz(fsh[*file].name, filename, sizeof(fsh[*file].name));
 					fsh[*file].zipFile = qtrue;
+					fsh[*file].zipPack = pak;
 
-					// set the file position in the zip file (also sets the current file info)
-					unzSetOffset(fsh[*file].handleFiles.file.z, pakFile->pos);
+					if(!fsh[*file].prefetch)
+					{
+						// set the file position in the zip file (also sets the current file info)
+						unzSetOffset(fsh[*file].handleFiles.file.z, pakFile->pos);
 
-					// open the file in the zip
-					unzOpenCurrentFile(fsh[*file].handleFiles.file.z);
+						// open the file in the zip
+						unzOpenCurrentFile(fsh[*file].handleFiles.file.z);
+					}
 					fsh[*file].zipFilePos = pakFile->pos;
 					fsh[*file].zipFileLen = pakFile->len;
 
 					if(fs_debug->integer)
 					{
-						Com_Printf("FS_FOpenFileRead: %s (found in '%s')\n", 
-								filename, pak->pakFilename);
+						Com_Printf("FS_FOpenFileRead: %s (found in '%s'%s)\n", 
+								filename, pak->pakFilename, fsh[*file].prefetch ? ", prefetched" : "");
 					}
 
 					return pakFile->len;
 				}
 
-				pakFile = pakFile->next;
+				pakFile = FS_NextPakFile(pak, pakFile);
 			} while(pakFile != NULL);
 		}
 	}
@@ -1570,6 +1735,15 @@ int FS_Read( void *buffer, int len, fileHandle_t f ) {
 	buf = (byte *)buffer;
 	fs_readCount += len;
 
+	if ( fsh[f].prefetch ) {
+		if ( len > fsh[f].zipFileLen - fsh[f].prefetchPos ) {
+			len = fsh[f].zipFileLen - fsh[f].prefetchPos;
+		}
+		Com_Memcpy( buf, fsh[f].prefetch->data + fsh[f].prefetchPos, len );
+		fsh[f].prefetchPos += len;
+		return len;
+	}
+
 	if (fsh[f].zipFile == qfalse) {
 		remaining = len;
 		tries = 0;
@@ -1679,6 +1853,27 @@ int FS_Seek( fileHandle_t f, long offset, int origin ) {
 		return -1;
 	}
 
+	if ( fsh[f].prefetch ) {
+		switch( origin ) {
+			case FS_SEEK_CUR:
+				offset += fsh[f].prefetchPos;
+				break;
+			case FS_SEEK_END:
+				offset += fsh[f].zipFileLen;
+				break;
+			case FS_SEEK_SET:
+				break;
+			default:
+				Com_Error( ERR_FATAL, "Bad origin in FS_Seek" );
+				return -1;
+		}
+		if ( offset < 0 || offset > fsh[f].zipFileLen ) {
+			return -1;
+		}
+		fsh[f].prefetchPos = offset;
+		return 0;
+	}
+
 	if (fsh[f].zipFile == qtrue) {
 		//FIXME: this is really, really crappy
 		//(but better than what was here before)
@@ -1805,28 +2000,920 @@ int	FS_FileIsInPAK(const char *filename, int *pChecksum ) {
 			hash = FS_HashFileName(filename, search->pack->hashSize);
 		}
 		// is the element a pak file?
-		if ( search->pack && search->pack->hashTable[hash] ) {
+		if ( search->pack && search->pack->hashTable[hash] >= 0 ) {
 			// disregard if it doesn't match one of the allowed pure pak files
 			if ( !FS_PakIsPure(search->pack) ) {
 				continue;
 			}
 
-			// look through all the pak file elements
-			pak = search->pack;
-			pakFile = pak->hashTable[hash];
-			do {
-				// case and separator insensitive comparisons
-				if ( !FS_FilenameCompare( pakFile->name, filename ) ) {
-					if (pChecksum) {
-						*pChecksum = pak->pure_checksum;
-					}
-					return 1;
-				}
-				pakFile = pakFile->next;
-			} while(pakFile != NULL);
+			// look through all the pak file elements
+			pak = search->pack;
+			pakFile = FS_FirstPakFile( pak, hash );
+			do {
+				// case and separator insensitive comparisons
+				if ( !FS_FilenameCompare( pak->names + pakFile->name, filename ) ) {
+					if (pChecksum) {
+						*pChecksum = pak->pure_checksum;
+					}
+					return 1;
+				}
+				pakFile = FS_NextPakFile( pak, pakFile );
+			} while(pakFile != NULL);
+		}
+	}
+	return -1;
+}
+
+/*
+================
+FS_FileSource
+
+Finds where FS_FOpenFileRead would open a file from, without opening it.
+Returns NULL if it wouldn't find it, and sets *pakFile if it is in a pk3.
+================
+*/
+static searchpath_t *FS_FileSource( const char *filename, fileInPack_t **pakFile ) {
+	searchpath_t	*search;
+	fileInPack_t	*file;
+	long			hash;
+
+	*pakFile = NULL;
+
+	for ( search = fs_searchpaths ; search ; search = search->next ) {
+		if ( search->pack ) {
+			hash = FS_HashFileName( filename, search->pack->hashSize );
+			if ( search->pack->hashTable[hash] < 0 ) {
+				continue;
+			}
+			for ( file = FS_FirstPakFile( search->pack, hash ) ; file ; file = FS_NextPakFile( search->pack, file ) ) {
+				if ( !FS_FilenameCompare( search->pack->names + file->name, filename ) ) {
+					break;
+				}
+			}
+			if ( file && FS_PakIsPure( search->pack ) ) {
+				*pakFile = file;
+				return search;
+			}
+		} else if ( search->dir && !fs_numServerPaks ) {
+			if ( FS_FOpenFileReadDir( filename, search, NULL, qfalse, qfalse ) > 0 ) {
+				return search;
+			}
+		}
+	}
+
+	return NULL;
+}
+
+/*
+==========================================================================
+
+PREFETCH
+
+Loading a map reads its textures, models and sounds one after another
+through FS_ReadFile, and inflating the ones that are in pk3s is most of
+that time.  Before anything is registered, FS_PrefetchMap finds what the
+bsp, the models of the map and their surfaces will ask for, and inflates
+all of it at once on the job threads.  The next FS_ReadFile or
+FS_FOpenFileRead of one of those files is given the inflated copy instead
+of reading the pk3 again, and FS_ClearPrefetch frees whatever wasn't asked
+for once the map is loaded.
+
+Only files the search path would take from a pk3 are prefetched, and not
+stored ones that are big enough to be mapped.  Jobs only read the pk3 with
+stdio and inflate it with zlib into memory from malloc, everything that
+touches the search path or the zone happens on the main thread between
+batches.
+
+fs_prefetchThreads is 0 by default: on the only load measured so far,
+prefetching made it slower (442 msec against 412), and the big stored
+files that dominate many pk3s are mapped and never go through it.
+
+==========================================================================
+*/
+
+/*
+================
+FS_PrefetchJob
+================
+*/
+static void FS_PrefetchJob( void *data, int job ) {
+	prefetchFile_t	*pf;
+	z_stream		stream;
+	byte			*in;
+	FILE			*f;
+	qboolean		ok;
+
+	pf = ( (prefetchFile_t **)data )[job];
+	pf->data = malloc( pf->length + 1 );
+	if ( !pf->data ) {
+		return;
+	}
+
+	ok = qfalse;
+	f = Sys_FOpen( pf->pack->pakFilename, "rb" );
+	if ( f && !fseek( f, pf->dataPos, SEEK_SET ) ) {
+		if ( !pf->deflated ) {
+			ok = fread( pf->data, 1, pf->length, f ) == pf->length;
+		} else {
+			in = malloc( pf->compressedLength );
+			if ( in && fread( in, 1, pf->compressedLength, f ) == pf->compressedLength ) {
+				Com_Memset( &stream, 0, sizeof( stream ) );
+				if ( inflateInit2( &stream, -MAX_WBITS ) == Z_OK ) {
+					stream.next_in = in;
+					stream.avail_in = pf->compressedLength;
+					stream.next_out = pf->data;
+					stream.avail_out = pf->length;
+					ok = inflate( &stream, Z_FINISH ) == Z_STREAM_END && stream.total_out == pf->length;
+					inflateEnd( &stream );
+				}
+			}
+			free( in );
+		}
+	}
+	if ( f ) {
+		fclose( f );
+	}
+
+	if ( ok && crc32( 0, pf->data, pf->length ) != pf->crc ) {
+		ok = qfalse;
+	}
+	if ( !ok ) {
+		free( pf->data );
+		pf->data = NULL;
+		return;
+	}
+	pf->data[pf->length] = 0;
+}
+
+/*
+================
+FS_QueuePrefetch
+
+Returns qfalse if the file doesn't exist
+================
+*/
+static qboolean FS_QueuePrefetch( const char *filename ) {
+	prefetchFile_t	*pf, *slot;
+	unz_file_info	info;
+	searchpath_t	*search;
+	pack_t			*pak;
+	fileInPack_t	*pakFile;
+	uLong			pos;
+	int				i;
+
+	if ( !filename[0] || filename[0] == '*' ) {
+		return qfalse;
+	}
+	search = FS_FileSource( filename, &pakFile );
+	if ( !search ) {
+		return qfalse;
+	}
+	if ( !search->pack || pakFile->len <= 0 ) {
+		return qtrue;
+	}
+	pak = search->pack;
+	if ( fs_prefetchBytes + pakFile->len + 1 > fs_prefetchMegs->integer * 1024 * 1024 ) {
+		return qtrue;
+	}
+
+	slot = NULL;
+	for ( i = 0, pf = fs_prefetch ; i < MAX_PREFETCH_FILES ; i++, pf++ ) {
+		if ( pf->state == PF_FREE ) {
+			if ( !slot ) {
+				slot = pf;
+			}
+		} else if ( pf->pakFile == pakFile && pf->pack == pak ) {
+			return qtrue;
+		}
+	}
+	if ( !slot ) {
+		return qtrue;
+	}
+
+	unzSetOffset( pak->handle, pakFile->pos );
+	if ( unzOpenCurrentFile( pak->handle ) != UNZ_OK ) {
+		return qtrue;
+	}
+	if ( unzGetCurrentFileInfo( pak->handle, &info, NULL, 0, NULL, 0, NULL, 0 ) != UNZ_OK
+		|| unzGetCurrentFileDataPos( pak->handle, &pos ) != UNZ_OK
+		|| info.uncompressed_size != pakFile->len
+		|| ( !info.compression_method && fs_mapFiles->integer && pakFile->len >= MIN_MAPPED_SIZE ) ) {
+		unzCloseCurrentFile( pak->handle );
+		return qtrue;
+	}
+	unzCloseCurrentFile( pak->handle );
+
+	slot->state = PF_QUEUED;
+	slot->pack = pak;
+	slot->pakFile = pakFile;
+	slot->dataPos = pos;
+	slot->compressedLength = info.compressed_size;
+	slot->deflated = info.compression_method != 0;
+	slot->crc = info.crc;
+	slot->length = pakFile->len;
+	fs_prefetchBytes += slot->length + 1;
+
+	return qtrue;
+}
+
+/*
+================
+FS_PrefetchImage
+
+Queues the first image the renderer would find for a shader or skin name
+================
+*/
+static void FS_PrefetchImage( const char *name ) {
+	static const char	*extensions[] = { "png", "tga", "jpg" };
+	char	base[MAX_QPATH];
+	int		i;
+
+	if ( *COM_GetExtension( name ) && FS_QueuePrefetch( name ) ) {
+		return;
+	}
+
+	COM_StripExtension( name, base, sizeof( base ) );
+	for ( i = 0 ; i < ARRAY_LEN( extensions ) ; i++ ) {
+		if ( FS_QueuePrefetch( va( "%s.%s", base, extensions[i] ) ) ) {
+			return;
+		}
+	}
+}
+
+/*
+================
+FS_RunPrefetch
+
+Inflates everything that was queued, returns how many were
+================
+*/
+static int FS_RunPrefetch( void ) {
+	static prefetchFile_t	*queued[MAX_PREFETCH_FILES];
+	prefetchFile_t	*pf;
+	int				i, numQueued;
+
+	numQueued = 0;
+	for ( i = 0, pf = fs_prefetch ; i < MAX_PREFETCH_FILES ; i++, pf++ ) {
+		if ( pf->state == PF_QUEUED ) {
+			queued[numQueued++] = pf;
+		}
+	}
+
+	Com_RunJobs( FS_PrefetchJob, queued, numQueued, fs_prefetchThreads->integer );
+
+	for ( i = 0 ; i < numQueued ; i++ ) {
+		if ( queued[i]->data ) {
+			queued[i]->state = PF_READY;
+			fs_numPrefetchReady++;
+		} else {
+			FS_DropPrefetched( queued[i] );
+		}
+	}
+
+	return numQueued;
+}
+
+/*
+================
+FS_PrefetchBspAssets
+
+Queues the images of the shaders a bsp uses, and the models and sounds
+named by its entities
+================
+*/
+static void FS_PrefetchBspAssets( const byte *data, int length ) {
+	const dheader_t	*header;
+	const dshader_t	*shader;
+	char			key[MAX_TOKEN_CHARS];
+	char			*entities, *text, *token;
+	int				ofs, len, i;
+
+	header = (const dheader_t *)data;
+	if ( length < (int)sizeof( *header ) || LittleLong( header->ident ) != BSP_IDENT
+		|| LittleLong( header->version ) != BSP_VERSION ) {
+		return;
+	}
+
+	ofs = LittleLong( header->lumps[LUMP_SHADERS].fileofs );
+	len = LittleLong( header->lumps[LUMP_SHADERS].filelen );
+	if ( ofs >= 0 && len >= 0 && ofs <= length - len ) {
+		shader = (const dshader_t *)( data + ofs );
+		for ( i = 0 ; i < len / (int)sizeof( *shader ) ; i++, shader++ ) {
+			if ( !memchr( shader->shader, 0, sizeof( shader->shader ) ) ) {
+				continue;
+			}
+			FS_PrefetchImage( shader->shader );
+		}
+	}
+
+	ofs = LittleLong( header->lumps[LUMP_ENTITIES].fileofs );
+	len = LittleLong( header->lumps[LUMP_ENTITIES].filelen );
+	if ( ofs < 0 || len <= 0 || ofs > length - len ) {
+		return;
+	}
+
+	// COM_Parse needs it terminated
+	entities = Hunk_AllocateTempMemory( len + 1 );
+	Com_Memcpy( entities, data + ofs, len );
+	entities[len] = 0;
+
+	text = entities;
+	while ( 1 ) {
+		token = COM_Parse( &text );
+		if ( !token[0] ) {
+			break;
+		}
+		if ( token[0] == '{' || token[0] == '}' ) {
+			continue;
+		}
+		Q_strncpyz( key, token, sizeof( key ) );
+		token = COM_Parse( &text );
+		if ( !Q_stricmp( key, "model" ) || !Q_stricmp( key, "model2" ) || !Q_stricmp( key, "noise" ) ) {
+			FS_QueuePrefetch( token );
+		}
+	}
+
+	Hunk_FreeTempMemory( entities );
+}
+
+/*
+================
+FS_PrefetchModelSkins
+
+Queues the images an md3 names for its surfaces
+================
+*/
+static void FS_PrefetchModelSkins( const byte *data, int length ) {
+	const md3Header_t	*header;
+	const md3Surface_t	*surf;
+	const md3Shader_t	*shader;
+	int					ofs, numShaders, i, j;
+
+	header = (const md3Header_t *)data;
+	if ( length < (int)sizeof( *header ) || LittleLong( header->ident ) != MD3_IDENT
+		|| LittleLong( header->version ) != MD3_VERSION ) {
+		return;
+	}
+
+	ofs = LittleLong( header->ofsSurfaces );
+	for ( i = 0 ; i < LittleLong( header->numSurfaces ) && i < MD3_MAX_SURFACES ; i++ ) {
+		if ( ofs < 0 || ofs > length - (int)sizeof( *surf ) ) {
+			return;
+		}
+		surf = (const md3Surface_t *)( data + ofs );
+
+		numShaders = LittleLong( surf->numShaders );
+		shader = (const md3Shader_t *)( (const byte *)surf + LittleLong( surf->ofsShaders ) );
+		if ( numShaders < 0 || LittleLong( surf->ofsShaders ) < 0
+			|| LittleLong( surf->ofsShaders ) > length - ofs - numShaders * (int)sizeof( *shader ) ) {
+			return;
+		}
+		for ( j = 0 ; j < numShaders ; j++, shader++ ) {
+			if ( memchr( shader->name, 0, sizeof( shader->name ) ) ) {
+				FS_PrefetchImage( shader->name );
+			}
+		}
+
+		if ( LittleLong( surf->ofsEnd ) <= 0 ) {
+			return;
+		}
+		ofs += LittleLong( surf->ofsEnd );
+	}
+}
+
+/*
+================
+FS_PrefetchMap
+
+Inflates the bsp, then what it and names (models and sounds, from the
+configstrings) use, then the skins of those models.  Nothing is done if
+fs_prefetchThreads is 0, since the same files would only be inflated one
+after another ahead of time instead of when they are registered.
+================
+*/
+void FS_PrefetchMap( const char *bspName, const char **names, int numNames ) {
+	prefetchFile_t	*pf;
+	searchpath_t	*search;
+	fileInPack_t	*pakFile;
+	int				start, numFiles, i;
+
+	if ( !fs_searchpaths ) {
+		Com_Error( ERR_FATAL, "Filesystem call made without initialization" );
+	}
+	if ( fs_prefetchThreads->integer <= 0 || fs_prefetchMegs->integer <= 0 ) {
+		return;
+	}
+
+	start = Sys_Milliseconds();
+
+	// whatever an earlier load left behind, if it didn't get to clear it
+	FS_ClearPrefetch();
+
+	FS_QueuePrefetch( bspName );
+	numFiles = FS_RunPrefetch();
+
+	search = FS_FileSource( bspName, &pakFile );
+	if ( search && search->pack && ( pf = FS_FindPrefetched( search->pack, pakFile ) ) != NULL ) {
+		FS_PrefetchBspAssets( pf->data, pf->length );
+	}
+	for ( i = 0 ; i < numNames ; i++ ) {
+		FS_QueuePrefetch( names[i] );
+	}
+	numFiles += FS_RunPrefetch();
+
+	for ( i = 0, pf = fs_prefetch ; i < MAX_PREFETCH_FILES ; i++, pf++ ) {
+		if ( pf->state == PF_READY ) {
+			FS_PrefetchModelSkins( pf->data, pf->length );
+		}
+	}
+	numFiles += FS_RunPrefetch();
+
+	Com_Printf( "FS_PrefetchMap: %i files, %i KB in %i msec\n", numFiles,
+		fs_prefetchBytes / 1024, Sys_Milliseconds() - start );
+}
+
+/*
+================
+FS_ClearPrefetch
+
+Frees the prefetched files nobody asked for.  Ones that are open or were
+handed out are freed when they are closed or freed.
+================
+*/
+void FS_ClearPrefetch( void ) {
+	prefetchFile_t	*pf;
+	int				i, unused;
+
+	unused = 0;
+	for ( i = 0, pf = fs_prefetch ; i < MAX_PREFETCH_FILES ; i++, pf++ ) {
+		if ( pf->state == PF_READY ) {
+			FS_DropPrefetched( pf );
+			unused++;
+		}
+	}
+
+	if ( unused ) {
+		Com_DPrintf( "FS_ClearPrefetch: %i prefetched files weren't used\n", unused );
+	}
+}
+
+/*
+================
+FS_ListPrefetched
+
+Names of the prefetched files that are waiting to be read, for prefetchbench
+================
+*/
+int FS_ListPrefetched( const char **names, int maxNames ) {
+	prefetchFile_t	*pf;
+	int				i, numNames;
+
+	numNames = 0;
+	for ( i = 0, pf = fs_prefetch ; i < MAX_PREFETCH_FILES && numNames < maxNames ; i++, pf++ ) {
+		if ( pf->state == PF_READY ) {
+			names[numNames++] = pf->pack->names + pf->pakFile->name;
+		}
+	}
+	return numNames;
+}
+
+/*
+================
+FS_FreePrefetchedFile
+
+Returns qfalse if the buffer wasn't handed out by FS_ReadFile from the
+prefetched files
+================
+*/
+static qboolean FS_FreePrefetchedFile( void *buffer ) {
+	prefetchFile_t	*pf;
+	int				i;
+
+	if ( !fs_numPrefetchLoaded ) {
+		return qfalse;
+	}
+	for ( i = 0, pf = fs_prefetch ; i < MAX_PREFETCH_FILES ; i++, pf++ ) {
+		if ( pf->state == PF_LOADED && pf->data == buffer ) {
+			FS_DropPrefetched( pf );
+			return qtrue;
+		}
+	}
+	return qfalse;
+}
+
+/*
+==========================================================================
+
+ASSET CACHE
+
+Decoding images and sounds takes much longer than reading them, so when
+fs_assetCache is set the renderer and the sound codecs keep what they
+decoded in ASSETCACHE_DIR in fs_homepath, and look there before decoding
+the same file again.  An entry is keyed by the kind of data, the path, and
+where FS_FOpenFileRead would get the file from: the checksum of its pk3,
+or the size and modification time of a file in a directory.  A changed
+pk3 or file never matches an old entry.  The file name is a hash of the
+key, and the whole key is kept in the entry, so a collision is only a miss.
+
+Entries are written to a temporary file that is then renamed, so a crash
+can't leave a partial one behind.  When the cache grows past
+fs_assetCacheMegs the entries written longest ago are removed until it is
+down to three quarters of that.
+
+==========================================================================
+*/
+
+#define	ASSETCACHE_IDENT	(('H'<<24)+('C'<<16)+('S'<<8)+'A')
+#define	ASSETCACHE_VERSION	1
+#define	ASSETCACHE_DIR		"assetcache"
+#define	MAX_ASSETCACHE_KEY	( MAX_QPATH * 2 )
+#define	MAX_ASSETCACHE_INFO	256
+
+typedef struct {
+	int			ident;
+	int			version;
+	int			keyLength;
+	int			infoSize;
+	int			dataLength;
+} assetCacheHeader_t;
+
+typedef struct {
+	char		ospath[MAX_OSPATH];
+	int64_t		size;
+	int64_t		time;
+} assetCacheFile_t;
+
+static	cvar_t		*fs_assetCache;
+static	cvar_t		*fs_assetCacheMegs;
+
+static struct {
+	int			hits;
+	int			misses;
+	int			writes;
+	int			removed;
+	int			errors;
+	int64_t		bytesRead;
+	int64_t		bytesWritten;
+	int			msecRead;
+	int			numFiles;		// in the directory, -1 until they are counted
+	int64_t		size;
+} fs_cacheStats = { 0, 0, 0, 0, 0, 0, 0, 0, -1, 0 };
+
+/*
+================
+FS_AssetCacheKey
+
+Returns qfalse if the file isn't there to be cached
+================
+*/
+static qboolean FS_AssetCacheKey( const char *qpath, const char *kind, char *key, char *ospath ) {
+	searchpath_t	*search;
+	fileInPack_t	*pakFile;
+	int64_t			size, time;
+
+	if ( !fs_homepath->string[0] ) {
+		return qfalse;
+	}
+	search = FS_FileSource( qpath, &pakFile );
+	if ( !search ) {
+		return qfalse;
+	}
+
+	if ( search->pack ) {
+		Com_sprintf( key, MAX_ASSETCACHE_KEY, "%s %s %08x %u", kind, qpath,
+			search->pack->checksum, pakFile->len );
+	} else {
+		if ( !Sys_StatFile( FS_BuildOSPath( search->dir->path, search->dir->gamedir, qpath ), &size, &time ) ) {
+			return qfalse;
+		}
+		Com_sprintf( key, MAX_ASSETCACHE_KEY, "%s %s %lld %lld", kind, qpath,
+			(long long)size, (long long)time );
+	}
+
+	Q_strncpyz( ospath, FS_BuildOSPath( fs_homepath->string, ASSETCACHE_DIR,
+		va( "%08x.cache", Com_BlockChecksum( key, strlen( key ) ) ) ), MAX_OSPATH );
+	return qtrue;
+}
+
+/*
+================
+FS_ListAssetCache
+
+Returns the entries in the cache directory with their sizes and times,
+from Z_Malloc
+================
+*/
+static assetCacheFile_t *FS_ListAssetCache( int *numFiles ) {
+	assetCacheFile_t	*files;
+	char				dir[MAX_OSPATH];
+	char				**list;
+	int					i, numListed;
+
+	Q_strncpyz( dir, FS_BuildOSPath( fs_homepath->string, ASSETCACHE_DIR, "" ), sizeof( dir ) );
+	list = Sys_ListFiles( dir, ".cache", NULL, &numListed, qfalse );
+
+	files = Z_Malloc( ( numListed + 1 ) * sizeof( *files ) );
+	*numFiles = 0;
+	for ( i = 0 ; i < numListed ; i++ ) {
+		Com_sprintf( files[*numFiles].ospath, sizeof( files[*numFiles].ospath ), "%s%s", dir, list[i] );
+		if ( Sys_StatFile( files[*numFiles].ospath, &files[*numFiles].size, &files[*numFiles].time ) ) {
+			( *numFiles )++;
+		}
+	}
+
+	Sys_FreeFileList( list );
+	return files;
+}
+
+/*
+================
+FS_CountAssetCache
+================
+*/
+static void FS_CountAssetCache( void ) {
+	assetCacheFile_t	*files;
+	int					i, numFiles;
+
+	files = FS_ListAssetCache( &numFiles );
+	fs_cacheStats.size = 0;
+	for ( i = 0 ; i < numFiles ; i++ ) {
+		fs_cacheStats.size += files[i].size;
+	}
+	fs_cacheStats.numFiles = numFiles;
+	Z_Free( files );
+}
+
+static int FS_CompareAssetCacheTimes( const void *a, const void *b ) {
+	int64_t	ta = ( (const assetCacheFile_t *)a )->time;
+	int64_t	tb = ( (const assetCacheFile_t *)b )->time;
+
+	return ta < tb ? -1 : ta > tb;
+}
+
+/*
+================
+FS_TrimAssetCache
+
+Removes the oldest entries until the cache is no bigger than size
+================
+*/
+static void FS_TrimAssetCache( int64_t size ) {
+	assetCacheFile_t	*files;
+	int					i, numFiles;
+
+	files = FS_ListAssetCache( &numFiles );
+	qsort( files, numFiles, sizeof( *files ), FS_CompareAssetCacheTimes );
+
+	fs_cacheStats.size = 0;
+	for ( i = 0 ; i < numFiles ; i++ ) {
+		fs_cacheStats.size += files[i].size;
+	}
+	fs_cacheStats.numFiles = numFiles;
+
+	for ( i = 0 ; i < numFiles && fs_cacheStats.size > size ; i++ ) {
+		if ( !remove( files[i].ospath ) ) {
+			fs_cacheStats.size -= files[i].size;
+			fs_cacheStats.numFiles--;
+			fs_cacheStats.removed++;
+		}
+	}
+
+	Z_Free( files );
+}
+
+/*
+================
+FS_ReadAssetCache
+
+Returns the data cached for a file, from alloc, and fills in info, which
+must be the same size it was written with.  Returns NULL if there is
+nothing cached for the file as it is now.
+================
+*/
+void *FS_ReadAssetCache( const char *qpath, const char *kind, void *info, int infoSize, int *length,
+	void *(*alloc)( int size ), void (*release)( void *data ) ) {
+	assetCacheHeader_t	header;
+	char				key[MAX_ASSETCACHE_KEY], ospath[MAX_OSPATH];
+	char				fileKey[MAX_ASSETCACHE_KEY];
+	byte				fileInfo[MAX_ASSETCACHE_INFO];
+	void				*data;
+	FILE				*f;
+	int					start, keyLength;
+
+	if ( !fs_searchpaths ) {
+		Com_Error( ERR_FATAL, "Filesystem call made without initialization" );
+	}
+	if ( !fs_assetCache->integer || infoSize > MAX_ASSETCACHE_INFO ) {
+		return NULL;
+	}
+	if ( !FS_AssetCacheKey( qpath, kind, key, ospath ) ) {
+		return NULL;
+	}
+
+	start = Sys_Milliseconds();
+	f = Sys_FOpen( ospath, "rb" );
+	if ( !f ) {
+		fs_cacheStats.misses++;
+		return NULL;
+	}
+
+	keyLength = strlen( key );
+	if ( fread( &header, sizeof( header ), 1, f ) != 1
+		|| LittleLong( header.ident ) != ASSETCACHE_IDENT
+		|| LittleLong( header.version ) != ASSETCACHE_VERSION
+		|| LittleLong( header.keyLength ) != keyLength
+		|| LittleLong( header.infoSize ) != infoSize
+		|| LittleLong( header.dataLength ) < 0
+		|| FS_fplength( f ) != sizeof( header ) + keyLength + infoSize + LittleLong( header.dataLength )
+		|| fread( fileKey, keyLength, 1, f ) != 1
+		|| memcmp( fileKey, key, keyLength )
+		|| ( infoSize && fread( fileInfo, infoSize, 1, f ) != 1 ) ) {
+		fclose( f );
+		fs_cacheStats.misses++;
+		return NULL;
+	}
+
+	*length = LittleLong( header.dataLength );
+	data = alloc( *length );
+	if ( *length && fread( data, *length, 1, f ) != 1 ) {
+		fclose( f );
+		release( data );
+		fs_cacheStats.errors++;
+		fs_cacheStats.misses++;
+		return NULL;
+	}
+	fclose( f );
+
+	Com_Memcpy( info, fileInfo, infoSize );
+	fs_cacheStats.hits++;
+	fs_cacheStats.bytesRead += *length;
+	fs_cacheStats.msecRead += Sys_Milliseconds() - start;
+	return data;
+}
+
+/*
+================
+FS_WriteAssetCache
+
+Keeps what was decoded from a file, info is anything that goes along with
+the data, like the size of an image
+================
+*/
+void FS_WriteAssetCache( const char *qpath, const char *kind, const void *info, int infoSize,
+	const void *data, int length ) {
+	assetCacheHeader_t	header;
+	char				key[MAX_ASSETCACHE_KEY], ospath[MAX_OSPATH], tmppath[MAX_OSPATH];
+	int64_t				oldSize, time, limit;
+	qboolean			ok;
+	FILE				*f;
+
+	if ( !fs_searchpaths ) {
+		Com_Error( ERR_FATAL, "Filesystem call made without initialization" );
+	}
+	if ( !fs_assetCache->integer || infoSize > MAX_ASSETCACHE_INFO || length < 0 ) {
+		return;
+	}
+	if ( !FS_AssetCacheKey( qpath, kind, key, ospath ) ) {
+		return;
+	}
+	if ( fs_cacheStats.numFiles < 0 ) {
+		FS_CountAssetCache();
+	}
+
+	Com_sprintf( tmppath, sizeof( tmppath ), "%s.tmp", ospath );
+	if ( FS_CreatePath( tmppath ) ) {
+		return;
+	}
+
+	header.ident = LittleLong( ASSETCACHE_IDENT );
+	header.version = LittleLong( ASSETCACHE_VERSION );
+	header.keyLength = LittleLong( strlen( key ) );
+	header.infoSize = LittleLong( infoSize );
+	header.dataLength = LittleLong( length );
+
+	ok = qfalse;
+	f = Sys_FOpen( tmppath, "wb" );
+	if ( f ) {
+		ok = fwrite( &header, sizeof( header ), 1, f ) == 1;
+		ok &= fwrite( key, strlen( key ), 1, f ) == 1;
+		ok &= !infoSize || fwrite( info, infoSize, 1, f ) == 1;
+		ok &= !length || fwrite( data, length, 1, f ) == 1;
+		ok &= fclose( f ) == 0;
+	}
+
+	// a colliding or stale entry is replaced
+	if ( ok && Sys_StatFile( ospath, &oldSize, &time ) ) {
+		if ( !remove( ospath ) ) {
+			fs_cacheStats.size -= oldSize;
+			fs_cacheStats.numFiles--;
+		}
+	}
+	if ( !ok || rename( tmppath, ospath ) ) {
+		remove( tmppath );
+		fs_cacheStats.errors++;
+		return;
+	}
+
+	fs_cacheStats.writes++;
+	fs_cacheStats.bytesWritten += length;
+	fs_cacheStats.numFiles++;
+	fs_cacheStats.size += sizeof( header ) + strlen( key ) + infoSize + length;
+
+	limit = (int64_t)fs_assetCacheMegs->integer * 1024 * 1024;
+	if ( fs_cacheStats.size > limit ) {
+		FS_TrimAssetCache( limit / 4 * 3 );
+	}
+}
+
+/*
+================
+FS_AssetCache_f
+================
+*/
+static void FS_AssetCache_f( void ) {
+	if ( !fs_homepath->string[0] ) {
+		Com_Printf( "no fs_homepath for the asset cache\n" );
+		return;
+	}
+	if ( !Q_stricmp( Cmd_Argv( 1 ), "clear" ) ) {
+		FS_TrimAssetCache( 0 );
+		Com_Printf( "%i files left in the asset cache\n", fs_cacheStats.numFiles );
+		return;
+	}
+	if ( Cmd_Argc() > 1 ) {
+		Com_Printf( "usage: fs_assetcache [clear]\n" );
+		return;
+	}
+
+	if ( fs_cacheStats.numFiles < 0 ) {
+		FS_CountAssetCache();
+	}
+
+	Com_Printf( "asset cache is %s, %i files, %.1f of %i MB\n", fs_assetCache->integer ? "on" : "off",
+		fs_cacheStats.numFiles, fs_cacheStats.size / ( 1024.0f * 1024.0f ), fs_assetCacheMegs->integer );
+	Com_Printf( "%i hits, %i misses, %i written, %i removed, %i errors\n", fs_cacheStats.hits,
+		fs_cacheStats.misses, fs_cacheStats.writes, fs_cacheStats.removed, fs_cacheStats.errors );
+	Com_Printf( "%.1f MB read in %i msec, %.1f MB written\n", fs_cacheStats.bytesRead / ( 1024.0f * 1024.0f ),
+		fs_cacheStats.msecRead, fs_cacheStats.bytesWritten / ( 1024.0f * 1024.0f ) );
+}
+
+/*
+============
+FS_MapStoredFile
+
+Maps a file that is stored in a pk3 without compression, along with the
+byte after it, which is a zip header and can be set to the trailing 0.  The
+mapping is copy on write and only of this file, so the buffer can be
+changed like a read one.  Returns NULL if the file should be read instead.
+============
+*/
+static byte *FS_MapStoredFile( fileHandle_t h, int len ) {
+	mappedFile_t	*mf;
+	uLong			pos;
+	int				i;
+
+	if ( !fs_mapFiles->integer || !fsh[h].zipFile || fsh[h].prefetch || len < MIN_MAPPED_SIZE ) {
+		return NULL;
+	}
+	if ( unzGetCurrentFileStoredPos( fsh[h].handleFiles.file.z, &pos ) != UNZ_OK ) {
+		return NULL;
+	}
+
+	for ( i = 0, mf = fs_mappedFiles ; i < MAX_MAPPED_FILES ; i++, mf++ ) {
+		if ( !mf->data ) {
+			break;
+		}
+	}
+	if ( i == MAX_MAPPED_FILES ) {
+		return NULL;
+	}
+
+	mf->data = Sys_MapFileRange( fsh[h].zipPack->pakFilename, pos, len + 1, &mf->base, &mf->length );
+	if ( mf->data && fs_debug->integer ) {
+		Com_Printf( "FS_MapStoredFile: %s\n", fsh[h].name );
+	}
+	return mf->data;
+}
+
+/*
+============
+FS_UnmapStoredFile
+
+Returns qfalse if the buffer wasn't mapped
+============
+*/
+static qboolean FS_UnmapStoredFile( void *buffer ) {
+	mappedFile_t	*mf;
+	int				i;
+
+	for ( i = 0, mf = fs_mappedFiles ; i < MAX_MAPPED_FILES ; i++, mf++ ) {
+		if ( mf->data == buffer ) {
+			Sys_UnmapFile( mf->base, mf->length );
+			Com_Memset( mf, 0, sizeof( *mf ) );
+			return qtrue;
 		}
 	}
-	return -1;
+	return qfalse;
 }
 
 /*
@@ -1941,11 +3028,20 @@ long FS_ReadFileDir(const char *qpath, void *searchPath, qboolean unpure, void *
 	fs_loadCount++;
 	fs_loadStack++;
 
-	buf = Hunk_AllocateTempMemory(len+1);
+	if ( fsh[h].prefetch ) {
+		// inflated on the job threads already, hand the buffer over
+		buf = fsh[h].prefetch->data;
+		fsh[h].prefetch->state = PF_LOADED;
+		fs_numPrefetchLoaded++;
+	} else {
+		buf = FS_MapStoredFile( h, len );
+	}
+	if ( !buf ) {
+		buf = Hunk_AllocateTempMemory(len+1);
+		FS_Read (buf, len, h);
+	}
 	*buffer = buf;
 
-	FS_Read (buf, len, h);
-
 	// guarantee that it will have a trailing 0 for string operations
 	buf[len] = 0;
 	FS_FCloseFile( h );
@@ -1987,7 +3083,9 @@ void FS_FreeFile( void *buffer ) {
 	}
 	fs_loadStack--;
 
-	Hunk_FreeTempMemory( buffer );
+	if ( !FS_FreePrefetchedFile( buffer ) && !FS_UnmapStoredFile( buffer ) ) {
+		Hunk_FreeTempMemory( buffer );
+	}
 
 	// if all of our temp files are free, clear all of our space
 	if ( fs_loadStack == 0 ) {
@@ -2026,6 +3124,322 @@ void FS_WriteFile( const char *qpath, const void *buffer, int size ) {
 
 
 
+/*
+==========================================================================
+
+PAK INDEX
+
+The central directories of all pk3s that were loaded at the last startup
+are kept in PAKINDEX_NAME in fs_homepath, in the same layout pack_t uses for
+them.  At startup the index is mapped, and a pk3 that is in it with the
+same size and modification time gets its file list and hash table straight
+from the mapping, so its directory isn't read and nothing is allocated or
+hashed per file.  Pure checksums depend on fs_checksumFeed, so the crcs
+they are made from are kept instead of the checksums.
+
+When any pk3 had to be read, the index is written again after startup, to
+a temporary file that replaces it at the next startup, since the old one
+is still mapped until the packs that use it are freed.  Entries of pk3s
+that weren't loaded this time, like those of other mods, are carried over
+as long as the pk3 is still there unchanged.
+
+==========================================================================
+*/
+
+/*
+=================
+FS_ClosePakIndex
+=================
+*/
+static void FS_ClosePakIndex( pakIndex_t *index ) {
+	if ( index->base ) {
+		Sys_UnmapFile( index->base, index->length );
+	}
+	Com_Memset( index, 0, sizeof( *index ) );
+}
+
+/*
+=================
+FS_OpenPakIndex
+
+Maps the index at ospath if there is a valid one, and starts counting the
+pk3s that miss it
+=================
+*/
+static void FS_OpenPakIndex( pakIndex_t *index, const char *ospath ) {
+	const pakIndexHeader_t	*header;
+	char		tmppath[MAX_OSPATH];
+	int64_t		size, time;
+
+	Com_Memset( index, 0, sizeof( *index ) );
+	Q_strncpyz( index->ospath, ospath, sizeof( index->ospath ) );
+
+	// a newer index was written while this one was mapped
+	Com_sprintf( tmppath, sizeof( tmppath ), "%s.tmp", ospath );
+	if ( Sys_StatFile( tmppath, &size, &time ) ) {
+		remove( ospath );
+		rename( tmppath, ospath );
+	}
+
+	index->base = Sys_MapFile( ospath, &index->length );
+	if ( !index->base ) {
+		return;
+	}
+
+	header = (const pakIndexHeader_t *)index->base;
+	if ( index->length < sizeof( *header ) || header->ident != PAKINDEX_IDENT
+		|| header->version != PAKINDEX_VERSION || header->length != index->length
+		|| header->numPaks < 0
+		|| header->numPaks > ( index->length - sizeof( *header ) ) / sizeof( pakIndexEntry_t ) ) {
+		Com_Printf( "WARNING: ignoring bad pak index %s\n", ospath );
+		Sys_UnmapFile( index->base, index->length );
+		index->base = NULL;
+		index->length = 0;
+	}
+}
+
+/*
+=================
+FS_IndexRegion
+
+Checks that count things of size bytes at ofs are in the index
+=================
+*/
+static qboolean FS_IndexRegion( const pakIndex_t *index, int ofs, int count, int size ) {
+	if ( ofs < sizeof( pakIndexHeader_t ) || ( ofs & 3 ) || count < 0 ) {
+		return qfalse;
+	}
+	return (int64_t)ofs + (int64_t)count * size <= index->length;
+}
+
+/*
+=================
+FS_IndexedPakIsValid
+
+The index is only written by us, but it's read from disk, so make sure
+it can't send a lookup outside of it or around a hash chain forever
+=================
+*/
+static qboolean FS_IndexedPakIsValid( const pakIndex_t *index, const pakIndexEntry_t *entry ) {
+	const int			*hashTable;
+	const fileInPack_t	*files;
+	int					i;
+
+	if ( entry->hashSize < 1 || entry->hashSize > MAX_FILEHASH_SIZE || ( entry->hashSize & ( entry->hashSize - 1 ) )
+		|| !FS_IndexRegion( index, entry->hashTable, entry->hashSize, sizeof( int ) )
+		|| !FS_IndexRegion( index, entry->files, entry->numFiles, sizeof( fileInPack_t ) )
+		|| !FS_IndexRegion( index, entry->crcs, entry->numCrcs, sizeof( int ) )
+		|| !FS_IndexRegion( index, entry->names, entry->namesLength, 1 ) ) {
+		return qfalse;
+	}
+	if ( entry->numFiles && ( !entry->namesLength || index->base[entry->names + entry->namesLength - 1] ) ) {
+		return qfalse;
+	}
+
+	hashTable = (const int *)( index->base + entry->hashTable );
+	for ( i = 0 ; i < entry->hashSize ; i++ ) {
+		if ( hashTable[i] < -1 || hashTable[i] >= entry->numFiles ) {
+			return qfalse;
+		}
+	}
+
+	// each file only points at files before it
+	files = (const fileInPack_t *)( index->base + entry->files );
+	for ( i = 0 ; i < entry->numFiles ; i++ ) {
+		if ( files[i].next < -1 || files[i].next >= i || files[i].name < 0 || files[i].name >= entry->namesLength ) {
+			return qfalse;
+		}
+	}
+
+	return qtrue;
+}
+
+/*
+=================
+FS_FindIndexedPak
+=================
+*/
+static const pakIndexEntry_t *FS_FindIndexedPak( pakIndex_t *index, const char *zipfile, int64_t size, int64_t time ) {
+	const pakIndexHeader_t	*header;
+	const pakIndexEntry_t	*entry;
+	const char		*name;
+	int				i, num;
+
+	header = (const pakIndexHeader_t *)index->base;
+	for ( i = 0 ; i < header->numPaks ; i++ ) {
+		num = ( index->nextEntry + i ) % header->numPaks;
+		entry = (const pakIndexEntry_t *)( header + 1 ) + num;
+		if ( entry->fileSize != size || entry->fileTime != time ) {
+			continue;
+		}
+		if ( !FS_IndexRegion( index, entry->pakFilename, 1, 1 ) ) {
+			return NULL;
+		}
+		name = (const char *)index->base + entry->pakFilename;
+		if ( !memchr( name, 0, index->length - entry->pakFilename ) || strcmp( name, zipfile ) ) {
+			continue;
+		}
+		if ( !FS_IndexedPakIsValid( index, entry ) ) {
+			return NULL;
+		}
+		index->nextEntry = num + 1;
+		return entry;
+	}
+
+	return NULL;
+}
+
+/*
+=================
+FS_WritePakIndex
+
+Writes the index of the given packs and of the still valid entries of the
+one in use to be used from the next startup on
+=================
+*/
+static void FS_WritePakIndex( pakIndex_t *index, pack_t **paks, int numPaks ) {
+	typedef struct {
+		const char			*pakFilename;
+		const int			*hashTable;
+		const fileInPack_t	*files;
+		const int			*crcs;
+		const char			*names;
+	} indexSource_t;
+	static const byte	zeros[4];
+	const pakIndexHeader_t	*oldHeader;
+	const pakIndexEntry_t	*old;
+	pakIndexHeader_t	header;
+	pakIndexEntry_t		*entries, *entry;
+	indexSource_t		*sources, *src;
+	char		tmppath[MAX_OSPATH];
+	FILE		*f;
+	int64_t		size, time;
+	int			maxEntries, numEntries, ofs, len;
+	int			i, j;
+	qboolean	ok;
+
+	oldHeader = (const pakIndexHeader_t *)index->base;
+	maxEntries = numPaks + ( oldHeader ? oldHeader->numPaks : 0 );
+	entries = Z_Malloc( maxEntries * sizeof( *entries ) + 1 );
+	sources = Z_Malloc( maxEntries * sizeof( *sources ) + 1 );
+
+	numEntries = 0;
+	for ( i = 0 ; i < numPaks ; i++ ) {
+		if ( !paks[i]->fileSize ) {
+			continue;
+		}
+		entry = &entries[numEntries];
+		src = &sources[numEntries++];
+		entry->fileSize = paks[i]->fileSize;
+		entry->fileTime = paks[i]->fileTime;
+		entry->hashSize = paks[i]->hashSize;
+		entry->numFiles = paks[i]->numfiles;
+		entry->numCrcs = paks[i]->numCrcs;
+		entry->namesLength = paks[i]->namesLength;
+		src->pakFilename = paks[i]->pakFilename;
+		src->hashTable = paks[i]->hashTable;
+		src->files = paks[i]->files;
+		src->crcs = paks[i]->crcs;
+		src->names = paks[i]->names;
+	}
+
+	// carry over the ones of pk3s that weren't loaded now
+	if ( oldHeader ) {
+		old = (const pakIndexEntry_t *)( oldHeader + 1 );
+		for ( i = 0 ; i < oldHeader->numPaks ; i++, old++ ) {
+			if ( !FS_IndexRegion( index, old->pakFilename, 1, 1 )
+				|| !memchr( index->base + old->pakFilename, 0, index->length - old->pakFilename ) ) {
+				continue;
+			}
+			for ( j = 0 ; j < numEntries ; j++ ) {
+				if ( !strcmp( sources[j].pakFilename, (const char *)index->base + old->pakFilename ) ) {
+					break;
+				}
+			}
+			if ( j < numEntries ) {
+				continue;
+			}
+			if ( !Sys_StatFile( (const char *)index->base + old->pakFilename, &size, &time )
+				|| size != old->fileSize || time != old->fileTime || !FS_IndexedPakIsValid( index, old ) ) {
+				continue;
+			}
+			entries[numEntries] = *old;
+			src = &sources[numEntries++];
+			src->pakFilename = (const char *)index->base + old->pakFilename;
+			src->hashTable = (const int *)( index->base + old->hashTable );
+			src->files = (const fileInPack_t *)( index->base + old->files );
+			src->crcs = (const int *)( index->base + old->crcs );
+			src->names = (const char *)index->base + old->names;
+		}
+	}
+
+	// lay out the data after the entries
+	ofs = sizeof( header ) + numEntries * sizeof( *entries );
+	for ( i = 0 ; i < numEntries ; i++ ) {
+		entry = &entries[i];
+		entry->pad = 0;
+		entry->pakFilename = ofs;
+		ofs += PAD( strlen( sources[i].pakFilename ) + 1, 4 );
+		entry->hashTable = ofs;
+		ofs += entry->hashSize * sizeof( int );
+		entry->files = ofs;
+		ofs += entry->numFiles * sizeof( fileInPack_t );
+		entry->crcs = ofs;
+		ofs += entry->numCrcs * sizeof( int );
+		entry->names = ofs;
+		ofs += PAD( entry->namesLength, 4 );
+	}
+
+	header.ident = PAKINDEX_IDENT;
+	header.version = PAKINDEX_VERSION;
+	header.numPaks = numEntries;
+	header.length = ofs;
+
+	Com_sprintf( tmppath, sizeof( tmppath ), "%s.tmp", index->ospath );
+	f = Sys_FOpen( tmppath, "wb" );
+	if ( !f ) {
+		Com_Printf( "WARNING: couldn't write pak index %s\n", tmppath );
+		Z_Free( sources );
+		Z_Free( entries );
+		return;
+	}
+
+	ok = fwrite( &header, sizeof( header ), 1, f ) == 1;
+	if ( numEntries ) {
+		ok &= fwrite( entries, sizeof( *entries ) * numEntries, 1, f ) == 1;
+	}
+	for ( i = 0 ; i < numEntries && ok ; i++ ) {
+		entry = &entries[i];
+		src = &sources[i];
+		len = strlen( src->pakFilename ) + 1;
+		ok &= fwrite( src->pakFilename, len, 1, f ) == 1;
+		ok &= fwrite( zeros, PAD( len, 4 ) - len, 1, f ) == 1 || PAD( len, 4 ) == len;
+		ok &= fwrite( src->hashTable, entry->hashSize * sizeof( int ), 1, f ) == 1;
+		if ( entry->numFiles ) {
+			ok &= fwrite( src->files, entry->numFiles * sizeof( fileInPack_t ), 1, f ) == 1;
+		}
+		if ( entry->numCrcs ) {
+			ok &= fwrite( src->crcs, entry->numCrcs * sizeof( int ), 1, f ) == 1;
+		}
+		if ( entry->namesLength ) {
+			ok &= fwrite( src->names, entry->namesLength, 1, f ) == 1;
+		}
+		len = entry->namesLength;
+		ok &= fwrite( zeros, PAD( len, 4 ) - len, 1, f ) == 1 || PAD( len, 4 ) == len;
+	}
+	ok &= fclose( f ) == 0;
+
+	if ( !ok ) {
+		Com_Printf( "WARNING: couldn't write pak index %s\n", tmppath );
+		remove( tmppath );
+	} else if ( fs_debug->integer ) {
+		Com_Printf( "FS_WritePakIndex: %i pk3s to %s\n", numEntries, tmppath );
+	}
+
+	Z_Free( sources );
+	Z_Free( entries );
+}
+
 /*
 ==========================================================================
 
@@ -2036,38 +3450,41 @@ ZIP FILE LOADING
 
 /*
 =================
-FS_LoadZipFile
+FS_LoadIndexedPak
 
-Creates a new pak_t in the search chain for the contents
-of a zip file.
+Sets up the files of a pack from its entry in the pak index
 =================
 */
-static pack_t *FS_LoadZipFile(const char *zipfile, const char *basename)
-{
-	fileInPack_t	*buildBuffer;
-	pack_t			*pack;
-	unzFile			uf;
+static void FS_LoadIndexedPak( pack_t *pack, const pakIndex_t *index, const pakIndexEntry_t *entry ) {
+	pack->hashSize = entry->hashSize;
+	pack->hashTable = (int *)( index->base + entry->hashTable );
+	pack->numfiles = entry->numFiles;
+	pack->files = (fileInPack_t *)( index->base + entry->files );
+	pack->numCrcs = entry->numCrcs;
+	pack->crcs = (int *)( index->base + entry->crcs );
+	pack->namesLength = entry->namesLength;
+	pack->names = (char *)index->base + entry->names;
+	pack->buildBuffer = NULL;
+}
+
+/*
+=================
+FS_ReadPakDirectory
+
+Sets up the files of a pack from the central directory of the zip
+=================
+*/
+static void FS_ReadPakDirectory( pack_t *pack, unzFile uf, int numEntries ) {
 	int				err;
-	unz_global_info gi;
 	char			filename_inzip[MAX_ZPATH];
 	unz_file_info	file_info;
-	int				i, len;
+	int				i, len, numFiles;
 	long			hash;
-	int				fs_numHeaderLongs;
-	int				*fs_headerLongs;
 	char			*namePtr;
 
-	fs_numHeaderLongs = 0;
-
-	uf = unzOpen(zipfile);
-	err = unzGetGlobalInfo (uf,&gi);
-
-	if (err != UNZ_OK)
-		return NULL;
-
 	len = 0;
 	unzGoToFirstFile(uf);
-	for (i = 0; i < gi.number_entry; i++)
+	for (i = 0; i < numEntries; i++)
 	{
 		err = unzGetCurrentFileInfo(uf, &file_info, filename_inzip, sizeof(filename_inzip), NULL, 0, NULL, 0);
 		if (err != UNZ_OK) {
@@ -2076,69 +3493,120 @@ static pack_t *FS_LoadZipFile(const char *zipfile, const char *basename)
 		len += strlen(filename_inzip) + 1;
 		unzGoToNextFile(uf);
 	}
-
-	buildBuffer = Z_Malloc( (gi.number_entry * sizeof( fileInPack_t )) + len );
-	namePtr = ((char *) buildBuffer) + gi.number_entry * sizeof( fileInPack_t );
-	fs_headerLongs = Z_Malloc( ( gi.number_entry + 1 ) * sizeof(int) );
-	fs_headerLongs[ fs_numHeaderLongs++ ] = LittleLong( fs_checksumFeed );
+	numFiles = i;
 
 	// get the hash table size from the number of files in the zip
 	// because lots of custom pk3 files have less than 32 or 64 files
 	for (i = 1; i <= MAX_FILEHASH_SIZE; i <<= 1) {
-		if (i > gi.number_entry) {
+		if (i > numFiles) {
 			break;
 		}
 	}
-
-	pack = Z_Malloc( sizeof( pack_t ) + i * sizeof(fileInPack_t *) );
 	pack->hashSize = i;
-	pack->hashTable = (fileInPack_t **) (((char *) pack) + sizeof( pack_t ));
-	for(i = 0; i < pack->hashSize; i++) {
-		pack->hashTable[i] = NULL;
-	}
-
-	Q_strncpyz( pack->pakFilename, zipfile, sizeof( pack->pakFilename ) );
-	Q_strncpyz( pack->pakBasename, basename, sizeof( pack->pakBasename ) );
 
-	// strip .pk3 if needed
-	if ( strlen( pack->pakBasename ) > 4 && !Q_stricmp( pack->pakBasename + strlen( pack->pakBasename ) - 4, ".pk3" ) ) {
-		pack->pakBasename[strlen( pack->pakBasename ) - 4] = 0;
+	pack->buildBuffer = Z_Malloc( pack->hashSize * sizeof( int ) + numFiles * ( sizeof( fileInPack_t ) + sizeof( int ) ) + len );
+	pack->hashTable = pack->buildBuffer;
+	pack->files = (fileInPack_t *)( pack->hashTable + pack->hashSize );
+	pack->crcs = (int *)( pack->files + numFiles );
+	pack->names = (char *)( pack->crcs + numFiles );
+	for(i = 0; i < pack->hashSize; i++) {
+		pack->hashTable[i] = -1;
 	}
 
-	pack->handle = uf;
-	pack->numfiles = gi.number_entry;
+	pack->numCrcs = 0;
+	namePtr = pack->names;
 	unzGoToFirstFile(uf);
 
-	for (i = 0; i < gi.number_entry; i++)
+	for (i = 0; i < numFiles; i++)
 	{
 		err = unzGetCurrentFileInfo(uf, &file_info, filename_inzip, sizeof(filename_inzip), NULL, 0, NULL, 0);
 		if (err != UNZ_OK) {
 			break;
 		}
 		if (file_info.uncompressed_size > 0) {
-			fs_headerLongs[fs_numHeaderLongs++] = LittleLong(file_info.crc);
+			pack->crcs[pack->numCrcs++] = LittleLong(file_info.crc);
 		}
 		Q_strlwr( filename_inzip );
 		hash = FS_HashFileName(filename_inzip, pack->hashSize);
-		buildBuffer[i].name = namePtr;
-		strcpy( buildBuffer[i].name, filename_inzip );
+		pack->files[i].name = namePtr - pack->names;
+		strcpy( namePtr, filename_inzip );
 		namePtr += strlen(filename_inzip) + 1;
 		// store the file position in the zip
-		buildBuffer[i].pos = unzGetOffset(uf);
-		buildBuffer[i].len = file_info.uncompressed_size;
-		buildBuffer[i].next = pack->hashTable[hash];
-		pack->hashTable[hash] = &buildBuffer[i];
+		pack->files[i].pos = unzGetOffset(uf);
+		pack->files[i].len = file_info.uncompressed_size;
+		pack->files[i].next = pack->hashTable[hash];
+		pack->hashTable[hash] = i;
 		unzGoToNextFile(uf);
 	}
+	pack->numfiles = i;
+	pack->namesLength = namePtr - pack->names;
+}
+
+/*
+=================
+FS_LoadZipFile
+
+Creates a new pak_t in the search chain for the contents
+of a zip file.  With an index, the contents come from it if it has them.
+=================
+*/
+static pack_t *FS_LoadZipFile(const char *zipfile, const char *basename, pakIndex_t *index)
+{
+	pack_t			*pack;
+	unzFile			uf;
+	int				err;
+	unz_global_info gi;
+	const pakIndexEntry_t	*entry;
+	int64_t			size, time;
+	int				*fs_headerLongs;
+
+	uf = unzOpen(zipfile);
+	err = unzGetGlobalInfo (uf,&gi);
+
+	if (err != UNZ_OK)
+		return NULL;
+
+	pack = Z_Malloc( sizeof( pack_t ) );
+
+	Q_strncpyz( pack->pakFilename, zipfile, sizeof( pack->pakFilename ) );
+	Q_strncpyz( pack->pakBasename, basename, sizeof( pack->pakBasename ) );
+
+	// strip .pk3 if needed
+	if ( strlen( pack->pakBasename ) > 4 && !Q_stricmp( pack->pakBasename + strlen( pack->pakBasename ) - 4, ".pk3" ) ) {
+		pack->pakBasename[strlen( pack->pakBasename ) - 4] = 0;
+	}
+
+	pack->handle = uf;
+
+	entry = NULL;
+	if ( index && index->ospath[0] && Sys_StatFile( zipfile, &size, &time ) ) {
+		pack->fileSize = size;
+		pack->fileTime = time;
+		if ( index->base ) {
+			entry = FS_FindIndexedPak( index, zipfile, size, time );
+		}
+		if ( !entry ) {
+			index->numMissed++;
+		}
+	}
+
+	if ( entry ) {
+		FS_LoadIndexedPak( pack, index, entry );
+	} else {
+		FS_ReadPakDirectory( pack, uf, gi.number_entry );
+	}
+
+	fs_headerLongs = Z_Malloc( ( pack->numCrcs + 1 ) * sizeof(int) );
+	fs_headerLongs[0] = LittleLong( fs_checksumFeed );
+	Com_Memcpy( fs_headerLongs + 1, pack->crcs, pack->numCrcs * sizeof(int) );
 
-	pack->checksum = Com_BlockChecksum( &fs_headerLongs[ 1 ], sizeof(*fs_headerLongs) * ( fs_numHeaderLongs - 1 ) );
-	pack->pure_checksum = Com_BlockChecksum( fs_headerLongs, sizeof(*fs_headerLongs) * fs_numHeaderLongs );
+	pack->checksum = Com_BlockChecksum( &fs_headerLongs[ 1 ], sizeof(*fs_headerLongs) * pack->numCrcs );
+	pack->pure_checksum = Com_BlockChecksum( fs_headerLongs, sizeof(*fs_headerLongs) * ( pack->numCrcs + 1 ) );
 	pack->checksum = LittleLong( pack->checksum );
 	pack->pure_checksum = LittleLong( pack->pure_checksum );
 
 	Z_Free(fs_headerLongs);
 
-	pack->buildBuffer = buildBuffer;
 	return pack;
 }
 
@@ -2153,7 +3621,9 @@ Frees a pak structure and releases all associated resources
 static void FS_FreePak(pack_t *thepak)
 {
 	unzClose(thepak->handle);
-	Z_Free(thepak->buildBuffer);
+	if (thepak->buildBuffer) {
+		Z_Free(thepak->buildBuffer);
+	}
 	Z_Free(thepak);
 }
 
@@ -2169,7 +3639,7 @@ qboolean FS_CompareZipChecksum(const char *zipfile)
 	pack_t *thepak;
 	int index, checksum;
 
-	thepak = FS_LoadZipFile(zipfile, "");
+	thepak = FS_LoadZipFile(zipfile, "", NULL);
 
 	if(!thepak)
 		return qfalse;
@@ -2259,7 +3729,6 @@ char **FS_ListFilteredFiles( const char *path, const char *extension, char *filt
 	int				extensionLength;
 	int				length, pathDepth, temp;
 	pack_t			*pak;
-	fileInPack_t	*buildBuffer;
 	char			zpath[MAX_ZPATH];
 
 	if ( !fs_searchpaths ) {
@@ -2297,13 +3766,12 @@ char **FS_ListFilteredFiles( const char *path, const char *extension, char *filt
 
 			// look through all the pak file elements
 			pak = search->pack;
-			buildBuffer = pak->buildBuffer;
 			for (i = 0; i < pak->numfiles; i++) {
 				char	*name;
 				int		zpathLen, depth;
 
 				// check for directory match
-				name = buildBuffer[i].name;
+				name = pak->names + pak->files[i].name;
 				//
 				if (filter) {
 					// case insensitive
@@ -2995,7 +4463,7 @@ void FS_AddGameDirectory( const char *path, const char *dir ) {
 		if (pakwhich) {
 			// The next .pk3 file is before the next .pk3dir
 			pakfile = FS_BuildOSPath(path, dir, pakfiles[pakfilesi]);
-			if ((pak = FS_LoadZipFile(pakfile, pakfiles[pakfilesi])) == 0) {
+			if ((pak = FS_LoadZipFile(pakfile, pakfiles[pakfilesi], &fs_index)) == 0) {
 				// This isn't a .pk3! Next!
 				pakfilesi++;
 				continue;
@@ -3059,6 +4527,88 @@ void FS_AddGameDirectory( const char *path, const char *dir ) {
 	fs_searchpaths = search;
 }
 
+/*
+================
+FS_LoadPakDirectory
+
+Loads and frees every pk3 in osdir the way the search paths load them, with
+the pak index at indexPath, or with none if that is NULL, and updates that
+index if some pk3s weren't in it.  Returns the number of pk3s.  For the
+pakbench command.
+================
+*/
+int FS_LoadPakDirectory( const char *osdir, const char *indexPath, int *numFiles ) {
+	pakIndex_t	index;
+	pack_t		**paks;
+	char		**pakfiles;
+	char		ospath[MAX_OSPATH];
+	int			numPakfiles, numPaks, i;
+
+	Com_Memset( &index, 0, sizeof( index ) );
+	if ( indexPath ) {
+		FS_OpenPakIndex( &index, indexPath );
+	}
+
+	pakfiles = Sys_ListFiles( osdir, ".pk3", NULL, &numPakfiles, qfalse );
+	qsort( pakfiles, numPakfiles, sizeof(char*), paksort );
+	paks = Z_Malloc( numPakfiles * sizeof( *paks ) + 1 );
+
+	numPaks = 0;
+	*numFiles = 0;
+	for ( i = 0 ; i < numPakfiles ; i++ ) {
+		Com_sprintf( ospath, sizeof( ospath ), "%s%c%s", osdir, PATH_SEP, pakfiles[i] );
+		paks[numPaks] = FS_LoadZipFile( ospath, pakfiles[i], &index );
+		if ( paks[numPaks] ) {
+			*numFiles += paks[numPaks]->numfiles;
+			numPaks++;
+		}
+	}
+
+	if ( index.numMissed ) {
+		FS_WritePakIndex( &index, paks, numPaks );
+	}
+
+	for ( i = 0 ; i < numPaks ; i++ ) {
+		FS_FreePak( paks[i] );
+	}
+	Z_Free( paks );
+	Sys_FreeFileList( pakfiles );
+	FS_ClosePakIndex( &index );
+
+	return numPaks;
+}
+
+/*
+================
+FS_UpdatePakIndex
+
+Writes the pak index again after startup read pk3s that weren't in it
+================
+*/
+static void FS_UpdatePakIndex( void ) {
+	searchpath_t	*search;
+	pack_t			**paks;
+	int				numPaks;
+
+	numPaks = 0;
+	for ( search = fs_searchpaths ; search ; search = search->next ) {
+		if ( search->pack ) {
+			numPaks++;
+		}
+	}
+
+	paks = Z_Malloc( numPaks * sizeof( *paks ) + 1 );
+	numPaks = 0;
+	for ( search = fs_searchpaths ; search ; search = search->next ) {
+		if ( search->pack ) {
+			paks[numPaks++] = search->pack;
+		}
+	}
+
+	FS_WritePakIndex( &fs_index, paks, numPaks );
+	Z_Free( paks );
+}
+
 /*
 ================
 FS_idPak
@@ -3274,11 +4824,22 @@ void FS_Shutdown( qboolean closemfp ) {
 	// any FS_ calls will now be an error until reinitialized
 	fs_searchpaths = NULL;
 
+	// the packs are gone, what is still open or handed out is freed as usual
+	FS_ClearPrefetch();
+	for ( i = 0 ; i < MAX_PREFETCH_FILES ; i++ ) {
+		fs_prefetch[i].pack = NULL;
+		fs_prefetch[i].pakFile = NULL;
+	}
+
+	// nothing uses the mapped index any more
+	FS_ClosePakIndex( &fs_index );
+
 	Cmd_RemoveCommand( "path" );
 	Cmd_RemoveCommand( "dir" );
 	Cmd_RemoveCommand( "fdir" );
 	Cmd_RemoveCommand( "touchFile" );
 	Cmd_RemoveCommand( "which" );
+	Cmd_RemoveCommand( "fs_assetcache" );
 
 #ifdef FS_MISSING
 	if (closemfp) {
@@ -3354,6 +4915,13 @@ static void FS_Startup( const char *gameName )
 	}
 	fs_homepath = Cvar_Get ("fs_homepath", homePath, CVAR_INIT|CVAR_PROTECTED );
 	fs_gamedirvar = Cvar_Get ("fs_game", "", CVAR_INIT|CVAR_SYSTEMINFO );
+	fs_pakIndex = Cvar_Get ("fs_pakIndex", "1", CVAR_ARCHIVE );
+	fs_mapFiles = Cvar_Get ("fs_mapFiles", "1", CVAR_ARCHIVE );
+	fs_prefetchThreads = Cvar_Get ("fs_prefetchThreads", "0", CVAR_ARCHIVE );
+	Cvar_CheckRange( fs_prefetchThreads, 0, MAX_JOB_THREADS, qtrue );
+	fs_prefetchMegs = Cvar_Get ("fs_prefetchMegs", "64", CVAR_ARCHIVE );
+	fs_assetCache = Cvar_Get ("fs_assetCache", "0", CVAR_ARCHIVE );
+	fs_assetCacheMegs = Cvar_Get ("fs_assetCacheMegs", "512", CVAR_ARCHIVE );
 
 	if (!gameName[0]) {
 		Cvar_ForceReset( "com_basegame" );
@@ -3376,6 +4944,11 @@ static void FS_Startup( const char *gameName )
 		Com_Error( ERR_DROP, "Invalid fs_game '%s'", fs_gamedirvar->string );
 	}
 
+	FS_ClosePakIndex( &fs_index );
+	if (fs_pakIndex->integer && fs_homepath->string[0]) {
+		FS_OpenPakIndex( &fs_index, va( "%s%c%s", fs_homepath->string, PATH_SEP, PAKINDEX_NAME ) );
+	}
+
 	// add search path elements in reverse priority order
 	fs_gogpath = Cvar_Get ("fs_gogpath", Sys_GogPath(), CVAR_INIT|CVAR_PROTECTED );
 	if (fs_gogpath->string[0]) {
@@ -3435,6 +5008,10 @@ static void FS_Startup( const char *gameName )
 		}
 	}
 
+	if (fs_index.numMissed) {
+		FS_UpdatePakIndex();
+	}
+
 #ifndef STANDALONE
 	if (!com_standalone->integer) {
 		Com_ReadCDKey(BASEGAME);
@@ -3450,6 +5027,7 @@ static void FS_Startup( const char *gameName )
 	Cmd_AddCommand ("fdir", FS_NewDir_f );
 	Cmd_AddCommand ("touchFile", FS_TouchFile_f );
 	Cmd_AddCommand ("which", FS_Which_f );
+	Cmd_AddCommand ("fs_assetcache", FS_AssetCache_f );
 
 	// https://zerowing.idsoftware.com/bugzilla/show_bug.cgi?id=506
 	// reorder the pure pk3 files according to server order
@@ -4185,7 +5763,9 @@ int		FS_FOpenFileByMode( const char *qpath, fileHandle_t *f, fsMode_t mode ) {
 
 int		FS_FTell( fileHandle_t f ) {
 	int pos;
-	if (fsh[f].zipFile == qtrue) {
+	if (fsh[f].prefetch) {
+		pos = fsh[f].prefetchPos;
+	} else if (fsh[f].zipFile == qtrue) {
 		pos = unztell(fsh[f].handleFiles.file.z);
 	} else {
 		pos = ftell(fsh[f].handleFiles.file.o);
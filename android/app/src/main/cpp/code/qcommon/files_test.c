@@ -0,0 +1,321 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// files_test.c -- times loading the directories of many pk3s with and
+// without the pak index, and loading a map's files with and without
+// prefetching them
+
+/*
+
+pakbench [paks] [files] [repeat]
+
+Writes paks pk3s (300 by default) of files small stored files each (300 by
+default) to pakbench/<paks>x<files> in fs_homepath, unless they are already
+there from an earlier run, and loads all of them the way the search paths
+are set up at startup:
+
+- repeat times (3 by default) without a pak index, reading every central
+  directory,
+- once with an empty pak index, which reads them all and writes the index,
+- repeat times with that index.
+
+The pk3s stay on disk, so the operating system will have them cached, and
+only the work done by the engine is timed.
+
+prefetchbench <map> [repeat]
+
+Prefetches maps/<map>.bsp and the files it uses the way a map load does,
+with fs_prefetchThreads job threads, and then reads every prefetched file
+through FS_ReadFile.  The same files are then read again without
+prefetching.  Both are done repeat times (3 by default), and the time for
+each is printed.  Only files that are in pk3s and would be prefetched are
+read, the configstring models and sounds a real map load adds aren't.
+
+*/
+
+#include "q_shared.h"
+#include "qcommon.h"
+#include "unzip.h"
+
+#define	PB_DATE		( ( ( 2000 - 1980 ) << 9 ) | ( 1 << 5 ) | 1 )	// dos date of 2000-01-01
+
+typedef struct {
+	byte	*data;
+	int		length;
+	int		maxLength;
+} pbBuffer_t;
+
+/*
+=================
+PB_Write
+=================
+*/
+static void PB_Write( pbBuffer_t *buf, const void *data, int length ) {
+	if ( buf->length + length > buf->maxLength ) {
+		buf->maxLength = ( buf->length + length ) * 2;
+		buf->data = realloc( buf->data, buf->maxLength );
+		if ( !buf->data ) {
+			Com_Error( ERR_FATAL, "pakbench: out of memory" );
+		}
+	}
+	Com_Memcpy( buf->data + buf->length, data, length );
+	buf->length += length;
+}
+
+/*
+=================
+PB_Short / PB_Long
+
+Zip files are little endian
+=================
+*/
+static void PB_Short( pbBuffer_t *buf, int value ) {
+	byte	b[2];
+
+	b[0] = value & 0xff;
+	b[1] = ( value >> 8 ) & 0xff;
+	PB_Write( buf, b, 2 );
+}
+
+static void PB_Long( pbBuffer_t *buf, unsigned value ) {
+	PB_Short( buf, value & 0xffff );
+	PB_Short( buf, value >> 16 );
+}
+
+/*
+=================
+PB_Header
+
+The part of a local file header and a central directory entry after the
+signature and versions
+=================
+*/
+static void PB_Header( pbBuffer_t *buf, unsigned crc, int length, int nameLength ) {
+	PB_Short( buf, 0 );				// flags
+	PB_Short( buf, 0 );				// stored
+	PB_Short( buf, 0 );				// time
+	PB_Short( buf, PB_DATE );
+	PB_Long( buf, crc );
+	PB_Long( buf, length );			// compressed
+	PB_Long( buf, length );			// uncompressed
+	PB_Short( buf, nameLength );
+	PB_Short( buf, 0 );				// extra field
+}
+
+/*
+=================
+PB_WritePak
+=================
+*/
+static qboolean PB_WritePak( const char *ospath, int pakNum, int numFiles ) {
+	pbBuffer_t	local, central;
+	char		name[MAX_QPATH], data[64];
+	unsigned	*offsets, *crcs;
+	int			i, nameLength, dataLength;
+	FILE		*f;
+	qboolean	ok;
+
+	Com_Memset( &local, 0, sizeof( local ) );
+	Com_Memset( &central, 0, sizeof( central ) );
+	offsets = malloc( numFiles * sizeof( *offsets ) * 2 + 1 );
+	if ( !offsets ) {
+		return qfalse;
+	}
+	crcs = offsets + numFiles;
+
+	for ( i = 0 ; i < numFiles ; i++ ) {
+		Com_sprintf( name, sizeof( name ), "textures/pakbench/pak%04d/texture%05d.tga", pakNum, i );
+		Com_sprintf( data, sizeof( data ), "pakbench %i %i\n", pakNum, i );
+		nameLength = strlen( name );
+		dataLength = strlen( data );
+		crcs[i] = crc32( 0, (const Bytef *)data, dataLength );
+		offsets[i] = local.length;
+
+		PB_Long( &local, 0x04034b50 );
+		PB_Short( &local, 20 );
+		PB_Header( &local, crcs[i], dataLength, nameLength );
+		PB_Write( &local, name, nameLength );
+		PB_Write( &local, data, dataLength );
+
+		PB_Long( &central, 0x02014b50 );
+		PB_Short( &central, 20 );
+		PB_Short( &central, 20 );
+		PB_Header( &central, crcs[i], dataLength, nameLength );
+		PB_Short( &central, 0 );		// comment
+		PB_Short( &central, 0 );		// disk
+		PB_Short( &central, 0 );		// internal attributes
+		PB_Long( &central, 0 );			// external attributes
+		PB_Long( &central, offsets[i] );
+		PB_Write( &central, name, nameLength );
+	}
+
+	// end of central directory
+	PB_Long( &central, 0x06054b50 );
+	PB_Short( &central, 0 );
+	PB_Short( &central, 0 );
+	PB_Short( &central, numFiles );
+	PB_Short( &central, numFiles );
+	PB_Long( &central, central.length - 12 );
+	PB_Long( &central, local.length );
+	PB_Short( &central, 0 );
+
+	ok = qfalse;
+	f = Sys_FOpen( ospath, "wb" );
+	if ( f ) {
+		ok = fwrite( local.data, local.length, 1, f ) == 1;
+		ok &= fwrite( central.data, central.length, 1, f ) == 1;
+		ok &= fclose( f ) == 0;
+	}
+
+	free( offsets );
+	free( local.data );
+	free( central.data );
+	return ok;
+}
+
+/*
+=================
+FS_PakBench_f
+=================
+*/
+void FS_PakBench_f( void ) {
+	char		dir[MAX_OSPATH], ospath[MAX_OSPATH], indexPath[MAX_OSPATH];
+	int64_t		size, time;
+	int			numPaks, numFiles, repeat;
+	int			i, start, loaded, files;
+	int			msec[3];
+
+	numPaks = Cmd_Argc() > 1 ? atoi( Cmd_Argv( 1 ) ) : 300;
+	numFiles = Cmd_Argc() > 2 ? atoi( Cmd_Argv( 2 ) ) : 300;
+	repeat = Cmd_Argc() > 3 ? atoi( Cmd_Argv( 3 ) ) : 3;
+	if ( numPaks < 1 || numFiles < 1 || numFiles > 65535 || repeat < 1 ) {
+		Com_Printf( "usage: pakbench [paks] [files] [repeat]\n" );
+		return;
+	}
+
+	Com_sprintf( dir, sizeof( dir ), "%s%cpakbench", Cvar_VariableString( "fs_homepath" ), PATH_SEP );
+	Sys_Mkdir( dir );
+	Com_sprintf( dir, sizeof( dir ), "%s%cpakbench%c%ix%i", Cvar_VariableString( "fs_homepath" ), PATH_SEP,
+		PATH_SEP, numPaks, numFiles );
+	if ( !Sys_Mkdir( dir ) ) {
+		Com_Printf( "pakbench: couldn't create %s\n", dir );
+		return;
+	}
+
+	start = Sys_Milliseconds();
+	for ( i = 0 ; i < numPaks ; i++ ) {
+		Com_sprintf( ospath, sizeof( ospath ), "%s%cpak%04d.pk3", dir, PATH_SEP, i );
+		if ( Sys_StatFile( ospath, &size, &time ) ) {
+			continue;
+		}
+		if ( !PB_WritePak( ospath, i, numFiles ) ) {
+			Com_Printf( "pakbench: couldn't write %s\n", ospath );
+			return;
+		}
+	}
+	Com_Printf( "pakbench: %s ready after %i msec\n", dir, Sys_Milliseconds() - start );
+
+	Com_sprintf( indexPath, sizeof( indexPath ), "%s%cpakindex.dat", dir, PATH_SEP );
+	remove( indexPath );
+	Com_sprintf( ospath, sizeof( ospath ), "%s.tmp", indexPath );
+	remove( ospath );
+
+	loaded = files = 0;
+	start = Sys_Milliseconds();
+	for ( i = 0 ; i < repeat ; i++ ) {
+		loaded = FS_LoadPakDirectory( dir, NULL, &files );
+	}
+	msec[0] = Sys_Milliseconds() - start;
+
+	start = Sys_Milliseconds();
+	FS_LoadPakDirectory( dir, indexPath, &files );
+	msec[1] = Sys_Milliseconds() - start;
+
+	start = Sys_Milliseconds();
+	for ( i = 0 ; i < repeat ; i++ ) {
+		loaded = FS_LoadPakDirectory( dir, indexPath, &files );
+	}
+	msec[2] = Sys_Milliseconds() - start;
+
+	Com_Printf( "pakbench: %i pk3s with %i files\n", loaded, files );
+	Com_Printf( "pakbench: read directories %i msec, wrote index %i msec, from index %i msec\n",
+		msec[0] / repeat, msec[1], msec[2] / repeat );
+}
+
+/*
+=================
+FS_PrefetchBench_f
+=================
+*/
+void FS_PrefetchBench_f( void ) {
+	static const char	*names[1024];
+	char		bspName[MAX_QPATH];
+	void		*buffer;
+	int			numNames, repeat, threads;
+	int			i, pass, start, bytes;
+	int			msec[2];
+
+	if ( Cmd_Argc() < 2 ) {
+		Com_Printf( "usage: prefetchbench <map> [repeat]\n" );
+		return;
+	}
+	repeat = Cmd_Argc() > 2 ? atoi( Cmd_Argv( 2 ) ) : 3;
+	if ( repeat < 1 ) {
+		repeat = 1;
+	}
+	threads = Cvar_VariableIntegerValue( "fs_prefetchThreads" );
+	if ( threads < 1 ) {
+		Com_Printf( "prefetchbench: fs_prefetchThreads is 0, nothing would be prefetched\n" );
+		return;
+	}
+
+	Com_sprintf( bspName, sizeof( bspName ), "maps/%s.bsp", Cmd_Argv( 1 ) );
+
+	numNames = bytes = 0;
+	msec[0] = msec[1] = 0;
+	for ( pass = 0 ; pass < repeat ; pass++ ) {
+		start = Sys_Milliseconds();
+		FS_PrefetchMap( bspName, NULL, 0 );
+		numNames = FS_ListPrefetched( names, ARRAY_LEN( names ) );
+		bytes = 0;
+		for ( i = 0 ; i < numNames ; i++ ) {
+			bytes += FS_ReadFile( names[i], &buffer );
+			if ( buffer ) {
+				FS_FreeFile( buffer );
+			}
+		}
+		FS_ClearPrefetch();
+		msec[0] += Sys_Milliseconds() - start;
+
+		start = Sys_Milliseconds();
+		for ( i = 0 ; i < numNames ; i++ ) {
+			FS_ReadFile( names[i], &buffer );
+			if ( buffer ) {
+				FS_FreeFile( buffer );
+			}
+		}
+		msec[1] += Sys_Milliseconds() - start;
+	}
+
+	Com_Printf( "prefetchbench: %s uses %i pk3 files, %i KB\n", bspName, numNames, bytes / 1024 );
+	Com_Printf( "prefetchbench: %i threads prefetched %i msec, read one at a time %i msec\n",
+		threads, msec[0] / repeat, msec[1] / repeat );
+}
@@ -27,16 +27,18 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include "q_shared.h"
 #include "qcommon.h"
 
+// bit position for the streaming Huff_Compress / Huff_Decompress functions,
+// the offset based functions only use the caller's offset so that messages
+// can be written from several threads at once
 static int			bloc = 0;
 
 void	Huff_putBit( int bit, byte *fout, int *offset) {
-	bloc = *offset;
-	if ((bloc&7) == 0) {
-		fout[(bloc>>3)] = 0;
+	int		o = *offset;
+	if ((o&7) == 0) {
+		fout[(o>>3)] = 0;
 	}
-	fout[(bloc>>3)] |= bit << (bloc&7);
-	bloc++;
-	*offset = bloc;
+	fout[(o>>3)] |= bit << (o&7);
+	*offset = o + 1;
 }
 
 int		Huff_getBloc(void)
@@ -51,10 +53,9 @@ void	Huff_setBloc(int _bloc)
 
 int		Huff_getBit( byte *fin, int *offset) {
 	int t;
-	bloc = *offset;
-	t = (fin[(bloc>>3)] >> (bloc&7)) & 0x1;
-	bloc++;
-	*offset = bloc;
+	int o = *offset;
+	t = (fin[(o>>3)] >> (o&7)) & 0x1;
+	*offset = o + 1;
 	return t;
 }
 
@@ -280,14 +281,14 @@ int Huff_Receive (node_t *node, int *ch, byte *fin) {
 
 /* Get a symbol */
 void Huff_offsetReceive (node_t *node, int *ch, byte *fin, int *offset, int maxoffset) {
-	bloc = *offset;
+	int o = *offset;
 	while (node && node->symbol == INTERNAL_NODE) {
-		if (bloc >= maxoffset) {
+		if (o >= maxoffset) {
 			*ch = 0;
 			*offset = maxoffset + 1;
 			return;
 		}
-		if (get_bit(fin)) {
+		if (Huff_getBit(fin, &o)) {
 			node = node->right;
 		} else {
 			node = node->left;
@@ -299,7 +300,7 @@ void Huff_offsetReceive (node_t *node, int *ch, byte *fin, int *offset, int maxo
 //		Com_Error(ERR_DROP, "Illegal tree!");
 	}
 	*ch = node->symbol;
-	*offset = bloc;
+	*offset = o;
 }
 
 /* Send the prefix code for this node */
@@ -334,10 +335,22 @@ void Huff_transmit (huff_t *huff, int ch, byte *fout, int maxoffset) {
 	}
 }
 
+/* Send the prefix code for this node at *offset */
+static void offsetSend(node_t *node, node_t *child, byte *fout, int *offset, int maxoffset) {
+	if (node->parent) {
+		offsetSend(node->parent, node, fout, offset, maxoffset);
+	}
+	if (child) {
+		if (*offset >= maxoffset) {
+			*offset = maxoffset + 1;
+			return;
+		}
+		Huff_putBit(node->right == child, fout, offset);
+	}
+}
+
 void Huff_offsetTransmit (huff_t *huff, int ch, byte *fout, int *offset, int maxoffset) {
-	bloc = *offset;
-	send(huff->loc[ch], NULL, fout, maxoffset);
-	*offset = bloc;
+	offsetSend(huff->loc[ch], NULL, fout, offset, maxoffset);
 }
 
 void Huff_Decompress(msg_t *mbuf, int offset) {
@@ -452,3 +465,35 @@ void Huff_Init(huffman_t *huff) {
 	huff->compressor.tree->parent = huff->compressor.tree->left = huff->compressor.tree->right = NULL;
 }
 
+
+/* Walk the tree from node down, filling in the tables for every leaf */
+static void Huff_tableNode(huffTable_t *table, node_t *node, unsigned int code, int length) {
+	int i;
+
+	if (!node) {
+		return;
+	}
+	if (node->symbol == INTERNAL_NODE) {
+		/* codes longer than 32 bits are left to the tree walk */
+		if (length < 32) {
+			Huff_tableNode(table, node->left, code, length + 1);
+			Huff_tableNode(table, node->right, code | (1u << length), length + 1);
+		}
+		return;
+	}
+
+	table->code[node->symbol] = code;
+	table->length[node->symbol] = length;
+	if (length <= HUFF_TABLE_BITS) {
+		for (i = code; i < (1 << HUFF_TABLE_BITS); i += 1 << length) {
+			table->decode[i] = node->symbol | (length << HUFF_SYMBOL_BITS);
+		}
+	}
+}
+
+/* Flatten a tree that won't be updated any more.  The codes come out the same
+ * as from Huff_offsetTransmit and Huff_offsetReceive, first bit lowest */
+void Huff_BuildTable(node_t *tree, huffTable_t *table) {
+	Com_Memset(table, 0, sizeof(*table));
+	Huff_tableNode(table, tree, 0, 0);
+}
@@ -0,0 +1,212 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// jobs.c -- a small pool of worker threads for splitting up frame work
+
+/*
+Com_RunJobs( function, data, numJobs, numThreads ) calls function( data, job )
+for every job in [0, numJobs) and returns when all of them are done.  The
+calling thread takes jobs as well, and up to numThreads pool threads help it.
+Threads are started the first time they are asked for and then sleep on a
+semaphore between batches.
+
+Only one batch runs at a time.  A batch started while another one is running,
+for example from inside a job, is run on the calling thread.
+
+Jobs run outside of the main thread, so they must not call Com_Error,
+Com_Printf, the zone allocator, or anything else that touches shared state
+without a lock.
+*/
+
+#include "q_shared.h"
+#include "qcommon.h"
+
+typedef struct {
+	void			*threads[MAX_JOB_THREADS];
+	int				numThreads;
+	qboolean		quit;
+
+	void			*batchLock;		// held for the duration of a batch
+	void			*lock;			// protects the batch state below
+	void			*wake;			// posted once for every thread asked to help
+	void			*done;			// posted when a waiting caller's batch completes
+
+	jobFunction_t	function;
+	void			*data;
+	int				numJobs;
+	int				nextJob;
+	int				finished;
+	qboolean		waiting;
+} jobPool_t;
+
+static jobPool_t	jobs;
+
+/*
+=================
+Com_RunJob
+
+Runs the next job of the current batch, returns qfalse if there was none left
+=================
+*/
+static qboolean Com_RunJob( void ) {
+	jobFunction_t	function;
+	void			*data;
+	int				job;
+
+	Sys_LockMutex( jobs.lock );
+	if ( jobs.nextJob >= jobs.numJobs ) {
+		Sys_UnlockMutex( jobs.lock );
+		return qfalse;
+	}
+	job = jobs.nextJob++;
+	function = jobs.function;
+	data = jobs.data;
+	Sys_UnlockMutex( jobs.lock );
+
+	function( data, job );
+
+	Sys_LockMutex( jobs.lock );
+	if ( ++jobs.finished == jobs.numJobs && jobs.waiting ) {
+		jobs.waiting = qfalse;
+		Sys_PostSemaphore( jobs.done );
+	}
+	Sys_UnlockMutex( jobs.lock );
+
+	return qtrue;
+}
+
+/*
+=================
+Com_JobThread
+=================
+*/
+static void Com_JobThread( void *arg ) {
+	while ( 1 ) {
+		Sys_WaitSemaphore( jobs.wake );
+		if ( jobs.quit ) {
+			return;
+		}
+		while ( Com_RunJob() ) {
+		}
+	}
+}
+
+/*
+=================
+Com_RunJobs
+=================
+*/
+void Com_RunJobs( jobFunction_t function, void *data, int numJobs, int numThreads ) {
+	int		i;
+
+	if ( numThreads > numJobs - 1 ) {
+		numThreads = numJobs - 1;
+	}
+	if ( numThreads > MAX_JOB_THREADS ) {
+		numThreads = MAX_JOB_THREADS;
+	}
+
+	if ( numThreads <= 0 || !jobs.batchLock || !Sys_TryLockMutex( jobs.batchLock ) ) {
+		for ( i = 0 ; i < numJobs ; i++ ) {
+			function( data, i );
+		}
+		return;
+	}
+
+	while ( jobs.numThreads < numThreads ) {
+		void	*thread = Sys_CreateThread( Com_JobThread, NULL );
+
+		if ( !thread ) {
+			break;
+		}
+		jobs.threads[jobs.numThreads++] = thread;
+	}
+	if ( numThreads > jobs.numThreads ) {
+		numThreads = jobs.numThreads;
+	}
+
+	Sys_LockMutex( jobs.lock );
+	jobs.function = function;
+	jobs.data = data;
+	jobs.numJobs = numJobs;
+	jobs.nextJob = 0;
+	jobs.finished = 0;
+	jobs.waiting = qfalse;
+	Sys_UnlockMutex( jobs.lock );
+
+	for ( i = 0 ; i < numThreads ; i++ ) {
+		Sys_PostSemaphore( jobs.wake );
+	}
+
+	while ( Com_RunJob() ) {
+	}
+
+	// wait for the jobs still running on other threads
+	Sys_LockMutex( jobs.lock );
+	if ( jobs.finished < jobs.numJobs ) {
+		jobs.waiting = qtrue;
+		Sys_UnlockMutex( jobs.lock );
+		Sys_WaitSemaphore( jobs.done );
+	} else {
+		Sys_UnlockMutex( jobs.lock );
+	}
+
+	Sys_UnlockMutex( jobs.batchLock );
+}
+
+/*
+=================
+Com_InitJobs
+=================
+*/
+void Com_InitJobs( void ) {
+	jobs.batchLock = Sys_CreateMutex();
+	jobs.lock = Sys_CreateMutex();
+	jobs.wake = Sys_CreateSemaphore();
+	jobs.done = Sys_CreateSemaphore();
+}
+
+/*
+=================
+Com_ShutdownJobs
+=================
+*/
+void Com_ShutdownJobs( void ) {
+	int		i;
+
+	if ( !jobs.batchLock ) {
+		return;
+	}
+
+	jobs.quit = qtrue;
+	for ( i = 0 ; i < jobs.numThreads ; i++ ) {
+		Sys_PostSemaphore( jobs.wake );
+	}
+	for ( i = 0 ; i < jobs.numThreads ; i++ ) {
+		Sys_JoinThread( jobs.threads[i] );
+	}
+
+	Sys_DestroySemaphore( jobs.done );
+	Sys_DestroySemaphore( jobs.wake );
+	Sys_DestroyMutex( jobs.lock );
+	Sys_DestroyMutex( jobs.batchLock );
+	Com_Memset( &jobs, 0, sizeof( jobs ) );
+}
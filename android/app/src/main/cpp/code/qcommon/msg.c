@@ -22,7 +22,14 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include "q_shared.h"
 #include "qcommon.h"
 
+#if idx64
+#include <emmintrin.h>
+#elif defined( __aarch64__ )
+#include <arm_neon.h>
+#endif
+
 static huffman_t		msgHuff;
+static huffTable_t		msgHuffTable;
 
 static qboolean			msgInit = qfalse;
 
@@ -40,6 +47,7 @@ Handles byte ordering and avoids alignment errors
 int oldsize = 0;
 
 void MSG_initHuffman( void );
+static void MSG_InitDeltaTables( void );
 
 void MSG_Init( msg_t *buf, byte *data, int length ) {
 	if (!msgInit) {
@@ -97,13 +105,88 @@ void MSG_Copy(msg_t *buf, byte *data, int length, msg_t *src)
 =============================================================================
 
 bit functions
+
+Bitstream messages are read and written a 64 bit word at a time.  A write
+collects the raw low bits and the Huffman code of every whole byte in a
+word, lowest bit first, and stores it with one unaligned store.  A read
+loads a word at the read position, takes the raw bits out of it, and
+decodes each byte with one lookup, only walking the tree for the rare codes
+longer than HUFF_TABLE_BITS.  The message tree never changes once it is
+built, so msgHuffTable holds all of its codes.
+
+Bytes go in and come out exactly the way Huff_putBit, Huff_offsetTransmit
+and Huff_offsetReceive would move them one bit at a time, so the wire
+format doesn't change, and msg->bit, cursize and readcount are always up to
+date for the code that looks at them directly.
   
 =============================================================================
 */
 
+#define	MSG_STORE_BITS		57		// the most that always fits in a word after a partial byte
+
+/*
+==================
+MSG_StoreBits
+
+Stores up to MSG_STORE_BITS bits at msg->bit, first bit lowest.  The caller
+has made sure they fit.  Like Huff_putBit, whatever followed in the bytes
+that are written to is cleared.
+==================
+*/
+static ID_INLINE void MSG_StoreBits( msg_t *msg, uint64_t bits, int numBits ) {
+	byte	*p = msg->data + ( msg->bit >> 3 );
+	int		ofs = msg->bit & 7;
+	int		i;
+
+	if ( ofs ) {
+		bits = ( bits << ofs ) | ( *p & ( ( 1 << ofs ) - 1 ) );
+	}
+	msg->bit += numBits;
+
+#ifdef Q3_LITTLE_ENDIAN
+	if ( p + 8 <= msg->data + msg->maxsize ) {
+		Com_Memcpy( p, &bits, 8 );
+		return;
+	}
+#endif
+	for ( i = ( ofs + numBits + 7 ) >> 3 ; i > 0 ; i--, p++ ) {
+		*p = (byte)bits;
+		bits >>= 8;
+	}
+}
+
+/*
+==================
+MSG_LoadBits
+
+Returns the bits from bit on, at least MSG_STORE_BITS of them, with zeros
+past the end of the message
+==================
+*/
+static ID_INLINE uint64_t MSG_LoadBits( const msg_t *msg, int bit ) {
+	const byte	*p = msg->data + ( bit >> 3 );
+	int			left = msg->cursize - ( bit >> 3 );
+	uint64_t	bits;
+	int			i;
+
+#ifdef Q3_LITTLE_ENDIAN
+	if ( left >= 8 ) {
+		Com_Memcpy( &bits, p, 8 );
+		return bits >> ( bit & 7 );
+	}
+#endif
+	bits = 0;
+	for ( i = 0 ; i < left && i < 8 ; i++ ) {
+		bits |= (uint64_t)p[i] << ( i << 3 );
+	}
+	return bits >> ( bit & 7 );
+}
+
 // negative bit values include signs
 void MSG_WriteBits( msg_t *msg, int value, int bits ) {
-	int	i;
+	uint64_t	word;
+	unsigned	v;
+	int			i, c, nbits, wordBits;
 
 	oldsize += bits;
 
@@ -143,29 +226,49 @@ void MSG_WriteBits( msg_t *msg, int value, int bits ) {
 			Com_Error( ERR_DROP, "can't write %d bits", bits );
 		}
 	} else {
-		value &= (0xffffffff >> (32 - bits));
-		if ( bits&7 ) {
-			int nbits;
-			nbits = bits&7;
-			if ( msg->bit + nbits > msg->maxsize << 3 ) {
+		v = (unsigned)value & ( 0xffffffff >> ( 32 - bits ) );
+
+		// the odd bits go in raw
+		nbits = bits & 7;
+		if ( msg->bit + nbits > msg->maxsize << 3 ) {
+			msg->overflowed = qtrue;
+			return;
+		}
+		word = v & ( ( 1 << nbits ) - 1 );
+		wordBits = nbits;
+		v >>= nbits;
+
+		// then the Huffman code of every byte
+		for ( i = nbits ; i <= bits ; i += 8, v >>= 8 ) {
+			c = v & 0xff;
+			if ( i < bits && msgHuffTable.length[c] && wordBits + msgHuffTable.length[c] <= MSG_STORE_BITS ) {
+				word |= (uint64_t)msgHuffTable.code[c] << wordBits;
+				wordBits += msgHuffTable.length[c];
+				continue;
+			}
+
+			if ( msg->bit + wordBits > msg->maxsize << 3 ) {
 				msg->overflowed = qtrue;
 				return;
 			}
-			for( i = 0; i < nbits; i++ ) {
-				Huff_putBit( (value & 1), msg->data, &msg->bit );
-				value = (value >> 1);
+			if ( wordBits ) {
+				MSG_StoreBits( msg, word, wordBits );
 			}
-			bits = bits - nbits;
-		}
-		if ( bits ) {
-			for( i = 0; i < bits; i += 8 ) {
-				Huff_offsetTransmit( &msgHuff.compressor, (value & 0xff), msg->data, &msg->bit, msg->maxsize << 3 );
-				value = (value >> 8);
-
-				if ( msg->bit > msg->maxsize << 3 ) {
-					msg->overflowed = qtrue;
-					return;
-				}
+			if ( i == bits ) {
+				break;
+			}
+
+			if ( msgHuffTable.length[c] ) {
+				word = msgHuffTable.code[c];
+				wordBits = msgHuffTable.length[c];
+				continue;
+			}
+			word = 0;
+			wordBits = 0;
+			Huff_offsetTransmit( &msgHuff.compressor, c, msg->data, &msg->bit, msg->maxsize << 3 );
+			if ( msg->bit > msg->maxsize << 3 ) {
+				msg->overflowed = qtrue;
+				return;
 			}
 		}
 		msg->cursize = (msg->bit >> 3) + 1;
@@ -174,10 +277,11 @@ void MSG_WriteBits( msg_t *msg, int value, int bits ) {
 
 int MSG_ReadBits( msg_t *msg, int bits ) {
 	int			value;
-	int			get;
 	qboolean	sgn;
 	int			i, nbits;
-//	FILE*	fp;
+	uint64_t	word;
+	int			wordBits, bit, maxBit, start, entry;
+	node_t		*node;
 
 	if ( msg->readcount > msg->cursize ) {
 		return 0;
@@ -222,33 +326,68 @@ int MSG_ReadBits( msg_t *msg, int bits ) {
 		else
 			Com_Error(ERR_DROP, "can't read %d bits", bits);
 	} else {
-		nbits = 0;
-		if (bits&7) {
-			nbits = bits&7;
-			if (msg->bit + nbits > msg->cursize << 3) {
+		bit = msg->bit;
+		maxBit = msg->cursize << 3;
+		word = MSG_LoadBits( msg, bit );
+		wordBits = MSG_STORE_BITS;
+
+		nbits = bits & 7;
+		if ( nbits ) {
+			if ( bit + nbits > maxBit ) {
 				msg->readcount = msg->cursize + 1;
 				return 0;
 			}
-			for(i=0;i<nbits;i++) {
-				value |= (Huff_getBit(msg->data, &msg->bit)<<i);
-			}
-			bits = bits - nbits;
+			value = word & ( ( 1 << nbits ) - 1 );
+			word >>= nbits;
+			wordBits -= nbits;
+			bit += nbits;
+			bits -= nbits;
 		}
-		if (bits) {
-//			fp = fopen("c:\\netchan.bin", "a");
-			for(i=0;i<bits;i+=8) {
-				Huff_offsetReceive (msgHuff.decompressor.tree, &get, msg->data, &msg->bit, msg->cursize<<3);
-//				fwrite(&get, 1, 1, fp);
-				value = (unsigned int)value | ((unsigned int)get<<(i+nbits));
-
-				if (msg->bit > msg->cursize<<3) {
+
+		for ( i = 0 ; i < bits ; i += 8 ) {
+			if ( wordBits < HUFF_TABLE_BITS ) {
+				word = MSG_LoadBits( msg, bit );
+				wordBits = MSG_STORE_BITS;
+			}
+			entry = msgHuffTable.decode[word & ( ( 1 << HUFF_TABLE_BITS ) - 1 )];
+			if ( entry && bit + ( entry >> HUFF_SYMBOL_BITS ) <= maxBit ) {
+				word >>= entry >> HUFF_SYMBOL_BITS;
+				wordBits -= entry >> HUFF_SYMBOL_BITS;
+				bit += entry >> HUFF_SYMBOL_BITS;
+				value = (unsigned int)value | ( (unsigned int)( entry & ( ( 1 << HUFF_SYMBOL_BITS ) - 1 ) ) << ( i + nbits ) );
+				continue;
+			}
+
+			// a long code, or one that runs past the end
+			start = bit;
+			node = msgHuff.decompressor.tree;
+			while ( node && node->symbol == INTERNAL_NODE ) {
+				if ( bit >= maxBit ) {
+					msg->bit = maxBit + 1;
 					msg->readcount = msg->cursize + 1;
 					return 0;
 				}
+				if ( !wordBits ) {
+					word = MSG_LoadBits( msg, bit );
+					wordBits = MSG_STORE_BITS;
+				}
+				node = ( word & 1 ) ? node->right : node->left;
+				word >>= 1;
+				wordBits--;
+				bit++;
+			}
+
+			if ( !node ) {
+				// same as Huff_offsetReceive, a zero without moving on
+				bit = start;
+				wordBits = 0;
+				continue;
 			}
-//			fclose(fp);
+			value = (unsigned int)value | ( (unsigned int)node->symbol << ( i + nbits ) );
 		}
-		msg->readcount = (msg->bit>>3)+1;
+
+		msg->bit = bit;
+		msg->readcount = ( bit >> 3 ) + 1;
 	}
 	if ( sgn && bits > 0 && bits < 32 ) {
 		if ( value & ( 1 << ( bits - 1 ) ) ) {
@@ -259,8 +398,6 @@ int MSG_ReadBits( msg_t *msg, int bits ) {
 	return value;
 }
 
-
-
 //================================================================================
 
 //
@@ -804,16 +941,13 @@ netField_t	entityStateFields[] =
 
 /*
 ==================
-MSG_WriteDeltaEntity
+MSG_WriteDeltaEntityFields
 
-Writes part of a packetentities message, including the entity number.
-Can delta from either a baseline or a previous packet_entity
-If to is NULL, a remove entity update will be sent
-If force is not set, then nothing at all will be generated if the entity is
-identical, under the assumption that the in-order delta code will catch it.
+MSG_WriteDeltaEntity the original way, one field and one MSG_WriteBits at a
+time.  Used for out of band messages and as the reference for msgtest.
 ==================
 */
-void MSG_WriteDeltaEntity( msg_t *msg, struct entityState_s *from, struct entityState_s *to, 
+void MSG_WriteDeltaEntityFields( msg_t *msg, struct entityState_s *from, struct entityState_s *to, 
 						   qboolean force ) {
 	int			i, lc;
 	int			numFields;
@@ -1110,13 +1244,371 @@ netField_t	playerStateFields[] =
 { PSF(loopSound), 16 }
 };
 
+/*
+============================================================================
+
+table driven delta encoding
+
+MSG_WriteDeltaEntity and MSG_WriteDeltaPlayerstate find every changed
+32 bit word of the structures with vector compares, and map the words back
+to netField_t entries through a table.
+
+Instead of going through MSG_WriteBits for every field, the raw bits and
+Huffman codes of all the fields are collected in a deltaWriter_t and stored
+a word at a time with MSG_StoreBits.  The message comes out bit for bit the
+same as from the field by field versions.
+
+============================================================================
+*/
+
+#define	ENTITY_WORDS		( sizeof( entityState_t ) / 4 )
+#define	PLAYER_WORDS		( sizeof( playerState_t ) / 4 )
+#define	WORD_MASKS( words )	( ( (words) + 63 ) / 64 )
+#define	PSW(x)				( (size_t)&((playerState_t*)0)->x / 4 )
+
+// netField_t index for every word of the structures, -1 if it isn't a field
+static signed char	entityFieldForWord[ENTITY_WORDS];
+static signed char	playerFieldForWord[PLAYER_WORDS];
+
+typedef struct {
+	msg_t		*msg;
+	uint64_t	bits;		// raw bits not stored yet, first one in the lowest bit
+	int			numBits;
+} deltaWriter_t;
+
+/*
+==================
+MSG_InitDeltaTables
+==================
+*/
+static void MSG_InitDeltaTables( void ) {
+	int		i;
+
+	Com_Memset( entityFieldForWord, -1, sizeof( entityFieldForWord ) );
+	for ( i = 0 ; i < ARRAY_LEN( entityStateFields ) ; i++ ) {
+		entityFieldForWord[entityStateFields[i].offset >> 2] = i;
+	}
+
+	Com_Memset( playerFieldForWord, -1, sizeof( playerFieldForWord ) );
+	for ( i = 0 ; i < ARRAY_LEN( playerStateFields ) ; i++ ) {
+		playerFieldForWord[playerStateFields[i].offset >> 2] = i;
+	}
+}
+
+/*
+==================
+MSG_ChangedWords
+
+Sets a bit in mask for every 32 bit word that differs between a and b
+==================
+*/
+static void MSG_ChangedWords( const int *a, const int *b, int numWords, uint64_t *mask ) {
+	int		i;
+
+	Com_Memset( mask, 0, WORD_MASKS( numWords ) * sizeof( *mask ) );
+
+	i = 0;
+#if idx64
+	for ( ; i + 4 <= numWords ; i += 4 ) {
+		__m128i		eq = _mm_cmpeq_epi32( _mm_loadu_si128( (const __m128i *)( a + i ) ),
+							_mm_loadu_si128( (const __m128i *)( b + i ) ) );
+		unsigned	diff = ~_mm_movemask_ps( _mm_castsi128_ps( eq ) ) & 15;
+
+		mask[i >> 6] |= (uint64_t)diff << ( i & 63 );
+	}
+#elif defined( __aarch64__ )
+	{
+		static const uint32_t	laneBits[4] = { 1, 2, 4, 8 };
+		uint32x4_t				lanes = vld1q_u32( laneBits );
+
+		for ( ; i + 4 <= numWords ; i += 4 ) {
+			uint32x4_t	eq = vceqq_u32( vld1q_u32( (const uint32_t *)( a + i ) ),
+							vld1q_u32( (const uint32_t *)( b + i ) ) );
+			unsigned	diff = vaddvq_u32( vbicq_u32( lanes, eq ) );
+
+			mask[i >> 6] |= (uint64_t)diff << ( i & 63 );
+		}
+	}
+#endif
+	for ( ; i < numWords ; i++ ) {
+		if ( a[i] != b[i] ) {
+			mask[i >> 6] |= (uint64_t)1 << ( i & 63 );
+		}
+	}
+}
+
+/*
+==================
+MSG_LowestBit
+==================
+*/
+static ID_INLINE int MSG_LowestBit( uint64_t x ) {
+#ifdef __GNUC__
+	return __builtin_ctzll( x );
+#else
+	int		n = 0;
+
+	while ( !( x & 1 ) ) {
+		x >>= 1;
+		n++;
+	}
+	return n;
+#endif
+}
+
+/*
+==================
+MSG_ChangedFields
+
+Turns a word mask into a mask of changed netField_t entries, returns the
+number of fields up to and including the last changed one
+==================
+*/
+static int MSG_ChangedFields( const uint64_t *mask, int numWords, const signed char *fieldForWord, uint64_t *fields ) {
+	uint64_t	m;
+	int			i, word, field, lc;
+
+	*fields = 0;
+	lc = 0;
+	for ( i = 0 ; i < WORD_MASKS( numWords ) ; i++ ) {
+		for ( m = mask[i] ; m ; m &= m - 1 ) {
+			word = ( i << 6 ) + MSG_LowestBit( m );
+			field = fieldForWord[word];
+			if ( field < 0 ) {
+				continue;
+			}
+			*fields |= (uint64_t)1 << field;
+			if ( field >= lc ) {
+				lc = field + 1;
+			}
+		}
+	}
+
+	return lc;
+}
+
+/*
+==================
+MSG_MaskBits
+
+Returns count bits of the word mask starting at word first
+==================
+*/
+static int MSG_MaskBits( const uint64_t *mask, int first, int count ) {
+	uint64_t	bits;
+
+	bits = mask[first >> 6] >> ( first & 63 );
+	if ( ( first & 63 ) + count > 64 ) {
+		bits |= mask[( first >> 6 ) + 1] << ( 64 - ( first & 63 ) );
+	}
+
+	return (int)( bits & ( ( (uint64_t)1 << count ) - 1 ) );
+}
+
+/*
+==================
+MSG_FlushDeltaBits
+
+Stores the pending bits
+==================
+*/
+static void MSG_FlushDeltaBits( deltaWriter_t *w ) {
+	msg_t		*msg = w->msg;
+	uint64_t	bits = w->bits;
+	int			numBits = w->numBits;
+
+	w->bits = 0;
+	w->numBits = 0;
+
+	if ( !numBits || msg->overflowed ) {
+		return;
+	}
+
+	oldsize += numBits;
+
+	if ( msg->bit + numBits > msg->maxsize << 3 ) {
+		msg->overflowed = qtrue;
+		return;
+	}
+
+	MSG_StoreBits( msg, bits, numBits );
+	msg->cursize = ( msg->bit >> 3 ) + 1;
+}
+
+/*
+==================
+MSG_DeltaBits
+
+Queues up to 32 bits
+==================
+*/
+static ID_INLINE void MSG_DeltaBits( deltaWriter_t *w, unsigned int value, int bits ) {
+	if ( w->numBits + bits > MSG_STORE_BITS ) {
+		MSG_FlushDeltaBits( w );
+	}
+	w->bits |= (uint64_t)value << w->numBits;
+	w->numBits += bits;
+}
+
+/*
+==================
+MSG_DeltaValue
+
+Same as MSG_WriteBits
+==================
+*/
+static void MSG_DeltaValue( deltaWriter_t *w, int value, int bits ) {
+	msg_t		*msg = w->msg;
+	unsigned	v;
+	int			nbits, i;
+
+	if ( bits < 0 ) {
+		bits = -bits;
+	}
+
+	v = (unsigned)value & ( 0xffffffff >> ( 32 - bits ) );
+
+	nbits = bits & 7;
+	if ( nbits ) {
+		MSG_DeltaBits( w, v & ( ( 1 << nbits ) - 1 ), nbits );
+		v >>= nbits;
+		bits -= nbits;
+	}
+
+	for ( i = 0 ; i < bits ; i += 8, v >>= 8 ) {
+		if ( msgHuffTable.length[v & 0xff] ) {
+			MSG_DeltaBits( w, msgHuffTable.code[v & 0xff], msgHuffTable.length[v & 0xff] );
+			continue;
+		}
+
+		MSG_FlushDeltaBits( w );
+		if ( msg->overflowed ) {
+			return;
+		}
+		Huff_offsetTransmit( &msgHuff.compressor, v & 0xff, msg->data, &msg->bit, msg->maxsize << 3 );
+		if ( msg->bit > msg->maxsize << 3 ) {
+			msg->overflowed = qtrue;
+			return;
+		}
+		msg->cursize = ( msg->bit >> 3 ) + 1;
+	}
+}
+
+/*
+==================
+MSG_DeltaFloat
+==================
+*/
+static ID_INLINE void MSG_DeltaFloat( deltaWriter_t *w, int *toF ) {
+	float	fullFloat = *(float *)toF;
+	int		trunc = (int)fullFloat;
+
+	if ( trunc == fullFloat && trunc + FLOAT_INT_BIAS >= 0 && 
+		trunc + FLOAT_INT_BIAS < ( 1 << FLOAT_INT_BITS ) ) {
+		// send as small integer
+		MSG_DeltaBits( w, 0, 1 );
+		MSG_DeltaValue( w, trunc + FLOAT_INT_BIAS, FLOAT_INT_BITS );
+	} else {
+		// send as full floating point value
+		MSG_DeltaBits( w, 1, 1 );
+		MSG_DeltaValue( w, *toF, 32 );
+	}
+}
+
+/*
+==================
+MSG_WriteDeltaEntity
+
+Writes part of a packetentities message, including the entity number.
+Can delta from either a baseline or a previous packet_entity
+If to is NULL, a remove entity update will be sent
+If force is not set, then nothing at all will be generated if the entity is
+identical, under the assumption that the in-order delta code will catch it.
+==================
+*/
+void MSG_WriteDeltaEntity( msg_t *msg, struct entityState_s *from, struct entityState_s *to, 
+						   qboolean force ) {
+	int				i, lc;
+	uint64_t		mask[WORD_MASKS( ENTITY_WORDS )];
+	uint64_t		changed;
+	netField_t		*field;
+	int				*toF;
+	deltaWriter_t	w;
+
+	if ( to == NULL || msg->oob ) {
+		MSG_WriteDeltaEntityFields( msg, from, to, force );
+		return;
+	}
+
+	if ( to->number < 0 || to->number >= MAX_GENTITIES ) {
+		Com_Error (ERR_FATAL, "MSG_WriteDeltaEntity: Bad entity number: %i", to->number );
+	}
+
+	MSG_ChangedWords( (int *)from, (int *)to, ENTITY_WORDS, mask );
+	lc = MSG_ChangedFields( mask, ENTITY_WORDS, entityFieldForWord, &changed );
+
+	w.msg = msg;
+	w.bits = 0;
+	w.numBits = 0;
+
+	if ( lc == 0 ) {
+		// nothing at all changed
+		if ( !force ) {
+			return;		// nothing at all
+		}
+		// write two bits for no change
+		MSG_DeltaValue( &w, to->number, GENTITYNUM_BITS );
+		MSG_DeltaBits( &w, 0, 2 );		// not removed, no delta
+		MSG_FlushDeltaBits( &w );
+		return;
+	}
+
+	MSG_DeltaValue( &w, to->number, GENTITYNUM_BITS );
+	MSG_DeltaBits( &w, 2, 2 );			// not removed, we have a delta
+	MSG_DeltaValue( &w, lc, 8 );		// # of changes
+
+	oldsize += ARRAY_LEN( entityStateFields );
+
+	for ( i = 0, field = entityStateFields ; i < lc ; i++, field++ ) {
+		if ( !( changed & ( (uint64_t)1 << i ) ) ) {
+			MSG_DeltaBits( &w, 0, 1 );	// no change
+			continue;
+		}
+
+		MSG_DeltaBits( &w, 1, 1 );	// changed
+
+		toF = (int *)( (byte *)to + field->offset );
+		if ( field->bits == 0 ) {
+			// float
+			if ( *(float *)toF == 0.0f ) {
+				MSG_DeltaBits( &w, 0, 1 );
+				oldsize += FLOAT_INT_BITS;
+			} else {
+				MSG_DeltaBits( &w, 1, 1 );
+				MSG_DeltaFloat( &w, toF );
+			}
+		} else {
+			if ( *toF == 0 ) {
+				MSG_DeltaBits( &w, 0, 1 );
+			} else {
+				MSG_DeltaBits( &w, 1, 1 );
+				// integer
+				MSG_DeltaValue( &w, *toF, field->bits );
+			}
+		}
+	}
+
+	MSG_FlushDeltaBits( &w );
+}
+
 /*
 =============
-MSG_WriteDeltaPlayerstate
+MSG_WriteDeltaPlayerstateFields
 
+MSG_WriteDeltaPlayerstate the original way, one field at a time
 =============
 */
-void MSG_WriteDeltaPlayerstate( msg_t *msg, struct playerState_s *from, struct playerState_s *to ) {
+void MSG_WriteDeltaPlayerstateFields( msg_t *msg, struct playerState_s *from, struct playerState_s *to ) {
 	int				i;
 	playerState_t	dummy;
 	int				statsbits;
@@ -1263,6 +1755,115 @@ void MSG_WriteDeltaPlayerstate( msg_t *msg, struct playerState_s *from, struct p
 }
 
 
+/*
+=============
+MSG_DeltaArray
+
+Sends one of the playerState_t arrays, values are written with
+the given number of bits
+=============
+*/
+static void MSG_DeltaArray( deltaWriter_t *w, int changed, int count, const int *values, int bits ) {
+	int		i;
+
+	if ( !changed ) {
+		MSG_DeltaBits( w, 0, 1 );	// no change
+		return;
+	}
+
+	MSG_DeltaBits( w, 1, 1 );	// changed
+	MSG_DeltaValue( w, changed, count );
+	for ( i = 0 ; i < count ; i++ ) {
+		if ( changed & ( 1 << i ) ) {
+			MSG_DeltaValue( w, values[i], bits );
+		}
+	}
+}
+
+/*
+=============
+MSG_WriteDeltaPlayerstate
+
+=============
+*/
+void MSG_WriteDeltaPlayerstate( msg_t *msg, struct playerState_s *from, struct playerState_s *to ) {
+	int				i;
+	playerState_t	dummy;
+	int				statsbits;
+	int				persistantbits;
+	int				ammobits;
+	int				powerupbits;
+	uint64_t		mask[WORD_MASKS( PLAYER_WORDS )];
+	uint64_t		changed;
+	netField_t		*field;
+	int				*toF;
+	int				lc;
+	deltaWriter_t	w;
+
+	if ( msg->oob ) {
+		MSG_WriteDeltaPlayerstateFields( msg, from, to );
+		return;
+	}
+
+	if (!from) {
+		from = &dummy;
+		Com_Memset (&dummy, 0, sizeof(dummy));
+	}
+
+	MSG_ChangedWords( (int *)from, (int *)to, PLAYER_WORDS, mask );
+	lc = MSG_ChangedFields( mask, PLAYER_WORDS, playerFieldForWord, &changed );
+
+	w.msg = msg;
+	w.bits = 0;
+	w.numBits = 0;
+
+	MSG_DeltaValue( &w, lc, 8 );	// # of changes
+
+	oldsize += ARRAY_LEN( playerStateFields ) - lc;
+
+	for ( i = 0, field = playerStateFields ; i < lc ; i++, field++ ) {
+		if ( !( changed & ( (uint64_t)1 << i ) ) ) {
+			MSG_DeltaBits( &w, 0, 1 );	// no change
+			continue;
+		}
+
+		MSG_DeltaBits( &w, 1, 1 );	// changed
+
+		toF = (int *)( (byte *)to + field->offset );
+		if ( field->bits == 0 ) {
+			// float
+			MSG_DeltaFloat( &w, toF );
+		} else {
+			// integer
+			MSG_DeltaValue( &w, *toF, field->bits );
+		}
+	}
+
+	//
+	// send the arrays
+	//
+	statsbits = MSG_MaskBits( mask, PSW( stats ), MAX_STATS );
+	persistantbits = MSG_MaskBits( mask, PSW( persistant ), MAX_PERSISTANT );
+	ammobits = MSG_MaskBits( mask, PSW( ammo ), MAX_WEAPONS );
+	powerupbits = MSG_MaskBits( mask, PSW( powerups ), MAX_POWERUPS );
+
+	if (!statsbits && !persistantbits && !ammobits && !powerupbits) {
+		MSG_DeltaBits( &w, 0, 1 );	// no change
+		MSG_FlushDeltaBits( &w );
+		oldsize += 4;
+		return;
+	}
+	MSG_DeltaBits( &w, 1, 1 );	// changed
+
+	MSG_DeltaArray( &w, statsbits, MAX_STATS, to->stats, 16 );
+	MSG_DeltaArray( &w, persistantbits, MAX_PERSISTANT, to->persistant, 16 );
+	MSG_DeltaArray( &w, ammobits, MAX_WEAPONS, to->ammo, 16 );
+	MSG_DeltaArray( &w, powerupbits, MAX_POWERUPS, to->powerups, 32 );
+
+	MSG_FlushDeltaBits( &w );
+}
+
+
 /*
 ===================
 MSG_ReadDeltaPlayerstate
@@ -1677,6 +2278,10 @@ void MSG_initHuffman( void ) {
 			Huff_addRef(&msgHuff.decompressor,	(byte)i);			// Do update
 		}
 	}
+
+	// the decompressor is built from the same counts, so one table does for both
+	Huff_BuildTable( msgHuff.compressor.tree, &msgHuffTable );
+	MSG_InitDeltaTables();
 }
 
 /*
@@ -0,0 +1,1046 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// msg_test.c -- checks the table driven delta encoders against the field
+// by field ones and times both, and times the bit functions over a demo
+
+/*
+
+msgtest [count] [seed] [repeat]
+
+Builds count random entityState_t and playerState_t deltas, shaped like
+the ones a server sends: most states change in a few words, some not at
+all, some everywhere, with values picked to hit every path of the encoders
+(zero, small integer and full floats, negative zero, wide integers).
+
+Every delta is written with both MSG_WriteDeltaEntity and
+MSG_WriteDeltaEntityFields (and the playerstate pair), and the two messages
+must be bit for bit the same.  The message is then read back, where every
+delta has to end at the bit it was written to, and the decoded states have
+to come through another write and read unchanged.
+
+With repeat, each encoder and the decoder are also timed over that many
+passes through the whole set.
+
+*/
+
+#include "q_shared.h"
+#include "qcommon.h"
+
+#define MSGT_ENTITY_BYTES	512		// more than a full entity or playerstate delta takes
+#define MSGT_PLAYER_BYTES	1024
+
+typedef struct {
+	int				count;
+	int				seed;
+
+	entityState_t	*entFrom;
+	entityState_t	*entTo;
+	qboolean		*entRemove;
+	qboolean		*entForce;
+
+	playerState_t	*psFrom;
+	playerState_t	*psTo;
+
+	int				*bitPos;		// message position after each delta
+	byte			*buf[2];
+	int				bufSize;
+} msgTest_t;
+
+static msgTest_t	msgt;
+
+/*
+=================
+MSGT_Rand
+=================
+*/
+static int MSGT_Rand( int range ) {
+	return ( (unsigned)Q_rand( &msgt.seed ) >> 8 ) % range;
+}
+
+/*
+=================
+MSGT_Value
+
+A random word value, biased towards the cases the encoders treat specially
+=================
+*/
+static int MSGT_Value( void ) {
+	floatint_t	v;
+
+	switch ( MSGT_Rand( 8 ) ) {
+	case 0:
+		return 0;
+	case 1:
+		return MSGT_Rand( 600 ) - 300;
+	case 2:
+		v.f = MSGT_Rand( 8192 ) - 4096;			// fits in FLOAT_INT_BITS
+		return v.i;
+	case 3:
+		v.f = Q_crandom( &msgt.seed ) * 1000.0f;
+		return v.i;
+	case 4:
+		v.f = 100000.0f + MSGT_Rand( 1000 );
+		return v.i;
+	case 5:
+		return 0x80000000;						// -0.0f
+	default:
+		return Q_rand( &msgt.seed );
+	}
+}
+
+/*
+=================
+MSGT_Mutate
+
+Changes a few random words, none of them, or all of them
+=================
+*/
+static void MSGT_Mutate( int *words, int numWords, int firstWord ) {
+	int		i, n;
+
+	n = MSGT_Rand( 10 );
+	if ( n < 3 ) {
+		return;
+	}
+	if ( n < 8 ) {
+		for ( i = MSGT_Rand( 4 ) + 1 ; i > 0 ; i-- ) {
+			words[firstWord + MSGT_Rand( numWords - firstWord )] = MSGT_Value();
+		}
+		return;
+	}
+	for ( i = firstWord ; i < numWords ; i++ ) {
+		words[i] = MSGT_Value();
+	}
+}
+
+/*
+=================
+MSGT_Generate
+=================
+*/
+static void MSGT_Generate( void ) {
+	int		i, j;
+	int		*words;
+
+	for ( i = 0 ; i < msgt.count ; i++ ) {
+		// a quarter delta from a zero baseline
+		words = (int *)&msgt.entFrom[i];
+		if ( MSGT_Rand( 4 ) ) {
+			for ( j = 0 ; j < sizeof( entityState_t ) / 4 ; j++ ) {
+				words[j] = MSGT_Value();
+			}
+		} else {
+			Com_Memset( words, 0, sizeof( entityState_t ) );
+		}
+		msgt.entFrom[i].number = MSGT_Rand( MAX_GENTITIES - 1 );
+		msgt.entTo[i] = msgt.entFrom[i];
+		MSGT_Mutate( (int *)&msgt.entTo[i], sizeof( entityState_t ) / 4, 1 );
+		msgt.entRemove[i] = MSGT_Rand( 20 ) == 0;
+		msgt.entForce[i] = MSGT_Rand( 2 );
+
+		words = (int *)&msgt.psFrom[i];
+		for ( j = 0 ; j < sizeof( playerState_t ) / 4 ; j++ ) {
+			words[j] = MSGT_Value();
+		}
+		msgt.psTo[i] = msgt.psFrom[i];
+		MSGT_Mutate( (int *)&msgt.psTo[i], sizeof( playerState_t ) / 4, 0 );
+	}
+}
+
+/*
+=================
+MSGT_WriteEntities
+=================
+*/
+static void MSGT_WriteEntities( msg_t *msg, qboolean reference, qboolean positions ) {
+	int		i;
+
+	MSG_Init( msg, msgt.buf[reference], msgt.bufSize );
+	for ( i = 0 ; i < msgt.count ; i++ ) {
+		entityState_t	*to = msgt.entRemove[i] ? NULL : &msgt.entTo[i];
+
+		if ( reference ) {
+			MSG_WriteDeltaEntityFields( msg, &msgt.entFrom[i], to, msgt.entForce[i] );
+		} else {
+			MSG_WriteDeltaEntity( msg, &msgt.entFrom[i], to, msgt.entForce[i] );
+		}
+		if ( positions ) {
+			msgt.bitPos[i] = msg->bit;
+		}
+	}
+}
+
+/*
+=================
+MSGT_WritePlayers
+=================
+*/
+static void MSGT_WritePlayers( msg_t *msg, qboolean reference, qboolean positions ) {
+	int		i;
+
+	MSG_Init( msg, msgt.buf[reference], msgt.bufSize );
+	for ( i = 0 ; i < msgt.count ; i++ ) {
+		// every eighth one from nothing, like the first snapshot
+		playerState_t	*from = ( i & 7 ) ? &msgt.psFrom[i] : NULL;
+
+		if ( reference ) {
+			MSG_WriteDeltaPlayerstateFields( msg, from, &msgt.psTo[i] );
+		} else {
+			MSG_WriteDeltaPlayerstate( msg, from, &msgt.psTo[i] );
+		}
+		if ( positions ) {
+			msgt.bitPos[i] = msg->bit;
+		}
+	}
+}
+
+/*
+=================
+MSGT_Compare
+
+Returns qtrue if both messages hold the same bits
+=================
+*/
+static qboolean MSGT_Compare( msg_t *a, msg_t *b ) {
+	if ( a->overflowed || b->overflowed ) {
+		return qfalse;
+	}
+	if ( a->bit != b->bit ) {
+		return qfalse;
+	}
+	return !memcmp( a->data, b->data, ( a->bit + 7 ) >> 3 );
+}
+
+/*
+=================
+MSGT_EntityRoundTrip
+
+Values that don't fit their fields come back changed from the first trip,
+but after that a state has to survive being written and read unchanged
+=================
+*/
+static qboolean MSGT_EntityRoundTrip( entityState_t *from, entityState_t *state ) {
+	msg_t			msg;
+	byte			buf[MSGT_ENTITY_BYTES];
+	entityState_t	read;
+
+	MSG_Init( &msg, buf, sizeof( buf ) );
+	MSG_WriteDeltaEntity( &msg, from, state, qtrue );
+	MSG_BeginReading( &msg );
+	MSG_ReadDeltaEntity( &msg, from, &read, MSG_ReadBits( &msg, GENTITYNUM_BITS ) );
+
+	return !memcmp( &read, state, sizeof( read ) );
+}
+
+/*
+=================
+MSGT_PlayerRoundTrip
+=================
+*/
+static qboolean MSGT_PlayerRoundTrip( playerState_t *from, playerState_t *state ) {
+	msg_t			msg;
+	byte			buf[MSGT_ENTITY_BYTES];
+	playerState_t	read;
+
+	MSG_Init( &msg, buf, sizeof( buf ) );
+	MSG_WriteDeltaPlayerstate( &msg, from, state );
+	MSG_BeginReading( &msg );
+	MSG_ReadDeltaPlayerstate( &msg, from, &read );
+
+	return !memcmp( &read, state, sizeof( read ) );
+}
+
+/*
+=================
+MSGT_ReadEntities
+
+Returns the number of deltas that didn't read back
+=================
+*/
+static int MSGT_ReadEntities( msg_t *msg, qboolean check ) {
+	entityState_t	state;
+	int				i, number, lastBit, failed;
+
+	MSG_BeginReading( msg );
+	lastBit = 0;
+	failed = 0;
+	for ( i = 0 ; i < msgt.count ; i++ ) {
+		if ( msgt.bitPos[i] == lastBit ) {
+			continue;		// unchanged and not forced, nothing was written
+		}
+		lastBit = msgt.bitPos[i];
+
+		number = MSG_ReadBits( msg, GENTITYNUM_BITS );
+		MSG_ReadDeltaEntity( msg, &msgt.entFrom[i], &state, number );
+
+		if ( !check ) {
+			continue;
+		}
+		if ( msg->bit != msgt.bitPos[i] ) {
+			failed++;
+			msg->bit = msgt.bitPos[i];
+		} else if ( msgt.entRemove[i] ) {
+			if ( state.number != MAX_GENTITIES - 1 ) {
+				failed++;
+			}
+		} else if ( state.number != msgt.entTo[i].number ||
+			!MSGT_EntityRoundTrip( &msgt.entFrom[i], &state ) ) {
+			failed++;
+		}
+	}
+
+	return failed;
+}
+
+/*
+=================
+MSGT_ReadPlayers
+=================
+*/
+static int MSGT_ReadPlayers( msg_t *msg, qboolean check ) {
+	playerState_t	state, *from;
+	int				i, failed;
+
+	MSG_BeginReading( msg );
+	failed = 0;
+	for ( i = 0 ; i < msgt.count ; i++ ) {
+		from = ( i & 7 ) ? &msgt.psFrom[i] : NULL;
+		MSG_ReadDeltaPlayerstate( msg, from, &state );
+
+		if ( !check ) {
+			continue;
+		}
+		if ( msg->bit != msgt.bitPos[i] ) {
+			failed++;
+			msg->bit = msgt.bitPos[i];
+		} else if ( !MSGT_PlayerRoundTrip( from, &state ) ) {
+			failed++;
+		}
+	}
+
+	return failed;
+}
+
+/*
+=================
+MSGT_Free
+=================
+*/
+static void MSGT_Free( void ) {
+	if ( msgt.entFrom ) {
+		Z_Free( msgt.entFrom );
+		Z_Free( msgt.entTo );
+		Z_Free( msgt.entRemove );
+		Z_Free( msgt.entForce );
+		Z_Free( msgt.psFrom );
+		Z_Free( msgt.psTo );
+		Z_Free( msgt.bitPos );
+		Z_Free( msgt.buf[0] );
+		Z_Free( msgt.buf[1] );
+	}
+	Com_Memset( &msgt, 0, sizeof( msgt ) );
+}
+
+/*
+=================
+MSG_Test_f
+=================
+*/
+void MSG_Test_f( void ) {
+	msg_t	msg[2];
+	int		count, seed, repeat;
+	int		entFailed, psFailed;
+	int		msec[3];
+	int		entBytes, psBytes;
+	int		i, j, start;
+
+	count = Cmd_Argc() > 1 ? atoi( Cmd_Argv( 1 ) ) : 10000;
+	seed = Cmd_Argc() > 2 ? atoi( Cmd_Argv( 2 ) ) : Com_Milliseconds();
+	repeat = Cmd_Argc() > 3 ? atoi( Cmd_Argv( 3 ) ) : 0;
+	if ( count < 1 || count > 20000 ) {
+		Com_Printf( "msgtest: count must be 1 to 20000\n" );
+		return;
+	}
+
+	MSGT_Free();
+	msgt.count = count;
+	msgt.seed = seed;
+	msgt.entFrom = Z_Malloc( count * sizeof( entityState_t ) );
+	msgt.entTo = Z_Malloc( count * sizeof( entityState_t ) );
+	msgt.entRemove = Z_Malloc( count * sizeof( qboolean ) );
+	msgt.entForce = Z_Malloc( count * sizeof( qboolean ) );
+	msgt.psFrom = Z_Malloc( count * sizeof( playerState_t ) );
+	msgt.psTo = Z_Malloc( count * sizeof( playerState_t ) );
+	msgt.bitPos = Z_Malloc( count * sizeof( int ) );
+	msgt.bufSize = count * MSGT_ENTITY_BYTES;
+	msgt.buf[0] = Z_Malloc( msgt.bufSize );
+	msgt.buf[1] = Z_Malloc( msgt.bufSize );
+
+	MSGT_Generate();
+
+	// entities, the table driven message ends up in buf[0]
+	MSGT_WriteEntities( &msg[1], qtrue, qfalse );
+	MSGT_WriteEntities( &msg[0], qfalse, qtrue );
+	entBytes = msg[0].cursize;
+	entFailed = MSGT_Compare( &msg[0], &msg[1] ) ? 0 : 1;
+	entFailed += MSGT_ReadEntities( &msg[0], qtrue );
+
+	MSGT_WritePlayers( &msg[1], qtrue, qfalse );
+	MSGT_WritePlayers( &msg[0], qfalse, qtrue );
+	psBytes = msg[0].cursize;
+	psFailed = MSGT_Compare( &msg[0], &msg[1] ) ? 0 : 1;
+	psFailed += MSGT_ReadPlayers( &msg[0], qtrue );
+
+	Com_Printf( "msgtest: %i entity deltas (%i bytes), %i failed\n", count, entBytes, entFailed );
+	Com_Printf( "msgtest: %i playerstate deltas (%i bytes), %i failed, seed %i\n", count, psBytes, psFailed, seed );
+
+	if ( repeat > 0 ) {
+		Com_Memset( msec, 0, sizeof( msec ) );
+		for ( i = 0 ; i < repeat ; i++ ) {
+			for ( j = 0 ; j < 2 ; j++ ) {
+				start = Sys_Milliseconds();
+				MSGT_WriteEntities( &msg[j], j, qfalse );
+				MSGT_WritePlayers( &msg[j], j, qfalse );
+				msec[j] += Sys_Milliseconds() - start;
+			}
+
+			MSGT_WriteEntities( &msg[0], qfalse, qtrue );
+			start = Sys_Milliseconds();
+			MSGT_ReadEntities( &msg[0], qfalse );
+			msec[2] += Sys_Milliseconds() - start;
+
+			MSGT_WritePlayers( &msg[0], qfalse, qtrue );
+			start = Sys_Milliseconds();
+			MSGT_ReadPlayers( &msg[0], qfalse );
+			msec[2] += Sys_Milliseconds() - start;
+		}
+		Com_Printf( "msgtest: %i passes, encode %i msec table driven, %i msec field by field\n",
+			repeat, msec[0], msec[1] );
+		Com_Printf( "msgtest: decode %i msec\n", msec[2] );
+	}
+
+	MSGT_Free();
+}
+
+/*
+==============================================================================
+
+msgbench <demo> [repeat]
+
+Times MSG_ReadBits, MSG_WriteBits and the delta functions over the server
+messages of a recorded demo.  The demo is parsed once the way the client
+parses it, and every read is recorded: plain fields with their width and
+value, entity and playerstate deltas with the states on both sides.
+
+The timed passes then go through every message again, once reading it with
+the recorded widths, and once writing the recorded values into a new
+message, which has to come out byte for byte the same as the demo's.
+Messages with downloads or voip in them, or deltas from snapshots the demo
+doesn't have, are left out.
+
+==============================================================================
+*/
+
+typedef enum {
+	MSGB_BITS,
+	MSGB_ENTITY,		// entity number and delta
+	MSGB_PLAYER
+} msgbOpType_t;
+
+typedef struct {
+	byte			type;
+	signed char		bits;
+	int				value;		// value read, or entity / player index
+} msgbOp_t;
+
+typedef struct {
+	entityState_t	from;
+	entityState_t	to;
+} msgbEntity_t;
+
+typedef struct {
+	qboolean		noFrom;
+	playerState_t	from;
+	playerState_t	to;
+} msgbPlayer_t;
+
+typedef struct {
+	byte			*data;
+	int				size;
+	int				bits;		// where the last read ended
+	int				firstOp;
+	int				numOps;
+} msgbMessage_t;
+
+typedef struct {
+	qboolean		valid;
+	int				messageNum;
+	playerState_t	ps;
+	int				numEntities;
+	entityState_t	entities[MAX_SNAPSHOT_ENTITIES];
+} msgbSnapshot_t;
+
+typedef struct {
+	msgbMessage_t	*messages;
+	int				numMessages, maxMessages;
+	msgbOp_t		*ops;
+	int				numOps, maxOps;
+	msgbEntity_t	*entities;
+	int				numEntities, maxEntities;
+	msgbPlayer_t	*players;
+	int				numPlayers, maxPlayers;
+
+	entityState_t	*baselines;
+	msgbSnapshot_t	*snapshots;		// PACKET_BACKUP, and one being parsed
+	qboolean		failed;			// the current message can't be replayed
+
+	byte			*buffer;		// MAX_MSGLEN for writing
+} msgBench_t;
+
+static msgBench_t	msgb;
+
+/*
+=================
+MSGB_Grow
+=================
+*/
+static void *MSGB_Grow( void *array, int *max, int size ) {
+	void	*grown;
+	int		newMax;
+
+	newMax = *max ? *max * 2 : 1024;
+	grown = Z_Malloc( newMax * size );
+	if ( array ) {
+		Com_Memcpy( grown, array, *max * size );
+		Z_Free( array );
+	}
+	*max = newMax;
+
+	return grown;
+}
+
+/*
+=================
+MSGB_AddOp
+=================
+*/
+static void MSGB_AddOp( msgbOpType_t type, int bits, int value ) {
+	msgbOp_t	*op;
+
+	if ( msgb.numOps == msgb.maxOps ) {
+		msgb.ops = MSGB_Grow( msgb.ops, &msgb.maxOps, sizeof( *msgb.ops ) );
+	}
+	op = &msgb.ops[msgb.numOps++];
+	op->type = type;
+	op->bits = bits;
+	op->value = value;
+}
+
+/*
+=================
+MSGB_Read
+=================
+*/
+static int MSGB_Read( msg_t *msg, int bits ) {
+	int		value;
+
+	value = MSG_ReadBits( msg, bits );
+	MSGB_AddOp( MSGB_BITS, bits, value );
+
+	return value;
+}
+
+/*
+=================
+MSGB_ReadString
+
+Same reads as MSG_ReadString, without keeping the string
+=================
+*/
+static void MSGB_ReadString( msg_t *msg ) {
+	while ( MSGB_Read( msg, 8 ) && msg->readcount <= msg->cursize ) {
+	}
+}
+
+/*
+=================
+MSGB_ReadEntity
+
+Reads an entity number and delta
+=================
+*/
+static void MSGB_ReadEntity( msg_t *msg, const entityState_t *from, int number, entityState_t *to ) {
+	msgbEntity_t	*e;
+
+	if ( msgb.numEntities == msgb.maxEntities ) {
+		msgb.entities = MSGB_Grow( msgb.entities, &msgb.maxEntities, sizeof( *msgb.entities ) );
+	}
+	e = &msgb.entities[msgb.numEntities];
+	e->from = *from;
+	e->from.number = number;		// a removal is written with the old number
+	MSG_ReadDeltaEntity( msg, &e->from, &e->to, number );
+	*to = e->to;
+
+	MSGB_AddOp( MSGB_ENTITY, GENTITYNUM_BITS, msgb.numEntities++ );
+}
+
+/*
+=================
+MSGB_ReadPlayerstate
+=================
+*/
+static void MSGB_ReadPlayerstate( msg_t *msg, const playerState_t *from, playerState_t *to ) {
+	msgbPlayer_t	*p;
+
+	if ( msgb.numPlayers == msgb.maxPlayers ) {
+		msgb.players = MSGB_Grow( msgb.players, &msgb.maxPlayers, sizeof( *msgb.players ) );
+	}
+	p = &msgb.players[msgb.numPlayers];
+	p->noFrom = !from;
+	if ( from ) {
+		p->from = *from;
+	}
+	MSG_ReadDeltaPlayerstate( msg, from ? &p->from : NULL, &p->to );
+	*to = p->to;
+
+	MSGB_AddOp( MSGB_PLAYER, 0, msgb.numPlayers++ );
+}
+
+/*
+=================
+MSGB_ParseGamestate
+=================
+*/
+static void MSGB_ParseGamestate( msg_t *msg ) {
+	entityState_t	nullstate;
+	int				cmd, number;
+
+	Com_Memset( &nullstate, 0, sizeof( nullstate ) );
+	Com_Memset( msgb.baselines, 0, MAX_GENTITIES * sizeof( *msgb.baselines ) );
+	Com_Memset( msgb.snapshots, 0, ( PACKET_BACKUP + 1 ) * sizeof( *msgb.snapshots ) );
+
+	MSGB_Read( msg, 32 );		// serverCommandSequence
+	while ( !msgb.failed ) {
+		cmd = MSGB_Read( msg, 8 );
+		if ( cmd == svc_EOF ) {
+			break;
+		}
+
+		if ( cmd == svc_configstring ) {
+			MSGB_Read( msg, 16 );
+			MSGB_ReadString( msg );
+		} else if ( cmd == svc_baseline ) {
+			number = MSG_ReadBits( msg, GENTITYNUM_BITS );
+			MSGB_ReadEntity( msg, &nullstate, number, &msgb.baselines[number] );
+		} else {
+			msgb.failed = qtrue;
+		}
+	}
+
+	MSGB_Read( msg, 32 );		// clientNum
+	MSGB_Read( msg, 32 );		// checksumFeed
+}
+
+/*
+=================
+MSGB_ParseSnapshot
+=================
+*/
+static void MSGB_ParseSnapshot( msg_t *msg, int messageNum ) {
+	msgbSnapshot_t	*snap, *old;
+	entityState_t	*from, state;
+	int				deltaNum, len, oldIndex, newNum, i;
+
+	snap = &msgb.snapshots[PACKET_BACKUP];
+	old = NULL;
+
+	MSGB_Read( msg, 32 );		// serverTime
+	deltaNum = MSGB_Read( msg, 8 );
+	if ( deltaNum ) {
+		old = &msgb.snapshots[( messageNum - deltaNum ) & ( PACKET_BACKUP - 1 )];
+		if ( !old->valid || old->messageNum != messageNum - deltaNum ) {
+			msgb.failed = qtrue;
+			return;
+		}
+	}
+	MSGB_Read( msg, 8 );		// snapFlags
+
+	len = MSGB_Read( msg, 8 );
+	if ( len > MAX_MAP_AREA_BYTES ) {
+		msgb.failed = qtrue;
+		return;
+	}
+	for ( i = 0 ; i < len ; i++ ) {
+		MSGB_Read( msg, 8 );
+	}
+
+	MSGB_ReadPlayerstate( msg, old ? &old->ps : NULL, &snap->ps );
+
+	// merge the deltas with the old snapshot's entities
+	snap->numEntities = 0;
+	oldIndex = 0;
+	while ( 1 ) {
+		newNum = MSG_ReadBits( msg, GENTITYNUM_BITS );
+		if ( newNum == MAX_GENTITIES - 1 ) {
+			MSGB_AddOp( MSGB_BITS, GENTITYNUM_BITS, newNum );
+			break;
+		}
+		if ( msg->readcount > msg->cursize ) {
+			msgb.failed = qtrue;
+			return;
+		}
+
+		while ( old && oldIndex < old->numEntities && old->entities[oldIndex].number < newNum ) {
+			if ( snap->numEntities == MAX_SNAPSHOT_ENTITIES ) {
+				msgb.failed = qtrue;
+				return;
+			}
+			snap->entities[snap->numEntities++] = old->entities[oldIndex++];
+		}
+
+		if ( old && oldIndex < old->numEntities && old->entities[oldIndex].number == newNum ) {
+			from = &old->entities[oldIndex++];
+		} else {
+			from = &msgb.baselines[newNum];
+		}
+		MSGB_ReadEntity( msg, from, newNum, &state );
+
+		if ( state.number != MAX_GENTITIES - 1 ) {
+			if ( snap->numEntities == MAX_SNAPSHOT_ENTITIES ) {
+				msgb.failed = qtrue;
+				return;
+			}
+			snap->entities[snap->numEntities++] = state;
+		}
+	}
+
+	while ( old && oldIndex < old->numEntities ) {
+		if ( snap->numEntities == MAX_SNAPSHOT_ENTITIES ) {
+			msgb.failed = qtrue;
+			return;
+		}
+		snap->entities[snap->numEntities++] = old->entities[oldIndex++];
+	}
+
+	snap->valid = qtrue;
+	snap->messageNum = messageNum;
+	msgb.snapshots[messageNum & ( PACKET_BACKUP - 1 )] = *snap;
+}
+
+/*
+=================
+MSGB_ParseMessage
+=================
+*/
+static void MSGB_ParseMessage( msg_t *msg, int messageNum ) {
+	int		cmd;
+
+	MSGB_Read( msg, 32 );		// reliableAcknowledge
+	while ( !msgb.failed ) {
+		if ( msg->readcount > msg->cursize ) {
+			msgb.failed = qtrue;
+			break;
+		}
+
+		cmd = MSGB_Read( msg, 8 );
+		if ( cmd == svc_EOF ) {
+			break;
+		}
+
+		switch ( cmd ) {
+		case svc_nop:
+			break;
+		case svc_serverCommand:
+			MSGB_Read( msg, 32 );
+			MSGB_ReadString( msg );
+			break;
+		case svc_gamestate:
+			MSGB_ParseGamestate( msg );
+			break;
+		case svc_snapshot:
+			MSGB_ParseSnapshot( msg, messageNum );
+			break;
+		default:
+			// downloads and voip aren't replayed
+			msgb.failed = qtrue;
+			break;
+		}
+	}
+
+	if ( msg->readcount > msg->cursize ) {
+		msgb.failed = qtrue;
+	}
+}
+
+/*
+=================
+MSGB_Load
+
+Returns the number of messages that were left out
+=================
+*/
+static int MSGB_Load( byte *demo, int length ) {
+	msgbMessage_t	*m;
+	msg_t			msg;
+	int				ofs, sequence, size, skipped;
+	int				firstEntity, firstPlayer;
+
+	skipped = 0;
+	for ( ofs = 0 ; ofs + 8 <= length ; ofs += size ) {
+		sequence = LittleLong( ( (int *)( demo + ofs ) )[0] );
+		size = LittleLong( ( (int *)( demo + ofs ) )[1] );
+		ofs += 8;
+		if ( size == -1 ) {
+			break;
+		}
+		if ( size < 0 || size > MAX_MSGLEN || ofs + size > length ) {
+			Com_Printf( "msgbench: bad message length %i\n", size );
+			break;
+		}
+
+		if ( msgb.numMessages == msgb.maxMessages ) {
+			msgb.messages = MSGB_Grow( msgb.messages, &msgb.maxMessages, sizeof( *msgb.messages ) );
+		}
+		m = &msgb.messages[msgb.numMessages];
+		m->data = demo + ofs;
+		m->size = size;
+		m->firstOp = msgb.numOps;
+		firstEntity = msgb.numEntities;
+		firstPlayer = msgb.numPlayers;
+
+		MSG_Init( &msg, m->data, m->size );
+		msg.cursize = m->size;
+		msgb.failed = qfalse;
+		MSGB_ParseMessage( &msg, sequence );
+
+		if ( msgb.failed ) {
+			msgb.numOps = m->firstOp;
+			msgb.numEntities = firstEntity;
+			msgb.numPlayers = firstPlayer;
+			skipped++;
+			continue;
+		}
+
+		m->bits = msg.bit;
+		m->numOps = msgb.numOps - m->firstOp;
+		msgb.numMessages++;
+	}
+
+	return skipped;
+}
+
+/*
+=================
+MSGB_Decode
+
+Returns the number of messages that didn't read the same as when loaded
+=================
+*/
+static int MSGB_Decode( qboolean check ) {
+	msgbMessage_t	*m;
+	msgbOp_t		*op;
+	msgbEntity_t	*e;
+	msgbPlayer_t	*p;
+	msg_t			msg;
+	entityState_t	state;
+	playerState_t	ps;
+	int				i, j, number, failed, mismatch;
+
+	failed = 0;
+	for ( i = 0, m = msgb.messages ; i < msgb.numMessages ; i++, m++ ) {
+		MSG_Init( &msg, m->data, m->size );
+		msg.cursize = m->size;
+		mismatch = 0;
+
+		for ( j = 0, op = msgb.ops + m->firstOp ; j < m->numOps ; j++, op++ ) {
+			switch ( op->type ) {
+			case MSGB_BITS:
+				mismatch |= MSG_ReadBits( &msg, op->bits ) != op->value;
+				break;
+			case MSGB_ENTITY:
+				e = &msgb.entities[op->value];
+				number = MSG_ReadBits( &msg, GENTITYNUM_BITS );
+				MSG_ReadDeltaEntity( &msg, &e->from, &state, number );
+				if ( check ) {
+					mismatch |= number != e->from.number || memcmp( &state, &e->to, sizeof( state ) );
+				}
+				break;
+			case MSGB_PLAYER:
+				p = &msgb.players[op->value];
+				MSG_ReadDeltaPlayerstate( &msg, p->noFrom ? NULL : &p->from, &ps );
+				if ( check ) {
+					mismatch |= memcmp( &ps, &p->to, sizeof( ps ) ) != 0;
+				}
+				break;
+			}
+		}
+
+		if ( mismatch || msg.bit != m->bits ) {
+			failed++;
+		}
+	}
+
+	return failed;
+}
+
+/*
+=================
+MSGB_Encode
+
+Returns the number of messages that didn't come out the same as the demo's
+=================
+*/
+static int MSGB_Encode( qboolean check ) {
+	msgbMessage_t	*m;
+	msgbOp_t		*op;
+	msgbEntity_t	*e;
+	msgbPlayer_t	*p;
+	msg_t			msg;
+	int				i, j, failed;
+
+	failed = 0;
+	for ( i = 0, m = msgb.messages ; i < msgb.numMessages ; i++, m++ ) {
+		MSG_Init( &msg, msgb.buffer, MAX_MSGLEN );
+
+		for ( j = 0, op = msgb.ops + m->firstOp ; j < m->numOps ; j++, op++ ) {
+			switch ( op->type ) {
+			case MSGB_BITS:
+				MSG_WriteBits( &msg, op->value, op->bits );
+				break;
+			case MSGB_ENTITY:
+				// the server only sends deltas that change something,
+				// so forcing it writes the same bits
+				e = &msgb.entities[op->value];
+				MSG_WriteDeltaEntity( &msg, &e->from,
+					e->to.number == MAX_GENTITIES - 1 ? NULL : &e->to, qtrue );
+				break;
+			case MSGB_PLAYER:
+				p = &msgb.players[op->value];
+				MSG_WriteDeltaPlayerstate( &msg, p->noFrom ? NULL : &p->from, &p->to );
+				break;
+			}
+		}
+
+		if ( check && ( msg.overflowed || msg.bit != m->bits ||
+			memcmp( msg.data, m->data, ( m->bits + 7 ) >> 3 ) ) ) {
+			failed++;
+		}
+	}
+
+	return failed;
+}
+
+/*
+=================
+MSGB_Free
+=================
+*/
+static void MSGB_Free( void ) {
+	if ( msgb.messages ) {
+		Z_Free( msgb.messages );
+	}
+	if ( msgb.ops ) {
+		Z_Free( msgb.ops );
+	}
+	if ( msgb.entities ) {
+		Z_Free( msgb.entities );
+	}
+	if ( msgb.players ) {
+		Z_Free( msgb.players );
+	}
+	if ( msgb.baselines ) {
+		Z_Free( msgb.baselines );
+		Z_Free( msgb.snapshots );
+		Z_Free( msgb.buffer );
+	}
+	Com_Memset( &msgb, 0, sizeof( msgb ) );
+}
+
+/*
+=================
+MSG_Bench_f
+=================
+*/
+void MSG_Bench_f( void ) {
+	char	name[MAX_QPATH];
+	void	*demo;
+	int		length, repeat, skipped;
+	int		decodeFailed, encodeFailed;
+	int		msec[2];
+	int		i, start, bytes;
+
+	if ( Cmd_Argc() < 2 ) {
+		Com_Printf( "usage: msgbench <demo> [repeat]\n" );
+		return;
+	}
+	repeat = Cmd_Argc() > 2 ? atoi( Cmd_Argv( 2 ) ) : 100;
+
+	Q_strncpyz( name, Cmd_Argv( 1 ), sizeof( name ) );
+	length = FS_ReadFile( name, &demo );
+	if ( !demo ) {
+		Com_sprintf( name, sizeof( name ), "demos/%s.%s%d", Cmd_Argv( 1 ), DEMOEXT, PROTOCOL_VERSION );
+		length = FS_ReadFile( name, &demo );
+	}
+	if ( !demo ) {
+		Com_Printf( "msgbench: couldn't load %s\n", Cmd_Argv( 1 ) );
+		return;
+	}
+
+	MSGB_Free();
+	msgb.baselines = Z_Malloc( MAX_GENTITIES * sizeof( *msgb.baselines ) );
+	msgb.snapshots = Z_Malloc( ( PACKET_BACKUP + 1 ) * sizeof( *msgb.snapshots ) );
+	msgb.buffer = Z_Malloc( MAX_MSGLEN );
+
+	skipped = MSGB_Load( demo, length );
+
+	bytes = 0;
+	for ( i = 0 ; i < msgb.numMessages ; i++ ) {
+		bytes += msgb.messages[i].size;
+	}
+
+	decodeFailed = MSGB_Decode( qtrue );
+	encodeFailed = MSGB_Encode( qtrue );
+
+	Com_Printf( "msgbench: %s, %i messages (%i left out), %i bytes\n", name, msgb.numMessages, skipped, bytes );
+	Com_Printf( "msgbench: %i reads, %i entity deltas, %i playerstate deltas\n",
+		msgb.numOps - msgb.numEntities - msgb.numPlayers, msgb.numEntities, msgb.numPlayers );
+	Com_Printf( "msgbench: %i messages read differently, %i written differently\n", decodeFailed, encodeFailed );
+
+	if ( repeat > 0 && bytes > 0 ) {
+		msec[0] = msec[1] = 0;
+		for ( i = 0 ; i < repeat ; i++ ) {
+			start = Sys_Milliseconds();
+			MSGB_Decode( qfalse );
+			msec[0] += Sys_Milliseconds() - start;
+
+			start = Sys_Milliseconds();
+			MSGB_Encode( qfalse );
+			msec[1] += Sys_Milliseconds() - start;
+		}
+		Com_Printf( "msgbench: %i passes, decode %i msec (%.1f MB/s), encode %i msec (%.1f MB/s)\n", repeat,
+			msec[0], msec[0] ? (float)bytes * repeat / ( msec[0] * 1000.0f ) : 0.0f,
+			msec[1], msec[1] ? (float)bytes * repeat / ( msec[1] * 1000.0f ) : 0.0f );
+	}
+
+	MSGB_Free();
+	FS_FreeFile( demo );
+}
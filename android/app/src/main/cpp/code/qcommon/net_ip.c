@@ -20,6 +20,13 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 ===========================================================================
 */
 
+#if defined(__linux__) && !defined(__ANDROID__)
+#	define NET_BATCH_IO		// recvmmsg and sendmmsg
+#	ifndef _GNU_SOURCE
+#		define _GNU_SOURCE
+#	endif
+#endif
+
 #include "../qcommon/q_shared.h"
 #include "../qcommon/qcommon.h"
 
@@ -111,6 +118,10 @@ static cvar_t	*net_mcast6iface;
 
 static cvar_t	*net_dropsim;
 
+#ifdef NET_BATCH_IO
+static cvar_t	*net_batch;
+#endif
+
 static struct sockaddr	socksRelayAddr;
 
 static SOCKET	ip_socket = INVALID_SOCKET;
@@ -145,6 +156,56 @@ typedef struct
 static nip_localaddr_t localIP[MAX_IPS];
 static int numIP;
 
+typedef struct
+{
+	int recvCalls, recvPackets;
+	int sendCalls, sendPackets;
+} netStats_t;
+
+static netStats_t netStats;
+
+#ifdef NET_BATCH_IO
+/*
+With net_batch, every recvmmsg drains up to NET_BATCH packets from a socket
+into that socket's ring, which NET_GetPacket then hands out one by one.
+Each socket has its own ring, so reading one socket never throws away what
+is still waiting from another.  Packets sent
+between NET_BeginSendBatch and NET_FlushSendBatch go out together with one
+sendmmsg per socket.
+*/
+
+#define	NET_BATCH			64
+#define	NET_BATCH_SOCKETS	3		// ip_socket, ip6_socket, multicast6_socket
+#define	NET_BATCH_PACKETLEN	1400	// same as the netchan's MAX_PACKETLEN, bigger ones are sent right away
+
+typedef struct
+{
+	SOCKET socket;
+	int count;
+	int next;
+
+	struct mmsghdr msgs[NET_BATCH];
+	struct iovec iov[NET_BATCH];
+	struct sockaddr_storage from[NET_BATCH];
+	byte data[NET_BATCH][MAX_MSGLEN + 1];
+} netRecvBatch_t;
+
+typedef struct
+{
+	qboolean active;
+	int count;
+
+	SOCKET sockets[NET_BATCH];
+	struct mmsghdr msgs[NET_BATCH];
+	struct iovec iov[NET_BATCH];
+	struct sockaddr_storage to[NET_BATCH];
+	byte data[NET_BATCH][NET_BATCH_PACKETLEN];
+} netSendBatch_t;
+
+static netRecvBatch_t recvBatches[NET_BATCH_SOCKETS];
+static netSendBatch_t sendBatch;
+#endif
+
 
 //=============================================================================
 
@@ -513,6 +574,140 @@ qboolean	NET_IsLocalAddress( netadr_t adr ) {
 
 //=============================================================================
 
+#ifdef NET_BATCH_IO
+/*
+==================
+NET_RecvBatchFor
+
+Returns the ring of sock, or an empty one to give it
+==================
+*/
+static netRecvBatch_t *NET_RecvBatchFor( SOCKET sock )
+{
+	netRecvBatch_t *b, *empty = NULL;
+	int i;
+
+	for( i = 0; i < NET_BATCH_SOCKETS; i++ )
+	{
+		b = &recvBatches[i];
+		if( b->socket == sock && b->count )
+			return b;
+		if( !empty && b->next >= b->count )
+			empty = b;
+	}
+
+	return empty;
+}
+
+/*
+==================
+NET_RecvBatch
+
+Hands out the next packet from sock, reading a new batch when there are none left
+==================
+*/
+static int NET_RecvBatch( SOCKET sock, void *data, int maxsize, struct sockaddr_storage *from, socklen_t *fromlen )
+{
+	netRecvBatch_t *b;
+	int i, len;
+
+	b = NET_RecvBatchFor( sock );
+	if( !b )
+	{
+		len = recvfrom( sock, data, maxsize, 0, (struct sockaddr *) from, fromlen );
+		netStats.recvCalls++;
+		return len;
+	}
+
+	if( b->socket != sock || b->next >= b->count )
+	{
+		for( i = 0; i < NET_BATCH; i++ )
+		{
+			b->iov[i].iov_base = b->data[i];
+			b->iov[i].iov_len = sizeof( b->data[i] );
+			memset( &b->msgs[i].msg_hdr, 0, sizeof( b->msgs[i].msg_hdr ) );
+			b->msgs[i].msg_hdr.msg_name = &b->from[i];
+			b->msgs[i].msg_hdr.msg_namelen = sizeof( b->from[i] );
+			b->msgs[i].msg_hdr.msg_iov = &b->iov[i];
+			b->msgs[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		b->socket = sock;
+		b->next = 0;
+		b->count = recvmmsg( sock, b->msgs, NET_BATCH, MSG_DONTWAIT, NULL );
+		netStats.recvCalls++;
+
+		if( b->count <= 0 )
+		{
+			b->count = 0;
+			return SOCKET_ERROR;
+		}
+	}
+
+	i = b->next++;
+	len = b->msgs[i].msg_len;
+	if( len > maxsize )
+		len = maxsize;
+
+	memcpy( data, b->data[i], len );
+	*fromlen = b->msgs[i].msg_hdr.msg_namelen;
+	memcpy( from, &b->from[i], *fromlen );
+
+	return len;
+}
+
+/*
+==================
+NET_RecvBatchPending
+
+Returns whether sock still has packets in its batch,
+any socket for INVALID_SOCKET
+==================
+*/
+static qboolean NET_RecvBatchPending( SOCKET sock )
+{
+	netRecvBatch_t *b;
+	int i;
+
+	for( i = 0; i < NET_BATCH_SOCKETS; i++ )
+	{
+		b = &recvBatches[i];
+		if( b->next < b->count && ( sock == INVALID_SOCKET || b->socket == sock ) )
+			return qtrue;
+	}
+
+	return qfalse;
+}
+#endif
+
+/*
+==================
+NET_RecvFrom
+==================
+*/
+static int NET_RecvFrom( SOCKET sock, msg_t *net_message, struct sockaddr_storage *from, socklen_t *fromlen )
+{
+	int ret;
+
+#ifdef NET_BATCH_IO
+	if( net_batch->integer || NET_RecvBatchPending( sock ) )
+	{
+		ret = NET_RecvBatch( sock, net_message->data, net_message->maxsize, from, fromlen );
+		if( ret != SOCKET_ERROR )
+			netStats.recvPackets++;
+
+		return ret;
+	}
+#endif
+
+	ret = recvfrom( sock, (void *)net_message->data, net_message->maxsize, 0, (struct sockaddr *) from, fromlen );
+	netStats.recvCalls++;
+	if( ret != SOCKET_ERROR )
+		netStats.recvPackets++;
+
+	return ret;
+}
+
 /*
 ==================
 NET_GetPacket
@@ -530,7 +725,7 @@ qboolean NET_GetPacket(netadr_t *net_from, msg_t *net_message, fd_set *fdr)
 	if(ip_socket != INVALID_SOCKET && FD_ISSET(ip_socket, fdr))
 	{
 		fromlen = sizeof(from);
-		ret = recvfrom( ip_socket, (void *)net_message->data, net_message->maxsize, 0, (struct sockaddr *) &from, &fromlen );
+		ret = NET_RecvFrom( ip_socket, net_message, &from, &fromlen );
 		
 		if (ret == SOCKET_ERROR)
 		{
@@ -574,7 +769,7 @@ qboolean NET_GetPacket(netadr_t *net_from, msg_t *net_message, fd_set *fdr)
 	if(ip6_socket != INVALID_SOCKET && FD_ISSET(ip6_socket, fdr))
 	{
 		fromlen = sizeof(from);
-		ret = recvfrom(ip6_socket, (void *)net_message->data, net_message->maxsize, 0, (struct sockaddr *) &from, &fromlen);
+		ret = NET_RecvFrom( ip6_socket, net_message, &from, &fromlen );
 		
 		if (ret == SOCKET_ERROR)
 		{
@@ -602,7 +797,7 @@ qboolean NET_GetPacket(netadr_t *net_from, msg_t *net_message, fd_set *fdr)
 	if(multicast6_socket != INVALID_SOCKET && multicast6_socket != ip6_socket && FD_ISSET(multicast6_socket, fdr))
 	{
 		fromlen = sizeof(from);
-		ret = recvfrom(multicast6_socket, (void *)net_message->data, net_message->maxsize, 0, (struct sockaddr *) &from, &fromlen);
+		ret = NET_RecvFrom( multicast6_socket, net_message, &from, &fromlen );
 		
 		if (ret == SOCKET_ERROR)
 		{
@@ -631,10 +826,168 @@ qboolean NET_GetPacket(netadr_t *net_from, msg_t *net_message, fd_set *fdr)
 	return qfalse;
 }
 
+#ifdef USE_TESTS
+/*
+==================
+NET_GetTestPacket
+
+NET_GetPacket as if select() had found every socket readable, for nettest
+==================
+*/
+qboolean NET_GetTestPacket( netadr_t *net_from, msg_t *net_message )
+{
+	fd_set fdr;
+
+	FD_ZERO( &fdr );
+	if( ip_socket != INVALID_SOCKET )
+		FD_SET( ip_socket, &fdr );
+	if( ip6_socket != INVALID_SOCKET )
+		FD_SET( ip6_socket, &fdr );
+	if( multicast6_socket != INVALID_SOCKET )
+		FD_SET( multicast6_socket, &fdr );
+
+	return NET_GetPacket( net_from, net_message, &fdr );
+}
+#endif
+
 //=============================================================================
 
 static char socksBuf[4096];
 
+/*
+==================
+NET_SendError
+==================
+*/
+static void NET_SendError( netadr_t to ) {
+	int err = socketError;
+
+	// wouldblock is silent
+	if( err == EAGAIN ) {
+		return;
+	}
+
+	// some PPP links do not allow broadcasts and return an error
+	if( ( err == EADDRNOTAVAIL ) && ( ( to.type == NA_BROADCAST ) ) ) {
+		return;
+	}
+
+	Com_Printf( "Sys_SendPacket: %s\n", NET_ErrorString() );
+}
+
+#ifdef NET_BATCH_IO
+/*
+==================
+NET_BeginSendBatch
+
+Holds back the packets sent from here on until NET_FlushSendBatch
+==================
+*/
+void NET_BeginSendBatch( void ) {
+	if( net_batch && net_batch->integer ) {
+		sendBatch.active = qtrue;
+	}
+}
+
+/*
+==================
+NET_FlushSendBatch
+==================
+*/
+void NET_FlushSendBatch( void ) {
+	netSendBatch_t *b = &sendBatch;
+	netadr_t to;
+	int i, run, ret;
+
+	// one sendmmsg for each run of packets to the same socket
+	for( i = 0; i < b->count; i += run ) {
+		for( run = 1; i + run < b->count && b->sockets[i + run] == b->sockets[i]; run++ ) {
+		}
+
+		ret = sendmmsg( b->sockets[i], &b->msgs[i], run, 0 );
+		netStats.sendCalls++;
+
+		if( ret == SOCKET_ERROR ) {
+			// the first packet failed, report it and go on with the rest
+			memset( &to, 0, sizeof( to ) );
+			SockadrToNetadr( (struct sockaddr *) &b->to[i], &to );
+			NET_SendError( to );
+			run = 1;
+		} else if( ret > 0 ) {
+			netStats.sendPackets += ret;
+			run = ret;
+		}
+	}
+
+	b->count = 0;
+	b->active = qfalse;
+}
+
+/*
+==================
+NET_QueueBatchPacket
+
+Returns qfalse if the packet has to be sent right away
+==================
+*/
+static qboolean NET_QueueBatchPacket( SOCKET sock, int length, const void *data, struct sockaddr_storage *addr, socklen_t addrlen ) {
+	netSendBatch_t *b = &sendBatch;
+	int i;
+
+	if( !b->active || length > NET_BATCH_PACKETLEN ) {
+		return qfalse;
+	}
+
+	if( b->count == NET_BATCH ) {
+		NET_FlushSendBatch();
+		b->active = qtrue;
+	}
+
+	i = b->count++;
+	memcpy( b->data[i], data, length );
+	memcpy( &b->to[i], addr, addrlen );
+	b->sockets[i] = sock;
+	b->iov[i].iov_base = b->data[i];
+	b->iov[i].iov_len = length;
+	memset( &b->msgs[i].msg_hdr, 0, sizeof( b->msgs[i].msg_hdr ) );
+	b->msgs[i].msg_hdr.msg_name = &b->to[i];
+	b->msgs[i].msg_hdr.msg_namelen = addrlen;
+	b->msgs[i].msg_hdr.msg_iov = &b->iov[i];
+	b->msgs[i].msg_hdr.msg_iovlen = 1;
+
+	return qtrue;
+}
+#else
+void NET_BeginSendBatch( void ) {
+}
+
+void NET_FlushSendBatch( void ) {
+}
+#endif
+
+/*
+==================
+NET_SendTo
+==================
+*/
+static int NET_SendTo( SOCKET sock, int length, const void *data, struct sockaddr_storage *addr, socklen_t addrlen ) {
+	int ret;
+
+#ifdef NET_BATCH_IO
+	if( NET_QueueBatchPacket( sock, length, data, addr, addrlen ) ) {
+		return length;
+	}
+#endif
+
+	ret = sendto( sock, data, length, 0, (struct sockaddr *) addr, addrlen );
+	netStats.sendCalls++;
+	if( ret != SOCKET_ERROR ) {
+		netStats.sendPackets++;
+	}
+
+	return ret;
+}
+
 /*
 ==================
 Sys_SendPacket
@@ -674,24 +1027,12 @@ void Sys_SendPacket( int length, const void *data, netadr_t to ) {
 	}
 	else {
 		if(addr.ss_family == AF_INET)
-			ret = sendto( ip_socket, data, length, 0, (struct sockaddr *) &addr, sizeof(struct sockaddr_in) );
+			ret = NET_SendTo( ip_socket, length, data, &addr, sizeof(struct sockaddr_in) );
 		else if(addr.ss_family == AF_INET6)
-			ret = sendto( ip6_socket, data, length, 0, (struct sockaddr *) &addr, sizeof(struct sockaddr_in6) );
+			ret = NET_SendTo( ip6_socket, length, data, &addr, sizeof(struct sockaddr_in6) );
 	}
 	if( ret == SOCKET_ERROR ) {
-		int err = socketError;
-
-		// wouldblock is silent
-		if( err == EAGAIN ) {
-			return;
-		}
-
-		// some PPP links do not allow broadcasts and return an error
-		if( ( err == EADDRNOTAVAIL ) && ( ( to.type == NA_BROADCAST ) ) ) {
-			return;
-		}
-
-		Com_Printf( "Sys_SendPacket: %s\n", NET_ErrorString() );
+		NET_SendError( to );
 	}
 }
 
@@ -1480,6 +1821,10 @@ static qboolean NET_GetCvars( void ) {
 
 	net_dropsim = Cvar_Get("net_dropsim", "", CVAR_TEMP);
 
+#ifdef NET_BATCH_IO
+	net_batch = Cvar_Get( "net_batch", "1", CVAR_ARCHIVE );
+#endif
+
 	return modified ? qtrue : qfalse;
 }
 
@@ -1493,6 +1838,9 @@ void NET_Config( qboolean enableNetworking ) {
 	qboolean	modified;
 	qboolean	stop;
 	qboolean	start;
+#ifdef NET_BATCH_IO
+	int			i;
+#endif
 
 	// get any latched changes to cvars
 	modified = NET_GetCvars();
@@ -1551,7 +1899,11 @@ void NET_Config( qboolean enableNetworking ) {
 			closesocket( socks_socket );
 			socks_socket = INVALID_SOCKET;
 		}
-		
+
+#ifdef NET_BATCH_IO
+		for( i = 0; i < NET_BATCH_SOCKETS; i++ )
+			recvBatches[i].count = recvBatches[i].next = 0;
+#endif
 	}
 
 	if( start )
@@ -1587,6 +1939,7 @@ void NET_Init( void ) {
 	NET_Config( qtrue );
 	
 	Cmd_AddCommand ("net_restart", NET_Restart_f);
+	Cmd_AddCommand ("net_stats", NET_Stats_f);
 }
 
 
@@ -1658,10 +2011,20 @@ void NET_Sleep(int msec)
 	fd_set fdr;
 	int retval;
 	SOCKET highestfd = INVALID_SOCKET;
+#ifdef NET_BATCH_IO
+	netRecvBatch_t *b;
+	int i;
+#endif
 
 	if(msec < 0)
 		msec = 0;
 
+#ifdef NET_BATCH_IO
+	// packets that were already read in a batch don't wake select up
+	if(NET_RecvBatchPending(INVALID_SOCKET))
+		msec = 0;
+#endif
+
 	FD_ZERO(&fdr);
 
 	if(ip_socket != INVALID_SOCKET)
@@ -1693,11 +2056,47 @@ void NET_Sleep(int msec)
 	retval = select(highestfd + 1, &fdr, NULL, NULL, &timeout);
 
 	if(retval == SOCKET_ERROR)
+	{
 		Com_Printf("Warning: select() syscall failed: %s\n", NET_ErrorString());
-	else if(retval > 0)
+		return;
+	}
+
+#ifdef NET_BATCH_IO
+	for(i = 0; i < NET_BATCH_SOCKETS; i++)
+	{
+		b = &recvBatches[i];
+		if(b->next < b->count && !FD_ISSET(b->socket, &fdr))
+		{
+			FD_SET(b->socket, &fdr);
+			retval++;
+		}
+	}
+#endif
+
+	if(retval > 0)
 		NET_Event(&fdr);
 }
 
+/*
+====================
+NET_Stats_f
+====================
+*/
+void NET_Stats_f( void )
+{
+	if( !strcmp( Cmd_Argv( 1 ), "reset" ) )
+	{
+		Com_Memset( &netStats, 0, sizeof( netStats ) );
+		return;
+	}
+
+#ifdef NET_BATCH_IO
+	Com_Printf( "batched I/O: %s\n", net_batch->integer ? "on" : "off" );
+#endif
+	Com_Printf( "received %i packets with %i calls\n", netStats.recvPackets, netStats.recvCalls );
+	Com_Printf( "sent %i packets with %i calls\n", netStats.sendPackets, netStats.sendCalls );
+}
+
 /*
 ====================
 NET_Restart_f
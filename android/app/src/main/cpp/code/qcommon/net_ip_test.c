@@ -0,0 +1,218 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// net_ip_test.c -- checks that packets arriving on the IPv4 and IPv6
+// sockets at the same time all come out of NET_GetPacket
+
+/*
+
+nettest [rounds] [seed]
+
+Every round sends random bursts of numbered packets from the IPv4 socket
+to itself on 127.0.0.1 and from the IPv6 socket to itself on ::1, and
+between the bursts reads a random number of packets back, the way
+NET_Event does after select() has found both sockets readable.  Reading
+stops part way through a burst, so with net_batch 1 there are usually
+packets of one family waiting in a batch when the other family's socket
+is read.
+
+At the end of every round each family has to have come back complete and
+in order: nothing lost, nothing twice.
+
+Needs net_enabled with both IPv4 and IPv6, and nothing else sending to
+the ports while it runs.
+
+*/
+
+#include "q_shared.h"
+#include "qcommon.h"
+
+#define NETT_MAGIC			0x7e57
+#define NETT_MAX_BURST		24
+#define NETT_MAX_UNREAD		96		// well inside the default socket buffers
+
+typedef struct {
+	netadr_t	adr;
+	const char	*name;
+	int			sent;
+	int			received;
+	int			errors;
+} nettFamily_t;
+
+static nettFamily_t	nett[2];		// IPv4, IPv6
+static int			nett_seed;
+
+/*
+=================
+NETT_Rand
+=================
+*/
+static int NETT_Rand( int range ) {
+	return ( (unsigned)Q_rand( &nett_seed ) >> 8 ) % range;
+}
+
+/*
+=================
+NETT_Send
+=================
+*/
+static void NETT_Send( nettFamily_t *f, int round ) {
+	int		data[3];
+
+	data[0] = LittleLong( NETT_MAGIC );
+	data[1] = LittleLong( round );
+	data[2] = LittleLong( f->sent++ );
+	Sys_SendPacket( sizeof( data ), data, f->adr );
+}
+
+/*
+=================
+NETT_Read
+
+Reads up to count packets, returns the number read
+=================
+*/
+static int NETT_Read( int count, int round ) {
+	byte		buf[MAX_MSGLEN + 1];
+	msg_t		msg;
+	netadr_t	from;
+	nettFamily_t	*f;
+	int			i, seq;
+
+	for ( i = 0 ; i < count ; i++ ) {
+		MSG_Init( &msg, buf, sizeof( buf ) );
+		if ( !NET_GetTestPacket( &from, &msg ) ) {
+			break;
+		}
+
+		f = from.type == NA_IP6 ? &nett[1] : &nett[0];
+		if ( msg.cursize != 12 || LittleLong( ((int *)buf)[0] ) != NETT_MAGIC ) {
+			Com_Printf( S_COLOR_RED "nettest: stray %i byte packet from %s\n", msg.cursize, NET_AdrToStringwPort( from ) );
+			f->errors++;
+			continue;
+		}
+
+		seq = LittleLong( ((int *)buf)[2] );
+		if ( LittleLong( ((int *)buf)[1] ) != round || seq != f->received ) {
+			if ( !f->errors ) {
+				Com_Printf( S_COLOR_RED "nettest: round %i, %s packet %i arrived when %i was next\n",
+					round, f->name, seq, f->received );
+			}
+			f->errors++;
+		}
+		f->received = seq + 1;
+	}
+
+	return i;
+}
+
+/*
+=================
+NETT_Family
+=================
+*/
+static qboolean NETT_Family( nettFamily_t *f, const char *name, const char *host, const char *port, netadrtype_t type ) {
+	Com_Memset( f, 0, sizeof( *f ) );
+	f->name = name;
+
+	if ( !NET_StringToAdr( host, &f->adr, type ) ) {
+		return qfalse;
+	}
+	f->adr.port = BigShort( Cvar_VariableIntegerValue( port ) );
+
+	return qtrue;
+}
+
+/*
+=================
+NET_Test_f
+=================
+*/
+void NET_Test_f( void ) {
+	nettFamily_t	*f;
+	int		rounds, seed, round, bursts, unread, n, i;
+	int		failed;
+
+	rounds = Cmd_Argc() > 1 ? atoi( Cmd_Argv( 1 ) ) : 100;
+	seed = Cmd_Argc() > 2 ? atoi( Cmd_Argv( 2 ) ) : Com_Milliseconds();
+	nett_seed = seed;
+
+	if ( !NETT_Family( &nett[0], "IPv4", "127.0.0.1", "net_port", NA_IP )
+		|| !NETT_Family( &nett[1], "IPv6", "::1", "net_port6", NA_IP6 ) ) {
+		Com_Printf( "nettest: couldn't resolve the loopback addresses\n" );
+		return;
+	}
+
+	// drop anything already queued, then check that both families get through
+	while ( NETT_Read( 1, -1 ) ) {
+	}
+	nett[0].errors = nett[1].errors = 0;
+	NETT_Send( &nett[0], 0 );
+	NETT_Send( &nett[1], 0 );
+	NETT_Read( 2, 0 );
+	if ( nett[0].received != 1 || nett[1].received != 1 ) {
+		Com_Printf( "nettest: needs net_enabled with both IPv4 and IPv6, got back %i IPv4 and %i IPv6 packets\n",
+			nett[0].received, nett[1].received );
+		return;
+	}
+
+	failed = 0;
+	for ( round = 1 ; round <= rounds ; round++ ) {
+		for ( i = 0 ; i < 2 ; i++ ) {
+			nett[i].sent = nett[i].received = nett[i].errors = 0;
+		}
+
+		unread = 0;
+		for ( bursts = 4 + NETT_Rand( 12 ) ; bursts > 0 ; bursts-- ) {
+			f = &nett[NETT_Rand( 2 )];
+			for ( n = 1 + NETT_Rand( NETT_MAX_BURST ) ; n > 0 ; n-- ) {
+				NETT_Send( f, round );
+				unread++;
+			}
+
+			// stop part way, the rest may be waiting in a batch
+			if ( unread > NETT_MAX_UNREAD ) {
+				unread -= NETT_Read( unread - NETT_MAX_UNREAD / 2, round );
+			} else {
+				unread -= NETT_Read( NETT_Rand( unread + 1 ), round );
+			}
+		}
+		NETT_Read( unread, round );
+
+		// anything left over came twice
+		NETT_Read( 1, round );
+
+		for ( i = 0 ; i < 2 ; i++ ) {
+			f = &nett[i];
+			if ( f->received != f->sent && !f->errors ) {
+				Com_Printf( S_COLOR_RED "nettest: round %i, %i of %i %s packets came back\n",
+					round, f->received, f->sent, f->name );
+				f->errors++;
+			}
+		}
+		if ( nett[0].errors || nett[1].errors ) {
+			failed++;
+		}
+	}
+
+	Com_Printf( "nettest: %i rounds from seed %i with net_batch %i, %i failed\n",
+		rounds, seed, Cvar_VariableIntegerValue( "net_batch" ), failed );
+}
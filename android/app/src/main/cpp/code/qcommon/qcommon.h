@@ -100,14 +100,21 @@ void MSG_ReadDeltaUsercmdKey( msg_t *msg, int key, usercmd_t *from, usercmd_t *t
 
 void MSG_WriteDeltaEntity( msg_t *msg, struct entityState_s *from, struct entityState_s *to
 						   , qboolean force );
+void MSG_WriteDeltaEntityFields( msg_t *msg, struct entityState_s *from, struct entityState_s *to
+						   , qboolean force );
 void MSG_ReadDeltaEntity( msg_t *msg, entityState_t *from, entityState_t *to, 
 						 int number );
 
 void MSG_WriteDeltaPlayerstate( msg_t *msg, struct playerState_s *from, struct playerState_s *to );
+void MSG_WriteDeltaPlayerstateFields( msg_t *msg, struct playerState_s *from, struct playerState_s *to );
 void MSG_ReadDeltaPlayerstate( msg_t *msg, struct playerState_s *from, struct playerState_s *to );
 
 
 void MSG_ReportChangeVectors_f( void );
+#ifdef USE_TESTS
+void MSG_Test_f( void );
+void MSG_Bench_f( void );
+#endif
 
 //============================================================================
 
@@ -169,6 +176,7 @@ typedef struct {
 void		NET_Init( void );
 void		NET_Shutdown( void );
 void		NET_Restart_f( void );
+void		NET_Stats_f( void );
 void		NET_Config( qboolean enableNetworking );
 void		NET_FlushPacketQueue(void);
 void		NET_SendPacket (netsrc_t sock, int length, const void *data, netadr_t to);
@@ -186,6 +194,15 @@ qboolean	NET_GetLoopPacket (netsrc_t sock, netadr_t *net_from, msg_t *net_messag
 void		NET_JoinMulticast6(void);
 void		NET_LeaveMulticast6(void);
 void		NET_Sleep(int msec);
+void		NET_BeginSendBatch( void );
+void		NET_FlushSendBatch( void );
+
+#ifdef USE_TESTS
+qboolean	NET_GetTestPacket( netadr_t *net_from, msg_t *net_message );
+
+// net_ip_test.c
+void		NET_Test_f( void );
+#endif
 
 
 #define	MAX_MSGLEN				16384		// max length of a message, which may
@@ -372,6 +389,7 @@ void	VM_Debug( int level );
 
 void	*VM_ArgPtr( intptr_t intValue );
 void	*VM_ExplicitArgPtr( vm_t *vm, intptr_t intValue );
+void	VM_CheckBounds( vm_t *vm, intptr_t address, unsigned int length );
 
 #define	VMA(x) VM_ArgPtr(args[x])
 static ID_INLINE float _vmf(intptr_t x)
@@ -631,6 +649,14 @@ int FS_FindVM(void **startSearch, char *found, int foundlen, const char *name, i
 
 char   *FS_BuildOSPath( const char *base, const char *game, const char *qpath );
 qboolean FS_CompareZipChecksum(const char *zipfile);
+int		FS_LoadPakDirectory( const char *osdir, const char *indexPath, int *numFiles );
+int		FS_ListPrefetched( const char **names, int maxNames );
+
+#ifdef USE_TESTS
+// files_test.c
+void	FS_PakBench_f( void );
+void	FS_PrefetchBench_f( void );
+#endif
 
 int		FS_LoadStack( void );
 
@@ -680,6 +706,24 @@ void	FS_ForceFlush( fileHandle_t f );
 void	FS_FreeFile( void *buffer );
 // frees the memory returned by FS_ReadFile
 
+void	FS_PrefetchMap( const char *bspName, const char **names, int numNames );
+// inflates the pk3 files a map will load on the job threads ahead of time,
+// names are the models and sounds from the configstrings
+
+void	FS_ClearPrefetch( void );
+// frees the prefetched files that weren't asked for
+
+void	*FS_ReadAssetCache( const char *qpath, const char *kind, void *info, int infoSize, int *length,
+			void *(*alloc)( int size ), void (*release)( void *data ) );
+// returns what was decoded from qpath and kept with FS_WriteAssetCache, in
+// memory from alloc, or NULL if fs_assetCache is off or nothing is cached
+// for the file as it is now
+
+void	FS_WriteAssetCache( const char *qpath, const char *kind, const void *info, int infoSize,
+			const void *data, int length );
+// keeps decoded data for a file in the asset cache, kind names the format
+// of info and data, so it should change when they do
+
 void	FS_WriteFile( const char *qpath, const void *buffer, int size );
 // writes a complete file, creating any subdirectories needed
 
@@ -905,7 +949,8 @@ typedef enum {
 	TAG_BOTLIB,
 	TAG_RENDERER,
 	TAG_SMALL,
-	TAG_STATIC
+	TAG_STATIC,
+	TAG_SLAB			// a zone block cut into slab objects
 } memtag_t;
 
 /*
@@ -947,6 +992,15 @@ void Z_Free( void *ptr );
 void Z_FreeTags( int tag );
 int Z_AvailableMemory( void );
 void Z_LogHeap( void );
+qboolean Z_UseSlabs( qboolean use );
+
+#ifdef USE_TESTS
+// zone_test.c
+extern	qboolean	z_recordAllocs;
+void Z_RecordAlloc( void *ptr, int size, int tag );
+void Z_RecordFree( void *ptr );
+void Z_Bench_f( void );
+#endif
 
 void Hunk_Clear( void );
 void Hunk_ClearToMark( void );
@@ -965,6 +1019,15 @@ void Com_Init( char *commandLine );
 void Com_Frame( void );
 void Com_Shutdown( void );
 
+// jobs.c, a worker thread pool, see the notes at the top of the file
+#define	MAX_JOB_THREADS		16
+
+typedef void (*jobFunction_t)( void *data, int job );
+
+void Com_InitJobs( void );
+void Com_ShutdownJobs( void );
+void Com_RunJobs( jobFunction_t function, void *data, int numJobs, int numThreads );
+
 
 /*
 ==============================================================
@@ -1099,6 +1162,7 @@ void	Sys_Print( const char *msg );
 // Sys_Milliseconds should only be used for profiling purposes,
 // any game related timing information should come from event timestamps
 int		Sys_Milliseconds (void);
+int64_t	Sys_Microseconds (void);
 
 qboolean Sys_RandomBytes( byte *string, int len );
 
@@ -1120,6 +1184,10 @@ void		Sys_ShowIP(void);
 FILE	*Sys_FOpen( const char *ospath, const char *mode );
 qboolean Sys_Mkdir( const char *path );
 FILE	*Sys_Mkfifo( const char *ospath );
+qboolean Sys_StatFile( const char *ospath, int64_t *size, int64_t *mtime );
+void	*Sys_MapFile( const char *ospath, int *length );
+void	*Sys_MapFileRange( const char *ospath, int64_t offset, int length, void **base, int *baseLength );
+void	Sys_UnmapFile( void *base, int length );
 char	*Sys_Cwd( void );
 void	Sys_SetDefaultInstallPath(const char *path);
 char	*Sys_DefaultInstallPath(void);
@@ -1142,6 +1210,19 @@ void	Sys_Sleep(int msec);
 
 qboolean Sys_LowPhysicalMemory( void );
 
+// threads and synchronization for the job system, handles are opaque
+void	*Sys_CreateThread( void (*function)( void *arg ), void *arg );
+void	Sys_JoinThread( void *thread );
+void	*Sys_CreateMutex( void );
+void	Sys_DestroyMutex( void *mutex );
+void	Sys_LockMutex( void *mutex );
+qboolean Sys_TryLockMutex( void *mutex );
+void	Sys_UnlockMutex( void *mutex );
+void	*Sys_CreateSemaphore( void );
+void	Sys_DestroySemaphore( void *sem );
+void	Sys_WaitSemaphore( void *sem );
+void	Sys_PostSemaphore( void *sem );
+
 void Sys_SetEnv(const char *name, const char *value);
 
 typedef enum
@@ -1202,6 +1283,19 @@ typedef struct {
 	huff_t		decompressor;
 } huffman_t;
 
+/* Lookup tables for a tree that doesn't change any more, like the one the
+ * network messages use.  decode is indexed with the next HUFF_TABLE_BITS bits,
+ * first bit lowest, and holds the symbol and code length, or 0 when the code
+ * is longer and the tree has to be walked. */
+#define HUFF_TABLE_BITS		11
+#define HUFF_SYMBOL_BITS	9
+
+typedef struct {
+	unsigned int	code[HMAX+1];		/* first bit lowest */
+	byte			length[HMAX+1];		/* 0 if the symbol has to go through the tree */
+	unsigned short	decode[1 << HUFF_TABLE_BITS];
+} huffTable_t;
+
 void	Huff_Compress(msg_t *buf, int offset);
 void	Huff_Decompress(msg_t *buf, int offset);
 void	Huff_Init(huffman_t *huff);
@@ -1212,6 +1306,7 @@ void	Huff_offsetReceive (node_t *node, int *ch, byte *fin, int *offset, int maxo
 void	Huff_offsetTransmit (huff_t *huff, int ch, byte *fout, int *offset, int maxoffset);
 void	Huff_putBit( int bit, byte *fout, int *offset);
 int		Huff_getBit( byte *fout, int *offset);
+void	Huff_BuildTable( node_t *tree, huffTable_t *table );
 
 // don't use if you don't know what you're doing.
 int		Huff_getBloc(void);
@@ -1606,3 +1606,59 @@ extern int ZEXPORT unzSetOffset (file, pos)
     s->current_file_ok = (err == UNZ_OK);
     return err;
 }
+
+/* Position of the data of the current file in the zipfile, when it was
+   just opened and is stored or deflated without encryption, so that it can
+   be read and inflated by someone else */
+extern int ZEXPORT unzGetCurrentFileDataPos (file, pos)
+        unzFile file;
+        uLong *pos;
+{
+    unz_s* s;
+    file_in_zip_read_info_s* pfile_in_zip_read_info;
+
+    if (file==NULL)
+        return UNZ_PARAMERROR;
+    s=(unz_s*)file;
+    pfile_in_zip_read_info=s->pfile_in_zip_read;
+
+    if (pfile_in_zip_read_info==NULL)
+        return UNZ_PARAMERROR;
+    if ((pfile_in_zip_read_info->compression_method!=0) &&
+        (pfile_in_zip_read_info->compression_method!=Z_DEFLATED))
+        return UNZ_PARAMERROR;
+    if (s->encrypted)
+        return UNZ_PARAMERROR;
+
+    *pos = pfile_in_zip_read_info->pos_in_zipfile +
+           pfile_in_zip_read_info->byte_before_the_zipfile;
+    return UNZ_OK;
+}
+
+/* Position of the data of the current file in the zipfile, when it was
+   just opened and is stored without compression or encryption, so that
+   it can be used without reading it through the file */
+extern int ZEXPORT unzGetCurrentFileStoredPos (file, pos)
+        unzFile file;
+        uLong *pos;
+{
+    unz_s* s;
+    file_in_zip_read_info_s* pfile_in_zip_read_info;
+
+    if (file==NULL)
+        return UNZ_PARAMERROR;
+    s=(unz_s*)file;
+    pfile_in_zip_read_info=s->pfile_in_zip_read;
+
+    if (pfile_in_zip_read_info==NULL)
+        return UNZ_PARAMERROR;
+    if ((pfile_in_zip_read_info->compression_method!=0) ||
+        (pfile_in_zip_read_info->raw))
+        return UNZ_PARAMERROR;
+    if (s->encrypted)
+        return UNZ_PARAMERROR;
+
+    *pos = pfile_in_zip_read_info->pos_in_zipfile +
+           pfile_in_zip_read_info->byte_before_the_zipfile;
+    return UNZ_OK;
+}
@@ -346,6 +346,12 @@ extern uLong ZEXPORT unzGetOffset (unzFile file);
 /* Set the current file offset */
 extern int ZEXPORT unzSetOffset (unzFile file, uLong pos);
 
+/* Get where the data of the current file starts, if it is stored */
+extern int ZEXPORT unzGetCurrentFileStoredPos (unzFile file, uLong *pos);
+
+/* Get where the data of the current file starts, stored or deflated */
+extern int ZEXPORT unzGetCurrentFileDataPos (unzFile file, uLong *pos);
+
 
 
 #ifdef __cplusplus
@@ -40,15 +40,20 @@ vm_t	*currentVM = NULL;
 vm_t	*lastVM    = NULL;
 int		vm_debugLevel;
 
+cvar_t	*vm_optimize;
+
 // used by Com_Error to get rid of running vm's before longjmp
 static int forced_unload;
 
-#define	MAX_VM		3
 vm_t	vmTable[MAX_VM];
 
 
 void VM_VmInfo_f( void );
 void VM_VmProfile_f( void );
+void VM_Prof_f( void );
+#ifdef USE_TESTS
+void VM_Test_f( void );
+#endif
 
 
 
@@ -73,9 +78,14 @@ void VM_Init( void ) {
 	Cvar_Get( "vm_cgame", "2", CVAR_ARCHIVE );	// !@# SHIP WITH SET TO 2
 	Cvar_Get( "vm_game", "2", CVAR_ARCHIVE );	// !@# SHIP WITH SET TO 2
 	Cvar_Get( "vm_ui", "2", CVAR_ARCHIVE );		// !@# SHIP WITH SET TO 2
+	vm_optimize = Cvar_Get( "vm_optimize", "1", CVAR_ARCHIVE );
 
 	Cmd_AddCommand ("vmprofile", VM_VmProfile_f );
+	Cmd_AddCommand ("vmprof", VM_Prof_f );
 	Cmd_AddCommand ("vminfo", VM_VmInfo_f );
+#ifdef USE_TESTS
+	Cmd_AddCommand ("vmtest", VM_Test_f );
+#endif
 
 	Com_Memset( vmTable, 0, sizeof( vmTable ) );
 }
@@ -281,13 +291,15 @@ void VM_LoadSymbols( vm_t *vm ) {
 		prev = &sym->next;
 		sym->next = NULL;
 
+		Q_strncpyz( sym->symName, token, chars + 1 );
+
 		// convert value from an instruction number to a code offset
 		if ( value >= 0 && value < numInstructions ) {
+			VM_NameProcedure( vm, value, sym->symName );
 			value = vm->instructionPointers[value];
 		}
 
 		sym->symValue = value;
-		Q_strncpyz( sym->symName, token, chars + 1 );
 
 		count++;
 	}
@@ -675,6 +687,8 @@ vm_t *VM_Create( const char *module, intptr_t (*systemCalls)(intptr_t *),
 		VM_PrepareInterpreter( vm, header );
 	}
 
+	VM_FindProcedures( vm, header );
+
 	// free the original file
 	FS_FreeFile( header );
 
@@ -710,6 +724,8 @@ void VM_Free( vm_t *vm ) {
 		}
 	}
 
+	VM_ProfileFree( vm );
+
 	if(vm->destroy)
 		vm->destroy(vm);
 
@@ -765,6 +781,26 @@ void *VM_ArgPtr( intptr_t intValue ) {
 	}
 }
 
+/*
+==============
+VM_CheckBounds
+
+Drops the game when length bytes at the vm address don't fit in the data
+segment, which VM_ArgPtr only masks the start of.  Native libraries pass
+real pointers and aren't checked.
+==============
+*/
+void VM_CheckBounds( vm_t *vm, intptr_t address, unsigned int length ) {
+	if ( vm->entryPoint ) {
+		return;
+	}
+	if ( (uintptr_t)address > (unsigned)vm->dataMask || length > (unsigned)vm->dataMask + 1
+		|| (unsigned)address + length > (unsigned)vm->dataMask + 1 ) {
+		Com_Error( ERR_DROP, "%s tried to pass %u bytes at 0x%x, outside its data segment",
+			vm->name, length, (unsigned)address );
+	}
+}
+
 void *VM_ExplicitArgPtr( vm_t *vm, intptr_t intValue ) {
 	if ( !intValue ) {
 		return NULL;
@@ -825,6 +861,10 @@ intptr_t QDECL VM_Call( vm_t *vm, int callnum, ... )
 	  Com_Printf( "VM_Call( %d )\n", callnum );
 	}
 
+	if ( vm == vm_profiled && !vm->callLevel ) {
+		VM_ProfileEnter( vm );
+	}
+
 	++vm->callLevel;
 	// if we have a dll loaded, call it directly
 	if ( vm->entryPoint ) {
@@ -871,6 +911,10 @@ intptr_t QDECL VM_Call( vm_t *vm, int callnum, ... )
 	}
 	--vm->callLevel;
 
+	if ( vm == vm_profiled && !vm->callLevel ) {
+		VM_ProfileLeave( vm );
+	}
+
 	if ( oldVM != NULL )
 	  currentVM = oldVM;
 	return r;
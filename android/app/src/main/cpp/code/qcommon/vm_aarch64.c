@@ -0,0 +1,1033 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// vm_aarch64.c -- load time compiler and execution environment for AArch64
+
+/*
+Docu:
+ARM Architecture Reference Manual for A-profile architecture (DDI0487)
+Procedure Call Standard for the Arm 64-bit Architecture (AAPCS64)
+
+The generated code follows the layout of vm_armv7l.c: the opStack lives in
+memory and grows upwards, VM procedure calls use the native call stack
+for return addresses and every data access is masked with vm->dataMask.
+*/
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <stddef.h>
+
+#include "vm_local.h"
+
+// workaround for systems that use the old MAP_ANON macro
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+/*
+
+  w0..w2, s0, s1	scratch
+  x16, x17		scratch (ip0/ip1)
+  x19		opStack pointer, points at the top value
+  w20		program stack
+  x21		vm->dataBase
+  w22		vm->dataMask
+  x23		vm->instructionPointers
+  x24		vm->codeBase
+  x25		opStack base, for overflow checks
+  x26		&programStack of VM_CallCompiled
+
+*/
+
+#define R0	0
+#define R1	1
+#define R2	2
+#define IP0	16
+#define FP	29
+#define LR	30
+#define SP	31
+#define ZR	31
+
+#define S0	0
+#define S1	1
+
+#define rOPSTACK	19
+#define rPSTACK		20
+#define rDATABASE	21
+#define rDATAMASK	22
+#define rINSPOINTERS	23
+#define rCODEBASE	24
+#define rOPSTACKBASE	25
+#define rPSTACKPTR	26
+
+// the opStack is checked against its bounds on procedure entry, after
+// procedure calls, on jump targets and at least every OPSTACK_CHECK
+// instructions, so it can never get further than that out of range
+#define OPSTACK_CHECK	32
+#define OPSTACK_SLACK	(OPSTACK_CHECK * 2 * 4)
+
+/* exit() won't be called but use it because it is marked with noreturn */
+#define DIE( reason, args... ) \
+	do { \
+		Com_Error(ERR_DROP, "vm_aarch64 compiler error: " reason, ##args); \
+		exit(1); \
+	} while(0)
+
+/*
+ * opcode information table:
+ * - length of immediate value
+ */
+#define opImm0	0x0000 /* no immediate */
+#define opImm1	0x0001 /* 1 byte immadiate value after opcode */
+#define opImm4	0x0002 /* 4 bytes immediate value after opcode */
+#define opJump	0x0004 /* immediate is an instruction number */
+
+static const unsigned char vm_opInfo[256] =
+{
+	[OP_ENTER]	= opImm4,
+	[OP_LEAVE]	= opImm4,
+	[OP_CONST]	= opImm4,
+	[OP_LOCAL]	= opImm4,
+
+	[OP_EQ]		= opImm4 | opJump,
+	[OP_NE]		= opImm4 | opJump,
+	[OP_LTI]	= opImm4 | opJump,
+	[OP_LEI]	= opImm4 | opJump,
+	[OP_GTI]	= opImm4 | opJump,
+	[OP_GEI]	= opImm4 | opJump,
+	[OP_LTU]	= opImm4 | opJump,
+	[OP_LEU]	= opImm4 | opJump,
+	[OP_GTU]	= opImm4 | opJump,
+	[OP_GEU]	= opImm4 | opJump,
+	[OP_EQF]	= opImm4 | opJump,
+	[OP_NEF]	= opImm4 | opJump,
+	[OP_LTF]	= opImm4 | opJump,
+	[OP_LEF]	= opImm4 | opJump,
+	[OP_GTF]	= opImm4 | opJump,
+	[OP_GEF]	= opImm4 | opJump,
+
+	[OP_ARG]	= opImm1,
+	[OP_BLOCK_COPY]	= opImm4,
+};
+
+// conditions
+#define EQ	0x0
+#define NE	0x1
+#define HS	0x2
+#define LO	0x3
+#define MI	0x4
+#define PL	0x5
+#define VS	0x6
+#define VC	0x7
+#define HI	0x8
+#define LS	0x9
+#define GE	0xA
+#define LT	0xB
+#define GT	0xC
+#define LE	0xD
+#define AL	0xE
+
+#define NOP		0xD503201F
+#define BRK(i)		(0xD4200000 | (((i)&0xFFFF)<<5))
+#define RET		0xD65F03C0
+#define BR(rn)		(0xD61F0000 | ((rn)<<5))
+#define BLR(rn)		(0xD63F0000 | ((rn)<<5))
+
+// move wide immediate, hw selects the 16 bit chunk
+#define MOVZw(rd, i, hw)	(0x52800000 | ((hw)<<21) | (((i)&0xFFFF)<<5) | (rd))
+#define MOVKw(rd, i, hw)	(0x72800000 | ((hw)<<21) | (((i)&0xFFFF)<<5) | (rd))
+#define MOVNw(rd, i, hw)	(0x12800000 | ((hw)<<21) | (((i)&0xFFFF)<<5) | (rd))
+#define MOVZx(rd, i, hw)	(0xD2800000 | ((hw)<<21) | (((i)&0xFFFF)<<5) | (rd))
+#define MOVKx(rd, i, hw)	(0xF2800000 | ((hw)<<21) | (((i)&0xFFFF)<<5) | (rd))
+
+// immediate must fit in 12 bits!
+#define ADDwi(rd, rn, i)	(0x11000000 | (imm12(i)<<10) | ((rn)<<5) | (rd))
+#define SUBwi(rd, rn, i)	(0x51000000 | (imm12(i)<<10) | ((rn)<<5) | (rd))
+#define CMPwi(rn, i)		(0x71000000 | (imm12(i)<<10) | ((rn)<<5) | ZR)
+#define CMNwi(rn, i)		(0x31000000 | (imm12(i)<<10) | ((rn)<<5) | ZR)
+#define ADDxi(rd, rn, i)	(0x91000000 | (imm12(i)<<10) | ((rn)<<5) | (rd))
+#define SUBxi(rd, rn, i)	(0xD1000000 | (imm12(i)<<10) | ((rn)<<5) | (rd))
+#define CMPxi(rn, i)		(0xF1000000 | (imm12(i)<<10) | ((rn)<<5) | ZR)
+
+#define ADDw(rd, rn, rm)	(0x0B000000 | ((rm)<<16) | ((rn)<<5) | (rd))
+#define SUBw(rd, rn, rm)	(0x4B000000 | ((rm)<<16) | ((rn)<<5) | (rd))
+#define CMPw(rn, rm)		(0x6B000000 | ((rm)<<16) | ((rn)<<5) | ZR)
+#define ADDx(rd, rn, rm)	(0x8B000000 | ((rm)<<16) | ((rn)<<5) | (rd))
+#define SUBx(rd, rn, rm)	(0xCB000000 | ((rm)<<16) | ((rn)<<5) | (rd))
+#define NEGw(rd, rm)		SUBw(rd, ZR, rm)
+
+#define ANDw(rd, rn, rm)	(0x0A000000 | ((rm)<<16) | ((rn)<<5) | (rd))
+#define ORRw(rd, rn, rm)	(0x2A000000 | ((rm)<<16) | ((rn)<<5) | (rd))
+#define EORw(rd, rn, rm)	(0x4A000000 | ((rm)<<16) | ((rn)<<5) | (rd))
+#define MVNw(rd, rm)		(0x2A200000 | ((rm)<<16) | (ZR<<5) | (rd))
+#define MOVw(rd, rm)		ORRw(rd, ZR, rm)
+#define MOVx(rd, rm)		(0xAA000000 | ((rm)<<16) | (ZR<<5) | (rd))
+#define MOVxSP(rd, rn)		ADDxi(rd, rn, 0)
+
+#define MULw(rd, rn, rm)	(0x1B007C00 | ((rm)<<16) | ((rn)<<5) | (rd))
+#define MSUBw(rd, rn, rm, ra)	(0x1B008000 | ((rm)<<16) | ((ra)<<10) | ((rn)<<5) | (rd))
+#define SDIVw(rd, rn, rm)	(0x1AC00C00 | ((rm)<<16) | ((rn)<<5) | (rd))
+#define UDIVw(rd, rn, rm)	(0x1AC00800 | ((rm)<<16) | ((rn)<<5) | (rd))
+
+#define LSLVw(rd, rn, rm)	(0x1AC02000 | ((rm)<<16) | ((rn)<<5) | (rd))
+#define LSRVw(rd, rn, rm)	(0x1AC02400 | ((rm)<<16) | ((rn)<<5) | (rd))
+#define ASRVw(rd, rn, rm)	(0x1AC02800 | ((rm)<<16) | ((rn)<<5) | (rd))
+
+#define SXTBw(rd, rn)		(0x13001C00 | ((rn)<<5) | (rd))
+#define SXTHw(rd, rn)		(0x13003C00 | ((rn)<<5) | (rd))
+
+// loads and stores with scaled unsigned offset
+#define LDRwi(rt, rn, i)	(0xB9400000 | (uoff(i, 2)<<10) | ((rn)<<5) | (rt))
+#define STRwi(rt, rn, i)	(0xB9000000 | (uoff(i, 2)<<10) | ((rn)<<5) | (rt))
+#define LDRxi(rt, rn, i)	(0xF9400000 | (uoff(i, 3)<<10) | ((rn)<<5) | (rt))
+#define STRxi(rt, rn, i)	(0xF9000000 | (uoff(i, 3)<<10) | ((rn)<<5) | (rt))
+#define LDRsi(rt, rn, i)	(0xBD400000 | (uoff(i, 2)<<10) | ((rn)<<5) | (rt))
+#define STRsi(rt, rn, i)	(0xBD000000 | (uoff(i, 2)<<10) | ((rn)<<5) | (rt))
+
+// load with post-increment, store with pre-increment
+#define LDRw_post(rt, rn, i)	(0xB8400400 | (((i)&0x1FF)<<12) | ((rn)<<5) | (rt))
+#define STRw_pre(rt, rn, i)	(0xB8000C00 | (((i)&0x1FF)<<12) | ((rn)<<5) | (rt))
+#define LDRs_post(rt, rn, i)	(0xBC400400 | (((i)&0x1FF)<<12) | ((rn)<<5) | (rt))
+
+// register offset, 32 bit index is zero extended
+#define LDRw_uxtw(rt, rn, rm)	(0xB8604800 | ((rm)<<16) | ((rn)<<5) | (rt))
+#define STRw_uxtw(rt, rn, rm)	(0xB8204800 | ((rm)<<16) | ((rn)<<5) | (rt))
+#define LDRHw_uxtw(rt, rn, rm)	(0x78604800 | ((rm)<<16) | ((rn)<<5) | (rt))
+#define STRHw_uxtw(rt, rn, rm)	(0x78204800 | ((rm)<<16) | ((rn)<<5) | (rt))
+#define LDRBw_uxtw(rt, rn, rm)	(0x38604800 | ((rm)<<16) | ((rn)<<5) | (rt))
+#define STRBw_uxtw(rt, rn, rm)	(0x38204800 | ((rm)<<16) | ((rn)<<5) | (rt))
+// 64 bit load, index scaled by 8
+#define LDRx_lsl3(rt, rn, rm)	(0xF8607800 | ((rm)<<16) | ((rn)<<5) | (rt))
+
+// register pairs, offset is scaled by 8
+#define STPx_pre(rt, rt2, rn, i)	(0xA9800000 | ((((i)>>3)&0x7F)<<15) | ((rt2)<<10) | ((rn)<<5) | (rt))
+#define LDPx_post(rt, rt2, rn, i)	(0xA8C00000 | ((((i)>>3)&0x7F)<<15) | ((rt2)<<10) | ((rn)<<5) | (rt))
+#define STPx(rt, rt2, rn, i)		(0xA9000000 | ((((i)>>3)&0x7F)<<15) | ((rt2)<<10) | ((rn)<<5) | (rt))
+#define LDPx(rt, rt2, rn, i)		(0xA9400000 | ((((i)>>3)&0x7F)<<15) | ((rt2)<<10) | ((rn)<<5) | (rt))
+#define STRx_pre(rt, rn, i)		(0xF8000C00 | (((i)&0x1FF)<<12) | ((rn)<<5) | (rt))
+#define LDRx_post(rt, rn, i)		(0xF8400400 | (((i)&0x1FF)<<12) | ((rn)<<5) | (rt))
+
+#define FMOVsw(sd, wn)		(0x1E270000 | ((wn)<<5) | (sd))
+#define FMOVws(wd, sn)		(0x1E260000 | ((sn)<<5) | (wd))
+#define FADDs(sd, sn, sm)	(0x1E202800 | ((sm)<<16) | ((sn)<<5) | (sd))
+#define FSUBs(sd, sn, sm)	(0x1E203800 | ((sm)<<16) | ((sn)<<5) | (sd))
+#define FMULs(sd, sn, sm)	(0x1E200800 | ((sm)<<16) | ((sn)<<5) | (sd))
+#define FDIVs(sd, sn, sm)	(0x1E201800 | ((sm)<<16) | ((sn)<<5) | (sd))
+#define FNEGs(sd, sn)		(0x1E214000 | ((sn)<<5) | (sd))
+#define FCMPs(sn, sm)		(0x1E202000 | ((sm)<<16) | ((sn)<<5))
+#define SCVTFsw(sd, wn)		(0x1E220000 | ((wn)<<5) | (sd))
+#define FCVTZSws(wd, sn)	(0x1E380000 | ((sn)<<5) | (wd))
+
+// branches, offsets are in bytes relative to the branch instruction
+#define Bi(ofs)			(0x14000000 | (rel26(ofs)))
+#define BLi(ofs)		(0x94000000 | (rel26(ofs)))
+#define Bcond(c, ofs)		(0x54000000 | (rel19(ofs)<<5) | (c))
+#define TBNZw(rt, bit, ofs)	(0x37000000 | ((bit)<<19) | (rel14(ofs)<<5) | (rt))
+
+static unsigned imm12(int val)
+{
+	if (val < 0 || val > 0xFFF)
+		DIE("immediate cannot be encoded (%d)", val);
+	return val;
+}
+
+static unsigned uoff(int val, int scale)
+{
+	if (val < 0 || (val & ((1<<scale)-1)) || (val >> scale) > 0xFFF)
+		DIE("offset cannot be encoded (%d)", val);
+	return val >> scale;
+}
+
+static unsigned rel26(int ofs)
+{
+	if ((ofs & 3) || ofs < -(1<<27) || ofs >= (1<<27))
+		DIE("branch offset %d out of range", ofs);
+	return (ofs >> 2) & 0x3FFFFFF;
+}
+
+static unsigned rel19(int ofs)
+{
+	if ((ofs & 3) || ofs < -(1<<20) || ofs >= (1<<20))
+		DIE("conditional branch offset %d out of range", ofs);
+	return (ofs >> 2) & 0x7FFFF;
+}
+
+static unsigned rel14(int ofs)
+{
+	if ((ofs & 3) || ofs < -(1<<15) || ofs >= (1<<15))
+		DIE("test branch offset %d out of range", ofs);
+	return (ofs >> 2) & 0x3FFF;
+}
+
+static void VM_Destroy_Compiled(vm_t *vm)
+{
+	if (vm->codeBase) {
+		if (munmap(vm->codeBase, vm->codeLength))
+			Com_Printf(S_COLOR_RED "Memory unmap failed, possible memory leak\n");
+	}
+	vm->codeBase = NULL;
+}
+
+/*
+=================
+ErrJump
+Error handler for jump/call to invalid instruction number
+=================
+*/
+
+static void __attribute__((__noreturn__)) ErrJump(unsigned num)
+{
+	Com_Error(ERR_DROP, "program tried to execute code outside VM (%x)", num);
+}
+
+/*
+=================
+ErrOpStack
+Error handler for opStack over- and underflows
+=================
+*/
+
+static void __attribute__((__noreturn__)) ErrOpStack(void)
+{
+	Com_Error(ERR_DROP, "opStack corrupted in compiled code");
+}
+
+/*
+=================
+asmcall
+System call dispatcher, arguments start at programStack + 8
+=================
+*/
+
+static int asmcall(int call, int pstack)
+{
+	// save currentVM so as to allow for recursive VM entry
+	vm_t *savedVM = currentVM;
+	int i, ret;
+	intptr_t args[MAX_VMSYSCALL_ARGS];
+	int *argPosition;
+
+	// modify VM stack pointer for recursive VM entry
+	currentVM->programStack = pstack - 4;
+
+	args[0] = -1 - call;
+	argPosition = (int *)((byte *)currentVM->dataBase + pstack + 4);
+	for( i = 1; i < ARRAY_LEN(args); i++ )
+		args[i] = argPosition[i];
+
+	ret = currentVM->systemCall(args);
+
+	currentVM = savedVM;
+
+	return ret;
+}
+
+static void _emit(vm_t *vm, unsigned isn, int pass)
+{
+	if (pass)
+		memcpy(vm->codeBase+vm->codeLength, &isn, 4);
+	vm->codeLength+=4;
+}
+
+#define emit(isn) _emit(vm, isn, pass)
+
+// offset from the current position to code offset x
+#define rel(x) (pass ? (int)(x) - vm->codeLength : 0)
+
+/*
+=================
+emit_MOVwi
+Put a 32 bit integer in register reg
+=================
+*/
+static void emit_MOVwi(vm_t *vm, int pass, int reg, unsigned val)
+{
+	if (!(val & 0xFFFF0000)) {
+		emit(MOVZw(reg, val, 0));
+	} else if (!(val & 0xFFFF)) {
+		emit(MOVZw(reg, val >> 16, 1));
+	} else if ((val & 0xFFFF0000) == 0xFFFF0000) {
+		emit(MOVNw(reg, ~val, 0));
+	} else {
+		emit(MOVZw(reg, val, 0));
+		emit(MOVKw(reg, val >> 16, 1));
+	}
+}
+
+/*
+=================
+emit_MOVxi
+Put a host pointer in register reg, always four instructions
+=================
+*/
+static void emit_MOVxi(vm_t *vm, int pass, int reg, void *ptr)
+{
+	uint64_t val = (uint64_t)(intptr_t)ptr;
+
+	emit(MOVZx(reg, val, 0));
+	emit(MOVKx(reg, val >> 16, 1));
+	emit(MOVKx(reg, val >> 32, 2));
+	emit(MOVKx(reg, val >> 48, 3));
+}
+
+/*
+=================
+emit_ADDwi
+rd = rn + val for any value, clobbers IP0
+=================
+*/
+static void emit_ADDwi(vm_t *vm, int pass, int rd, int rn, int val)
+{
+	if (val >= 0 && val <= 0xFFF)
+		emit(ADDwi(rd, rn, val));
+	else if (val < 0 && val >= -0xFFF)
+		emit(SUBwi(rd, rn, -val));
+	else {
+		emit_MOVwi(vm, pass, IP0, val);
+		emit(ADDw(rd, rn, IP0));
+	}
+}
+
+/*
+=================
+emit_CheckOpStack
+Make sure the opStack pointer is within its bounds
+=================
+*/
+static void emit_CheckOpStack(vm_t *vm, int pass, int errOfs)
+{
+	emit(SUBx(IP0, rOPSTACK, rOPSTACKBASE));
+	emit(CMPxi(IP0, OPSTACK_SIZE - 4));
+	emit(Bcond(LS, 8));
+	emit(BLi(rel(errOfs)));
+}
+
+/*
+=================
+emit_Branch
+Conditional branch to instruction number dest. B.cond only reaches +-1MB
+so the condition gets inverted and jumps over an unconditional branch.
+=================
+*/
+static void emit_Branch(vm_t *vm, int pass, int cond, int dest)
+{
+	emit(Bcond(cond ^ 1, 8));
+	emit(Bi(rel(vm->instructionPointers[dest])));
+}
+
+// save the instruction number the call returns to at programStack, the
+// way the interpreter does, so the VM profiler can walk the program stack
+static void emit_StoreReturn(vm_t *vm, int pass, int instruction)
+{
+	emit_MOVwi(vm, pass, R1, instruction);
+	emit(ANDw(R2, rPSTACK, rDATAMASK));
+	emit(STRw_uxtw(R1, rDATABASE, R2));
+}
+
+static int IntCondition(int op)
+{
+	switch (op) {
+	case OP_EQ:	return EQ;
+	case OP_NE:	return NE;
+	case OP_LTI:	return LT;
+	case OP_LEI:	return LE;
+	case OP_GTI:	return GT;
+	case OP_GEI:	return GE;
+	case OP_LTU:	return LO;
+	case OP_LEU:	return LS;
+	case OP_GTU:	return HI;
+	default:	return HS;
+	}
+}
+
+// conditions which are false for unordered operands, except for NE
+static int FloatCondition(int op)
+{
+	switch (op) {
+	case OP_EQF:	return EQ;
+	case OP_NEF:	return NE;
+	case OP_LTF:	return MI;
+	case OP_LEF:	return LS;
+	case OP_GTF:	return GT;
+	default:	return GE;
+	}
+}
+
+static int NextOp(const byte *code, int pc)
+{
+	return code[pc];
+}
+
+static int NextConstant4(const byte *code, int pc)
+{
+	return (int)((unsigned)code[pc] | ((unsigned)code[pc+1]<<8) | ((unsigned)code[pc+2]<<16) | ((unsigned)code[pc+3]<<24));
+}
+
+/*
+=================
+VM_FindJumpTargets
+Mark every instruction that may be the target of a jump. Returns qfalse if
+a jump target is out of range.
+=================
+*/
+static qboolean VM_FindJumpTargets(vm_t *vm, vmHeader_t *header, const byte *code, byte *jused)
+{
+	int i, pc, op, v;
+
+	for (i = 0; i < vm->numJumpTableTargets; i++) {
+		v = ((int *)vm->jumpTableTargets)[i];
+		if (v < 0 || v >= header->instructionCount)
+			return qfalse;
+		jused[v] = 1;
+	}
+
+	pc = 0;
+	for (i = 0; i < header->instructionCount; i++) {
+		if (pc >= header->codeLength)
+			return qfalse;
+
+		op = code[pc++];
+		if (vm_opInfo[op] & opImm4) {
+			v = NextConstant4(code, pc);
+			pc += 4;
+			if (vm_opInfo[op] & opJump) {
+				if (v < 0 || v >= header->instructionCount)
+					return qfalse;
+				jused[v] = 1;
+			} else if (op == OP_CONST && code[pc] == OP_JUMP) {
+				// invalid targets are caught at run time
+				if (v >= 0 && v < header->instructionCount)
+					jused[v] = 1;
+			}
+		} else if (vm_opInfo[op] & opImm1)
+			pc++;
+	}
+
+	return qtrue;
+}
+
+void VM_Compile(vm_t *vm, vmHeader_t *header)
+{
+	byte *code;
+	byte *jused;
+	int i_count, pc;
+	int pass;
+	int op, v;
+	int sinceCheck;
+	int codeLength;
+	int callOfs = 0, jumpOfs = 0, syscallOfs = 0, errJumpOfs = 0, errOpStackOfs = 0;
+
+	vm->compiled = qfalse;
+
+	// copy code in larger buffer and put some zeros at the end
+	// so we can safely look ahead for a few instructions in it
+	code = Z_Malloc(header->codeLength + 32);
+	Com_Memset(code, 0, header->codeLength + 32);
+	Com_Memcpy(code, (byte *)header + header->codeOffset, header->codeLength);
+
+	jused = Z_Malloc(header->instructionCount + 2);
+	Com_Memset(jused, 0, header->instructionCount + 2);
+
+	if (!VM_FindJumpTargets(vm, header, code, jused)) {
+		Z_Free(code);
+		Z_Free(jused);
+		DIE("jump target out of range");
+	}
+
+	vm->codeBase = NULL;
+	codeLength = 0;
+
+	for (pass = 0; pass < 2; ++pass) {
+
+	if (pass)
+	{
+		codeLength = vm->codeLength;
+		vm->codeBase = mmap(NULL, codeLength, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+		if (vm->codeBase == MAP_FAILED)
+			Com_Error(ERR_FATAL, "VM_CompileAArch64: can't mmap memory");
+	}
+	vm->codeLength = 0;
+
+	//int (*entry)(vm_t*, int *programStack, int **opStack);
+	emit(STPx_pre(FP, LR, SP, -96));
+	emit(MOVxSP(FP, SP));
+	emit(STPx(19, 20, SP, 16));
+	emit(STPx(21, 22, SP, 32));
+	emit(STPx(23, 24, SP, 48));
+	emit(STPx(25, 26, SP, 64));
+	emit(STRxi(R2, SP, 80));
+	emit(MOVx(rPSTACKPTR, R1));
+	emit(LDRxi(rOPSTACK, R2, 0));
+	emit(MOVx(rOPSTACKBASE, rOPSTACK));
+	emit(LDRwi(rPSTACK, rPSTACKPTR, 0));
+	emit(LDRxi(rDATABASE, R0, offsetof(vm_t, dataBase)));
+	emit(LDRwi(rDATAMASK, R0, offsetof(vm_t, dataMask)));
+	emit(LDRxi(rINSPOINTERS, R0, offsetof(vm_t, instructionPointers)));
+	emit(LDRxi(rCODEBASE, R0, offsetof(vm_t, codeBase)));
+
+	emit(BLi(rel(vm->instructionPointers[0])));
+
+	// write back programStack and opStack for the sanity checks
+	emit(STRwi(rPSTACK, rPSTACKPTR, 0));
+	emit(LDRxi(R2, SP, 80));
+	emit(STRxi(rOPSTACK, R2, 0));
+	emit(LDRwi(R0, rOPSTACK, 0));
+
+	emit(LDPx(25, 26, SP, 64));
+	emit(LDPx(23, 24, SP, 48));
+	emit(LDPx(21, 22, SP, 32));
+	emit(LDPx(19, 20, SP, 16));
+	emit(LDPx_post(FP, LR, SP, 96));
+	emit(RET);
+
+	// jump/call to invalid instruction number in w0
+	errJumpOfs = vm->codeLength;
+	emit_MOVxi(vm, pass, IP0, ErrJump);
+	emit(BLR(IP0));
+
+	errOpStackOfs = vm->codeLength;
+	emit_MOVxi(vm, pass, IP0, ErrOpStack);
+	emit(BLR(IP0));
+
+	// system call number in w0, pushes the return value
+	syscallOfs = vm->codeLength;
+	emit(STPx_pre(FP, LR, SP, -16));
+	emit(MOVw(R1, rPSTACK));
+	emit_MOVxi(vm, pass, IP0, asmcall);
+	emit(BLR(IP0));
+	emit(STRw_pre(R0, rOPSTACK, 4));
+	emit(LDPx_post(FP, LR, SP, 16));
+	emit(RET);
+
+	// call instruction number or system call in w0, LR holds
+	// the return address so the procedure returns to the caller
+	callOfs = vm->codeLength;
+	emit(TBNZw(R0, 31, syscallOfs - vm->codeLength));
+	emit_MOVwi(vm, pass, R1, vm->instructionCount);
+	emit(CMPw(R0, R1));
+	emit(Bcond(HS, errJumpOfs - vm->codeLength));
+	emit(LDRx_lsl3(IP0, rINSPOINTERS, R0));
+	emit(ADDx(IP0, rCODEBASE, IP0));
+	emit(BR(IP0));
+
+	// jump to instruction number in w0
+	jumpOfs = vm->codeLength;
+	emit_MOVwi(vm, pass, R1, vm->instructionCount);
+	emit(CMPw(R0, R1));
+	emit(Bcond(HS, errJumpOfs - vm->codeLength));
+	emit(LDRx_lsl3(IP0, rINSPOINTERS, R0));
+	emit(ADDx(IP0, rCODEBASE, IP0));
+	emit(BR(IP0));
+
+	pc = 0;
+	sinceCheck = 0;
+
+	for (i_count = 0; i_count < header->instructionCount; i_count++) {
+		int next;
+
+		op = code[pc++];
+		v = 0;
+
+		vm->instructionPointers[i_count] = vm->codeLength;
+
+		if (vm_opInfo[op] & opImm4) {
+			v = NextConstant4(code, pc);
+			pc += 4;
+		} else if (vm_opInfo[op] & opImm1) {
+			v = code[pc];
+			pc++;
+		}
+
+		// operands can only be merged with the following instruction
+		// if it can't be reached by a jump
+		if (vm->jumpTableTargets && !jused[i_count + 1])
+			next = NextOp(code, pc);
+		else
+			next = OP_UNDEF;
+
+		if (jused[i_count] || op == OP_ENTER || sinceCheck >= OPSTACK_CHECK) {
+			emit_CheckOpStack(vm, pass, errOpStackOfs);
+			sinceCheck = 0;
+		}
+		sinceCheck++;
+
+		switch ( op )
+		{
+			case OP_UNDEF:
+			case OP_IGNORE:
+				break;
+
+			case OP_BREAK:
+				emit(BRK(0));
+				break;
+
+			case OP_ENTER:
+				emit(STRx_pre(LR, SP, -16));
+				emit_ADDwi(vm, pass, rPSTACK, rPSTACK, -v);	// pstack -= arg
+				break;
+
+			case OP_LEAVE:
+				emit_ADDwi(vm, pass, rPSTACK, rPSTACK, v);	// pstack += arg
+				emit(LDRx_post(LR, SP, 16));
+				emit(RET);
+				break;
+
+			case OP_CALL:
+				emit_StoreReturn(vm, pass, i_count + 1);
+				emit(LDRw_post(R0, rOPSTACK, -4));	// r0 = *opstack; opstack -= 4
+				emit(BLi(rel(callOfs)));
+				emit_CheckOpStack(vm, pass, errOpStackOfs);
+				sinceCheck = 0;
+				break;
+
+			case OP_PUSH:
+				emit(ADDxi(rOPSTACK, rOPSTACK, 4));
+				break;
+
+			case OP_POP:
+				emit(SUBxi(rOPSTACK, rOPSTACK, 4));
+				break;
+
+			case OP_CONST:
+				// leave calls and jumps to invalid targets to the range checks
+				if ((next == OP_CALL || next == OP_JUMP) && v >= (int)vm->instructionCount)
+					next = OP_UNDEF;
+				if (next == OP_JUMP && v < 0)
+					next = OP_UNDEF;
+
+				if (next == OP_CALL) {
+					emit_StoreReturn(vm, pass, i_count + 2);
+					if (v >= 0) {
+						emit(BLi(rel(vm->instructionPointers[v])));
+					} else {
+						emit_MOVwi(vm, pass, R0, v);
+						emit(BLi(rel(syscallOfs)));
+					}
+					emit_CheckOpStack(vm, pass, errOpStackOfs);
+					sinceCheck = 0;
+				} else if (next == OP_JUMP) {
+					emit(Bi(rel(vm->instructionPointers[v])));
+				} else if (next >= OP_EQ && next <= OP_GEU && v >= 0 && v <= 0xFFF) {
+					emit(LDRw_post(R0, rOPSTACK, -4));	// r0 = *opstack; opstack -= 4
+					emit(CMPwi(R0, v));
+					emit_Branch(vm, pass, IntCondition(next), NextConstant4(code, pc + 1));
+				} else if ((next == OP_ADD || next == OP_SUB) && v >= 0 && v <= 0xFFF) {
+					emit(LDRwi(R0, rOPSTACK, 0));		// r0 = *opstack
+					if (next == OP_ADD)
+						emit(ADDwi(R0, R0, v));
+					else
+						emit(SUBwi(R0, R0, v));
+					emit(STRwi(R0, rOPSTACK, 0));		// *opstack = r0
+				} else if (next == OP_LOAD4 || next == OP_LOAD2 || next == OP_LOAD1) {
+					emit_MOVwi(vm, pass, R0, v & vm->dataMask);
+					if (next == OP_LOAD4)
+						emit(LDRw_uxtw(R0, rDATABASE, R0));
+					else if (next == OP_LOAD2)
+						emit(LDRHw_uxtw(R0, rDATABASE, R0));
+					else
+						emit(LDRBw_uxtw(R0, rDATABASE, R0));
+					emit(STRw_pre(R0, rOPSTACK, 4));	// opstack += 4; *opstack = r0
+				} else {
+					next = OP_UNDEF;
+					emit_MOVwi(vm, pass, R0, v);
+					emit(STRw_pre(R0, rOPSTACK, 4));	// opstack += 4; *opstack = r0
+				}
+
+				if (next != OP_UNDEF) {
+					// skip the merged instruction
+					pc += (vm_opInfo[next] & opImm4) ? 5 : 1;
+					i_count++;
+					vm->instructionPointers[i_count] = vm->instructionPointers[i_count - 1];
+					sinceCheck++;
+				}
+				break;
+
+			case OP_LOCAL:
+				emit_ADDwi(vm, pass, R0, rPSTACK, v);		// r0 = pstack + arg
+				if (next == OP_LOAD4 || next == OP_LOAD2 || next == OP_LOAD1) {
+					emit(ANDw(R0, R0, rDATAMASK));		// r0 = r0 & dataMask
+					if (next == OP_LOAD4)
+						emit(LDRw_uxtw(R0, rDATABASE, R0));
+					else if (next == OP_LOAD2)
+						emit(LDRHw_uxtw(R0, rDATABASE, R0));
+					else
+						emit(LDRBw_uxtw(R0, rDATABASE, R0));
+					pc++;
+					i_count++;
+					vm->instructionPointers[i_count] = vm->instructionPointers[i_count - 1];
+					sinceCheck++;
+				}
+				emit(STRw_pre(R0, rOPSTACK, 4));		// opstack += 4; *opstack = r0
+				break;
+
+			case OP_JUMP:
+				emit(LDRw_post(R0, rOPSTACK, -4));		// r0 = *opstack; opstack -= 4
+				emit_CheckOpStack(vm, pass, errOpStackOfs);
+				emit(Bi(rel(jumpOfs)));
+				break;
+
+			case OP_EQ:
+			case OP_NE:
+			case OP_LTI:
+			case OP_LEI:
+			case OP_GTI:
+			case OP_GEI:
+			case OP_LTU:
+			case OP_LEU:
+			case OP_GTU:
+			case OP_GEU:
+				emit(LDRw_post(R1, rOPSTACK, -4));		// r1 = *opstack; opstack -= 4
+				emit(LDRw_post(R0, rOPSTACK, -4));		// r0 = *opstack; opstack -= 4
+				emit(CMPw(R0, R1));
+				emit_Branch(vm, pass, IntCondition(op), v);
+				break;
+
+			case OP_EQF:
+			case OP_NEF:
+			case OP_LTF:
+			case OP_LEF:
+			case OP_GTF:
+			case OP_GEF:
+				emit(LDRs_post(S1, rOPSTACK, -4));		// s1 = *opstack; opstack -= 4
+				emit(LDRs_post(S0, rOPSTACK, -4));		// s0 = *opstack; opstack -= 4
+				emit(FCMPs(S0, S1));
+				emit_Branch(vm, pass, FloatCondition(op), v);
+				break;
+
+			case OP_LOAD1:
+			case OP_LOAD2:
+			case OP_LOAD4:
+				emit(LDRwi(R0, rOPSTACK, 0));			// r0 = *opstack
+				emit(ANDw(R0, R0, rDATAMASK));			// r0 = r0 & dataMask
+				if (op == OP_LOAD4)
+					emit(LDRw_uxtw(R0, rDATABASE, R0));	// r0 = *(int *)&dataBase[r0]
+				else if (op == OP_LOAD2)
+					emit(LDRHw_uxtw(R0, rDATABASE, R0));	// r0 = *(unsigned short *)&dataBase[r0]
+				else
+					emit(LDRBw_uxtw(R0, rDATABASE, R0));	// r0 = dataBase[r0]
+				emit(STRwi(R0, rOPSTACK, 0));			// *opstack = r0
+				break;
+
+			case OP_STORE1:
+			case OP_STORE2:
+			case OP_STORE4:
+				emit(LDRw_post(R0, rOPSTACK, -4));		// r0 = *opstack; opstack -= 4
+				emit(LDRw_post(R1, rOPSTACK, -4));		// r1 = *opstack; opstack -= 4
+				emit(ANDw(R1, R1, rDATAMASK));			// r1 = r1 & dataMask
+				if (op == OP_STORE4)
+					emit(STRw_uxtw(R0, rDATABASE, R1));
+				else if (op == OP_STORE2)
+					emit(STRHw_uxtw(R0, rDATABASE, R1));
+				else
+					emit(STRBw_uxtw(R0, rDATABASE, R1));
+				break;
+
+			case OP_ARG:
+				emit(LDRw_post(R0, rOPSTACK, -4));		// r0 = *opstack; opstack -= 4
+				emit(ADDwi(R1, rPSTACK, v));			// r1 = pstack + arg
+				emit(ANDw(R1, R1, rDATAMASK));			// r1 = r1 & dataMask
+				emit(STRw_uxtw(R0, rDATABASE, R1));		// dataBase[r1] = r0
+				break;
+
+			case OP_BLOCK_COPY:
+				emit(LDRw_post(R1, rOPSTACK, -4));		// src
+				emit(LDRw_post(R0, rOPSTACK, -4));		// dest
+				emit_MOVwi(vm, pass, R2, v);
+				emit_MOVxi(vm, pass, IP0, VM_BlockCopy);
+				emit(BLR(IP0));
+				break;
+
+			case OP_SEX8:
+			case OP_SEX16:
+			case OP_NEGI:
+			case OP_BCOM:
+				emit(LDRwi(R0, rOPSTACK, 0));			// r0 = *opstack
+				if (op == OP_SEX8)
+					emit(SXTBw(R0, R0));
+				else if (op == OP_SEX16)
+					emit(SXTHw(R0, R0));
+				else if (op == OP_NEGI)
+					emit(NEGw(R0, R0));
+				else
+					emit(MVNw(R0, R0));
+				emit(STRwi(R0, rOPSTACK, 0));			// *opstack = r0
+				break;
+
+			case OP_ADD:
+			case OP_SUB:
+			case OP_DIVI:
+			case OP_DIVU:
+			case OP_MODI:
+			case OP_MODU:
+			case OP_MULI:
+			case OP_MULU:
+			case OP_BAND:
+			case OP_BOR:
+			case OP_BXOR:
+			case OP_LSH:
+			case OP_RSHI:
+			case OP_RSHU:
+				emit(LDRw_post(R1, rOPSTACK, -4));		// r1 = *opstack; opstack -= 4
+				emit(LDRwi(R0, rOPSTACK, 0));			// r0 = *opstack
+				switch (op) {
+				case OP_ADD:	emit(ADDw(R0, R0, R1)); break;
+				case OP_SUB:	emit(SUBw(R0, R0, R1)); break;
+				case OP_DIVI:	emit(SDIVw(R0, R0, R1)); break;
+				case OP_DIVU:	emit(UDIVw(R0, R0, R1)); break;
+				case OP_MODI:
+					emit(SDIVw(R2, R0, R1));
+					emit(MSUBw(R0, R2, R1, R0));		// r0 = r0 - r2 * r1
+					break;
+				case OP_MODU:
+					emit(UDIVw(R2, R0, R1));
+					emit(MSUBw(R0, R2, R1, R0));		// r0 = r0 - r2 * r1
+					break;
+				case OP_MULI:
+				case OP_MULU:	emit(MULw(R0, R0, R1)); break;
+				case OP_BAND:	emit(ANDw(R0, R0, R1)); break;
+				case OP_BOR:	emit(ORRw(R0, R0, R1)); break;
+				case OP_BXOR:	emit(EORw(R0, R0, R1)); break;
+				case OP_LSH:	emit(LSLVw(R0, R0, R1)); break;
+				case OP_RSHI:	emit(ASRVw(R0, R0, R1)); break;
+				default:	emit(LSRVw(R0, R0, R1)); break;
+				}
+				emit(STRwi(R0, rOPSTACK, 0));			// *opstack = r0
+				break;
+
+			case OP_NEGF:
+				emit(LDRsi(S0, rOPSTACK, 0));			// s0 = *(float *)opstack
+				emit(FNEGs(S0, S0));
+				emit(STRsi(S0, rOPSTACK, 0));			// *(float *)opstack = s0
+				break;
+
+			case OP_ADDF:
+			case OP_SUBF:
+			case OP_DIVF:
+			case OP_MULF:
+				emit(LDRs_post(S1, rOPSTACK, -4));		// s1 = *opstack; opstack -= 4
+				emit(LDRsi(S0, rOPSTACK, 0));			// s0 = *opstack
+				if (op == OP_ADDF)
+					emit(FADDs(S0, S0, S1));
+				else if (op == OP_SUBF)
+					emit(FSUBs(S0, S0, S1));
+				else if (op == OP_DIVF)
+					emit(FDIVs(S0, S0, S1));
+				else
+					emit(FMULs(S0, S0, S1));
+				emit(STRsi(S0, rOPSTACK, 0));			// *(float *)opstack = s0
+				break;
+
+			case OP_CVIF:
+				emit(LDRwi(R0, rOPSTACK, 0));			// r0 = *opstack
+				emit(SCVTFsw(S0, R0));				// s0 = (float)r0
+				emit(STRsi(S0, rOPSTACK, 0));			// *(float *)opstack = s0
+				break;
+
+			case OP_CVFI:
+				emit(LDRsi(S0, rOPSTACK, 0));			// s0 = *(float *)opstack
+				emit(FCVTZSws(R0, S0));				// r0 = (int)s0
+				emit(STRwi(R0, rOPSTACK, 0));			// *opstack = r0
+				break;
+
+			default:
+				Z_Free(code);
+				Z_Free(jused);
+				if (pass)
+					munmap(vm->codeBase, codeLength);
+				vm->codeBase = NULL;
+				DIE("bad opcode %i at instruction %i", op, i_count);
+		}
+	}
+
+	// never reached
+	emit(BRK(0));
+
+	if (pass && vm->codeLength != codeLength)
+		DIE("code size changed between passes");
+	} // pass
+
+	Z_Free(code);
+	Z_Free(jused);
+
+	if (mprotect(vm->codeBase, vm->codeLength, PROT_READ|PROT_EXEC)) {
+		VM_Destroy_Compiled(vm);
+		DIE("mprotect failed");
+	}
+
+	__builtin___clear_cache((char *)vm->codeBase, (char *)vm->codeBase + vm->codeLength);
+
+	Com_Printf( "VM file %s compiled to %i bytes of code\n", vm->name, vm->codeLength );
+
+	vm->destroy = VM_Destroy_Compiled;
+	vm->compiled = qtrue;
+}
+
+/*
+==============
+VM_CallCompiled
+
+This function is called directly by the generated code
+==============
+*/
+int VM_CallCompiled(vm_t *vm, int *args)
+{
+	byte	stack[OPSTACK_SIZE + 2 * OPSTACK_SLACK + 15];
+	int	*opStack, *opStackTop;
+	int	programStack = vm->programStack;
+	int	stackOnEntry = programStack;
+	byte	*image = vm->dataBase;
+	int	*argPointer;
+	int	retVal;
+	int	(*entry)(vm_t *, int *, int **);
+
+	currentVM = vm;
+
+	vm->currentlyInterpreting = qtrue;
+
+	programStack -= ( 8 + 4 * MAX_VMMAIN_ARGS );
+	argPointer = (int *)&image[ programStack + 8 ];
+	memcpy( argPointer, args, 4 * MAX_VMMAIN_ARGS );
+	argPointer[-1] = 0;
+	argPointer[-2] = -1;
+
+	// leave some room below the opStack as it is only checked
+	// every few instructions
+	opStack = PADP(stack + OPSTACK_SLACK, 16);
+	*opStack = 0xDEADBEEF;
+	opStackTop = opStack;
+
+	/* call generated code */
+	entry = (void *)vm->codeBase;
+	retVal = entry(vm, &programStack, &opStackTop);
+
+	if(opStackTop != opStack + 1 || *opStack != 0xDEADBEEF)
+	{
+		Com_Error(ERR_DROP, "opStack corrupted in compiled code");
+	}
+
+	if(programStack != stackOnEntry - (8 + 4 * MAX_VMMAIN_ARGS))
+		Com_Error(ERR_DROP, "programStack corrupted in compiled code");
+
+	vm->programStack = stackOnEntry;
+	vm->currentlyInterpreting = qfalse;
+
+	return retVal;
+}
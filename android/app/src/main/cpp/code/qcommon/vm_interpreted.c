@@ -108,7 +108,29 @@ static char	*opnames[256] = {
 	"OP_MULF",
 
 	"OP_CVIF",
-	"OP_CVFI"
+	"OP_CVFI",
+
+	"OPX_LOCAL_LOAD4",
+	"OPX_CONST_LOAD4",
+	"OPX_CONST_ADD",
+	"OPX_CONST_SUB",
+	"OPX_CONST_MULI",
+	"OPX_CONST_BAND",
+	"OPX_CONST_LSH",
+	"OPX_CONST_EQ",
+	"OPX_CONST_NE",
+	"OPX_CONST_LTI",
+	"OPX_CONST_LEI",
+	"OPX_CONST_GTI",
+	"OPX_CONST_GEI",
+	"OPX_CONST_LTU",
+	"OPX_CONST_LEU",
+	"OPX_CONST_GTU",
+	"OPX_CONST_GEU",
+	"OPX_CONST_CALL",
+	"OPX_CONST_JUMP",
+	"OPX_LOCAL_CONST_STORE4",
+	"OPX_END"
 };
 #endif
 
@@ -162,6 +184,127 @@ void VM_StackTrace( vm_t *vm, int programCounter, int programStack ) {
 }
 
 
+
+/*
+==============================================================
+
+INSTRUCTION DECODING
+
+The bytecode is decoded into one vmInstruction_t per instruction, so an
+instruction number is an index into the code and neither branches nor
+calls need a lookup through vm->instructionPointers.
+
+Superinstructions replace the first instruction of a common sequence.
+The instructions that follow are left in place, so a branch into the
+middle of a sequence still executes the plain opcodes, and the
+superinstruction reads their operands when it needs them.
+
+==============================================================
+*/
+
+typedef enum {
+	OPX_LOCAL_LOAD4 = OP_CVFI + 1,	// LOCAL LOAD4
+	OPX_CONST_LOAD4,				// CONST LOAD4
+	OPX_CONST_ADD,					// CONST ADD
+	OPX_CONST_SUB,
+	OPX_CONST_MULI,
+	OPX_CONST_BAND,
+	OPX_CONST_LSH,
+	OPX_CONST_EQ,					// CONST EQ, in the same order as OP_EQ - OP_GEU
+	OPX_CONST_NE,
+	OPX_CONST_LTI,
+	OPX_CONST_LEI,
+	OPX_CONST_GTI,
+	OPX_CONST_GEI,
+	OPX_CONST_LTU,
+	OPX_CONST_LEU,
+	OPX_CONST_GTU,
+	OPX_CONST_GEU,
+	OPX_CONST_CALL,					// CONST CALL
+	OPX_CONST_JUMP,					// CONST JUMP
+	OPX_LOCAL_CONST_STORE4,			// LOCAL CONST STORE4
+	OPX_END,						// marks the end of the code
+
+	OPX_MAX
+} vmOpx_t;
+
+typedef struct {
+	int		op;
+	int		value;		// operand, branch targets are instruction numbers
+} vmInstruction_t;
+
+/*
+====================
+VM_FuseInstructions
+====================
+*/
+static void VM_FuseInstructions( vmInstruction_t *code, int count ) {
+	int		i, next;
+
+	for ( i = 0 ; i < count - 1 ; i++ ) {
+		next = code[i+1].op;
+
+		switch ( code[i].op ) {
+		case OP_LOCAL:
+			if ( next == OP_CONST && i + 2 < count && code[i+2].op == OP_STORE4 ) {
+				code[i].op = OPX_LOCAL_CONST_STORE4;
+			} else if ( next == OP_LOAD4 ) {
+				code[i].op = OPX_LOCAL_LOAD4;
+			}
+			break;
+
+		case OP_CONST:
+			switch ( next ) {
+			case OP_LOAD4:
+				code[i].op = OPX_CONST_LOAD4;
+				break;
+			case OP_ADD:
+				code[i].op = OPX_CONST_ADD;
+				break;
+			case OP_SUB:
+				code[i].op = OPX_CONST_SUB;
+				break;
+			case OP_MULI:
+				code[i].op = OPX_CONST_MULI;
+				break;
+			case OP_BAND:
+				code[i].op = OPX_CONST_BAND;
+				break;
+			case OP_LSH:
+				code[i].op = OPX_CONST_LSH;
+				break;
+			case OP_EQ:
+			case OP_NE:
+			case OP_LTI:
+			case OP_LEI:
+			case OP_GTI:
+			case OP_GEI:
+			case OP_LTU:
+			case OP_LEU:
+			case OP_GTU:
+			case OP_GEU:
+				code[i].op = OPX_CONST_EQ + ( next - OP_EQ );
+				break;
+			case OP_CALL:
+				code[i].op = OPX_CONST_CALL;
+				break;
+			case OP_JUMP:
+				// bad targets are left to the range check in OP_JUMP
+				if ( (unsigned)code[i].value < (unsigned)count ) {
+					code[i].op = OPX_CONST_JUMP;
+				}
+				break;
+			default:
+				break;
+			}
+			break;
+
+		default:
+			break;
+		}
+	}
+}
+
 /*
 ====================
 VM_PrepareInterpreter
@@ -170,33 +313,29 @@ VM_PrepareInterpreter
 void VM_PrepareInterpreter( vm_t *vm, vmHeader_t *header ) {
 	int		op;
 	int		byte_pc;
-	int		int_pc;
 	byte	*code;
 	int		instruction;
-	int		*codeBase;
+	vmInstruction_t	*codeBase;
 
-	vm->codeBase = Hunk_Alloc( vm->codeLength*4, h_high );			// we're now int aligned
-//	memcpy( vm->codeBase, (byte *)header + header->codeOffset, vm->codeLength );
+	// one extra slot for the end of code marker
+	codeBase = Hunk_Alloc( ( header->instructionCount + 1 ) * sizeof( *codeBase ), h_high );
+	vm->codeBase = (byte *)codeBase;
 
-	// we don't need to translate the instructions, but we still need
-	// to find each instructions starting point for jumps
-	int_pc = byte_pc = 0;
-	instruction = 0;
+	byte_pc = 0;
 	code = (byte *)header + header->codeOffset;
-	codeBase = (int *)vm->codeBase;
 
-	// Copy and expand instructions to words while building instruction table
-	while ( instruction < header->instructionCount ) {
-		vm->instructionPointers[ instruction ] = int_pc;
-		instruction++;
+	for ( instruction = 0 ; instruction < header->instructionCount ; instruction++ ) {
+		// symbols and stack traces use instruction numbers as addresses
+		vm->instructionPointers[ instruction ] = instruction;
 
-		op = (int)code[ byte_pc ];
-		codeBase[int_pc] = op;
-		if(byte_pc > header->codeLength)
-			Com_Error(ERR_DROP, "VM_PrepareInterpreter: pc > header->codeLength");
+		if ( byte_pc >= header->codeLength )
+			Com_Error( ERR_DROP, "VM_PrepareInterpreter: pc > header->codeLength" );
 
+		op = (int)code[ byte_pc ];
 		byte_pc++;
-		int_pc++;
+
+		codeBase[ instruction ].op = op;
+		codeBase[ instruction ].value = 0;
 
 		// these are the only opcodes that aren't a single byte
 		switch ( op ) {
@@ -221,72 +360,37 @@ void VM_PrepareInterpreter( vm_t *vm, vmHeader_t *header ) {
 		case OP_GTF:
 		case OP_GEF:
 		case OP_BLOCK_COPY:
-			codeBase[int_pc] = loadWord(&code[byte_pc]);
+			if ( byte_pc + 4 > header->codeLength )
+				Com_Error( ERR_DROP, "VM_PrepareInterpreter: pc > header->codeLength" );
+
+			codeBase[ instruction ].value = loadWord( &code[ byte_pc ] );
 			byte_pc += 4;
-			int_pc++;
 			break;
 		case OP_ARG:
-			codeBase[int_pc] = (int)code[byte_pc];
+			if ( byte_pc + 1 > header->codeLength )
+				Com_Error( ERR_DROP, "VM_PrepareInterpreter: pc > header->codeLength" );
+
+			codeBase[ instruction ].value = (int)code[ byte_pc ];
 			byte_pc++;
-			int_pc++;
 			break;
 		default:
+			// the dispatch table only covers the known opcodes
+			if ( op > OP_CVFI )
+				Com_Error( ERR_DROP, "VM_PrepareInterpreter: bad opcode %i at instruction %i", op, instruction );
 			break;
 		}
 
+		if ( op >= OP_EQ && op <= OP_GEF ) {
+			if ( codeBase[ instruction ].value < 0 || codeBase[ instruction ].value > header->instructionCount )
+				Com_Error( ERR_DROP, "VM_PrepareInterpreter: Jump to invalid instruction number" );
+		}
 	}
-	int_pc = 0;
-	instruction = 0;
-	
-	// Now that the code has been expanded to int-sized opcodes, we'll translate instruction index
-	//into an index into codeBase[], which contains opcodes and operands.
-	while ( instruction < header->instructionCount ) {
-		op = codeBase[ int_pc ];
-		instruction++;
-		int_pc++;
-		
-		switch ( op ) {
-		// These ops need to translate addresses in jumps from instruction index to int index
-		case OP_EQ:
-		case OP_NE:
-		case OP_LTI:
-		case OP_LEI:
-		case OP_GTI:
-		case OP_GEI:
-		case OP_LTU:
-		case OP_LEU:
-		case OP_GTU:
-		case OP_GEU:
-		case OP_EQF:
-		case OP_NEF:
-		case OP_LTF:
-		case OP_LEF:
-		case OP_GTF:
-		case OP_GEF:
-			if(codeBase[int_pc] < 0 || codeBase[int_pc] > vm->instructionCount)
-				Com_Error(ERR_DROP, "VM_PrepareInterpreter: Jump to invalid instruction number");
-
-			// codeBase[pc] is the instruction index. Convert that into an offset into
-			//the int-aligned codeBase[] by the lookup table.
-			codeBase[int_pc] = vm->instructionPointers[codeBase[int_pc]];
-			int_pc++;
-			break;
-
-		// These opcodes have an operand that isn't an instruction index
-		case OP_ENTER:
-		case OP_CONST:
-		case OP_LOCAL:
-		case OP_LEAVE:
-		case OP_BLOCK_COPY:
-		case OP_ARG:
-			int_pc++;
-			break;
 
-		default:
-			break;
-		}
+	// a branch to the end or falling off it lands here
+	codeBase[ header->instructionCount ].op = OPX_END;
+	codeBase[ header->instructionCount ].value = 0;
 
-	}
+	VM_FuseInstructions( codeBase, header->instructionCount );
 }
 
 /*
@@ -315,6 +419,32 @@ locals from sp
 
 #define	DEBUGSTR va("%s%i", VM_Indent(vm), opStackOfs)
 
+// gcc and clang can jump straight from one handler to the next through
+// a table of label addresses, instead of going back through the switch
+#if defined(__GNUC__) && !defined(DEBUG_VM)
+#define USE_COMPUTED_GOTO
+#endif
+
+#ifdef USE_COMPUTED_GOTO
+#define CASE(x)		case x: label_##x
+#define DISPATCH2() \
+	do { \
+		opcode = code[ programCounter ].op; \
+		r2 = code[ programCounter++ ].value; \
+		goto *dispatchTable[ opcode ]; \
+	} while ( 0 )
+#define DISPATCH() \
+	do { \
+		r0 = opStack[opStackOfs]; \
+		r1 = opStack[(uint8_t) (opStackOfs - 1)]; \
+		DISPATCH2(); \
+	} while ( 0 )
+#else
+#define CASE(x)		case x
+#define DISPATCH2()	goto nextInstruction2
+#define DISPATCH()	goto nextInstruction
+#endif
+
 int	VM_CallInterpreted( vm_t *vm, int *args ) {
 	byte		stack[OPSTACK_SIZE + 15];
 	int		*opStack;
@@ -323,13 +453,100 @@ int	VM_CallInterpreted( vm_t *vm, int *args ) {
 	int		programStack;
 	int		stackOnEntry;
 	byte	*image;
-	int		*codeImage;
+	vmInstruction_t	*code;
+	int		instructionCount;
 	int		v1;
 	int		dataMask;
 	int		arg;
+	int		opcode, r0, r1, r2;
 #ifdef DEBUG_VM
 	vmSymbol_t	*profileSymbol;
 #endif
+#ifdef USE_COMPUTED_GOTO
+	static const void * const dispatchTable[OPX_MAX] = {
+		[OP_UNDEF] = &&label_OP_UNDEF,
+		[OP_IGNORE] = &&label_OP_IGNORE,
+		[OP_BREAK] = &&label_OP_BREAK,
+		[OP_ENTER] = &&label_OP_ENTER,
+		[OP_LEAVE] = &&label_OP_LEAVE,
+		[OP_CALL] = &&label_OP_CALL,
+		[OP_PUSH] = &&label_OP_PUSH,
+		[OP_POP] = &&label_OP_POP,
+		[OP_CONST] = &&label_OP_CONST,
+		[OP_LOCAL] = &&label_OP_LOCAL,
+		[OP_JUMP] = &&label_OP_JUMP,
+		[OP_EQ] = &&label_OP_EQ,
+		[OP_NE] = &&label_OP_NE,
+		[OP_LTI] = &&label_OP_LTI,
+		[OP_LEI] = &&label_OP_LEI,
+		[OP_GTI] = &&label_OP_GTI,
+		[OP_GEI] = &&label_OP_GEI,
+		[OP_LTU] = &&label_OP_LTU,
+		[OP_LEU] = &&label_OP_LEU,
+		[OP_GTU] = &&label_OP_GTU,
+		[OP_GEU] = &&label_OP_GEU,
+		[OP_EQF] = &&label_OP_EQF,
+		[OP_NEF] = &&label_OP_NEF,
+		[OP_LTF] = &&label_OP_LTF,
+		[OP_LEF] = &&label_OP_LEF,
+		[OP_GTF] = &&label_OP_GTF,
+		[OP_GEF] = &&label_OP_GEF,
+		[OP_LOAD1] = &&label_OP_LOAD1,
+		[OP_LOAD2] = &&label_OP_LOAD2,
+		[OP_LOAD4] = &&label_OP_LOAD4,
+		[OP_STORE1] = &&label_OP_STORE1,
+		[OP_STORE2] = &&label_OP_STORE2,
+		[OP_STORE4] = &&label_OP_STORE4,
+		[OP_ARG] = &&label_OP_ARG,
+		[OP_BLOCK_COPY] = &&label_OP_BLOCK_COPY,
+		[OP_SEX8] = &&label_OP_SEX8,
+		[OP_SEX16] = &&label_OP_SEX16,
+		[OP_NEGI] = &&label_OP_NEGI,
+		[OP_ADD] = &&label_OP_ADD,
+		[OP_SUB] = &&label_OP_SUB,
+		[OP_DIVI] = &&label_OP_DIVI,
+		[OP_DIVU] = &&label_OP_DIVU,
+		[OP_MODI] = &&label_OP_MODI,
+		[OP_MODU] = &&label_OP_MODU,
+		[OP_MULI] = &&label_OP_MULI,
+		[OP_MULU] = &&label_OP_MULU,
+		[OP_BAND] = &&label_OP_BAND,
+		[OP_BOR] = &&label_OP_BOR,
+		[OP_BXOR] = &&label_OP_BXOR,
+		[OP_BCOM] = &&label_OP_BCOM,
+		[OP_LSH] = &&label_OP_LSH,
+		[OP_RSHI] = &&label_OP_RSHI,
+		[OP_RSHU] = &&label_OP_RSHU,
+		[OP_NEGF] = &&label_OP_NEGF,
+		[OP_ADDF] = &&label_OP_ADDF,
+		[OP_SUBF] = &&label_OP_SUBF,
+		[OP_DIVF] = &&label_OP_DIVF,
+		[OP_MULF] = &&label_OP_MULF,
+		[OP_CVIF] = &&label_OP_CVIF,
+		[OP_CVFI] = &&label_OP_CVFI,
+		[OPX_LOCAL_LOAD4] = &&label_OPX_LOCAL_LOAD4,
+		[OPX_CONST_LOAD4] = &&label_OPX_CONST_LOAD4,
+		[OPX_CONST_ADD] = &&label_OPX_CONST_ADD,
+		[OPX_CONST_SUB] = &&label_OPX_CONST_SUB,
+		[OPX_CONST_MULI] = &&label_OPX_CONST_MULI,
+		[OPX_CONST_BAND] = &&label_OPX_CONST_BAND,
+		[OPX_CONST_LSH] = &&label_OPX_CONST_LSH,
+		[OPX_CONST_EQ] = &&label_OPX_CONST_EQ,
+		[OPX_CONST_NE] = &&label_OPX_CONST_NE,
+		[OPX_CONST_LTI] = &&label_OPX_CONST_LTI,
+		[OPX_CONST_LEI] = &&label_OPX_CONST_LEI,
+		[OPX_CONST_GTI] = &&label_OPX_CONST_GTI,
+		[OPX_CONST_GEI] = &&label_OPX_CONST_GEI,
+		[OPX_CONST_LTU] = &&label_OPX_CONST_LTU,
+		[OPX_CONST_LEU] = &&label_OPX_CONST_LEU,
+		[OPX_CONST_GTU] = &&label_OPX_CONST_GTU,
+		[OPX_CONST_GEU] = &&label_OPX_CONST_GEU,
+		[OPX_CONST_CALL] = &&label_OPX_CONST_CALL,
+		[OPX_CONST_JUMP] = &&label_OPX_CONST_JUMP,
+		[OPX_LOCAL_CONST_STORE4] = &&label_OPX_LOCAL_CONST_STORE4,
+		[OPX_END] = &&label_OPX_END
+	};
+#endif
 
 	// interpret the code
 	vm->currentlyInterpreting = qtrue;
@@ -345,7 +562,8 @@ int	VM_CallInterpreted( vm_t *vm, int *args ) {
 	// set up the stack frame 
 
 	image = vm->dataBase;
-	codeImage = (int *)vm->codeBase;
+	code = (vmInstruction_t *)vm->codeBase;
+	instructionCount = vm->instructionCount;
 	dataMask = vm->dataMask;
 	
 	programCounter = 0;
@@ -371,521 +589,563 @@ int	VM_CallInterpreted( vm_t *vm, int *args ) {
 	// main interpreter loop, will exit when a LEAVE instruction
 	// grabs the -1 program counter
 
-#define r2 codeImage[programCounter]
-
-	while ( 1 ) {
-		int		opcode,	r0, r1;
-//		unsigned int	r2;
-
+	// r0 and r1 cache the top two opStack entries, handlers that leave
+	// them valid continue with DISPATCH2(), the others with DISPATCH()
+#ifdef USE_COMPUTED_GOTO
+	DISPATCH();
+#else
 nextInstruction:
-		r0 = opStack[opStackOfs];
-		r1 = opStack[(uint8_t) (opStackOfs - 1)];
+	r0 = opStack[opStackOfs];
+	r1 = opStack[(uint8_t) (opStackOfs - 1)];
 nextInstruction2:
 #ifdef DEBUG_VM
-		if ( (unsigned)programCounter >= vm->codeLength ) {
-			Com_Error( ERR_DROP, "VM pc out of range" );
-			return 0;
-		}
-
-		if ( programStack <= vm->stackBottom ) {
-			Com_Error( ERR_DROP, "VM stack overflow" );
-			return 0;
-		}
+	if ( (unsigned)programCounter > instructionCount ) {
+		Com_Error( ERR_DROP, "VM pc out of range" );
+		return 0;
+	}
 
-		if ( programStack & 3 ) {
-			Com_Error( ERR_DROP, "VM program stack misaligned" );
-			return 0;
-		}
+	if ( programStack <= vm->stackBottom ) {
+		Com_Error( ERR_DROP, "VM stack overflow" );
+		return 0;
+	}
 
-		if ( vm_debugLevel > 1 ) {
-			Com_Printf( "%s %s\n", DEBUGSTR, opnames[opcode] );
-		}
-		profileSymbol->profileCount++;
+	if ( programStack & 3 ) {
+		Com_Error( ERR_DROP, "VM program stack misaligned" );
+		return 0;
+	}
 #endif
-		opcode = codeImage[ programCounter++ ];
-
-		switch ( opcode ) {
+	opcode = code[ programCounter ].op;
+	r2 = code[ programCounter++ ].value;
 #ifdef DEBUG_VM
-		default:
-			Com_Error( ERR_DROP, "Bad VM instruction" );  // this should be scanned on load!
-			return 0;
+	if ( vm_debugLevel > 1 ) {
+		Com_Printf( "%s %s\n", DEBUGSTR, opnames[opcode] );
+	}
+	profileSymbol->profileCount++;
+#endif
 #endif
-		case OP_BREAK:
-			vm->breakCount++;
-			goto nextInstruction2;
-		case OP_CONST:
-			opStackOfs++;
-			r1 = r0;
-			r0 = opStack[opStackOfs] = r2;
-			
-			programCounter += 1;
-			goto nextInstruction2;
-		case OP_LOCAL:
-			opStackOfs++;
-			r1 = r0;
-			r0 = opStack[opStackOfs] = r2+programStack;
-
-			programCounter += 1;
-			goto nextInstruction2;
 
-		case OP_LOAD4:
+	switch ( opcode ) {
+	default:
+	CASE(OPX_END):
+		Com_Error( ERR_DROP, "VM program counter out of range" );
+		return 0;
+
+	CASE(OP_UNDEF):
+	CASE(OP_IGNORE):
+		DISPATCH2();
+	CASE(OP_BREAK):
+		vm->breakCount++;
+		DISPATCH2();
+	CASE(OP_CONST):
+		opStackOfs++;
+		r1 = r0;
+		r0 = opStack[opStackOfs] = r2;
+		DISPATCH2();
+	CASE(OP_LOCAL):
+		opStackOfs++;
+		r1 = r0;
+		r0 = opStack[opStackOfs] = r2+programStack;
+		DISPATCH2();
+
+	CASE(OP_LOAD4):
 #ifdef DEBUG_VM
-			if(opStack[opStackOfs] & 3)
-			{
-				Com_Error( ERR_DROP, "OP_LOAD4 misaligned" );
-				return 0;
-			}
+		if(opStack[opStackOfs] & 3)
+		{
+			Com_Error( ERR_DROP, "OP_LOAD4 misaligned" );
+			return 0;
+		}
 #endif
-			r0 = opStack[opStackOfs] = *(int *) &image[ r0 & dataMask ];
-			goto nextInstruction2;
-		case OP_LOAD2:
-			r0 = opStack[opStackOfs] = *(unsigned short *)&image[ r0 & dataMask ];
-			goto nextInstruction2;
-		case OP_LOAD1:
-			r0 = opStack[opStackOfs] = image[ r0 & dataMask ];
-			goto nextInstruction2;
-
-		case OP_STORE4:
-			*(int *)&image[ r1 & dataMask ] = r0;
-			opStackOfs -= 2;
-			goto nextInstruction;
-		case OP_STORE2:
-			*(short *)&image[ r1 & dataMask ] = r0;
-			opStackOfs -= 2;
-			goto nextInstruction;
-		case OP_STORE1:
-			image[ r1 & dataMask ] = r0;
-			opStackOfs -= 2;
-			goto nextInstruction;
-
-		case OP_ARG:
-			// single byte offset from programStack
-			*(int *)&image[ (codeImage[programCounter] + programStack) & dataMask ] = r0;
-			opStackOfs--;
-			programCounter += 1;
-			goto nextInstruction;
-
-		case OP_BLOCK_COPY:
-			VM_BlockCopy(r1, r0, r2);
-			programCounter += 1;
-			opStackOfs -= 2;
-			goto nextInstruction;
-
-		case OP_CALL:
-			// save current program counter
-			*(int *)&image[ programStack ] = programCounter;
-			
-			// jump to the location on the stack
-			programCounter = r0;
-			opStackOfs--;
-			if ( programCounter < 0 ) {
-				// system call
-				int		r;
-//				int		temp;
+		r0 = opStack[opStackOfs] = *(int *) &image[ r0 & dataMask ];
+		DISPATCH2();
+	CASE(OP_LOAD2):
+		r0 = opStack[opStackOfs] = *(unsigned short *)&image[ r0 & dataMask ];
+		DISPATCH2();
+	CASE(OP_LOAD1):
+		r0 = opStack[opStackOfs] = image[ r0 & dataMask ];
+		DISPATCH2();
+
+	CASE(OP_STORE4):
+		*(int *)&image[ r1 & dataMask ] = r0;
+		opStackOfs -= 2;
+		DISPATCH();
+	CASE(OP_STORE2):
+		*(short *)&image[ r1 & dataMask ] = r0;
+		opStackOfs -= 2;
+		DISPATCH();
+	CASE(OP_STORE1):
+		image[ r1 & dataMask ] = r0;
+		opStackOfs -= 2;
+		DISPATCH();
+
+	CASE(OP_ARG):
+		// single byte offset from programStack
+		*(int *)&image[ (r2 + programStack) & dataMask ] = r0;
+		opStackOfs--;
+		DISPATCH();
+
+	CASE(OP_BLOCK_COPY):
+		VM_BlockCopy(r1, r0, r2);
+		opStackOfs -= 2;
+		DISPATCH();
+
+	CASE(OPX_CONST_CALL):
+		// skip the OP_CALL, the constant was never pushed
+		programCounter++;
+		v1 = r2;
+		goto doCall;
+	CASE(OP_CALL):
+		v1 = r0;
+		opStackOfs--;
+doCall:
+		// save current program counter
+		*(int *)&image[ programStack ] = programCounter;
+		
+		// jump to the location on the stack
+		programCounter = v1;
+		if ( programCounter < 0 ) {
+			// system call
+			int		r;
+//			int		temp;
 #ifdef DEBUG_VM
-				int		stomped;
+			int		stomped;
 
-				if ( vm_debugLevel ) {
-					Com_Printf( "%s---> systemcall(%i)\n", DEBUGSTR, -1 - programCounter );
-				}
+			if ( vm_debugLevel ) {
+				Com_Printf( "%s---> systemcall(%i)\n", DEBUGSTR, -1 - programCounter );
+			}
 #endif
-				// save the stack to allow recursive VM entry
-//				temp = vm->callLevel;
-				vm->programStack = programStack - 4;
+			// save the stack to allow recursive VM entry
+//			temp = vm->callLevel;
+			vm->programStack = programStack - 4;
 #ifdef DEBUG_VM
-				stomped = *(int *)&image[ programStack + 4 ];
+			stomped = *(int *)&image[ programStack + 4 ];
 #endif
-				*(int *)&image[ programStack + 4 ] = -1 - programCounter;
+			*(int *)&image[ programStack + 4 ] = -1 - programCounter;
 
 //VM_LogSyscalls( (int *)&image[ programStack + 4 ] );
-				{
-					// the vm has ints on the stack, we expect
-					// pointers so we might have to convert it
-					if (sizeof(intptr_t) != sizeof(int)) {
-						intptr_t argarr[ MAX_VMSYSCALL_ARGS ];
-						int *imagePtr = (int *)&image[ programStack ];
-						int i;
-						for (i = 0; i < ARRAY_LEN(argarr); ++i) {
-							argarr[i] = *(++imagePtr);
-						}
-						r = vm->systemCall( argarr );
-					} else {
-						intptr_t* argptr = (intptr_t *)&image[ programStack + 4 ];
-						r = vm->systemCall( argptr );
+			{
+				// the vm has ints on the stack, we expect
+				// pointers so we might have to convert it
+				if (sizeof(intptr_t) != sizeof(int)) {
+					intptr_t argarr[ MAX_VMSYSCALL_ARGS ];
+					int *imagePtr = (int *)&image[ programStack ];
+					int i;
+					for (i = 0; i < ARRAY_LEN(argarr); ++i) {
+						argarr[i] = *(++imagePtr);
 					}
+					r = vm->systemCall( argarr );
+				} else {
+					intptr_t* argptr = (intptr_t *)&image[ programStack + 4 ];
+					r = vm->systemCall( argptr );
 				}
+			}
 
 #ifdef DEBUG_VM
-				// this is just our stack frame pointer, only needed
-				// for debugging
-				*(int *)&image[ programStack + 4 ] = stomped;
+			// this is just our stack frame pointer, only needed
+			// for debugging
+			*(int *)&image[ programStack + 4 ] = stomped;
 #endif
 
-				// save return value
-				opStackOfs++;
-				opStack[opStackOfs] = r;
-				programCounter = *(int *)&image[ programStack ];
-//				vm->callLevel = temp;
+			// save return value
+			opStackOfs++;
+			opStack[opStackOfs] = r;
+			programCounter = *(int *)&image[ programStack ];
+//			vm->callLevel = temp;
 #ifdef DEBUG_VM
-				if ( vm_debugLevel ) {
-					Com_Printf( "%s<--- %s\n", DEBUGSTR, VM_ValueToSymbol( vm, programCounter ) );
-				}
-#endif
-			} else if ( (unsigned)programCounter >= vm->instructionCount ) {
-				Com_Error( ERR_DROP, "VM program counter out of range in OP_CALL" );
-				return 0;
-			} else {
-				programCounter = vm->instructionPointers[ programCounter ];
+			if ( vm_debugLevel ) {
+				Com_Printf( "%s<--- %s\n", DEBUGSTR, VM_ValueToSymbol( vm, programCounter ) );
 			}
-			goto nextInstruction;
+#endif
+		} else if ( (unsigned)programCounter >= instructionCount ) {
+			Com_Error( ERR_DROP, "VM program counter out of range in OP_CALL" );
+			return 0;
+		}
+		DISPATCH();
 
-		// push and pop are only needed for discarded or bad function return values
-		case OP_PUSH:
-			opStackOfs++;
-			goto nextInstruction;
-		case OP_POP:
-			opStackOfs--;
-			goto nextInstruction;
+	// push and pop are only needed for discarded or bad function return values
+	CASE(OP_PUSH):
+		opStackOfs++;
+		DISPATCH();
+	CASE(OP_POP):
+		opStackOfs--;
+		DISPATCH();
 
-		case OP_ENTER:
+	CASE(OP_ENTER):
 #ifdef DEBUG_VM
-			profileSymbol = VM_ValueToFunctionSymbol( vm, programCounter );
+		profileSymbol = VM_ValueToFunctionSymbol( vm, programCounter );
 #endif
-			// get size of stack frame
-			v1 = r2;
+		if ( vm == vm_profiled ) {
+			VM_ProfileCall( vm, programStack, programCounter - 1 );
+		}
+		// get size of stack frame
+		v1 = r2;
 
-			programCounter += 1;
-			programStack -= v1;
+		programStack -= v1;
 #ifdef DEBUG_VM
-			// save old stack frame for debugging traces
-			*(int *)&image[programStack+4] = programStack + v1;
-			if ( vm_debugLevel ) {
-				Com_Printf( "%s---> %s\n", DEBUGSTR, VM_ValueToSymbol( vm, programCounter - 5 ) );
-				if ( vm->breakFunction && programCounter - 5 == vm->breakFunction ) {
-					// this is to allow setting breakpoints here in the debugger
-					vm->breakCount++;
-//					vm_debugLevel = 2;
-//					VM_StackTrace( vm, programCounter, programStack );
-				}
-//				vm->callLevel++;
+		// save old stack frame for debugging traces
+		*(int *)&image[programStack+4] = programStack + v1;
+		if ( vm_debugLevel ) {
+			Com_Printf( "%s---> %s\n", DEBUGSTR, VM_ValueToSymbol( vm, programCounter - 1 ) );
+			if ( vm->breakFunction && programCounter - 1 == vm->breakFunction ) {
+				// this is to allow setting breakpoints here in the debugger
+				vm->breakCount++;
+//				vm_debugLevel = 2;
+//				VM_StackTrace( vm, programCounter, programStack );
 			}
+//			vm->callLevel++;
+		}
 #endif
-			goto nextInstruction;
-		case OP_LEAVE:
-			// remove our stack frame
-			v1 = r2;
+		DISPATCH2();
+	CASE(OP_LEAVE):
+		if ( vm == vm_profiled ) {
+			VM_ProfileReturn( vm, programStack, programCounter - 1 );
+		}
+		// remove our stack frame
+		v1 = r2;
 
-			programStack += v1;
+		programStack += v1;
 
-			// grab the saved program counter
-			programCounter = *(int *)&image[ programStack ];
+		// grab the saved program counter
+		programCounter = *(int *)&image[ programStack ];
 #ifdef DEBUG_VM
-			profileSymbol = VM_ValueToFunctionSymbol( vm, programCounter );
-			if ( vm_debugLevel ) {
-//				vm->callLevel--;
-				Com_Printf( "%s<--- %s\n", DEBUGSTR, VM_ValueToSymbol( vm, programCounter ) );
-			}
+		profileSymbol = VM_ValueToFunctionSymbol( vm, programCounter );
+		if ( vm_debugLevel ) {
+//			vm->callLevel--;
+			Com_Printf( "%s<--- %s\n", DEBUGSTR, VM_ValueToSymbol( vm, programCounter ) );
+		}
 #endif
-			// check for leaving the VM
-			if ( programCounter == -1 ) {
-				goto done;
-			} else if ( (unsigned)programCounter >= vm->codeLength ) {
-				Com_Error( ERR_DROP, "VM program counter out of range in OP_LEAVE" );
-				return 0;
-			}
-			goto nextInstruction;
-
-		/*
-		===================================================================
-		BRANCHES
-		===================================================================
-		*/
-
-		case OP_JUMP:
-			if ( (unsigned)r0 >= vm->instructionCount )
-			{
-				Com_Error( ERR_DROP, "VM program counter out of range in OP_JUMP" );
-				return 0;
-			}
-
-			programCounter = vm->instructionPointers[ r0 ];
-
-			opStackOfs--;
-			goto nextInstruction;
-
-		case OP_EQ:
-			opStackOfs -= 2;
-			if ( r1 == r0 ) {
-				programCounter = r2;	//vm->instructionPointers[r2];
-				goto nextInstruction;
-			} else {
-				programCounter += 1;
-				goto nextInstruction;
-			}
-
-		case OP_NE:
-			opStackOfs -= 2;
-			if ( r1 != r0 ) {
-				programCounter = r2;	//vm->instructionPointers[r2];
-				goto nextInstruction;
-			} else {
-				programCounter += 1;
-				goto nextInstruction;
-			}
-
-		case OP_LTI:
-			opStackOfs -= 2;
-			if ( r1 < r0 ) {
-				programCounter = r2;	//vm->instructionPointers[r2];
-				goto nextInstruction;
-			} else {
-				programCounter += 1;
-				goto nextInstruction;
-			}
-
-		case OP_LEI:
-			opStackOfs -= 2;
-			if ( r1 <= r0 ) {
-				programCounter = r2;	//vm->instructionPointers[r2];
-				goto nextInstruction;
-			} else {
-				programCounter += 1;
-				goto nextInstruction;
-			}
-
-		case OP_GTI:
-			opStackOfs -= 2;
-			if ( r1 > r0 ) {
-				programCounter = r2;	//vm->instructionPointers[r2];
-				goto nextInstruction;
-			} else {
-				programCounter += 1;
-				goto nextInstruction;
-			}
+		// check for leaving the VM
+		if ( programCounter == -1 ) {
+			goto done;
+		} else if ( (unsigned)programCounter >= instructionCount ) {
+			Com_Error( ERR_DROP, "VM program counter out of range in OP_LEAVE" );
+			return 0;
+		}
+		DISPATCH();
+
+	/*
+	===================================================================
+	BRANCHES
+	===================================================================
+	*/
+
+	CASE(OP_JUMP):
+		if ( (unsigned)r0 >= instructionCount )
+		{
+			Com_Error( ERR_DROP, "VM program counter out of range in OP_JUMP" );
+			return 0;
+		}
 
-		case OP_GEI:
-			opStackOfs -= 2;
-			if ( r1 >= r0 ) {
-				programCounter = r2;	//vm->instructionPointers[r2];
-				goto nextInstruction;
-			} else {
-				programCounter += 1;
-				goto nextInstruction;
-			}
+		programCounter = r0;
 
-		case OP_LTU:
-			opStackOfs -= 2;
-			if ( ((unsigned)r1) < ((unsigned)r0) ) {
-				programCounter = r2;	//vm->instructionPointers[r2];
-				goto nextInstruction;
-			} else {
-				programCounter += 1;
-				goto nextInstruction;
-			}
+		opStackOfs--;
+		DISPATCH();
 
-		case OP_LEU:
-			opStackOfs -= 2;
-			if ( ((unsigned)r1) <= ((unsigned)r0) ) {
-				programCounter = r2;	//vm->instructionPointers[r2];
-				goto nextInstruction;
-			} else {
-				programCounter += 1;
-				goto nextInstruction;
-			}
+	CASE(OP_EQ):
+		opStackOfs -= 2;
+		if ( r1 == r0 ) {
+			programCounter = r2;
+		}
+		DISPATCH();
 
-		case OP_GTU:
-			opStackOfs -= 2;
-			if ( ((unsigned)r1) > ((unsigned)r0) ) {
-				programCounter = r2;	//vm->instructionPointers[r2];
-				goto nextInstruction;
-			} else {
-				programCounter += 1;
-				goto nextInstruction;
-			}
+	CASE(OP_NE):
+		opStackOfs -= 2;
+		if ( r1 != r0 ) {
+			programCounter = r2;
+		}
+		DISPATCH();
 
-		case OP_GEU:
-			opStackOfs -= 2;
-			if ( ((unsigned)r1) >= ((unsigned)r0) ) {
-				programCounter = r2;	//vm->instructionPointers[r2];
-				goto nextInstruction;
-			} else {
-				programCounter += 1;
-				goto nextInstruction;
-			}
+	CASE(OP_LTI):
+		opStackOfs -= 2;
+		if ( r1 < r0 ) {
+			programCounter = r2;
+		}
+		DISPATCH();
 
-		case OP_EQF:
-			opStackOfs -= 2;
-			
-			if(((float *) opStack)[(uint8_t) (opStackOfs + 1)] == ((float *) opStack)[(uint8_t) (opStackOfs + 2)])
-			{
-				programCounter = r2;	//vm->instructionPointers[r2];
-				goto nextInstruction;
-			} else {
-				programCounter += 1;
-				goto nextInstruction;
-			}
+	CASE(OP_LEI):
+		opStackOfs -= 2;
+		if ( r1 <= r0 ) {
+			programCounter = r2;
+		}
+		DISPATCH();
 
-		case OP_NEF:
-			opStackOfs -= 2;
+	CASE(OP_GTI):
+		opStackOfs -= 2;
+		if ( r1 > r0 ) {
+			programCounter = r2;
+		}
+		DISPATCH();
 
-			if(((float *) opStack)[(uint8_t) (opStackOfs + 1)] != ((float *) opStack)[(uint8_t) (opStackOfs + 2)])
-			{
-				programCounter = r2;	//vm->instructionPointers[r2];
-				goto nextInstruction;
-			} else {
-				programCounter += 1;
-				goto nextInstruction;
-			}
+	CASE(OP_GEI):
+		opStackOfs -= 2;
+		if ( r1 >= r0 ) {
+			programCounter = r2;
+		}
+		DISPATCH();
 
-		case OP_LTF:
-			opStackOfs -= 2;
+	CASE(OP_LTU):
+		opStackOfs -= 2;
+		if ( ((unsigned)r1) < ((unsigned)r0) ) {
+			programCounter = r2;
+		}
+		DISPATCH();
 
-			if(((float *) opStack)[(uint8_t) (opStackOfs + 1)] < ((float *) opStack)[(uint8_t) (opStackOfs + 2)])
-			{
-				programCounter = r2;	//vm->instructionPointers[r2];
-				goto nextInstruction;
-			} else {
-				programCounter += 1;
-				goto nextInstruction;
-			}
+	CASE(OP_LEU):
+		opStackOfs -= 2;
+		if ( ((unsigned)r1) <= ((unsigned)r0) ) {
+			programCounter = r2;
+		}
+		DISPATCH();
 
-		case OP_LEF:
-			opStackOfs -= 2;
+	CASE(OP_GTU):
+		opStackOfs -= 2;
+		if ( ((unsigned)r1) > ((unsigned)r0) ) {
+			programCounter = r2;
+		}
+		DISPATCH();
 
-			if(((float *) opStack)[(uint8_t) ((uint8_t) (opStackOfs + 1))] <= ((float *) opStack)[(uint8_t) ((uint8_t) (opStackOfs + 2))])
-			{
-				programCounter = r2;	//vm->instructionPointers[r2];
-				goto nextInstruction;
-			} else {
-				programCounter += 1;
-				goto nextInstruction;
-			}
+	CASE(OP_GEU):
+		opStackOfs -= 2;
+		if ( ((unsigned)r1) >= ((unsigned)r0) ) {
+			programCounter = r2;
+		}
+		DISPATCH();
 
-		case OP_GTF:
-			opStackOfs -= 2;
+	CASE(OP_EQF):
+		opStackOfs -= 2;
+		if(((float *) opStack)[(uint8_t) (opStackOfs + 1)] == ((float *) opStack)[(uint8_t) (opStackOfs + 2)]) {
+			programCounter = r2;
+		}
+		DISPATCH();
 
-			if(((float *) opStack)[(uint8_t) (opStackOfs + 1)] > ((float *) opStack)[(uint8_t) (opStackOfs + 2)])
-			{
-				programCounter = r2;	//vm->instructionPointers[r2];
-				goto nextInstruction;
-			} else {
-				programCounter += 1;
-				goto nextInstruction;
-			}
+	CASE(OP_NEF):
+		opStackOfs -= 2;
+		if(((float *) opStack)[(uint8_t) (opStackOfs + 1)] != ((float *) opStack)[(uint8_t) (opStackOfs + 2)]) {
+			programCounter = r2;
+		}
+		DISPATCH();
 
-		case OP_GEF:
-			opStackOfs -= 2;
+	CASE(OP_LTF):
+		opStackOfs -= 2;
+		if(((float *) opStack)[(uint8_t) (opStackOfs + 1)] < ((float *) opStack)[(uint8_t) (opStackOfs + 2)]) {
+			programCounter = r2;
+		}
+		DISPATCH();
 
-			if(((float *) opStack)[(uint8_t) (opStackOfs + 1)] >= ((float *) opStack)[(uint8_t) (opStackOfs + 2)])
-			{
-				programCounter = r2;	//vm->instructionPointers[r2];
-				goto nextInstruction;
-			} else {
-				programCounter += 1;
-				goto nextInstruction;
-			}
+	CASE(OP_LEF):
+		opStackOfs -= 2;
+		if(((float *) opStack)[(uint8_t) (opStackOfs + 1)] <= ((float *) opStack)[(uint8_t) (opStackOfs + 2)]) {
+			programCounter = r2;
+		}
+		DISPATCH();
 
+	CASE(OP_GTF):
+		opStackOfs -= 2;
+		if(((float *) opStack)[(uint8_t) (opStackOfs + 1)] > ((float *) opStack)[(uint8_t) (opStackOfs + 2)]) {
+			programCounter = r2;
+		}
+		DISPATCH();
 
-		//===================================================================
-
-		case OP_NEGI:
-			opStack[opStackOfs] = -r0;
-			goto nextInstruction;
-		case OP_ADD:
-			opStackOfs--;
-			opStack[opStackOfs] = r1 + r0;
-			goto nextInstruction;
-		case OP_SUB:
-			opStackOfs--;
-			opStack[opStackOfs] = r1 - r0;
-			goto nextInstruction;
-		case OP_DIVI:
-			opStackOfs--;
-			opStack[opStackOfs] = r1 / r0;
-			goto nextInstruction;
-		case OP_DIVU:
-			opStackOfs--;
-			opStack[opStackOfs] = ((unsigned) r1) / ((unsigned) r0);
-			goto nextInstruction;
-		case OP_MODI:
-			opStackOfs--;
-			opStack[opStackOfs] = r1 % r0;
-			goto nextInstruction;
-		case OP_MODU:
-			opStackOfs--;
-			opStack[opStackOfs] = ((unsigned) r1) % ((unsigned) r0);
-			goto nextInstruction;
-		case OP_MULI:
-			opStackOfs--;
-			opStack[opStackOfs] = r1 * r0;
-			goto nextInstruction;
-		case OP_MULU:
-			opStackOfs--;
-			opStack[opStackOfs] = ((unsigned) r1) * ((unsigned) r0);
-			goto nextInstruction;
-
-		case OP_BAND:
-			opStackOfs--;
-			opStack[opStackOfs] = ((unsigned) r1) & ((unsigned) r0);
-			goto nextInstruction;
-		case OP_BOR:
-			opStackOfs--;
-			opStack[opStackOfs] = ((unsigned) r1) | ((unsigned) r0);
-			goto nextInstruction;
-		case OP_BXOR:
-			opStackOfs--;
-			opStack[opStackOfs] = ((unsigned) r1) ^ ((unsigned) r0);
-			goto nextInstruction;
-		case OP_BCOM:
-			opStack[opStackOfs] = ~((unsigned) r0);
-			goto nextInstruction;
-
-		case OP_LSH:
-			opStackOfs--;
-			opStack[opStackOfs] = r1 << r0;
-			goto nextInstruction;
-		case OP_RSHI:
-			opStackOfs--;
-			opStack[opStackOfs] = r1 >> r0;
-			goto nextInstruction;
-		case OP_RSHU:
-			opStackOfs--;
-			opStack[opStackOfs] = ((unsigned) r1) >> r0;
-			goto nextInstruction;
-
-		case OP_NEGF:
-			((float *) opStack)[opStackOfs] =  -((float *) opStack)[opStackOfs];
-			goto nextInstruction;
-		case OP_ADDF:
-			opStackOfs--;
-			((float *) opStack)[opStackOfs] = ((float *) opStack)[opStackOfs] + ((float *) opStack)[(uint8_t) (opStackOfs + 1)];
-			goto nextInstruction;
-		case OP_SUBF:
-			opStackOfs--;
-			((float *) opStack)[opStackOfs] = ((float *) opStack)[opStackOfs] - ((float *) opStack)[(uint8_t) (opStackOfs + 1)];
-			goto nextInstruction;
-		case OP_DIVF:
-			opStackOfs--;
-			((float *) opStack)[opStackOfs] = ((float *) opStack)[opStackOfs] / ((float *) opStack)[(uint8_t) (opStackOfs + 1)];
-			goto nextInstruction;
-		case OP_MULF:
-			opStackOfs--;
-			((float *) opStack)[opStackOfs] = ((float *) opStack)[opStackOfs] * ((float *) opStack)[(uint8_t) (opStackOfs + 1)];
-			goto nextInstruction;
-
-		case OP_CVIF:
-			((float *) opStack)[opStackOfs] = (float) opStack[opStackOfs];
-			goto nextInstruction;
-		case OP_CVFI:
-			opStack[opStackOfs] = Q_ftol(((float *) opStack)[opStackOfs]);
-			goto nextInstruction;
-		case OP_SEX8:
-			opStack[opStackOfs] = (signed char) opStack[opStackOfs];
-			goto nextInstruction;
-		case OP_SEX16:
-			opStack[opStackOfs] = (short) opStack[opStackOfs];
-			goto nextInstruction;
+	CASE(OP_GEF):
+		opStackOfs -= 2;
+		if(((float *) opStack)[(uint8_t) (opStackOfs + 1)] >= ((float *) opStack)[(uint8_t) (opStackOfs + 2)]) {
+			programCounter = r2;
 		}
+		DISPATCH();
+
+
+	//===================================================================
+
+	CASE(OP_NEGI):
+		opStack[opStackOfs] = -r0;
+		DISPATCH();
+	CASE(OP_ADD):
+		opStackOfs--;
+		opStack[opStackOfs] = r1 + r0;
+		DISPATCH();
+	CASE(OP_SUB):
+		opStackOfs--;
+		opStack[opStackOfs] = r1 - r0;
+		DISPATCH();
+	CASE(OP_DIVI):
+		opStackOfs--;
+		opStack[opStackOfs] = r1 / r0;
+		DISPATCH();
+	CASE(OP_DIVU):
+		opStackOfs--;
+		opStack[opStackOfs] = ((unsigned) r1) / ((unsigned) r0);
+		DISPATCH();
+	CASE(OP_MODI):
+		opStackOfs--;
+		opStack[opStackOfs] = r1 % r0;
+		DISPATCH();
+	CASE(OP_MODU):
+		opStackOfs--;
+		opStack[opStackOfs] = ((unsigned) r1) % ((unsigned) r0);
+		DISPATCH();
+	CASE(OP_MULI):
+		opStackOfs--;
+		opStack[opStackOfs] = r1 * r0;
+		DISPATCH();
+	CASE(OP_MULU):
+		opStackOfs--;
+		opStack[opStackOfs] = ((unsigned) r1) * ((unsigned) r0);
+		DISPATCH();
+
+	CASE(OP_BAND):
+		opStackOfs--;
+		opStack[opStackOfs] = ((unsigned) r1) & ((unsigned) r0);
+		DISPATCH();
+	CASE(OP_BOR):
+		opStackOfs--;
+		opStack[opStackOfs] = ((unsigned) r1) | ((unsigned) r0);
+		DISPATCH();
+	CASE(OP_BXOR):
+		opStackOfs--;
+		opStack[opStackOfs] = ((unsigned) r1) ^ ((unsigned) r0);
+		DISPATCH();
+	CASE(OP_BCOM):
+		opStack[opStackOfs] = ~((unsigned) r0);
+		DISPATCH();
+
+	CASE(OP_LSH):
+		opStackOfs--;
+		opStack[opStackOfs] = r1 << r0;
+		DISPATCH();
+	CASE(OP_RSHI):
+		opStackOfs--;
+		opStack[opStackOfs] = r1 >> r0;
+		DISPATCH();
+	CASE(OP_RSHU):
+		opStackOfs--;
+		opStack[opStackOfs] = ((unsigned) r1) >> r0;
+		DISPATCH();
+
+	CASE(OP_NEGF):
+		((float *) opStack)[opStackOfs] =  -((float *) opStack)[opStackOfs];
+		DISPATCH();
+	CASE(OP_ADDF):
+		opStackOfs--;
+		((float *) opStack)[opStackOfs] = ((float *) opStack)[opStackOfs] + ((float *) opStack)[(uint8_t) (opStackOfs + 1)];
+		DISPATCH();
+	CASE(OP_SUBF):
+		opStackOfs--;
+		((float *) opStack)[opStackOfs] = ((float *) opStack)[opStackOfs] - ((float *) opStack)[(uint8_t) (opStackOfs + 1)];
+		DISPATCH();
+	CASE(OP_DIVF):
+		opStackOfs--;
+		((float *) opStack)[opStackOfs] = ((float *) opStack)[opStackOfs] / ((float *) opStack)[(uint8_t) (opStackOfs + 1)];
+		DISPATCH();
+	CASE(OP_MULF):
+		opStackOfs--;
+		((float *) opStack)[opStackOfs] = ((float *) opStack)[opStackOfs] * ((float *) opStack)[(uint8_t) (opStackOfs + 1)];
+		DISPATCH();
+
+	CASE(OP_CVIF):
+		((float *) opStack)[opStackOfs] = (float) opStack[opStackOfs];
+		DISPATCH();
+	CASE(OP_CVFI):
+		opStack[opStackOfs] = Q_ftol(((float *) opStack)[opStackOfs]);
+		DISPATCH();
+	CASE(OP_SEX8):
+		opStack[opStackOfs] = (signed char) opStack[opStackOfs];
+		DISPATCH();
+	CASE(OP_SEX16):
+		opStack[opStackOfs] = (short) opStack[opStackOfs];
+		DISPATCH();
+
+	/*
+	===================================================================
+	SUPERINSTRUCTIONS
+
+	r2 is the operand of the first instruction, programCounter points
+	at the second one
+	===================================================================
+	*/
+
+	CASE(OPX_LOCAL_LOAD4):
+		programCounter++;
+		opStackOfs++;
+		r1 = r0;
+		r0 = opStack[opStackOfs] = *(int *)&image[ (r2 + programStack) & dataMask ];
+		DISPATCH2();
+	CASE(OPX_CONST_LOAD4):
+		programCounter++;
+		opStackOfs++;
+		r1 = r0;
+		r0 = opStack[opStackOfs] = *(int *)&image[ r2 & dataMask ];
+		DISPATCH2();
+
+	CASE(OPX_CONST_ADD):
+		programCounter++;
+		r0 = opStack[opStackOfs] = r0 + r2;
+		DISPATCH2();
+	CASE(OPX_CONST_SUB):
+		programCounter++;
+		r0 = opStack[opStackOfs] = r0 - r2;
+		DISPATCH2();
+	CASE(OPX_CONST_MULI):
+		programCounter++;
+		r0 = opStack[opStackOfs] = r0 * r2;
+		DISPATCH2();
+	CASE(OPX_CONST_BAND):
+		programCounter++;
+		r0 = opStack[opStackOfs] = ((unsigned) r0) & ((unsigned) r2);
+		DISPATCH2();
+	CASE(OPX_CONST_LSH):
+		programCounter++;
+		r0 = opStack[opStackOfs] = r0 << r2;
+		DISPATCH2();
+
+	CASE(OPX_CONST_EQ):
+		opStackOfs--;
+		programCounter = ( r0 == r2 ) ? code[ programCounter ].value : programCounter + 1;
+		DISPATCH();
+	CASE(OPX_CONST_NE):
+		opStackOfs--;
+		programCounter = ( r0 != r2 ) ? code[ programCounter ].value : programCounter + 1;
+		DISPATCH();
+	CASE(OPX_CONST_LTI):
+		opStackOfs--;
+		programCounter = ( r0 < r2 ) ? code[ programCounter ].value : programCounter + 1;
+		DISPATCH();
+	CASE(OPX_CONST_LEI):
+		opStackOfs--;
+		programCounter = ( r0 <= r2 ) ? code[ programCounter ].value : programCounter + 1;
+		DISPATCH();
+	CASE(OPX_CONST_GTI):
+		opStackOfs--;
+		programCounter = ( r0 > r2 ) ? code[ programCounter ].value : programCounter + 1;
+		DISPATCH();
+	CASE(OPX_CONST_GEI):
+		opStackOfs--;
+		programCounter = ( r0 >= r2 ) ? code[ programCounter ].value : programCounter + 1;
+		DISPATCH();
+	CASE(OPX_CONST_LTU):
+		opStackOfs--;
+		programCounter = ( (unsigned)r0 < (unsigned)r2 ) ? code[ programCounter ].value : programCounter + 1;
+		DISPATCH();
+	CASE(OPX_CONST_LEU):
+		opStackOfs--;
+		programCounter = ( (unsigned)r0 <= (unsigned)r2 ) ? code[ programCounter ].value : programCounter + 1;
+		DISPATCH();
+	CASE(OPX_CONST_GTU):
+		opStackOfs--;
+		programCounter = ( (unsigned)r0 > (unsigned)r2 ) ? code[ programCounter ].value : programCounter + 1;
+		DISPATCH();
+	CASE(OPX_CONST_GEU):
+		opStackOfs--;
+		programCounter = ( (unsigned)r0 >= (unsigned)r2 ) ? code[ programCounter ].value : programCounter + 1;
+		DISPATCH();
+
+	CASE(OPX_CONST_JUMP):
+		// the target was checked when the code was decoded
+		programCounter = r2;
+		DISPATCH2();
+
+	CASE(OPX_LOCAL_CONST_STORE4):
+		*(int *)&image[ (r2 + programStack) & dataMask ] = code[ programCounter ].value;
+		programCounter += 2;
+		DISPATCH2();
 	}
 
 done:
@@ -138,6 +138,13 @@ typedef struct vmSymbol_s {
 	char	symName[1];		// variable sized
 } vmSymbol_t;
 
+// procedures found at load time, for walking the program stack
+typedef struct {
+	int			instruction;		// OP_ENTER
+	int			frameSize;
+	const char	*name;				// from the symbol file
+} vmProc_t;
+
 #define	VM_OFFSET_PROGRAM_STACK		0
 #define	VM_OFFSET_SYSTEM_CALL		4
 
@@ -177,6 +184,9 @@ struct vm_s {
 	int			numSymbols;
 	struct vmSymbol_s	*symbols;
 
+	int			numProcs;
+	vmProc_t	*procs;
+
 	int			callLevel;		// counts recursive VM_Call
 	int			breakFunction;		// increment breakCount on function entry to this
 	int			breakCount;
@@ -186,8 +196,12 @@ struct vm_s {
 };
 
 
+#define	MAX_VM		3
+extern	vm_t	vmTable[MAX_VM];
+
 extern	vm_t	*currentVM;
 extern	int		vm_debugLevel;
+extern	cvar_t	*vm_optimize;
 
 void VM_Compile( vm_t *vm, vmHeader_t *header );
 int	VM_CallCompiled( vm_t *vm, int *args );
@@ -195,6 +209,15 @@ int	VM_CallCompiled( vm_t *vm, int *args );
 void VM_PrepareInterpreter( vm_t *vm, vmHeader_t *header );
 int	VM_CallInterpreted( vm_t *vm, int *args );
 
+void VM_FindProcedures( vm_t *vm, vmHeader_t *header );
+void VM_NameProcedure( vm_t *vm, int instruction, const char *name );
+void VM_ProfileEnter( vm_t *vm );
+void VM_ProfileLeave( vm_t *vm );
+void VM_ProfileCall( vm_t *vm, int programStack, int pc );
+void VM_ProfileReturn( vm_t *vm, int programStack, int pc );
+void VM_ProfileFree( vm_t *vm );
+extern vm_t *vm_profiled;
+
 vmSymbol_t *VM_ValueToFunctionSymbol( vm_t *vm, int value );
 int VM_SymbolToValue( vm_t *vm, const char *symbol );
 const char *VM_ValueToSymbol( vm_t *vm, int value );
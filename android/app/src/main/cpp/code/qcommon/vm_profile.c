@@ -0,0 +1,636 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// vm_profile.c -- sampling profiler for interpreted and compiled vms
+
+/*
+
+While a capture is running the system calls of the profiled vm go through
+VM_ProfileSystemCall, and the interpreter reports every procedure entry
+and return through VM_ProfileCall and VM_ProfileReturn. At each of these
+points the time since the last one, read from the microsecond clock, is
+charged to the current call stack: time before a call or a return to the
+procedure running it, time inside a system call to the system call.
+
+Compiled code only stops at system calls, so there the time a procedure
+spends between two system calls goes to the procedure making the next
+one, usually its caller, and calls aren't counted. The report says so;
+load the vm interpreted for exact attribution.
+
+The call stack is walked on the program stack. Every call saves the
+instruction number to return to at the bottom of the caller's frame, and
+the frame sizes come from the OP_ENTER of each procedure, so this works
+the same for the interpreter and for compilers that save return addresses.
+
+"vmprof stop" prints the procedures with the most time and writes one
+line per call stack, "root;...;leaf usec", which flamegraph.pl and
+similar tools read directly.
+
+*/
+
+#include "vm_local.h"
+
+// compilers that save return addresses on the program stack
+#if !defined(NO_VM_COMPILED) && !idx64 && !id386 && !defined(__aarch64__)
+#define VMP_NO_COMPILED
+#endif
+
+#define VMP_MAX_DEPTH		32
+#define VMP_MAX_STACKS		8192
+#define VMP_HASH_SIZE		8192
+#define VMP_MAX_SYSCALLS	1024	// higher numbers share the last slot
+
+typedef struct vmpStack_s {
+	struct vmpStack_s	*next;			// hash chain
+	int64_t		usec;
+	int			syscall;				// leaf system call + 1, or 0
+	int			depth;
+	int			procs[VMP_MAX_DEPTH];	// leaf first
+} vmpStack_t;
+
+typedef struct {
+	vm_t		*vm;
+	intptr_t	(*systemCall)( intptr_t *parms );
+
+	int64_t		lastTime;				// usec
+	int			syscall;				// running system call + 1, or 0
+	int			startTime;
+
+	vmpStack_t	*stacks;
+	int			numStacks;
+	int64_t		dropped;				// usec that didn't fit
+	int			*calls;					// per procedure, interpreted only
+	vmpStack_t	*hashTable[VMP_HASH_SIZE];
+} vmProfile_t;
+
+static vmProfile_t	vmp;
+
+vm_t	*vm_profiled;
+
+
+/*
+================
+VM_FindProcedures
+
+Records the entry and frame size of every procedure, the bytecode
+has already been checked by the compiler or interpreter
+================
+*/
+void VM_FindProcedures( vm_t *vm, vmHeader_t *header ) {
+	byte	*code;
+	int		pass, count, instruction, pc, op, v;
+
+	code = (byte *)header + header->codeOffset;
+	count = 0;
+
+	for ( pass = 0 ; pass < 2 ; pass++ ) {
+		if ( pass ) {
+			vm->procs = Hunk_Alloc( count * sizeof( *vm->procs ), h_high );
+			vm->numProcs = count;
+			count = 0;
+		}
+
+		pc = 0;
+		for ( instruction = 0 ; instruction < header->instructionCount && pc < header->codeLength ; instruction++ ) {
+			op = code[pc++];
+
+			if ( op == OP_ENTER ) {
+				if ( pass ) {
+					Com_Memcpy( &v, &code[pc], 4 );
+					vm->procs[count].instruction = instruction;
+					vm->procs[count].frameSize = LittleLong( v );
+					vm->procs[count].name = NULL;
+				}
+				count++;
+			}
+
+			switch ( op ) {
+			case OP_ENTER:
+			case OP_CONST:
+			case OP_LOCAL:
+			case OP_LEAVE:
+			case OP_EQ:
+			case OP_NE:
+			case OP_LTI:
+			case OP_LEI:
+			case OP_GTI:
+			case OP_GEI:
+			case OP_LTU:
+			case OP_LEU:
+			case OP_GTU:
+			case OP_GEU:
+			case OP_EQF:
+			case OP_NEF:
+			case OP_LTF:
+			case OP_LEF:
+			case OP_GTF:
+			case OP_GEF:
+			case OP_BLOCK_COPY:
+				pc += 4;
+				break;
+			case OP_ARG:
+				pc += 1;
+				break;
+			default:
+				break;
+			}
+		}
+	}
+}
+
+/*
+================
+VM_FindProcedure
+
+Returns the index of the procedure containing the instruction
+================
+*/
+static int VM_FindProcedure( vm_t *vm, int instruction ) {
+	int		low, high, mid;
+
+	low = 0;
+	high = vm->numProcs - 1;
+	if ( high < 0 || instruction < vm->procs[0].instruction ) {
+		return -1;
+	}
+
+	while ( low < high ) {
+		mid = ( low + high + 1 ) >> 1;
+		if ( vm->procs[mid].instruction <= instruction ) {
+			low = mid;
+		} else {
+			high = mid - 1;
+		}
+	}
+
+	return low;
+}
+
+/*
+================
+VM_NameProcedure
+
+Called for every code symbol in the map file
+================
+*/
+void VM_NameProcedure( vm_t *vm, int instruction, const char *name ) {
+	int		i;
+
+	i = VM_FindProcedure( vm, instruction );
+	if ( i >= 0 && vm->procs[i].instruction == instruction ) {
+		vm->procs[i].name = name;
+	}
+}
+
+/*
+================
+VM_ProcedureName
+================
+*/
+static const char *VM_ProcedureName( vm_t *vm, int proc ) {
+	if ( vm->procs[proc].name ) {
+		return vm->procs[proc].name;
+	}
+	return va( "proc_%i", vm->procs[proc].instruction );
+}
+
+/*
+================
+VM_SystemCallName
+
+Symbol files may list the system calls with their negative call numbers
+================
+*/
+static const char *VM_SystemCallName( vm_t *vm, int syscall ) {
+	vmSymbol_t	*sym;
+
+	for ( sym = vm->symbols ; sym ; sym = sym->next ) {
+		if ( sym->symValue == -1 - syscall ) {
+			return sym->symName;
+		}
+	}
+	return va( "syscall_%i", syscall );
+}
+
+/*
+================
+VM_ProfileSample
+
+Charges usec to the call stack whose innermost procedure is running pc
+with its frame at programStack, pc -1 when the frames are gone
+================
+*/
+static void VM_ProfileSample( int64_t usec, int programStack, int pc ) {
+	vm_t		*vm = vmp.vm;
+	vmpStack_t	sample, *s;
+	unsigned	hash;
+	int			proc, i;
+
+	sample.syscall = vmp.syscall;
+	sample.depth = 0;
+
+	// each frame has the return address of its last call at the bottom
+	while ( sample.depth < VMP_MAX_DEPTH ) {
+		if ( (unsigned)pc >= vm->instructionCount ) {
+			break;
+		}
+		proc = VM_FindProcedure( vm, pc );
+		if ( proc < 0 ) {
+			break;
+		}
+		sample.procs[sample.depth++] = proc;
+
+		programStack += vm->procs[proc].frameSize;
+		pc = *(int *)&vm->dataBase[ programStack & vm->dataMask ];
+	}
+
+	if ( !sample.depth ) {
+		// entering or leaving vmMain
+		proc = VM_FindProcedure( vm, 0 );
+		if ( proc >= 0 ) {
+			sample.procs[sample.depth++] = proc;
+		}
+	}
+
+	hash = sample.syscall;
+	for ( i = 0 ; i < sample.depth ; i++ ) {
+		hash = hash * 31 + sample.procs[i];
+	}
+	hash &= VMP_HASH_SIZE - 1;
+
+	for ( s = vmp.hashTable[hash] ; s ; s = s->next ) {
+		if ( s->syscall == sample.syscall && s->depth == sample.depth
+			&& !memcmp( s->procs, sample.procs, sample.depth * sizeof( sample.procs[0] ) ) ) {
+			s->usec += usec;
+			return;
+		}
+	}
+
+	if ( vmp.numStacks == VMP_MAX_STACKS ) {
+		vmp.dropped += usec;
+		return;
+	}
+
+	s = &vmp.stacks[vmp.numStacks++];
+	*s = sample;
+	s->usec = usec;
+	s->next = vmp.hashTable[hash];
+	vmp.hashTable[hash] = s;
+}
+
+/*
+================
+VM_ProfileTick
+================
+*/
+static void VM_ProfileTick( int programStack, int pc ) {
+	int64_t		time;
+
+	time = Sys_Microseconds();
+	if ( time != vmp.lastTime ) {
+		VM_ProfileSample( time - vmp.lastTime, programStack, pc );
+		vmp.lastTime = time;
+	}
+}
+
+/*
+================
+VM_ProfileSystemCall
+================
+*/
+static intptr_t VM_ProfileSystemCall( intptr_t *args ) {
+	vm_t		*vm = vmp.vm;
+	intptr_t	r;
+	int			programStack, pc;
+
+	// calls from vms entered by this system call count as its time
+	if ( vmp.syscall ) {
+		return vmp.systemCall( args );
+	}
+
+	// the return address of the system call is at the bottom of the frame
+	programStack = vm->programStack + 4;
+	pc = *(int *)&vm->dataBase[ programStack & vm->dataMask ];
+
+	VM_ProfileTick( programStack, pc );
+	vmp.syscall = args[0] + 1;
+
+	r = vmp.systemCall( args );
+
+	VM_ProfileTick( programStack, pc );
+	vmp.syscall = 0;
+
+	return r;
+}
+
+/*
+================
+VM_ProfileCall
+
+Called by the interpreter at the OP_ENTER at pc, before the new frame
+is taken off programStack
+================
+*/
+void VM_ProfileCall( vm_t *vm, int programStack, int pc ) {
+	int		proc;
+
+	proc = VM_FindProcedure( vm, pc );
+	if ( proc >= 0 ) {
+		vmp.calls[proc]++;
+	}
+
+	if ( !vmp.syscall ) {
+		// the caller is running the instruction it will return to
+		VM_ProfileTick( programStack, *(int *)&vm->dataBase[ programStack & vm->dataMask ] );
+	}
+}
+
+/*
+================
+VM_ProfileReturn
+
+Called by the interpreter at the OP_LEAVE at pc, before the frame
+at programStack is given back
+================
+*/
+void VM_ProfileReturn( vm_t *vm, int programStack, int pc ) {
+	if ( !vmp.syscall ) {
+		VM_ProfileTick( programStack, pc );
+	}
+}
+
+/*
+================
+VM_ProfileEnter
+
+Called by VM_Call for the outermost call into the profiled vm
+================
+*/
+void VM_ProfileEnter( vm_t *vm ) {
+	vmp.lastTime = Sys_Microseconds();
+	vmp.syscall = 0;
+}
+
+/*
+================
+VM_ProfileLeave
+================
+*/
+void VM_ProfileLeave( vm_t *vm ) {
+	VM_ProfileTick( 0, -1 );
+}
+
+/*
+================
+VM_ProfileSort
+================
+*/
+static int64_t	*vmp_sortTime;
+
+static int QDECL VM_ProfileSort( const void *a, const void *b ) {
+	int64_t		ta = vmp_sortTime[*(const int *)a];
+	int64_t		tb = vmp_sortTime[*(const int *)b];
+
+	return ta < tb ? 1 : ta > tb ? -1 : 0;
+}
+
+/*
+================
+VM_ProfileReport
+
+Prints the flat profile and writes the collapsed call stacks
+================
+*/
+static void VM_ProfileReport( const char *name ) {
+	vm_t			*vm = vmp.vm;
+	vmpStack_t		*s;
+	fileHandle_t	f;
+	int64_t			*self, *total, sum;
+	int				*seen, *order;
+	int				numEntries, i, j;
+	char			line[MAX_STRING_CHARS];
+	char			filename[MAX_QPATH];
+
+	// the name may come from va(), which the symbol lookups use as well
+	if ( name ) {
+		Q_strncpyz( filename, name, sizeof( filename ) );
+	}
+
+	// one entry per procedure and one per system call
+	numEntries = vm->numProcs + VMP_MAX_SYSCALLS;
+	self = Z_Malloc( numEntries * ( sizeof( *self ) * 2 + sizeof( *seen ) * 2 ) );
+	total = self + numEntries;
+	seen = (int *)( total + numEntries );
+	order = seen + numEntries;
+
+	sum = 0;
+	for ( i = 0 ; i < vmp.numStacks ; i++ ) {
+		s = &vmp.stacks[i];
+		sum += s->usec;
+
+		if ( s->syscall ) {
+			j = vm->numProcs + MIN( s->syscall - 1, VMP_MAX_SYSCALLS - 1 );
+			self[j] += s->usec;
+			total[j] += s->usec;
+		} else if ( s->depth ) {
+			self[s->procs[0]] += s->usec;
+		}
+
+		// recursive procedures count once per stack
+		for ( j = 0 ; j < s->depth ; j++ ) {
+			if ( seen[s->procs[j]] != i + 1 ) {
+				seen[s->procs[j]] = i + 1;
+				total[s->procs[j]] += s->usec;
+			}
+		}
+	}
+
+	for ( i = 0 ; i < numEntries ; i++ ) {
+		order[i] = i;
+	}
+	vmp_sortTime = self;
+	qsort( order, numEntries, sizeof( *order ), VM_ProfileSort );
+
+	Com_Printf( "%s: %i msec in %i call stacks over %i msec\n", vm->name, (int)( sum / 1000 ), vmp.numStacks,
+		Sys_Milliseconds() - vmp.startTime );
+	if ( vmp.dropped ) {
+		Com_Printf( "%i msec dropped, too many call stacks\n", (int)( vmp.dropped / 1000 ) );
+	}
+	if ( vm->compiled ) {
+		Com_Printf( "%s is compiled: time between system calls goes to the procedure making the next one,\n"
+			"so procedures that return without a system call are charged to their callers, and calls\n"
+			"aren't counted; load it interpreted for exact numbers\n", vm->name );
+	}
+	Com_Printf( " self%%  total%%   self ms     calls name\n" );
+	for ( i = 0 ; i < 25 && i < numEntries && sum ; i++ ) {
+		j = order[i];
+		if ( !self[j] ) {
+			break;
+		}
+		Com_Printf( "%5.1f%% %6.1f%% %9.2f %9s %s\n", 100.0f * self[j] / sum, 100.0f * total[j] / sum, self[j] / 1000.0f,
+			j < vm->numProcs && !vm->compiled ? va( "%i", vmp.calls[j] ) : "-",
+			j < vm->numProcs ? VM_ProcedureName( vm, j ) : VM_SystemCallName( vm, j - vm->numProcs ) );
+	}
+
+	if ( name ) {
+		f = FS_FOpenFileWrite( filename );
+		if ( !f ) {
+			Com_Printf( "Couldn't write %s\n", filename );
+		} else {
+			for ( i = 0 ; i < vmp.numStacks ; i++ ) {
+				s = &vmp.stacks[i];
+
+				line[0] = 0;
+				for ( j = s->depth - 1 ; j >= 0 ; j-- ) {
+					Q_strcat( line, sizeof( line ), VM_ProcedureName( vm, s->procs[j] ) );
+					if ( j || s->syscall ) {
+						Q_strcat( line, sizeof( line ), ";" );
+					}
+				}
+				if ( s->syscall ) {
+					Q_strcat( line, sizeof( line ), VM_SystemCallName( vm, s->syscall - 1 ) );
+				}
+				if ( !line[0] ) {
+					Q_strncpyz( line, "unknown", sizeof( line ) );
+				}
+				FS_Printf( f, "%s %i\n", line, (int)s->usec );
+			}
+			FS_FCloseFile( f );
+			Com_Printf( "Wrote %s\n", filename );
+		}
+	}
+
+	Z_Free( self );
+}
+
+/*
+================
+VM_ProfileStop
+================
+*/
+static void VM_ProfileStop( const char *filename ) {
+	VM_ProfileReport( filename );
+
+	vmp.vm->systemCall = vmp.systemCall;
+	Z_Free( vmp.calls );
+	Z_Free( vmp.stacks );
+	Com_Memset( &vmp, 0, sizeof( vmp ) );
+	vm_profiled = NULL;
+}
+
+/*
+================
+VM_ProfileFree
+
+The profiled vm is going away, finish the capture with what we have
+================
+*/
+void VM_ProfileFree( vm_t *vm ) {
+	if ( vm == vm_profiled ) {
+		Com_Printf( "%s is being freed, stopping the profile\n", vm->name );
+		VM_ProfileStop( va( "vmprof_%s.txt", vm->name ) );
+	}
+}
+
+/*
+================
+VM_ProfileStart
+================
+*/
+static void VM_ProfileStart( vm_t *vm ) {
+	if ( vm->dllHandle ) {
+		Com_Printf( "%s is a native library, use a profiler for the host\n", vm->name );
+		return;
+	}
+#ifdef VMP_NO_COMPILED
+	if ( vm->compiled ) {
+		Com_Printf( "The compiler for this architecture doesn't save return addresses, load %s interpreted\n", vm->name );
+		return;
+	}
+#endif
+	if ( !vm->numProcs ) {
+		Com_Printf( "%s has no procedures\n", vm->name );
+		return;
+	}
+	if ( !vm->symbols ) {
+		Com_Printf( "No symbols for %s, set developer 1 before it loads for procedure names\n", vm->name );
+	}
+
+	Com_Memset( &vmp, 0, sizeof( vmp ) );
+	vmp.vm = vm;
+	vmp.stacks = Z_Malloc( VMP_MAX_STACKS * sizeof( *vmp.stacks ) );
+	vmp.calls = Z_Malloc( vm->numProcs * sizeof( *vmp.calls ) );
+	vmp.startTime = Sys_Milliseconds();
+	vmp.lastTime = Sys_Microseconds();
+
+	// a capture started from inside the vm picks up at the next system call
+	vmp.systemCall = vm->systemCall;
+	vm->systemCall = VM_ProfileSystemCall;
+	vm_profiled = vm;
+
+	Com_Printf( "Profiling %s\n", vm->name );
+}
+
+/*
+================
+VM_Prof_f
+
+vmprof start [vm]
+vmprof stop [file]
+vmprof status
+================
+*/
+void VM_Prof_f( void ) {
+	const char	*cmd, *name;
+	int			i;
+
+	cmd = Cmd_Argv( 1 );
+
+	if ( !Q_stricmp( cmd, "start" ) ) {
+		if ( vm_profiled ) {
+			Com_Printf( "Already profiling %s\n", vm_profiled->name );
+			return;
+		}
+
+		name = Cmd_Argc() > 2 ? Cmd_Argv( 2 ) : "qagame";
+		for ( i = 0 ; i < MAX_VM ; i++ ) {
+			if ( vmTable[i].name[0] && !Q_stricmp( vmTable[i].name, name ) ) {
+				VM_ProfileStart( &vmTable[i] );
+				return;
+			}
+		}
+		Com_Printf( "No vm named %s\n", name );
+	} else if ( !Q_stricmp( cmd, "stop" ) ) {
+		if ( !vm_profiled ) {
+			Com_Printf( "Not profiling\n" );
+			return;
+		}
+		VM_ProfileStop( Cmd_Argc() > 2 ? Cmd_Argv( 2 ) : va( "vmprof_%s.txt", vm_profiled->name ) );
+	} else if ( !Q_stricmp( cmd, "status" ) ) {
+		if ( !vm_profiled ) {
+			Com_Printf( "Not profiling\n" );
+			return;
+		}
+		VM_ProfileReport( NULL );
+	} else {
+		Com_Printf( "usage: vmprof start [vm] | stop [file] | status\n" );
+	}
+}
@@ -0,0 +1,809 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// vm_test.c -- runs generated bytecode through both the interpreter and
+// the compiler and compares the results
+
+/*
+
+The programs are random, but always valid and terminating. They use the
+same conventions as code generated by q3lcc: the opStack is empty between
+statements, procedures take their arguments from the caller's frame and
+every frame is VMT_FRAME bytes:
+
+	0		return address
+	4		unused
+	8		outgoing arguments
+	24		locals
+	VMT_FRAME + 8	incoming arguments
+
+The first half of the globals is written by the programs, the second half
+holds the tables for computed jumps.
+
+*/
+
+#include "vm_local.h"
+
+#define VMT_DATA_SIZE		0x20000		// the program stack takes the upper half
+#define VMT_STORE_SIZE		0x800
+#define VMT_GLOBALS_SIZE	0x1000
+
+#define VMT_FRAME		56
+#define VMT_LOCALS		24
+#define VMT_NUM_LOCALS		6		// plus two loop counters
+#define VMT_ARGS		( VMT_FRAME + 8 )
+
+#define VMT_MAX_CODE		0x8000
+#define VMT_MAX_LABELS		1024
+#define VMT_MAX_FIXUPS		2048
+#define VMT_MAX_FUNCS		6
+#define VMT_MAX_JUMPTABLES	( ( VMT_GLOBALS_SIZE - VMT_STORE_SIZE ) / 16 )
+
+#define VMT_CALLS		4		// vmMain calls per program
+#define VMT_CALL_SITES		3		// per procedure, keeps the run time down
+
+typedef struct {
+	byte		code[VMT_MAX_CODE];
+	int			codeLength;
+	int			instructionCount;
+	qboolean	overflow;
+
+	int			labels[VMT_MAX_LABELS];
+	int			numLabels;
+
+	int			fixupOfs[VMT_MAX_FIXUPS];
+	int			fixupLabel[VMT_MAX_FIXUPS];
+	int			numFixups;
+
+	int			funcLabels[VMT_MAX_FUNCS];
+	qboolean	funcVoid[VMT_MAX_FUNCS];
+	int			numFuncs;
+	int			func;
+	int			callSites;
+
+	int			tableLabels[VMT_MAX_JUMPTABLES][4];
+	int			numTables;
+	int			jumpTargets[VMT_MAX_JUMPTABLES * 4];
+
+	int			loopDepth;
+	int			seed;
+} vmtProgram_t;
+
+static vmtProgram_t	*vmt_prog;
+static vmHeader_t	*vmt_header;
+static vm_t			vmt_vms[2];		// interpreted, compiled
+static int			vmt_reentry;
+static int			vmt_repeat;		// timed runs of each program
+static int			vmt_msec[2];
+
+static int VMT_Rand( int range ) {
+	return ( (unsigned)Q_rand( &vmt_prog->seed ) >> 8 ) % range;
+}
+
+/*
+=================
+Code emitting
+=================
+*/
+
+static void VMT_Byte( int b ) {
+	if ( vmt_prog->codeLength >= VMT_MAX_CODE ) {
+		vmt_prog->overflow = qtrue;
+		return;
+	}
+	vmt_prog->code[vmt_prog->codeLength++] = b;
+}
+
+static void VMT_Long( int v ) {
+	VMT_Byte( v & 0xFF );
+	VMT_Byte( ( v >> 8 ) & 0xFF );
+	VMT_Byte( ( v >> 16 ) & 0xFF );
+	VMT_Byte( ( v >> 24 ) & 0xFF );
+}
+
+static void VMT_Op( int op ) {
+	VMT_Byte( op );
+	vmt_prog->instructionCount++;
+}
+
+static void VMT_Op4( int op, int v ) {
+	VMT_Op( op );
+	VMT_Long( v );
+}
+
+static void VMT_Op1( int op, int v ) {
+	VMT_Op( op );
+	VMT_Byte( v );
+}
+
+static int VMT_NewLabel( void ) {
+	if ( vmt_prog->numLabels >= VMT_MAX_LABELS ) {
+		vmt_prog->overflow = qtrue;
+		return 0;
+	}
+	vmt_prog->labels[vmt_prog->numLabels] = -1;
+	return vmt_prog->numLabels++;
+}
+
+static void VMT_PlaceLabel( int label ) {
+	vmt_prog->labels[label] = vmt_prog->instructionCount;
+}
+
+// op with an instruction number that is patched in later
+static void VMT_OpLabel( int op, int label ) {
+	VMT_Op( op );
+	if ( vmt_prog->numFixups >= VMT_MAX_FIXUPS ) {
+		vmt_prog->overflow = qtrue;
+	} else {
+		vmt_prog->fixupOfs[vmt_prog->numFixups] = vmt_prog->codeLength;
+		vmt_prog->fixupLabel[vmt_prog->numFixups] = label;
+		vmt_prog->numFixups++;
+	}
+	VMT_Long( 0 );
+}
+
+/*
+=================
+Program generation
+=================
+*/
+
+static void VMT_IntExpr( int depth );
+static void VMT_Block( int depth );
+
+static void VMT_Call( int func, int depth ) {
+	VMT_IntExpr( depth );
+	VMT_Op1( OP_ARG, 8 );
+	VMT_IntExpr( depth );
+	VMT_Op1( OP_ARG, 12 );
+	VMT_OpLabel( OP_CONST, vmt_prog->funcLabels[func] );
+	VMT_Op( OP_CALL );
+}
+
+static void VMT_SystemCall( int num, int depth ) {
+	VMT_IntExpr( depth );
+	VMT_Op1( OP_ARG, 8 );
+	VMT_IntExpr( depth );
+	VMT_Op1( OP_ARG, 12 );
+	VMT_Op4( OP_CONST, -1 - num );
+	VMT_Op( OP_CALL );
+}
+
+// returns a procedure that may be called from the current one, procedures
+// only call those after them so there is no recursion
+static int VMT_Callee( qboolean allowVoid ) {
+	int func;
+
+	if ( vmt_prog->func + 1 >= vmt_prog->numFuncs || vmt_prog->loopDepth
+		|| vmt_prog->callSites >= VMT_CALL_SITES )
+		return -1;
+
+	func = vmt_prog->func + 1 + VMT_Rand( vmt_prog->numFuncs - vmt_prog->func - 1 );
+	if ( vmt_prog->funcVoid[func] && !allowVoid )
+		return -1;
+
+	vmt_prog->callSites++;
+	return func;
+}
+
+static int VMT_FloatConst( int range, int div ) {
+	floatint_t	fi;
+
+	fi.f = (float)( VMT_Rand( 2 * range + 1 ) - range ) / div;
+	return fi.i;
+}
+
+// floats stay small so converting them back to int is well defined
+static void VMT_FloatExpr( int depth ) {
+	floatint_t	fi;
+	int			r = depth > 2 ? VMT_Rand( 2 ) : VMT_Rand( 7 );
+
+	switch ( r ) {
+	case 0:
+		VMT_IntExpr( depth + 1 );
+		VMT_Op4( OP_CONST, 1023 );
+		VMT_Op( OP_BAND );
+		VMT_Op4( OP_CONST, 512 );
+		VMT_Op( OP_SUB );
+		VMT_Op( OP_CVIF );
+		break;
+	case 1:
+		VMT_Op4( OP_CONST, VMT_FloatConst( 8000, 8 ) );
+		break;
+	case 2:
+		VMT_FloatExpr( depth + 1 );
+		VMT_FloatExpr( depth + 1 );
+		VMT_Op( OP_ADDF );
+		break;
+	case 3:
+		VMT_FloatExpr( depth + 1 );
+		VMT_FloatExpr( depth + 1 );
+		VMT_Op( OP_SUBF );
+		break;
+	case 4:
+		VMT_FloatExpr( depth + 1 );
+		VMT_Op4( OP_CONST, VMT_FloatConst( 8, 4 ) );
+		VMT_Op( OP_MULF );
+		break;
+	case 5:
+		VMT_FloatExpr( depth + 1 );
+		fi.f = 1.5f + VMT_Rand( 4 );
+		VMT_Op4( OP_CONST, fi.i );
+		VMT_Op( OP_DIVF );
+		break;
+	default:
+		VMT_FloatExpr( depth + 1 );
+		VMT_Op( OP_NEGF );
+		break;
+	}
+}
+
+static void VMT_IntExpr( int depth ) {
+	static const int binops[] = { OP_ADD, OP_SUB, OP_MULI, OP_MULU, OP_BAND, OP_BOR, OP_BXOR };
+	static const int shiftops[] = { OP_LSH, OP_RSHI, OP_RSHU };
+	static const int divops[] = { OP_DIVI, OP_DIVU, OP_MODI, OP_MODU };
+	static const int unops[] = { OP_NEGI, OP_BCOM, OP_SEX8, OP_SEX16 };
+	int		r, func;
+
+	if ( depth >= 4 || vmt_prog->overflow )
+		r = VMT_Rand( 5 );
+	else
+		r = VMT_Rand( 12 );
+
+	switch ( r ) {
+	case 0:
+		// small constants get merged with the next instruction by the compilers
+		if ( VMT_Rand( 2 ) )
+			VMT_Op4( OP_CONST, VMT_Rand( 5000 ) );
+		else
+			VMT_Op4( OP_CONST, Q_rand( &vmt_prog->seed ) );
+		break;
+	case 1:
+		VMT_Op4( OP_LOCAL, VMT_LOCALS + 4 * VMT_Rand( VMT_NUM_LOCALS + 2 ) );
+		VMT_Op( OP_LOAD4 );
+		break;
+	case 2:
+		VMT_Op4( OP_LOCAL, VMT_ARGS + 4 * VMT_Rand( 2 ) );
+		VMT_Op( OP_LOAD4 );
+		break;
+	case 3:
+		r = VMT_Rand( 3 );
+		if ( r == 0 ) {
+			VMT_Op4( OP_CONST, VMT_Rand( VMT_GLOBALS_SIZE / 4 ) * 4 );
+			VMT_Op( OP_LOAD4 );
+		} else if ( r == 1 ) {
+			VMT_Op4( OP_CONST, VMT_Rand( VMT_GLOBALS_SIZE / 2 ) * 2 );
+			VMT_Op( OP_LOAD2 );
+		} else {
+			VMT_Op4( OP_CONST, VMT_Rand( VMT_GLOBALS_SIZE ) );
+			VMT_Op( OP_LOAD1 );
+		}
+		break;
+	case 4:
+		// address arithmetic the way q3lcc emits it for local arrays
+		VMT_Op4( OP_LOCAL, VMT_LOCALS );
+		VMT_Op4( OP_CONST, 4 * VMT_Rand( VMT_NUM_LOCALS ) );
+		VMT_Op( OP_ADD );
+		VMT_Op( OP_LOAD4 );
+		break;
+	case 5:
+		VMT_IntExpr( depth + 1 );
+		VMT_IntExpr( depth + 1 );
+		VMT_Op( binops[VMT_Rand( ARRAY_LEN( binops ) )] );
+		break;
+	case 6:
+		VMT_IntExpr( depth + 1 );
+		if ( VMT_Rand( 2 ) ) {
+			VMT_Op4( OP_CONST, VMT_Rand( 32 ) );
+		} else {
+			VMT_IntExpr( depth + 1 );
+			VMT_Op4( OP_CONST, 31 );
+			VMT_Op( OP_BAND );
+		}
+		VMT_Op( shiftops[VMT_Rand( ARRAY_LEN( shiftops ) )] );
+		break;
+	case 7:
+		// divisors are positive and never zero
+		VMT_IntExpr( depth + 1 );
+		VMT_IntExpr( depth + 1 );
+		VMT_Op4( OP_CONST, 255 );
+		VMT_Op( OP_BAND );
+		VMT_Op4( OP_CONST, 1 );
+		VMT_Op( OP_BOR );
+		VMT_Op( divops[VMT_Rand( ARRAY_LEN( divops ) )] );
+		break;
+	case 8:
+		VMT_IntExpr( depth + 1 );
+		VMT_Op( unops[VMT_Rand( ARRAY_LEN( unops ) )] );
+		break;
+	case 9:
+		VMT_FloatExpr( depth + 1 );
+		VMT_Op( OP_CVFI );
+		break;
+	case 10:
+		func = VMT_Callee( qfalse );
+		if ( func < 0 )
+			VMT_Op4( OP_CONST, VMT_Rand( 100 ) );
+		else
+			VMT_Call( func, depth + 2 );
+		break;
+	default:
+		VMT_SystemCall( VMT_Rand( 3 ), depth + 2 );
+		break;
+	}
+}
+
+static void VMT_Compare( int depth, int then ) {
+	static const int intops[] = { OP_EQ, OP_NE, OP_LTI, OP_LEI, OP_GTI, OP_GEI, OP_LTU, OP_LEU, OP_GTU, OP_GEU };
+	static const int floatops[] = { OP_EQF, OP_NEF, OP_LTF, OP_LEF, OP_GTF, OP_GEF };
+
+	if ( VMT_Rand( 3 ) ) {
+		VMT_IntExpr( depth );
+		VMT_IntExpr( depth );
+		VMT_OpLabel( intops[VMT_Rand( ARRAY_LEN( intops ) )], then );
+	} else {
+		VMT_FloatExpr( depth );
+		VMT_FloatExpr( depth );
+		VMT_OpLabel( floatops[VMT_Rand( ARRAY_LEN( floatops ) )], then );
+	}
+}
+
+static void VMT_Statement( int depth ) {
+	int		r, i, n, func, then, end, counter, top;
+	int		table;
+
+	if ( depth >= 3 || vmt_prog->overflow )
+		r = VMT_Rand( 5 );
+	else
+		r = VMT_Rand( 11 );
+
+	switch ( r ) {
+	case 0:
+		VMT_Op4( OP_CONST, VMT_Rand( VMT_STORE_SIZE / 4 ) * 4 );
+		VMT_IntExpr( 1 );
+		VMT_Op( OP_STORE4 );
+		break;
+	case 1:
+		VMT_Op4( OP_LOCAL, VMT_LOCALS + 4 * VMT_Rand( VMT_NUM_LOCALS ) );
+		VMT_IntExpr( 1 );
+		VMT_Op( OP_STORE4 );
+		break;
+	case 2:
+		if ( VMT_Rand( 2 ) ) {
+			VMT_Op4( OP_CONST, VMT_Rand( VMT_STORE_SIZE / 2 ) * 2 );
+			VMT_IntExpr( 1 );
+			VMT_Op( OP_STORE2 );
+		} else {
+			VMT_Op4( OP_CONST, VMT_Rand( VMT_STORE_SIZE ) );
+			VMT_IntExpr( 1 );
+			VMT_Op( OP_STORE1 );
+		}
+		break;
+	case 3:
+		VMT_Op4( OP_CONST, VMT_Rand( VMT_STORE_SIZE / 4 ) * 4 );
+		VMT_FloatExpr( 1 );
+		VMT_Op( OP_STORE4 );
+		break;
+	case 4:
+		n = 4 + 4 * VMT_Rand( 16 ) + VMT_Rand( 2 );
+		VMT_Op4( OP_CONST, VMT_Rand( ( VMT_STORE_SIZE - n ) / 4 ) * 4 );
+		VMT_Op4( OP_CONST, VMT_Rand( ( VMT_GLOBALS_SIZE - n ) / 4 ) * 4 );
+		VMT_Op4( OP_BLOCK_COPY, n );
+		break;
+	case 5:
+	case 6:
+		then = VMT_NewLabel();
+		end = VMT_NewLabel();
+		VMT_Compare( 1, then );
+		VMT_Block( depth + 1 );
+		VMT_OpLabel( OP_CONST, end );
+		VMT_Op( OP_JUMP );
+		VMT_PlaceLabel( then );
+		VMT_Block( depth + 1 );
+		VMT_PlaceLabel( end );
+		break;
+	case 7:
+		if ( vmt_prog->loopDepth >= 2 ) {
+			VMT_Statement( depth + 1 );
+			break;
+		}
+		counter = VMT_LOCALS + 4 * ( VMT_NUM_LOCALS + vmt_prog->loopDepth );
+		top = VMT_NewLabel();
+		VMT_Op4( OP_LOCAL, counter );
+		VMT_Op4( OP_CONST, 1 + VMT_Rand( 4 ) );
+		VMT_Op( OP_STORE4 );
+		VMT_PlaceLabel( top );
+		vmt_prog->loopDepth++;
+		VMT_Block( depth + 1 );
+		vmt_prog->loopDepth--;
+		VMT_Op4( OP_LOCAL, counter );
+		VMT_Op4( OP_LOCAL, counter );
+		VMT_Op( OP_LOAD4 );
+		VMT_Op4( OP_CONST, 1 );
+		VMT_Op( OP_SUB );
+		VMT_Op( OP_STORE4 );
+		VMT_Op4( OP_LOCAL, counter );
+		VMT_Op( OP_LOAD4 );
+		VMT_Op4( OP_CONST, 0 );
+		VMT_OpLabel( OP_GTI, top );
+		break;
+	case 8:
+		// switch through a jump table
+		if ( vmt_prog->numTables >= VMT_MAX_JUMPTABLES ) {
+			VMT_Statement( depth + 1 );
+			break;
+		}
+		table = vmt_prog->numTables++;
+		end = VMT_NewLabel();
+		VMT_IntExpr( 1 );
+		VMT_Op4( OP_CONST, 3 );
+		VMT_Op( OP_BAND );
+		VMT_Op4( OP_CONST, 2 );
+		VMT_Op( OP_LSH );
+		VMT_Op4( OP_CONST, VMT_STORE_SIZE + table * 16 );
+		VMT_Op( OP_ADD );
+		VMT_Op( OP_LOAD4 );
+		VMT_Op( OP_JUMP );
+		for ( i = 0 ; i < 4 ; i++ ) {
+			vmt_prog->tableLabels[table][i] = VMT_NewLabel();
+			VMT_PlaceLabel( vmt_prog->tableLabels[table][i] );
+			VMT_Block( depth + 1 );
+			VMT_OpLabel( OP_CONST, end );
+			VMT_Op( OP_JUMP );
+		}
+		VMT_PlaceLabel( end );
+		break;
+	case 9:
+		// discarded return value
+		func = VMT_Callee( qtrue );
+		if ( func >= 0 ) {
+			VMT_Call( func, 2 );
+		} else {
+			VMT_SystemCall( 1, 2 );
+		}
+		VMT_Op( OP_POP );
+		break;
+	default:
+		VMT_SystemCall( 1, 2 );
+		VMT_Op( OP_POP );
+		break;
+	}
+}
+
+static void VMT_Block( int depth ) {
+	int		i, n;
+
+	n = 1 + VMT_Rand( 3 );
+	for ( i = 0 ; i < n ; i++ ) {
+		VMT_Statement( depth );
+	}
+}
+
+static void VMT_Function( int func ) {
+	int		i, body;
+
+	vmt_prog->func = func;
+	vmt_prog->callSites = 0;
+	VMT_PlaceLabel( vmt_prog->funcLabels[func] );
+	VMT_Op4( OP_ENTER, VMT_FRAME );
+
+	// never read uninitialized stack, the interpreter stores
+	// return addresses there
+	for ( i = 0 ; i < VMT_NUM_LOCALS + 2 ; i++ ) {
+		VMT_Op4( OP_LOCAL, VMT_LOCALS + 4 * i );
+		VMT_Op4( OP_LOCAL, VMT_ARGS + 4 * ( i & 1 ) );
+		VMT_Op( OP_LOAD4 );
+		VMT_Op4( OP_CONST, i * 0x1234567 );
+		VMT_Op( OP_ADD );
+		VMT_Op( OP_STORE4 );
+	}
+
+	if ( func == 0 ) {
+		// vmMain, command 1 is used for recursive calls from the system calls
+		body = VMT_NewLabel();
+		VMT_Op4( OP_LOCAL, VMT_ARGS );
+		VMT_Op( OP_LOAD4 );
+		VMT_Op4( OP_CONST, 1 );
+		VMT_OpLabel( OP_NE, body );
+		VMT_Op4( OP_LOCAL, VMT_ARGS + 4 );
+		VMT_Op( OP_LOAD4 );
+		VMT_IntExpr( 2 );
+		VMT_Op( OP_BXOR );
+		VMT_Op4( OP_LEAVE, VMT_FRAME );
+		VMT_PlaceLabel( body );
+	}
+
+	VMT_Block( 0 );
+
+	if ( vmt_prog->funcVoid[func] )
+		VMT_Op( OP_PUSH );
+	else
+		VMT_IntExpr( 1 );
+	VMT_Op4( OP_LEAVE, VMT_FRAME );
+}
+
+/*
+=================
+VM_TestGenerate
+
+Builds a program and its header, returns qfalse if it got too large
+=================
+*/
+static qboolean VM_TestGenerate( int seed, qboolean jumpTable ) {
+	int		i, label, ofs;
+	byte	*image;
+
+	Com_Memset( vmt_prog, 0, sizeof( *vmt_prog ) );
+	// spread consecutive seeds apart, Q_rand is a plain LCG
+	vmt_prog->seed = seed * 0x9E3779B1;
+
+	vmt_prog->numFuncs = 2 + VMT_Rand( VMT_MAX_FUNCS - 1 );
+	for ( i = 0 ; i < vmt_prog->numFuncs ; i++ ) {
+		vmt_prog->funcLabels[i] = VMT_NewLabel();
+		vmt_prog->funcVoid[i] = ( i > 0 && !VMT_Rand( 4 ) );
+	}
+
+	for ( i = 0 ; i < vmt_prog->numFuncs ; i++ ) {
+		VMT_Function( i );
+	}
+
+	if ( vmt_prog->overflow )
+		return qfalse;
+
+	for ( i = 0 ; i < vmt_prog->numFixups ; i++ ) {
+		label = vmt_prog->labels[vmt_prog->fixupLabel[i]];
+		ofs = vmt_prog->fixupOfs[i];
+		vmt_prog->code[ofs] = label & 0xFF;
+		vmt_prog->code[ofs + 1] = ( label >> 8 ) & 0xFF;
+		vmt_prog->code[ofs + 2] = ( label >> 16 ) & 0xFF;
+		vmt_prog->code[ofs + 3] = ( label >> 24 ) & 0xFF;
+	}
+
+	for ( i = 0 ; i < vmt_prog->numTables * 4 ; i++ ) {
+		vmt_prog->jumpTargets[i] = vmt_prog->labels[vmt_prog->tableLabels[i / 4][i & 3]];
+	}
+
+	if ( vmt_header )
+		Z_Free( vmt_header );
+	vmt_header = Z_Malloc( sizeof( vmHeader_t ) + vmt_prog->codeLength );
+	vmt_header->vmMagic = jumpTable ? VM_MAGIC_VER2 : VM_MAGIC;
+	vmt_header->instructionCount = vmt_prog->instructionCount;
+	vmt_header->codeOffset = sizeof( vmHeader_t );
+	vmt_header->codeLength = vmt_prog->codeLength;
+	vmt_header->jtrgLength = jumpTable ? vmt_prog->numTables * 16 : 0;
+	Com_Memcpy( (byte *)vmt_header + vmt_header->codeOffset, vmt_prog->code, vmt_prog->codeLength );
+
+	// both vms get the same initial data
+	image = vmt_vms[0].dataBase;
+	for ( i = 0 ; i < VMT_DATA_SIZE ; i += 4 ) {
+		*(int *)( image + i ) = Q_rand( &vmt_prog->seed );
+	}
+	for ( i = 0 ; i < vmt_prog->numTables * 4 ; i++ ) {
+		*(int *)( image + VMT_STORE_SIZE + i * 4 ) = vmt_prog->jumpTargets[i];
+	}
+	Com_Memcpy( vmt_vms[1].dataBase, image, VMT_DATA_SIZE );
+
+	return qtrue;
+}
+
+static intptr_t VM_TestSystemCalls( intptr_t *args ) {
+	intptr_t	r;
+
+	switch ( args[0] ) {
+	case 0:
+		return ( args[1] * 3 ) ^ args[2];
+	case 1:
+		*(int *)( currentVM->dataBase + ( args[1] & ( VMT_STORE_SIZE - 4 ) ) ) = args[2];
+		return args[1] + args[2];
+	case 2:
+		if ( vmt_reentry >= 2 )
+			return args[1];
+		vmt_reentry++;
+		r = VM_Call( currentVM, 1, args[1], args[2] );
+		return r + 1;
+	default:
+		Com_Error( ERR_DROP, "vmtest: bad system call %i", (int)args[0] );
+	}
+	return 0;
+}
+
+static void VM_TestFree( void ) {
+	int		i;
+
+	for ( i = 0 ; i < 2 ; i++ ) {
+		if ( vmt_vms[i].destroy )
+			vmt_vms[i].destroy( &vmt_vms[i] );
+		if ( vmt_vms[i].dataBase )
+			Z_Free( vmt_vms[i].dataBase );
+		if ( vmt_vms[i].instructionPointers )
+			Z_Free( vmt_vms[i].instructionPointers );
+	}
+	Com_Memset( vmt_vms, 0, sizeof( vmt_vms ) );
+
+	if ( vmt_header ) {
+		Z_Free( vmt_header );
+		vmt_header = NULL;
+	}
+	if ( vmt_prog ) {
+		Z_Free( vmt_prog );
+		vmt_prog = NULL;
+	}
+}
+
+static void VM_TestSetup( vm_t *vm, const char *name, qboolean jumpTable ) {
+	byte	*dataBase = vm->dataBase;
+
+	// the interpreter keeps its code on the hunk
+	if ( vm->destroy )
+		vm->destroy( vm );
+	if ( vm->instructionPointers )
+		Z_Free( vm->instructionPointers );
+	Com_Memset( vm, 0, sizeof( *vm ) );
+	vm->dataBase = dataBase;
+
+	Q_strncpyz( vm->name, name, sizeof( vm->name ) );
+	vm->systemCall = VM_TestSystemCalls;
+	vm->dataAlloc = VMT_DATA_SIZE + 4;
+	vm->dataMask = VMT_DATA_SIZE - 1;
+
+	vm->programStack = VMT_DATA_SIZE;
+	vm->stackBottom = vm->programStack - PROGRAM_STACK_SIZE;
+	vm->instructionCount = vmt_header->instructionCount;
+	vm->instructionPointers = Z_Malloc( vm->instructionCount * sizeof( *vm->instructionPointers ) );
+	vm->codeLength = vmt_header->codeLength;
+	if ( jumpTable ) {
+		vm->jumpTableTargets = (byte *)vmt_prog->jumpTargets;
+		vm->numJumpTableTargets = vmt_prog->numTables * 4;
+	}
+}
+
+/*
+=================
+VM_TestProgram
+
+Returns the number of mismatches
+=================
+*/
+static int VM_TestProgram( int seed ) {
+	int			i, j, k;
+	int			args[VMT_CALLS][3];
+	int			result[2];
+	int			start;
+	qboolean	jumpTable;
+	vm_t		*interp = &vmt_vms[0];
+	vm_t		*compiled = &vmt_vms[1];
+
+	jumpTable = seed & 1;
+
+	if ( !vmt_prog )
+		vmt_prog = Z_Malloc( sizeof( *vmt_prog ) );
+	for ( i = 0 ; i < 2 ; i++ ) {
+		if ( !vmt_vms[i].dataBase )
+			vmt_vms[i].dataBase = Z_Malloc( VMT_DATA_SIZE + 4 );
+	}
+
+	if ( !VM_TestGenerate( seed, jumpTable ) ) {
+		Com_Printf( "vmtest: program %i too large, skipped\n", seed );
+		return 0;
+	}
+
+	VM_TestSetup( interp, "vmtest_interpreted", jumpTable );
+	VM_PrepareInterpreter( interp, vmt_header );
+
+	VM_TestSetup( compiled, "vmtest_compiled", jumpTable );
+	compiled->compiled = qtrue;
+	VM_Compile( compiled, vmt_header );
+	if ( !compiled->compiled ) {
+		Com_Printf( "vmtest: program %i failed to compile\n", seed );
+		return 1;
+	}
+
+	for ( k = 0 ; k < VMT_CALLS ; k++ ) {
+		args[k][0] = Q_rand( &vmt_prog->seed );
+		args[k][1] = Q_rand( &vmt_prog->seed );
+		args[k][2] = VMT_Rand( 256 );
+
+		for ( i = 0 ; i < 2 ; i++ ) {
+			vmt_reentry = 0;
+			result[i] = VM_Call( &vmt_vms[i], 0, args[k][0], args[k][1], args[k][2] );
+		}
+
+		if ( result[0] != result[1] ) {
+			Com_Printf( S_COLOR_RED "vmtest: program %i call %i returned %i interpreted, %i compiled\n",
+				seed, k, result[0], result[1] );
+			return 1;
+		}
+
+		if ( interp->programStack != compiled->programStack ) {
+			Com_Printf( S_COLOR_RED "vmtest: program %i call %i left programStack at %i interpreted, %i compiled\n",
+				seed, k, interp->programStack, compiled->programStack );
+			return 1;
+		}
+
+		// the program stack also holds system call numbers and unused vmMain
+		// arguments, which differ between the interpreter and the compilers
+		for ( j = 0 ; j < VMT_GLOBALS_SIZE ; j += 4 ) {
+			if ( *(int *)( interp->dataBase + j ) != *(int *)( compiled->dataBase + j ) ) {
+				Com_Printf( S_COLOR_RED "vmtest: program %i call %i data at 0x%x is 0x%x interpreted, 0x%x compiled\n",
+					seed, k, j, *(int *)( interp->dataBase + j ), *(int *)( compiled->dataBase + j ) );
+				return 1;
+			}
+		}
+	}
+
+	// run the same calls again to time both
+	for ( i = 0 ; i < 2 && vmt_repeat > 0 ; i++ ) {
+		start = Sys_Milliseconds();
+		for ( j = 0 ; j < vmt_repeat ; j++ ) {
+			for ( k = 0 ; k < VMT_CALLS ; k++ ) {
+				vmt_reentry = 0;
+				VM_Call( &vmt_vms[i], 0, args[k][0], args[k][1], args[k][2] );
+			}
+		}
+		vmt_msec[i] += Sys_Milliseconds() - start;
+	}
+
+	return 0;
+}
+
+/*
+=================
+VM_Test_f
+
+vmtest [programs] [seed] [repeat]
+
+With a repeat count, the calls of every program are run that many more
+times on both machines and the total time of each is printed.
+=================
+*/
+void VM_Test_f( void ) {
+#ifdef NO_VM_COMPILED
+	Com_Printf( "vmtest: no bytecode compiler for this architecture\n" );
+#else
+	int		i, count, seed, failed, tested;
+
+	count = Cmd_Argc() > 1 ? atoi( Cmd_Argv( 1 ) ) : 100;
+	seed = Cmd_Argc() > 2 ? atoi( Cmd_Argv( 2 ) ) : Com_Milliseconds();
+	vmt_repeat = Cmd_Argc() > 3 ? atoi( Cmd_Argv( 3 ) ) : 0;
+	vmt_msec[0] = vmt_msec[1] = 0;
+
+	VM_TestFree();
+
+	failed = tested = 0;
+	for ( i = 0 ; i < count ; i++ ) {
+		// the interpreted code stays on the hunk until the next map change
+		if ( Hunk_MemoryRemaining() < 4 * VMT_MAX_CODE + 0x100000 ) {
+			Com_Printf( "vmtest: hunk is full, stopping\n" );
+			break;
+		}
+		failed += VM_TestProgram( seed + i );
+		tested++;
+	}
+
+	VM_TestFree();
+
+	Com_Printf( "vmtest: %i programs from seed %i, %i failed\n", tested, seed, failed );
+	if ( vmt_repeat > 0 ) {
+		Com_Printf( "vmtest: %i runs each, %i msec interpreted, %i msec compiled\n",
+			vmt_repeat, vmt_msec[0], vmt_msec[1] );
+	}
+#endif
+}
@@ -635,6 +635,27 @@ void EmitJumpIns(vm_t *vm, const char *jmpop, int cdest)
 		compiledOfs += 4;
 }
 
+/*
+=================
+EmitStoreReturn
+Save the instruction number the call returns to at programStack, the
+way the interpreter does, so the VM profiler can walk the program stack
+=================
+*/
+
+void EmitStoreReturn(vm_t *vm, int ret)
+{
+	EmitString("89 F2");			// mov edx, esi
+	MASK_REG("E2", vm->dataMask);		// and edx, 0x12345678
+#if idx64
+	EmitRexString(0x41, "C7 04 11");	// mov dword ptr [r9 + edx], 0x12345678
+#else
+	EmitString("C7 82");			// mov dword ptr [edx + 0x12345678], 0x12345678
+	Emit4((intptr_t) vm->dataBase);
+#endif
+	Emit4(ret);
+}
+
 /*
 =================
 EmitCallIns
@@ -1049,6 +1070,7 @@ qboolean ConstOptimize(vm_t *vm, int callProcOfsSyscall)
 
 	case OP_CALL:
 		v = Constant4();
+		EmitStoreReturn(vm, instruction + 1);
 		EmitCallConst(vm, v, callProcOfsSyscall);
 
 		pc += 1;                  // OP_CALL
@@ -1062,6 +1084,782 @@ qboolean ConstOptimize(vm_t *vm, int callProcOfsSyscall)
 	return qfalse;
 }
 
+/*
+=================
+Opstack cache
+
+With vm_optimize set, the top entries of the opStack are tracked at compile
+time instead of being written out by every instruction. Constants and local
+addresses are folded into the instructions that consume them and results are
+kept in eax, ecx and edx. The cache is written back to the opStack before
+jump labels, calls and every instruction left to the regular templates.
+
+This needs the jump table targets of the QVM to know where the labels are.
+=================
+*/
+
+#define CACHE_MAX	8	// max number of opStack entries held by the cache
+#define CACHE_MAXOFS	16	// max pending change of the opStack offset
+#define CACHE_MARGIN	256	// max code size emitted for a single instruction
+
+#define REG_COUNT	3	// eax, ecx and edx
+
+typedef enum
+{
+	CACHE_CONST,		// constant value
+	CACHE_LOCAL,		// programStack + value
+	CACHE_REG,		// value in register
+	CACHE_MEM		// value on the opStack at byte offset value, popped entries only
+} cacheType_t;
+
+typedef struct
+{
+	cacheType_t	type;
+	int		value;
+	int		reg;
+} cacheEntry_t;
+
+static	qboolean	optimize;
+static	cacheEntry_t	cache[CACHE_MAX];
+static	int		cacheCount;
+static	int		cacheOfs;	// opStack offset change not yet applied to bl
+static	int		regsUsed;
+
+static void EmitModRM(int mod, int reg, int rm)
+{
+	Emit1((mod << 6) | (reg << 3) | rm);
+}
+
+// [edi + ebx * 4 + disp]
+static void EmitOpStackRM(int reg, int disp)
+{
+	if(disp)
+	{
+		EmitModRM(1, reg, 4);
+		Emit1(0x9F);
+		Emit1(disp);
+	}
+	else
+	{
+		EmitModRM(0, reg, 4);
+		Emit1(0x9F);
+	}
+}
+
+// [dataBase + base]
+static void EmitDataRM(vm_t *vm, const char *prefix, const char *opcode, int reg, int base)
+{
+	if(prefix)
+		EmitString(prefix);
+#if idx64
+	EmitRexString(0x41, opcode);
+	EmitModRM(0, reg, 4);
+	Emit1((base << 3) | 1);			// [r9 + base]
+#else
+	EmitString(opcode);
+	EmitModRM(2, reg, base);		// [base + 0x12345678]
+	Emit4((intptr_t) vm->dataBase);
+#endif
+}
+
+// [dataBase + (addr & dataMask)]
+static void EmitDataConstRM(vm_t *vm, const char *prefix, const char *opcode, int reg, int addr)
+{
+	if(prefix)
+		EmitString(prefix);
+#if idx64
+	EmitRexString(0x41, opcode);
+	EmitModRM(2, reg, 1);			// [r9 + 0x12345678]
+	Emit4(addr & vm->dataMask);
+#else
+	EmitString(opcode);
+	EmitModRM(0, reg, 5);			// [0x12345678]
+	Emit4((intptr_t) (vm->dataBase + (addr & vm->dataMask)));
+#endif
+}
+
+static void EmitMovRegImm(int reg, int v)
+{
+	if(v)
+	{
+		Emit1(0xB8 + reg);		// mov reg, 0x12345678
+		Emit4(v);
+	}
+	else
+	{
+		Emit1(0x31);			// xor reg, reg
+		EmitModRM(3, reg, reg);
+	}
+}
+
+static void EmitLeaLocal(int reg, int v)
+{
+	Emit1(0x8D);				// lea reg, [esi + 0x12345678]
+	EmitModRM(2, reg, 6);
+	Emit4(v);
+}
+
+// ext is the opcode extension of the 0x81/0x83 group: add, or, adc, sbb, and, sub, xor, cmp
+static void EmitAluRegImm(int ext, int reg, int v)
+{
+	if(iss8(v))
+	{
+		Emit1(0x83);			// op reg, 0x7F
+		EmitModRM(3, ext, reg);
+		Emit1(v);
+	}
+	else
+	{
+		Emit1(0x81);			// op reg, 0x12345678
+		EmitModRM(3, ext, reg);
+		Emit4(v);
+	}
+}
+
+static void CacheFreeReg(int reg)
+{
+	regsUsed &= ~(1 << reg);
+}
+
+static int CacheFindReg(void)
+{
+	int reg;
+
+	for(reg = 0; reg < REG_COUNT; reg++)
+	{
+		if(!(regsUsed & (1 << reg)))
+			return reg;
+	}
+
+	return -1;
+}
+
+/*
+=================
+CacheStore
+Write a cache entry to the opStack at [edi + ebx * 4 + disp]
+=================
+*/
+static void CacheStore(cacheEntry_t *e, int disp)
+{
+	int reg;
+
+	switch(e->type)
+	{
+	case CACHE_CONST:
+		Emit1(0xC7);				// mov dword ptr [edi + ebx * 4 + disp], 0x12345678
+		EmitOpStackRM(0, disp);
+		Emit4(e->value);
+		break;
+	case CACHE_LOCAL:
+		reg = CacheFindReg();
+		if(reg >= 0)
+		{
+			EmitLeaLocal(reg, e->value);	// lea reg, [esi + 0x12345678]
+			Emit1(0x89);			// mov dword ptr [edi + ebx * 4 + disp], reg
+			EmitOpStackRM(reg, disp);
+		}
+		else
+		{
+			Emit1(0x89);			// mov dword ptr [edi + ebx * 4 + disp], esi
+			EmitOpStackRM(6, disp);
+			Emit1(0x81);			// add dword ptr [edi + ebx * 4 + disp], 0x12345678
+			EmitOpStackRM(0, disp);
+			Emit4(e->value);
+		}
+		break;
+	case CACHE_REG:
+		Emit1(0x89);				// mov dword ptr [edi + ebx * 4 + disp], reg
+		EmitOpStackRM(e->reg, disp);
+		CacheFreeReg(e->reg);
+		break;
+	default:
+		break;
+	}
+}
+
+/*
+=================
+CacheSpill
+Write the bottom entry of the cache to the opStack
+=================
+*/
+static void CacheSpill(void)
+{
+	CacheStore(&cache[0], 4 * (cacheOfs - cacheCount + 1));
+	cacheCount--;
+	memmove(cache, cache + 1, cacheCount * sizeof(cache[0]));
+}
+
+/*
+=================
+CacheFlush
+Write all entries to the opStack, the opStack offset may still be pending
+=================
+*/
+static void CacheFlush(void)
+{
+	int i;
+
+	// registers first, so they are free again for CACHE_LOCAL entries
+	for(i = 0; i < cacheCount; i++)
+	{
+		if(cache[i].type == CACHE_REG)
+			CacheStore(&cache[i], 4 * (cacheOfs - cacheCount + 1 + i));
+	}
+	for(i = 0; i < cacheCount; i++)
+	{
+		if(cache[i].type != CACHE_REG)
+			CacheStore(&cache[i], 4 * (cacheOfs - cacheCount + 1 + i));
+	}
+
+	cacheCount = 0;
+}
+
+/*
+=================
+CacheAdjust
+Apply the pending opStack offset change to bl
+=================
+*/
+static void CacheAdjust(void)
+{
+	if(cacheOfs > 0)
+		STACK_PUSH(cacheOfs);		// add bl, cacheOfs
+	else if(cacheOfs < 0)
+		STACK_POP(-cacheOfs);		// sub bl, -cacheOfs
+
+	cacheOfs = 0;
+}
+
+/*
+=================
+CacheSync
+Bring the opStack into the state the regular templates expect
+=================
+*/
+static void CacheSync(void)
+{
+	CacheFlush();
+	CacheAdjust();
+}
+
+static int CacheAllocReg(void)
+{
+	int reg;
+
+	while((reg = CacheFindReg()) < 0)
+	{
+		if(!cacheCount)
+		{
+			VMFREE_BUFFERS();
+			Com_Error(ERR_DROP, "VM_CompileX86: out of registers at offset %d", pc);
+		}
+
+		CacheSpill();
+	}
+
+	regsUsed |= 1 << reg;
+
+	return reg;
+}
+
+static void CachePush(cacheType_t type, int value, int reg)
+{
+	cacheEntry_t *e;
+
+	if(cacheCount == CACHE_MAX)
+		CacheSpill();
+
+	e = &cache[cacheCount++];
+	e->type = type;
+	e->value = value;
+	e->reg = reg;
+
+	cacheOfs++;
+}
+
+// the register of a popped CACHE_REG entry stays allocated until freed by the caller
+static void CachePop(cacheEntry_t *e)
+{
+	if(cacheCount)
+		*e = cache[--cacheCount];
+	else
+	{
+		e->type = CACHE_MEM;
+		e->value = 4 * cacheOfs;
+		e->reg = -1;
+	}
+
+	cacheOfs--;
+}
+
+/*
+=================
+CacheLoadReg
+Make sure a popped entry is held in a register and return it
+=================
+*/
+static int CacheLoadReg(cacheEntry_t *e)
+{
+	int reg;
+
+	if(e->type == CACHE_REG)
+		return e->reg;
+
+	reg = CacheAllocReg();
+
+	switch(e->type)
+	{
+	case CACHE_CONST:
+		EmitMovRegImm(reg, e->value);		// mov reg, 0x12345678
+		break;
+	case CACHE_LOCAL:
+		EmitLeaLocal(reg, e->value);		// lea reg, [esi + 0x12345678]
+		break;
+	case CACHE_MEM:
+		Emit1(0x8B);				// mov reg, dword ptr [edi + ebx * 4 + disp]
+		EmitOpStackRM(reg, e->value);
+		break;
+	default:
+		break;
+	}
+
+	e->type = CACHE_REG;
+	e->reg = reg;
+
+	return reg;
+}
+
+static int FoldConst(int op, int a, int b)
+{
+	switch(op)
+	{
+	case OP_ADD:
+		return (unsigned) a + (unsigned) b;
+	case OP_SUB:
+		return (unsigned) a - (unsigned) b;
+	case OP_MULI:
+	case OP_MULU:
+		return (unsigned) a * (unsigned) b;
+	case OP_BAND:
+		return a & b;
+	case OP_BOR:
+		return a | b;
+	case OP_BXOR:
+		return a ^ b;
+	case OP_LSH:
+		return (unsigned) a << (b & 31);
+	case OP_RSHI:
+		return a >> (b & 31);
+	case OP_RSHU:
+		return (unsigned) a >> (b & 31);
+	case OP_NEGI:
+		return -(unsigned) a;
+	case OP_BCOM:
+		return ~a;
+	case OP_SEX8:
+		return (signed char) a;
+	case OP_SEX16:
+		return (short) a;
+	default:
+		return 0;
+	}
+}
+
+// opcode extension for the 0x81/0x83 group, opcode for the reg, reg form
+static void AluOpcodes(int op, int *ext, int *opcode)
+{
+	switch(op)
+	{
+	case OP_ADD:
+		*ext = 0;
+		*opcode = 0x01;
+		break;
+	case OP_BOR:
+		*ext = 1;
+		*opcode = 0x09;
+		break;
+	case OP_BAND:
+		*ext = 4;
+		*opcode = 0x21;
+		break;
+	case OP_SUB:
+		*ext = 5;
+		*opcode = 0x29;
+		break;
+	default:
+		*ext = 6;
+		*opcode = 0x31;
+		break;
+	}
+}
+
+/*
+=================
+OptimizeInstruction
+Translate an instruction through the opStack cache. Returns qfalse,
+without consuming any operands, if the regular template is needed.
+=================
+*/
+static qboolean OptimizeInstruction(vm_t *vm, int op, int callProcOfsSyscall)
+{
+	cacheEntry_t a, b, *top;
+	int ra, rb, v, ext, opcode;
+	const char *prefix, *store, *load;
+
+	if(cacheOfs > CACHE_MAXOFS || cacheOfs < -CACHE_MAXOFS)
+		CacheAdjust();
+
+	top = cacheCount ? &cache[cacheCount - 1] : NULL;
+
+	switch(op)
+	{
+	case OP_UNDEF:
+		return qtrue;
+
+	case OP_CONST:
+		v = Constant4();
+		if(code[pc] == OP_JUMP)
+			JUSED(v);
+
+		CachePush(CACHE_CONST, v, 0);
+		return qtrue;
+
+	case OP_LOCAL:
+		CachePush(CACHE_LOCAL, Constant4(), 0);
+		return qtrue;
+
+	case OP_PUSH:
+		CacheFlush();
+		cacheOfs++;
+		return qtrue;
+
+	case OP_POP:
+		CachePop(&a);
+		if(a.type == CACHE_REG)
+			CacheFreeReg(a.reg);
+		return qtrue;
+
+	case OP_LOAD4:
+	case OP_LOAD2:
+	case OP_LOAD1:
+		if(op == OP_LOAD4)
+			load = "8B";				// mov reg, dword ptr []
+		else if(op == OP_LOAD2)
+			load = "0F B7";				// movzx reg, word ptr []
+		else
+			load = "0F B6";				// movzx reg, byte ptr []
+
+		CachePop(&a);
+		if(a.type == CACHE_CONST)
+		{
+			ra = CacheAllocReg();
+			EmitDataConstRM(vm, NULL, load, ra, a.value);
+		}
+		else
+		{
+			ra = CacheLoadReg(&a);
+			EmitAluRegImm(4, ra, vm->dataMask);	// and reg, dataMask
+			EmitDataRM(vm, NULL, load, ra, ra);
+		}
+
+		CachePush(CACHE_REG, 0, ra);
+		return qtrue;
+
+	case OP_STORE4:
+	case OP_STORE2:
+	case OP_STORE1:
+		CachePop(&b);
+		CachePop(&a);
+
+		if(b.type != CACHE_CONST)
+			CacheLoadReg(&b);
+
+		prefix = (op == OP_STORE2) ? "66" : NULL;
+		if(b.type == CACHE_CONST)
+			store = (op == OP_STORE1) ? "C6" : "C7";	// mov ptr [], 0x12345678
+		else
+			store = (op == OP_STORE1) ? "88" : "89";	// mov ptr [], reg
+
+		if(a.type == CACHE_CONST)
+			EmitDataConstRM(vm, prefix, store, b.type == CACHE_CONST ? 0 : b.reg, a.value);
+		else
+		{
+			ra = CacheLoadReg(&a);
+			EmitAluRegImm(4, ra, vm->dataMask);	// and reg, dataMask
+			EmitDataRM(vm, prefix, store, b.type == CACHE_CONST ? 0 : b.reg, ra);
+			CacheFreeReg(ra);
+		}
+
+		if(b.type == CACHE_CONST)
+		{
+			if(op == OP_STORE4)
+				Emit4(b.value);
+			else if(op == OP_STORE2)
+				Emit2(b.value);
+			else
+				Emit1(b.value);
+		}
+		else
+			CacheFreeReg(b.reg);
+
+		return qtrue;
+
+	case OP_ARG:
+		CachePop(&b);
+		if(b.type != CACHE_CONST)
+			CacheLoadReg(&b);
+
+		ra = CacheAllocReg();
+		EmitLeaLocal(ra, Constant1() & 0xFF);		// lea reg, [esi + 0x12]
+		EmitAluRegImm(4, ra, vm->dataMask);		// and reg, dataMask
+
+		if(b.type == CACHE_CONST)
+		{
+			EmitDataRM(vm, NULL, "C7", 0, ra);	// mov dword ptr [reg], 0x12345678
+			Emit4(b.value);
+		}
+		else
+		{
+			EmitDataRM(vm, NULL, "89", b.reg, ra);	// mov dword ptr [reg], reg
+			CacheFreeReg(b.reg);
+		}
+
+		CacheFreeReg(ra);
+		return qtrue;
+
+	case OP_LSH:
+	case OP_RSHI:
+	case OP_RSHU:
+		// variable shifts need cl, leave them to the templates
+		if(!top || top->type != CACHE_CONST)
+			return qfalse;
+		// fall through
+	case OP_ADD:
+	case OP_SUB:
+	case OP_BAND:
+	case OP_BOR:
+	case OP_BXOR:
+	case OP_MULI:
+	case OP_MULU:
+		CachePop(&b);
+		CachePop(&a);
+
+		if(a.type == CACHE_CONST && b.type == CACHE_CONST)
+		{
+			CachePush(CACHE_CONST, FoldConst(op, a.value, b.value), 0);
+			return qtrue;
+		}
+
+		// address arithmetic on locals
+		if(a.type == CACHE_LOCAL && b.type == CACHE_CONST && (op == OP_ADD || op == OP_SUB))
+		{
+			CachePush(CACHE_LOCAL, FoldConst(op, a.value, b.value), 0);
+			return qtrue;
+		}
+		if(a.type == CACHE_CONST && b.type == CACHE_LOCAL && op == OP_ADD)
+		{
+			CachePush(CACHE_LOCAL, FoldConst(op, a.value, b.value), 0);
+			return qtrue;
+		}
+
+		if(a.type == CACHE_CONST && op != OP_SUB && op != OP_LSH && op != OP_RSHI && op != OP_RSHU)
+		{
+			cacheEntry_t t = a;
+			a = b;
+			b = t;
+		}
+
+		ra = CacheLoadReg(&a);
+
+		if(b.type == CACHE_CONST)
+		{
+			v = b.value;
+
+			switch(op)
+			{
+			case OP_BAND:
+				if(v != -1)
+					EmitAluRegImm(4, ra, v);	// and reg, 0x12345678
+				break;
+			case OP_MULI:
+			case OP_MULU:
+				if(v == 1)
+					break;
+
+				Emit1(iss8(v) ? 0x6B : 0x69);	// imul reg, reg, 0x12345678
+				EmitModRM(3, ra, ra);
+				if(iss8(v))
+					Emit1(v);
+				else
+					Emit4(v);
+				break;
+			case OP_LSH:
+			case OP_RSHI:
+			case OP_RSHU:
+				if(!(v & 31))
+					break;
+
+				Emit1(0xC1);			// shl/sar/shr reg, 0x12
+				EmitModRM(3, op == OP_LSH ? 4 : (op == OP_RSHI ? 7 : 5), ra);
+				Emit1(v & 31);
+				break;
+			default:
+				if(!v)
+					break;
+
+				AluOpcodes(op, &ext, &opcode);
+				EmitAluRegImm(ext, ra, v);	// op reg, 0x12345678
+				break;
+			}
+		}
+		else
+		{
+			rb = CacheLoadReg(&b);
+
+			if(op == OP_MULI || op == OP_MULU)
+			{
+				EmitString("0F AF");		// imul reg, reg
+				EmitModRM(3, ra, rb);
+			}
+			else
+			{
+				AluOpcodes(op, &ext, &opcode);
+				Emit1(opcode);			// op reg, reg
+				EmitModRM(3, rb, ra);
+			}
+
+			CacheFreeReg(rb);
+		}
+
+		CachePush(CACHE_REG, 0, ra);
+		return qtrue;
+
+	case OP_NEGI:
+	case OP_BCOM:
+	case OP_SEX8:
+	case OP_SEX16:
+		CachePop(&a);
+
+		if(a.type == CACHE_CONST)
+		{
+			CachePush(CACHE_CONST, FoldConst(op, a.value, 0), 0);
+			return qtrue;
+		}
+
+		ra = CacheLoadReg(&a);
+
+		switch(op)
+		{
+		case OP_NEGI:
+			Emit1(0xF7);				// neg reg
+			EmitModRM(3, 3, ra);
+			break;
+		case OP_BCOM:
+			Emit1(0xF7);				// not reg
+			EmitModRM(3, 2, ra);
+			break;
+		case OP_SEX8:
+			EmitString("0F BE");			// movsx reg, reg8
+			EmitModRM(3, ra, ra);
+			break;
+		case OP_SEX16:
+			EmitString("0F BF");			// movsx reg, reg16
+			EmitModRM(3, ra, ra);
+			break;
+		}
+
+		CachePush(CACHE_REG, 0, ra);
+		return qtrue;
+
+	case OP_EQ:
+	case OP_NE:
+	case OP_LTI:
+	case OP_LEI:
+	case OP_GTI:
+	case OP_GEI:
+	case OP_LTU:
+	case OP_LEU:
+	case OP_GTU:
+	case OP_GEU:
+		CachePop(&b);
+		CachePop(&a);
+
+		ra = CacheLoadReg(&a);
+		if(b.type != CACHE_CONST)
+			CacheLoadReg(&b);
+
+		// the branch target and the next instruction expect a synced opStack
+		CacheSync();
+
+		if(b.type == CACHE_CONST && !b.value)
+		{
+			Emit1(0x85);				// test reg, reg
+			EmitModRM(3, ra, ra);
+		}
+		else if(b.type == CACHE_CONST)
+			EmitAluRegImm(7, ra, b.value);		// cmp reg, 0x12345678
+		else
+		{
+			Emit1(0x39);				// cmp reg, reg
+			EmitModRM(3, b.reg, ra);
+			CacheFreeReg(b.reg);
+		}
+		CacheFreeReg(ra);
+
+		EmitBranchConditions(vm, op);
+		return qtrue;
+
+	case OP_EQF:
+	case OP_NEF:
+		// comparison with 0.0f can be done on the integer bits
+		if(!top || top->type != CACHE_CONST || top->value)
+			return qfalse;
+
+		CachePop(&b);
+		CachePop(&a);
+
+		ra = CacheLoadReg(&a);
+		CacheSync();
+
+		Emit1(0xF7);					// test reg, 0x7FFFFFFF
+		EmitModRM(3, 0, ra);
+		Emit4(0x7FFFFFFF);
+		CacheFreeReg(ra);
+
+		if(op == OP_EQF)
+			EmitJumpIns(vm, "0F 84", Constant4());	// jz 0x12345678
+		else
+			EmitJumpIns(vm, "0F 85", Constant4());	// jnz 0x12345678
+		return qtrue;
+
+	case OP_CALL:
+		if(!top || top->type != CACHE_CONST)
+			return qfalse;
+
+		CachePop(&a);
+		CacheSync();
+		EmitStoreReturn(vm, instruction);
+		EmitCallConst(vm, a.value, callProcOfsSyscall);
+		return qtrue;
+
+	case OP_JUMP:
+		if(!top || top->type != CACHE_CONST)
+			return qfalse;
+
+		CachePop(&a);
+		CacheSync();
+		EmitJumpIns(vm, "E9", a.value);			// jmp 0x12345678
+		return qtrue;
+
+	default:
+		break;
+	}
+
+	return qfalse;
+}
+
 /*
 =================
 VM_Compile
@@ -1077,8 +1875,13 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 
 	jusedSize = header->instructionCount + 2;
 
+	// the opStack cache relies on knowing all jump targets
+	optimize = vm_optimize->integer && vm->jumpTableTargets;
+
 	// allocate a very large temp buffer, we will shrink it later
 	maxLength = header->codeLength * 8 + 64;
+	if(optimize)
+		maxLength += header->codeLength * 8 + CACHE_MARGIN;
 	buf = Z_Malloc(maxLength);
 	jused = Z_Malloc(jusedSize);
 	code = Z_Malloc(header->codeLength+32);
@@ -1121,14 +1924,25 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 
 	LastCommand = LAST_COMMAND_NONE;
 
+	cacheCount = 0;
+	cacheOfs = 0;
+	regsUsed = 0;
+
 	while(instruction < header->instructionCount)
 	{
-		if(compiledOfs > maxLength - 16)
+		if(compiledOfs > maxLength - (optimize ? CACHE_MARGIN : 32))
 		{
 	        	VMFREE_BUFFERS();
 			Com_Error(ERR_DROP, "VM_CompileX86: maxLength exceeded");
 		}
 
+		if(optimize && jused[instruction])
+		{
+			// jump labels expect everything on the opStack
+			CacheSync();
+			LastCommand = LAST_COMMAND_NONE;
+		}
+
 		vm->instructionPointers[ instruction ] = compiledOfs;
 
 		if ( !vm->jumpTableTargets )
@@ -1146,6 +1960,19 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 
 		op = code[ pc ];
 		pc++;
+
+		if(optimize)
+		{
+			if(OptimizeInstruction(vm, op, callProcOfsSyscall))
+			{
+				pop0 = pop1;
+				pop1 = OP_UNDEF;
+				continue;
+			}
+
+			CacheSync();
+		}
+
 		switch ( op ) {
 		case 0:
 			break;
@@ -1192,6 +2019,7 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 			EmitCommand(LAST_COMMAND_SUB_BL_1);		// sub bl, 1
 			break;
 		case OP_CALL:
+			EmitStoreReturn(vm, instruction);
 			EmitCallRel(vm, callProcOfs);
 			break;
 		case OP_PUSH:
@@ -1643,6 +2471,9 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 		pop0 = pop1;
 		pop1 = op;
 	}
+
+	if(optimize)
+		CacheSync();
 	}
 
 	// copy to an exact sized buffer with the appropriate permission bits
@@ -0,0 +1,368 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// zone_test.c -- records the zone allocations of a real game and replays
+// them with and without the slabs
+
+/*
+
+zonebench record <name>
+zonebench stop
+zonebench replay <name> [repeat]
+
+Keeps every Z_TagMalloc and Z_Free that is made until stopped, and then
+writes them to zonelogs/<name>.zlog.  The log is kept in system memory while
+recording, so that writing it doesn't show up in it.
+
+Replaying makes the same allocations and frees in the same order, first
+with the slabs turned off, so every block comes from the first fit block
+list, and then with them on.  Frees of blocks that were allocated before
+recording started are left out, and whatever is still allocated at the end
+of the log is freed afterwards.  Both runs are timed over repeat passes
+(1 by default), and for each the most main zone memory that was in use
+above what was in use when the replay started is printed.
+
+*/
+
+#include "q_shared.h"
+#include "qcommon.h"
+
+#define	ZONELOG_IDENT	(('G'<<24)+('L'<<16)+('Z'<<8)+'Q')
+#define	ZONELOG_VERSION	1
+
+typedef struct {
+	int		ident;
+	int		version;
+	int		numOps;
+} zoneLogHeader_t;
+
+typedef struct {
+	int		size;		// -1 for a free
+	int		tag;
+	uint64_t	ptr;		// where the block was, to pair frees with allocations
+} zoneLogOp_t;
+
+typedef struct {
+	int		size;		// -1 for a free, -2 for a free that is left out
+	int		tag;
+	int		block;		// number of the allocation
+} zoneReplayOp_t;
+
+qboolean		z_recordAllocs;
+
+static zoneLogOp_t	*zl_ops;
+static int			zl_numOps;
+static int			zl_maxOps;
+static char			zl_path[MAX_QPATH];
+
+/*
+================
+ZL_AddOp
+
+Called from inside the zone, so this can't allocate from it or print
+================
+*/
+static void ZL_AddOp( void *ptr, int size, int tag ) {
+	zoneLogOp_t	*ops;
+
+	if ( zl_numOps == zl_maxOps ) {
+		ops = realloc( zl_ops, ( zl_maxOps + 65536 ) * sizeof( *ops ) );
+		if ( !ops ) {
+			// ZL_Stop will report it
+			z_recordAllocs = qfalse;
+			return;
+		}
+		zl_ops = ops;
+		zl_maxOps += 65536;
+	}
+
+	zl_ops[zl_numOps].size = size;
+	zl_ops[zl_numOps].tag = tag;
+	zl_ops[zl_numOps].ptr = (uint64_t)(intptr_t)ptr;
+	zl_numOps++;
+}
+
+/*
+================
+Z_RecordAlloc
+================
+*/
+void Z_RecordAlloc( void *ptr, int size, int tag ) {
+	ZL_AddOp( ptr, size, tag );
+}
+
+/*
+================
+Z_RecordFree
+================
+*/
+void Z_RecordFree( void *ptr ) {
+	ZL_AddOp( ptr, -1, 0 );
+}
+
+/*
+================
+ZL_Record
+================
+*/
+static void ZL_Record( const char *name ) {
+	if ( zl_path[0] ) {
+		Com_Printf( "zonebench: already recording\n" );
+		return;
+	}
+
+	Com_sprintf( zl_path, sizeof( zl_path ), "zonelogs/%s.zlog", name );
+	zl_numOps = 0;
+	z_recordAllocs = qtrue;
+
+	Com_Printf( "zonebench: recording to %s\n", zl_path );
+}
+
+/*
+================
+ZL_Stop
+================
+*/
+static void ZL_Stop( void ) {
+	zoneLogHeader_t	header;
+	fileHandle_t	f;
+	qboolean		complete;
+
+	if ( !zl_path[0] ) {
+		Com_Printf( "zonebench: not recording\n" );
+		return;
+	}
+	complete = z_recordAllocs;
+	z_recordAllocs = qfalse;
+
+	if ( !complete ) {
+		Com_Printf( "zonebench: ran out of memory after %i allocations and frees\n", zl_numOps );
+	} else {
+		f = FS_FOpenFileWrite( zl_path );
+		if ( !f ) {
+			Com_Printf( "zonebench: couldn't open %s\n", zl_path );
+		} else {
+			header.ident = ZONELOG_IDENT;
+			header.version = ZONELOG_VERSION;
+			header.numOps = zl_numOps;
+			FS_Write( &header, sizeof( header ), f );
+			FS_Write( zl_ops, zl_numOps * sizeof( *zl_ops ), f );
+			FS_FCloseFile( f );
+			Com_Printf( "zonebench: wrote %i allocations and frees to %s\n", zl_numOps, zl_path );
+		}
+	}
+
+	free( zl_ops );
+	zl_ops = NULL;
+	zl_numOps = zl_maxOps = 0;
+	zl_path[0] = 0;
+}
+
+/*
+================
+ZL_PairOps
+
+Numbers the allocations of the log and points each free at the allocation
+it frees, so that the replay doesn't have to look up pointers.  Returns the
+number of allocations.
+================
+*/
+static int ZL_PairOps( const zoneLogOp_t *log, zoneReplayOp_t *ops, int numOps ) {
+	uint64_t	*keys;
+	int			*values;
+	int			hashSize, numBlocks, i, h;
+
+	for ( hashSize = 1024 ; hashSize < numOps * 2 ; hashSize <<= 1 ) {
+	}
+	keys = malloc( hashSize * sizeof( *keys ) );
+	values = malloc( hashSize * sizeof( *values ) );
+	if ( !keys || !values ) {
+		free( keys );
+		free( values );
+		return -1;
+	}
+	for ( i = 0 ; i < hashSize ; i++ ) {
+		values[i] = -1;
+	}
+
+	// an address is only ever in the table once, a new allocation at it
+	// replaces the one that was freed
+	numBlocks = 0;
+	for ( i = 0 ; i < numOps ; i++ ) {
+		h = (int)( ( log[i].ptr * 0x9E3779B97F4A7C15ULL ) >> 40 ) & ( hashSize - 1 );
+		while ( values[h] != -1 && keys[h] != log[i].ptr ) {
+			h = ( h + 1 ) & ( hashSize - 1 );
+		}
+
+		ops[i].tag = log[i].tag;
+		if ( log[i].size >= 0 ) {
+			keys[h] = log[i].ptr;
+			values[h] = numBlocks;
+			ops[i].size = log[i].size;
+			ops[i].block = numBlocks++;
+		} else if ( values[h] >= 0 && keys[h] == log[i].ptr ) {
+			ops[i].size = -1;
+			ops[i].block = values[h];
+			values[h] = -2;		// keeps the probe chain, can't be freed twice
+		} else {
+			ops[i].size = -2;
+			ops[i].block = -1;
+		}
+	}
+
+	free( keys );
+	free( values );
+	return numBlocks;
+}
+
+/*
+================
+ZL_ReplayPass
+
+Returns the most main zone memory used above what was used at the start
+================
+*/
+static int ZL_ReplayPass( const zoneReplayOp_t *ops, int numOps, void **blocks, int numBlocks ) {
+	int		i, avail, lowest;
+
+	Com_Memset( blocks, 0, numBlocks * sizeof( *blocks ) );
+	avail = lowest = Z_AvailableMemory();
+
+	for ( i = 0 ; i < numOps ; i++ ) {
+		if ( ops[i].size >= 0 ) {
+			blocks[ops[i].block] = Z_TagMalloc( ops[i].size, ops[i].tag );
+			if ( Z_AvailableMemory() < lowest ) {
+				lowest = Z_AvailableMemory();
+			}
+		} else if ( ops[i].size == -1 ) {
+			Z_Free( blocks[ops[i].block] );
+			blocks[ops[i].block] = NULL;
+		}
+	}
+
+	for ( i = 0 ; i < numBlocks ; i++ ) {
+		if ( blocks[i] ) {
+			Z_Free( blocks[i] );
+		}
+	}
+
+	return avail - lowest;
+}
+
+/*
+================
+ZL_Replay
+================
+*/
+static void ZL_Replay( const char *name, int repeat ) {
+	const zoneLogHeader_t	*header;
+	zoneReplayOp_t	*ops;
+	void		**blocks;
+	void		*buffer;
+	char		path[MAX_QPATH];
+	qboolean	useSlabs;
+	int			len, numOps, numBlocks, i, pass, start;
+	int			msec[2], peak[2];
+
+	if ( zl_path[0] ) {
+		Com_Printf( "zonebench: can't replay while recording\n" );
+		return;
+	}
+
+	Com_sprintf( path, sizeof( path ), "zonelogs/%s.zlog", name );
+	len = FS_ReadFile( path, &buffer );
+	if ( !buffer ) {
+		Com_Printf( "zonebench: couldn't load %s\n", path );
+		return;
+	}
+
+	header = buffer;
+	if ( len < (int)sizeof( *header ) || header->ident != ZONELOG_IDENT
+		|| header->version != ZONELOG_VERSION
+		|| len != (int)sizeof( *header ) + header->numOps * (int)sizeof( zoneLogOp_t ) ) {
+		Com_Printf( "zonebench: %s is not a zone log\n", path );
+		FS_FreeFile( buffer );
+		return;
+	}
+	numOps = header->numOps;
+
+	ops = Hunk_AllocateTempMemory( numOps * sizeof( *ops ) );
+	numBlocks = ZL_PairOps( (const zoneLogOp_t *)( header + 1 ), ops, numOps );
+	if ( numBlocks < 0 ) {
+		Com_Printf( "zonebench: out of memory\n" );
+		Hunk_FreeTempMemory( ops );
+		FS_FreeFile( buffer );
+		return;
+	}
+	blocks = Hunk_AllocateTempMemory( numBlocks * sizeof( *blocks ) + 1 );
+
+	if ( repeat < 1 ) {
+		repeat = 1;
+	}
+
+	// 0 is the first fit block list, 1 the slabs
+	useSlabs = Z_UseSlabs( qfalse );
+	for ( i = 0 ; i < 2 ; i++ ) {
+		Z_UseSlabs( i );
+		peak[i] = 0;
+
+		start = Sys_Milliseconds();
+		for ( pass = 0 ; pass < repeat ; pass++ ) {
+			peak[i] = MAX( peak[i], ZL_ReplayPass( ops, numOps, blocks, numBlocks ) );
+		}
+		msec[i] = Sys_Milliseconds() - start;
+	}
+	Z_UseSlabs( useSlabs );
+
+	Com_Printf( "zonebench: %i allocations and %i frees\n", numBlocks, numOps - numBlocks );
+	Com_Printf( "zonebench: %i passes, block list %i msec %i bytes peak, slabs %i msec %i bytes peak\n",
+		repeat, msec[0], peak[0], msec[1], peak[1] );
+
+	Hunk_FreeTempMemory( blocks );
+	Hunk_FreeTempMemory( ops );
+	FS_FreeFile( buffer );
+}
+
+/*
+================
+Z_Bench_f
+================
+*/
+void Z_Bench_f( void ) {
+	const char	*cmd;
+
+	cmd = Cmd_Argv( 1 );
+	if ( !Q_stricmp( cmd, "stop" ) ) {
+		ZL_Stop();
+		return;
+	}
+
+	if ( Cmd_Argc() < 3 || ( Q_stricmp( cmd, "record" ) && Q_stricmp( cmd, "replay" ) ) ) {
+		Com_Printf( "usage: zonebench record <name> | stop | replay <name> [repeat]\n" );
+		return;
+	}
+
+	if ( !Q_stricmp( cmd, "record" ) ) {
+		ZL_Record( Cmd_Argv( 2 ) );
+	} else {
+		ZL_Replay( Cmd_Argv( 2 ), Cmd_Argc() > 3 ? atoi( Cmd_Argv( 3 ) ) : 0 );
+	}
+}
@@ -261,6 +261,8 @@ extern void (APIENTRYP qglUnlockArraysEXT) (void);
 	GLE(GLuint, GetUniformBlockIndex, GLuint program, const GLchar *uniformBlockName) \
 	GLE(void, UniformBlockBinding, GLuint program, GLuint uniformBlockIndex, GLuint uniformBlockBinding) \
 	GLE(void, BindBufferBase, GLenum target, GLuint index, GLuint buffer) \
+	GLE(void, BindBufferRange, GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) \
+	GLE(void, DrawElementsInstanced, GLenum mode, GLsizei count, GLenum type, const GLvoid *indices, GLsizei instancecount) \
 	GLE(void, BlitFramebuffer, GLint srcX0, GLint srcY0, GLint srcX1, GLint srcY1, GLint dstX0, GLint dstY0, GLint dstX1, GLint dstY1, GLbitfield mask, GLenum filter) \
 	GLE(void, RenderbufferStorageMultisample, GLenum target, GLsizei samples, GLenum internalformat, GLsizei width, GLsizei height) \
 
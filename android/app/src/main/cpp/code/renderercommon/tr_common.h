@@ -167,5 +167,12 @@ void		GLimp_SetGamma( unsigned char red[256],
 		unsigned char green[256],
 		unsigned char blue[256] );
 
+// SMP
+qboolean	GLimp_SpawnRenderThread( void (*function)( void ) );
+void		GLimp_ShutdownRenderThread( void );
+void		*GLimp_RendererSleep( void );
+void		GLimp_FrontEndSleep( void );
+void		GLimp_WakeRenderer( void *data );
+
 
 #endif
@@ -24,7 +24,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 
 #include "tr_types.h"
 
-#define	REF_API_VERSION		8
+#define	REF_API_VERSION		11
 
 //
 // these are the functions exported by the refresh module
@@ -84,10 +84,14 @@ typedef struct {
 	// if the pointers are not NULL, timing info will be returned
 	void	(*EndFrame)( int *frontEndMsec, int *backEndMsec );
 
+	// waits until the render thread is done with the last frame and the
+	// GL context is back on the calling thread, does nothing without r_smp
+	void	(*SyncRenderThread)( void );
+
 #if __ANDROID__
 	void	(*SetVRHeadsetParms)( const float projectionMatrix[4][4],
 								  const float nonVRProjectionMatrix[4][4],
-								  int renderBuffer );
+								  int renderBuffer, void *vrFrame );
 #endif
 
 	int		(*MarkFragments)( int numPoints, const vec3_t *points, const vec3_t projection,
@@ -167,6 +171,12 @@ typedef struct {
 	void	(*FS_WriteFile)( const char *qpath, const void *buffer, int size );
 	qboolean (*FS_FileExists)( const char *file );
 
+	// decoded images kept between runs, see FS_ReadAssetCache
+	void	*(*FS_ReadAssetCache)( const char *qpath, const char *kind, void *info, int infoSize, int *length,
+				void *(*alloc)( int size ), void (*release)( void *data ) );
+	void	(*FS_WriteAssetCache)( const char *qpath, const char *kind, const void *info, int infoSize,
+				const void *data, int length );
+
 	// cinematic stuff
 	void	(*CIN_UploadCinematic)(int handle);
 	int		(*CIN_PlayCinematic)( const char *arg0, int xpos, int ypos, int width, int height, int bits);
@@ -187,6 +197,9 @@ typedef struct {
 	void	(*Sys_GLimpSafeInit)( void );
 	void	(*Sys_GLimpInit)( void );
 	qboolean (*Sys_LowPhysicalMemory)( void );
+
+	// splits work over the worker threads, see Com_RunJobs
+	void	(*RunJobs)( void (*function)( void *data, int job ), void *data, int numJobs, int numThreads );
 } refimport_t;
 
 
@@ -217,7 +217,7 @@ typedef struct {
 	// used CDS.
 	qboolean				isFullscreen;
 	qboolean				stereoEnabled;
-	qboolean				smpActive;		// UNUSED, present for compatibility
+	qboolean				smpActive;		// back end runs on its own thread, see r_smp
 } glconfig_t;
 
 #endif	// __TR_TYPES_H
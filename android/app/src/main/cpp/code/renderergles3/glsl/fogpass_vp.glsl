@@ -27,7 +27,10 @@ uniform float   u_Time;
 #if defined(USE_VERTEX_ANIMATION)
 uniform float   u_VertexLerp;
 #elif defined(USE_BONE_ANIMATION)
-uniform mat4 u_BoneMatrix[MAX_GLSL_BONES];
+layout(std140) uniform BoneMatrices
+{
+    mat4 u_BoneMatrix[MAX_GLSL_BONES];
+};
 #endif
 
 uniform vec4  u_Color;
@@ -37,6 +37,24 @@ uniform vec4   u_FogColorMask;
 #endif
 
 uniform mat4 u_ModelMatrix;
+uniform int  u_CulledEyes;
+uniform int  u_Instanced;
+
+struct Instance
+{
+	mat4 modelMatrix;
+	vec4 localViewOrigin; // w = culled eyes
+	vec4 ambientLight;
+	vec4 directedLight;
+	vec4 lightOrigin;
+	vec4 modelLightDir;
+};
+
+// the entities of an instanced draw
+layout(std140) uniform Instances
+{
+	Instance u_Instances[MAX_GLSL_INSTANCES];
+};
 
 #if defined(USE_DEFORM_VERTEXES)
 uniform int    u_DeformGen;
@@ -60,7 +78,10 @@ uniform float  u_PortalRange;
 #if defined(USE_VERTEX_ANIMATION)
 uniform float  u_VertexLerp;
 #elif defined(USE_BONE_ANIMATION)
-uniform mat4 u_BoneMatrix[MAX_GLSL_BONES];
+layout(std140) uniform BoneMatrices
+{
+    mat4 u_BoneMatrix[MAX_GLSL_BONES];
+};
 #endif
 
 // Uniforms
@@ -76,6 +97,48 @@ layout(shared) uniform ProjectionMatrix
 varying vec2   var_DiffuseTex;
 varying vec4   var_Color;
 
+// the entity, from u_Instances in instanced draws
+mat4 modelMatrix;
+int  culledEyes;
+#if defined(USE_TCGEN) || defined(USE_RGBAGEN)
+vec3 localViewOrigin;
+#endif
+#if defined(USE_RGBAGEN)
+vec3 ambientLight;
+vec3 directedLight;
+vec3 modelLightDir;
+#endif
+
+void SetupEntity()
+{
+	if (u_Instanced != 0)
+	{
+		modelMatrix     = u_Instances[gl_InstanceID].modelMatrix;
+		culledEyes      = int(u_Instances[gl_InstanceID].localViewOrigin.w);
+#if defined(USE_TCGEN) || defined(USE_RGBAGEN)
+		localViewOrigin = u_Instances[gl_InstanceID].localViewOrigin.xyz;
+#endif
+#if defined(USE_RGBAGEN)
+		ambientLight    = u_Instances[gl_InstanceID].ambientLight.xyz;
+		directedLight   = u_Instances[gl_InstanceID].directedLight.xyz;
+		modelLightDir   = u_Instances[gl_InstanceID].modelLightDir.xyz;
+#endif
+	}
+	else
+	{
+		modelMatrix     = u_ModelMatrix;
+		culledEyes      = u_CulledEyes;
+#if defined(USE_TCGEN) || defined(USE_RGBAGEN)
+		localViewOrigin = u_LocalViewOrigin;
+#endif
+#if defined(USE_RGBAGEN)
+		ambientLight    = u_AmbientLight;
+		directedLight   = u_DirectedLight;
+		modelLightDir   = u_ModelLightDir;
+#endif
+	}
+}
+
 #if defined(USE_DEFORM_VERTEXES)
 vec3 DeformPosition(const vec3 pos, const vec3 normal, const vec2 st)
 {
@@ -137,7 +200,7 @@ vec2 GenTexCoords(int TCGen, vec3 position, vec3 normal, vec3 TCGenVector0, vec3
 	}
 	else if (TCGen == TCGEN_ENVIRONMENT_MAPPED)
 	{
-		vec3 viewer = normalize(u_LocalViewOrigin - position);
+		vec3 viewer = normalize(localViewOrigin - position);
 		vec2 ref = reflect(viewer, normal).yz;
 		tex.s = ref.x * -0.5 + 0.5;
 		tex.t = ref.y *  0.5 + 0.5;
@@ -175,12 +238,12 @@ vec4 CalcColor(vec3 position, vec3 normal)
 	
 	if (u_ColorGen == CGEN_LIGHTING_DIFFUSE)
 	{
-		float incoming = clamp(dot(normal, u_ModelLightDir), 0.0, 1.0);
+		float incoming = clamp(dot(normal, modelLightDir), 0.0, 1.0);
 
-		color.rgb = clamp(u_DirectedLight * incoming + u_AmbientLight, 0.0, 1.0);
+		color.rgb = clamp(directedLight * incoming + ambientLight, 0.0, 1.0);
 	}
 	
-	vec3 viewer = u_LocalViewOrigin - position;
+	vec3 viewer = localViewOrigin - position;
 
 	if (u_AlphaGen == AGEN_LIGHTING_SPECULAR)
 	{
@@ -218,6 +281,15 @@ float CalcFog(vec3 position)
 
 void main()
 {
+	SetupEntity();
+
+	// the model is outside the frustum of this eye, put it outside the clip volume
+	if ((culledEyes & (1 << int(gl_ViewID_OVR))) != 0)
+	{
+		gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+		return;
+	}
+
 #if defined(USE_VERTEX_ANIMATION)
 	vec3 position  = mix(attr_Position, attr_Position2, u_VertexLerp);
 	vec3 normal    = mix(attr_Normal,   attr_Normal2,   u_VertexLerp);
@@ -239,7 +311,7 @@ void main()
 	position = DeformPosition(position, normal, attr_TexCoord0.st);
 #endif
 
-	gl_Position = u_ProjectionMatrix * (u_ViewMatrices[gl_ViewID_OVR] * (u_ModelMatrix * vec4(position, 1.0)));
+	gl_Position = u_ProjectionMatrix * (u_ViewMatrices[gl_ViewID_OVR] * (modelMatrix * vec4(position, 1.0)));
 
 #if defined(USE_TCGEN)
 	vec2 tex = GenTexCoords(u_TCGen0, position, normal, u_TCGen0Vector0, u_TCGen0Vector1);
@@ -43,6 +43,24 @@ uniform vec4   u_DiffuseTexOffTurb;
 
 
 uniform mat4 u_ModelMatrix;
+uniform int  u_CulledEyes;
+uniform int  u_Instanced;
+
+struct Instance
+{
+	mat4 modelMatrix;
+	vec4 localViewOrigin; // w = culled eyes
+	vec4 ambientLight;
+	vec4 directedLight;
+	vec4 lightOrigin;
+	vec4 modelLightDir;
+};
+
+// the entities of an instanced draw
+layout(std140) uniform Instances
+{
+	Instance u_Instances[MAX_GLSL_INSTANCES];
+};
 
 uniform vec4   u_BaseColor;
 uniform vec4   u_VertColor;
@@ -51,7 +69,10 @@ uniform vec4   u_VertColor;
 #if defined(USE_VERTEX_ANIMATION)
 uniform float  u_VertexLerp;
 #elif defined(USE_BONE_ANIMATION)
-uniform mat4 u_BoneMatrix[MAX_GLSL_BONES];
+layout(std140) uniform BoneMatrices
+{
+    mat4 u_BoneMatrix[MAX_GLSL_BONES];
+};
 #endif
 
 #if defined(USE_LIGHT_VECTOR)
@@ -97,6 +118,48 @@ varying vec4   var_LightDir;
 varying vec4   var_PrimaryLightDir;
 #endif
 
+// the entity, from u_Instances in instanced draws
+mat4 modelMatrix;
+int  culledEyes;
+#if defined(USE_TCGEN)
+vec3 localViewOrigin;
+#endif
+#if defined(USE_LIGHT_VECTOR)
+vec4 lightOrigin;
+vec3 directedLight;
+vec3 ambientLight;
+#endif
+
+void SetupEntity()
+{
+	if (u_Instanced != 0)
+	{
+		modelMatrix     = u_Instances[gl_InstanceID].modelMatrix;
+		culledEyes      = int(u_Instances[gl_InstanceID].localViewOrigin.w);
+#if defined(USE_TCGEN)
+		localViewOrigin = u_Instances[gl_InstanceID].localViewOrigin.xyz;
+#endif
+#if defined(USE_LIGHT_VECTOR)
+		lightOrigin     = u_Instances[gl_InstanceID].lightOrigin;
+		directedLight   = u_Instances[gl_InstanceID].directedLight.xyz;
+		ambientLight    = u_Instances[gl_InstanceID].ambientLight.xyz;
+#endif
+	}
+	else
+	{
+		modelMatrix     = u_ModelMatrix;
+		culledEyes      = u_CulledEyes;
+#if defined(USE_TCGEN)
+		localViewOrigin = u_LocalViewOrigin;
+#endif
+#if defined(USE_LIGHT_VECTOR)
+		lightOrigin     = u_LightOrigin;
+		directedLight   = u_DirectedLight;
+		ambientLight    = u_AmbientLight;
+#endif
+	}
+}
+
 #if defined(USE_TCGEN)
 vec2 GenTexCoords(int TCGen, vec3 position, vec3 normal, vec3 TCGenVector0, vec3 TCGenVector1)
 {
@@ -108,7 +171,7 @@ vec2 GenTexCoords(int TCGen, vec3 position, vec3 normal, vec3 TCGenVector0, vec3
 	}
 	else if (TCGen == TCGEN_ENVIRONMENT_MAPPED)
 	{
-		vec3 viewer = normalize(u_LocalViewOrigin - position);
+		vec3 viewer = normalize(localViewOrigin - position);
 		vec2 ref = reflect(viewer, normal).yz;
 		tex.s = ref.x * -0.5 + 0.5;
 		tex.t = ref.y *  0.5 + 0.5;
@@ -159,6 +222,15 @@ float CalcLightAttenuation(float point, float normDist)
 
 void main()
 {
+	SetupEntity();
+
+	// the model is outside the frustum of this eye, put it outside the clip volume
+	if ((culledEyes & (1 << int(gl_ViewID_OVR))) != 0)
+	{
+		gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+		return;
+	}
+
 #if defined(USE_VERTEX_ANIMATION)
 	vec3 position  = mix(attr_Position,    attr_Position2,    u_VertexLerp);
 	vec3 normal    = mix(attr_Normal,      attr_Normal2,      u_VertexLerp);
@@ -197,13 +269,13 @@ void main()
 	var_TexCoords.xy = texCoords;
 #endif
 
-	gl_Position = u_ProjectionMatrix * (u_ViewMatrices[gl_ViewID_OVR] * (u_ModelMatrix * vec4(position, 1.0)));
+	gl_Position = u_ProjectionMatrix * (u_ViewMatrices[gl_ViewID_OVR] * (modelMatrix * vec4(position, 1.0)));
 
 #if defined(USE_MODELMATRIX)
-	position  = (u_ModelMatrix * vec4(position, 1.0)).xyz;
-	normal    = (u_ModelMatrix * vec4(normal,   0.0)).xyz;
+	position  = (modelMatrix * vec4(position, 1.0)).xyz;
+	normal    = (modelMatrix * vec4(normal,   0.0)).xyz;
 #if defined(USE_LIGHT) && !defined(USE_FAST_LIGHT)
-	tangent   = (u_ModelMatrix * vec4(tangent,  0.0)).xyz;
+	tangent   = (modelMatrix * vec4(tangent,  0.0)).xyz;
 #endif
 #endif
 
@@ -212,11 +284,11 @@ void main()
 #endif
 
 #if defined(USE_LIGHT_VECTOR)
-	vec3 L = u_LightOrigin.xyz - (position * u_LightOrigin.w);
+	vec3 L = lightOrigin.xyz - (position * lightOrigin.w);
 #elif defined(USE_LIGHT) && !defined(USE_FAST_LIGHT)
 	vec3 L = attr_LightDirection;
 #if defined(USE_MODELMATRIX)
-	L = (u_ModelMatrix * vec4(L, 0.0)).xyz;
+	L = (modelMatrix * vec4(L, 0.0)).xyz;
 #endif
 #endif
 
@@ -230,12 +302,12 @@ void main()
   #if defined(USE_FAST_LIGHT)
 	float sqrLightDist = dot(L, L);
 	float NL = clamp(dot(normalize(normal), L) / sqrt(sqrLightDist), 0.0, 1.0);
-	float attenuation = CalcLightAttenuation(u_LightOrigin.w, u_LightRadius * u_LightRadius / sqrLightDist);
+	float attenuation = CalcLightAttenuation(lightOrigin.w, u_LightRadius * u_LightRadius / sqrLightDist);
 
-	var_Color.rgb *= u_DirectedLight * (attenuation * NL) + u_AmbientLight;
+	var_Color.rgb *= directedLight * (attenuation * NL) + ambientLight;
   #else
-	var_ColorAmbient.rgb = u_AmbientLight * var_Color.rgb;
-	var_Color.rgb *= u_DirectedLight;
+	var_ColorAmbient.rgb = ambientLight * var_Color.rgb;
+	var_Color.rgb *= directedLight;
     #if defined(USE_PBR)
 	var_ColorAmbient.rgb *= var_ColorAmbient.rgb;
     #endif
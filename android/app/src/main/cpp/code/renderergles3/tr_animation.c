@@ -120,6 +120,7 @@ static int R_MDRCullModel( mdrHeader_t *header, trRefEntity_t *ent ) {
 			return CULL_IN;
 		case CULL_CLIP:
 			tr.pc.c_box_cull_md3_clip++;
+			ent->culledEyes = R_CullLocalBoxEyes( bounds );
 			return CULL_CLIP;
 		case CULL_OUT:
 		default:
@@ -22,10 +22,13 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include "tr_local.h"
 #include "tr_fbo.h"
 #include "tr_dsa.h"
+#include "../vr/vr_renderer.h"
 
-backEndData_t	*backEndData;
+backEndData_t	*backEndData[SMP_FRAMES];
 backEndState_t	backEnd;
 
+volatile qboolean	renderThreadActive;
+
 static float	s_flipMatrix[16] = {
 	// convert from our coordinate system (looking down X)
 	// to OpenGL's coordinate system (looking down -Z)
@@ -394,6 +397,141 @@ void RB_BeginDrawingView (void) {
 }
 
 
+/*
+==================
+RB_CanInstance
+
+Entities can be drawn in one instanced draw if the only things that differ
+between them are the model matrix and the lighting, which come from the
+instance buffer
+==================
+*/
+static qboolean RB_CanInstance( const trRefEntity_t *ent, const trRefEntity_t *first ) {
+	if ( ent->e.reType != RT_MODEL || ( ent->e.renderfx & RF_DEPTHHACK ) ) {
+		return qfalse;
+	}
+
+	if ( ent->e.frame != first->e.frame || ent->e.oldframe != first->e.oldframe ) {
+		return qfalse;
+	}
+
+	if ( first->e.frame != first->e.oldframe && ent->e.backlerp != first->e.backlerp ) {
+		return qfalse;
+	}
+
+	if ( ent->mirrored != first->mirrored || ent->e.shaderTime != first->e.shaderTime ) {
+		return qfalse;
+	}
+
+	if ( memcmp( ent->e.shaderRGBA, first->e.shaderRGBA, sizeof( ent->e.shaderRGBA ) )
+		|| memcmp( ent->e.shaderTexCoord, first->e.shaderTexCoord, sizeof( ent->e.shaderTexCoord ) ) ) {
+		return qfalse;
+	}
+
+	return qtrue;
+}
+
+/*
+==================
+RB_NumInstances
+
+Returns how many of drawSurfs, which all start with the same MD3 surface
+on different entities, can be drawn in one instanced draw
+==================
+*/
+static int RB_NumInstances( const drawSurf_t *drawSurfs, int numDrawSurfs ) {
+	const trRefEntity_t	*first, *ent;
+	const unsigned		entityMask = REFENTITYNUM_MASK << QSORT_REFENTITYNUM_SHIFT;
+	int					fogNum, dlighted, pshadowed;
+	int					n;
+
+	if ( !r_instancing->integer || r_showtris->integer || ( backEnd.viewParms.flags & VPF_SHADOWMAP ) ) {
+		return 1;
+	}
+
+	if ( !( (srfVaoMdvMesh_t *)drawSurfs->surface )->vao || ShaderRequiresCPUDeforms( tess.shader ) ) {
+		return 1;
+	}
+
+	// fog, dlights and pshadows are drawn in the space of one entity
+	fogNum = ( drawSurfs->sort >> QSORT_FOGNUM_SHIFT ) & 31;
+	pshadowed = ( drawSurfs->sort >> QSORT_PSHADOW_SHIFT ) & 1;
+	dlighted = drawSurfs->sort & 1;
+	if ( fogNum || dlighted || pshadowed || backEnd.currentEntity == &tr.worldEntity ) {
+		return 1;
+	}
+
+	first = backEnd.currentEntity;
+	if ( !RB_CanInstance( first, first ) ) {
+		return 1;
+	}
+
+	numDrawSurfs = MIN( numDrawSurfs, MAX_GLSL_INSTANCES );
+	for ( n = 1 ; n < numDrawSurfs ; n++ ) {
+		const drawSurf_t	*drawSurf = drawSurfs + n;
+
+		if ( drawSurf->surface != drawSurfs->surface || drawSurf->cubemapIndex != drawSurfs->cubemapIndex
+			|| ( drawSurf->sort & ~entityMask ) != ( drawSurfs->sort & ~entityMask ) ) {
+			break;
+		}
+
+		ent = &backEnd.refdef.entities[( drawSurf->sort & entityMask ) >> QSORT_REFENTITYNUM_SHIFT];
+		if ( ent == first || !RB_CanInstance( ent, first ) ) {
+			break;
+		}
+	}
+
+	return n;
+}
+
+/*
+==================
+RB_DrawInstances
+
+Draws the MD3 surface of drawSurfs on numInstances entities with one draw,
+backEnd.currentEntity has to be the entity of the first one
+==================
+*/
+static void RB_DrawInstances( const drawSurf_t *drawSurfs, int numInstances ) {
+	static instanceData_t	instances[MAX_GLSL_INSTANCES];
+	const unsigned			entityMask = REFENTITYNUM_MASK << QSORT_REFENTITYNUM_SHIFT;
+	orientationr_t			or;
+	int						i;
+
+	for ( i = 0 ; i < numInstances ; i++ ) {
+		const trRefEntity_t	*ent = &backEnd.refdef.entities[( drawSurfs[i].sort & entityMask ) >> QSORT_REFENTITYNUM_SHIFT];
+		instanceData_t		*instance = &instances[i];
+
+		R_RotateForEntity( ent, &backEnd.viewParms, &or );
+
+		Mat4Copy( or.modelMatrix, instance->modelMatrix );
+		VectorCopy( or.viewOrigin, instance->localViewOrigin );
+		instance->localViewOrigin[3] = ( backEnd.viewParms.flags & VPF_STEREOFRUSTUM ) ? ent->culledEyes : 0;
+
+		VectorScale( ent->ambientLight, 1.0f / 255.0f, instance->ambientLight );
+		instance->ambientLight[3] = 0.0f;
+		VectorScale( ent->directedLight, 1.0f / 255.0f, instance->directedLight );
+		instance->directedLight[3] = 0.0f;
+		VectorCopy( ent->lightDir, instance->lightOrigin );
+		instance->lightOrigin[3] = 0.0f;
+		VectorCopy( ent->modelLightDir, instance->modelLightDir );
+		instance->modelLightDir[3] = 0.0f;
+	}
+
+	// anything batched before isn't drawn instanced
+	RB_EndSurface();
+
+	glState.instanceOffset = GLSL_UploadInstances( instances, numInstances );
+	glState.numInstances = numInstances;
+
+	rb_surfaceTable[ *drawSurfs->surface ]( drawSurfs->surface );
+
+	glState.numInstances = 0;
+
+	backEnd.pc.c_instancedDraws++;
+	backEnd.pc.c_instances += numInstances;
+}
+
 /*
 ==================
 RB_RenderDrawSurfList
@@ -543,6 +681,18 @@ void RB_RenderDrawSurfList( drawSurf_t *drawSurfs, int numDrawSurfs ) {
 			oldEntityNum = entityNum;
 		}
 
+		// the same MD3 surface on several entities is drawn with one draw
+		if ( *drawSurf->surface == SF_VAO_MDVMESH ) {
+			int numInstances = RB_NumInstances( drawSurf, numDrawSurfs - i );
+
+			if ( numInstances > 1 ) {
+				RB_DrawInstances( drawSurf, numInstances );
+				i += numInstances - 1;
+				drawSurf += numInstances - 1;
+				continue;
+			}
+		}
+
 		// add the triangles for this surface
 		rb_surfaceTable[ *drawSurf->surface ]( drawSurf->surface );
 	}
@@ -720,6 +870,11 @@ void RE_UploadCinematic (int w, int h, int cols, int rows, const byte *data, int
 		return;
 	}
 
+	// the render thread has the context between syncs
+	if ( glConfig.smpActive ) {
+		R_IssuePendingRenderCommands();
+	}
+
 	texture = tr.scratchImage[client]->texnum;
 
 	// if the scratchImage isn't in the format we want, specify it as a new texture
@@ -1384,6 +1539,10 @@ const void	*RB_SwapBuffers( const void *data ) {
 
 	//GLimp_EndFrame();
 
+	if ( cmd->vrFrame ) {
+		VR_EndRenderFrame( cmd->vrFrame );
+	}
+
 	backEnd.framePostProcessed = qfalse;
 	backEnd.projection2D = qfalse;
 
@@ -1719,7 +1878,18 @@ RB_SwitchEye
 const void* RB_SwitchEye( const void* data ) {
 	const switchEyeCommand_t *cmd = data;
 
-	tr.renderFbo->frameBuffer = cmd->eye;
+	// with r_smp only the render thread changes the frameBuffer
+	if ( !backEnd.renderBufferOriginal ) {
+		backEnd.renderBufferOriginal = tr.renderFbo->frameBuffer;
+	}
+
+	// the headset frame may only be started now, when the
+	// render thread gets to it
+	if ( cmd->vrFrame ) {
+		tr.renderFbo->frameBuffer = VR_BeginRenderFrame( cmd->vrFrame );
+	} else {
+		tr.renderFbo->frameBuffer = cmd->eye;
+	}
 
 	// finish any 2D drawing if needed
 	if(tess.numIndexes)
@@ -1803,6 +1973,37 @@ const void* RB_HUDBuffer( const void* data ) {
 	return (const void*)(cmd + 1);
 }
 
+/*
+====================
+RB_UniformBuffers
+====================
+*/
+const void *RB_UniformBuffers( const void *data ) {
+	const uniformBuffersCommand_t *cmd = data;
+	orientationr_t world;
+	mat4_t latch;
+	int i;
+
+	// finish any 2D drawing if needed
+	if(tess.numIndexes)
+		RB_EndSurface();
+
+	world = cmd->world;
+
+	// turn the views by however far the head has turned since
+	// the front end built them
+	if ( r_lateLatch->integer && cmd->vrParms.frame && VR_LateLatchViews( cmd->vrParms.frame, latch ) ) {
+		for ( i = 0; i < 2; i++ ) {
+			Mat4Multiply( latch, cmd->world.eyeViewMatrix[i], world.eyeViewMatrix[i] );
+		}
+	}
+
+	GLSL_PrepareUniformBuffers( &cmd->vrParms, &world );
+
+	return (const void*)(cmd + 1);
+}
+
+
 /*
 ====================
 RB_ExecuteRenderCommands
@@ -1859,6 +2060,9 @@ void RB_ExecuteRenderCommands( const void *data ) {
 		case RC_HUD_BUFFER:
 		    data = RB_HUDBuffer(data);
 			break;
+		case RC_UNIFORM_BUFFERS:
+			data = RB_UniformBuffers(data);
+			break;
 		case RC_END_OF_LIST:
 		default:
 			// finish any 2D drawing if needed
@@ -1873,3 +2077,32 @@ void RB_ExecuteRenderCommands( const void *data ) {
 	}
 
 }
+
+
+/*
+================
+RB_RenderThread
+
+With r_smp the back end runs here, drawing one frame while
+the front end builds the next
+================
+*/
+void RB_RenderThread( void ) {
+	const void	*data;
+
+	// wait for either a rendering command or a quit command
+	while ( 1 ) {
+		// sleep until we have work to do
+		data = GLimp_RendererSleep();
+
+		if ( !data ) {
+			return;	// all done, renderer is shutting down
+		}
+
+		renderThreadActive = qtrue;
+
+		RB_ExecuteRenderCommands( data );
+
+		renderThreadActive = qfalse;
+	}
+}
@@ -1854,6 +1854,7 @@ static	void R_LoadSubmodels( lump_t *l ) {
 		{
 			// Add this for limiting VAO surface creation
 			s_worldData.numWorldSurfaces = out->numSurfaces;
+			s_worldData.jobDrawSurfs = ri.Hunk_Alloc( out->numSurfaces * sizeof(*s_worldData.jobDrawSurfs), h_low );
 		}
 	}
 }
@@ -1867,13 +1868,14 @@ static	void R_LoadSubmodels( lump_t *l ) {
 R_SetParent
 =================
 */
-static	void R_SetParent (mnode_t *node, mnode_t *parent)
+static	int R_SetParent (mnode_t *node, mnode_t *parent)
 {
 	node->parent = parent;
 	if (node->contents != -1)
-		return;
-	R_SetParent (node->children[0], node);
-	R_SetParent (node->children[1], node);
+		return node->numLeafs = 1;
+	node->numLeafs = R_SetParent (node->children[0], node);
+	node->numLeafs += R_SetParent (node->children[1], node);
+	return node->numLeafs;
 }
 
 /*
@@ -1949,6 +1951,8 @@ static	void R_LoadNodesAndLeafs (lump_t *nodeLump, lump_t *leafLump) {
 
 	// chain descendants
 	R_SetParent (s_worldData.nodes, NULL);
+
+	s_worldData.jobLeafs = ri.Hunk_Alloc ( numLeafs * sizeof(*s_worldData.jobLeafs), h_low );
 }
 
 //=============================================================================
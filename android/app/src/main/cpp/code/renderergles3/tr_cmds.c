@@ -70,6 +70,8 @@ void R_PerformanceCounters( void ) {
 			backEnd.pc.c_staticVaoDraws, backEnd.pc.c_dynamicVaoDraws);
 		ri.Printf( PRINT_ALL, "GLSL binds: %i  draws: gen %i light %i fog %i dlight %i\n",
 			backEnd.pc.c_glslShaderBinds, backEnd.pc.c_genericDraws, backEnd.pc.c_lightallDraws, backEnd.pc.c_fogDraws, backEnd.pc.c_dlightDraws);
+		ri.Printf( PRINT_ALL, "draw calls: %i  instanced: %i with %i entities\n",
+			backEnd.pc.c_drawCalls, backEnd.pc.c_instancedDraws, backEnd.pc.c_instances);
 	}
 
 	Com_Memset( &tr.pc, 0, sizeof( tr.pc ) );
@@ -85,7 +87,7 @@ R_IssueRenderCommands
 void R_IssueRenderCommands( qboolean runPerformanceCounters ) {
 	renderCommandList_t	*cmdList;
 
-	cmdList = &backEndData->commands;
+	cmdList = &backEndData[tr.smpFrame]->commands;
 	assert(cmdList);
 	// add an end-of-list command
 	*(int *)(cmdList->cmds + cmdList->used) = RC_END_OF_LIST;
@@ -93,6 +95,18 @@ void R_IssueRenderCommands( qboolean runPerformanceCounters ) {
 	// clear it out, in case this is a sync and not a buffer flip
 	cmdList->used = 0;
 
+	if ( glConfig.smpActive ) {
+		// if the render thread is not idle, wait for it
+		if ( r_showSmp->integer ) {
+			ri.Printf( PRINT_ALL, renderThreadActive ? "R" : "." );
+		}
+
+		// sleep until the renderer has completed
+		GLimp_FrontEndSleep();
+	}
+
+	// at this point the back end is idle, so it is ok
+	// to look at its performance counters
 	if ( runPerformanceCounters ) {
 		R_PerformanceCounters();
 	}
@@ -100,7 +114,11 @@ void R_IssueRenderCommands( qboolean runPerformanceCounters ) {
 	// actually start the commands going
 	if ( !r_skipBackEnd->integer ) {
 		// let it start on the new batch
-		RB_ExecuteRenderCommands( cmdList->cmds );
+		if ( !glConfig.smpActive ) {
+			RB_ExecuteRenderCommands( cmdList->cmds );
+		} else {
+			GLimp_WakeRenderer( cmdList->cmds );
+		}
 	}
 }
 
@@ -117,6 +135,14 @@ void R_IssuePendingRenderCommands( void ) {
 		return;
 	}
 	R_IssueRenderCommands( qfalse );
+
+	if ( !glConfig.smpActive ) {
+		return;
+	}
+
+	// sleep until the renderer has completed, the front end
+	// owns the GL context again after this
+	GLimp_FrontEndSleep();
 }
 
 /*
@@ -129,7 +155,7 @@ make sure there is enough command space
 void *R_GetCommandBufferReserved( int bytes, int reservedBytes ) {
 	renderCommandList_t	*cmdList;
 
-	cmdList = &backEndData->commands;
+	cmdList = &backEndData[tr.smpFrame]->commands;
 	bytes = PAD(bytes, sizeof(void *));
 
 	// always leave room for the end of list command
@@ -411,10 +437,6 @@ void RE_BeginFrame( stereoFrame_t stereoFrame ) {
 	}
 
 	{
-		if (tr.renderFbo && tr.vrParms.renderBufferOriginal == 0) {
-			tr.vrParms.renderBufferOriginal = tr.renderFbo->frameBuffer;
-		}
-
 		{
 			if (tr.vrParms.valid == qtrue) {
 				if (tr.renderFbo) {
@@ -424,12 +446,25 @@ void RE_BeginFrame( stereoFrame_t stereoFrame ) {
 					sec->commandId = RC_SWITCH_EYE;
 					sec->eye = tr.vrParms.renderBuffer;
 					sec->stereoFrame = stereoFrame;
+					sec->vrFrame = tr.vrParms.frame;
 				}
 			}
 		}
 	}
 	
-	GLSL_PrepareUniformBuffers();
+	//
+	// the uniform buffers are GL objects, so the back end fills them
+	// from a copy of this frame's parms
+	//
+	{
+		uniformBuffersCommand_t	*ubc;
+
+		if ( !( ubc = R_GetCommandBuffer( sizeof( *ubc ) ) ) )
+			return;
+		ubc->commandId = RC_UNIFORM_BUFFERS;
+		ubc->vrParms = tr.vrParms;
+		ubc->world = tr.viewParms.world;
+	}
 }
 
 
@@ -451,10 +486,12 @@ void RE_EndFrame( int *frontEndMsec, int *backEndMsec ) {
 		return;
 	}
 	cmd->commandId = RC_SWAP_BUFFERS;
+	cmd->vrFrame = tr.vrParms.frame;
 
 	R_IssueRenderCommands( qtrue );
 
-	if (r_useFlush->integer)
+	// with r_smp the render thread has the context now
+	if (r_useFlush->integer && !glConfig.smpActive)
 	{
 		//FLush all open gl commands
 		qglFlush();
@@ -472,6 +509,18 @@ void RE_EndFrame( int *frontEndMsec, int *backEndMsec ) {
 	backEnd.pc.msec = 0;
 }
 
+/*
+=============
+RE_SyncRenderThread
+=============
+*/
+void RE_SyncRenderThread( void ) {
+	if ( !tr.registered || !glConfig.smpActive ) {
+		return;
+	}
+	GLimp_FrontEndSleep();
+}
+
 void RE_HUDBufferStart( qboolean clear )
 {
     hudBufferCommand_t	*cmd;
@@ -514,10 +563,11 @@ void R_Mat4Transpose( const float in[4][4], float* out ) {
 }
 
 void RE_SetVRHeadsetParms( const float projectionMatrix[4][4],  const float nonVRProjectionMatrix[4][4],
-        int renderBuffer ) {
+        int renderBuffer, void *vrFrame ) {
 	R_Mat4Transpose(projectionMatrix, tr.vrParms.projection);
 	R_Mat4Transpose(nonVRProjectionMatrix, tr.vrParms.monoVRProjection);
 	tr.vrParms.renderBuffer = renderBuffer;
+	tr.vrParms.frame = vrFrame;
 	tr.vrParms.valid = qtrue;
 }
 //#endif
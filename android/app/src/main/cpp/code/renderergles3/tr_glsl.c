@@ -77,6 +77,28 @@ typedef enum {
 GLuint		viewMatricesBuffer[PROJECTION_COUNT];
 GLuint		projectionMatricesBuffer[PROJECTION_COUNT];
 
+// the joint matrices of all IQM models drawn with GPU skinning and the
+// entities of instanced draws are streamed through buffers of their own,
+// which are orphaned and filled again from the start when they run out
+typedef struct
+{
+	GLuint	buffer;
+	int		size;		// room for uploads, one more block is allocated
+	int		blockSize;	// bound at every offset
+	int		offset;
+	int		fill;
+} uniformStream_t;
+
+#define BONE_BUFFER_SIZE		( 512 * 1024 )
+#define INSTANCE_BUFFER_SIZE	( 256 * 1024 )
+
+static uniformStream_t	boneStream;
+static uniformStream_t	instanceStream;
+static int				uniformStreamAlign;
+
+static void GLSL_InitUniformStream(uniformStream_t *stream, int size, int blockSize);
+static void GLSL_ShutdownUniformStream(uniformStream_t *stream);
+
 float       orthoProjectionMatrix[16];
 
 
@@ -142,6 +164,8 @@ static uniformInfo_t uniformsInfo[] =
 	{ "u_FogColorMask", GLSL_VEC4 },
 
 	{ "u_ModelMatrix",   GLSL_MAT16 },
+	{ "u_CulledEyes",    GLSL_INT },
+	{ "u_Instanced",     GLSL_INT },
 
 	{ "u_Time",          GLSL_FLOAT },
 	{ "u_VertexLerp" ,   GLSL_FLOAT },
@@ -167,8 +191,6 @@ static uniformInfo_t uniformsInfo[] =
 	{ "u_CubeMapInfo", GLSL_VEC4 },
 
 	{ "u_AlphaTest", GLSL_INT },
-
-	{ "u_BoneMatrix", GLSL_MAT16_BONEMATRIX },
 };
 
 typedef enum
@@ -477,6 +499,9 @@ static void GLSL_GetShaderHeader( GLenum shaderType, const GLchar *extra, char *
 								AGEN_LIGHTING_SPECULAR,
 								AGEN_PORTAL));
 
+	Q_strcat(dest, size,
+			 va("#ifndef MAX_GLSL_INSTANCES\n#define MAX_GLSL_INSTANCES %i\n#endif\n", MAX_GLSL_INSTANCES));
+
 	fbufWidthScale = 1.0f / ((float)glConfig.vidWidth);
 	fbufHeightScale = 1.0f / ((float)glConfig.vidHeight);
 	Q_strcat(dest, size,
@@ -796,6 +821,30 @@ void GLSL_InitUniforms(shaderProgram_t *program)
 			projectionMatrixUniformLocation,
 			program->projectionMatrixBinding);
 
+	//Joint matrices, only in programs with bone animation
+	GLuint boneMatricesUniformLocation = qglGetUniformBlockIndex(program->program, "BoneMatrices");
+	program->boneMatricesBinding = GL_INVALID_INDEX;
+	if (boneMatricesUniformLocation != GL_INVALID_INDEX)
+	{
+		program->boneMatricesBinding = numBufferBindings++;
+		qglUniformBlockBinding(
+				program->program,
+				boneMatricesUniformLocation,
+				program->boneMatricesBinding);
+	}
+
+	//Entities of instanced draws
+	GLuint instancesUniformLocation = qglGetUniformBlockIndex(program->program, "Instances");
+	program->instancesBinding = GL_INVALID_INDEX;
+	if (instancesUniformLocation != GL_INVALID_INDEX)
+	{
+		program->instancesBinding = numBufferBindings++;
+		qglUniformBlockBinding(
+				program->program,
+				instancesUniformLocation,
+				program->instancesBinding);
+	}
+
 	size = 0;
 	for (i = 0; i < UNIFORM_COUNT; i++)
 	{
@@ -829,9 +878,6 @@ void GLSL_InitUniforms(shaderProgram_t *program)
 			case GLSL_MAT16:
 				size += sizeof(vec_t) * 16;
 				break;
-			case GLSL_MAT16_BONEMATRIX:
-				size += sizeof(vec_t) * 16 * glRefConfig.glslMaxAnimatedBones;
-				break;
 			default:
 				break;
 		}
@@ -1015,38 +1061,6 @@ void GLSL_SetUniformMat4(shaderProgram_t *program, int uniformNum, const mat4_t
 	qglProgramUniformMatrix4fvEXT(program->program, uniforms[uniformNum], 1, GL_FALSE, matrix);
 }
 
-void GLSL_SetUniformMat4BoneMatrix(shaderProgram_t *program, int uniformNum, /*const*/ mat4_t *matrix, int numMatricies)
-{
-	GLint *uniforms = program->uniforms;
-	vec_t *compare = (float *)(program->uniformBuffer + program->uniformBufferOffsets[uniformNum]);
-
-	if (uniforms[uniformNum] == -1) {
-		return;
-	}
-
-	if (uniformsInfo[uniformNum].type != GLSL_MAT16_BONEMATRIX)
-	{
-		ri.Printf( PRINT_WARNING, "GLSL_SetUniformMat4BoneMatrix: wrong type for uniform %i in program %s\n", uniformNum, program->name);
-		return;
-	}
-
-	if (numMatricies > glRefConfig.glslMaxAnimatedBones)
-	{
-		ri.Printf( PRINT_WARNING, "GLSL_SetUniformMat4BoneMatrix: too many matricies (%d/%d) for uniform %i in program %s\n",
-				numMatricies, glRefConfig.glslMaxAnimatedBones, uniformNum, program->name);
-		return;
-	}
-
-	if (!memcmp(matrix, compare, numMatricies * sizeof(mat4_t)))
-	{
-		return;
-	}
-
-	Com_Memcpy(compare, matrix, numMatricies * sizeof(mat4_t));
-
-	qglProgramUniformMatrix4fvEXT(program->program, uniforms[uniformNum], numMatricies, GL_FALSE, &matrix[0][0]);
-}
-
 void GLSL_DeleteGPUShader(shaderProgram_t *program)
 {
 	if(program->program)
@@ -1106,6 +1120,20 @@ void GLSL_InitGPUShaders(void)
 		qglBindBuffer(GL_UNIFORM_BUFFER, 0);
 	}
 
+	{
+		GLint align;
+
+		qglGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &align);
+		uniformStreamAlign = MAX(align, 16);
+	}
+
+	if (glRefConfig.glslMaxAnimatedBones)
+	{
+		GLSL_InitUniformStream(&boneStream, BONE_BUFFER_SIZE, glRefConfig.glslMaxAnimatedBones * sizeof(mat4_t));
+	}
+
+	GLSL_InitUniformStream(&instanceStream, INSTANCE_BUFFER_SIZE, MAX_GLSL_INSTANCES * sizeof(instanceData_t));
+
 	R_IssuePendingRenderCommands();
 
 	startTime = ri.Milliseconds();
@@ -1683,9 +1711,12 @@ void GLSL_ShutdownGPUShaders(void)
 	//Clean up buffers
 	qglDeleteBuffers(PROJECTION_COUNT, viewMatricesBuffer);
 	qglDeleteBuffers(PROJECTION_COUNT, projectionMatricesBuffer);
+
+	GLSL_ShutdownUniformStream(&boneStream);
+	GLSL_ShutdownUniformStream(&instanceStream);
 }
 
-void GLSL_PrepareUniformBuffers(void)
+void GLSL_PrepareUniformBuffers(const vrParms_t *vrParms, const orientationr_t *world)
 {
     int width, height;
     if (glState.currentFBO)
@@ -1714,18 +1745,18 @@ void GLSL_PrepareUniformBuffers(void)
 
     //VR projection matrix
     GLSL_ProjectionMatricesUniformBuffer(projectionMatricesBuffer[VR_PROJECTION],
-            tr.vrParms.projection);
+            vrParms->projection);
 
     //Mirror VR projection matrix
 	GLSL_ProjectionMatricesUniformBuffer(projectionMatricesBuffer[MIRROR_VR_PROJECTION],
-                                         tr.vrParms.mirrorProjection);
+                                         vrParms->mirrorProjection);
 
     //Used for drawing models
     GLSL_ProjectionMatricesUniformBuffer(projectionMatricesBuffer[MONO_VR_PROJECTION],
-                                         tr.vrParms.monoVRProjection);
+                                         vrParms->monoVRProjection);
 
     //Set all view matrices
-	GLSL_ViewMatricesUniformBuffer(tr.viewParms.world.eyeViewMatrix, tr.viewParms.world.modelView);
+	GLSL_ViewMatricesUniformBuffer(world->eyeViewMatrix[0], world->modelView);
 }
 
 void GLSL_BindProgram(shaderProgram_t * program)
@@ -1786,6 +1817,154 @@ void GLSL_BindBuffers( shaderProgram_t * program )
 			program->projectionMatrixBinding,
 			projectionMatricesBuffer[projection]);
 
+	if (glState.boneAnimation && program->boneMatricesBinding != GL_INVALID_INDEX)
+	{
+		qglBindBufferRange(
+				GL_UNIFORM_BUFFER,
+				program->boneMatricesBinding,
+				boneStream.buffer,
+				glState.boneOffset,
+				boneStream.blockSize);
+	}
+
+	// the block is in use even if the draw isn't instanced
+	if (program->instancesBinding != GL_INVALID_INDEX)
+	{
+		qglBindBufferRange(
+				GL_UNIFORM_BUFFER,
+				program->instancesBinding,
+				instanceStream.buffer,
+				glState.instanceOffset,
+				instanceStream.blockSize);
+	}
+}
+
+/*
+====================
+GLSL_InitUniformStream
+====================
+*/
+static void GLSL_InitUniformStream(uniformStream_t *stream, int size, int blockSize)
+{
+	stream->size = size;
+	stream->blockSize = blockSize;
+	stream->offset = 0;
+	stream->fill = 1;
+
+	qglGenBuffers(1, &stream->buffer);
+	qglBindBuffer(GL_UNIFORM_BUFFER, stream->buffer);
+	qglBufferData(GL_UNIFORM_BUFFER, stream->size + stream->blockSize, NULL, GL_STREAM_DRAW);
+	qglBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+/*
+====================
+GLSL_ShutdownUniformStream
+====================
+*/
+static void GLSL_ShutdownUniformStream(uniformStream_t *stream)
+{
+	if (stream->buffer)
+	{
+		qglDeleteBuffers(1, &stream->buffer);
+	}
+
+	Com_Memset(stream, 0, sizeof(*stream));
+}
+
+/*
+====================
+GLSL_StreamUniformData
+
+Copies data to a stream buffer and returns its offset in it.
+Nothing the GPU may still read is written, so the copy doesn't wait for it.
+====================
+*/
+static int GLSL_StreamUniformData(uniformStream_t *stream, const void *data, int size)
+{
+	int offset;
+	void *dest;
+
+	qglBindBuffer(GL_UNIFORM_BUFFER, stream->buffer);
+
+	if (stream->offset + size > stream->size)
+	{
+		// draws still using the old storage keep it
+		qglBufferData(GL_UNIFORM_BUFFER, stream->size + stream->blockSize, NULL, GL_STREAM_DRAW);
+		stream->offset = 0;
+		stream->fill++;
+	}
+
+	offset = stream->offset;
+	dest = qglMapBufferRange(
+			GL_UNIFORM_BUFFER,
+			offset,
+			size,
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+
+	if (dest)
+	{
+		Com_Memcpy(dest, data, size);
+		qglUnmapBuffer(GL_UNIFORM_BUFFER);
+	}
+
+	qglBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	stream->offset += PAD(size, uniformStreamAlign);
+
+	return offset;
+}
+
+/*
+====================
+GLSL_BoneBufferFill
+
+Bumped every time the bone buffer is orphaned, offsets returned by
+GLSL_UploadBoneMatrices before that can't be used any more
+====================
+*/
+int GLSL_BoneBufferFill(void)
+{
+	return boneStream.fill;
+}
+
+/*
+====================
+GLSL_UploadBoneMatrices
+
+Copies joint matrices to the bone buffer and returns their offset in it
+====================
+*/
+int GLSL_UploadBoneMatrices(/*const*/ mat4_t *matrices, int numMatrices)
+{
+	if (numMatrices > glRefConfig.glslMaxAnimatedBones)
+	{
+		ri.Printf( PRINT_WARNING, "GLSL_UploadBoneMatrices: too many matricies (%d/%d)\n",
+				numMatrices, glRefConfig.glslMaxAnimatedBones);
+		numMatrices = glRefConfig.glslMaxAnimatedBones;
+	}
+
+	return GLSL_StreamUniformData(&boneStream, matrices, numMatrices * sizeof(mat4_t));
+}
+
+/*
+====================
+GLSL_UploadInstances
+
+Copies the entities of an instanced draw to the instance buffer and
+returns their offset in it
+====================
+*/
+int GLSL_UploadInstances(const instanceData_t *instances, int numInstances)
+{
+	if (numInstances > MAX_GLSL_INSTANCES)
+	{
+		ri.Printf( PRINT_WARNING, "GLSL_UploadInstances: too many instances (%d/%d)\n",
+				numInstances, MAX_GLSL_INSTANCES);
+		numInstances = MAX_GLSL_INSTANCES;
+	}
+
+	return GLSL_StreamUniformData(&instanceStream, instances, numInstances * sizeof(instanceData_t));
 }
 
 
@@ -2130,6 +2130,12 @@ image_t *R_CreateImage2( const char *name, byte *pic, int width, int height, GLe
 	if (strlen(name) >= MAX_QPATH ) {
 		ri.Error (ERR_DROP, "R_CreateImage: \"%s\" is too long", name);
 	}
+
+	// images can be registered mid frame, when the render thread has the context
+	if ( glConfig.smpActive ) {
+		R_IssuePendingRenderCommands();
+	}
+
 	if ( !strncmp( name, "*lightmap", 9 ) ) {
 		isLightmap = qtrue;
 	}
@@ -2298,6 +2304,40 @@ static imageExtToLoaderMap_t imageLoaders[ ] =
 
 static int numImageLoaders = ARRAY_LEN( imageLoaders );
 
+/*
+=================
+R_LoadImageCached
+
+Runs a loader, unless the asset cache has what it made from the same file
+=================
+*/
+static void R_LoadImageCached( const imageExtToLoaderMap_t *loader, const char *name, byte **pic, int *width, int *height )
+{
+	int size[2];
+	int length;
+
+	*pic = ri.FS_ReadAssetCache( name, "rgba1", size, sizeof( size ), &length, ri.Malloc, ri.Free );
+	if( *pic )
+	{
+		if( size[0] > 0 && size[1] > 0 && length == size[0] * size[1] * 4 )
+		{
+			*width = size[0];
+			*height = size[1];
+			return;
+		}
+		ri.Free( *pic );
+	}
+
+	loader->ImageLoader( name, pic, width, height );
+
+	if( *pic )
+	{
+		size[0] = *width;
+		size[1] = *height;
+		ri.FS_WriteAssetCache( name, "rgba1", size, sizeof( size ), *pic, *width * *height * 4 );
+	}
+}
+
 /*
 =================
 R_LoadImage
@@ -2348,7 +2388,7 @@ void R_LoadImage( const char *name, byte **pic, int *width, int *height, GLenum
 			if( !Q_stricmp( ext, imageLoaders[ i ].ext ) )
 			{
 				// Load
-				imageLoaders[ i ].ImageLoader( localName, pic, width, height );
+				R_LoadImageCached( &imageLoaders[ i ], localName, pic, width, height );
 				break;
 			}
 		}
@@ -2382,7 +2422,7 @@ void R_LoadImage( const char *name, byte **pic, int *width, int *height, GLenum
 		altName = va( "%s.%s", localName, imageLoaders[ i ].ext );
 
 		// Load
-		imageLoaders[ i ].ImageLoader( altName, pic, width, height );
+		R_LoadImageCached( &imageLoaders[ i ], altName, pic, width, height );
 
 		if( *pic )
 		{
@@ -64,6 +64,15 @@ cvar_t	*r_useFlush;
 
 cvar_t	*r_skipBackEnd;
 
+cvar_t	*r_smp;
+cvar_t	*r_showSmp;
+cvar_t	*r_lateLatch;
+
+cvar_t	*r_worldThreads;
+
+cvar_t	*r_gpuSkinning;
+cvar_t	*r_instancing;
+
 cvar_t	*r_stereoEnabled;
 cvar_t	*r_anaglyphMode;
 
@@ -283,9 +292,9 @@ static void InitOpenGL( void )
 		qglGetIntegerv( GL_MAX_TEXTURE_IMAGE_UNITS, &temp );
 		glConfig.numTextureUnits = temp;
 
-		// reserve 160 components for other uniforms
-		qglGetIntegerv( GL_MAX_VERTEX_UNIFORM_COMPONENTS, &temp );
-		glRefConfig.glslMaxAnimatedBones = Com_Clamp( 0, IQM_MAX_JOINTS, ( temp - 160 ) / 16 );
+		// the joint matrices are in a uniform block of their own
+		qglGetIntegerv( GL_MAX_UNIFORM_BLOCK_SIZE, &temp );
+		glRefConfig.glslMaxAnimatedBones = Com_Clamp( 0, IQM_MAX_JOINTS, temp / sizeof( mat4_t ) );
 		if ( glRefConfig.glslMaxAnimatedBones < 12 ) {
 			glRefConfig.glslMaxAnimatedBones = 0;
 		}
@@ -1293,6 +1302,7 @@ void R_Register( void )
 	//
 	// temporary latched variables that can only change over a restart
 	//
+	r_smp = ri.Cvar_Get( "r_smp", "0", CVAR_ARCHIVE | CVAR_LATCH );
 	r_displayRefresh = ri.Cvar_Get( "r_displayRefresh", "0", CVAR_LATCH );
 	ri.Cvar_CheckRange( r_displayRefresh, 0, 200, qtrue );
 	r_fullbright = ri.Cvar_Get ("r_fullbright", "0", CVAR_LATCH|CVAR_CHEAT );
@@ -1311,6 +1321,11 @@ void R_Register( void )
 	r_zproj = ri.Cvar_Get( "r_zproj", "64", CVAR_ARCHIVE );
 	r_stereoSeparation = ri.Cvar_Get( "r_stereoSeparation", "64", CVAR_ARCHIVE );
 	r_useFlush = ri.Cvar_Get( "r_useFlush", "1", CVAR_ARCHIVE );
+	r_lateLatch = ri.Cvar_Get( "r_lateLatch", "0", CVAR_ARCHIVE );
+	r_worldThreads = ri.Cvar_Get( "r_worldThreads", "0", CVAR_ARCHIVE );
+	ri.Cvar_CheckRange( r_worldThreads, 0, 16, qtrue );
+	r_gpuSkinning = ri.Cvar_Get( "r_gpuSkinning", "1", CVAR_ARCHIVE );
+	r_instancing = ri.Cvar_Get( "r_instancing", "1", CVAR_ARCHIVE );
 	r_ignoreGLErrors = ri.Cvar_Get( "r_ignoreGLErrors", "1", CVAR_ARCHIVE );
 	r_fastsky = ri.Cvar_Get( "r_fastsky", "0", CVAR_ARCHIVE );
 	vr_thirdPersonSpectator = ri.Cvar_Get( "vr_thirdPersonSpectator", "0", CVAR_TEMP );
@@ -1354,6 +1369,7 @@ void R_Register( void )
 	r_flareCoeff = ri.Cvar_Get ("r_flareCoeff", FLARE_STDCOEFF, CVAR_CHEAT);
 
 	r_skipBackEnd = ri.Cvar_Get ("r_skipBackEnd", "0", CVAR_CHEAT);
+	r_showSmp = ri.Cvar_Get ("r_showSmp", "0", CVAR_CHEAT);
 
 	r_measureOverdraw = ri.Cvar_Get( "r_measureOverdraw", "0", CVAR_CHEAT );
 	r_lodscale = ri.Cvar_Get( "r_lodscale", "5", CVAR_CHEAT );
@@ -1401,6 +1417,10 @@ void R_Register( void )
 	ri.Cmd_AddCommand( "minimize", GLimp_Minimize );
 	ri.Cmd_AddCommand( "gfxmeminfo", GfxMemInfo_f );
 	ri.Cmd_AddCommand( "exportCubemaps", R_ExportCubemaps_f );
+#ifdef USE_TESTS
+	ri.Cmd_AddCommand( "r_worldbench", R_WorldBench_f );
+	ri.Cmd_AddCommand( "iqmbench", R_IQMBench_f );
+#endif
 }
 
 void R_InitQueries(void)
@@ -1489,14 +1509,31 @@ void R_Init( void ) {
 	if (max_polyverts < MAX_POLYVERTS)
 		max_polyverts = MAX_POLYVERTS;
 
-	ptr = ri.Hunk_Alloc( sizeof( *backEndData ) + sizeof(srfPoly_t) * max_polys + sizeof(polyVert_t) * max_polyverts, h_low);
-	backEndData = (backEndData_t *) ptr;
-	backEndData->polys = (srfPoly_t *) ((char *) ptr + sizeof( *backEndData ));
-	backEndData->polyVerts = (polyVert_t *) ((char *) ptr + sizeof( *backEndData ) + sizeof(srfPoly_t) * max_polys);
+	for ( i = 0; i < ( r_smp->integer ? SMP_FRAMES : 1 ); i++ ) {
+		ptr = ri.Hunk_Alloc( sizeof( *backEndData[i] ) + sizeof(srfPoly_t) * max_polys + sizeof(polyVert_t) * max_polyverts, h_low);
+		backEndData[i] = (backEndData_t *) ptr;
+		backEndData[i]->polys = (srfPoly_t *) ((char *) ptr + sizeof( *backEndData[i] ));
+		backEndData[i]->polyVerts = (polyVert_t *) ((char *) ptr + sizeof( *backEndData[i] ) + sizeof(srfPoly_t) * max_polys);
+	}
+	if ( !r_smp->integer ) {
+		backEndData[1] = NULL;
+	}
 	R_InitNextFrame();
 
 	InitOpenGL();
 
+	// start the back end on its own thread, it takes the GL
+	// context whenever it is handed a frame
+	if ( r_smp->integer ) {
+		ri.Printf( PRINT_ALL, "Trying SMP acceleration...\n" );
+		if ( GLimp_SpawnRenderThread( RB_RenderThread ) ) {
+			ri.Printf( PRINT_ALL, "...succeeded.\n" );
+			glConfig.smpActive = qtrue;
+		} else {
+			ri.Printf( PRINT_ALL, "...failed.\n" );
+		}
+	}
+
 	R_InitImages();
 
 	if (glRefConfig.framebufferObject)
@@ -1546,16 +1583,28 @@ void RE_Shutdown( qboolean destroyWindow ) {
 	ri.Cmd_RemoveCommand( "minimize" );
 	ri.Cmd_RemoveCommand( "gfxmeminfo" );
 	ri.Cmd_RemoveCommand( "exportCubemaps" );
+#ifdef USE_TESTS
+	ri.Cmd_RemoveCommand( "r_worldbench" );
+	ri.Cmd_RemoveCommand( "iqmbench" );
+#endif
 
 
 	if ( tr.registered ) {
 		R_IssuePendingRenderCommands();
+	}
+
+	if ( glConfig.smpActive ) {
+		GLimp_ShutdownRenderThread();
+		glConfig.smpActive = qfalse;
+	}
+
+	if ( tr.registered ) {
 		R_ShutDownQueries();
 		if (glRefConfig.framebufferObject)
 		{
-			if (tr.vrParms.renderBufferOriginal != 0)
+			if (backEnd.renderBufferOriginal != 0)
 			{
-				tr.renderFbo->frameBuffer = tr.vrParms.renderBufferOriginal;
+				tr.renderFbo->frameBuffer = backEnd.renderBufferOriginal;
 			}
 			FBO_Shutdown();
 		}
@@ -1638,6 +1687,7 @@ refexport_t *GetRefAPI ( int apiVersion, refimport_t *rimp ) {
 
 	re.BeginFrame = RE_BeginFrame;
 	re.EndFrame = RE_EndFrame;
+	re.SyncRenderThread = RE_SyncRenderThread;
 
 #if __ANDROID__
 	re.SetVRHeadsetParms = RE_SetVRHeadsetParms;
@@ -100,6 +100,9 @@ typedef struct {
 	qboolean	needDlights;	// true for bmodels that touch a dlight
 	qboolean	lightingCalculated;
 	qboolean	mirrored;		// mirrored matrix, needs reversed culling
+	int			culledEyes;		// eyes whose frustum the model is outside of, 1 << eye
+	int			boneOffset;		// joint matrices in the bone buffer, if boneBufferFill is current
+	int			boneBufferFill;
 	vec3_t		lightDir;		// normalized direction towards light, in world space
 	vec3_t      modelLightDir;  // normalized direction towards light, in model space
 	vec3_t		ambientLight;	// color normalized to 0-255
@@ -612,8 +615,7 @@ enum
 	GLSL_VEC2,
 	GLSL_VEC3,
 	GLSL_VEC4,
-	GLSL_MAT16,
-	GLSL_MAT16_BONEMATRIX
+	GLSL_MAT16
 };
 
 typedef enum
@@ -677,6 +679,8 @@ typedef enum
 	UNIFORM_FOGCOLORMASK,
 
 	UNIFORM_MODELMATRIX,
+	UNIFORM_CULLEDEYES,
+	UNIFORM_INSTANCED,
 
 	UNIFORM_TIME,
 	UNIFORM_VERTEXLERP,
@@ -703,8 +707,6 @@ typedef enum
 
 	UNIFORM_ALPHATEST,
 
-	UNIFORM_BONEMATRIX,
-
 	UNIFORM_COUNT
 } uniform_t;
 
@@ -722,6 +724,8 @@ typedef struct shaderProgram_s
 	//New for multiview - The view and projection matrix uniforms
 	GLuint		projectionMatrixBinding;
 	GLuint		viewMatricesBinding;
+	GLuint		boneMatricesBinding;	// GL_INVALID_INDEX without bone animation
+	GLuint		instancesBinding;		// GL_INVALID_INDEX without instancing
 
 	// uniform parameters
 	GLint uniforms[UNIFORM_COUNT];
@@ -729,6 +733,20 @@ typedef struct shaderProgram_s
 	char  *uniformBuffer;
 } shaderProgram_t;
 
+// the entities of one instanced draw, same layout as the std140
+// Instances block in the vertex shaders
+#define MAX_GLSL_INSTANCES	64
+
+typedef struct instanceData_s
+{
+	mat4_t		modelMatrix;
+	vec4_t		localViewOrigin;	// w = culled eyes
+	vec4_t		ambientLight;
+	vec4_t		directedLight;
+	vec4_t		lightOrigin;
+	vec4_t		modelLightDir;
+} instanceData_t;
+
 // trRefdef_t holds everything that comes in refdef_t,
 // as well as the locally generated scene information
 typedef struct {
@@ -822,7 +840,8 @@ typedef enum {
 	VPF_ORTHOGRAPHIC    = 0x10,
 	VPF_USESUNLIGHT     = 0x20,
 	VPF_FARPLANEFRUSTUM = 0x40,
-	VPF_NOCUBEMAPS      = 0x80
+	VPF_NOCUBEMAPS      = 0x80,
+	VPF_STEREOFRUSTUM   = 0x100		// frustum covers both eyes, eyeFrustum is valid
 } viewParmFlags_t;
 
 typedef struct {
@@ -842,6 +861,7 @@ typedef struct {
 	float		fovX, fovY;
 	float		projectionMatrix[16];
 	cplane_t	frustum[5];
+	cplane_t	eyeFrustum[2][2];	// left and right planes of each eye
 	vec3_t		visBounds[2];
 	float		zFar;
 	float       zNear;
@@ -854,7 +874,7 @@ typedef struct {
 	float		mirrorProjection[16];
 	float		monoVRProjection[16];
 	int			renderBuffer;
-	int			renderBufferOriginal;
+	void		*frame;				// the headset frame being drawn, see VR_BeginRenderFrame
 } vrParms_t;
 
 /*
@@ -1149,8 +1169,19 @@ typedef struct mnode_s {
 
 	int         firstmarksurface;
 	int			nummarksurfaces;
+
+	int			numLeafs;		// leafs at or below this node, for r_worldThreads
 } mnode_t;
 
+// a node still to be walked, with the frustum planes and lights
+// left to check below it
+typedef struct {
+	mnode_t		*node;
+	uint32_t	planeBits;
+	uint32_t	dlightBits;
+	uint32_t	pshadowBits;
+} worldNode_t;
+
 typedef struct {
 	vec3_t		bounds[2];		// for culling
 	int	        firstSurface;
@@ -1184,6 +1215,10 @@ typedef struct {
 	int         *surfacesDlightBits;
 	int			*surfacesPshadowBits;
 
+	// scratch space for r_worldThreads, see R_AddWorldSurfaces
+	worldNode_t	*jobLeafs;			// numnodes - numDecisionNodes
+	drawSurf_t	*jobDrawSurfs;			// numWorldSurfaces
+
 	int			nummarksurfaces;
 	int         *marksurfaces;
 
@@ -1390,7 +1425,9 @@ typedef struct {
 	float           vertexAttribsInterpolation;
 	qboolean        vertexAnimation;
 	int             boneAnimation; // number of bones
-	mat4_t          boneMatrix[IQM_MAX_JOINTS];
+	int             boneOffset;    // joint matrices in the bone buffer
+	int             numInstances;  // entities drawn at once, 0 if not instanced
+	int             instanceOffset; // their instanceData_t in the instance buffer
 	uint32_t        vertexAttribsEnabled;  // global if no VAOs, tess only otherwise
 	FBO_t          *currentFBO;
 	vao_t          *currentVao;
@@ -1456,6 +1493,10 @@ typedef struct {
 	int     c_staticVaoDraws;
 	int     c_dynamicVaoDraws;
 
+	int     c_drawCalls;
+	int     c_instancedDraws;
+	int     c_instances;
+
 	int		c_dlightVertexes;
 	int		c_dlightIndexes;
 
@@ -1492,6 +1533,7 @@ typedef struct {
 	qboolean    colorMask[4];
 	qboolean    framePostProcessed;
 	qboolean    depthFill;
+	int			renderBufferOriginal;	// tr.renderFbo's own frameBuffer, before RB_SwitchEye replaced it
 } backEndState_t;
 
 /*
@@ -1510,6 +1552,7 @@ typedef struct {
 	int						visCounts[MAX_VISCOUNTS];	// incremented every time a new vis cluster is entered
 
 	int						frameCount;		// incremented every frame
+	int						smpFrame;		// which backEndData the front end fills, toggles with r_smp
 	int						sceneCount;		// incremented every scene
 	int						viewCount;		// incremented every view (twice a scene if portaled)
 											// and every R_MarkFragments call
@@ -1780,6 +1823,15 @@ extern	cvar_t	*r_subdivisions;
 extern	cvar_t	*r_lodCurveError;
 extern	cvar_t	*r_skipBackEnd;
 
+extern	cvar_t	*r_smp;
+extern	cvar_t	*r_showSmp;
+extern	cvar_t	*r_lateLatch;
+
+extern	cvar_t	*r_worldThreads;		// job threads helping with R_AddWorldSurfaces
+
+extern	cvar_t	*r_gpuSkinning;			// skin IQM models in the vertex shaders
+extern	cvar_t	*r_instancing;			// draw a MD3 surface on several entities at once
+
 extern	cvar_t	*r_anaglyphMode;
 
 extern  cvar_t  *r_externalGLSL;
@@ -1906,6 +1958,8 @@ void R_DecomposeSort( unsigned sort, int *entityNum, shader_t **shader,
 
 void R_AddDrawSurf( surfaceType_t *surface, shader_t *shader, 
 				   int fogIndex, int dlightMap, int pshadowMap, int cubemap );
+void R_SetDrawSurf( drawSurf_t *drawSurf, surfaceType_t *surface, shader_t *shader,
+				   int fogIndex, int dlightMap, int pshadowMap, int cubemap );
 
 void R_CalcTexDirs(vec3_t sdir, vec3_t tdir, const vec3_t v1, const vec3_t v2,
 				   const vec3_t v3, const vec2_t w1, const vec2_t w2, const vec2_t w3);
@@ -1919,11 +1973,14 @@ void R_LocalNormalToWorld (const vec3_t local, vec3_t world);
 void R_LocalPointToWorld (const vec3_t local, vec3_t world);
 int R_CullBox (vec3_t bounds[2]);
 int R_CullLocalBox (vec3_t bounds[2]);
+int R_CullBoxEyes( vec3_t worldBounds[2] );
+int R_CullLocalBoxEyes( vec3_t localBounds[2] );
 int R_CullPointAndRadiusEx( const vec3_t origin, float radius, const cplane_t* frustum, int numPlanes );
 int R_CullPointAndRadius( const vec3_t origin, float radius );
 int R_CullLocalPointAndRadius( const vec3_t origin, float radius );
 
 void R_SetupProjection(viewParms_t *dest, float zProj, float zFar, qboolean computeFrustum);
+void R_RotateForViewer( void );
 void R_RotateForEntity( const trRefEntity_t *ent, const viewParms_t *viewParms, orientationr_t *or );
 
 /*
@@ -2123,6 +2180,10 @@ void R_AddBrushModelSurfaces( trRefEntity_t *e );
 void R_AddWorldSurfaces( void );
 qboolean R_inPVS( const vec3_t p1, const vec3_t p2 );
 
+#ifdef USE_TESTS
+void R_WorldBench_f( void );
+#endif
+
 
 /*
 ============================================================
@@ -2253,7 +2314,7 @@ GLSL
 */
 
 void GLSL_InitGPUShaders(void);
-void GLSL_PrepareUniformBuffers(void);
+void GLSL_PrepareUniformBuffers(const vrParms_t *vrParms, const orientationr_t *world);
 void GLSL_ShutdownGPUShaders(void);
 void GLSL_VertexAttribPointers(uint32_t attribBits);
 void GLSL_BindProgram(shaderProgram_t * program);
@@ -2266,7 +2327,9 @@ void GLSL_SetUniformVec2(shaderProgram_t *program, int uniformNum, const vec2_t
 void GLSL_SetUniformVec3(shaderProgram_t *program, int uniformNum, const vec3_t v);
 void GLSL_SetUniformVec4(shaderProgram_t *program, int uniformNum, const vec4_t v);
 void GLSL_SetUniformMat4(shaderProgram_t *program, int uniformNum, const mat4_t matrix);
-void GLSL_SetUniformMat4BoneMatrix(shaderProgram_t *program, int uniformNum, /*const*/ mat4_t *matrix, int numMatricies);
+int GLSL_BoneBufferFill(void);
+int GLSL_UploadBoneMatrices(/*const*/ mat4_t *matrices, int numMatrices);
+int GLSL_UploadInstances(const instanceData_t *instances, int numInstances);
 
 shaderProgram_t *GLSL_GetGenericShaderProgram(int stage);
 
@@ -2322,6 +2385,10 @@ qboolean R_LoadIQM (model_t *mod, void *buffer, int filesize, const char *name )
 void R_AddIQMSurfaces( trRefEntity_t *ent );
 void RB_IQMSurfaceAnim( surfaceType_t *surface );
 void RB_IQMSurfaceAnimVao( srfVaoIQModel_t *surface );
+void RB_IQMBoneMatrices( iqmData_t *data, const refEntity_t *e, mat4_t *boneMatrix );
+#ifdef USE_TESTS
+void R_IQMBench_f( void );
+#endif
 int R_IQMLerpTag( orientation_t *tag, iqmData_t *data,
                   int startFrame, int endFrame,
                   float frac, const char *tagName );
@@ -2394,6 +2461,7 @@ typedef struct {
 
 typedef struct {
 	int		commandId;
+	void	*vrFrame;
 } swapBuffersCommand_t;
 
 typedef struct {
@@ -2469,8 +2537,15 @@ typedef struct {
 	int commandId;
 	int eye;
 	stereoFrame_t stereoFrame;
+	void *vrFrame;
 } switchEyeCommand_t;
 
+typedef struct {
+	int commandId;
+	vrParms_t vrParms;
+	orientationr_t world;
+} uniformBuffersCommand_t;
+
 typedef struct {
 	int commandId;
 	qboolean start;
@@ -2492,7 +2567,8 @@ typedef enum {
 	RC_POSTPROCESS,
 	RC_EXPORT_CUBEMAPS,
 	RC_SWITCH_EYE,
-	RC_HUD_BUFFER
+	RC_HUD_BUFFER,
+	RC_UNIFORM_BUFFERS
 } renderCommand_t;
 
 
@@ -2517,11 +2593,17 @@ typedef struct {
 extern	int		max_polys;
 extern	int		max_polyverts;
 
-extern	backEndData_t	*backEndData;	// the second one may not be allocated
+// with r_smp the front end fills one while the render thread draws the other
+#define	SMP_FRAMES		2
+
+extern	backEndData_t	*backEndData[SMP_FRAMES];	// the second one may not be allocated
+
+extern	volatile qboolean	renderThreadActive;
 
 
 void *R_GetCommandBuffer( int bytes );
 void RB_ExecuteRenderCommands( const void *data );
+void RB_RenderThread( void );
 
 void R_IssuePendingRenderCommands( void );
 
@@ -2534,10 +2616,11 @@ void RE_StretchPic ( float x, float y, float w, float h,
 					  float s1, float t1, float s2, float t2, qhandle_t hShader );
 void RE_BeginFrame( stereoFrame_t stereoFrame );
 void RE_EndFrame( int *frontEndMsec, int *backEndMsec );
+void RE_SyncRenderThread( void );
 #if __ANDROID__
 void RE_SetVRHeadsetParms( const float projectionMatrix[4][4],
 						   const float nonVRProjectionMatrix[4][4],
-						   int renderBuffer );
+						   int renderBuffer, void *vrFrame );
 #endif
 void RE_HUDBufferStart( qboolean clear );
 void RE_HUDBufferEnd( void );
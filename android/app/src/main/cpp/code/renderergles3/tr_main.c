@@ -194,6 +194,33 @@ qboolean R_CalcTangentVectors(srfVert_t * dv[3])
 }
 
 
+/*
+=================
+R_LocalBoundsToWorld
+
+Bounds in world space around local bounds transformed by tr.or
+=================
+*/
+static void R_LocalBoundsToWorld(vec3_t localBounds[2], vec3_t worldBounds[2])
+{
+	int             j;
+	vec3_t          transformed;
+	vec3_t          v;
+
+	ClearBounds(worldBounds[0], worldBounds[1]);
+
+	for(j = 0; j < 8; j++)
+	{
+		v[0] = localBounds[j & 1][0];
+		v[1] = localBounds[(j >> 1) & 1][1];
+		v[2] = localBounds[(j >> 2) & 1][2];
+
+		R_LocalPointToWorld(v, transformed);
+
+		AddPointToBounds(transformed, worldBounds[0], worldBounds[1]);
+	}
+}
+
 /*
 =================
 R_CullLocalBox
@@ -257,9 +284,6 @@ int R_CullLocalBox(vec3_t localBounds[2]) {
 
 	return CULL_CLIP;		// partially clipped
 #else
-	int             j;
-	vec3_t          transformed;
-	vec3_t          v;
 	vec3_t          worldBounds[2];
 
 	if(r_nocull->integer )
@@ -267,19 +291,7 @@ int R_CullLocalBox(vec3_t localBounds[2]) {
 		return CULL_CLIP;
 	}
 
-	// transform into world space
-	ClearBounds(worldBounds[0], worldBounds[1]);
-
-	for(j = 0; j < 8; j++)
-	{
-		v[0] = localBounds[j & 1][0];
-		v[1] = localBounds[(j >> 1) & 1][1];
-		v[2] = localBounds[(j >> 2) & 1][2];
-
-		R_LocalPointToWorld(v, transformed);
-
-		AddPointToBounds(transformed, worldBounds[0], worldBounds[1]);
-	}
+	R_LocalBoundsToWorld(localBounds, worldBounds);
 
 	return R_CullBox(worldBounds);
 #endif
@@ -329,6 +341,53 @@ int R_CullBox(vec3_t worldBounds[2]) {
 	return CULL_CLIP;
 }
 
+/*
+=================
+R_CullBoxEyes
+
+Returns the eyes that can't see a box the stereo frustum didn't cull,
+1 << eye for each.  Only boxes in the strip between the side planes of
+the two eyes are seen by one eye alone, so this is mostly 0.
+=================
+*/
+int R_CullBoxEyes( vec3_t worldBounds[2] ) {
+	int		eye, side;
+	int		culled;
+
+	if ( !( tr.viewParms.flags & VPF_STEREOFRUSTUM ) || r_nocull->integer ) {
+		return 0;
+	}
+
+	culled = 0;
+	for ( eye = 0 ; eye < 2 ; eye++ ) {
+		for ( side = 0 ; side < 2 ; side++ ) {
+			if ( BoxOnPlaneSide( worldBounds[0], worldBounds[1], &tr.viewParms.eyeFrustum[eye][side] ) == 2 ) {
+				culled |= 1 << eye;
+				break;
+			}
+		}
+	}
+
+	return culled;
+}
+
+/*
+=================
+R_CullLocalBoxEyes
+=================
+*/
+int R_CullLocalBoxEyes( vec3_t localBounds[2] ) {
+	vec3_t	worldBounds[2];
+
+	if ( !( tr.viewParms.flags & VPF_STEREOFRUSTUM ) ) {
+		return 0;
+	}
+
+	R_LocalBoundsToWorld( localBounds, worldBounds );
+
+	return R_CullBoxEyes( worldBounds );
+}
+
 /*
 ** R_CullLocalPointAndRadius
 */
@@ -701,6 +760,71 @@ static void R_SetFarClip( void )
 	tr.viewParms.zFar = sqrt( farthestCornerDistance );
 }
 
+/*
+=================
+R_SetupStereoFrustum
+
+Sets up frustum planes that bound what both eyes see.  The planes come
+from the headset projection, which is asymmetric and may be narrowed by
+the weapon zoom, so fovX and fovY don't describe it.  The left plane is
+put through the left eye and the right plane through the right one, so
+the frustum holds both eye frustums, and the side planes of each eye are
+kept in eyeFrustum for R_CullBoxEyes.
+=================
+*/
+static qboolean R_SetupStereoFrustum( void ) {
+	const float	*p = tr.vrParms.projection;
+	vec3_t		eyeOrigin[2];
+	float		offset[4];
+	float		scale;
+	int			i, eye;
+
+	scale = ((r_stereoSeparation->value / 1000.0f) / 2.0f) * vr_worldscale->value * vr_worldscaleScaler->value;
+	VectorMA( tr.viewParms.or.origin, scale, tr.viewParms.or.axis[1], eyeOrigin[0] );
+	VectorMA( tr.viewParms.or.origin, -scale, tr.viewParms.or.axis[1], eyeOrigin[1] );
+
+	// the left, right, bottom and top clip planes are the fourth row of
+	// the projection plus or minus the first and second ones, in eye
+	// space, where x is our -axis[1], y is axis[2] and z is -axis[0]
+	for ( i = 0 ; i < 4 ; i++ ) {
+		cplane_t	*plane = &tr.viewParms.frustum[i];
+		float		sign = ( i & 1 ) ? -1.0f : 1.0f;
+		int			row = i >> 1;
+		float		length;
+
+		VectorScale( tr.viewParms.or.axis[1], -( p[3] + sign * p[row] ), plane->normal );
+		VectorMA( plane->normal, p[7] + sign * p[4 + row], tr.viewParms.or.axis[2], plane->normal );
+		VectorMA( plane->normal, -( p[11] + sign * p[8 + row] ), tr.viewParms.or.axis[0], plane->normal );
+
+		length = VectorNormalize( plane->normal );
+		if ( length < 0.0001f ) {
+			return qfalse;
+		}
+		offset[i] = ( p[15] + sign * p[12 + row] ) / length;
+	}
+
+	for ( i = 0 ; i < 4 ; i++ ) {
+		cplane_t	*plane = &tr.viewParms.frustum[i];
+
+		// the top and bottom planes don't change along axis[1]
+		plane->type = PLANE_NON_AXIAL;
+		plane->dist = DotProduct( i < 2 ? eyeOrigin[i] : tr.viewParms.or.origin, plane->normal ) - offset[i];
+		SetPlaneSignbits( plane );
+	}
+
+	for ( eye = 0 ; eye < 2 ; eye++ ) {
+		for ( i = 0 ; i < 2 ; i++ ) {
+			cplane_t	*plane = &tr.viewParms.eyeFrustum[eye][i];
+
+			*plane = tr.viewParms.frustum[i];
+			plane->dist = DotProduct( eyeOrigin[eye], plane->normal ) - offset[i];
+		}
+	}
+
+	tr.viewParms.flags |= VPF_STEREOFRUSTUM;
+	return qtrue;
+}
+
 /*
 =================
 R_SetupFrustum
@@ -713,6 +837,16 @@ void R_SetupFrustum( void ) {
 	float xs, xc;
 	float ang;
 
+	tr.viewParms.flags &= ~VPF_STEREOFRUSTUM;
+
+	// the main view of the world in the headset is culled for both eyes,
+	// portals, shadow maps and the hud keep the mono frustum
+	if ( tr.vrParms.valid && !VR_useScreenLayer() && !tr.viewParms.isPortal
+		&& !( tr.viewParms.flags & ( VPF_SHADOWMAP | VPF_DEPTHSHADOW | VPF_ORTHOGRAPHIC ) )
+		&& !( tr.refdef.rdflags & RDF_NOWORLDMODEL ) && R_SetupStereoFrustum() ) {
+		return;
+	}
+
 	ang = tr.viewParms.fovX / 180 * M_PI * 0.5f;
 	xs = sinf( ang );
 	xc = cosf( ang );
@@ -1263,6 +1397,8 @@ qboolean R_MirrorViewBySurface (drawSurf_t *drawSurf, int entityNum) {
 	viewParms_t		newParms;
 	viewParms_t		oldParms;
 	orientation_t	surface, camera;
+	int				culledEyes[MAX_REFENTITIES];
+	int				i;
 
 	// don't recursively mirror
 	if (tr.viewParms.isPortal) {
@@ -1305,11 +1441,25 @@ qboolean R_MirrorViewBySurface (drawSurf_t *drawSurf, int entityNum) {
 
 	// OPTIMIZE: restrict the viewport on the mirrored view
 
+	// the mirror view culls the entities again with a mono frustum and
+	// clears culledEyes, which this view's drawSurfs still need
+	if ( oldParms.flags & VPF_STEREOFRUSTUM ) {
+		for ( i = 0 ; i < tr.refdef.num_entities ; i++ ) {
+			culledEyes[i] = tr.refdef.entities[i].culledEyes;
+		}
+	}
+
 	// render the mirror view
 	R_RenderView (&newParms);
 
 	tr.viewParms = oldParms;
 
+	if ( oldParms.flags & VPF_STEREOFRUSTUM ) {
+		for ( i = 0 ; i < tr.refdef.num_entities ; i++ ) {
+			tr.refdef.entities[i].culledEyes = culledEyes[i];
+		}
+	}
+
 	return qtrue;
 }
 
@@ -1418,19 +1568,30 @@ R_AddDrawSurf
 */
 void R_AddDrawSurf( surfaceType_t *surface, shader_t *shader, 
 				   int fogIndex, int dlightMap, int pshadowMap, int cubemap ) {
-	int			index;
-
 	// instead of checking for overflow, we just mask the index
 	// so it wraps around
-	index = tr.refdef.numDrawSurfs & DRAWSURF_MASK;
+	R_SetDrawSurf( &tr.refdef.drawSurfs[tr.refdef.numDrawSurfs & DRAWSURF_MASK], surface, shader,
+		fogIndex, dlightMap, pshadowMap, cubemap );
+	tr.refdef.numDrawSurfs++;
+}
+
+/*
+=================
+R_SetDrawSurf
+
+Fills in a drawSurf for the current entity without adding it to the
+refdef, for the world jobs that collect their own lists
+=================
+*/
+void R_SetDrawSurf( drawSurf_t *drawSurf, surfaceType_t *surface, shader_t *shader,
+				   int fogIndex, int dlightMap, int pshadowMap, int cubemap ) {
 	// the sort data is packed into a single 32 bit value so it can be
 	// compared quickly during the qsorting process
-	tr.refdef.drawSurfs[index].sort = (shader->sortedIndex << QSORT_SHADERNUM_SHIFT) 
+	drawSurf->sort = (shader->sortedIndex << QSORT_SHADERNUM_SHIFT) 
 		| tr.shiftedEntityNum | ( fogIndex << QSORT_FOGNUM_SHIFT ) 
 		| ((int)pshadowMap << QSORT_PSHADOW_SHIFT) | (int)dlightMap;
-	tr.refdef.drawSurfs[index].cubemapIndex = cubemap;
-	tr.refdef.drawSurfs[index].surface = surface;
-	tr.refdef.numDrawSurfs++;
+	drawSurf->cubemapIndex = cubemap;
+	drawSurf->surface = surface;
 }
 
 /*
@@ -1516,6 +1677,7 @@ static void R_AddEntitySurface (int entityNum)
 	ent = tr.currentEntity = &tr.refdef.entities[tr.currentEntityNum];
 
 	ent->needDlights = qfalse;
+	ent->culledEyes = 0;
 
 	// preshift the value we are going to OR into the drawsurf sort
 	tr.shiftedEntityNum = tr.currentEntityNum << QSORT_REFENTITYNUM_SHIFT;
@@ -148,6 +148,7 @@ static int R_CullModel( mdvModel_t *model, trRefEntity_t *ent ) {
 		return CULL_IN;
 	case CULL_CLIP:
 		tr.pc.c_box_cull_md3_clip++;
+		ent->culledEyes = R_CullLocalBoxEyes( bounds );
 		return CULL_CLIP;
 	case CULL_OUT:
 	default:
@@ -960,8 +960,14 @@ qboolean R_LoadIQM( model_t *mod, void *buffer, int filesize, const char *mod_na
 		}
 	}
 
-	// Create VAO surfaces
-	if ( iqmData->num_surfaces && iqmData->num_joints <= glRefConfig.glslMaxAnimatedBones )
+	// Create VAO surfaces, models with more joints than fit in the
+	// bone buffer block are skinned on the CPU
+	if ( iqmData->num_surfaces && iqmData->num_joints > glRefConfig.glslMaxAnimatedBones )
+	{
+		ri.Printf( PRINT_DEVELOPER, "R_LoadIQM: %s has %i joints, more than the %i that can be skinned on the GPU\n",
+				mod_name, iqmData->num_joints, glRefConfig.glslMaxAnimatedBones );
+	}
+	else if ( iqmData->num_surfaces )
 	{
 		srfVaoIQModel_t *vaoSurf;
 		srfIQModel_t *surf;
@@ -973,7 +979,7 @@ qboolean R_LoadIQM( model_t *mod, void *buffer, int filesize, const char *mod_na
 		surf = iqmData->surfaces;
 		for (i = 0; i < iqmData->num_surfaces; i++, vaoSurf++, surf++)
 		{
-			uint32_t offset_xyz, offset_st, offset_normal, offset_tangent;
+			uint32_t offset_xyz, offset_st, offset_normal, offset_tangent, offset_color;
 			uint32_t offset_blendindexes, offset_blendweights, stride;
 			uint32_t dataSize, dataOfs;
 			uint8_t *data;
@@ -985,10 +991,20 @@ qboolean R_LoadIQM( model_t *mod, void *buffer, int filesize, const char *mod_na
 			offset_st      = offset_xyz + sizeof(float) * 3;
 			offset_normal  = offset_st + sizeof(float) * 2;
 			offset_tangent = offset_normal + sizeof(int16_t) * 4;
+			offset_color   = offset_tangent + sizeof(int16_t) * 4;
+
+			if ( iqmData->colors )
+			{
+				stride = offset_color + sizeof(byte) * 4;
+			}
+			else
+			{
+				stride = offset_color;
+			}
 
 			if ( iqmData->num_joints )
 			{
-				offset_blendindexes = offset_tangent + sizeof(int16_t) * 4;
+				offset_blendindexes = stride;
 				offset_blendweights = offset_blendindexes + sizeof(byte) * 4;
 
 				if ( vertexArrayFormat[IQM_BLENDWEIGHTS] == IQM_FLOAT ) {
@@ -997,10 +1013,6 @@ qboolean R_LoadIQM( model_t *mod, void *buffer, int filesize, const char *mod_na
 					stride = offset_blendweights + sizeof(byte) * 4;
 				}
 			}
-			else
-			{
-				stride = offset_tangent + sizeof(int16_t) * 4;
-			}
 
 			dataSize = surf->num_vertexes * stride;
 
@@ -1027,6 +1039,12 @@ qboolean R_LoadIQM( model_t *mod, void *buffer, int filesize, const char *mod_na
 				R_VaoPackTangent((int16_t*)(data + dataOfs), &iqmData->tangents[vtx*4]);
 				dataOfs += sizeof(int16_t) * 4;
 
+				if ( iqmData->colors )
+				{
+					memcpy(data + dataOfs, &iqmData->colors[vtx*4], sizeof(byte) * 4);
+					dataOfs += sizeof(byte) * 4;
+				}
+
 				if ( iqmData->num_joints )
 				{
 					// blendindexes
@@ -1092,6 +1110,16 @@ qboolean R_LoadIQM( model_t *mod, void *buffer, int filesize, const char *mod_na
 			vaoSurf->vao->attribs[ATTR_INDEX_NORMAL  ].stride = stride;
 			vaoSurf->vao->attribs[ATTR_INDEX_TANGENT ].stride = stride;
 
+			if ( iqmData->colors )
+			{
+				vaoSurf->vao->attribs[ATTR_INDEX_COLOR].enabled = 1;
+				vaoSurf->vao->attribs[ATTR_INDEX_COLOR].count = 4;
+				vaoSurf->vao->attribs[ATTR_INDEX_COLOR].type = GL_UNSIGNED_BYTE;
+				vaoSurf->vao->attribs[ATTR_INDEX_COLOR].normalized = GL_TRUE;
+				vaoSurf->vao->attribs[ATTR_INDEX_COLOR].offset = offset_color;
+				vaoSurf->vao->attribs[ATTR_INDEX_COLOR].stride = stride;
+			}
+
 			if ( iqmData->num_joints )
 			{
 				vaoSurf->vao->attribs[ATTR_INDEX_BONE_INDEXES].enabled = 1;
@@ -1159,6 +1187,7 @@ static int R_CullIQM( iqmData_t *data, trRefEntity_t *ent ) {
 		return CULL_IN;
 	case CULL_CLIP:
 		tr.pc.c_box_cull_md3_clip++;
+		ent->culledEyes = R_CullLocalBoxEyes( bounds );
 		return CULL_CLIP;
 	case CULL_OUT:
 	default:
@@ -1307,7 +1336,7 @@ void R_AddIQMSurfaces( trRefEntity_t *ent ) {
 			shader = surface->shader;
 		}
 
-		if ( data->numVaoSurfaces ) {
+		if ( data->numVaoSurfaces && r_gpuSkinning->integer ) {
 			drawSurf = &data->vaoSurfaces[i];
 		} else {
 			drawSurf = surface;
@@ -1654,6 +1683,43 @@ void RB_IQMSurfaceAnim( surfaceType_t *surface ) {
 	tess.numVertexes += surf->num_vertexes;
 }
 
+/*
+=================
+RB_IQMBoneMatrices
+
+Interpolated joint matrices of an entity for the vertex shaders
+=================
+*/
+void RB_IQMBoneMatrices( iqmData_t *data, const refEntity_t *e, mat4_t *boneMatrix ) {
+	float		jointMats[IQM_MAX_JOINTS * 12];
+	int			frame = data->num_frames ? e->frame % data->num_frames : 0;
+	int			oldframe = data->num_frames ? e->oldframe % data->num_frames : 0;
+	int			i;
+
+	// compute interpolated joint matrices
+	ComputePoseMats( data, frame, oldframe, e->backlerp, jointMats );
+
+	// convert row-major order 3x4 matrix to column-major order 4x4 matrix
+	for ( i = 0; i < data->num_poses; i++ ) {
+		boneMatrix[i][0] = jointMats[i*12+0];
+		boneMatrix[i][1] = jointMats[i*12+4];
+		boneMatrix[i][2] = jointMats[i*12+8];
+		boneMatrix[i][3] = 0.0f;
+		boneMatrix[i][4] = jointMats[i*12+1];
+		boneMatrix[i][5] = jointMats[i*12+5];
+		boneMatrix[i][6] = jointMats[i*12+9];
+		boneMatrix[i][7] = 0.0f;
+		boneMatrix[i][8] = jointMats[i*12+2];
+		boneMatrix[i][9] = jointMats[i*12+6];
+		boneMatrix[i][10] = jointMats[i*12+10];
+		boneMatrix[i][11] = 0.0f;
+		boneMatrix[i][12] = jointMats[i*12+3];
+		boneMatrix[i][13] = jointMats[i*12+7];
+		boneMatrix[i][14] = jointMats[i*12+11];
+		boneMatrix[i][15] = 1.0f;
+	}
+}
+
 /*
 =================
 RB_IQMSurfaceAnimVao
@@ -1686,34 +1752,20 @@ void RB_IQMSurfaceAnimVao(srfVaoIQModel_t * surface)
 	glState.boneAnimation = data->num_poses;
 
 	if ( glState.boneAnimation ) {
-		float		jointMats[IQM_MAX_JOINTS * 12];
-		int			frame = data->num_frames ? backEnd.currentEntity->e.frame % data->num_frames : 0;
-		int			oldframe = data->num_frames ? backEnd.currentEntity->e.oldframe % data->num_frames : 0;
-		float		backlerp = backEnd.currentEntity->e.backlerp;
-		int i;
+		trRefEntity_t	*ent = backEnd.currentEntity;
 
-		// compute interpolated joint matrices
-		ComputePoseMats( surface->iqmData, frame, oldframe, backlerp, jointMats );
-
-		// convert row-major order 3x4 matrix to column-major order 4x4 matrix
-		for ( i = 0; i < data->num_poses; i++ ) {
-			glState.boneMatrix[i][0] = jointMats[i*12+0];
-			glState.boneMatrix[i][1] = jointMats[i*12+4];
-			glState.boneMatrix[i][2] = jointMats[i*12+8];
-			glState.boneMatrix[i][3] = 0.0f;
-			glState.boneMatrix[i][4] = jointMats[i*12+1];
-			glState.boneMatrix[i][5] = jointMats[i*12+5];
-			glState.boneMatrix[i][6] = jointMats[i*12+9];
-			glState.boneMatrix[i][7] = 0.0f;
-			glState.boneMatrix[i][8] = jointMats[i*12+2];
-			glState.boneMatrix[i][9] = jointMats[i*12+6];
-			glState.boneMatrix[i][10] = jointMats[i*12+10];
-			glState.boneMatrix[i][11] = 0.0f;
-			glState.boneMatrix[i][12] = jointMats[i*12+3];
-			glState.boneMatrix[i][13] = jointMats[i*12+7];
-			glState.boneMatrix[i][14] = jointMats[i*12+11];
-			glState.boneMatrix[i][15] = 1.0f;
+		// the joints of an entity are uploaded once and shared by all
+		// its surfaces and every view and pass that draws them
+		if ( ent->boneBufferFill != GLSL_BoneBufferFill() ) {
+			mat4_t	boneMatrix[IQM_MAX_JOINTS];
+
+			RB_IQMBoneMatrices( data, &ent->e, boneMatrix );
+
+			ent->boneOffset = GLSL_UploadBoneMatrices( boneMatrix, data->num_poses );
+			ent->boneBufferFill = GLSL_BoneBufferFill();
 		}
+
+		glState.boneOffset = ent->boneOffset;
 	}
 
 	RB_EndSurface();
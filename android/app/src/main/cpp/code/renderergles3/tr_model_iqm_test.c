@@ -0,0 +1,155 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// tr_model_iqm_test.c -- times the CPU side of skinning IQM models on the
+// CPU and on the GPU
+
+/*
+
+iqmbench <model> [count] [frames]
+
+Registers model, which has to be an IQM, and animates count instances of it
+(32 by default) through frames frames (100 by default), every instance at a
+different point of the animation.  The CPU time this takes a frame is timed
+both ways an animated IQM can be drawn:
+
+- CPU skinning, RB_IQMSurfaceAnim for every surface of every instance, which
+  is what r_gpuSkinning 0 and models with too many joints cost,
+- GPU skinning, RB_IQMBoneMatrices once for every instance, which is all
+  that is left on the CPU when the vertex shaders do the skinning.
+
+Nothing is drawn and no GL calls are made, so the upload of the joint
+matrices and the time the GPU spends skinning aren't included.
+
+*/
+
+#include "tr_local.h"
+
+#define	IB_MAX_INSTANCES	256
+
+/*
+=================
+IB_Animate
+=================
+*/
+static void IB_Animate( trRefEntity_t *ents, int count, const iqmData_t *data, int frame ) {
+	int		i;
+
+	for ( i = 0 ; i < count ; i++ ) {
+		ents[i].e.frame = ( frame + i * 7 ) % data->num_frames;
+		ents[i].e.oldframe = ( ents[i].e.frame + data->num_frames - 1 ) % data->num_frames;
+		ents[i].e.backlerp = ( ( frame + i ) & 3 ) * 0.25f;
+	}
+}
+
+/*
+=================
+R_IQMBench_f
+=================
+*/
+void R_IQMBench_f( void ) {
+	static trRefEntity_t	ents[IB_MAX_INSTANCES];
+	static mat4_t			boneMatrix[IQM_MAX_JOINTS];
+	trRefEntity_t	*savedEntity;
+	model_t			*model;
+	iqmData_t		*data;
+	int				count, frames;
+	int				i, j, f, start, numVertexes;
+	int				msec[2];
+
+	if ( ri.Cmd_Argc() < 2 ) {
+		ri.Printf( PRINT_ALL, "usage: iqmbench <model> [count] [frames]\n" );
+		return;
+	}
+	count = ri.Cmd_Argc() > 2 ? atoi( ri.Cmd_Argv( 2 ) ) : 32;
+	if ( count < 1 || count > IB_MAX_INSTANCES ) {
+		ri.Printf( PRINT_ALL, "iqmbench: count has to be 1 to %i\n", IB_MAX_INSTANCES );
+		return;
+	}
+	frames = ri.Cmd_Argc() > 3 ? atoi( ri.Cmd_Argv( 3 ) ) : 100;
+	if ( frames < 1 ) {
+		frames = 1;
+	}
+
+	if ( !tr.registered ) {
+		ri.Printf( PRINT_ALL, "iqmbench: renderer not running\n" );
+		return;
+	}
+
+	model = R_GetModelByHandle( RE_RegisterModel( ri.Cmd_Argv( 1 ) ) );
+	if ( model->type != MOD_IQM ) {
+		ri.Printf( PRINT_ALL, "iqmbench: %s is not an IQM model\n", ri.Cmd_Argv( 1 ) );
+		return;
+	}
+	data = model->modelData;
+	if ( !data->num_poses || !data->num_frames ) {
+		ri.Printf( PRINT_ALL, "iqmbench: %s is not animated\n", model->name );
+		return;
+	}
+
+	// RB_IQMSurfaceAnim fills tess, which the render thread may be using
+	RE_SyncRenderThread();
+	savedEntity = backEnd.currentEntity;
+
+	Com_Memset( ents, 0, count * sizeof( ents[0] ) );
+
+	numVertexes = 0;
+	for ( j = 0 ; j < data->num_surfaces ; j++ ) {
+		numVertexes += data->surfaces[j].num_vertexes;
+	}
+
+	start = ri.Milliseconds();
+	for ( f = 0 ; f < frames ; f++ ) {
+		IB_Animate( ents, count, data, f );
+		for ( i = 0 ; i < count ; i++ ) {
+			backEnd.currentEntity = &ents[i];
+			for ( j = 0 ; j < data->num_surfaces ; j++ ) {
+				tess.numVertexes = 0;
+				tess.numIndexes = 0;
+				RB_IQMSurfaceAnim( &data->surfaces[j].surfaceType );
+			}
+		}
+	}
+	msec[0] = ri.Milliseconds() - start;
+
+	start = ri.Milliseconds();
+	for ( f = 0 ; f < frames ; f++ ) {
+		IB_Animate( ents, count, data, f );
+		for ( i = 0 ; i < count ; i++ ) {
+			RB_IQMBoneMatrices( data, &ents[i].e, boneMatrix );
+		}
+	}
+	msec[1] = ri.Milliseconds() - start;
+
+	tess.numVertexes = 0;
+	tess.numIndexes = 0;
+	backEnd.currentEntity = savedEntity;
+
+	ri.Printf( PRINT_ALL, "iqmbench: %s, %i joints, %i surfaces, %i vertexes, %i instances, %i frames\n",
+		model->name, data->num_joints, data->num_surfaces, numVertexes, count, frames );
+	ri.Printf( PRINT_ALL, "iqmbench: CPU skinning %i msec, %i usec a frame\n",
+		msec[0], msec[0] * 1000 / frames );
+	ri.Printf( PRINT_ALL, "iqmbench: GPU skinning %i msec, %i usec a frame\n",
+		msec[1], msec[1] * 1000 / frames );
+	if ( !data->numVaoSurfaces ) {
+		ri.Printf( PRINT_ALL, "iqmbench: %s has too many joints, it is always skinned on the CPU\n", model->name );
+	}
+}
@@ -35,11 +35,20 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 ==================
 R_DrawElements
 
+Draws glState.numInstances entities at once if that is set
 ==================
 */
 
 void R_DrawElements( int numIndexes, int firstIndex )
 {
+	backEnd.pc.c_drawCalls++;
+
+	if (glState.numInstances)
+	{
+		qglDrawElementsInstanced(GL_TRIANGLES, numIndexes, GL_INDEX_TYPE, BUFFER_OFFSET(firstIndex * sizeof(glIndex_t)), glState.numInstances);
+		return;
+	}
+
 	qglDrawElements(GL_TRIANGLES, numIndexes, GL_INDEX_TYPE, BUFFER_OFFSET(firstIndex * sizeof(glIndex_t)));
 }
 
@@ -930,11 +939,6 @@ static void RB_FogPass( void ) {
 
 	GLSL_SetUniformFloat(sp, UNIFORM_VERTEXLERP, glState.vertexAttribsInterpolation);
 
-	if (glState.boneAnimation)
-	{
-		GLSL_SetUniformMat4BoneMatrix(sp, UNIFORM_BONEMATRIX, glState.boneMatrix, glState.boneAnimation);
-	}
-	
 	GLSL_SetUniformInt(sp, UNIFORM_DEFORMGEN, deformGen);
 	if (deformGen != DGEN_NONE)
 	{
@@ -994,6 +998,14 @@ static void RB_IterateStagesGeneric( shaderCommands_t *input )
 
 	qboolean renderToCubemap = tr.renderCubeFbo && glState.currentFBO == tr.renderCubeFbo;
 
+	// models outside the frustum of one eye aren't transformed for it
+	int culledEyes = 0;
+
+	if ((backEnd.viewParms.flags & VPF_STEREOFRUSTUM) && backEnd.currentEntity)
+	{
+		culledEyes = backEnd.currentEntity->culledEyes;
+	}
+
 	ComputeDeformValues(&deformGen, deformParams);
 
 	ComputeFogValues(fogDistanceVector, fogDepthVector, &eyeT);
@@ -1101,17 +1113,14 @@ static void RB_IterateStagesGeneric( shaderCommands_t *input )
 		GLSL_BindProgram(sp);
 
 		GLSL_SetUniformMat4(sp, UNIFORM_MODELMATRIX, glState.modelMatrix);
+		GLSL_SetUniformInt(sp, UNIFORM_CULLEDEYES, culledEyes);
+		GLSL_SetUniformInt(sp, UNIFORM_INSTANCED, glState.numInstances != 0);
 		GLSL_BindBuffers(sp);
 		GLSL_SetUniformVec3(sp, UNIFORM_VIEWORIGIN, backEnd.viewParms.or.origin);
 		GLSL_SetUniformVec3(sp, UNIFORM_LOCALVIEWORIGIN, backEnd.or.viewOrigin);
 
 		GLSL_SetUniformFloat(sp, UNIFORM_VERTEXLERP, glState.vertexAttribsInterpolation);
 
-		if (glState.boneAnimation)
-		{
-			GLSL_SetUniformMat4BoneMatrix(sp, UNIFORM_BONEMATRIX, glState.boneMatrix, glState.boneAnimation);
-		}
-		
 		GLSL_SetUniformInt(sp, UNIFORM_DEFORMGEN, deformGen);
 		if (deformGen != DGEN_NONE)
 		{
@@ -1343,7 +1352,7 @@ static void RB_IterateStagesGeneric( shaderCommands_t *input )
 						GL_BindToTMU( tr.whiteImage, TB_SPECULARMAP );
 				}
 
-				enableTextures[3] = (r_cubeMapping->integer && !(tr.viewParms.flags & VPF_NOCUBEMAPS) && input->cubemapIndex) ? 1.0f : 0.0f;
+				enableTextures[3] = (r_cubeMapping->integer && !(backEnd.viewParms.flags & VPF_NOCUBEMAPS) && input->cubemapIndex) ? 1.0f : 0.0f;
 			}
 
 			GLSL_SetUniformVec4(sp, UNIFORM_ENABLETEXTURES, enableTextures);
@@ -1364,7 +1373,7 @@ static void RB_IterateStagesGeneric( shaderCommands_t *input )
 		//
 		// testing cube map
 		//
-		if (!(tr.viewParms.flags & VPF_NOCUBEMAPS) && input->cubemapIndex && r_cubeMapping->integer)
+		if (!(backEnd.viewParms.flags & VPF_NOCUBEMAPS) && input->cubemapIndex && r_cubeMapping->integer)
 		{
 			vec4_t vec;
 			cubemap_t *cubemap = &tr.cubemaps[input->cubemapIndex - 1];
@@ -1426,11 +1435,6 @@ static void RB_RenderShadowmap( shaderCommands_t *input )
 
 		GLSL_SetUniformFloat(sp, UNIFORM_VERTEXLERP, glState.vertexAttribsInterpolation);
 
-		if (glState.boneAnimation)
-		{
-			GLSL_SetUniformMat4BoneMatrix(sp, UNIFORM_BONEMATRIX, glState.boneMatrix, glState.boneAnimation);
-		}
-
 		GLSL_SetUniformInt(sp, UNIFORM_DEFORMGEN, deformGen);
 		if (deformGen != DGEN_NONE)
 		{
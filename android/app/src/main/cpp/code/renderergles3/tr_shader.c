@@ -2645,7 +2645,7 @@ sortedIndex.
 ==============
 */
 static void FixRenderCommandList( int newShader ) {
-	renderCommandList_t	*cmdList = &backEndData->commands;
+	renderCommandList_t	*cmdList = &backEndData[tr.smpFrame]->commands;
 
 	if( cmdList ) {
 		const void *curCmd = cmdList->cmds;
@@ -2725,6 +2725,11 @@ static void SortNewShader( void ) {
 	float	sort;
 	shader_t	*newShader;
 
+	// the render thread may be drawing with the old sorted indices
+	if ( glConfig.smpActive ) {
+		R_IssuePendingRenderCommands();
+	}
+
 	newShader = tr.shaders[ tr.numShaders - 1 ];
 	sort = newShader->sort;
 
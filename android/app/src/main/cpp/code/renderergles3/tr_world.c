@@ -221,12 +221,6 @@ static int R_DlightSurface( msurface_t *surf, int dlightBits ) {
 			break;
 	}
 
-	if ( dlightBits ) {
-		tr.pc.c_dlightSurfaces++;
-	} else {
-		tr.pc.c_dlightSurfacesCulled++;
-	}
-
 	return dlightBits;
 }
 
@@ -316,30 +310,51 @@ static int R_PshadowSurface( msurface_t *surf, int pshadowBits ) {
 
 /*
 ======================
-R_AddWorldSurface
+R_CullWorldSurface
+
+Returns qtrue if the surface can't be seen, otherwise throws out the
+dlights and pshadows that don't reach it.  Only touches the surface
+itself, so the world jobs can call it.
 ======================
 */
-static void R_AddWorldSurface( msurface_t *surf, int dlightBits, int pshadowBits ) {
+static qboolean R_CullWorldSurface( msurface_t *surf, int *dlightBits, int *pshadowBits ) {
 	// FIXME: bmodel fog?
 
 	// try to cull before dlighting or adding
 	if ( R_CullSurface( surf ) ) {
-		return;
+		return qtrue;
 	}
 
 	// check for dlighting
 	/*if ( dlightBits ) */{
-		dlightBits = R_DlightSurface( surf, dlightBits );
-		dlightBits = ( dlightBits != 0 );
+		*dlightBits = R_DlightSurface( surf, *dlightBits );
 	}
 
 	// check for pshadows
 	/*if ( pshadowBits ) */{
-		pshadowBits = R_PshadowSurface( surf, pshadowBits);
-		pshadowBits = ( pshadowBits != 0 );
+		*pshadowBits = R_PshadowSurface( surf, *pshadowBits );
 	}
 
-	R_AddDrawSurf( surf->data, surf->shader, surf->fogIndex, dlightBits, pshadowBits, surf->cubemapIndex );
+	return qfalse;
+}
+
+/*
+======================
+R_AddWorldSurface
+======================
+*/
+static void R_AddWorldSurface( msurface_t *surf, int dlightBits, int pshadowBits ) {
+	if ( R_CullWorldSurface( surf, &dlightBits, &pshadowBits ) ) {
+		return;
+	}
+
+	if ( dlightBits ) {
+		tr.pc.c_dlightSurfaces++;
+	} else {
+		tr.pc.c_dlightSurfacesCulled++;
+	}
+
+	R_AddDrawSurf( surf->data, surf->shader, surf->fogIndex, dlightBits != 0, pshadowBits != 0, surf->cubemapIndex );
 }
 
 /*
@@ -369,6 +384,9 @@ void R_AddBrushModelSurfaces ( trRefEntity_t *ent ) {
 	if ( clip == CULL_OUT ) {
 		return;
 	}
+	if ( clip == CULL_CLIP ) {
+		ent->culledEyes = R_CullLocalBoxEyes( bmodel->bounds );
+	}
 	
 	R_SetupEntityLighting( &tr.refdef, ent );
 	R_DlightBmodel( bmodel );
@@ -394,17 +412,136 @@ void R_AddBrushModelSurfaces ( trRefEntity_t *ent ) {
 */
 
 
+/*
+With r_worldThreads the world is walked and its surfaces are culled on the
+job threads.  The top WORLD_SPLIT_DEPTH levels of the tree are walked here,
+and every node reached at that depth, or leaf above it, becomes a job that
+walks its own subtree.  Each job writes the leafs it reaches to its part of
+tr.world->jobLeafs, the subtree's numLeafs long.  The surfaces in those
+leafs are then marked here, in the same order as the single threaded walk.
+
+The marked surfaces are culled in WORLD_SURFACE_JOBS ranges, each filling
+its part of tr.world->jobDrawSurfs, and the lists are copied to the refdef
+in order, so the drawSurfs come out exactly as without r_worldThreads.
+*/
+
+#define	WORLD_SPLIT_DEPTH		6
+#define	MAX_WORLD_JOBS			( 1 << WORLD_SPLIT_DEPTH )
+#define	WORLD_SURFACE_JOBS		32
+
+typedef struct {
+	worldNode_t	top;			// where a world job starts
+	worldNode_t	*nodes;			// nodes reached, NULL to mark the surfaces of leafs
+	int			numNodes;
+	int			splitDepth;		// add nodes at this depth instead of walking them, -1 for none
+
+	vec3_t		visBounds[2];
+	int			c_leafs;
+} worldWalk_t;
+
+typedef struct {
+	int			firstSurface;
+	int			numSurfaces;
+
+	int			numDrawSurfs;
+	int			dlightMask;
+	int			c_dlightSurfaces;
+	int			c_dlightSurfacesCulled;
+} worldSurfaceJob_t;
+
+/*
+================
+R_InitWalk
+================
+*/
+static void R_InitWalk( worldWalk_t *walk, worldNode_t *nodes, int splitDepth ) {
+	walk->nodes = nodes;
+	walk->numNodes = 0;
+	walk->splitDepth = splitDepth;
+	ClearBounds( walk->visBounds[0], walk->visBounds[1] );
+	walk->c_leafs = 0;
+}
+
+/*
+================
+R_AddWalkNode
+================
+*/
+static void R_AddWalkNode( worldWalk_t *walk, mnode_t *node, uint32_t planeBits, uint32_t dlightBits, uint32_t pshadowBits ) {
+	worldNode_t	*out;
+
+	out = &walk->nodes[walk->numNodes++];
+	out->node = node;
+	out->planeBits = planeBits;
+	out->dlightBits = dlightBits;
+	out->pshadowBits = pshadowBits;
+}
+
+/*
+================
+R_MarkLeafSurfaces
+================
+*/
+static void R_MarkLeafSurfaces( mnode_t *node, uint32_t dlightBits, uint32_t pshadowBits ) {
+	int			c;
+	int surf, *view;
+
+	// add surfaces
+	view = tr.world->marksurfaces + node->firstmarksurface;
+
+	c = node->nummarksurfaces;
+	while (c--) {
+		// just mark it as visible, so we don't jump out of the cache derefencing the surface
+		surf = *view;
+		if (tr.world->surfacesViewCount[surf] != tr.viewCount)
+		{
+			tr.world->surfacesViewCount[surf] = tr.viewCount;
+			tr.world->surfacesDlightBits[surf] = dlightBits;
+			tr.world->surfacesPshadowBits[surf] = pshadowBits;
+		}
+		else
+		{
+			tr.world->surfacesDlightBits[surf] |= dlightBits;
+			tr.world->surfacesPshadowBits[surf] |= pshadowBits;
+		}
+		view++;
+	}
+}
+
+/*
+================
+R_FinishWalk
+
+Adds the visible bounds and leaf count of a walk to the view
+================
+*/
+static void R_FinishWalk( const worldWalk_t *walk ) {
+	if ( !walk->c_leafs ) {
+		return;
+	}
+
+	AddPointToBounds( walk->visBounds[0], tr.viewParms.visBounds[0], tr.viewParms.visBounds[1] );
+	AddPointToBounds( walk->visBounds[1], tr.viewParms.visBounds[0], tr.viewParms.visBounds[1] );
+	tr.pc.c_leafs += walk->c_leafs;
+}
+
 /*
 ================
 R_RecursiveWorldNode
 ================
 */
-static void R_RecursiveWorldNode( mnode_t *node, uint32_t planeBits, uint32_t dlightBits, uint32_t pshadowBits ) {
+static void R_RecursiveWorldNode( worldWalk_t *walk, mnode_t *node, int depth, uint32_t planeBits, uint32_t dlightBits, uint32_t pshadowBits ) {
 
 	do {
 		uint32_t newDlights[2];
 		uint32_t newPShadows[2];
 
+		// leave the rest of the tree to the world jobs
+		if ( walk->splitDepth >= 0 && ( depth == walk->splitDepth || node->contents != -1 ) ) {
+			R_AddWalkNode( walk, node, planeBits, dlightBits, pshadowBits );
+			return;
+		}
+
 		// if the node wasn't marked as potentially visible, exit
 		// pvs is skipped for depth shadows
 		if (!vr_thirdPersonSpectator->integer && !(tr.viewParms.flags & VPF_DEPTHSHADOW) && node->visCounts[tr.visIndex] != tr.visCounts[tr.visIndex]) {
@@ -523,62 +660,48 @@ static void R_RecursiveWorldNode( mnode_t *node, uint32_t planeBits, uint32_t dl
 		}
 
 		// recurse down the children, front side first
-		R_RecursiveWorldNode (node->children[0], planeBits, newDlights[0], newPShadows[0] );
+		R_RecursiveWorldNode (walk, node->children[0], depth + 1, planeBits, newDlights[0], newPShadows[0] );
 
 		// tail recurse
 		node = node->children[1];
+		depth++;
 		dlightBits = newDlights[1];
 		pshadowBits = newPShadows[1];
 	} while ( 1 );
 
 	{
 		// leaf node, so add mark surfaces
-		int			c;
-		int surf, *view;
-
-		tr.pc.c_leafs++;
+		walk->c_leafs++;
 
 		// add to z buffer bounds
-		if ( node->mins[0] < tr.viewParms.visBounds[0][0] ) {
-			tr.viewParms.visBounds[0][0] = node->mins[0];
+		if ( node->mins[0] < walk->visBounds[0][0] ) {
+			walk->visBounds[0][0] = node->mins[0];
 		}
-		if ( node->mins[1] < tr.viewParms.visBounds[0][1] ) {
-			tr.viewParms.visBounds[0][1] = node->mins[1];
+		if ( node->mins[1] < walk->visBounds[0][1] ) {
+			walk->visBounds[0][1] = node->mins[1];
 		}
-		if ( node->mins[2] < tr.viewParms.visBounds[0][2] ) {
-			tr.viewParms.visBounds[0][2] = node->mins[2];
+		if ( node->mins[2] < walk->visBounds[0][2] ) {
+			walk->visBounds[0][2] = node->mins[2];
 		}
 
-		if ( node->maxs[0] > tr.viewParms.visBounds[1][0] ) {
-			tr.viewParms.visBounds[1][0] = node->maxs[0];
+		if ( node->maxs[0] > walk->visBounds[1][0] ) {
+			walk->visBounds[1][0] = node->maxs[0];
 		}
-		if ( node->maxs[1] > tr.viewParms.visBounds[1][1] ) {
-			tr.viewParms.visBounds[1][1] = node->maxs[1];
+		if ( node->maxs[1] > walk->visBounds[1][1] ) {
+			walk->visBounds[1][1] = node->maxs[1];
 		}
-		if ( node->maxs[2] > tr.viewParms.visBounds[1][2] ) {
-			tr.viewParms.visBounds[1][2] = node->maxs[2];
+		if ( node->maxs[2] > walk->visBounds[1][2] ) {
+			walk->visBounds[1][2] = node->maxs[2];
 		}
 
-		// add surfaces
-		view = tr.world->marksurfaces + node->firstmarksurface;
-
-		c = node->nummarksurfaces;
-		while (c--) {
-			// just mark it as visible, so we don't jump out of the cache derefencing the surface
-			surf = *view;
-			if (tr.world->surfacesViewCount[surf] != tr.viewCount)
-			{
-				tr.world->surfacesViewCount[surf] = tr.viewCount;
-				tr.world->surfacesDlightBits[surf] = dlightBits;
-				tr.world->surfacesPshadowBits[surf] = pshadowBits;
-			}
-			else
-			{
-				tr.world->surfacesDlightBits[surf] |= dlightBits;
-				tr.world->surfacesPshadowBits[surf] |= pshadowBits;
-			}
-			view++;
+		// the world jobs can't mark surfaces, as other jobs may
+		// reach the same ones, so the leaf is marked later
+		if ( walk->nodes ) {
+			R_AddWalkNode( walk, node, 0, dlightBits, pshadowBits );
+			return;
 		}
+
+		R_MarkLeafSurfaces( node, dlightBits, pshadowBits );
 	}
 
 }
@@ -733,6 +856,133 @@ static void R_MarkLeaves (void) {
 }
 
 
+/*
+=============
+R_WorldWalkJob
+=============
+*/
+static void R_WorldWalkJob( void *data, int job ) {
+	worldWalk_t	*walk = (worldWalk_t *)data + job;
+
+	R_RecursiveWorldNode( walk, walk->top.node, 0, walk->top.planeBits, walk->top.dlightBits, walk->top.pshadowBits );
+}
+
+/*
+=============
+R_WalkWorldJobs
+
+Splits up R_RecursiveWorldNode over the job threads
+=============
+*/
+static void R_WalkWorldJobs( uint32_t planeBits, uint32_t dlightBits, uint32_t pshadowBits ) {
+	static worldNode_t	tops[MAX_WORLD_JOBS];
+	static worldWalk_t	walks[MAX_WORLD_JOBS];
+	worldWalk_t	split;
+	worldNode_t	*out;
+	int			i, j;
+
+	R_InitWalk( &split, tops, WORLD_SPLIT_DEPTH );
+	R_RecursiveWorldNode( &split, tr.world->nodes, 0, planeBits, dlightBits, pshadowBits );
+
+	// every subtree gets room for all of its leafs
+	out = tr.world->jobLeafs;
+	for ( i = 0 ; i < split.numNodes ; i++ ) {
+		R_InitWalk( &walks[i], out, -1 );
+		walks[i].top = tops[i];
+		out += tops[i].node->numLeafs;
+	}
+
+	ri.RunJobs( R_WorldWalkJob, walks, split.numNodes, r_worldThreads->integer );
+
+	for ( i = 0 ; i < split.numNodes ; i++ ) {
+		R_FinishWalk( &walks[i] );
+		for ( j = 0 ; j < walks[i].numNodes ; j++ ) {
+			R_MarkLeafSurfaces( walks[i].nodes[j].node, walks[i].nodes[j].dlightBits, walks[i].nodes[j].pshadowBits );
+		}
+	}
+}
+
+/*
+=============
+R_WorldSurfaceJob
+=============
+*/
+static void R_WorldSurfaceJob( void *data, int job ) {
+	worldSurfaceJob_t	*sj = (worldSurfaceJob_t *)data + job;
+	drawSurf_t	*drawSurfs = tr.world->jobDrawSurfs + sj->firstSurface;
+	msurface_t	*surf;
+	int			i, dlightBits, pshadowBits;
+
+	for ( i = sj->firstSurface ; i < sj->firstSurface + sj->numSurfaces ; i++ ) {
+		if ( tr.world->surfacesViewCount[i] != tr.viewCount ) {
+			continue;
+		}
+
+		dlightBits = tr.world->surfacesDlightBits[i];
+		pshadowBits = tr.world->surfacesPshadowBits[i];
+		sj->dlightMask |= dlightBits;
+
+		surf = tr.world->surfaces + i;
+		if ( R_CullWorldSurface( surf, &dlightBits, &pshadowBits ) ) {
+			continue;
+		}
+
+		if ( dlightBits ) {
+			sj->c_dlightSurfaces++;
+		} else {
+			sj->c_dlightSurfacesCulled++;
+		}
+
+		R_SetDrawSurf( &drawSurfs[sj->numDrawSurfs++], surf->data, surf->shader, surf->fogIndex,
+			dlightBits != 0, pshadowBits != 0, surf->cubemapIndex );
+	}
+}
+
+/*
+=============
+R_AddWorldSurfaceJobs
+
+Culls the marked surfaces over the job threads and adds them in order
+=============
+*/
+static void R_AddWorldSurfaceJobs( void ) {
+	static worldSurfaceJob_t	jobs[WORLD_SURFACE_JOBS];
+	const drawSurf_t	*in;
+	int			i, j, numJobs, first;
+
+	numJobs = 0;
+	for ( first = 0 ; first < tr.world->numWorldSurfaces ; numJobs++ ) {
+		jobs[numJobs].firstSurface = first;
+		jobs[numJobs].numSurfaces = ( tr.world->numWorldSurfaces + WORLD_SURFACE_JOBS - 1 ) / WORLD_SURFACE_JOBS;
+		if ( first + jobs[numJobs].numSurfaces > tr.world->numWorldSurfaces ) {
+			jobs[numJobs].numSurfaces = tr.world->numWorldSurfaces - first;
+		}
+		jobs[numJobs].numDrawSurfs = 0;
+		jobs[numJobs].dlightMask = 0;
+		jobs[numJobs].c_dlightSurfaces = 0;
+		jobs[numJobs].c_dlightSurfacesCulled = 0;
+		first += jobs[numJobs].numSurfaces;
+	}
+
+	ri.RunJobs( R_WorldSurfaceJob, jobs, numJobs, r_worldThreads->integer );
+
+	tr.refdef.dlightMask = 0;
+
+	for ( i = 0 ; i < numJobs ; i++ ) {
+		in = tr.world->jobDrawSurfs + jobs[i].firstSurface;
+		for ( j = 0 ; j < jobs[i].numDrawSurfs ; j++ ) {
+			tr.refdef.drawSurfs[tr.refdef.numDrawSurfs & DRAWSURF_MASK] = in[j];
+			tr.refdef.numDrawSurfs++;
+		}
+
+		tr.refdef.dlightMask |= jobs[i].dlightMask;
+		tr.pc.c_dlightSurfaces += jobs[i].c_dlightSurfaces;
+		tr.pc.c_dlightSurfacesCulled += jobs[i].c_dlightSurfacesCulled;
+	}
+
+	tr.refdef.dlightMask = ~tr.refdef.dlightMask;
+}
+
 /*
 =============
 R_AddWorldSurfaces
@@ -786,7 +1036,19 @@ void R_AddWorldSurfaces (void) {
 		pshadowBits = 0;
 	}
 
-	R_RecursiveWorldNode( tr.world->nodes, planeBits, dlightBits, pshadowBits);
+	if ( r_worldThreads->integer > 0 ) {
+		R_WalkWorldJobs( planeBits, dlightBits, pshadowBits );
+		R_AddWorldSurfaceJobs();
+		return;
+	}
+
+	{
+		worldWalk_t	walk;
+
+		R_InitWalk( &walk, NULL, -1 );
+		R_RecursiveWorldNode( &walk, tr.world->nodes, 0, planeBits, dlightBits, pshadowBits );
+		R_FinishWalk( &walk );
+	}
 
 	// now add all the potentially visible surfaces
 	// also mask invisible dlights for next frame
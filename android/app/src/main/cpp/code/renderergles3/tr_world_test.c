@@ -0,0 +1,283 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// tr_world_test.c -- times R_AddWorldSurfaces along a camera path with and
+// without r_worldThreads
+
+/*
+
+r_worldbench [threads] [repeat]
+
+Walks a camera path through the loaded map and times R_AddWorldSurfaces
+for every view, first single threaded and then with threads job threads
+(r_worldThreads, or 2 if that is 0).  The path stops at every spawn point
+in the entity string, turns around there, and then heads for the next one.
+It is walked repeat times (10 by default).
+
+Only the world front end runs.  No commands are issued and the drawSurfs go
+to a buffer of their own, so nothing is drawn and the time doesn't depend
+on the GL driver.  The drawSurfs of every view are checksummed in both runs
+and any view where they differ is reported.
+
+*/
+
+#include "tr_local.h"
+
+#define	WB_MAX_POINTS		64
+#define	WB_TURN_VIEWS		12		// views while turning around at a point
+#define	WB_MOVE_VIEWS		8		// views on the way to the next point
+#define	WB_VIEW_HEIGHT		26		// DEFAULT_VIEWHEIGHT
+
+/*
+=================
+WB_ParseSpawnPoints
+=================
+*/
+static int WB_ParseSpawnPoints( vec3_t *points, int maxPoints ) {
+	char		classname[MAX_QPATH], key[MAX_TOKEN_CHARS];
+	char		*p, *token;
+	vec3_t		origin;
+	int			numPoints;
+
+	numPoints = 0;
+	p = tr.world->entityString;
+	while ( p && numPoints < maxPoints ) {
+		token = COM_ParseExt( &p, qtrue );
+		if ( !*token ) {
+			break;
+		}
+		if ( *token != '{' ) {
+			continue;
+		}
+
+		classname[0] = 0;
+		VectorClear( origin );
+		while ( 1 ) {
+			token = COM_ParseExt( &p, qtrue );
+			if ( !*token || *token == '}' ) {
+				break;
+			}
+			Q_strncpyz( key, token, sizeof( key ) );
+
+			token = COM_ParseExt( &p, qtrue );
+			if ( !*token || *token == '}' ) {
+				break;
+			}
+			if ( !Q_stricmp( key, "classname" ) ) {
+				Q_strncpyz( classname, token, sizeof( classname ) );
+			} else if ( !Q_stricmp( key, "origin" ) ) {
+				sscanf( token, "%f %f %f", &origin[0], &origin[1], &origin[2] );
+			}
+		}
+
+		if ( !Q_stricmpn( classname, "info_player_", 12 ) ) {
+			VectorCopy( origin, points[numPoints] );
+			points[numPoints][2] += WB_VIEW_HEIGHT;
+			numPoints++;
+		}
+	}
+
+	return numPoints;
+}
+
+/*
+=================
+WB_SetupView
+=================
+*/
+static void WB_SetupView( const vec3_t origin, float yaw ) {
+	vec3_t		angles;
+
+	Com_Memset( &tr.viewParms, 0, sizeof( tr.viewParms ) );
+	VectorCopy( origin, tr.viewParms.or.origin );
+	VectorCopy( origin, tr.viewParms.pvsOrigin );
+	VectorSet( angles, 0, yaw, 0 );
+	AnglesToAxis( angles, tr.viewParms.or.axis );
+	tr.viewParms.fovX = 100;
+	tr.viewParms.fovY = 100;
+
+	tr.viewCount++;
+	tr.refdef.numDrawSurfs = 0;
+
+	R_RotateForViewer();
+	R_SetupProjection( &tr.viewParms, r_zproj->value, tr.viewParms.zFar, qtrue );
+}
+
+/*
+=================
+WB_Checksum
+=================
+*/
+static unsigned WB_Checksum( void ) {
+	unsigned	sum;
+	int			i;
+
+	sum = 0;
+	for ( i = 0 ; i < tr.refdef.numDrawSurfs && i < MAX_DRAWSURFS ; i++ ) {
+		sum = sum * 31 + tr.refdef.drawSurfs[i].sort;
+		sum = sum * 31 + (unsigned)( (intptr_t)tr.refdef.drawSurfs[i].surface );
+	}
+	return sum;
+}
+
+/*
+=================
+WB_RunPath
+
+Returns the msec spent in R_AddWorldSurfaces, the checksums of the views
+are written to sums, or compared with them if compare is set
+=================
+*/
+static int WB_RunPath( vec3_t *points, int numPoints, unsigned *sums, qboolean compare,
+		int *numViews, int *numDrawSurfs, int *numMismatched ) {
+	vec3_t		origin, dir;
+	float		yaw;
+	int			i, j, start, msec;
+	unsigned	sum;
+
+	msec = 0;
+	*numViews = 0;
+	*numDrawSurfs = 0;
+	*numMismatched = 0;
+	tr.refdef.areamaskModified = qtrue;
+
+	for ( i = 0 ; i < numPoints ; i++ ) {
+		const float	*next = points[( i + 1 ) % numPoints];
+
+		VectorSubtract( next, points[i], dir );
+		yaw = RAD2DEG( atan2( dir[1], dir[0] ) );
+
+		for ( j = 0 ; j < WB_TURN_VIEWS + WB_MOVE_VIEWS ; j++ ) {
+			if ( j < WB_TURN_VIEWS ) {
+				WB_SetupView( points[i], yaw + j * 360.0f / WB_TURN_VIEWS );
+			} else {
+				VectorMA( points[i], (float)( j - WB_TURN_VIEWS ) / WB_MOVE_VIEWS, dir, origin );
+				WB_SetupView( origin, yaw );
+			}
+
+			start = ri.Milliseconds();
+			R_AddWorldSurfaces();
+			msec += ri.Milliseconds() - start;
+			tr.refdef.areamaskModified = qfalse;
+
+			sum = WB_Checksum();
+			if ( !compare ) {
+				sums[*numViews] = sum;
+			} else if ( sums[*numViews] != sum ) {
+				(*numMismatched)++;
+			}
+
+			(*numViews)++;
+			*numDrawSurfs += tr.refdef.numDrawSurfs;
+		}
+	}
+
+	return msec;
+}
+
+/*
+=================
+R_WorldBench_f
+=================
+*/
+void R_WorldBench_f( void ) {
+	static vec3_t	points[WB_MAX_POINTS];
+	static unsigned	sums[WB_MAX_POINTS * ( WB_TURN_VIEWS + WB_MOVE_VIEWS )];
+	trRefdef_t		*savedRefdef;
+	viewParms_t		savedViewParms;
+	orientationr_t	savedOr;
+	drawSurf_t		*drawSurfs;
+	char			savedThreads[16];
+	int				numPoints, threads, repeat;
+	int				i, pass, numViews, numDrawSurfs, numMismatched;
+	int				msec[2];
+
+	if ( !tr.registered || !tr.world ) {
+		ri.Printf( PRINT_ALL, "r_worldbench: no map loaded\n" );
+		return;
+	}
+
+	threads = ri.Cmd_Argc() > 1 ? atoi( ri.Cmd_Argv( 1 ) ) : r_worldThreads->integer;
+	if ( threads < 1 ) {
+		threads = 2;
+	}
+	repeat = ri.Cmd_Argc() > 2 ? atoi( ri.Cmd_Argv( 2 ) ) : 10;
+	if ( repeat < 1 ) {
+		repeat = 1;
+	}
+
+	numPoints = WB_ParseSpawnPoints( points, WB_MAX_POINTS );
+	if ( numPoints < 1 ) {
+		// no spawn points, so just look around in the middle of the map
+		VectorAdd( tr.world->nodes[0].mins, tr.world->nodes[0].maxs, points[0] );
+		VectorScale( points[0], 0.5f, points[0] );
+		numPoints = 1;
+	}
+
+	// the back end reads the dlight bits the walk writes to the surfaces
+	RE_SyncRenderThread();
+
+	// the front end state is restored afterwards
+	savedRefdef = ri.Hunk_AllocateTempMemory( sizeof( *savedRefdef ) );
+	drawSurfs = ri.Hunk_AllocateTempMemory( MAX_DRAWSURFS * sizeof( *drawSurfs ) );
+	*savedRefdef = tr.refdef;
+	savedViewParms = tr.viewParms;
+	savedOr = tr.or;
+	Q_strncpyz( savedThreads, r_worldThreads->string, sizeof( savedThreads ) );
+
+	Com_Memset( &tr.refdef, 0, sizeof( tr.refdef ) );
+	tr.refdef.drawSurfs = drawSurfs;
+
+	numViews = numDrawSurfs = numMismatched = 0;
+	for ( i = 0 ; i < 2 ; i++ ) {
+		int		views, surfs, mismatched;
+
+		ri.Cvar_Set( "r_worldThreads", i ? va( "%i", threads ) : "0" );
+
+		msec[i] = 0;
+		for ( pass = 0 ; pass < repeat ; pass++ ) {
+			msec[i] += WB_RunPath( points, numPoints, sums, i || pass, &views, &surfs, &mismatched );
+			numViews += views;
+			numDrawSurfs += surfs;
+			numMismatched += mismatched;
+		}
+	}
+
+	ri.Cvar_Set( "r_worldThreads", savedThreads );
+	tr.refdef = *savedRefdef;
+	tr.viewParms = savedViewParms;
+	tr.or = savedOr;
+	ri.Hunk_FreeTempMemory( drawSurfs );
+	ri.Hunk_FreeTempMemory( savedRefdef );
+
+	// the vis clusters were marked with the bench's areamask
+	for ( i = 0 ; i < MAX_VISCOUNTS ; i++ ) {
+		tr.visClusters[i] = -2;
+	}
+
+	ri.Printf( PRINT_ALL, "r_worldbench: %s, %i spawn points, %i views, %i drawSurfs per view\n",
+		tr.world->baseName, numPoints, numViews / ( 2 * repeat ), numDrawSurfs / numViews );
+	ri.Printf( PRINT_ALL, "r_worldbench: single threaded %i msec, %i threads %i msec\n",
+		msec[0], threads, msec[1] );
+	if ( numMismatched ) {
+		ri.Printf( PRINT_WARNING, "r_worldbench: drawSurfs differ in %i views\n", numMismatched );
+	}
+}
@@ -1147,3 +1147,203 @@ void GLimp_EndFrame( void )
 	}
 #endif
 }
+
+/*
+===========================================================
+
+SMP acceleration
+
+===========================================================
+*/
+
+/*
+ * The GL context is only ever current on one thread.  The render thread
+ * takes it in GLimp_RendererSleep when it is handed a command list, and the
+ * front end takes it back in GLimp_FrontEndSleep once that list has been
+ * executed, so anything the front end does with GL in between syncs is safe.
+ */
+
+static SDL_mutex	*smpMutex = NULL;
+static SDL_cond		*renderCommandsEvent = NULL;
+static SDL_cond		*renderCompletedEvent = NULL;
+static SDL_Thread	*renderThread = NULL;
+static void			(*glimpRenderThread)( void ) = NULL;
+
+static volatile void		*smpData = NULL;
+static volatile qboolean	smpDataReady = qfalse;
+
+/*
+===============
+GLimp_RenderThreadWrapper
+===============
+*/
+static int GLimp_RenderThreadWrapper( void *arg )
+{
+	glimpRenderThread();
+
+	// unbind the context before we die
+	SDL_GL_MakeCurrent( SDL_window, NULL );
+
+	return 0;
+}
+
+/*
+===============
+GLimp_SpawnRenderThread
+===============
+*/
+qboolean GLimp_SpawnRenderThread( void (*function)( void ) )
+{
+	if ( renderThread )
+	{
+		ri.Printf( PRINT_WARNING, "Already running a render thread\n" );
+		return qfalse;
+	}
+
+	smpMutex = SDL_CreateMutex();
+	renderCommandsEvent = SDL_CreateCond();
+	renderCompletedEvent = SDL_CreateCond();
+	if ( !smpMutex || !renderCommandsEvent || !renderCompletedEvent )
+	{
+		ri.Printf( PRINT_WARNING, "Couldn't create render thread events: %s\n", SDL_GetError() );
+		GLimp_ShutdownRenderThread();
+		return qfalse;
+	}
+
+	smpData = NULL;
+	smpDataReady = qfalse;
+	glimpRenderThread = function;
+
+	renderThread = SDL_CreateThread( GLimp_RenderThreadWrapper, "render", NULL );
+	if ( !renderThread )
+	{
+		ri.Printf( PRINT_WARNING, "SDL_CreateThread() failed: %s\n", SDL_GetError() );
+		GLimp_ShutdownRenderThread();
+		return qfalse;
+	}
+
+	return qtrue;
+}
+
+/*
+===============
+GLimp_ShutdownRenderThread
+
+The render thread must be idle, the caller should have synced with it
+===============
+*/
+void GLimp_ShutdownRenderThread( void )
+{
+	if ( renderThread )
+	{
+		// a NULL command list tells the thread to return
+		GLimp_WakeRenderer( NULL );
+		SDL_WaitThread( renderThread, NULL );
+		renderThread = NULL;
+
+		SDL_GL_MakeCurrent( SDL_window, SDL_glContext );
+	}
+
+	if ( renderCompletedEvent )
+	{
+		SDL_DestroyCond( renderCompletedEvent );
+		renderCompletedEvent = NULL;
+	}
+	if ( renderCommandsEvent )
+	{
+		SDL_DestroyCond( renderCommandsEvent );
+		renderCommandsEvent = NULL;
+	}
+	if ( smpMutex )
+	{
+		SDL_DestroyMutex( smpMutex );
+		smpMutex = NULL;
+	}
+
+	glimpRenderThread = NULL;
+}
+
+/*
+===============
+GLimp_RendererSleep
+
+Called on the render thread when it has finished a command list, returns
+the next one
+===============
+*/
+void *GLimp_RendererSleep( void )
+{
+	void	*data;
+
+	SDL_GL_MakeCurrent( SDL_window, NULL );
+
+	SDL_LockMutex( smpMutex );
+	{
+		// a list can be waiting already if the thread started late
+		if ( !smpDataReady )
+		{
+			smpData = NULL;
+
+			// after this, the front end can exit GLimp_FrontEndSleep
+			SDL_CondSignal( renderCompletedEvent );
+		}
+
+		while ( !smpDataReady )
+		{
+			SDL_CondWait( renderCommandsEvent, smpMutex );
+		}
+
+		data = (void *)smpData;
+		smpDataReady = qfalse;
+	}
+	SDL_UnlockMutex( smpMutex );
+
+	SDL_GL_MakeCurrent( SDL_window, SDL_glContext );
+
+	return data;
+}
+
+/*
+===============
+GLimp_FrontEndSleep
+
+Waits for the render thread to finish its command list and takes the
+context back
+===============
+*/
+void GLimp_FrontEndSleep( void )
+{
+	SDL_LockMutex( smpMutex );
+	{
+		while ( smpData )
+		{
+			SDL_CondWait( renderCompletedEvent, smpMutex );
+		}
+	}
+	SDL_UnlockMutex( smpMutex );
+
+	SDL_GL_MakeCurrent( SDL_window, SDL_glContext );
+}
+
+/*
+===============
+GLimp_WakeRenderer
+
+Hands a command list to the render thread, which must be idle
+===============
+*/
+void GLimp_WakeRenderer( void *data )
+{
+	SDL_GL_MakeCurrent( SDL_window, NULL );
+
+	SDL_LockMutex( smpMutex );
+	{
+		assert( smpData == NULL );
+		smpData = data;
+		smpDataReady = qtrue;
+
+		// after this, the renderer can continue through GLimp_RendererSleep
+		SDL_CondSignal( renderCommandsEvent );
+	}
+	SDL_UnlockMutex( smpMutex );
+}
@@ -51,13 +51,13 @@ typedef struct voipServerPacket_s
 typedef struct svEntity_s {
 	struct worldSector_s *worldSector;
 	struct svEntity_s *nextEntityInWorldSector;
+	vec3_t		absmin, absmax;		// copy of the linked bounds, tested by area queries
 	
 	entityState_t	baseline;		// for delta compression of initial sighting
 	int			numClusters;		// if -1, use headnode instead
 	int			clusternums[MAX_ENT_CLUSTERS];
 	int			lastCluster;		// if all the clusters don't fit in clusternums
 	int			areanum, areanum2;
-	int			snapshotCounter;	// used to prevent double adding from portal views
 } svEntity_t;
 
 typedef enum {
@@ -75,7 +75,6 @@ typedef struct {
 	// https://zerowing.idsoftware.com/bugzilla/show_bug.cgi?id=475
 	// the serverId associated with the current checksumFeed (always <= serverId)
 	int       checksumFeedServerId;	
-	int				snapshotCounter;	// incremented for each snapshot built
 	int				timeResidual;		// <= 1000 / sv_frame->value
 	int				nextFrameTime;		// when time > nextFrameTime, process world
 	char			*configstrings[MAX_CONFIGSTRINGS];
@@ -226,6 +225,16 @@ typedef struct {
 	qboolean	connected;
 } challenge_t;
 
+// visible entity set lookups made while building snapshots
+typedef struct {
+	int			lookups;					// sets asked for, including through portals
+	int			hits;						// found already built this frame
+	int			full;						// no free cache entry, built uncached
+	int			used;						// entries built in the current frame
+	int			lastUsed;					// entries built in the previous frame
+	int			peakUsed;					// most entries built in a single frame
+} snapshotCacheStats_t;
+
 // this structure will be cleared only when the game dll changes
 typedef struct {
 	qboolean	initialized;				// sv_init has completed
@@ -238,6 +247,14 @@ typedef struct {
 	int			numSnapshotEntities;		// sv_maxclients->integer*PACKET_BACKUP*MAX_SNAPSHOT_ENTITIES
 	int			nextSnapshotEntities;		// next snapshotEntities to use
 	entityState_t	*snapshotEntities;		// [numSnapshotEntities]
+	struct snapshotJob_s *snapshotJobs;		// [numSnapshotJobs] for sv_snapshotThreads
+	int			numSnapshotJobs;
+	struct snapshotCacheEntry_s *snapshotCache;	// [snapshotCacheSize] for sv_snapshotCache
+	int			snapshotCacheSize;
+	int			snapshotCacheFrame;			// entries from other frames are free
+	qboolean	snapshotCacheActive;		// only set while the game state can't change
+	void		*snapshotCacheLock;
+	snapshotCacheStats_t	snapshotCacheStats;
 	int			nextHeartbeatTime;
 	challenge_t	challenges[MAX_CHALLENGES];	// to prevent invalid IPs from connecting
 	netadr_t	redirectAddress;			// for rcon return messages
@@ -278,6 +295,9 @@ extern	cvar_t	*vr_master[MAX_MASTER_SERVERS];
 extern	cvar_t	*sv_reconnectlimit;
 extern	cvar_t	*sv_showloss;
 extern	cvar_t	*sv_padPackets;
+extern	cvar_t	*sv_snapshotThreads;
+extern	cvar_t	*sv_snapshotCache;
+extern	cvar_t	*sv_traceCache;
 extern	cvar_t	*sv_killserver;
 extern	cvar_t	*sv_mapname;
 extern	cvar_t	*sv_mapChecksum;
@@ -400,6 +420,9 @@ void SV_WriteFrameToClient (client_t *client, msg_t *msg);
 void SV_SendMessageToClient( msg_t *msg, client_t *client );
 void SV_SendClientMessages( void );
 void SV_SendClientSnapshot( client_t *client );
+void SV_FreeSnapshotJobs( void );
+void SV_FreeSnapshotCache( void );
+void SV_SnapshotCache_f( void );
 
 //
 // sv_game.c
@@ -457,6 +480,39 @@ clipHandle_t SV_ClipHandleForEntity( const sharedEntity_t *ent );
 
 void SV_SectorList_f( void );
 
+// loose octree used to index linked entities, see sv_world.c
+typedef struct worldSector_s {
+	vec3_t		center;
+	float		size;			// half width of the cell, the loose bounds are twice this
+	vec3_t		mins, maxs;		// encloses everything linked below, only shrinks when emptied
+	int			depth;
+	int			numEntities;	// linked to this sector
+	int			numInTree;		// linked to this sector and everything below it
+	struct worldSector_s	*parent;
+	struct worldSector_s	*children;	// block of 8, NULL for leaves
+	svEntity_t	*entities;
+} worldSector_t;
+
+typedef struct {
+	worldSector_t	*sectors;
+	int			maxSectors;
+	int			numSectors;		// high water mark of the pool
+	worldSector_t	*freeBlocks;	// released child blocks, chained through children
+	int			maxDepth;
+} worldTree_t;
+
+void SV_InitWorldTree( worldTree_t *tree, worldSector_t *sectors, int maxSectors, const vec3_t mins, const vec3_t maxs );
+void SV_WorldTreeLink( worldTree_t *tree, svEntity_t *ent );
+void SV_WorldTreeUnlink( worldTree_t *tree, svEntity_t *ent );
+int SV_WorldTreeQuery( const worldTree_t *tree, const svEntity_t *base, const vec3_t mins, const vec3_t maxs, int *list, int maxcount );
+// list is filled with entity numbers relative to base
+// the tree functions only look at svEntity_t absmin / absmax, so the
+// benchmark can run them over entity layouts that are not the live world
+
+#ifdef USE_TESTS
+void SV_WorldBench_f( void );
+#endif
+
 
 int SV_AreaEntities( const vec3_t mins, const vec3_t maxs, int *entityList, int maxcount );
 // fills in a table of entity numbers with entities that have bounding boxes
@@ -482,6 +538,15 @@ void SV_Trace( trace_t *results, const vec3_t start, vec3_t mins, vec3_t maxs, c
 
 // passEntityNum is explicitly excluded from clipping checks (normally ENTITYNUM_NONE)
 
+void SV_TraceBatch( trace_t *results, int numTraces, const vec3_t *starts, const vec3_t *ends, vec3_t mins, vec3_t maxs, int passEntityNum, int contentmask, int capsule );
+// the same as numTraces SV_Trace calls with the same box, but the rays are
+// walked through the world together
+
+void SV_FlushTraceCache( void );
+// drops the traces remembered for sv_traceCache, called every game frame
+
+void SV_TraceCache_f( void );
+
 
 void SV_ClipToEntity( trace_t *trace, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, int entityNum, int contentmask, int capsule );
 // clip to a specific entity
@@ -1462,6 +1462,75 @@ static void SV_KillServer_f( void ) {
 	SV_Shutdown( "killserver" );
 }
 
+#ifdef USE_TESTS
+/*
+=================
+SV_VmBench_f
+
+Reloads the map with the bytecode compiler's optimization pass off and on
+and times the same number of qagame frames for both
+=================
+*/
+static void SV_VmBench_f( void ) {
+	char	mapname[MAX_QPATH];
+	char	optimize[MAX_CVAR_VALUE_STRING];
+	int		frames, frameMsec;
+	int		i, pass, start;
+	int		msec[2];
+
+	// make sure server is running
+	if ( !com_sv_running->integer ) {
+		Com_Printf( "Server is not running.\n" );
+		return;
+	}
+
+	if ( Cvar_VariableIntegerValue( "vm_game" ) != VMI_COMPILED ) {
+		Com_Printf( "vmbench: qagame is not running as compiled bytecode, set vm_game 2\n" );
+		return;
+	}
+
+	frames = 1000;
+	if ( Cmd_Argc() > 1 ) {
+		frames = atoi( Cmd_Argv( 1 ) );
+		if ( frames < 1 ) {
+			frames = 1;
+		}
+	}
+
+	frameMsec = 50;
+	if ( sv_fps->integer > 0 && sv_fps->integer <= 1000 ) {
+		frameMsec = 1000 / sv_fps->integer;
+	}
+
+	Q_strncpyz( mapname, Cvar_VariableString( "mapname" ), sizeof( mapname ) );
+	Cvar_VariableStringBuffer( "vm_optimize", optimize, sizeof( optimize ) );
+
+	for ( pass = 0; pass < 2; pass++ ) {
+		// the bytecode is only compiled when the map is loaded
+		Cvar_Set( "vm_optimize", pass ? "1" : "0" );
+		SV_SpawnServer( mapname, qfalse );
+
+		start = Sys_Milliseconds();
+		for ( i = 0; i < frames; i++ ) {
+			svs.time += frameMsec;
+			sv.time += frameMsec;
+			VM_Call( gvm, GAME_RUN_FRAME, sv.time );
+		}
+		msec[pass] = Sys_Milliseconds() - start;
+	}
+
+	// leave the game running with the configured setting
+	Cvar_Set( "vm_optimize", optimize );
+	if ( !Cvar_VariableIntegerValue( "vm_optimize" ) ) {
+		SV_SpawnServer( mapname, qfalse );
+	}
+
+	Com_Printf( "%i qagame frames on %s\n", frames, mapname );
+	Com_Printf( "vm_optimize 0: %6i msec\n", msec[0] );
+	Com_Printf( "vm_optimize 1: %6i msec\n", msec[1] );
+}
+#endif
+
 //===========================================================
 
 /*
@@ -1544,6 +1613,14 @@ void SV_AddOperatorCommands( void ) {
 	Cmd_AddCommand ("dumpuser", SV_DumpUser_f);
 	Cmd_AddCommand ("map_restart", SV_MapRestart_f);
 	Cmd_AddCommand ("sectorlist", SV_SectorList_f);
+#ifdef USE_TESTS
+	Cmd_AddCommand ("worldbench", SV_WorldBench_f);
+#endif
+	Cmd_AddCommand ("tracecache", SV_TraceCache_f);
+	Cmd_AddCommand ("snapshotcache", SV_SnapshotCache_f);
+#ifdef USE_TESTS
+	Cmd_AddCommand ("vmbench", SV_VmBench_f);
+#endif
 	Cmd_AddCommand ("map", SV_Map_f);
 	Cmd_SetCommandCompletionFunc( "map", SV_CompleteMapName );
 #ifndef PRE_RELEASE_DEMO
@@ -1593,6 +1670,8 @@ void SV_RemoveOperatorCommands( void ) {
 	Cmd_RemoveCommand ("dumpuser");
 	Cmd_RemoveCommand ("map_restart");
 	Cmd_RemoveCommand ("sectorlist");
+	Cmd_RemoveCommand ("snapshotcache");
+	Cmd_RemoveCommand ("tracecache");
 	Cmd_RemoveCommand ("say");
 #endif
 }
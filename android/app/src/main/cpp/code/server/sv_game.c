@@ -367,6 +367,20 @@ intptr_t SV_GameSystemCalls( intptr_t *args ) {
 	case G_TRACECAPSULE:
 		SV_Trace( VMA(1), VMA(2), VMA(3), VMA(4), VMA(5), args[6], args[7], /*int capsule*/ qtrue );
 		return 0;
+	case G_TRACE_BATCH:
+		if ( args[2] < 0 || args[2] > MAX_TRACE_BATCH ) {
+			Com_Error( ERR_DROP, "G_TRACE_BATCH: bad trace count %i", (int)args[2] );
+		}
+		if ( args[2] && ( !args[1] || !args[3] || !args[4] ) ) {
+			Com_Error( ERR_DROP, "G_TRACE_BATCH: NULL results, starts or ends" );
+		}
+		VM_CheckBounds( gvm, args[1], args[2] * sizeof( trace_t ) );
+		VM_CheckBounds( gvm, args[3], args[2] * sizeof( vec3_t ) );
+		VM_CheckBounds( gvm, args[4], args[2] * sizeof( vec3_t ) );
+		VM_CheckBounds( gvm, args[5], sizeof( vec3_t ) );
+		VM_CheckBounds( gvm, args[6], sizeof( vec3_t ) );
+		SV_TraceBatch( VMA(1), args[2], VMA(3), VMA(4), VMA(5), VMA(6), args[7], args[8], /*int capsule*/ qfalse );
+		return 0;
 	case G_POINT_CONTENTS:
 		return SV_PointContents( VMA(1), args[2] );
 	case G_SET_BRUSH_MODEL:
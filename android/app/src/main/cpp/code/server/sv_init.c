@@ -681,6 +681,12 @@ void SV_Init (void)
 	sv_reconnectlimit = Cvar_Get ("sv_reconnectlimit", "3", 0);
 	sv_showloss = Cvar_Get ("sv_showloss", "0", 0);
 	sv_padPackets = Cvar_Get ("sv_padPackets", "0", 0);
+	sv_snapshotThreads = Cvar_Get ("sv_snapshotThreads", "0", CVAR_ARCHIVE);
+	Cvar_CheckRange( sv_snapshotThreads, 0, MAX_JOB_THREADS, qtrue );
+	sv_snapshotCache = Cvar_Get ("sv_snapshotCache", "64", CVAR_ARCHIVE);
+	Cvar_CheckRange( sv_snapshotCache, 0, 1024, qtrue );
+	sv_traceCache = Cvar_Get ("sv_traceCache", "0", CVAR_ARCHIVE);
+	Cvar_CheckRange( sv_traceCache, 0, 2, qtrue );
 	sv_killserver = Cvar_Get ("sv_killserver", "0", 0);
 	sv_mapChecksum = Cvar_Get ("sv_mapChecksum", "", CVAR_ROM);
 	sv_lanForceRate = Cvar_Get ("sv_lanForceRate", "1", CVAR_ARCHIVE );
@@ -770,6 +776,8 @@ void SV_Shutdown( char *finalmsg ) {
 		
 		Z_Free(svs.clients);
 	}
+	SV_FreeSnapshotJobs();
+	SV_FreeSnapshotCache();
 	Com_Memset( &svs, 0, sizeof( svs ) );
 
 	Cvar_Set( "sv_running", "0" );
@@ -45,6 +45,9 @@ cvar_t	*vr_master[MAX_MASTER_SERVERS];	// master server ip address
 cvar_t	*sv_reconnectlimit;		// minimum seconds between connect messages
 cvar_t	*sv_showloss;			// report when usercmds are lost
 cvar_t	*sv_padPackets;			// add nop bytes to messages
+cvar_t	*sv_snapshotThreads;	// extra threads building client snapshots
+cvar_t	*sv_snapshotCache;		// visible entity sets shared by clients each frame
+cvar_t	*sv_traceCache;			// reuse identical SV_Trace results until the world changes
 cvar_t	*sv_killserver;			// menu system can set to 1 to shut server down
 cvar_t	*sv_mapname;
 cvar_t	*sv_mapChecksum;
@@ -1141,6 +1144,7 @@ void SV_Frame( int msec ) {
 		sv.time += frameMsec;
 
 		// let everything in the world think and move
+		SV_FlushTraceCache();
 		VM_Call (gvm, GAME_RUN_FRAME, sv.time);
 	}
 
@@ -116,42 +116,57 @@ static void SV_EmitPacketEntities( clientSnapshot_t *from, clientSnapshot_t *to,
 
 /*
 ==================
-SV_WriteSnapshotToClient
+SV_SnapshotDeltaFrame
+
+Picks the previous frame the current snapshot will be delta
+compressed from, or NULL for a full snapshot
 ==================
 */
-static void SV_WriteSnapshotToClient( client_t *client, msg_t *msg ) {
-	clientSnapshot_t	*frame, *oldframe;
-	int					lastframe;
-	int					i;
-	int					snapFlags;
-
-	// this is the snapshot we are creating
-	frame = &client->frames[ client->netchan.outgoingSequence & PACKET_MASK ];
+static clientSnapshot_t *SV_SnapshotDeltaFrame( client_t *client, int *lastframe ) {
+	clientSnapshot_t	*oldframe;
 
 	// try to use a previous frame as the source for delta compressing the snapshot
 	if ( client->deltaMessage <= 0 || client->state != CS_ACTIVE ) {
 		// client is asking for a retransmit
 		oldframe = NULL;
-		lastframe = 0;
+		*lastframe = 0;
 	} else if ( client->netchan.outgoingSequence - client->deltaMessage 
 		>= (PACKET_BACKUP - 3) ) {
 		// client hasn't gotten a good message through in a long time
 		Com_DPrintf ("%s: Delta request from out of date packet.\n", client->name);
 		oldframe = NULL;
-		lastframe = 0;
+		*lastframe = 0;
 	} else {
 		// we have a valid snapshot to delta from
 		oldframe = &client->frames[ client->deltaMessage & PACKET_MASK ];
-		lastframe = client->netchan.outgoingSequence - client->deltaMessage;
+		*lastframe = client->netchan.outgoingSequence - client->deltaMessage;
 
 		// the snapshot's entities may still have rolled off the buffer, though
 		if ( oldframe->first_entity <= svs.nextSnapshotEntities - svs.numSnapshotEntities ) {
 			Com_DPrintf ("%s: Delta request from out of date entities.\n", client->name);
 			oldframe = NULL;
-			lastframe = 0;
+			*lastframe = 0;
 		}
 	}
 
+	return oldframe;
+}
+
+/*
+==================
+SV_WriteSnapshotToClient
+
+Safe to call from a worker thread
+==================
+*/
+static void SV_WriteSnapshotToClient( client_t *client, clientSnapshot_t *oldframe, int lastframe, msg_t *msg ) {
+	clientSnapshot_t	*frame;
+	int					i;
+	int					snapFlags;
+
+	// this is the snapshot we are creating
+	frame = &client->frames[ client->netchan.outgoingSequence & PACKET_MASK ];
+
 	MSG_WriteByte (msg, svc_snapshot);
 
 	// NOTE, MRE: now sent at the start of every message from server to client
@@ -238,6 +253,8 @@ Build a client snapshot structure
 typedef struct {
 	int		numSnapshotEntities;
 	int		snapshotEntities[MAX_SNAPSHOT_ENTITIES];	
+	byte	added[MAX_GENTITIES/8];		// prevents double adding from portal views
+	const char	*error;					// raised by the caller, snapshots may be built on worker threads
 } snapshotEntityNumbers_t;
 
 /*
@@ -268,53 +285,71 @@ static int QDECL SV_QsortEntityNumbers( const void *a, const void *b ) {
 SV_AddEntToSnapshot
 ===============
 */
-static void SV_AddEntToSnapshot( svEntity_t *svEnt, sharedEntity_t *gEnt, snapshotEntityNumbers_t *eNums ) {
+static void SV_AddEntToSnapshot( sharedEntity_t *gEnt, snapshotEntityNumbers_t *eNums ) {
+	int		e = gEnt->s.number;
+
 	// if we have already added this entity to this snapshot, don't add again
-	if ( svEnt->snapshotCounter == sv.snapshotCounter ) {
+	if ( eNums->added[e >> 3] & (1 << (e & 7)) ) {
 		return;
 	}
-	svEnt->snapshotCounter = sv.snapshotCounter;
+	eNums->added[e >> 3] |= 1 << (e & 7);
 
 	// if we are full, silently discard entities
 	if ( eNums->numSnapshotEntities == MAX_SNAPSHOT_ENTITIES ) {
 		return;
 	}
 
-	eNums->snapshotEntities[ eNums->numSnapshotEntities ] = gEnt->s.number;
+	eNums->snapshotEntities[ eNums->numSnapshotEntities ] = e;
 	eNums->numSnapshotEntities++;
 }
 
+/*
+=============================================================================
+
+Visible entity cache
+
+Which entities pass the area and PVS tests depends only on the viewer's
+cluster and areabits, so clients standing in the same place can share the
+result.  Sets found while building the snapshots of one server frame are
+kept in a small hash table keyed by (cluster, areabits) and thrown away when
+the next frame starts.  The SVF_ flags that pick out single clients and the
+portal distance checks still differ between clients, so those are applied
+to the shared set for each client in SV_AddEntitiesVisibleFromPoint.
+
+=============================================================================
+*/
+
+typedef struct snapshotCacheEntry_s {
+	int			frame;			// svs.snapshotCacheFrame the entry was built in
+	qboolean	ready;			// still being built on another thread if not set
+	int			cluster;
+	int			area;			// the area of whoever built it, only its sign is part of the key
+	int			areabytes;
+	byte		areabits[MAX_MAP_AREA_BYTES];
+	qboolean	clientMask;		// an SVF_CLIENTMASK entity was considered
+	int			numEntities;
+	short		entities[MAX_GENTITIES];
+} snapshotCacheEntry_t;
+
 /*
 ===============
-SV_AddEntitiesVisibleFromPoint
+SV_BuildVisibleEntities
+
+Finds all the entities that can be seen from the entry's cluster and area,
+in ascending order
 ===============
 */
-static void SV_AddEntitiesVisibleFromPoint( vec3_t origin, clientSnapshot_t *frame, 
-									snapshotEntityNumbers_t *eNums, qboolean portal ) {
+static void SV_BuildVisibleEntities( snapshotCacheEntry_t *vis ) {
 	int		e, i;
 	sharedEntity_t *ent;
 	svEntity_t	*svEnt;
 	int		l;
-	int		clientarea, clientcluster;
-	int		leafnum;
-	byte	*clientpvs;
 	byte	*bitvector;
 
-	// during an error shutdown message we may need to transmit
-	// the shutdown message after the server has shutdown, so
-	// specfically check for it
-	if ( !sv.state ) {
-		return;
-	}
-
-	leafnum = CM_PointLeafnum (origin);
-	clientarea = CM_LeafArea (leafnum);
-	clientcluster = CM_LeafCluster (leafnum);
-
-	// calculate the visible areas
-	frame->areabytes = CM_WriteAreaBits( frame->areabits, clientarea );
+	vis->numEntities = 0;
+	vis->clientMask = qfalse;
 
-	clientpvs = CM_ClusterPVS (clientcluster);
+	bitvector = CM_ClusterPVS (vis->cluster);
 
 	for ( e = 0 ; e < sv.num_entities ; e++ ) {
 		ent = SV_GentityNum(e);
@@ -334,51 +369,28 @@ static void SV_AddEntitiesVisibleFromPoint( vec3_t origin, clientSnapshot_t *fra
 			continue;
 		}
 
-		// entities can be flagged to be sent to only one client
-		if ( ent->r.svFlags & SVF_SINGLECLIENT ) {
-			if ( ent->r.singleClient != frame->ps.clientNum ) {
-				continue;
-			}
-		}
-		// entities can be flagged to be sent to everyone but one client
-		if ( ent->r.svFlags & SVF_NOTSINGLECLIENT ) {
-			if ( ent->r.singleClient == frame->ps.clientNum ) {
-				continue;
-			}
-		}
-		// entities can be flagged to be sent to a given mask of clients
 		if ( ent->r.svFlags & SVF_CLIENTMASK ) {
-			if (frame->ps.clientNum >= 32)
-				Com_Error( ERR_DROP, "SVF_CLIENTMASK: clientNum >= 32" );
-			if (~ent->r.singleClient & (1 << frame->ps.clientNum))
-				continue;
-		}
-
-		svEnt = SV_SvEntityForGentity( ent );
-
-		// don't double add an entity through portals
-		if ( svEnt->snapshotCounter == sv.snapshotCounter ) {
-			continue;
+			vis->clientMask = qtrue;
 		}
 
 		// broadcast entities are always sent
 		if ( ent->r.svFlags & SVF_BROADCAST ) {
-			SV_AddEntToSnapshot( svEnt, ent, eNums );
+			vis->entities[vis->numEntities++] = e;
 			continue;
 		}
 
+		svEnt = SV_SvEntityForGentity( ent );
+
 		// ignore if not touching a PV leaf
 		// check area
-		if ( !CM_AreasConnected( clientarea, svEnt->areanum ) ) {
+		if ( !CM_AreasConnected( vis->area, svEnt->areanum ) ) {
 			// doors can legally straddle two areas, so
 			// we may need to check another one
-			if ( !CM_AreasConnected( clientarea, svEnt->areanum2 ) ) {
+			if ( !CM_AreasConnected( vis->area, svEnt->areanum2 ) ) {
 				continue;		// blocked by a door
 			}
 		}
 
-		bitvector = clientpvs;
-
 		// check individual leafs
 		if ( !svEnt->numClusters ) {
 			continue;
@@ -408,8 +420,245 @@ static void SV_AddEntitiesVisibleFromPoint( vec3_t origin, clientSnapshot_t *fra
 			}
 		}
 
+		vis->entities[vis->numEntities++] = e;
+	}
+}
+
+/*
+===============
+SV_FindVisibleEntities
+
+Returns the visible entity set for the viewpoint, from the cache if another
+client already needed it this frame.  Builds into local if the cache is off
+or full.  May be called from several job threads at once.
+===============
+*/
+static snapshotCacheEntry_t *SV_FindVisibleEntities( int cluster, int area,
+									const byte *areabits, int areabytes, snapshotCacheEntry_t *local ) {
+	snapshotCacheStats_t	*stats = &svs.snapshotCacheStats;
+	snapshotCacheEntry_t	*vis;
+	unsigned	hash;
+	int			i, n;
+
+	if ( !svs.snapshotCacheActive ) {
+		vis = local;
+	} else {
+		hash = cluster * 119 + ( area < 0 );
+		for ( i = 0 ; i < areabytes ; i++ ) {
+			hash = hash * 31 + areabits[i];
+		}
+
+		Sys_LockMutex( svs.snapshotCacheLock );
+		stats->lookups++;
+
+		vis = NULL;
+		for ( n = 0 ; n < svs.snapshotCacheSize ; n++ ) {
+			vis = &svs.snapshotCache[ ( hash + n ) % svs.snapshotCacheSize ];
+			if ( vis->frame != svs.snapshotCacheFrame ) {
+				break;		// free, claim it below
+			}
+			if ( vis->cluster == cluster && ( vis->area < 0 ) == ( area < 0 )
+				&& !memcmp( vis->areabits, areabits, areabytes ) ) {
+				break;
+			}
+		}
+
+		if ( n == svs.snapshotCacheSize ) {
+			stats->full++;
+			vis = local;
+		} else if ( vis->frame == svs.snapshotCacheFrame ) {
+			if ( vis->ready ) {
+				stats->hits++;
+				Sys_UnlockMutex( svs.snapshotCacheLock );
+				return vis;
+			}
+			// another thread is still filling it in
+			vis = local;
+		} else {
+			vis->frame = svs.snapshotCacheFrame;
+			vis->ready = qfalse;
+			stats->used++;
+		}
+
+		Sys_UnlockMutex( svs.snapshotCacheLock );
+	}
+
+	vis->cluster = cluster;
+	vis->area = area;
+	vis->areabytes = areabytes;
+	Com_Memcpy( vis->areabits, areabits, areabytes );
+	SV_BuildVisibleEntities( vis );
+
+	if ( vis != local ) {
+		Sys_LockMutex( svs.snapshotCacheLock );
+		vis->ready = qtrue;
+		Sys_UnlockMutex( svs.snapshotCacheLock );
+	}
+
+	return vis;
+}
+
+/*
+===============
+SV_BeginSnapshotCache
+
+Starts a new frame of cached visible entity sets, the game state must not
+change until SV_EndSnapshotCache
+===============
+*/
+static void SV_BeginSnapshotCache( void ) {
+	snapshotCacheStats_t	*stats = &svs.snapshotCacheStats;
+
+	if ( svs.snapshotCacheSize != sv_snapshotCache->integer ) {
+		SV_FreeSnapshotCache();
+		if ( sv_snapshotCache->integer > 0 ) {
+			svs.snapshotCacheSize = sv_snapshotCache->integer;
+			svs.snapshotCache = Z_Malloc( svs.snapshotCacheSize * sizeof( snapshotCacheEntry_t ) );
+			svs.snapshotCacheLock = Sys_CreateMutex();
+		}
+	}
+	if ( !svs.snapshotCacheSize || !svs.snapshotCacheLock ) {
+		return;
+	}
+
+	svs.snapshotCacheFrame++;
+	svs.snapshotCacheActive = qtrue;
+	stats->used = 0;
+}
+
+/*
+===============
+SV_EndSnapshotCache
+===============
+*/
+static void SV_EndSnapshotCache( void ) {
+	snapshotCacheStats_t	*stats = &svs.snapshotCacheStats;
+
+	if ( !svs.snapshotCacheActive ) {
+		return;
+	}
+
+	svs.snapshotCacheActive = qfalse;
+	if ( stats->used ) {
+		stats->lastUsed = stats->used;
+	}
+	if ( stats->used > stats->peakUsed ) {
+		stats->peakUsed = stats->used;
+	}
+}
+
+/*
+===============
+SV_FreeSnapshotCache
+===============
+*/
+void SV_FreeSnapshotCache( void ) {
+	if ( svs.snapshotCache ) {
+		Z_Free( svs.snapshotCache );
+	}
+	if ( svs.snapshotCacheLock ) {
+		Sys_DestroyMutex( svs.snapshotCacheLock );
+	}
+	svs.snapshotCache = NULL;
+	svs.snapshotCacheLock = NULL;
+	svs.snapshotCacheSize = 0;
+	svs.snapshotCacheActive = qfalse;
+}
+
+/*
+===============
+SV_SnapshotCache_f
+
+Prints how well the visible entity cache is doing, "reset" clears the counts
+===============
+*/
+void SV_SnapshotCache_f( void ) {
+	snapshotCacheStats_t	*stats = &svs.snapshotCacheStats;
+
+	if ( !Q_stricmp( Cmd_Argv( 1 ), "reset" ) ) {
+		Com_Memset( stats, 0, sizeof( *stats ) );
+		return;
+	}
+
+	Com_Printf( "%i entries, %i used last frame, %i peak\n",
+		svs.snapshotCacheSize, stats->lastUsed, stats->peakUsed );
+	Com_Printf( "%i lookups, %i hits (%.1f%%), %i cache full\n", stats->lookups, stats->hits,
+		stats->lookups ? 100.0f * stats->hits / stats->lookups : 0.0f, stats->full );
+}
+
+/*
+===============
+SV_AddEntitiesVisibleFromPoint
+===============
+*/
+static void SV_AddEntitiesVisibleFromPoint( vec3_t origin, clientSnapshot_t *frame, 
+									snapshotEntityNumbers_t *eNums ) {
+	int		e, i;
+	sharedEntity_t *ent;
+	int		clientarea, clientcluster;
+	int		leafnum;
+	byte	areabits[MAX_MAP_AREA_BYTES];
+	int		areabytes;
+	int		clientNum;
+	snapshotCacheEntry_t	local;
+	snapshotCacheEntry_t	*vis;
+
+	// during an error shutdown message we may need to transmit
+	// the shutdown message after the server has shutdown, so
+	// specfically check for it
+	if ( !sv.state ) {
+		return;
+	}
+
+	leafnum = CM_PointLeafnum (origin);
+	clientarea = CM_LeafArea (leafnum);
+	clientcluster = CM_LeafCluster (leafnum);
+
+	// calculate the visible areas
+	Com_Memset( areabits, 0, sizeof( areabits ) );
+	areabytes = CM_WriteAreaBits( areabits, clientarea );
+	for ( i = 0 ; i < areabytes ; i++ ) {
+		frame->areabits[i] |= areabits[i];
+	}
+	frame->areabytes = areabytes;
+
+	vis = SV_FindVisibleEntities( clientcluster, clientarea, areabits, areabytes, &local );
+
+	clientNum = frame->ps.clientNum;
+	if ( vis->clientMask && clientNum >= 32 ) {
+		eNums->error = "SVF_CLIENTMASK: clientNum >= 32";
+	}
+
+	for ( i = 0 ; i < vis->numEntities ; i++ ) {
+		e = vis->entities[i];
+		ent = SV_GentityNum(e);
+
+		// entities can be flagged to be sent to only one client
+		if ( ent->r.svFlags & SVF_SINGLECLIENT ) {
+			if ( ent->r.singleClient != clientNum ) {
+				continue;
+			}
+		}
+		// entities can be flagged to be sent to everyone but one client
+		if ( ent->r.svFlags & SVF_NOTSINGLECLIENT ) {
+			if ( ent->r.singleClient == clientNum ) {
+				continue;
+			}
+		}
+		// entities can be flagged to be sent to a given mask of clients
+		if ( ent->r.svFlags & SVF_CLIENTMASK ) {
+			if ( clientNum >= 32 || ( ~ent->r.singleClient & (1 << clientNum) ) ) {
+				continue;
+			}
+		}
+
+		// don't double add an entity through portals
+		if ( eNums->added[e >> 3] & (1 << (e & 7)) ) {
+			continue;
+		}
+
 		// add it
-		SV_AddEntToSnapshot( svEnt, ent, eNums );
+		SV_AddEntToSnapshot( ent, eNums );
 
 		// if it's a portal entity, add everything visible from its camera position
 		if ( ent->r.svFlags & SVF_PORTAL ) {
@@ -420,45 +669,27 @@ static void SV_AddEntitiesVisibleFromPoint( vec3_t origin, clientSnapshot_t *fra
 					continue;
 				}
 			}
-			SV_AddEntitiesVisibleFromPoint( ent->s.origin2, frame, eNums, qtrue );
+			SV_AddEntitiesVisibleFromPoint( ent->s.origin2, frame, eNums );
 		}
-
 	}
 }
 
 /*
 =============
-SV_BuildClientSnapshot
-
-Decides which entities are going to be visible to the client, and
-copies off the playerstate and areabits.
-
-This properly handles multiple recursive portals, but the render
-currently doesn't.
+SV_BeginClientSnapshot
 
-For viewing through other player's eyes, clent can be something other than client->gentity
+Clears the frame being built and copies off the playerstate.
+Returns qfalse if the client has no entity to view from.
 =============
 */
-static void SV_BuildClientSnapshot( client_t *client ) {
-	vec3_t						org;
+static qboolean SV_BeginClientSnapshot( client_t *client ) {
 	clientSnapshot_t			*frame;
-	snapshotEntityNumbers_t		entityNumbers;
-	int							i;
-	sharedEntity_t				*ent;
-	entityState_t				*state;
-	svEntity_t					*svEnt;
 	sharedEntity_t				*clent;
-	int							clientNum;
-	playerState_t				*ps;
-
-	// bump the counter used to prevent double adding
-	sv.snapshotCounter++;
 
 	// this is the frame we are creating
 	frame = &client->frames[ client->netchan.outgoingSequence & PACKET_MASK ];
 
 	// clear everything in this snapshot
-	entityNumbers.numSnapshotEntities = 0;
 	Com_Memset( frame->areabits, 0, sizeof( frame->areabits ) );
 
   // https://zerowing.idsoftware.com/bugzilla/show_bug.cgi?id=62
@@ -466,60 +697,135 @@ static void SV_BuildClientSnapshot( client_t *client ) {
 	
 	clent = client->gentity;
 	if ( !clent || client->state == CS_ZOMBIE ) {
-		return;
+		return qfalse;
 	}
 
 	// grab the current playerState_t
-	ps = SV_GameClientNum( client - svs.clients );
-	frame->ps = *ps;
+	frame->ps = *SV_GameClientNum( client - svs.clients );
 
-	// never send client's own entity, because it can
-	// be regenerated from the playerstate
-	clientNum = frame->ps.clientNum;
-	if ( clientNum < 0 || clientNum >= MAX_GENTITIES ) {
+	if ( frame->ps.clientNum < 0 || frame->ps.clientNum >= MAX_GENTITIES ) {
 		Com_Error( ERR_DROP, "SV_SvEntityForGentity: bad gEnt" );
 	}
-	svEnt = &sv.svEntities[ clientNum ];
 
-	svEnt->snapshotCounter = sv.snapshotCounter;
+	return qtrue;
+}
+
+/*
+=============
+SV_AddClientEntities
+
+Decides which entities are going to be visible to the client, and
+finishes the areabits.  Only reads the game state, so this is safe
+to run for several clients at once on worker threads.
+
+This properly handles multiple recursive portals, but the render
+currently doesn't.
+=============
+*/
+static void SV_AddClientEntities( client_t *client, snapshotEntityNumbers_t *eNums ) {
+	vec3_t						org;
+	clientSnapshot_t			*frame;
+	int							i;
+	int							clientNum;
+
+	frame = &client->frames[ client->netchan.outgoingSequence & PACKET_MASK ];
+
+	eNums->numSnapshotEntities = 0;
+	eNums->error = NULL;
+	Com_Memset( eNums->added, 0, sizeof( eNums->added ) );
+
+	// never send client's own entity, because it can
+	// be regenerated from the playerstate
+	clientNum = frame->ps.clientNum;
+	eNums->added[clientNum >> 3] |= 1 << (clientNum & 7);
 
 	// find the client's viewpoint
-	VectorCopy( ps->origin, org );
-	org[2] += ps->viewheight;
+	VectorCopy( frame->ps.origin, org );
+	org[2] += frame->ps.viewheight;
 
 	// add all the entities directly visible to the eye, which
 	// may include portal entities that merge other viewpoints
-	SV_AddEntitiesVisibleFromPoint( org, frame, &entityNumbers, qfalse );
+	SV_AddEntitiesVisibleFromPoint( org, frame, eNums );
 
 	// if there were portals visible, there may be out of order entities
 	// in the list which will need to be resorted for the delta compression
-	// to work correctly.  This also catches the error condition
-	// of an entity being included twice.
-	qsort( entityNumbers.snapshotEntities, entityNumbers.numSnapshotEntities, 
-		sizeof( entityNumbers.snapshotEntities[0] ), SV_QsortEntityNumbers );
+	// to work correctly.
+	qsort( eNums->snapshotEntities, eNums->numSnapshotEntities, 
+		sizeof( eNums->snapshotEntities[0] ), SV_QsortEntityNumbers );
 
 	// now that all viewpoint's areabits have been OR'd together, invert
 	// all of them to make it a mask vector, which is what the renderer wants
 	for ( i = 0 ; i < MAX_MAP_AREA_BYTES/4 ; i++ ) {
 		((int *)frame->areabits)[i] = ((int *)frame->areabits)[i] ^ -1;
 	}
+}
 
-	// copy the entity states out
-	frame->num_entities = 0;
+/*
+=============
+SV_AllocSnapshotEntities
+
+Reserves room in the circular svs.snapshotEntities for the frame
+=============
+*/
+static void SV_AllocSnapshotEntities( clientSnapshot_t *frame, int numEntities ) {
+	frame->num_entities = numEntities;
 	frame->first_entity = svs.nextSnapshotEntities;
-	for ( i = 0 ; i < entityNumbers.numSnapshotEntities ; i++ ) {
-		ent = SV_GentityNum(entityNumbers.snapshotEntities[i]);
-		state = &svs.snapshotEntities[svs.nextSnapshotEntities % svs.numSnapshotEntities];
+	svs.nextSnapshotEntities += numEntities;
+
+	// this should never hit, map should always be restarted first in SV_Frame
+	if ( svs.nextSnapshotEntities >= 0x7FFFFFFE ) {
+		Com_Error(ERR_FATAL, "svs.nextSnapshotEntities wrapped");
+	}
+}
+
+/*
+=============
+SV_CopySnapshotEntities
+
+Copies the entity states out into the frame's reserved room
+=============
+*/
+static void SV_CopySnapshotEntities( clientSnapshot_t *frame, snapshotEntityNumbers_t *eNums ) {
+	int							i;
+	sharedEntity_t				*ent;
+	entityState_t				*state;
+
+	for ( i = 0 ; i < frame->num_entities ; i++ ) {
+		ent = SV_GentityNum(eNums->snapshotEntities[i]);
+		state = &svs.snapshotEntities[(frame->first_entity + i) % svs.numSnapshotEntities];
 		*state = ent->s;
-		svs.nextSnapshotEntities++;
-		// this should never hit, map should always be restarted first in SV_Frame
-		if ( svs.nextSnapshotEntities >= 0x7FFFFFFE ) {
-			Com_Error(ERR_FATAL, "svs.nextSnapshotEntities wrapped");
-		}
-		frame->num_entities++;
 	}
 }
 
+/*
+=============
+SV_BuildClientSnapshot
+
+Decides which entities are going to be visible to the client, and
+copies off the playerstate and areabits.
+
+For viewing through other player's eyes, clent can be something other than client->gentity
+=============
+*/
+static void SV_BuildClientSnapshot( client_t *client ) {
+	clientSnapshot_t			*frame;
+	snapshotEntityNumbers_t		entityNumbers;
+
+	if ( !SV_BeginClientSnapshot( client ) ) {
+		return;
+	}
+
+	frame = &client->frames[ client->netchan.outgoingSequence & PACKET_MASK ];
+
+	SV_AddClientEntities( client, &entityNumbers );
+	if ( entityNumbers.error ) {
+		Com_Error( ERR_DROP, "%s", entityNumbers.error );
+	}
+
+	SV_AllocSnapshotEntities( frame, entityNumbers.numSnapshotEntities );
+	SV_CopySnapshotEntities( frame, &entityNumbers );
+}
+
 #ifdef USE_VOIP
 /*
 ==================
@@ -586,6 +892,28 @@ void SV_SendMessageToClient(msg_t *msg, client_t *client)
 }
 
 
+/*
+=======================
+SV_SendSnapshotMessage
+
+Finishes a snapshot message and sends it
+=======================
+*/
+static void SV_SendSnapshotMessage( client_t *client, msg_t *msg ) {
+#ifdef USE_VOIP
+	SV_WriteVoipToClient( client, msg );
+#endif
+
+	// check for overflow
+	if ( msg->overflowed ) {
+		Com_Printf ("WARNING: msg overflowed for %s\n", client->name);
+		MSG_Clear (msg);
+	}
+
+	SV_SendMessageToClient( msg, client );
+}
+
+
 /*
 =======================
 SV_SendClientSnapshot
@@ -597,6 +925,8 @@ Also called by SV_FinalMessage
 void SV_SendClientSnapshot( client_t *client ) {
 	byte		msg_buf[MAX_MSGLEN];
 	msg_t		msg;
+	clientSnapshot_t	*oldframe;
+	int			lastframe;
 
 	// build the snapshot
 	SV_BuildClientSnapshot( client );
@@ -619,19 +949,165 @@ void SV_SendClientSnapshot( client_t *client ) {
 
 	// send over all the relevant entityState_t
 	// and the playerState_t
-	SV_WriteSnapshotToClient( client, &msg );
+	oldframe = SV_SnapshotDeltaFrame( client, &lastframe );
+	SV_WriteSnapshotToClient( client, oldframe, lastframe, &msg );
 
-#ifdef USE_VOIP
-	SV_WriteVoipToClient( client, &msg );
-#endif
+	SV_SendSnapshotMessage( client, &msg );
+}
 
-	// check for overflow
-	if ( msg.overflowed ) {
-		Com_Printf ("WARNING: msg overflowed for %s\n", client->name);
-		MSG_Clear (&msg);
+
+/*
+=============================================================================
+
+Threaded snapshots
+
+With sv_snapshotThreads set, the snapshots of all clients that are due in
+a frame are built together.  Finding the visible entities, copying their
+states and delta encoding are spread over the job threads, while anything
+that changes shared server state stays on the main thread between the two
+parallel passes: the playerstates are copied, room in the entity ring is
+reserved in client order, delta frames are picked and the finished
+messages go out through the normal netchan path.
+
+The only difference from building the snapshots one at a time is that
+delta frames are checked against the ring position after the whole
+frame's reservations, so no worker can delta from entity states that
+another client's snapshot is overwriting.
+
+=============================================================================
+*/
+
+typedef struct snapshotJob_s {
+	client_t				*client;
+	qboolean				build;			// client has an entity to view from
+	qboolean				send;			// bots only need the snapshot built
+	clientSnapshot_t		*oldframe;
+	int						lastframe;
+	snapshotEntityNumbers_t	entityNumbers;
+	msg_t					msg;
+	byte					msgBuf[MAX_MSGLEN];
+} snapshotJob_t;
+
+/*
+=======================
+SV_SnapshotEntitiesJob
+=======================
+*/
+static void SV_SnapshotEntitiesJob( void *data, int job ) {
+	snapshotJob_t	*j = (snapshotJob_t *)data + job;
+
+	if ( j->build ) {
+		SV_AddClientEntities( j->client, &j->entityNumbers );
 	}
+}
 
-	SV_SendMessageToClient( &msg, client );
+/*
+=======================
+SV_SnapshotMessageJob
+=======================
+*/
+static void SV_SnapshotMessageJob( void *data, int job ) {
+	snapshotJob_t	*j = (snapshotJob_t *)data + job;
+	client_t		*client = j->client;
+
+	if ( j->build ) {
+		SV_CopySnapshotEntities( &client->frames[ client->netchan.outgoingSequence & PACKET_MASK ],
+			&j->entityNumbers );
+	}
+
+	if ( j->send ) {
+		SV_WriteSnapshotToClient( client, j->oldframe, j->lastframe, &j->msg );
+	}
+}
+
+/*
+=======================
+SV_FreeSnapshotJobs
+=======================
+*/
+void SV_FreeSnapshotJobs( void ) {
+	if ( svs.snapshotJobs ) {
+		Z_Free( svs.snapshotJobs );
+	}
+	svs.snapshotJobs = NULL;
+	svs.numSnapshotJobs = 0;
+}
+
+/*
+=======================
+SV_SendClientSnapshotsThreaded
+
+Same as calling SV_SendClientSnapshot for each of the clients
+=======================
+*/
+static void SV_SendClientSnapshotsThreaded( client_t **clients, int numClients ) {
+	snapshotJob_t	*job;
+	client_t		*client;
+	sharedEntity_t	*ent;
+	int				i;
+
+	if ( svs.numSnapshotJobs < numClients ) {
+		SV_FreeSnapshotJobs();
+		svs.numSnapshotJobs = sv_maxclients->integer;
+		svs.snapshotJobs = Z_Malloc( svs.numSnapshotJobs * sizeof( snapshotJob_t ) );
+	}
+
+	// the entity pass only reads the game entities, so repair
+	// entity numbers here instead of on the worker threads
+	if ( sv.state ) {
+		for ( i = 0 ; i < sv.num_entities ; i++ ) {
+			ent = SV_GentityNum( i );
+			if ( ent->r.linked && ent->s.number != i ) {
+				Com_DPrintf ("FIXING ENT->S.NUMBER!!!\n");
+				ent->s.number = i;
+			}
+		}
+	}
+
+	for ( i = 0, job = svs.snapshotJobs ; i < numClients ; i++, job++ ) {
+		client = clients[i];
+		job->client = client;
+		job->build = SV_BeginClientSnapshot( client );
+		job->send = !( client->gentity && client->gentity->r.svFlags & SVF_BOT );
+	}
+
+	Com_RunJobs( SV_SnapshotEntitiesJob, svs.snapshotJobs, numClients, sv_snapshotThreads->integer );
+
+	for ( i = 0, job = svs.snapshotJobs ; i < numClients ; i++, job++ ) {
+		if ( !job->build ) {
+			continue;
+		}
+		if ( job->entityNumbers.error ) {
+			Com_Error( ERR_DROP, "%s", job->entityNumbers.error );
+		}
+
+		client = job->client;
+		SV_AllocSnapshotEntities( &client->frames[ client->netchan.outgoingSequence & PACKET_MASK ],
+			job->entityNumbers.numSnapshotEntities );
+	}
+
+	for ( i = 0, job = svs.snapshotJobs ; i < numClients ; i++, job++ ) {
+		if ( !job->send ) {
+			continue;
+		}
+
+		client = job->client;
+		MSG_Init( &job->msg, job->msgBuf, sizeof( job->msgBuf ) );
+		job->msg.allowoverflow = qtrue;
+
+		MSG_WriteLong( &job->msg, client->lastClientCommand );
+		SV_UpdateServerCommandsToClient( client, &job->msg );
+
+		job->oldframe = SV_SnapshotDeltaFrame( client, &job->lastframe );
+	}
+
+	Com_RunJobs( SV_SnapshotMessageJob, svs.snapshotJobs, numClients, sv_snapshotThreads->integer );
+
+	for ( i = 0, job = svs.snapshotJobs ; i < numClients ; i++, job++ ) {
+		if ( job->send ) {
+			SV_SendSnapshotMessage( job->client, &job->msg );
+		}
+	}
 }
 
 
@@ -644,6 +1120,13 @@ void SV_SendClientMessages(void)
 {
 	int		i;
 	client_t	*c;
+	client_t	*snapClients[MAX_CLIENTS];
+	int		numSnapClients = 0;
+
+	SV_BeginSnapshotCache();
+
+	// the snapshots go out together at the end
+	NET_BeginSendBatch();
 
 	// send a message to each connected client
 	for(i=0; i < sv_maxclients->integer; i++)
@@ -677,9 +1160,30 @@ void SV_SendClientMessages(void)
 			}
 		}
 
+		if(sv_snapshotThreads->integer > 0)
+		{
+			// built and sent together below
+			snapClients[numSnapClients++] = c;
+			continue;
+		}
+
 		// generate and send a new message
 		SV_SendClientSnapshot(c);
 		c->lastSnapshotTime = svs.time;
 		c->rateDelayed = qfalse;
 	}
+
+	if(numSnapClients)
+	{
+		SV_SendClientSnapshotsThreaded(snapClients, numSnapClients);
+
+		for(i=0; i < numSnapClients; i++)
+		{
+			snapClients[i]->lastSnapshotTime = svs.time;
+			snapClients[i]->rateDelayed = qfalse;
+		}
+	}
+
+	NET_FlushSendBatch();
+	SV_EndSnapshotCache();
 }
@@ -54,26 +54,265 @@ clipHandle_t SV_ClipHandleForEntity( const sharedEntity_t *ent ) {
 ENTITY CHECKING
 
 To avoid linearly searching through lists of entities during environment testing,
-the world is carved up with an evenly spaced, axially aligned bsp tree.  Entities
-are kept in chains either at the final leafs, or at the first node that splits
-them, which prevents having to deal with multiple fragments of a single entity.
+linked entities are kept in a loose octree over the world bounds.  Every sector
+is a cube, but the entities in it may stick out of the cube by up to half its
+width, so an entity goes to the deepest sector it fits in by its center alone
+and is never split into fragments.
+
+The tree only grows where entities are: a sector is subdivided when more than
+SECTOR_SPLIT_ENTITIES entities land in it, and the children are released again
+once nothing is left below it.  The smallest sector width follows the map size,
+so large open maps and small arenas both end up with cells a few players wide.
+
+Each sector also keeps the bounds of everything linked below it, which grow as
+entities are linked and are reset when the sector empties.  Area queries cull
+with those instead of the loose cubes, so sparse parts of the map cost little.
 
 ===============================================================================
 */
 
-typedef struct worldSector_s {
-	int		axis;		// -1 = leaf node
-	float	dist;
-	struct worldSector_s	*children[2];
-	svEntity_t	*entities;
-} worldSector_t;
+#define	SECTOR_SPLIT_ENTITIES	8
+#define	MIN_SECTOR_SIZE			64		// half width of the smallest sector
+#define	MAX_SECTOR_DEPTH		10
+#define	MAX_WORLD_SECTORS		( 1 + 8 * 512 )
+
+static worldSector_t	sv_worldSectors[MAX_WORLD_SECTORS];
+static worldTree_t		sv_worldTree;
+
+
+/*
+===============
+SV_InitWorldTree
+
+Sets up an empty tree with the root sector enclosing the given bounds
+===============
+*/
+void SV_InitWorldTree( worldTree_t *tree, worldSector_t *sectors, int maxSectors, const vec3_t mins, const vec3_t maxs ) {
+	worldSector_t	*root;
+	float			size;
+	int				i;
+
+	Com_Memset( tree, 0, sizeof( *tree ) );
+	Com_Memset( sectors, 0, maxSectors * sizeof( *sectors ) );
+	tree->sectors = sectors;
+	tree->maxSectors = maxSectors;
+	tree->numSectors = 1;
+
+	root = sectors;
+	size = 0;
+	for ( i = 0 ; i < 3 ; i++ ) {
+		root->center[i] = 0.5f * ( mins[i] + maxs[i] );
+		if ( 0.5f * ( maxs[i] - mins[i] ) > size ) {
+			size = 0.5f * ( maxs[i] - mins[i] );
+		}
+	}
+	root->size = size;
+	ClearBounds( root->mins, root->maxs );
+
+	while ( tree->maxDepth < MAX_SECTOR_DEPTH && size * 0.5f >= MIN_SECTOR_SIZE ) {
+		size *= 0.5f;
+		tree->maxDepth++;
+	}
+}
+
+/*
+===============
+SV_ChildSector
+
+Returns the child of the sector that can hold the entity, or NULL if it
+has to stay in the sector itself
+===============
+*/
+static worldSector_t *SV_ChildSector( const worldSector_t *sec, const svEntity_t *ent ) {
+	worldSector_t	*child;
+	vec3_t			center;
+	float			half;
+	int				i, index;
+
+	half = sec->size * 0.5f;
+	index = 0;
+	for ( i = 0 ; i < 3 ; i++ ) {
+		if ( ent->absmax[i] - ent->absmin[i] > sec->size ) {
+			return NULL;	// larger than a child
+		}
+		center[i] = 0.5f * ( ent->absmin[i] + ent->absmax[i] );
+		if ( center[i] >= sec->center[i] ) {
+			index |= 1 << i;
+		}
+	}
+
+	child = &sec->children[index];
+
+	// only possible for entities that stick out of the root
+	for ( i = 0 ; i < 3 ; i++ ) {
+		if ( fabs( center[i] - child->center[i] ) > half ) {
+			return NULL;
+		}
+	}
+
+	return child;
+}
+
+/*
+===============
+SV_SplitSector
+
+Creates the children of a leaf and moves down every entity that fits
+===============
+*/
+static qboolean SV_SplitSector( worldTree_t *tree, worldSector_t *sec ) {
+	worldSector_t	*block, *child;
+	svEntity_t		*ent, *next, *keep;
+	float			half;
+	int				i;
+
+	if ( tree->freeBlocks ) {
+		block = tree->freeBlocks;
+		tree->freeBlocks = block->children;
+	} else if ( tree->numSectors + 8 <= tree->maxSectors ) {
+		block = &tree->sectors[tree->numSectors];
+		tree->numSectors += 8;
+	} else {
+		return qfalse;	// stays a leaf, only slower to search
+	}
+
+	half = sec->size * 0.5f;
+	Com_Memset( block, 0, 8 * sizeof( *block ) );
+	for ( i = 0 ; i < 8 ; i++ ) {
+		child = &block[i];
+		child->center[0] = sec->center[0] + ( ( i & 1 ) ? half : -half );
+		child->center[1] = sec->center[1] + ( ( i & 2 ) ? half : -half );
+		child->center[2] = sec->center[2] + ( ( i & 4 ) ? half : -half );
+		child->size = half;
+		child->depth = sec->depth + 1;
+		child->parent = sec;
+		ClearBounds( child->mins, child->maxs );
+	}
+	sec->children = block;
+
+	keep = NULL;
+	for ( ent = sec->entities ; ent ; ent = next ) {
+		next = ent->nextEntityInWorldSector;
+
+		child = SV_ChildSector( sec, ent );
+		if ( !child ) {
+			ent->nextEntityInWorldSector = keep;
+			keep = ent;
+			continue;
+		}
+		sec->numEntities--;
+		ent->worldSector = child;
+		ent->nextEntityInWorldSector = child->entities;
+		child->entities = ent;
+		child->numEntities++;
+		child->numInTree++;
+		AddPointToBounds( ent->absmin, child->mins, child->maxs );
+		AddPointToBounds( ent->absmax, child->mins, child->maxs );
+	}
+	sec->entities = keep;
+
+	return qtrue;
+}
+
+/*
+===============
+SV_ReleaseSectors
+
+Returns the children of an empty sector to the free list
+===============
+*/
+static void SV_ReleaseSectors( worldTree_t *tree, worldSector_t *sec ) {
+	worldSector_t	*block;
+	int				i;
+
+	block = sec->children;
+	if ( !block ) {
+		return;
+	}
+	for ( i = 0 ; i < 8 ; i++ ) {
+		SV_ReleaseSectors( tree, &block[i] );
+	}
+	sec->children = NULL;
+	block->children = tree->freeBlocks;
+	tree->freeBlocks = block;
+}
+
+/*
+===============
+SV_WorldTreeLink
+
+The entity absmin / absmax must already be set
+===============
+*/
+void SV_WorldTreeLink( worldTree_t *tree, svEntity_t *ent ) {
+	worldSector_t	*sec, *child;
+
+	sec = tree->sectors;
+	while ( 1 ) {
+		if ( !sec->children ) {
+			if ( sec->numEntities < SECTOR_SPLIT_ENTITIES || sec->depth >= tree->maxDepth
+				|| !SV_SplitSector( tree, sec ) ) {
+				break;
+			}
+		}
+		child = SV_ChildSector( sec, ent );
+		if ( !child ) {
+			break;
+		}
+		sec = child;
+	}
+
+	ent->worldSector = sec;
+	ent->nextEntityInWorldSector = sec->entities;
+	sec->entities = ent;
+	sec->numEntities++;
+	for ( ; sec ; sec = sec->parent ) {
+		sec->numInTree++;
+		AddPointToBounds( ent->absmin, sec->mins, sec->maxs );
+		AddPointToBounds( ent->absmax, sec->mins, sec->maxs );
+	}
+}
+
+/*
+===============
+SV_WorldTreeUnlink
 
-#define	AREA_DEPTH	4
-#define	AREA_NODES	64
+===============
+*/
+void SV_WorldTreeUnlink( worldTree_t *tree, svEntity_t *ent ) {
+	worldSector_t	*ws, *sec, *empty;
+	svEntity_t		**prev;
 
-worldSector_t	sv_worldSectors[AREA_NODES];
-int			sv_numworldSectors;
+	ws = ent->worldSector;
+	if ( !ws ) {
+		return;		// not linked in anywhere
+	}
+	ent->worldSector = NULL;
 
+	for ( prev = &ws->entities ; *prev ; prev = &(*prev)->nextEntityInWorldSector ) {
+		if ( *prev == ent ) {
+			break;
+		}
+	}
+	if ( !*prev ) {
+		Com_Printf( "WARNING: SV_UnlinkEntity: not found in worldSector\n" );
+		return;
+	}
+	*prev = ent->nextEntityInWorldSector;
+	ws->numEntities--;
+
+	// collapse the largest subtree that became empty
+	empty = NULL;
+	for ( sec = ws ; sec ; sec = sec->parent ) {
+		if ( --sec->numInTree == 0 ) {
+			ClearBounds( sec->mins, sec->maxs );
+			empty = sec;
+		}
+	}
+	if ( empty ) {
+		SV_ReleaseSectors( tree, empty );
+	}
+}
 
 /*
 ===============
@@ -81,61 +320,277 @@ SV_SectorList_f
 ===============
 */
 void SV_SectorList_f( void ) {
-	int				i, c;
-	worldSector_t	*sec;
-	svEntity_t		*ent;
+	int				depthSectors[MAX_SECTOR_DEPTH + 1];
+	int				depthEntities[MAX_SECTOR_DEPTH + 1];
+	int				i, total;
+	worldSector_t	*sec, *stack[8 * MAX_SECTOR_DEPTH + 1];
+	int				sp;
+
+	if ( !sv_worldTree.sectors ) {
+		Com_Printf( "No world loaded.\n" );
+		return;
+	}
 
-	for ( i = 0 ; i < AREA_NODES ; i++ ) {
-		sec = &sv_worldSectors[i];
+	Com_Memset( depthSectors, 0, sizeof( depthSectors ) );
+	Com_Memset( depthEntities, 0, sizeof( depthEntities ) );
+	total = 0;
+
+	sp = 0;
+	stack[sp++] = sv_worldTree.sectors;
+	while ( sp ) {
+		sec = stack[--sp];
+		depthSectors[sec->depth]++;
+		depthEntities[sec->depth] += sec->numEntities;
+		total++;
+		if ( sec->children ) {
+			for ( i = 0 ; i < 8 ; i++ ) {
+				stack[sp++] = &sec->children[i];
+			}
+		}
+	}
 
-		c = 0;
-		for ( ent = sec->entities ; ent ; ent = ent->nextEntityInWorldSector ) {
-			c++;
+	for ( i = 0 ; i <= sv_worldTree.maxDepth ; i++ ) {
+		if ( !depthSectors[i] ) {
+			break;
 		}
-		Com_Printf( "sector %i: %i entities\n", i, c );
+		Com_Printf( "depth %i: %i sectors, %i entities, %i units wide\n", i,
+			depthSectors[i], depthEntities[i], (int)( sv_worldTree.sectors->size * 2 ) >> i );
 	}
+	Com_Printf( "%i sectors in use, %i of %i allocated, max depth %i\n", total,
+		sv_worldTree.numSectors, sv_worldTree.maxSectors, sv_worldTree.maxDepth );
 }
 
+/*
+===============================================================================
+
+TRACE CACHE
+
+With sv_traceCache, SV_Trace remembers its results until something that could
+change them happens.  Anything linked or unlinked drops the cached traces that
+looked at its old or new bounds, and everything is dropped at the start of
+every game frame.  The game also changes entity fields without a relink, like
+r.contents when something is gibbed or picked up, so every cached trace keeps
+a hash of the clip fields of the entities in its box, and a hit only counts
+while the entities there still hash the same.
+
+Traces are only reused when start, end, box, mask, pass entity and capsule are
+all the same down to the bit, so results are never approximated.  The
+coordinates are hashed as they come in; pmove and the bots already repeat the
+exact same traces, and a trace from a nearby point would have a different
+endpos.
+
+===============================================================================
+*/
+
+#define	TRACE_CACHE_SIZE	2048		// must be a power of two
+
+typedef struct {
+	vec3_t		start, end;
+	vec3_t		mins, maxs;
+	int			passEntityNum;
+	int			contentmask;
+	int			capsule;
+} traceKey_t;
+
+typedef struct {
+	traceKey_t	key;
+	vec3_t		boxmins, boxmaxs;	// the area SV_ClipMoveToEntities looked at
+	unsigned	entityHash;			// SV_TraceEntityHash of that area
+	int			generation;			// valid while it matches traceCache.generation
+	trace_t		trace;
+} traceCacheEntry_t;
+
+typedef struct {
+	int			generation;
+	int			numLive;
+	int			live[TRACE_CACHE_SIZE];	// entries of this generation
+	int			hits, misses, dropped, mismatches;
+	traceCacheEntry_t	entries[TRACE_CACHE_SIZE];
+} traceCache_t;
+
+static traceCache_t	traceCache;
+
 /*
 ===============
-SV_CreateworldSector
+SV_FlushTraceCache
 
-Builds a uniformly subdivided tree for the given world size
+Drops all cached traces
 ===============
 */
-static worldSector_t *SV_CreateworldSector( int depth, vec3_t mins, vec3_t maxs ) {
-	worldSector_t	*anode;
-	vec3_t		size;
-	vec3_t		mins1, maxs1, mins2, maxs2;
-
-	anode = &sv_worldSectors[sv_numworldSectors];
-	sv_numworldSectors++;
-
-	if (depth == AREA_DEPTH) {
-		anode->axis = -1;
-		anode->children[0] = anode->children[1] = NULL;
-		return anode;
-	}
-	
-	VectorSubtract (maxs, mins, size);
-	if (size[0] > size[1]) {
-		anode->axis = 0;
-	} else {
-		anode->axis = 1;
+void SV_FlushTraceCache( void ) {
+	traceCache.generation++;
+	if ( !traceCache.generation ) {
+		// wrapped, clear for real so nothing old comes back
+		Com_Memset( traceCache.entries, 0, sizeof( traceCache.entries ) );
+		traceCache.generation = 1;
+	}
+	traceCache.numLive = 0;
+}
+
+/*
+===============
+SV_DropCachedTraces
+
+Drops the cached traces that could see entity num with these bounds,
+the traces that pass it never clip against it
+===============
+*/
+static void SV_DropCachedTraces( int num, const vec3_t absmin, const vec3_t absmax ) {
+	traceCacheEntry_t	*e;
+	int			i;
+
+	for ( i = 0 ; i < traceCache.numLive ; ) {
+		e = &traceCache.entries[traceCache.live[i]];
+		if ( e->key.passEntityNum == num
+			|| absmin[0] > e->boxmaxs[0] || absmin[1] > e->boxmaxs[1] || absmin[2] > e->boxmaxs[2]
+			|| absmax[0] < e->boxmins[0] || absmax[1] < e->boxmins[1] || absmax[2] < e->boxmins[2] ) {
+			i++;
+			continue;
+		}
+		e->generation = 0;
+		traceCache.live[i] = traceCache.live[--traceCache.numLive];
+		traceCache.dropped++;
 	}
+}
+
+/*
+===============
+SV_TraceCacheEntry
 
-	anode->dist = 0.5 * (maxs[anode->axis] + mins[anode->axis]);
-	VectorCopy (mins, mins1);	
-	VectorCopy (mins, mins2);	
-	VectorCopy (maxs, maxs1);	
-	VectorCopy (maxs, maxs2);	
-	
-	maxs1[anode->axis] = mins2[anode->axis] = anode->dist;
-	
-	anode->children[0] = SV_CreateworldSector (depth+1, mins2, maxs2);
-	anode->children[1] = SV_CreateworldSector (depth+1, mins1, maxs1);
+The slot a trace goes in
+===============
+*/
+static traceCacheEntry_t *SV_TraceCacheEntry( const traceKey_t *key ) {
+	const unsigned	*p;
+	unsigned	hash;
+	int			i;
+
+	// FNV-1a over the words of the key
+	p = (const unsigned *)key;
+	hash = 2166136261u;
+	for ( i = 0 ; i < sizeof( *key ) / sizeof( *p ) ; i++ ) {
+		hash = ( hash ^ p[i] ) * 16777619u;
+	}
+	hash ^= hash >> 15;
 
-	return anode;
+	return &traceCache.entries[hash & ( TRACE_CACHE_SIZE - 1 )];
+}
+
+/*
+===============
+SV_TraceEntityHash
+
+Hashes everything SV_ClipMoveToEntities reads from the entities in the box
+===============
+*/
+static unsigned SV_TraceEntityHash( const vec3_t boxmins, const vec3_t boxmaxs, int passEntityNum ) {
+	int			touchlist[MAX_GENTITIES];
+	sharedEntity_t	*touch;
+	const unsigned	*p;
+	unsigned	hash;
+	int			num, i, j;
+
+	hash = 2166136261u;
+	if ( passEntityNum != ENTITYNUM_NONE ) {
+		hash = ( hash ^ SV_GentityNum( passEntityNum )->r.ownerNum ) * 16777619u;
+	}
+
+	num = SV_AreaEntities( boxmins, boxmaxs, touchlist, MAX_GENTITIES );
+	for ( i = 0 ; i < num ; i++ ) {
+		touch = SV_GentityNum( touchlist[i] );
+
+		hash = ( hash ^ touchlist[i] ) * 16777619u;
+		hash = ( hash ^ touch->r.contents ) * 16777619u;
+		hash = ( hash ^ touch->r.ownerNum ) * 16777619u;
+		hash = ( hash ^ touch->r.bmodel ) * 16777619u;
+		hash = ( hash ^ touch->s.modelindex ) * 16777619u;
+		hash = ( hash ^ ( touch->r.svFlags & SVF_CAPSULE ) ) * 16777619u;
+
+		p = (const unsigned *)touch->r.currentOrigin;
+		for ( j = 0 ; j < 3 ; j++ ) {
+			hash = ( hash ^ p[j] ) * 16777619u;
+		}
+		p = (const unsigned *)touch->r.currentAngles;
+		for ( j = 0 ; j < 3 ; j++ ) {
+			hash = ( hash ^ p[j] ) * 16777619u;
+		}
+		p = (const unsigned *)touch->r.mins;
+		for ( j = 0 ; j < 3 ; j++ ) {
+			hash = ( hash ^ p[j] ) * 16777619u;
+		}
+		p = (const unsigned *)touch->r.maxs;
+		for ( j = 0 ; j < 3 ; j++ ) {
+			hash = ( hash ^ p[j] ) * 16777619u;
+		}
+	}
+
+	return hash;
+}
+
+/*
+===============
+SV_TracesDiffer
+
+Compares field by field, trace_t has padding in its plane
+===============
+*/
+static qboolean SV_TracesDiffer( const trace_t *a, const trace_t *b ) {
+	return a->allsolid != b->allsolid || a->startsolid != b->startsolid
+		|| a->fraction != b->fraction || !VectorCompare( a->endpos, b->endpos )
+		|| !VectorCompare( a->plane.normal, b->plane.normal ) || a->plane.dist != b->plane.dist
+		|| a->plane.type != b->plane.type || a->plane.signbits != b->plane.signbits
+		|| a->surfaceFlags != b->surfaceFlags || a->contents != b->contents
+		|| a->entityNum != b->entityNum;
+}
+
+/*
+===============
+SV_CacheTrace
+===============
+*/
+static void SV_CacheTrace( traceCacheEntry_t *e, const traceKey_t *key, const trace_t *trace ) {
+	int			i;
+
+	if ( e->generation != traceCache.generation ) {
+		e->generation = traceCache.generation;
+		traceCache.live[traceCache.numLive++] = e - traceCache.entries;
+	}
+	e->key = *key;
+	e->trace = *trace;
+
+	// the same box SV_ClipTraceToEntities uses for SV_AreaEntities
+	for ( i = 0 ; i < 3 ; i++ ) {
+		if ( key->end[i] > key->start[i] ) {
+			e->boxmins[i] = key->start[i] + key->mins[i] - 1;
+			e->boxmaxs[i] = key->end[i] + key->maxs[i] + 1;
+		} else {
+			e->boxmins[i] = key->end[i] + key->mins[i] - 1;
+			e->boxmaxs[i] = key->start[i] + key->maxs[i] + 1;
+		}
+	}
+	e->entityHash = SV_TraceEntityHash( e->boxmins, e->boxmaxs, key->passEntityNum );
+}
+
+/*
+===============
+SV_TraceCache_f
+===============
+*/
+void SV_TraceCache_f( void ) {
+	int		total;
+
+	if ( !Q_stricmp( Cmd_Argv( 1 ), "reset" ) ) {
+		traceCache.hits = traceCache.misses = traceCache.dropped = traceCache.mismatches = 0;
+		return;
+	}
+
+	total = traceCache.hits + traceCache.misses;
+	Com_Printf( "trace cache %s: %i hits, %i misses (%.1f%% hit), %i dropped by links, %i in use\n",
+		sv_traceCache->integer ? "on" : "off", traceCache.hits, traceCache.misses,
+		total ? 100.0f * traceCache.hits / total : 0.0f, traceCache.dropped, traceCache.numLive );
+	if ( sv_traceCache->integer > 1 ) {
+		Com_Printf( "%i cached traces differed from a fresh one\n", traceCache.mismatches );
+	}
 }
 
 /*
@@ -148,13 +603,12 @@ void SV_ClearWorld( void ) {
 	clipHandle_t	h;
 	vec3_t			mins, maxs;
 
-	Com_Memset( sv_worldSectors, 0, sizeof(sv_worldSectors) );
-	sv_numworldSectors = 0;
-
 	// get world map bounds
 	h = CM_InlineModel( 0 );
 	CM_ModelBounds( h, mins, maxs );
-	SV_CreateworldSector( 0, mins, maxs );
+	SV_InitWorldTree( &sv_worldTree, sv_worldSectors, MAX_WORLD_SECTORS, mins, maxs );
+
+	SV_FlushTraceCache();
 }
 
 
@@ -166,32 +620,15 @@ SV_UnlinkEntity
 */
 void SV_UnlinkEntity( sharedEntity_t *gEnt ) {
 	svEntity_t		*ent;
-	svEntity_t		*scan;
-	worldSector_t	*ws;
 
 	ent = SV_SvEntityForGentity( gEnt );
 
 	gEnt->r.linked = qfalse;
 
-	ws = ent->worldSector;
-	if ( !ws ) {
-		return;		// not linked in anywhere
-	}
-	ent->worldSector = NULL;
-
-	if ( ws->entities == ent ) {
-		ws->entities = ent->nextEntityInWorldSector;
-		return;
-	}
-
-	for ( scan = ws->entities ; scan ; scan = scan->nextEntityInWorldSector ) {
-		if ( scan->nextEntityInWorldSector == ent ) {
-			scan->nextEntityInWorldSector = ent->nextEntityInWorldSector;
-			return;
-		}
+	if ( ent->worldSector ) {
+		SV_DropCachedTraces( gEnt->s.number, ent->absmin, ent->absmax );
 	}
-
-	Com_Printf( "WARNING: SV_UnlinkEntity: not found in worldSector\n" );
+	SV_WorldTreeUnlink( &sv_worldTree, ent );
 }
 
 
@@ -203,7 +640,6 @@ SV_LinkEntity
 */
 #define MAX_TOTAL_ENT_LEAFS		128
 void SV_LinkEntity( sharedEntity_t *gEnt ) {
-	worldSector_t	*node;
 	int			leafs[MAX_TOTAL_ENT_LEAFS];
 	int			cluster;
 	int			num_leafs;
@@ -332,24 +768,11 @@ void SV_LinkEntity( sharedEntity_t *gEnt ) {
 
 	gEnt->r.linkcount++;
 
-	// find the first world sector node that the ent's box crosses
-	node = sv_worldSectors;
-	while (1)
-	{
-		if (node->axis == -1)
-			break;
-		if ( gEnt->r.absmin[node->axis] > node->dist)
-			node = node->children[0];
-		else if ( gEnt->r.absmax[node->axis] < node->dist)
-			node = node->children[1];
-		else
-			break;		// crosses the node
-	}
-	
 	// link it in
-	ent->worldSector = node;
-	ent->nextEntityInWorldSector = node->entities;
-	node->entities = ent;
+	VectorCopy( gEnt->r.absmin, ent->absmin );
+	VectorCopy( gEnt->r.absmax, ent->absmax );
+	SV_WorldTreeLink( &sv_worldTree, ent );
+	SV_DropCachedTraces( gEnt->s.number, ent->absmin, ent->absmax );
 
 	gEnt->r.linked = qtrue;
 }
@@ -367,6 +790,7 @@ bounds.  This does NOT mean that they actually touch in the case of bmodels.
 typedef struct {
 	const float	*mins;
 	const float	*maxs;
+	const svEntity_t	*base;
 	int			*list;
 	int			count, maxcount;
 } areaParms_t;
@@ -378,65 +802,83 @@ SV_AreaEntities_r
 
 ====================
 */
-static void SV_AreaEntities_r( worldSector_t *node, areaParms_t *ap ) {
-	svEntity_t	*check, *next;
-	sharedEntity_t *gcheck;
-
-	for ( check = node->entities  ; check ; check = next ) {
-		next = check->nextEntityInWorldSector;
-
-		gcheck = SV_GEntityForSvEntity( check );
+static qboolean SV_AreaEntities_r( const worldSector_t *sec, areaParms_t *ap ) {
+	const svEntity_t	*check;
+	const worldSector_t	*child;
+	int			i;
 
-		if ( gcheck->r.absmin[0] > ap->maxs[0]
-		|| gcheck->r.absmin[1] > ap->maxs[1]
-		|| gcheck->r.absmin[2] > ap->maxs[2]
-		|| gcheck->r.absmax[0] < ap->mins[0]
-		|| gcheck->r.absmax[1] < ap->mins[1]
-		|| gcheck->r.absmax[2] < ap->mins[2]) {
+	for ( check = sec->entities ; check ; check = check->nextEntityInWorldSector ) {
+		if ( check->absmin[0] > ap->maxs[0]
+		|| check->absmin[1] > ap->maxs[1]
+		|| check->absmin[2] > ap->maxs[2]
+		|| check->absmax[0] < ap->mins[0]
+		|| check->absmax[1] < ap->mins[1]
+		|| check->absmax[2] < ap->mins[2]) {
 			continue;
 		}
 
 		if ( ap->count == ap->maxcount ) {
 			Com_Printf ("SV_AreaEntities: MAXCOUNT\n");
-			return;
+			return qfalse;
 		}
 
-		ap->list[ap->count] = check - sv.svEntities;
+		ap->list[ap->count] = check - ap->base;
 		ap->count++;
 	}
-	
-	if (node->axis == -1) {
-		return;		// terminal node
-	}
 
-	// recurse down both sides
-	if ( ap->maxs[node->axis] > node->dist ) {
-		SV_AreaEntities_r ( node->children[0], ap );
+	if ( !sec->children ) {
+		return qtrue;		// terminal node
 	}
-	if ( ap->mins[node->axis] < node->dist ) {
-		SV_AreaEntities_r ( node->children[1], ap );
+
+	// recurse into the children with something linked near the area,
+	// empty ones have inverted bounds and never pass
+	for ( i = 0 ; i < 8 ; i++ ) {
+		child = &sec->children[i];
+		if ( ap->mins[0] > child->maxs[0]
+		|| ap->mins[1] > child->maxs[1]
+		|| ap->mins[2] > child->maxs[2]
+		|| ap->maxs[0] < child->mins[0]
+		|| ap->maxs[1] < child->mins[1]
+		|| ap->maxs[2] < child->mins[2] ) {
+			continue;
+		}
+		if ( !SV_AreaEntities_r( child, ap ) ) {
+			return qfalse;
+		}
 	}
+
+	return qtrue;
 }
 
 /*
 ================
-SV_AreaEntities
+SV_WorldTreeQuery
 ================
 */
-int SV_AreaEntities( const vec3_t mins, const vec3_t maxs, int *entityList, int maxcount ) {
+int SV_WorldTreeQuery( const worldTree_t *tree, const svEntity_t *base, const vec3_t mins, const vec3_t maxs, int *list, int maxcount ) {
 	areaParms_t		ap;
 
 	ap.mins = mins;
 	ap.maxs = maxs;
-	ap.list = entityList;
+	ap.base = base;
+	ap.list = list;
 	ap.count = 0;
 	ap.maxcount = maxcount;
 
-	SV_AreaEntities_r( sv_worldSectors, &ap );
+	SV_AreaEntities_r( tree->sectors, &ap );
 
 	return ap.count;
 }
 
+/*
+================
+SV_AreaEntities
+================
+*/
+int SV_AreaEntities( const vec3_t mins, const vec3_t maxs, int *entityList, int maxcount ) {
+	return SV_WorldTreeQuery( &sv_worldTree, sv.svEntities, mins, maxs, entityList, maxcount );
+}
+
 
 
 //===========================================================================
@@ -587,27 +1029,18 @@ static void SV_ClipMoveToEntities( moveclip_t *clip ) {
 
 /*
 ==================
-SV_Trace
+SV_ClipTraceToEntities
 
-Moves the given mins/maxs volume through the world from start to end.
-passEntityNum and entities owned by passEntityNum are explicitly not checked.
+Takes a trace that was clipped to the world and clips it to the entities
 ==================
 */
-void SV_Trace( trace_t *results, const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, int passEntityNum, int contentmask, int capsule ) {
+static void SV_ClipTraceToEntities( trace_t *results, const trace_t *worldTrace, const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, int passEntityNum, int contentmask, int capsule ) {
 	moveclip_t	clip;
 	int			i;
 
-	if ( !mins ) {
-		mins = vec3_origin;
-	}
-	if ( !maxs ) {
-		maxs = vec3_origin;
-	}
-
 	Com_Memset ( &clip, 0, sizeof ( moveclip_t ) );
 
-	// clip to world
-	CM_BoxTrace( &clip.trace, start, end, mins, maxs, 0, contentmask, capsule );
+	clip.trace = *worldTrace;
 	clip.trace.entityNum = clip.trace.fraction != 1.0 ? ENTITYNUM_WORLD : ENTITYNUM_NONE;
 	if ( clip.trace.fraction == 0 ) {
 		*results = clip.trace;
@@ -643,6 +1076,95 @@ void SV_Trace( trace_t *results, const vec3_t start, vec3_t mins, vec3_t maxs, c
 	*results = clip.trace;
 }
 
+/*
+==================
+SV_Trace
+
+Moves the given mins/maxs volume through the world from start to end.
+passEntityNum and entities owned by passEntityNum are explicitly not checked.
+==================
+*/
+void SV_Trace( trace_t *results, const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, int passEntityNum, int contentmask, int capsule ) {
+	trace_t		trace;
+	traceKey_t	key;
+	traceCacheEntry_t	*e;
+	qboolean	hit;
+
+	if ( !mins ) {
+		mins = vec3_origin;
+	}
+	if ( !maxs ) {
+		maxs = vec3_origin;
+	}
+
+	e = NULL;
+	hit = qfalse;
+	if ( sv_traceCache->integer ) {
+		VectorCopy( start, key.start );
+		VectorCopy( end, key.end );
+		VectorCopy( mins, key.mins );
+		VectorCopy( maxs, key.maxs );
+		key.passEntityNum = passEntityNum;
+		key.contentmask = contentmask;
+		key.capsule = capsule;
+
+		e = SV_TraceCacheEntry( &key );
+		hit = ( e->generation == traceCache.generation && !memcmp( &e->key, &key, sizeof( key ) )
+			&& e->entityHash == SV_TraceEntityHash( e->boxmins, e->boxmaxs, passEntityNum ) );
+		if ( !hit ) {
+			traceCache.misses++;
+		} else {
+			traceCache.hits++;
+			if ( sv_traceCache->integer == 1 ) {
+				*results = e->trace;
+				return;
+			}
+		}
+	}
+
+	// clip to world
+	CM_BoxTrace( &trace, start, end, mins, maxs, 0, contentmask, capsule );
+
+	SV_ClipTraceToEntities( &trace, &trace, start, mins, maxs, end, passEntityNum, contentmask, capsule );
+
+	if ( hit ) {
+		// sv_traceCache 2 checks the hits against the real thing
+		if ( SV_TracesDiffer( &e->trace, &trace ) ) {
+			traceCache.mismatches++;
+		}
+	} else if ( e ) {
+		SV_CacheTrace( e, &key, &trace );
+	}
+
+	*results = trace;
+}
+
+/*
+==================
+SV_TraceBatch
+
+numTraces SV_Trace calls that share everything but the start and end,
+the world part of them is done with one walk of the tree
+==================
+*/
+void SV_TraceBatch( trace_t *results, int numTraces, const vec3_t *starts, const vec3_t *ends, vec3_t mins, vec3_t maxs, int passEntityNum, int contentmask, int capsule ) {
+	int			i;
+
+	if ( !mins ) {
+		mins = vec3_origin;
+	}
+	if ( !maxs ) {
+		maxs = vec3_origin;
+	}
+
+	// clip to world
+	CM_BoxTraceBatch( results, numTraces, starts, ends, mins, maxs, 0, contentmask, capsule );
+
+	for ( i = 0 ; i < numTraces ; i++ ) {
+		SV_ClipTraceToEntities( &results[i], &results[i], starts[i], mins, maxs, ends[i], passEntityNum, contentmask, capsule );
+	}
+}
+
 
 
 /*
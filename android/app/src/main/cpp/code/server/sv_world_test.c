@@ -0,0 +1,673 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// sv_world_test.c -- times the entity octree against the old sector tree
+
+/*
+
+worldbench record <name>
+worldbench <name|live> [traces] [seed]
+
+record saves the bounds of every linked entity of the running server to
+worldbench/<name>.txt, so the layout of a busy bot match can be measured
+again later without the game running.
+
+The bench loads a layout, or takes the live one, and links it into a
+private octree and into the fixed 64 sector tree the server used before.
+It then sweeps a set of traces shaped like the ones a bot match makes:
+mostly short player sized moves, plus long point traces for shots and
+visibility checks.  Every area query has to return the same entities as a
+linear scan, both after the initial link and after some frames of
+movement, and the query and relink loops are timed for both indices.
+
+With a live layout the same traces are also run through SV_Trace, which
+includes the clipping against the entities and the world.
+
+*/
+
+#include "server.h"
+
+#define WB_SECTORS			( 1 + 8 * 512 )
+#define WB_MAX_AREA			1024
+#define WB_FRAMES			1000
+
+#define	LEGACY_DEPTH		4
+#define	LEGACY_NODES		64
+
+// the evenly spaced tree the server used up to now
+typedef struct {
+	int		axis;		// -1 = leaf node
+	float	dist;
+	int		children[2];
+	int		entities;
+} legacySector_t;
+
+typedef struct {
+	vec3_t		start, end;
+	vec3_t		mins, maxs;
+	vec3_t		boxmins, boxmaxs;
+	int			passEntityNum;
+} wbTrace_t;
+
+typedef struct {
+	int				seed;
+	char			map[MAX_QPATH];
+	vec3_t			worldMins, worldMaxs;
+
+	svEntity_t		*ents;
+	int				*nums;			// numbers of the entities in the layout
+	int				numEnts;
+
+	worldTree_t		tree;
+	worldSector_t	*sectors;
+
+	legacySector_t	legacy[LEGACY_NODES];
+	int				numLegacy;
+	int				legacySector[MAX_GENTITIES];
+	int				legacyNext[MAX_GENTITIES];
+
+	wbTrace_t		*traces;
+	int				numTraces;
+} worldBench_t;
+
+static worldBench_t	wb;
+
+/*
+===============================================================================
+
+LEGACY SECTORS
+
+===============================================================================
+*/
+
+/*
+===============
+WB_CreateLegacySector
+===============
+*/
+static int WB_CreateLegacySector( int depth, vec3_t mins, vec3_t maxs ) {
+	legacySector_t	*anode;
+	vec3_t		size;
+	vec3_t		mins1, maxs1, mins2, maxs2;
+	int			num;
+
+	num = wb.numLegacy++;
+	anode = &wb.legacy[num];
+	anode->entities = -1;
+
+	if ( depth == LEGACY_DEPTH ) {
+		anode->axis = -1;
+		anode->children[0] = anode->children[1] = -1;
+		return num;
+	}
+
+	VectorSubtract( maxs, mins, size );
+	anode->axis = size[0] > size[1] ? 0 : 1;
+	anode->dist = 0.5 * ( maxs[anode->axis] + mins[anode->axis] );
+
+	VectorCopy( mins, mins1 );
+	VectorCopy( mins, mins2 );
+	VectorCopy( maxs, maxs1 );
+	VectorCopy( maxs, maxs2 );
+	maxs1[anode->axis] = mins2[anode->axis] = anode->dist;
+
+	anode->children[0] = WB_CreateLegacySector( depth + 1, mins2, maxs2 );
+	anode->children[1] = WB_CreateLegacySector( depth + 1, mins1, maxs1 );
+
+	return num;
+}
+
+/*
+===============
+WB_LegacyUnlink
+===============
+*/
+static void WB_LegacyUnlink( int num ) {
+	int		*prev;
+
+	if ( wb.legacySector[num] == -1 ) {
+		return;
+	}
+	for ( prev = &wb.legacy[wb.legacySector[num]].entities ; *prev != -1 ; prev = &wb.legacyNext[*prev] ) {
+		if ( *prev == num ) {
+			*prev = wb.legacyNext[num];
+			break;
+		}
+	}
+	wb.legacySector[num] = -1;
+}
+
+/*
+===============
+WB_LegacyLink
+===============
+*/
+static void WB_LegacyLink( int num ) {
+	const svEntity_t	*ent = &wb.ents[num];
+	legacySector_t		*node;
+	int					n;
+
+	n = 0;
+	while ( 1 ) {
+		node = &wb.legacy[n];
+		if ( node->axis == -1 ) {
+			break;
+		}
+		if ( ent->absmin[node->axis] > node->dist ) {
+			n = node->children[0];
+		} else if ( ent->absmax[node->axis] < node->dist ) {
+			n = node->children[1];
+		} else {
+			break;		// crosses the node
+		}
+	}
+
+	wb.legacySector[num] = n;
+	wb.legacyNext[num] = node->entities;
+	node->entities = num;
+}
+
+/*
+===============
+WB_LegacyQuery_r
+===============
+*/
+static int WB_LegacyQuery_r( int n, const vec3_t mins, const vec3_t maxs, int *list, int count, int maxcount ) {
+	const legacySector_t	*node = &wb.legacy[n];
+	const svEntity_t		*check;
+	int						num;
+
+	for ( num = node->entities ; num != -1 ; num = wb.legacyNext[num] ) {
+		check = &wb.ents[num];
+		if ( check->absmin[0] > maxs[0]
+		|| check->absmin[1] > maxs[1]
+		|| check->absmin[2] > maxs[2]
+		|| check->absmax[0] < mins[0]
+		|| check->absmax[1] < mins[1]
+		|| check->absmax[2] < mins[2]) {
+			continue;
+		}
+		if ( count == maxcount ) {
+			return count;
+		}
+		list[count++] = num;
+	}
+
+	if ( node->axis == -1 ) {
+		return count;
+	}
+	if ( maxs[node->axis] > node->dist ) {
+		count = WB_LegacyQuery_r( node->children[0], mins, maxs, list, count, maxcount );
+	}
+	if ( mins[node->axis] < node->dist ) {
+		count = WB_LegacyQuery_r( node->children[1], mins, maxs, list, count, maxcount );
+	}
+	return count;
+}
+
+/*
+===============================================================================
+
+LAYOUTS
+
+===============================================================================
+*/
+
+/*
+===============
+WB_AddEntity
+===============
+*/
+static void WB_AddEntity( int num, const vec3_t absmin, const vec3_t absmax ) {
+	if ( num < 0 || num >= MAX_GENTITIES || wb.ents[num].worldSector || wb.legacySector[num] != -1 ) {
+		return;
+	}
+	VectorCopy( absmin, wb.ents[num].absmin );
+	VectorCopy( absmax, wb.ents[num].absmax );
+	wb.nums[wb.numEnts++] = num;
+
+	SV_WorldTreeLink( &wb.tree, &wb.ents[num] );
+	WB_LegacyLink( num );
+}
+
+/*
+===============
+WB_LayoutName
+===============
+*/
+static void WB_LayoutName( char *path, int size, const char *name ) {
+	Com_sprintf( path, size, "worldbench/%s.txt", name );
+}
+
+/*
+===============
+WB_RecordLayout
+===============
+*/
+static void WB_RecordLayout( const char *name ) {
+	char			path[MAX_QPATH];
+	fileHandle_t	f;
+	vec3_t			mins, maxs;
+	svEntity_t		*ent;
+	int				i, count;
+
+	if ( !com_sv_running->integer || sv.state != SS_GAME ) {
+		Com_Printf( "Server is not running.\n" );
+		return;
+	}
+
+	WB_LayoutName( path, sizeof( path ), name );
+	f = FS_FOpenFileWrite( path );
+	if ( !f ) {
+		Com_Printf( "worldbench: couldn't write %s\n", path );
+		return;
+	}
+
+	CM_ModelBounds( CM_InlineModel( 0 ), mins, maxs );
+	FS_Printf( f, "worldbench 1\n" );
+	FS_Printf( f, "map %s\n", sv_mapname->string );
+	FS_Printf( f, "bounds %f %f %f %f %f %f\n", mins[0], mins[1], mins[2], maxs[0], maxs[1], maxs[2] );
+
+	count = 0;
+	for ( i = 0 ; i < sv.num_entities ; i++ ) {
+		ent = &sv.svEntities[i];
+		if ( !ent->worldSector ) {
+			continue;
+		}
+		FS_Printf( f, "%i %f %f %f %f %f %f\n", i, ent->absmin[0], ent->absmin[1], ent->absmin[2],
+			ent->absmax[0], ent->absmax[1], ent->absmax[2] );
+		count++;
+	}
+	FS_FCloseFile( f );
+
+	Com_Printf( "worldbench: wrote %i entities to %s\n", count, path );
+}
+
+/*
+===============
+WB_ParseVector
+===============
+*/
+static void WB_ParseVector( char **text, vec3_t v ) {
+	int		i;
+
+	for ( i = 0 ; i < 3 ; i++ ) {
+		v[i] = atof( COM_Parse( text ) );
+	}
+}
+
+/*
+===============
+WB_LoadLayout
+===============
+*/
+static qboolean WB_LoadLayout( const char *name ) {
+	char		path[MAX_QPATH];
+	union {
+		char	*c;
+		void	*v;
+	} buffer;
+	char		*text, *token;
+	vec3_t		absmin, absmax;
+	int			i, num;
+
+	if ( !Q_stricmp( name, "live" ) ) {
+		if ( !com_sv_running->integer || sv.state != SS_GAME ) {
+			Com_Printf( "Server is not running.\n" );
+			return qfalse;
+		}
+		Q_strncpyz( wb.map, sv_mapname->string, sizeof( wb.map ) );
+		CM_ModelBounds( CM_InlineModel( 0 ), wb.worldMins, wb.worldMaxs );
+		SV_InitWorldTree( &wb.tree, wb.sectors, WB_SECTORS, wb.worldMins, wb.worldMaxs );
+		WB_CreateLegacySector( 0, wb.worldMins, wb.worldMaxs );
+		for ( i = 0 ; i < sv.num_entities ; i++ ) {
+			if ( sv.svEntities[i].worldSector ) {
+				WB_AddEntity( i, sv.svEntities[i].absmin, sv.svEntities[i].absmax );
+			}
+		}
+		return qtrue;
+	}
+
+	WB_LayoutName( path, sizeof( path ), name );
+	if ( FS_ReadFile( path, &buffer.v ) < 0 || !buffer.c ) {
+		Com_Printf( "worldbench: couldn't load %s\n", path );
+		return qfalse;
+	}
+
+	text = buffer.c;
+	if ( strcmp( COM_Parse( &text ), "worldbench" ) || atoi( COM_Parse( &text ) ) != 1 ) {
+		Com_Printf( "worldbench: %s is not a layout\n", path );
+		FS_FreeFile( buffer.v );
+		return qfalse;
+	}
+
+	while ( 1 ) {
+		token = COM_Parse( &text );
+		if ( !token[0] ) {
+			break;
+		}
+		if ( !strcmp( token, "map" ) ) {
+			Q_strncpyz( wb.map, COM_Parse( &text ), sizeof( wb.map ) );
+		} else if ( !strcmp( token, "bounds" ) ) {
+			WB_ParseVector( &text, wb.worldMins );
+			WB_ParseVector( &text, wb.worldMaxs );
+			SV_InitWorldTree( &wb.tree, wb.sectors, WB_SECTORS, wb.worldMins, wb.worldMaxs );
+			wb.numLegacy = 0;
+			WB_CreateLegacySector( 0, wb.worldMins, wb.worldMaxs );
+		} else {
+			num = atoi( token );
+			WB_ParseVector( &text, absmin );
+			WB_ParseVector( &text, absmax );
+			if ( !wb.numLegacy ) {
+				Com_Printf( "worldbench: %s has entities before the bounds\n", path );
+				FS_FreeFile( buffer.v );
+				return qfalse;
+			}
+			WB_AddEntity( num, absmin, absmax );
+		}
+	}
+
+	FS_FreeFile( buffer.v );
+
+	if ( !wb.numLegacy ) {
+		Com_Printf( "worldbench: %s has no bounds\n", path );
+		return qfalse;
+	}
+	return qtrue;
+}
+
+/*
+===============================================================================
+
+TRACES
+
+===============================================================================
+*/
+
+/*
+===============
+WB_BuildTraces
+
+Mostly short player sized moves starting at entities, a third of them
+long point traces
+===============
+*/
+static void WB_BuildTraces( int count ) {
+	static const vec3_t	playerMins = { -15, -15, -24 };
+	static const vec3_t	playerMaxs = { 15, 15, 32 };
+	const svEntity_t	*ent;
+	wbTrace_t	*tr;
+	vec3_t		dir;
+	float		length;
+	int			i, j;
+
+	wb.numTraces = count;
+	for ( i = 0 ; i < count ; i++ ) {
+		tr = &wb.traces[i];
+
+		if ( wb.numEnts ) {
+			tr->passEntityNum = wb.nums[( (unsigned)Q_rand( &wb.seed ) >> 8 ) % wb.numEnts];
+			ent = &wb.ents[tr->passEntityNum];
+			for ( j = 0 ; j < 3 ; j++ ) {
+				tr->start[j] = 0.5f * ( ent->absmin[j] + ent->absmax[j] );
+			}
+		} else {
+			tr->passEntityNum = ENTITYNUM_NONE;
+			for ( j = 0 ; j < 3 ; j++ ) {
+				tr->start[j] = wb.worldMins[j] + Q_random( &wb.seed ) * ( wb.worldMaxs[j] - wb.worldMins[j] );
+			}
+		}
+
+		dir[0] = Q_crandom( &wb.seed );
+		dir[1] = Q_crandom( &wb.seed );
+		dir[2] = Q_crandom( &wb.seed ) * 0.25f;
+		VectorNormalize( dir );
+
+		if ( i % 3 == 2 ) {
+			length = 8192 * Q_random( &wb.seed ) * Q_random( &wb.seed );
+			VectorClear( tr->mins );
+			VectorClear( tr->maxs );
+		} else {
+			length = 64 * Q_random( &wb.seed );
+			VectorCopy( playerMins, tr->mins );
+			VectorCopy( playerMaxs, tr->maxs );
+		}
+		VectorMA( tr->start, length, dir, tr->end );
+
+		// the same box SV_Trace gives SV_AreaEntities
+		for ( j = 0 ; j < 3 ; j++ ) {
+			if ( tr->end[j] > tr->start[j] ) {
+				tr->boxmins[j] = tr->start[j] + tr->mins[j] - 1;
+				tr->boxmaxs[j] = tr->end[j] + tr->maxs[j] + 1;
+			} else {
+				tr->boxmins[j] = tr->end[j] + tr->mins[j] - 1;
+				tr->boxmaxs[j] = tr->start[j] + tr->maxs[j] + 1;
+			}
+		}
+	}
+}
+
+/*
+===============
+WB_SortList
+===============
+*/
+static void WB_SortList( int *list, int count ) {
+	int		i, j, v;
+
+	for ( i = 1 ; i < count ; i++ ) {
+		v = list[i];
+		for ( j = i ; j > 0 && list[j - 1] > v ; j-- ) {
+			list[j] = list[j - 1];
+		}
+		list[j] = v;
+	}
+}
+
+/*
+===============
+WB_CheckTraces
+
+Returns the number of traces where the octree and the legacy tree
+disagree with a linear scan
+===============
+*/
+static void WB_CheckTraces( int *treeFailed, int *legacyFailed ) {
+	int			scan[WB_MAX_AREA], list[WB_MAX_AREA];
+	const wbTrace_t		*tr;
+	const svEntity_t	*check;
+	int			i, j, count, scanCount;
+
+	*treeFailed = *legacyFailed = 0;
+
+	for ( i = 0 ; i < wb.numTraces ; i++ ) {
+		tr = &wb.traces[i];
+
+		scanCount = 0;
+		for ( j = 0 ; j < wb.numEnts && scanCount < WB_MAX_AREA ; j++ ) {
+			check = &wb.ents[wb.nums[j]];
+			if ( check->absmin[0] > tr->boxmaxs[0]
+			|| check->absmin[1] > tr->boxmaxs[1]
+			|| check->absmin[2] > tr->boxmaxs[2]
+			|| check->absmax[0] < tr->boxmins[0]
+			|| check->absmax[1] < tr->boxmins[1]
+			|| check->absmax[2] < tr->boxmins[2]) {
+				continue;
+			}
+			scan[scanCount++] = wb.nums[j];
+		}
+		WB_SortList( scan, scanCount );
+
+		count = SV_WorldTreeQuery( &wb.tree, wb.ents, tr->boxmins, tr->boxmaxs, list, WB_MAX_AREA );
+		WB_SortList( list, count );
+		if ( count != scanCount || memcmp( list, scan, count * sizeof( int ) ) ) {
+			(*treeFailed)++;
+		}
+
+		count = WB_LegacyQuery_r( 0, tr->boxmins, tr->boxmaxs, list, 0, WB_MAX_AREA );
+		WB_SortList( list, count );
+		if ( count != scanCount || memcmp( list, scan, count * sizeof( int ) ) ) {
+			(*legacyFailed)++;
+		}
+	}
+}
+
+/*
+===============
+WB_Move
+
+Moves every entity back and forth a little, like a frame of a match
+===============
+*/
+static void WB_Move( int frame, int num ) {
+	svEntity_t	*ent = &wb.ents[num];
+	float		d;
+
+	d = ( num * 37 ) % 17 - 8;
+	if ( frame & 1 ) {
+		d = -d;
+	}
+	ent->absmin[0] += d;
+	ent->absmax[0] += d;
+	ent->absmin[1] += d * 0.5f;
+	ent->absmax[1] += d * 0.5f;
+}
+
+/*
+===============
+SV_WorldBench_f
+===============
+*/
+void SV_WorldBench_f( void ) {
+	int		list[WB_MAX_AREA];
+	int		count, seed, failed[4];
+	int		i, f, start;
+	int		treeMsec, legacyMsec, traceMsec;
+	int		treeFound, legacyFound;
+	qboolean	live;
+	trace_t	trace;
+
+	if ( Cmd_Argc() < 2 ) {
+		Com_Printf( "usage: worldbench record <name>\n" );
+		Com_Printf( "       worldbench <name|live> [traces] [seed]\n" );
+		return;
+	}
+
+	if ( !Q_stricmp( Cmd_Argv( 1 ), "record" ) ) {
+		if ( Cmd_Argc() < 3 ) {
+			Com_Printf( "usage: worldbench record <name>\n" );
+			return;
+		}
+		WB_RecordLayout( Cmd_Argv( 2 ) );
+		return;
+	}
+
+	count = Cmd_Argc() > 2 ? atoi( Cmd_Argv( 2 ) ) : 100000;
+	seed = Cmd_Argc() > 3 ? atoi( Cmd_Argv( 3 ) ) : Com_Milliseconds();
+	if ( count < 1 || count > 1000000 ) {
+		Com_Printf( "worldbench: traces must be 1 to 1000000\n" );
+		return;
+	}
+	live = !Q_stricmp( Cmd_Argv( 1 ), "live" );
+
+	Com_Memset( &wb, 0, sizeof( wb ) );
+	Com_Memset( wb.legacySector, -1, sizeof( wb.legacySector ) );
+	wb.seed = seed;
+	wb.ents = Z_Malloc( MAX_GENTITIES * sizeof( *wb.ents ) );
+	wb.nums = Z_Malloc( MAX_GENTITIES * sizeof( *wb.nums ) );
+	wb.sectors = Z_Malloc( WB_SECTORS * sizeof( *wb.sectors ) );
+	wb.traces = Z_Malloc( count * sizeof( *wb.traces ) );
+
+	if ( !WB_LoadLayout( Cmd_Argv( 1 ) ) ) {
+		goto done;
+	}
+
+	WB_BuildTraces( count );
+	WB_CheckTraces( &failed[0], &failed[1] );
+
+	// relink every entity each frame, the way the game does for everything
+	// that moves
+	start = Sys_Milliseconds();
+	for ( f = 0 ; f < WB_FRAMES ; f++ ) {
+		for ( i = 0 ; i < wb.numEnts ; i++ ) {
+			WB_Move( f, wb.nums[i] );
+			SV_WorldTreeUnlink( &wb.tree, &wb.ents[wb.nums[i]] );
+			SV_WorldTreeLink( &wb.tree, &wb.ents[wb.nums[i]] );
+		}
+	}
+	treeMsec = Sys_Milliseconds() - start;
+
+	start = Sys_Milliseconds();
+	for ( f = 0 ; f < WB_FRAMES ; f++ ) {
+		for ( i = 0 ; i < wb.numEnts ; i++ ) {
+			WB_Move( f, wb.nums[i] );
+			WB_LegacyUnlink( wb.nums[i] );
+			WB_LegacyLink( wb.nums[i] );
+		}
+	}
+	legacyMsec = Sys_Milliseconds() - start;
+
+	// an even number of frames puts everything back where both trees
+	// last linked it
+	WB_CheckTraces( &failed[2], &failed[3] );
+
+	Com_Printf( "worldbench: %s on %s, %i entities, %i traces, seed %i\n", Cmd_Argv( 1 ),
+		wb.map, wb.numEnts, count, seed );
+	Com_Printf( "worldbench: octree %i sectors allocated, max depth %i\n", wb.tree.numSectors, wb.tree.maxDepth );
+	Com_Printf( "worldbench: %i / %i octree queries and %i / %i legacy queries differ from a scan\n",
+		failed[0], failed[2], failed[1], failed[3] );
+	Com_Printf( "worldbench: %i relinks, octree %i msec, legacy %i msec\n",
+		WB_FRAMES * wb.numEnts, treeMsec, legacyMsec );
+
+	treeFound = 0;
+	start = Sys_Milliseconds();
+	for ( i = 0 ; i < wb.numTraces ; i++ ) {
+		treeFound += SV_WorldTreeQuery( &wb.tree, wb.ents, wb.traces[i].boxmins, wb.traces[i].boxmaxs, list, WB_MAX_AREA );
+	}
+	treeMsec = Sys_Milliseconds() - start;
+
+	legacyFound = 0;
+	start = Sys_Milliseconds();
+	for ( i = 0 ; i < wb.numTraces ; i++ ) {
+		legacyFound += WB_LegacyQuery_r( 0, wb.traces[i].boxmins, wb.traces[i].boxmaxs, list, 0, WB_MAX_AREA );
+	}
+	legacyMsec = Sys_Milliseconds() - start;
+
+	Com_Printf( "worldbench: area queries, octree %i msec, legacy %i msec, %i / %i entities found\n",
+		treeMsec, legacyMsec, treeFound, legacyFound );
+
+	if ( live ) {
+		start = Sys_Milliseconds();
+		for ( i = 0 ; i < wb.numTraces ; i++ ) {
+			SV_Trace( &trace, wb.traces[i].start, wb.traces[i].mins, wb.traces[i].maxs, wb.traces[i].end,
+				wb.traces[i].passEntityNum, CONTENTS_SOLID | CONTENTS_BODY, qfalse );
+		}
+		traceMsec = Sys_Milliseconds() - start;
+		Com_Printf( "worldbench: SV_Trace %i msec\n", traceMsec );
+	}
+
+done:
+	Z_Free( wb.traces );
+	Z_Free( wb.sectors );
+	Z_Free( wb.nums );
+	Z_Free( wb.ents );
+	Com_Memset( &wb, 0, sizeof( wb ) );
+}
@@ -33,11 +33,13 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include <unistd.h>
 #include <sys/mman.h>
 #include <sys/time.h>
+#include <time.h>
 #include <pwd.h>
 #include <libgen.h>
 #include <fcntl.h>
 #include <fenv.h>
 #include <sys/wait.h>
+#include <pthread.h>
 
 qboolean stdinIsATTY;
 
@@ -152,6 +154,22 @@ int Sys_Milliseconds (void)
 	return curtime;
 }
 
+/*
+================
+Sys_Microseconds
+
+Monotonic, from an arbitrary origin
+================
+*/
+int64_t Sys_Microseconds (void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
 /*
 ==================
 Sys_RandomBytes
@@ -256,6 +274,106 @@ qboolean Sys_Mkdir( const char *path )
 	return qtrue;
 }
 
+/*
+==================
+Sys_StatFile
+
+Size and modification time of a file, qfalse if it isn't there
+==================
+*/
+qboolean Sys_StatFile( const char *ospath, int64_t *size, int64_t *mtime )
+{
+	struct stat buf;
+
+	if( stat( ospath, &buf ) || !S_ISREG( buf.st_mode ) )
+		return qfalse;
+
+	*size = buf.st_size;
+	*mtime = buf.st_mtime;
+	return qtrue;
+}
+
+/*
+==================
+Sys_MapFile
+
+Maps a whole file read only, NULL if it can't be opened or is empty
+==================
+*/
+void *Sys_MapFile( const char *ospath, int *length )
+{
+	struct stat buf;
+	void	*base;
+	int		fd;
+
+	fd = open( ospath, O_RDONLY );
+	if( fd == -1 )
+		return NULL;
+
+	if( fstat( fd, &buf ) || !S_ISREG( buf.st_mode ) || buf.st_size <= 0 || buf.st_size > 0x7fffffff )
+	{
+		close( fd );
+		return NULL;
+	}
+
+	// the mapping keeps the file open
+	base = mmap( NULL, buf.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+	close( fd );
+	if( base == MAP_FAILED )
+		return NULL;
+
+	*length = buf.st_size;
+	return base;
+}
+
+/*
+==================
+Sys_MapFileRange
+
+Maps length bytes at offset in a file copy on write, so that the memory can
+be changed without changing the file.  Returns the bytes, and in base and
+baseLength what has to be unmapped.
+==================
+*/
+void *Sys_MapFileRange( const char *ospath, int64_t offset, int length, void **base, int *baseLength )
+{
+	struct stat buf;
+	int64_t	start;
+	void	*mapping;
+	int		fd;
+
+	fd = open( ospath, O_RDONLY );
+	if( fd == -1 )
+		return NULL;
+
+	// touching pages past the end of the file would raise SIGBUS
+	if( fstat( fd, &buf ) || offset < 0 || length <= 0 || offset + length > buf.st_size )
+	{
+		close( fd );
+		return NULL;
+	}
+
+	start = offset & ~(int64_t)( sysconf( _SC_PAGESIZE ) - 1 );
+	mapping = mmap( NULL, offset - start + length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, start );
+	close( fd );
+	if( mapping == MAP_FAILED )
+		return NULL;
+
+	*base = mapping;
+	*baseLength = offset - start + length;
+	return (byte *)mapping + ( offset - start );
+}
+
+/*
+==================
+Sys_UnmapFile
+==================
+*/
+void Sys_UnmapFile( void *base, int length )
+{
+	munmap( base, length );
+}
+
 /*
 ==================
 Sys_Mkfifo
@@ -532,6 +650,209 @@ void Sys_Sleep( int msec )
 	}
 }
 
+/*
+==============================================================
+
+THREADS
+
+==============================================================
+*/
+
+typedef struct
+{
+	void	(*function)( void *arg );
+	void	*arg;
+	pthread_t	thread;
+} sysThread_t;
+
+typedef struct
+{
+	pthread_mutex_t	mutex;
+	pthread_cond_t	cond;
+	int				count;
+} sysSemaphore_t;
+
+/*
+==================
+Sys_ThreadMain
+==================
+*/
+static void *Sys_ThreadMain( void *arg )
+{
+	sysThread_t *thread = arg;
+	sigset_t set;
+
+	// signals are handled by the main thread
+	sigfillset( &set );
+	pthread_sigmask( SIG_BLOCK, &set, NULL );
+
+	thread->function( thread->arg );
+	return NULL;
+}
+
+/*
+==================
+Sys_CreateThread
+
+Returns NULL if the thread could not be started
+==================
+*/
+void *Sys_CreateThread( void (*function)( void *arg ), void *arg )
+{
+	sysThread_t *thread = calloc( 1, sizeof( *thread ) );
+
+	if( !thread )
+		return NULL;
+
+	thread->function = function;
+	thread->arg = arg;
+
+	if( pthread_create( &thread->thread, NULL, Sys_ThreadMain, thread ) )
+	{
+		free( thread );
+		return NULL;
+	}
+
+	return thread;
+}
+
+/*
+==================
+Sys_JoinThread
+
+Waits for the thread to return and frees it
+==================
+*/
+void Sys_JoinThread( void *thread )
+{
+	sysThread_t *t = thread;
+
+	pthread_join( t->thread, NULL );
+	free( t );
+}
+
+/*
+==================
+Sys_CreateMutex
+==================
+*/
+void *Sys_CreateMutex( void )
+{
+	pthread_mutex_t *mutex = malloc( sizeof( *mutex ) );
+
+	if( !mutex )
+		Sys_Error( "Sys_CreateMutex: out of memory" );
+
+	pthread_mutex_init( mutex, NULL );
+	return mutex;
+}
+
+/*
+==================
+Sys_DestroyMutex
+==================
+*/
+void Sys_DestroyMutex( void *mutex )
+{
+	pthread_mutex_destroy( mutex );
+	free( mutex );
+}
+
+/*
+==================
+Sys_LockMutex
+==================
+*/
+void Sys_LockMutex( void *mutex )
+{
+	pthread_mutex_lock( mutex );
+}
+
+/*
+==================
+Sys_TryLockMutex
+==================
+*/
+qboolean Sys_TryLockMutex( void *mutex )
+{
+	return pthread_mutex_trylock( mutex ) == 0;
+}
+
+/*
+==================
+Sys_UnlockMutex
+==================
+*/
+void Sys_UnlockMutex( void *mutex )
+{
+	pthread_mutex_unlock( mutex );
+}
+
+/*
+==================
+Sys_CreateSemaphore
+
+Counting semaphore starting at zero. Unnamed POSIX semaphores are not
+available on OS X, so this is built from a mutex and a condition.
+==================
+*/
+void *Sys_CreateSemaphore( void )
+{
+	sysSemaphore_t *sem = calloc( 1, sizeof( *sem ) );
+
+	if( !sem )
+		Sys_Error( "Sys_CreateSemaphore: out of memory" );
+
+	pthread_mutex_init( &sem->mutex, NULL );
+	pthread_cond_init( &sem->cond, NULL );
+	return sem;
+}
+
+/*
+==================
+Sys_DestroySemaphore
+==================
+*/
+void Sys_DestroySemaphore( void *sem )
+{
+	sysSemaphore_t *s = sem;
+
+	pthread_cond_destroy( &s->cond );
+	pthread_mutex_destroy( &s->mutex );
+	free( s );
+}
+
+/*
+==================
+Sys_WaitSemaphore
+==================
+*/
+void Sys_WaitSemaphore( void *sem )
+{
+	sysSemaphore_t *s = sem;
+
+	pthread_mutex_lock( &s->mutex );
+	while( s->count <= 0 )
+		pthread_cond_wait( &s->cond, &s->mutex );
+	s->count--;
+	pthread_mutex_unlock( &s->mutex );
+}
+
+/*
+==================
+Sys_PostSemaphore
+==================
+*/
+void Sys_PostSemaphore( void *sem )
+{
+	sysSemaphore_t *s = sem;
+
+	pthread_mutex_lock( &s->mutex );
+	s->count++;
+	pthread_cond_signal( &s->cond );
+	pthread_mutex_unlock( &s->mutex );
+}
+
 /*
 ==============
 Sys_ErrorDialog
@@ -242,6 +242,27 @@ int Sys_Milliseconds (void)
 	return sys_curtime;
 }
 
+/*
+================
+Sys_Microseconds
+
+Monotonic, from an arbitrary origin
+================
+*/
+int64_t Sys_Microseconds (void)
+{
+	static LARGE_INTEGER	frequency;
+	LARGE_INTEGER			counter;
+
+	if (!frequency.QuadPart) {
+		QueryPerformanceFrequency(&frequency);
+	}
+	QueryPerformanceCounter(&counter);
+
+	return counter.QuadPart / frequency.QuadPart * 1000000
+		+ counter.QuadPart % frequency.QuadPart * 1000000 / frequency.QuadPart;
+}
+
 /*
 ================
 Sys_RandomBytes
@@ -384,6 +405,122 @@ qboolean Sys_Mkdir( const char *path )
 	return qtrue;
 }
 
+/*
+==============
+Sys_StatFile
+
+Size and modification time of a file, qfalse if it isn't there
+==============
+*/
+qboolean Sys_StatFile( const char *ospath, int64_t *size, int64_t *mtime )
+{
+	WIN32_FILE_ATTRIBUTE_DATA data;
+
+	if( !GetFileAttributesEx( ospath, GetFileExInfoStandard, &data ) ||
+		( data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY ) )
+		return qfalse;
+
+	*size = ( (int64_t)data.nFileSizeHigh << 32 ) | data.nFileSizeLow;
+	*mtime = ( (int64_t)data.ftLastWriteTime.dwHighDateTime << 32 ) | data.ftLastWriteTime.dwLowDateTime;
+	return qtrue;
+}
+
+/*
+==============
+Sys_MapFile
+
+Maps a whole file read only, NULL if it can't be opened or is empty
+==============
+*/
+void *Sys_MapFile( const char *ospath, int *length )
+{
+	HANDLE	file, mapping;
+	DWORD	high, low;
+	void	*base;
+
+	file = CreateFile( ospath, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+	if( file == INVALID_HANDLE_VALUE )
+		return NULL;
+
+	low = GetFileSize( file, &high );
+	if( low == INVALID_FILE_SIZE || high || low == 0 || low > 0x7fffffff )
+	{
+		CloseHandle( file );
+		return NULL;
+	}
+
+	// the view keeps the mapping and the file open
+	mapping = CreateFileMapping( file, NULL, PAGE_READONLY, 0, 0, NULL );
+	CloseHandle( file );
+	if( !mapping )
+		return NULL;
+
+	base = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+	CloseHandle( mapping );
+	if( !base )
+		return NULL;
+
+	*length = low;
+	return base;
+}
+
+/*
+==============
+Sys_MapFileRange
+
+Maps length bytes at offset in a file copy on write, so that the memory can
+be changed without changing the file.  Returns the bytes, and in base and
+baseLength what has to be unmapped.
+==============
+*/
+void *Sys_MapFileRange( const char *ospath, int64_t offset, int length, void **base, int *baseLength )
+{
+	SYSTEM_INFO	info;
+	HANDLE	file, mapping;
+	LARGE_INTEGER size;
+	int64_t	start;
+	void	*view;
+
+	file = CreateFile( ospath, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+	if( file == INVALID_HANDLE_VALUE )
+		return NULL;
+
+	if( !GetFileSizeEx( file, &size ) || offset < 0 || length <= 0 || offset + length > size.QuadPart )
+	{
+		CloseHandle( file );
+		return NULL;
+	}
+
+	// the view keeps the mapping and the file open
+	mapping = CreateFileMapping( file, NULL, PAGE_WRITECOPY, 0, 0, NULL );
+	CloseHandle( file );
+	if( !mapping )
+		return NULL;
+
+	GetSystemInfo( &info );
+	start = offset & ~(int64_t)( info.dwAllocationGranularity - 1 );
+	view = MapViewOfFile( mapping, FILE_MAP_COPY, (DWORD)( start >> 32 ), (DWORD)start, offset - start + length );
+	CloseHandle( mapping );
+	if( !view )
+		return NULL;
+
+	*base = view;
+	*baseLength = offset - start + length;
+	return (byte *)view + ( offset - start );
+}
+
+/*
+==============
+Sys_UnmapFile
+==============
+*/
+void Sys_UnmapFile( void *base, int length )
+{
+	UnmapViewOfFile( base );
+}
+
 /*
 ==================
 Sys_Mkfifo
@@ -658,6 +795,181 @@ void Sys_Sleep( int msec )
 #endif
 }
 
+/*
+==============================================================
+
+THREADS
+
+==============================================================
+*/
+
+typedef struct
+{
+	void	(*function)( void *arg );
+	void	*arg;
+	HANDLE	thread;
+} sysThread_t;
+
+/*
+==================
+Sys_ThreadMain
+==================
+*/
+static DWORD WINAPI Sys_ThreadMain( LPVOID arg )
+{
+	sysThread_t *thread = arg;
+
+	thread->function( thread->arg );
+	return 0;
+}
+
+/*
+==================
+Sys_CreateThread
+
+Returns NULL if the thread could not be started
+==================
+*/
+void *Sys_CreateThread( void (*function)( void *arg ), void *arg )
+{
+	sysThread_t *thread = calloc( 1, sizeof( *thread ) );
+
+	if( !thread )
+		return NULL;
+
+	thread->function = function;
+	thread->arg = arg;
+	thread->thread = CreateThread( NULL, 0, Sys_ThreadMain, thread, 0, NULL );
+
+	if( !thread->thread )
+	{
+		free( thread );
+		return NULL;
+	}
+
+	return thread;
+}
+
+/*
+==================
+Sys_JoinThread
+
+Waits for the thread to return and frees it
+==================
+*/
+void Sys_JoinThread( void *thread )
+{
+	sysThread_t *t = thread;
+
+	WaitForSingleObject( t->thread, INFINITE );
+	CloseHandle( t->thread );
+	free( t );
+}
+
+/*
+==================
+Sys_CreateMutex
+==================
+*/
+void *Sys_CreateMutex( void )
+{
+	CRITICAL_SECTION *mutex = malloc( sizeof( *mutex ) );
+
+	if( !mutex )
+		Sys_Error( "Sys_CreateMutex: out of memory" );
+
+	InitializeCriticalSection( mutex );
+	return mutex;
+}
+
+/*
+==================
+Sys_DestroyMutex
+==================
+*/
+void Sys_DestroyMutex( void *mutex )
+{
+	DeleteCriticalSection( mutex );
+	free( mutex );
+}
+
+/*
+==================
+Sys_LockMutex
+==================
+*/
+void Sys_LockMutex( void *mutex )
+{
+	EnterCriticalSection( mutex );
+}
+
+/*
+==================
+Sys_TryLockMutex
+==================
+*/
+qboolean Sys_TryLockMutex( void *mutex )
+{
+	return TryEnterCriticalSection( mutex ) ? qtrue : qfalse;
+}
+
+/*
+==================
+Sys_UnlockMutex
+==================
+*/
+void Sys_UnlockMutex( void *mutex )
+{
+	LeaveCriticalSection( mutex );
+}
+
+/*
+==================
+Sys_CreateSemaphore
+
+Counting semaphore starting at zero
+==================
+*/
+void *Sys_CreateSemaphore( void )
+{
+	HANDLE sem = CreateSemaphore( NULL, 0, 0x7fffffff, NULL );
+
+	if( !sem )
+		Sys_Error( "Sys_CreateSemaphore: failed (%lu)", GetLastError( ) );
+
+	return sem;
+}
+
+/*
+==================
+Sys_DestroySemaphore
+==================
+*/
+void Sys_DestroySemaphore( void *sem )
+{
+	CloseHandle( sem );
+}
+
+/*
+==================
+Sys_WaitSemaphore
+==================
+*/
+void Sys_WaitSemaphore( void *sem )
+{
+	WaitForSingleObject( sem, INFINITE );
+}
+
+/*
+==================
+Sys_PostSemaphore
+==================
+*/
+void Sys_PostSemaphore( void *sem )
+{
+	ReleaseSemaphore( sem, 1, NULL );
+}
+
 /*
 ==============
 Sys_ErrorDialog
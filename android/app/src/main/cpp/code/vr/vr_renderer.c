@@ -329,12 +329,12 @@ void VR_ReInitRenderer()
     VR_InitRenderer( VR_GetEngine() );
 }
 
-void VR_ClearFrameBuffer( int width, int height)
+void VR_ClearFrameBuffer( qboolean spectator, int width, int height)
 {
     glEnable( GL_SCISSOR_TEST );
     glViewport( 0, 0, width, height );
 
-    if (Cvar_VariableIntegerValue("vr_thirdPersonSpectator"))
+    if (spectator)
     {
         //Blood red.. ish
         glClearColor( 0.12f, 0.0f, 0.05f, 1.0f );
@@ -352,6 +352,262 @@ void VR_ClearFrameBuffer( int width, int height)
     glDisable( GL_SCISSOR_TEST );
 }
 
+/*
+With r_smp the renderer back end runs on its own thread.  In game frames are
+then begun and submitted to OpenXR by that thread, from VR_BeginRenderFrame
+and VR_EndRenderFrame, so the main thread can wait for and simulate the next
+frame while the last one is drawn.  Everything the back end needs from the
+headset is snapshotted into a vrFrame_t, one for the frame being drawn and
+one for the frame being built.  Menu and screen layer frames are still begun
+and submitted here, with the render thread idle.
+*/
+typedef struct {
+    XrTime displayTime;
+    XrFovf fov;
+    XrPosef views[ovrMaxNumEyes];
+    int renderBuffer;
+    qboolean spectator;
+    qboolean screenLayer;
+    qboolean pipelined;
+    volatile qboolean begun;
+    volatile qboolean ended;
+} vrFrame_t;
+
+#define VR_FRAMES 2
+
+static vrFrame_t vrFrames[VR_FRAMES];
+static int vrFrameNum;
+
+static void VR_SyncRenderThread( void )
+{
+    if (cls.glconfig.smpActive && re.SyncRenderThread)
+    {
+        re.SyncRenderThread();
+    }
+}
+
+static void VR_StartFrame( engine_t* engine, vrFrame_t* frame )
+{
+    XrFrameBeginInfo beginFrameDesc = {};
+    beginFrameDesc.type = XR_TYPE_FRAME_BEGIN_INFO;
+    beginFrameDesc.next = NULL;
+    OXR(xrBeginFrame(engine->appState.Session, &beginFrameDesc));
+
+    ovrFramebuffer* frameBuffer = &engine->appState.Renderer.FrameBuffer;
+    frame->renderBuffer = frameBuffer->FrameBuffers[frameBuffer->TextureSwapChainIndex];
+
+    ovrFramebuffer_Acquire(frameBuffer);
+    ovrFramebuffer_SetCurrent(frameBuffer);
+    VR_ClearFrameBuffer(frame->spectator, frameBuffer->ColorSwapChain.Width, frameBuffer->ColorSwapChain.Height);
+    frame->begun = qtrue;
+}
+
+static void VR_SubmitFrame( engine_t* engine, vrFrame_t* frame )
+{
+    ovrFramebuffer* frameBuffer = &engine->appState.Renderer.FrameBuffer;
+
+    // Clear the alpha channel, other way OpenXR would not transfer the framebuffer fully
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_TRUE);
+    glClearColor(0.0, 0.0, 0.0, 1.0);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+    ovrFramebuffer_Resolve(frameBuffer);
+    ovrFramebuffer_Release(frameBuffer);
+    ovrFramebuffer_SetNone();
+
+    engine->appState.LayerCount = 0;
+    memset(engine->appState.Layers, 0, sizeof(ovrCompositorLayer_Union) * ovrMaxLayerCount);
+
+    XrCompositionLayerProjectionView projection_layer_elements[2] = {};
+    if (!frame->screenLayer) {
+        if (fullscreenMode) {
+            VR_ReInitRenderer();
+            fullscreenMode = qfalse;
+        }
+
+        for (int eye = 0; eye < ovrMaxNumEyes; eye++) {
+            ovrFramebuffer* frameBuffer = &engine->appState.Renderer.FrameBuffer;
+
+            memset(&projection_layer_elements[eye], 0, sizeof(XrCompositionLayerProjectionView));
+            projection_layer_elements[eye].type = XR_TYPE_COMPOSITION_LAYER_PROJECTION_VIEW;
+            projection_layer_elements[eye].pose = frame->views[eye];
+            projection_layer_elements[eye].fov = frame->fov;
+
+            memset(&projection_layer_elements[eye].subImage, 0, sizeof(XrSwapchainSubImage));
+            projection_layer_elements[eye].subImage.swapchain = frameBuffer->ColorSwapChain.Handle;
+            projection_layer_elements[eye].subImage.imageRect.offset.x = 0;
+            projection_layer_elements[eye].subImage.imageRect.offset.y = 0;
+            projection_layer_elements[eye].subImage.imageRect.extent.width = frameBuffer->ColorSwapChain.Width;
+            projection_layer_elements[eye].subImage.imageRect.extent.height = frameBuffer->ColorSwapChain.Height;
+            projection_layer_elements[eye].subImage.imageArrayIndex = eye;
+        }
+
+        XrCompositionLayerProjection projection_layer = {};
+        projection_layer.type = XR_TYPE_COMPOSITION_LAYER_PROJECTION;
+        projection_layer.layerFlags = XR_COMPOSITION_LAYER_BLEND_TEXTURE_SOURCE_ALPHA_BIT;
+        projection_layer.layerFlags |= XR_COMPOSITION_LAYER_CORRECT_CHROMATIC_ABERRATION_BIT;
+        projection_layer.space = engine->appState.CurrentSpace;
+        projection_layer.viewCount = ovrMaxNumEyes;
+        projection_layer.views = projection_layer_elements;
+
+        engine->appState.Layers[engine->appState.LayerCount++].Projection = projection_layer;
+    } else {
+
+        fullscreenMode = qtrue;
+
+        // Build the cylinder layer
+        int width = engine->appState.Renderer.FrameBuffer.ColorSwapChain.Width;
+        int height = engine->appState.Renderer.FrameBuffer.ColorSwapChain.Height;
+        XrCompositionLayerCylinderKHR cylinder_layer = {};
+        cylinder_layer.type = XR_TYPE_COMPOSITION_LAYER_CYLINDER_KHR;
+        cylinder_layer.layerFlags = XR_COMPOSITION_LAYER_BLEND_TEXTURE_SOURCE_ALPHA_BIT;
+        cylinder_layer.space = engine->appState.CurrentSpace;
+        cylinder_layer.eyeVisibility = XR_EYE_VISIBILITY_BOTH;
+        memset(&cylinder_layer.subImage, 0, sizeof(XrSwapchainSubImage));
+        cylinder_layer.subImage.swapchain = engine->appState.Renderer.FrameBuffer.ColorSwapChain.Handle;
+        cylinder_layer.subImage.imageRect.offset.x = 0;
+        cylinder_layer.subImage.imageRect.offset.y = 0;
+        cylinder_layer.subImage.imageRect.extent.width = width;
+        cylinder_layer.subImage.imageRect.extent.height = height;
+        cylinder_layer.subImage.imageArrayIndex = 0;
+        const XrVector3f axis = {0.0f, 1.0f, 0.0f};
+        XrVector3f pos = {
+                frame->views[0].position.x - sin(radians(vr.menuYaw)) * 6.0f,
+                frame->views[0].position.y,
+                frame->views[0].position.z - cos(radians(vr.menuYaw)) * 6.0f
+        };
+        cylinder_layer.pose.orientation = XrQuaternionf_CreateFromVectorAngle(axis, radians(vr.menuYaw));
+        cylinder_layer.pose.position = pos;
+        cylinder_layer.radius = 8.0f;
+        cylinder_layer.centralAngle = MATH_PI * 0.5f;
+        cylinder_layer.aspectRatio = width / (float)height / 0.75f;
+
+        engine->appState.Layers[engine->appState.LayerCount++].Cylinder = cylinder_layer;
+    }
+
+    // Compose the layers for this frame.
+    const XrCompositionLayerBaseHeader* layers[ovrMaxLayerCount] = {};
+    for (int i = 0; i < engine->appState.LayerCount; i++) {
+        layers[i] = (const XrCompositionLayerBaseHeader*)&engine->appState.Layers[i];
+    }
+
+    XrFrameEndInfo endFrameInfo = {};
+    endFrameInfo.type = XR_TYPE_FRAME_END_INFO;
+    endFrameInfo.displayTime = frame->displayTime;
+    endFrameInfo.environmentBlendMode = XR_ENVIRONMENT_BLEND_MODE_OPAQUE;
+    endFrameInfo.layerCount = engine->appState.LayerCount;
+    endFrameInfo.layers = layers;
+
+    OXR(xrEndFrame(engine->appState.Session, &endFrameInfo));
+    frameBuffer->TextureSwapChainIndex++;
+    frameBuffer->TextureSwapChainIndex %= frameBuffer->TextureSwapChainLength;
+    frame->ended = qtrue;
+}
+
+/*
+A pipelined frame the render thread never finished, because the renderer
+was restarted or the frame was dropped, still has to be begun and ended, or
+the next xrWaitFrame blocks forever.  Only call with the render thread idle.
+*/
+static void VR_FinishFrame( engine_t* engine, vrFrame_t* frame )
+{
+    if (!frame->pipelined || frame->ended) {
+        return;
+    }
+    if (!frame->begun) {
+        VR_StartFrame(engine, frame);
+    }
+    VR_SubmitFrame(engine, frame);
+}
+
+int VR_BeginRenderFrame( void* vrFrame )
+{
+    vrFrame_t* frame = (vrFrame_t*)vrFrame;
+
+    if (frame->pipelined && !frame->begun) {
+        VR_StartFrame(VR_GetEngine(), frame);
+    }
+    return frame->renderBuffer;
+}
+
+void VR_EndRenderFrame( void* vrFrame )
+{
+    vrFrame_t* frame = (vrFrame_t*)vrFrame;
+
+    if (frame->pipelined && frame->begun && !frame->ended) {
+        VR_SubmitFrame(VR_GetEngine(), frame);
+    }
+}
+
+static XrQuaternionf VR_QuatMultiply( XrQuaternionf a, XrQuaternionf b )
+{
+    XrQuaternionf out;
+    out.x = a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y;
+    out.y = a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x;
+    out.z = a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w;
+    out.w = a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z;
+    return out;
+}
+
+/*
+Locates the views again just before the render thread draws the frame and
+returns the rotation from the orientation the frame was simulated with to
+the new one, in eye space, as a column major matrix to multiply the view
+matrices with.  The frame's views are updated so the compositor reprojects
+from the orientation that was actually drawn.
+*/
+int VR_LateLatchViews( void* vrFrame, float rotation[16] )
+{
+    vrFrame_t* frame = (vrFrame_t*)vrFrame;
+    engine_t* engine = VR_GetEngine();
+    XrView views[ovrMaxNumEyes];
+
+    for (int eye = 0; eye < ovrMaxNumEyes; eye++) {
+        views[eye].type = XR_TYPE_VIEW;
+        views[eye].next = NULL;
+    }
+
+    XrViewLocateInfo projectionInfo = {};
+    projectionInfo.type = XR_TYPE_VIEW_LOCATE_INFO;
+    projectionInfo.viewConfigurationType = engine->appState.ViewportConfig.viewConfigurationType;
+    projectionInfo.displayTime = frame->displayTime;
+    projectionInfo.space = engine->appState.CurrentSpace;
+
+    XrViewState viewState = {XR_TYPE_VIEW_STATE, NULL};
+    uint32_t projectionCountOutput = ovrMaxNumEyes;
+
+    XrResult result;
+    OXR(result = xrLocateViews(
+            engine->appState.Session,
+            &projectionInfo,
+            &viewState,
+            ovrMaxNumEyes,
+            &projectionCountOutput,
+            views));
+    if (result != XR_SUCCESS || !(viewState.viewStateFlags & XR_VIEW_STATE_ORIENTATION_VALID_BIT)) {
+        return qfalse;
+    }
+
+    XrQuaternionf q = views[0].pose.orientation;
+    q.x = -q.x;
+    q.y = -q.y;
+    q.z = -q.z;
+    q = VR_QuatMultiply(q, frame->views[0].orientation);
+
+    const ovrMatrix4f m = ovrMatrix4f_CreateFromQuaternion(&q);
+    for (int col = 0; col < 4; col++) {
+        for (int row = 0; row < 4; row++) {
+            rotation[col * 4 + row] = m.M[row][col];
+        }
+    }
+
+    for (int eye = 0; eye < ovrMaxNumEyes; eye++) {
+        frame->views[eye].orientation = views[eye].pose.orientation;
+    }
+    return qtrue;
+}
+
 void VR_DrawFrame( engine_t* engine ) {
 	if (vr.weapon_zoomed) {
 		vr.weapon_zoomLevel += 0.05;
@@ -367,6 +623,8 @@ void VR_DrawFrame( engine_t* engine ) {
 
     GLboolean stageBoundsDirty = GL_TRUE;
     if (ovrApp_HandleXrEvents(&engine->appState)) {
+        // the render thread may still be using the old space
+        VR_SyncRenderThread();
         VR_Recenter(engine);
     }
     if (engine->appState.SessionActive == GL_FALSE) {
@@ -378,6 +636,14 @@ void VR_DrawFrame( engine_t* engine ) {
         stageBoundsDirty = GL_FALSE;
     }
 
+    // The last frame has to be begun before the next one can be waited for.
+    // The render thread starts on it right away, so this rarely waits.
+    vrFrame_t* lastFrame = &vrFrames[vrFrameNum % VR_FRAMES];
+    if (lastFrame->pipelined && !lastFrame->begun) {
+        VR_SyncRenderThread();
+        VR_FinishFrame(engine, lastFrame);
+    }
+
     // NOTE: OpenXR does not use the concept of frame indices. Instead,
     // XrWaitFrame returns the predicted display time.
     XrFrameWaitInfo waitFrameInfo = {};
@@ -398,11 +664,6 @@ void VR_DrawFrame( engine_t* engine ) {
     // the new eye images will be displayed. The number of frames predicted ahead
     // depends on the pipeline depth of the engine and the synthesis rate.
     // The better the prediction, the less black will be pulled in at the edges.
-    XrFrameBeginInfo beginFrameDesc = {};
-    beginFrameDesc.type = XR_TYPE_FRAME_BEGIN_INFO;
-    beginFrameDesc.next = NULL;
-    OXR(xrBeginFrame(engine->appState.Session, &beginFrameDesc));
-
     XrViewLocateInfo projectionInfo = {};
     projectionInfo.type = XR_TYPE_VIEW_LOCATE_INFO;
     projectionInfo.viewConfigurationType = engine->appState.ViewportConfig.viewConfigurationType;
@@ -452,117 +713,51 @@ void VR_DrawFrame( engine_t* engine ) {
             fov.angleDown / vr.weapon_zoomLevel,
             1.0f, 0.0f );
 
-    engine->appState.LayerCount = 0;
-    memset(engine->appState.Layers, 0, sizeof(ovrCompositorLayer_Union) * ovrMaxLayerCount);
-
-    ovrFramebuffer* frameBuffer = &engine->appState.Renderer.FrameBuffer;
-    int swapchainIndex = engine->appState.Renderer.FrameBuffer.TextureSwapChainIndex;
-    int glFramebuffer = engine->appState.Renderer.FrameBuffer.FrameBuffers[swapchainIndex];
-    re.SetVRHeadsetParms(projectionMatrix.M, monoVRMatrix.M, glFramebuffer);
-
-    ovrFramebuffer_Acquire(frameBuffer);
-    ovrFramebuffer_SetCurrent(frameBuffer);
-    VR_ClearFrameBuffer(frameBuffer->ColorSwapChain.Width, frameBuffer->ColorSwapChain.Height);
-    Com_Frame();
-
-    // Clear the alpha channel, other way OpenXR would not transfer the framebuffer fully
-    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_TRUE);
-    glClearColor(0.0, 0.0, 0.0, 1.0);
-    glClear(GL_COLOR_BUFFER_BIT);
-    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    // the slot the render thread drew two frames ago is normally
+    // done by now, but make sure before reusing it
+    vrFrame_t* frame = &vrFrames[++vrFrameNum % VR_FRAMES];
+    if (frame->pipelined && !frame->ended) {
+        VR_SyncRenderThread();
+        VR_FinishFrame(engine, frame);
+    }
 
-    ovrFramebuffer_Resolve(frameBuffer);
-    ovrFramebuffer_Release(frameBuffer);
-    ovrFramebuffer_SetNone();
+    frame->displayTime = frameState.predictedDisplayTime;
+    frame->fov = fov;
+    for (int eye = 0; eye < ovrMaxNumEyes; eye++) {
+        frame->views[eye] = invViewTransform[eye];
+    }
+    frame->spectator = Cvar_VariableIntegerValue("vr_thirdPersonSpectator") ? qtrue : qfalse;
+    frame->screenLayer = VR_useScreenLayer() || (cl.snap.ps.pm_flags & PMF_FOLLOW && vr.follow_mode == VRFM_FIRSTPERSON);
+    frame->pipelined = cls.glconfig.smpActive && clc.state == CA_ACTIVE && !frame->screenLayer && !fullscreenMode;
+    frame->begun = qfalse;
+    frame->ended = qfalse;
+
+    if (!frame->pipelined) {
+        // the render thread has to be idle to use the context here
+        VR_SyncRenderThread();
+        VR_FinishFrame(engine, lastFrame);
+        VR_StartFrame(engine, frame);
+    }
 
-    XrCompositionLayerProjectionView projection_layer_elements[2] = {};
-    if (!VR_useScreenLayer() && !(cl.snap.ps.pm_flags & PMF_FOLLOW && vr.follow_mode == VRFM_FIRSTPERSON)) {
+    if (frame->pipelined) {
         vr.menuYaw = vr.hmdorientation[YAW];
+    }
 
-        if (fullscreenMode) {
-            VR_ReInitRenderer();
-            fullscreenMode = qfalse;
-        }
-
-        for (int eye = 0; eye < ovrMaxNumEyes; eye++) {
-            ovrFramebuffer* frameBuffer = &engine->appState.Renderer.FrameBuffer;
-
-            memset(&projection_layer_elements[eye], 0, sizeof(XrCompositionLayerProjectionView));
-            projection_layer_elements[eye].type = XR_TYPE_COMPOSITION_LAYER_PROJECTION_VIEW;
-            projection_layer_elements[eye].pose = invViewTransform[eye];
-            projection_layer_elements[eye].fov = fov;
+    re.SetVRHeadsetParms(projectionMatrix.M, monoVRMatrix.M, frame->renderBuffer, frame);
+    Com_Frame();
 
-            memset(&projection_layer_elements[eye].subImage, 0, sizeof(XrSwapchainSubImage));
-            projection_layer_elements[eye].subImage.swapchain = frameBuffer->ColorSwapChain.Handle;
-            projection_layer_elements[eye].subImage.imageRect.offset.x = 0;
-            projection_layer_elements[eye].subImage.imageRect.offset.y = 0;
-            projection_layer_elements[eye].subImage.imageRect.extent.width = frameBuffer->ColorSwapChain.Width;
-            projection_layer_elements[eye].subImage.imageRect.extent.height = frameBuffer->ColorSwapChain.Height;
-            projection_layer_elements[eye].subImage.imageArrayIndex = eye;
+    if (!frame->pipelined) {
+        VR_SyncRenderThread();
+        frame->screenLayer = VR_useScreenLayer() || (cl.snap.ps.pm_flags & PMF_FOLLOW && vr.follow_mode == VRFM_FIRSTPERSON);
+        if (!frame->screenLayer) {
+            vr.menuYaw = vr.hmdorientation[YAW];
         }
-
-        XrCompositionLayerProjection projection_layer = {};
-        projection_layer.type = XR_TYPE_COMPOSITION_LAYER_PROJECTION;
-        projection_layer.layerFlags = XR_COMPOSITION_LAYER_BLEND_TEXTURE_SOURCE_ALPHA_BIT;
-        projection_layer.layerFlags |= XR_COMPOSITION_LAYER_CORRECT_CHROMATIC_ABERRATION_BIT;
-        projection_layer.space = engine->appState.CurrentSpace;
-        projection_layer.viewCount = ovrMaxNumEyes;
-        projection_layer.views = projection_layer_elements;
-
-        engine->appState.Layers[engine->appState.LayerCount++].Projection = projection_layer;
-    } else {
-
-        fullscreenMode = qtrue;
-
-        // Build the cylinder layer
-        int width = engine->appState.Renderer.FrameBuffer.ColorSwapChain.Width;
-        int height = engine->appState.Renderer.FrameBuffer.ColorSwapChain.Height;
-        XrCompositionLayerCylinderKHR cylinder_layer = {};
-        cylinder_layer.type = XR_TYPE_COMPOSITION_LAYER_CYLINDER_KHR;
-        cylinder_layer.layerFlags = XR_COMPOSITION_LAYER_BLEND_TEXTURE_SOURCE_ALPHA_BIT;
-        cylinder_layer.space = engine->appState.CurrentSpace;
-        cylinder_layer.eyeVisibility = XR_EYE_VISIBILITY_BOTH;
-        memset(&cylinder_layer.subImage, 0, sizeof(XrSwapchainSubImage));
-        cylinder_layer.subImage.swapchain = engine->appState.Renderer.FrameBuffer.ColorSwapChain.Handle;
-        cylinder_layer.subImage.imageRect.offset.x = 0;
-        cylinder_layer.subImage.imageRect.offset.y = 0;
-        cylinder_layer.subImage.imageRect.extent.width = width;
-        cylinder_layer.subImage.imageRect.extent.height = height;
-        cylinder_layer.subImage.imageArrayIndex = 0;
-        const XrVector3f axis = {0.0f, 1.0f, 0.0f};
-        XrVector3f pos = {
-                invViewTransform[0].position.x - sin(radians(vr.menuYaw)) * 6.0f,
-                invViewTransform[0].position.y,
-                invViewTransform[0].position.z - cos(radians(vr.menuYaw)) * 6.0f
-        };
-        cylinder_layer.pose.orientation = XrQuaternionf_CreateFromVectorAngle(axis, radians(vr.menuYaw));
-        cylinder_layer.pose.position = pos;
-        cylinder_layer.radius = 8.0f;
-        cylinder_layer.centralAngle = MATH_PI * 0.5f;
-        cylinder_layer.aspectRatio = width / (float)height / 0.75f;
-
-        engine->appState.Layers[engine->appState.LayerCount++].Cylinder = cylinder_layer;
+        VR_SubmitFrame(engine, frame);
     }
 
-    // Compose the layers for this frame.
-    const XrCompositionLayerBaseHeader* layers[ovrMaxLayerCount] = {};
-    for (int i = 0; i < engine->appState.LayerCount; i++) {
-        layers[i] = (const XrCompositionLayerBaseHeader*)&engine->appState.Layers[i];
-    }
-
-    XrFrameEndInfo endFrameInfo = {};
-    endFrameInfo.type = XR_TYPE_FRAME_END_INFO;
-    endFrameInfo.displayTime = frameState.predictedDisplayTime;
-    endFrameInfo.environmentBlendMode = XR_ENVIRONMENT_BLEND_MODE_OPAQUE;
-    endFrameInfo.layerCount = engine->appState.LayerCount;
-    endFrameInfo.layers = layers;
-
-    OXR(xrEndFrame(engine->appState.Session, &endFrameInfo));
-    frameBuffer->TextureSwapChainIndex++;
-    frameBuffer->TextureSwapChainIndex %= frameBuffer->TextureSwapChainLength;
-
     if (needRecenter)
     {
+        VR_SyncRenderThread();
         VR_Recenter(engine);
         needRecenter = qfalse;
     }
@@ -11,6 +11,11 @@ void VR_DestroyRenderer( engine_t* engine );
 void VR_DrawFrame( engine_t* engine );
 void VR_ReInitRenderer();
 
+// called by the renderer back end, on the render thread with r_smp
+int VR_BeginRenderFrame( void* vrFrame );
+void VR_EndRenderFrame( void* vrFrame );
+int VR_LateLatchViews( void* vrFrame, float rotation[16] );
+
 #endif
 
 #endif